@@ -0,0 +1,381 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * Encoding Benchmarks
+ * -------------------
+ * Measures binary encoding, decoding and size computation for the builtin
+ * types and for representative service messages. Every case is run for a fixed
+ * time. The results are printed as CSV on stdout, one line per case and
+ * operation, so that runs of different releases can be compared with a script.
+ *
+ * Usage: bench_encoding [seconds per case] [name filter]
+ *
+ * Columns: case, operation, iterations, ns_per_op, bytes (of the encoding),
+ * bytes_per_s, allocs_per_op. allocs_per_op is -1 if the allocations cannot be
+ * counted on the platform. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_nodeids.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_arena.h"
+#include "ua_util.h"
+
+/* With GNU ld, the benchmark is linked with --wrap for the allocator. The
+ * library is linked from its object files. So the allocations of the encoding
+ * functions are counted as well. */
+#ifdef UA_BENCH_COUNT_ALLOCS
+static size_t allocs = 0;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t num, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size) { allocs++; return __real_malloc(size); }
+void *__wrap_calloc(size_t num, size_t size) { allocs++; return __real_calloc(num, size); }
+void *__wrap_realloc(void *ptr, size_t size) { allocs++; return __real_realloc(ptr, size); }
+#endif
+
+typedef enum {
+    BENCH_ENCODE,
+    BENCH_DECODE,
+    BENCH_DECODE_ARENA,
+    BENCH_CALCSIZE
+} BenchOperation;
+
+static const char *operationNames[] = {"encode", "decode", "decode_arena", "calcsize"};
+
+static UA_DateTime benchDuration = UA_MSEC_TO_DATETIME * 200;
+static const char *benchFilter = NULL;
+
+/* Run a single operation once. Returns false on an error. */
+static UA_Boolean
+runOnce(BenchOperation op, const void *value, const UA_DataType *type,
+        UA_ByteString *buf, const UA_ByteString *encoded, void *scratch, UA_Arena *arena) {
+    size_t offset = 0;
+    switch(op) {
+    case BENCH_ENCODE:
+        return UA_encodeBinary(value, type, NULL, NULL, buf, &offset) == UA_STATUSCODE_GOOD;
+    case BENCH_DECODE:
+        if(UA_decodeBinary(encoded, &offset, scratch, type) != UA_STATUSCODE_GOOD)
+            return false;
+        UA_deleteMembers(scratch, type);
+        return true;
+    case BENCH_DECODE_ARENA:
+        if(UA_decodeBinaryChunked(encoded, &offset, scratch, type, NULL, NULL, 0, arena) != UA_STATUSCODE_GOOD)
+            return false;
+        UA_Arena_deleteMembers(arena);
+        return true;
+    case BENCH_CALCSIZE:
+        return UA_calcSizeBinary((void*)(uintptr_t)value, type) > 0;
+    }
+    return false;
+}
+
+static void
+benchOperation(const char *name, BenchOperation op, const void *value, const UA_DataType *type,
+               UA_ByteString *buf, const UA_ByteString *encoded) {
+    void *scratch = UA_malloc(type->memSize);
+    UA_Byte arenaBuf[4096];
+    UA_Arena arena;
+    UA_Arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+
+    /* Warm up and check that the operation works */
+    if(!scratch || !runOnce(op, value, type, buf, encoded, scratch, &arena)) {
+        fprintf(stderr, "%s: %s failed\n", name, operationNames[op]);
+        UA_free(scratch);
+        return;
+    }
+
+    /* Run batches until the duration has passed */
+    size_t iterations = 0;
+    size_t batch = 1;
+#ifdef UA_BENCH_COUNT_ALLOCS
+    size_t allocsBefore = allocs;
+#endif
+    UA_DateTime start = UA_DateTime_nowMonotonic();
+    UA_DateTime elapsed = 0;
+    while(elapsed < benchDuration) {
+        for(size_t i = 0; i < batch; i++)
+            runOnce(op, value, type, buf, encoded, scratch, &arena);
+        iterations += batch;
+        if(batch < 1024)
+            batch *= 2;
+        elapsed = UA_DateTime_nowMonotonic() - start;
+    }
+    double allocsPerOp = -1;
+#ifdef UA_BENCH_COUNT_ALLOCS
+    allocsPerOp = (double)(allocs - allocsBefore) / (double)iterations;
+#endif
+
+    double nsPerOp = ((double)elapsed * 100.0) / (double)iterations;
+    double bytesPerSec = nsPerOp > 0 ? (double)encoded->length * 1e9 / nsPerOp : 0;
+    printf("%s,%s,%lu,%.1f,%lu,%.0f,%.2f\n", name, operationNames[op], (unsigned long)iterations,
+           nsPerOp, (unsigned long)encoded->length, bytesPerSec, allocsPerOp);
+    UA_free(scratch);
+}
+
+static void
+bench(const char *name, const void *value, const UA_DataType *type) {
+    if(benchFilter && !strstr(name, benchFilter))
+        return;
+    UA_ByteString buf;
+    size_t size = UA_calcSizeBinary((void*)(uintptr_t)value, type);
+    if(UA_ByteString_allocBuffer(&buf, size) != UA_STATUSCODE_GOOD)
+        return;
+    size_t offset = 0;
+    if(UA_encodeBinary(value, type, NULL, NULL, &buf, &offset) != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "%s: cannot be encoded\n", name);
+        UA_ByteString_deleteMembers(&buf);
+        return;
+    }
+    UA_ByteString encoded;
+    UA_ByteString_copy(&buf, &encoded);
+    encoded.length = offset;
+    benchOperation(name, BENCH_ENCODE, value, type, &buf, &encoded);
+    benchOperation(name, BENCH_DECODE, value, type, &buf, &encoded);
+    benchOperation(name, BENCH_DECODE_ARENA, value, type, &buf, &encoded);
+    benchOperation(name, BENCH_CALCSIZE, value, type, &buf, &encoded);
+    UA_ByteString_deleteMembers(&encoded);
+    UA_ByteString_deleteMembers(&buf);
+}
+
+/*****************/
+/* Builtin Types */
+/*****************/
+
+static const char *builtinNames[UA_BUILTIN_TYPES_COUNT] = {
+    "boolean", "sbyte", "byte", "int16", "uint16", "int32", "uint32", "int64",
+    "uint64", "float", "double", "string", "datetime", "guid", "bytestring",
+    "xmlelement", "nodeid", "expandednodeid", "statuscode", "qualifiedname",
+    "localizedtext", "extensionobject", "datavalue", "variant", "diagnosticinfo"};
+
+static void benchBuiltin(void) {
+    for(size_t i = 0; i < UA_BUILTIN_TYPES_COUNT; i++) {
+        const UA_DataType *type = &UA_TYPES[i];
+        void *value = UA_new(type);
+        switch(i) {
+        case UA_TYPES_STRING:
+        case UA_TYPES_BYTESTRING:
+        case UA_TYPES_XMLELEMENT:
+            *(UA_String*)value = UA_STRING_ALLOC("open62541 encoding benchmark");
+            break;
+        case UA_TYPES_NODEID:
+            *(UA_NodeId*)value = UA_NODEID_STRING_ALLOC(1, "Objects.Plant.Line1.Temperature");
+            break;
+        case UA_TYPES_EXPANDEDNODEID:
+            ((UA_ExpandedNodeId*)value)->nodeId = UA_NODEID_NUMERIC(2, 123456);
+            break;
+        case UA_TYPES_QUALIFIEDNAME:
+            *(UA_QualifiedName*)value = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+            break;
+        case UA_TYPES_LOCALIZEDTEXT:
+            *(UA_LocalizedText*)value = UA_LOCALIZEDTEXT_ALLOC("en-US", "Temperature");
+            break;
+        case UA_TYPES_VARIANT: {
+            UA_Double d = 23.5;
+            UA_Variant_setScalarCopy(value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+            break;
+        }
+        case UA_TYPES_DATAVALUE: {
+            UA_DataValue *dv = value;
+            UA_Double d = 23.5;
+            UA_Variant_setScalarCopy(&dv->value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+            dv->hasValue = true;
+            dv->sourceTimestamp = UA_DateTime_now();
+            dv->hasSourceTimestamp = true;
+            break;
+        }
+        case UA_TYPES_EXTENSIONOBJECT: {
+            UA_ExtensionObject *eo = value;
+            UA_ReadValueId *rvi = UA_ReadValueId_new();
+            rvi->nodeId = UA_NODEID_NUMERIC(0, 2258);
+            rvi->attributeId = UA_ATTRIBUTEID_VALUE;
+            eo->encoding = UA_EXTENSIONOBJECT_DECODED;
+            eo->content.decoded.type = &UA_TYPES[UA_TYPES_READVALUEID];
+            eo->content.decoded.data = rvi;
+            break;
+        }
+        default:
+            break;
+        }
+        bench(builtinNames[i], value, type);
+        UA_delete(value, type);
+    }
+}
+
+/**********/
+/* Arrays */
+/**********/
+
+#define ARRAYSIZE 10000
+
+static void benchArrays(void) {
+    UA_Variant v;
+    UA_Int32 *ints = UA_Array_new(ARRAYSIZE, &UA_TYPES[UA_TYPES_INT32]);
+    for(size_t i = 0; i < ARRAYSIZE; i++)
+        ints[i] = (UA_Int32)i;
+    UA_Variant_setArray(&v, ints, ARRAYSIZE, &UA_TYPES[UA_TYPES_INT32]);
+    bench("array_int32_10000", &v, &UA_TYPES[UA_TYPES_VARIANT]);
+    UA_Variant_deleteMembers(&v);
+
+    UA_Double *doubles = UA_Array_new(ARRAYSIZE, &UA_TYPES[UA_TYPES_DOUBLE]);
+    for(size_t i = 0; i < ARRAYSIZE; i++)
+        doubles[i] = (UA_Double)i * 0.5;
+    UA_Variant_setArray(&v, doubles, ARRAYSIZE, &UA_TYPES[UA_TYPES_DOUBLE]);
+    bench("array_double_10000", &v, &UA_TYPES[UA_TYPES_VARIANT]);
+    UA_Variant_deleteMembers(&v);
+
+    UA_String *strings = UA_Array_new(ARRAYSIZE / 10, &UA_TYPES[UA_TYPES_STRING]);
+    for(size_t i = 0; i < ARRAYSIZE / 10; i++)
+        strings[i] = UA_STRING_ALLOC("Objects.Plant.Line1");
+    UA_Variant_setArray(&v, strings, ARRAYSIZE / 10, &UA_TYPES[UA_TYPES_STRING]);
+    bench("array_string_1000", &v, &UA_TYPES[UA_TYPES_VARIANT]);
+    UA_Variant_deleteMembers(&v);
+
+    /* Structures in a variant are wrapped into ExtensionObjects */
+    UA_ReadValueId *rvis = UA_Array_new(100, &UA_TYPES[UA_TYPES_READVALUEID]);
+    for(size_t i = 0; i < 100; i++) {
+        rvis[i].nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)(1000 + i));
+        rvis[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    UA_Variant_setArray(&v, rvis, 100, &UA_TYPES[UA_TYPES_READVALUEID]);
+    bench("variant_readvalueid_100", &v, &UA_TYPES[UA_TYPES_VARIANT]);
+    UA_Variant_deleteMembers(&v);
+}
+
+/********************/
+/* Service Messages */
+/********************/
+
+#define NODESCOUNT 100
+
+static void benchRead(void) {
+    UA_ReadRequest rq;
+    UA_ReadRequest_init(&rq);
+    rq.requestHeader.authenticationToken = UA_NODEID_NUMERIC(1, 4711);
+    rq.requestHeader.timestamp = UA_DateTime_now();
+    rq.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    rq.nodesToRead = UA_Array_new(NODESCOUNT, &UA_TYPES[UA_TYPES_READVALUEID]);
+    rq.nodesToReadSize = NODESCOUNT;
+    for(size_t i = 0; i < NODESCOUNT; i++) {
+        rq.nodesToRead[i].nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)(1000 + i));
+        rq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    bench("readrequest_100", &rq, &UA_TYPES[UA_TYPES_READREQUEST]);
+    UA_ReadRequest_deleteMembers(&rq);
+
+    UA_ReadResponse rr;
+    UA_ReadResponse_init(&rr);
+    rr.responseHeader.timestamp = UA_DateTime_now();
+    rr.results = UA_Array_new(NODESCOUNT, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    rr.resultsSize = NODESCOUNT;
+    for(size_t i = 0; i < NODESCOUNT; i++) {
+        UA_Double d = (UA_Double)i;
+        UA_Variant_setScalarCopy(&rr.results[i].value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+        rr.results[i].hasValue = true;
+        rr.results[i].sourceTimestamp = rr.responseHeader.timestamp;
+        rr.results[i].hasSourceTimestamp = true;
+    }
+    bench("readresponse_100", &rr, &UA_TYPES[UA_TYPES_READRESPONSE]);
+    UA_ReadResponse_deleteMembers(&rr);
+}
+
+static void benchBrowse(void) {
+    UA_BrowseResponse br;
+    UA_BrowseResponse_init(&br);
+    br.results = UA_BrowseResult_new();
+    br.resultsSize = 1;
+    br.results->references = UA_Array_new(NODESCOUNT, &UA_TYPES[UA_TYPES_REFERENCEDESCRIPTION]);
+    br.results->referencesSize = NODESCOUNT;
+    for(size_t i = 0; i < NODESCOUNT; i++) {
+        UA_ReferenceDescription *rd = &br.results->references[i];
+        rd->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+        rd->isForward = true;
+        rd->nodeId.nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)(1000 + i));
+        rd->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+        rd->displayName = UA_LOCALIZEDTEXT_ALLOC("en-US", "Temperature");
+        rd->nodeClass = UA_NODECLASS_VARIABLE;
+        rd->typeDefinition.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+    }
+    bench("browseresponse_100", &br, &UA_TYPES[UA_TYPES_BROWSERESPONSE]);
+    UA_BrowseResponse_deleteMembers(&br);
+}
+
+static void benchPublish(void) {
+    UA_DataChangeNotification *dcn = UA_DataChangeNotification_new();
+    dcn->monitoredItems = UA_Array_new(NODESCOUNT, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+    dcn->monitoredItemsSize = NODESCOUNT;
+    for(size_t i = 0; i < NODESCOUNT; i++) {
+        UA_MonitoredItemNotification *min = &dcn->monitoredItems[i];
+        UA_Double d = (UA_Double)i;
+        min->clientHandle = (UA_UInt32)i;
+        UA_Variant_setScalarCopy(&min->value.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+        min->value.hasValue = true;
+    }
+    UA_PublishResponse pr;
+    UA_PublishResponse_init(&pr);
+    pr.subscriptionId = 1;
+    pr.notificationMessage.sequenceNumber = 1;
+    pr.notificationMessage.publishTime = UA_DateTime_now();
+    pr.notificationMessage.notificationData = UA_ExtensionObject_new();
+    pr.notificationMessage.notificationDataSize = 1;
+    pr.notificationMessage.notificationData->encoding = UA_EXTENSIONOBJECT_DECODED;
+    pr.notificationMessage.notificationData->content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION];
+    pr.notificationMessage.notificationData->content.decoded.data = dcn;
+    bench("publishresponse_100", &pr, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    UA_PublishResponse_deleteMembers(&pr);
+}
+
+/* ExtensionObjects within ExtensionObjects: an AddNodesRequest with variable
+ * attributes, wrapped once more */
+static void benchNestedExtensionObjects(void) {
+    UA_AddNodesRequest *anr = UA_AddNodesRequest_new();
+    anr->nodesToAdd = UA_Array_new(NODESCOUNT / 10, &UA_TYPES[UA_TYPES_ADDNODESITEM]);
+    anr->nodesToAddSize = NODESCOUNT / 10;
+    for(size_t i = 0; i < NODESCOUNT / 10; i++) {
+        UA_AddNodesItem *item = &anr->nodesToAdd[i];
+        item->parentNodeId.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+        item->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+        item->requestedNewNodeId.nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)(1000 + i));
+        item->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Temperature");
+        item->nodeClass = UA_NODECLASS_VARIABLE;
+        UA_VariableAttributes *attr = UA_VariableAttributes_new();
+        attr->displayName = UA_LOCALIZEDTEXT_ALLOC("en-US", "Temperature");
+        UA_Double d = 23.5;
+        UA_Variant_setScalarCopy(&attr->value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+        item->nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED;
+        item->nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+        item->nodeAttributes.content.decoded.data = attr;
+    }
+    UA_ExtensionObject eo;
+    UA_ExtensionObject_init(&eo);
+    eo.encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo.content.decoded.type = &UA_TYPES[UA_TYPES_ADDNODESREQUEST];
+    eo.content.decoded.data = anr;
+    bench("nested_extensionobject_10", &eo, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
+    UA_ExtensionObject_deleteMembers(&eo);
+}
+
+int main(int argc, char **argv) {
+    if(argc > 1)
+        benchDuration = (UA_DateTime)(atof(argv[1]) * UA_SEC_TO_DATETIME);
+    if(argc > 2)
+        benchFilter = argv[2];
+
+    printf("case,operation,iterations,ns_per_op,bytes,bytes_per_s,allocs_per_op\n");
+    benchBuiltin();
+    benchArrays();
+    benchRead();
+    benchBrowse();
+    benchPublish();
+    benchNestedExtensionObjects();
+    return 0;
+}
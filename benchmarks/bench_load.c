@@ -0,0 +1,461 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * Load Generator
+ * --------------
+ * Opens a number of sessions against a server and sends a mix of Read, Write,
+ * Browse and Call requests at a target rate. Every session runs in its own
+ * thread and sends its share of the rate with the asynchronous client API.
+ * Up to WINDOW requests per session are in flight. The requests are sent on a
+ * fixed schedule. If the server falls behind, the requests are sent late and
+ * their latency is counted from the scheduled time. So a saturated server shows
+ * up in the latency and not only in the throughput.
+ *
+ * Optionally, every session creates a subscription that monitors the current
+ * time of the server. The notifications are counted.
+ *
+ * The requests target the nodes of examples/server.c: the variable
+ * ns=1;s=the.answer is read and written, the objects folder is browsed and the
+ * method ns=1;i=62541 is called. Without an endpoint url (or with "local"), the
+ * load generator starts a server with these nodes in the same process.
+ *
+ * Usage: bench_load [endpoint url|local] [sessions] [requests per s] [seconds]
+ *                   [mix] [monitored items per session]
+ *
+ * The mix gives the weights of the services, e.g. r70w20b5c5 for 70% reads,
+ * 20% writes, 5% browses and 5% calls. The default is r80w10b10.
+ *
+ * The result is printed as a CSV line with the columns sessions, target_rate,
+ * seconds, requests, errors, requests_per_s, p50_us, p99_us, p999_us, max_us,
+ * notifications_per_s. */
+
+#include "ua_types.h" // first, defines _DEFAULT_SOURCE for nanosleep
+#include "ua_types_generated.h"
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel.h"
+#include "ua_config_standard.h"
+#include "ua_network_tcp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h> // nanosleep
+#include <pthread.h>
+
+#define WINDOW 32 /* requests in flight per session */
+#define LOCALPORT 16664
+#define LOCALSTARTUP 50 /* attempts to connect to the starting local server */
+#define DRAINTIMEOUT (2 * UA_SEC_TO_DATETIME) /* for the last responses */
+
+typedef enum {
+    LOAD_READ,
+    LOAD_WRITE,
+    LOAD_BROWSE,
+    LOAD_CALL,
+    LOAD_SERVICES
+} LoadService;
+
+typedef struct {
+    UA_UInt32 requestId;
+    UA_DateTime scheduled;
+} PendingRequest;
+
+typedef struct {
+    pthread_t thread;
+    UA_Client *client;
+    size_t index;
+    PendingRequest pending[WINDOW];
+    size_t pendingSize;
+    UA_DateTime *latencies;
+    size_t latenciesSize;
+    size_t latenciesCapacity;
+    size_t errors;
+    size_t notifications;
+} LoadSession;
+
+static const char *endpointUrl = "opc.tcp://localhost:16664";
+static size_t sessionsSize = 10;
+static double rate = 1000.0;
+static double seconds = 10.0;
+static unsigned int weights[LOAD_SERVICES] = {80, 10, 10, 0};
+static unsigned int weightsSum = 100;
+static size_t itemsSize = 0;
+static UA_DateTime startTime, endTime;
+
+static const UA_NodeId answerId = {1, UA_NODEIDTYPE_STRING, {.string = {10, (UA_Byte*)"the.answer"}}};
+static const UA_NodeId pingId = {1, UA_NODEIDTYPE_NUMERIC, {.numeric = 62541}};
+
+/*********************/
+/* In-Process Server */
+/*********************/
+
+static UA_Server *localServer;
+static volatile UA_Boolean localRunning = true;
+
+static UA_StatusCode
+pingMethod(void *handle, const UA_NodeId objectId, size_t inputSize, const UA_Variant *input,
+           size_t outputSize, UA_Variant *output) {
+    return UA_Variant_copy(input, output);
+}
+
+static void * localServerLoop(void *data) {
+    UA_Server_run(localServer, &localRunning);
+    return NULL;
+}
+
+static UA_StatusCode startLocalServer(UA_ServerNetworkLayer *nl, pthread_t *thread) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    *nl = UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, LOCALPORT);
+    config.networkLayers = nl;
+    config.networkLayersSize = 1;
+    config.logger = NULL;
+    config.maxSessions = (UA_UInt16)(sessionsSize + 10);
+    localServer = UA_Server_new(config);
+
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 answer = 42;
+    UA_Variant_setScalar(&vattr.value, &answer, &UA_TYPES[UA_TYPES_INT32]);
+    vattr.accessLevel = UA_ACCESSLEVELMASK_READ | UA_ACCESSLEVELMASK_WRITE;
+    vattr.userAccessLevel = vattr.accessLevel;
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(localServer, answerId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "the answer"), UA_NODEID_NULL, vattr, NULL, NULL);
+
+#ifdef UA_ENABLE_METHODCALLS
+    UA_Argument argument;
+    UA_Argument_init(&argument);
+    argument.dataType = UA_TYPES[UA_TYPES_STRING].typeId;
+    argument.valueRank = -1;
+    UA_MethodAttributes mattr;
+    UA_MethodAttributes_init(&mattr);
+    mattr.executable = true;
+    mattr.userExecutable = true;
+    retval |= UA_Server_addMethodNode(localServer, pingId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                      UA_QUALIFIEDNAME(1, "ping"), mattr, pingMethod, NULL,
+                                      1, &argument, 1, &argument, NULL);
+#endif
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(pthread_create(thread, NULL, localServerLoop, NULL) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* Wait until the server listens */
+    struct timespec pause = {0, 100 * 1000 * 1000};
+    UA_ClientConfig cc = UA_ClientConfig_standard;
+    cc.logger = NULL;
+    for(size_t i = 0; i < LOCALSTARTUP; i++) {
+        UA_Client *client = UA_Client_new(cc);
+        retval = UA_Client_connect(client, endpointUrl);
+        UA_Client_delete(client);
+        if(retval == UA_STATUSCODE_GOOD)
+            break;
+        nanosleep(&pause, NULL);
+    }
+    return retval;
+}
+
+/************/
+/* Sessions */
+/************/
+
+static void recordLatency(LoadSession *ls, UA_DateTime latency) {
+    if(ls->latenciesSize == ls->latenciesCapacity) {
+        size_t capacity = ls->latenciesCapacity ? ls->latenciesCapacity * 2 : 1024;
+        UA_DateTime *latencies = realloc(ls->latencies, capacity * sizeof(UA_DateTime));
+        if(!latencies)
+            return;
+        ls->latencies = latencies;
+        ls->latenciesCapacity = capacity;
+    }
+    ls->latencies[ls->latenciesSize] = latency;
+    ls->latenciesSize++;
+}
+
+static void
+responseCallback(UA_Client *client, void *userdata, UA_UInt32 requestId, const void *response) {
+    LoadSession *ls = (LoadSession*)userdata;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < ls->pendingSize; i++) {
+        if(ls->pending[i].requestId != requestId)
+            continue;
+        recordLatency(ls, now - ls->pending[i].scheduled);
+        ls->pendingSize--;
+        ls->pending[i] = ls->pending[ls->pendingSize];
+        break;
+    }
+    /* Only the service result is checked */
+    const UA_ResponseHeader *rh = (const UA_ResponseHeader*)response;
+    if(rh->serviceResult != UA_STATUSCODE_GOOD)
+        ls->errors++;
+}
+
+static void
+notificationHandler(UA_UInt32 monId, UA_DataValue *value, void *context) {
+    ((LoadSession*)context)->notifications++;
+}
+
+static LoadService nextService(void) {
+    unsigned int r = UA_UInt32_random() % weightsSum;
+    for(int s = 0; s < LOAD_SERVICES; s++) {
+        if(r < weights[s])
+            return (LoadService)s;
+        r -= weights[s];
+    }
+    return LOAD_READ;
+}
+
+static UA_StatusCode sendRequest(LoadSession *ls, UA_UInt32 *requestId) {
+    switch(nextService()) {
+    case LOAD_WRITE: {
+        UA_Int32 value = 42;
+        UA_WriteValue wv;
+        UA_WriteValue_init(&wv);
+        wv.nodeId = answerId;
+        wv.attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_Variant_setScalar(&wv.value.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+        wv.value.hasValue = true;
+        UA_WriteRequest req;
+        UA_WriteRequest_init(&req);
+        req.nodesToWrite = &wv;
+        req.nodesToWriteSize = 1;
+        return UA_Client_AsyncService_write(ls->client, req, responseCallback, ls, requestId);
+    }
+    case LOAD_BROWSE: {
+        UA_BrowseDescription bd;
+        UA_BrowseDescription_init(&bd);
+        bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+        bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+        bd.includeSubtypes = true;
+        bd.resultMask = UA_BROWSERESULTMASK_ALL;
+        UA_BrowseRequest req;
+        UA_BrowseRequest_init(&req);
+        req.nodesToBrowse = &bd;
+        req.nodesToBrowseSize = 1;
+        return UA_Client_AsyncService_browse(ls->client, req, responseCallback, ls, requestId);
+    }
+    case LOAD_CALL: {
+        UA_String ping = UA_STRING("ping");
+        UA_CallMethodRequest cmr;
+        UA_CallMethodRequest_init(&cmr);
+        cmr.objectId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+        cmr.methodId = pingId;
+        UA_Variant input;
+        UA_Variant_setScalar(&input, &ping, &UA_TYPES[UA_TYPES_STRING]);
+        cmr.inputArguments = &input;
+        cmr.inputArgumentsSize = 1;
+        UA_CallRequest req;
+        UA_CallRequest_init(&req);
+        req.methodsToCall = &cmr;
+        req.methodsToCallSize = 1;
+        return UA_Client_AsyncService_call(ls->client, req, responseCallback, ls, requestId);
+    }
+    default: {
+        UA_ReadValueId rvid;
+        UA_ReadValueId_init(&rvid);
+        rvid.nodeId = answerId;
+        rvid.attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_ReadRequest req;
+        UA_ReadRequest_init(&req);
+        req.nodesToRead = &rvid;
+        req.nodesToReadSize = 1;
+        return UA_Client_AsyncService_read(ls->client, req, responseCallback, ls, requestId);
+    }
+    }
+}
+
+static void * sessionLoop(void *data) {
+    LoadSession *ls = (LoadSession*)data;
+    UA_DateTime interval = (UA_DateTime)((double)UA_SEC_TO_DATETIME * (double)sessionsSize / rate);
+    /* spread the sessions over the first interval */
+    UA_DateTime next = startTime + interval * (UA_DateTime)ls->index / (UA_DateTime)sessionsSize;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    while(now < endTime) {
+        while(now >= next && ls->pendingSize < WINDOW) {
+            UA_UInt32 requestId = 0;
+            if(sendRequest(ls, &requestId) != UA_STATUSCODE_GOOD) {
+                ls->errors++;
+            } else {
+                ls->pending[ls->pendingSize].requestId = requestId;
+                ls->pending[ls->pendingSize].scheduled = next;
+                ls->pendingSize++;
+            }
+            next += interval;
+        }
+        UA_UInt16 timeout = 1;
+        if(ls->pendingSize < WINDOW && next - now > UA_MSEC_TO_DATETIME)
+            timeout = (UA_UInt16)((next - now) / UA_MSEC_TO_DATETIME);
+        if(UA_Client_run_iterate(ls->client, timeout) != UA_STATUSCODE_GOOD)
+            break;
+        now = UA_DateTime_nowMonotonic();
+    }
+
+    /* Wait for the last responses. They count as errors if they don't arrive. */
+    UA_DateTime drainEnd = UA_DateTime_nowMonotonic() + DRAINTIMEOUT;
+    while(ls->pendingSize > 0 && UA_DateTime_nowMonotonic() < drainEnd) {
+        if(UA_Client_run_iterate(ls->client, 10) != UA_STATUSCODE_GOOD)
+            break;
+    }
+    ls->errors += ls->pendingSize;
+    return NULL;
+}
+
+static UA_StatusCode connectSession(LoadSession *ls) {
+    ls->client = UA_Client_new(UA_ClientConfig_standard);
+    UA_StatusCode retval = UA_Client_connect(ls->client, endpointUrl);
+    if(retval != UA_STATUSCODE_GOOD || itemsSize == 0)
+        return retval;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_SubscriptionSettings settings = UA_SubscriptionSettings_standard;
+    settings.requestedPublishingInterval = 100.0;
+    settings.maxNotificationsPerPublish = 0;
+    UA_UInt32 subId = 0;
+    retval = UA_Client_Subscriptions_new(ls->client, settings, &subId);
+    for(size_t i = 0; i < itemsSize && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_UInt32 monId = 0;
+        retval = UA_Client_Subscriptions_addMonitoredItem(ls->client, subId,
+                     UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                     UA_ATTRIBUTEID_VALUE, notificationHandler, ls, &monId);
+    }
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_Client_Subscriptions_startPublishing(ls->client, 4);
+#endif
+    return retval;
+}
+
+/**********/
+/* Report */
+/**********/
+
+static int compareDateTime(const void *a, const void *b) {
+    UA_DateTime x = *(const UA_DateTime*)a;
+    UA_DateTime y = *(const UA_DateTime*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentileUs(const UA_DateTime *sorted, size_t size, double p) {
+    if(size == 0)
+        return 0;
+    size_t i = (size_t)(p * (double)(size - 1));
+    return (double)sorted[i] / (double)UA_USEC_TO_DATETIME;
+}
+
+static int parseMix(const char *mix) {
+    memset(weights, 0, sizeof(weights));
+    weightsSum = 0;
+    while(*mix) {
+        int s;
+        switch(*mix) {
+        case 'r': s = LOAD_READ; break;
+        case 'w': s = LOAD_WRITE; break;
+        case 'b': s = LOAD_BROWSE; break;
+        case 'c': s = LOAD_CALL; break;
+        default: return -1;
+        }
+        mix++;
+        if(!isdigit((unsigned char)*mix))
+            return -1;
+        char *end;
+        weights[s] = (unsigned int)strtoul(mix, &end, 10);
+        weightsSum += weights[s];
+        mix = end;
+    }
+    return weightsSum > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    UA_Boolean local = argc <= 1 || strcmp(argv[1], "local") == 0;
+    if(!local)
+        endpointUrl = argv[1];
+    if(argc > 2)
+        sessionsSize = (size_t)atol(argv[2]);
+    if(argc > 3)
+        rate = atof(argv[3]);
+    if(argc > 4)
+        seconds = atof(argv[4]);
+    if(argc > 6)
+        itemsSize = (size_t)atol(argv[6]);
+    if(sessionsSize == 0 || rate <= 0 || seconds <= 0 || (argc > 5 && parseMix(argv[5]) != 0)) {
+        fprintf(stderr, "usage: %s [endpoint url|local] [sessions] [requests per s] [seconds] "
+                "[mix, e.g. r70w20b5c5] [monitored items per session]\n", argv[0]);
+        return 1;
+    }
+
+    UA_ServerNetworkLayer nl;
+    pthread_t serverThread;
+    if(local && startLocalServer(&nl, &serverThread) != UA_STATUSCODE_GOOD) {
+        fprintf(stderr, "could not start the local server\n");
+        return 1;
+    }
+
+    /* Connect all sessions before the clock starts */
+    int ret = 0;
+    LoadSession *sessions = calloc(sessionsSize, sizeof(LoadSession));
+    size_t connected = 0;
+    for(; sessions && connected < sessionsSize; connected++) {
+        sessions[connected].index = connected;
+        UA_StatusCode retval = connectSession(&sessions[connected]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            fprintf(stderr, "session %lu could not connect: 0x%08x\n",
+                    (unsigned long)connected, retval);
+            UA_Client_delete(sessions[connected].client);
+            ret = 1;
+            break;
+        }
+    }
+
+    if(ret == 0) {
+        startTime = UA_DateTime_nowMonotonic();
+        endTime = startTime + (UA_DateTime)(seconds * (double)UA_SEC_TO_DATETIME);
+        for(size_t i = 0; i < sessionsSize; i++)
+            pthread_create(&sessions[i].thread, NULL, sessionLoop, &sessions[i]);
+        for(size_t i = 0; i < sessionsSize; i++)
+            pthread_join(sessions[i].thread, NULL);
+        double duration = (double)(UA_DateTime_nowMonotonic() - startTime) / (double)UA_SEC_TO_DATETIME;
+
+        /* Merge the latencies */
+        size_t requests = 0, errors = 0, notifications = 0;
+        for(size_t i = 0; i < sessionsSize; i++) {
+            requests += sessions[i].latenciesSize;
+            errors += sessions[i].errors;
+            notifications += sessions[i].notifications;
+        }
+        UA_DateTime *latencies = malloc((requests > 0 ? requests : 1) * sizeof(UA_DateTime));
+        size_t p = 0;
+        for(size_t i = 0; latencies && i < sessionsSize; i++) {
+            memcpy(&latencies[p], sessions[i].latencies, sessions[i].latenciesSize * sizeof(UA_DateTime));
+            p += sessions[i].latenciesSize;
+        }
+        if(latencies)
+            qsort(latencies, p, sizeof(UA_DateTime), compareDateTime);
+        printf("sessions,target_rate,seconds,requests,errors,requests_per_s,"
+               "p50_us,p99_us,p999_us,max_us,notifications_per_s\n");
+        printf("%lu,%.0f,%.1f,%lu,%lu,%.0f,%.1f,%.1f,%.1f,%.1f,%.0f\n",
+               (unsigned long)sessionsSize, rate, seconds, (unsigned long)requests,
+               (unsigned long)errors, (double)requests / duration,
+               percentileUs(latencies, p, 0.5), percentileUs(latencies, p, 0.99),
+               percentileUs(latencies, p, 0.999), percentileUs(latencies, p, 1.0),
+               (double)notifications / duration);
+        free(latencies);
+    }
+
+    for(size_t i = 0; i < connected; i++) {
+        UA_Client_disconnect(sessions[i].client);
+        UA_Client_delete(sessions[i].client);
+        free(sessions[i].latencies);
+    }
+    free(sessions);
+    if(local) {
+        localRunning = false;
+        pthread_join(serverThread, NULL);
+        UA_Server_delete(localServer);
+        nl.deleteMembers(&nl);
+    }
+    return ret;
+}
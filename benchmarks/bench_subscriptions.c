@@ -0,0 +1,257 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/**
+ * Subscription Benchmarks
+ * -----------------------
+ * Creates N sessions with M subscriptions each. Every subscription monitors the
+ * same K variables, so that the monitored items of all sessions share the
+ * samplers. The benchmark runs in rounds without a network layer. In every
+ * round, a share of the variables is written. Then the sampling groups are
+ * sampled and every subscription is published once. The responses are sent
+ * into a connection that only counts the bytes.
+ *
+ * Usage: bench_subscriptions [sessions] [subscriptions per session]
+ *                            [items per subscription] [changed percent] [rounds]
+ *
+ * The result is printed as a CSV line with the columns sessions, subscriptions,
+ * items, changed_percent, rounds, samples_per_s, notifications_per_s,
+ * publish_p50_us, publish_p90_us, publish_p99_us, publish_max_us,
+ * bytes_per_s (sent), bytes_per_item. bytes_per_item is the heap growth for
+ * the creation of the monitored items and is -1 if it cannot be measured on
+ * the platform. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+#include "ua_types.h"
+#include "ua_types_generated.h"
+#include "ua_server.h"
+#include "ua_config_standard.h"
+#include "ua_securechannel.h"
+#include "server/ua_services.h"
+#include "server/ua_subscription.h"
+#include "server/ua_server_internal.h"
+
+#define SAMPLINGINTERVAL 100.0 /* for the revised limits of the standard config */
+
+static size_t sentBytes = 0;
+
+static UA_StatusCode
+countingGetSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static void
+countingReleaseSendBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+}
+
+static UA_StatusCode
+countingSend(UA_Connection *connection, UA_ByteString *buf) {
+    sentBytes += buf->length;
+    UA_ByteString_deleteMembers(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Heap in use. -1 if the allocator cannot tell. */
+static long heapInUse(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return (long)mallinfo2().uordblks;
+#else
+    return -1;
+#endif
+}
+
+typedef struct {
+    UA_Session session;
+    UA_SecureChannel channel;
+} BenchSession;
+
+static void
+createSubscription(UA_Server *server, UA_Session *session, const UA_NodeId *variables,
+                   size_t itemsSize) {
+    UA_CreateSubscriptionRequest request;
+    UA_CreateSubscriptionRequest_init(&request);
+    request.requestedPublishingInterval = SAMPLINGINTERVAL;
+    request.requestedLifetimeCount = 10000;
+    request.requestedMaxKeepAliveCount = 10;
+    request.publishingEnabled = true;
+    UA_CreateSubscriptionResponse response;
+    UA_CreateSubscriptionResponse_init(&response);
+    Service_CreateSubscription(server, session, &request, &response);
+
+    UA_CreateMonitoredItemsRequest itemsRequest;
+    UA_CreateMonitoredItemsRequest_init(&itemsRequest);
+    itemsRequest.subscriptionId = response.subscriptionId;
+    itemsRequest.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    itemsRequest.itemsToCreate =
+        UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_MONITOREDITEMCREATEREQUEST]);
+    itemsRequest.itemsToCreateSize = itemsSize;
+    for(size_t i = 0; i < itemsSize; i++) {
+        UA_MonitoredItemCreateRequest *item = &itemsRequest.itemsToCreate[i];
+        item->itemToMonitor.nodeId = variables[i];
+        item->itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+        item->monitoringMode = UA_MONITORINGMODE_REPORTING;
+        item->requestedParameters.clientHandle = (UA_UInt32)i;
+        item->requestedParameters.samplingInterval = SAMPLINGINTERVAL;
+        item->requestedParameters.queueSize = 1;
+        item->requestedParameters.discardOldest = true;
+    }
+    UA_CreateMonitoredItemsResponse itemsResponse;
+    UA_CreateMonitoredItemsResponse_init(&itemsResponse);
+    Service_CreateMonitoredItems(server, session, &itemsRequest, &itemsResponse);
+    for(size_t i = 0; i < itemsResponse.resultsSize; i++) {
+        if(itemsResponse.results[i].statusCode != UA_STATUSCODE_GOOD) {
+            fprintf(stderr, "monitored item %lu could not be created\n", (unsigned long)i);
+            break;
+        }
+    }
+    itemsRequest.itemsToCreateSize = 0; /* the node ids are not owned */
+    UA_free(itemsRequest.itemsToCreate);
+    UA_CreateMonitoredItemsResponse_deleteMembers(&itemsResponse);
+    UA_CreateSubscriptionResponse_deleteMembers(&response);
+}
+
+static int compareDateTime(const void *a, const void *b) {
+    UA_DateTime x = *(const UA_DateTime*)a;
+    UA_DateTime y = *(const UA_DateTime*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentileUs(const UA_DateTime *sorted, size_t size, double p) {
+    if(size == 0)
+        return 0;
+    size_t i = (size_t)(p * (double)(size - 1));
+    return (double)sorted[i] / (double)UA_USEC_TO_DATETIME;
+}
+
+int main(int argc, char **argv) {
+    size_t sessionsSize = argc > 1 ? (size_t)atol(argv[1]) : 10;
+    size_t subscriptionsSize = argc > 2 ? (size_t)atol(argv[2]) : 2;
+    size_t itemsSize = argc > 3 ? (size_t)atol(argv[3]) : 100;
+    double changedPercent = argc > 4 ? atof(argv[4]) : 100.0;
+    size_t rounds = argc > 5 ? (size_t)atol(argv[5]) : 100;
+    if(sessionsSize == 0 || subscriptionsSize == 0 || itemsSize == 0 || rounds == 0) {
+        fprintf(stderr, "usage: %s [sessions] [subscriptions per session] "
+                "[items per subscription] [changed percent] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.maxNotificationsPerPublish = (UA_UInt32)itemsSize;
+    UA_Server *server = UA_Server_new(config);
+
+    /* The monitored variables */
+    UA_NodeId *variables = UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Double *values = UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_DOUBLE]);
+    for(size_t i = 0; i < itemsSize; i++) {
+        UA_VariableAttributes attr;
+        UA_VariableAttributes_init(&attr);
+        UA_Variant_setScalar(&attr.value, &values[i], &UA_TYPES[UA_TYPES_DOUBLE]);
+        variables[i] = UA_NODEID_NUMERIC(1, (UA_UInt32)(50000 + i));
+        UA_Server_addVariableNode(server, variables[i], UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "value"), UA_NODEID_NULL, attr, NULL, NULL);
+    }
+
+    /* The sessions with a channel on a counting connection */
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.state = UA_CONNECTION_ESTABLISHED;
+    connection.localConf = UA_ConnectionConfig_standard;
+    connection.remoteConf = UA_ConnectionConfig_standard;
+    connection.getSendBuffer = countingGetSendBuffer;
+    connection.releaseSendBuffer = countingReleaseSendBuffer;
+    connection.send = countingSend;
+    BenchSession *sessions = UA_malloc(sizeof(BenchSession) * sessionsSize);
+    long heapBefore = heapInUse();
+    for(size_t i = 0; i < sessionsSize; i++) {
+        UA_Session_init(&sessions[i].session);
+        UA_SecureChannel_init(&sessions[i].channel);
+        sessions[i].channel.connection = &connection;
+        sessions[i].session.channel = &sessions[i].channel;
+        for(size_t j = 0; j < subscriptionsSize; j++)
+            createSubscription(server, &sessions[i].session, variables, itemsSize);
+    }
+    long heapAfter = heapInUse();
+    size_t monitoredItems = sessionsSize * subscriptionsSize * itemsSize;
+    long bytesPerItem = -1;
+    if(heapBefore >= 0)
+        bytesPerItem = (heapAfter - heapBefore) / (long)monitoredItems;
+
+    /* Drop the initial samples */
+    UA_SamplingGroup *group;
+    LIST_FOREACH(group, &server->samplingGroups, listEntry)
+        SamplingGroupCallback(server, group);
+
+    size_t publishes = rounds * sessionsSize * subscriptionsSize;
+    UA_DateTime *latencies = UA_malloc(sizeof(UA_DateTime) * publishes);
+    size_t changedSize = (size_t)((double)itemsSize * changedPercent / 100.0);
+    if(changedSize > itemsSize)
+        changedSize = itemsSize;
+    UA_PublishRequest publishRequest;
+    UA_PublishRequest_init(&publishRequest);
+    size_t samples = 0, notifications = 0, p = 0;
+    UA_DateTime sampleTime = 0, publishTime = 0;
+    sentBytes = 0;
+    for(size_t r = 0; r < rounds; r++) {
+        /* Write the changed variables and sample them */
+        UA_DateTime start = UA_DateTime_nowMonotonic();
+        for(size_t i = 0; i < changedSize; i++) {
+            size_t k = (r * changedSize + i) % itemsSize;
+            values[k] += 1.0;
+            UA_Variant v;
+            UA_Variant_setScalar(&v, &values[k], &UA_TYPES[UA_TYPES_DOUBLE]);
+            UA_Server_writeValue(server, variables[k], v);
+        }
+        LIST_FOREACH(group, &server->samplingGroups, listEntry)
+            SamplingGroupCallback(server, group);
+        sampleTime += UA_DateTime_nowMonotonic() - start;
+
+        /* Publish every subscription with one queued publish request */
+        for(size_t i = 0; i < sessionsSize; i++) {
+            UA_Session *session = &sessions[i].session;
+            UA_Subscription *sub;
+            LIST_FOREACH(sub, &session->serverSubscriptions, listEntry) {
+                samples += sub->queuedNotifications;
+                Service_Publish(server, session, &publishRequest, 1);
+                size_t queued = sub->queuedNotifications;
+                UA_DateTime publishStart = UA_DateTime_nowMonotonic();
+                UA_Subscription_publishCallback(server, sub);
+                latencies[p] = UA_DateTime_nowMonotonic() - publishStart;
+                publishTime += latencies[p];
+                p++;
+                notifications += queued - sub->queuedNotifications;
+            }
+        }
+    }
+
+    qsort(latencies, p, sizeof(UA_DateTime), compareDateTime);
+    double sampleSeconds = (double)sampleTime / (double)UA_SEC_TO_DATETIME;
+    double publishSeconds = (double)publishTime / (double)UA_SEC_TO_DATETIME;
+    printf("sessions,subscriptions,items,changed_percent,rounds,samples_per_s,notifications_per_s,"
+           "publish_p50_us,publish_p90_us,publish_p99_us,publish_max_us,bytes_per_s,bytes_per_item\n");
+    printf("%lu,%lu,%lu,%.1f,%lu,%.0f,%.0f,%.1f,%.1f,%.1f,%.1f,%.0f,%ld\n",
+           (unsigned long)sessionsSize, (unsigned long)subscriptionsSize, (unsigned long)itemsSize,
+           changedPercent, (unsigned long)rounds,
+           sampleSeconds > 0 ? (double)samples / sampleSeconds : 0,
+           publishSeconds > 0 ? (double)notifications / publishSeconds : 0,
+           percentileUs(latencies, p, 0.5), percentileUs(latencies, p, 0.9),
+           percentileUs(latencies, p, 0.99), percentileUs(latencies, p, 1.0),
+           publishSeconds > 0 ? (double)sentBytes / publishSeconds : 0, bytesPerItem);
+
+    UA_free(latencies);
+    for(size_t i = 0; i < sessionsSize; i++)
+        UA_Session_deleteMembersCleanup(&sessions[i].session, server);
+    UA_free(sessions);
+    UA_Array_delete(variables, itemsSize, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_Array_delete(values, itemsSize, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_Server_delete(server);
+    return 0;
+}
@@ -77,9 +77,15 @@ int main(int argc, char** argv) {
     UA_ReadRequest rq;
     UA_ReadResponse rr;
 
+    /* The request is decoded into an arena, as in the server */
+    UA_Byte arenaBuf[4096];
+    UA_Arena arena;
+    UA_Arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+
     for(int i = 0; i < 1000000; i++) {
         offset = 0;
-        retval |= UA_decodeBinary(&request_msg, &offset, &rq, &UA_TYPES[UA_TYPES_READREQUEST]);
+        retval |= UA_decodeBinaryChunked(&request_msg, &offset, &rq, &UA_TYPES[UA_TYPES_READREQUEST],
+                                         NULL, NULL, 0, &arena);
 
         UA_ReadResponse_init(&rr);
         Service_Read(server, &adminSession, &rq, &rr);
@@ -87,7 +93,7 @@ int main(int argc, char** argv) {
         offset = 0;
         retval |= UA_encodeBinary(&rr, &UA_TYPES[UA_TYPES_READRESPONSE], NULL, NULL, &response_msg, &offset);
 
-        UA_ReadRequest_deleteMembers(&rq);
+        UA_Arena_deleteMembers(&arena);
         UA_ReadResponse_deleteMembers(&rr);
     }
 
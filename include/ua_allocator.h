@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2014-2016 the contributors as stated in the AUTHORS file
+ *
+ * This file is part of open62541. open62541 is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU Lesser General
+ * Public License, version 3 (as published by the Free Software Foundation) with
+ * a static linking exception as stated in the LICENSE file provided with
+ * open62541.
+ *
+ * open62541 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ */
+
+#ifndef UA_ALLOCATOR_H_
+#define UA_ALLOCATOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_config.h"
+#include <stddef.h>
+
+/**
+ * Memory Allocator
+ * ----------------
+ * The small, fixed-size objects that the stack creates and deletes most often
+ * are taken from an allocator plugin. These are the nodes, the session
+ * entries, the subscriptions with their monitored items, samplers, queues,
+ * publish requests and retransmitted messages, the secure channel entries, the
+ * entries for incomplete chunked messages and the job structures of the
+ * server. All other memory is taken from ``UA_malloc``.
+ *
+ * The allocator is set in the server configuration. It is process-wide and
+ * installed when the server is created. Every object remembers the allocator
+ * it was taken from. So objects are always returned to the right allocator,
+ * also when several servers with different allocators are created. The
+ * allocator must not be deleted before the objects taken from it.
+ *
+ * Every allocation names the subsystem it belongs to, so that allocators can
+ * account for the memory per subsystem. A slab allocator with thread-local
+ * caches is provided in the plugins folder. With UA_ENABLE_STATIC_ALLOCATOR,
+ * an allocator with static pools of a fixed size per subsystem is provided as
+ * well. */
+
+typedef enum {
+    UA_MEMCATEGORY_NODESTORE,
+    UA_MEMCATEGORY_SESSION,
+    UA_MEMCATEGORY_SUBSCRIPTION,
+    UA_MEMCATEGORY_NETWORK,
+    UA_MEMCATEGORY_JOBS
+} UA_MemCategory;
+
+#define UA_MEMCATEGORY_COUNT 5
+
+typedef struct {
+    void *context;
+
+    /* Returns memory for an object of the given size or NULL */
+    void * (*alloc)(void *context, UA_MemCategory category, size_t size);
+
+    /* Returns the object to the allocator. The size and category are the same
+     * as for the allocation. */
+    void (*free)(void *context, UA_MemCategory category, void *p, size_t size);
+} UA_Allocator;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_ALLOCATOR_H_ */
@@ -34,12 +34,12 @@ extern "C" {
  * convenience, some functionality has been wrapped in :ref:`high-level
  * abstractions <client-highlevel>`.
  *
- * **However**: At this point, the client does not yet contain its own thread or
- * event-driven main-loop. So the client will not perform any actions
- * automatically in the background. This is especially relevant for
+ * **However**: At this point, the client does not yet contain its own thread.
+ * So the client will only perform actions in the background when the user
+ * calls ``UA_Client_run_iterate``. This is especially relevant for
  * subscriptions. The user will have to periodically call
- * `UA_Client_Subscriptions_manuallySendPublishRequest`. See also :ref:`here
- * <client-subscriptions>`.
+ * `UA_Client_Subscriptions_manuallySendPublishRequest` or use the background
+ * publishing. See also :ref:`here <client-subscriptions>`.
  *
  * Client Configuration
  * -------------------- */
@@ -53,6 +53,13 @@ typedef struct UA_ClientConfig {
     UA_Logger logger;
     UA_ConnectionConfig localConnectionConfig;
     UA_ConnectClientConnection connectionFunc;
+    UA_Boolean lazyExtensionObjects; /* Keep the ExtensionObjects in responses
+                                        encoded until they are accessed with
+                                        UA_ExtensionObject_decodeContent */
+    UA_String applicationUri; /* Sent when the session is created. The
+                                 subscriptions of anonymous users are only
+                                 transferred between sessions of the same
+                                 application. Empty by default. */
 } UA_ClientConfig;
 
 /**
@@ -126,6 +133,17 @@ UA_StatusCode UA_EXPORT
 UA_Client_connect_username(UA_Client *client, const char *endpointUrl,
                            const char *username, const char *password);
 
+/* Reconnect after the connection to the server was lost. Only the connection
+ * and the SecureChannel are opened again. The existing session is activated
+ * on the new SecureChannel, so that the subscriptions and monitored items
+ * continue. If the session has timed out in the meantime, a new session is
+ * created and the subscriptions are transferred to it. The notifications that
+ * were missed during the interruption are republished.
+ *
+ * @param client to use. Must have been connected before.
+ * @return Indicates whether the operation succeeded or returns an error code */
+UA_StatusCode UA_EXPORT UA_Client_reconnect(UA_Client *client);
+
 /* Close a connection to the selected server */
 UA_StatusCode UA_EXPORT UA_Client_disconnect(UA_Client *client);
 
@@ -163,17 +181,22 @@ UA_Client_Service_write(UA_Client *client, const UA_WriteRequest request) {
 
 /**
  * Method Service Set
- * ^^^^^^^^^^^^^^^^^^ */
+ * ^^^^^^^^^^^^^^^^^^
+ * The types of the method and node management service sets are not generated
+ * if the service sets are disabled with ``UA_ENABLE_SELECTIVE_TYPES``. */
+#ifdef UA_TYPES_CALLREQUEST
 static UA_INLINE UA_CallResponse
 UA_Client_Service_call(UA_Client *client, const UA_CallRequest request) {
     UA_CallResponse response;
     __UA_Client_Service(client, &request, &UA_TYPES[UA_TYPES_CALLREQUEST],
                         &response, &UA_TYPES[UA_TYPES_CALLRESPONSE]);
     return response; }
+#endif
 
 /**
  * NodeManagement Service Set
  * ^^^^^^^^^^^^^^^^^^^^^^^^^^ */
+#ifdef UA_TYPES_ADDNODESREQUEST
 static UA_INLINE UA_AddNodesResponse
 UA_Client_Service_addNodes(UA_Client *client, const UA_AddNodesRequest request) {
     UA_AddNodesResponse response;
@@ -201,6 +224,7 @@ UA_Client_Service_deleteReferences(UA_Client *client, const UA_DeleteReferencesR
     __UA_Client_Service(client, &request, &UA_TYPES[UA_TYPES_DELETENODESREQUEST],
                         &response, &UA_TYPES[UA_TYPES_DELETENODESRESPONSE]);
     return response; }
+#endif
 
 /**
  * View Service Set
@@ -308,8 +332,119 @@ UA_Client_Service_publish(UA_Client *client, const UA_PublishRequest request) {
                         &response, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
     return response; }
 
+static UA_INLINE UA_RepublishResponse
+UA_Client_Service_republish(UA_Client *client, const UA_RepublishRequest request) {
+    UA_RepublishResponse response;
+    __UA_Client_Service(client, &request, &UA_TYPES[UA_TYPES_REPUBLISHREQUEST],
+                        &response, &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE]);
+    return response; }
+
+static UA_INLINE UA_TransferSubscriptionsResponse
+UA_Client_Service_transferSubscriptions(UA_Client *client,
+                                        const UA_TransferSubscriptionsRequest request) {
+    UA_TransferSubscriptionsResponse response;
+    __UA_Client_Service(client, &request, &UA_TYPES[UA_TYPES_TRANSFERSUBSCRIPTIONSREQUEST],
+                        &response, &UA_TYPES[UA_TYPES_TRANSFERSUBSCRIPTIONSRESPONSE]);
+    return response; }
+
 #endif
 
+/**
+ * Asynchronous Services
+ * ^^^^^^^^^^^^^^^^^^^^^
+ * The services can also be called asynchronously. The request is sent right
+ * away and the callback is registered with the requestId of the message. So
+ * many requests can be in flight on the SecureChannel. The responses are
+ * received in ``UA_Client_run_iterate`` and while a synchronous service waits
+ * for its response. They are dispatched to the callbacks by their requestId.
+ * The response is deleted when the callback returns. When the client
+ * disconnects, the callbacks of the pending requests are called with the
+ * service result ``UA_STATUSCODE_BADSHUTDOWN``. */
+typedef void
+(*UA_ClientAsyncServiceCallback)(UA_Client *client, void *userdata,
+                                 UA_UInt32 requestId, const void *response);
+
+/* Don't use this function. Use the type versions below instead. */
+UA_StatusCode UA_EXPORT
+__UA_Client_AsyncService(UA_Client *client, const void *request, const UA_DataType *requestType,
+                         UA_ClientAsyncServiceCallback callback, const UA_DataType *responseType,
+                         void *userdata, UA_UInt32 *requestId);
+
+/* Receives the responses that arrive within the timeout [ms] and dispatches
+ * them to their callbacks. Returns after the first received messages. */
+UA_StatusCode UA_EXPORT
+UA_Client_run_iterate(UA_Client *client, UA_UInt16 timeout);
+
+static UA_INLINE UA_StatusCode
+UA_Client_AsyncService_read(UA_Client *client, const UA_ReadRequest request,
+                            UA_ClientAsyncServiceCallback callback, void *userdata,
+                            UA_UInt32 *requestId) {
+    return __UA_Client_AsyncService(client, &request, &UA_TYPES[UA_TYPES_READREQUEST], callback,
+                                    &UA_TYPES[UA_TYPES_READRESPONSE], userdata, requestId); }
+
+static UA_INLINE UA_StatusCode
+UA_Client_AsyncService_write(UA_Client *client, const UA_WriteRequest request,
+                             UA_ClientAsyncServiceCallback callback, void *userdata,
+                             UA_UInt32 *requestId) {
+    return __UA_Client_AsyncService(client, &request, &UA_TYPES[UA_TYPES_WRITEREQUEST], callback,
+                                    &UA_TYPES[UA_TYPES_WRITERESPONSE], userdata, requestId); }
+
+#ifdef UA_TYPES_CALLREQUEST
+static UA_INLINE UA_StatusCode
+UA_Client_AsyncService_call(UA_Client *client, const UA_CallRequest request,
+                            UA_ClientAsyncServiceCallback callback, void *userdata,
+                            UA_UInt32 *requestId) {
+    return __UA_Client_AsyncService(client, &request, &UA_TYPES[UA_TYPES_CALLREQUEST], callback,
+                                    &UA_TYPES[UA_TYPES_CALLRESPONSE], userdata, requestId); }
+#endif
+
+static UA_INLINE UA_StatusCode
+UA_Client_AsyncService_browse(UA_Client *client, const UA_BrowseRequest request,
+                              UA_ClientAsyncServiceCallback callback, void *userdata,
+                              UA_UInt32 *requestId) {
+    return __UA_Client_AsyncService(client, &request, &UA_TYPES[UA_TYPES_BROWSEREQUEST], callback,
+                                    &UA_TYPES[UA_TYPES_BROWSERESPONSE], userdata, requestId); }
+
+/**
+ * Prepared Requests
+ * ^^^^^^^^^^^^^^^^^
+ * A request that is sent many times with the same content can be prepared.
+ * Then the request is binary encoded only once. Every send encodes the fields
+ * that change between the sends (authenticationToken, timestamp and
+ * requestHandle of the RequestHeader) and copies the prepared encoding of the
+ * remaining request behind them.
+ *
+ * The response is decoded into the structure given by the caller. Its previous
+ * content is deleted first. So the same response structure can be reused for
+ * all sends. It has to be initialized before the first use. */
+typedef struct {
+    const UA_DataType *requestType;
+    const UA_DataType *responseType;
+    UA_ByteString encoding; /* Behind the requestHandle of the RequestHeader */
+} UA_PreparedRequest;
+
+UA_StatusCode UA_EXPORT
+UA_Client_prepareRequest(const void *request, const UA_DataType *requestType,
+                         const UA_DataType *responseType, UA_PreparedRequest *prepared);
+
+void UA_EXPORT UA_PreparedRequest_deleteMembers(UA_PreparedRequest *prepared);
+
+/* Returns the service result of the response */
+UA_StatusCode UA_EXPORT
+UA_Client_sendPreparedRequest(UA_Client *client, const UA_PreparedRequest *prepared,
+                              void *response);
+
+/* Decodes the response without allocating its members one by one. The memory
+ * is taken from the given buffer (e.g. on the stack or static) and from the
+ * heap when the buffer is exhausted. Strings and ByteStrings point into the
+ * received message. The response must not be deleted. It remains valid until
+ * the next call of this function or until the client disconnects. The
+ * receive buffer of the connection is reused. So with a sufficient buffer, a
+ * polling loop makes no allocations. */
+UA_StatusCode UA_EXPORT
+UA_Client_sendPreparedRequestArena(UA_Client *client, const UA_PreparedRequest *prepared,
+                                   void *response, void *arenaBuf, size_t arenaBufSize);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
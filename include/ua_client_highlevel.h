@@ -237,12 +237,37 @@ static UA_INLINE UA_StatusCode
 UA_Client_writeUserExecutableAttribute(UA_Client *client, const UA_NodeId nodeId, const UA_Boolean *newUserExecutable) {
     return __UA_Client_writeAttribute(client, &nodeId, UA_ATTRIBUTEID_USEREXECUTABLE, newUserExecutable, &UA_TYPES[UA_TYPES_BOOLEAN]); }
 
+/**
+ * Batched Reads and Writes
+ * ========================
+ * Between ``UA_Client_beginBatch`` and ``UA_Client_flushBatch``, the typed read
+ * and write attribute functions above (except for the read of the
+ * ArrayDimensions) do not send a request. They queue the
+ * operation and return ``UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY``. The
+ * written values are copied. The output arguments of the reads have to remain
+ * valid until the flush.
+ *
+ * The flush sends every run of consecutive reads as one ReadRequest and every
+ * run of consecutive writes as one WriteRequest. So the order of the
+ * operations is kept. The results are split back to the output arguments of
+ * the reads. The status code of every operation is returned in the optional
+ * operationResults array in the order of queueing. If a request fails, the
+ * remaining operations are not sent and its service result is returned. */
+UA_StatusCode UA_EXPORT
+UA_Client_beginBatch(UA_Client *client);
+
+UA_StatusCode UA_EXPORT
+UA_Client_flushBatch(UA_Client *client, UA_StatusCode **operationResults,
+                     size_t *operationResultsSize);
+
 /**
  * Method Calling
  * ============== */
+#ifdef UA_TYPES_CALLREQUEST
 UA_StatusCode UA_EXPORT
 UA_Client_call(UA_Client *client, const UA_NodeId objectId, const UA_NodeId methodId,
                size_t inputSize, const UA_Variant *input, size_t *outputSize, UA_Variant **output);
+#endif
 
 /**
  * Node Management
@@ -250,6 +275,7 @@ UA_Client_call(UA_Client *client, const UA_NodeId objectId, const UA_NodeId meth
  *
  * See the section on :ref:`server-side node management <addnodes>`.
  */
+#ifdef UA_TYPES_ADDNODESREQUEST
 UA_StatusCode UA_EXPORT
 UA_Client_addReference(UA_Client *client, const UA_NodeId sourceNodeId, const UA_NodeId referenceTypeId,
                        UA_Boolean isForward, const UA_String targetServerUri,
@@ -350,6 +376,7 @@ UA_Client_addMethodNode(UA_Client *client, const UA_NodeId requestedNewNodeId,
                                parentNodeId, referenceTypeId, browseName, UA_NODEID_NULL,
                                (const UA_NodeAttributes*)&attr, &UA_TYPES[UA_TYPES_METHODATTRIBUTES],
                                outNewNodeId); }
+#endif
 
 /**
  * .. _client-subscriptions:
@@ -357,11 +384,19 @@ UA_Client_addMethodNode(UA_Client *client, const UA_NodeId requestedNewNodeId,
  * Subscriptions Handling
  * ======================
  *
- * At this point, the client does not yet contain its own thread or event-driven
- * main-loop. So the client will not perform any actions automatically in the
- * background. This is especially relevant for subscriptions. The user will have
- * to periodically call `UA_Client_Subscriptions_manuallySendPublishRequest`.
- * See also :ref:`here <client-subscriptions>`. */
+ * The client does not contain its own thread. The user can periodically call
+ * `UA_Client_Subscriptions_manuallySendPublishRequest`. That sends one
+ * PublishRequest after the other and blocks until the server has no more
+ * notifications.
+ *
+ * Alternatively, `UA_Client_Subscriptions_startPublishing` keeps several
+ * PublishRequests outstanding with the server. Every call to
+ * ``UA_Client_run_iterate`` sends new PublishRequests to replace the answered
+ * ones. The new requests acknowledge all notifications received so far. The
+ * notifications are handed to the monitored item handlers as the responses
+ * arrive, also while the client waits for a synchronous service. If the server
+ * rejects a request with ``BadTooManyPublishRequests``, the number of
+ * outstanding requests is reduced accordingly. */
 #ifdef UA_ENABLE_SUBSCRIPTIONS
 
 typedef struct {
@@ -384,6 +419,12 @@ UA_Client_Subscriptions_remove(UA_Client *client, UA_UInt32 subscriptionId);
 
 UA_StatusCode UA_EXPORT UA_Client_Subscriptions_manuallySendPublishRequest(UA_Client *client);
 
+UA_StatusCode UA_EXPORT
+UA_Client_Subscriptions_startPublishing(UA_Client *client, UA_UInt16 outstandingPublishRequests);
+
+/* Sends no more PublishRequests. The outstanding requests are still answered. */
+void UA_EXPORT UA_Client_Subscriptions_stopPublishing(UA_Client *client);
+
 typedef void (*UA_MonitoredItemHandlingFunction) (UA_UInt32 monId, UA_DataValue *value, void *context);
 
 UA_StatusCode UA_EXPORT
@@ -398,6 +439,91 @@ UA_Client_Subscriptions_removeMonitoredItem(UA_Client *client, UA_UInt32 subscri
 
 #endif
 
+/**
+ * Client Cache
+ * ============
+ * The client can cache browse results and attributes other than the value.
+ * Every entry is kept for the time-to-live given when the cache is enabled.
+ * Then it is browsed or read again.
+ *
+ * The cache is filled when ``UA_Client_browse`` and the attribute read
+ * functions go to the server. ``UA_Client_Cache_prefetch`` fills the cache
+ * ahead of time for many nodes with one BrowseRequest (and BrowseNext requests
+ * with all continuation points). The entries of a node are invalidated when
+ * the node is changed through the highlevel functions of this client (write
+ * attributes, add and delete nodes and references). Changes by others are
+ * seen when the entries expire, or after ``UA_Client_Cache_invalidate``. */
+
+/* Enables the cache with the time-to-live of the entries [ms]. Zero disables
+ * the cache and removes all entries. */
+UA_StatusCode UA_EXPORT
+UA_Client_Cache_enable(UA_Client *client, UA_UInt32 ttl);
+
+/* Removes all entries of the node */
+void UA_EXPORT
+UA_Client_Cache_invalidate(UA_Client *client, const UA_NodeId nodeId);
+
+void UA_EXPORT UA_Client_Cache_clear(UA_Client *client);
+
+UA_StatusCode UA_EXPORT
+UA_Client_Cache_prefetch(UA_Client *client, const UA_BrowseDescription *descriptions,
+                         size_t descriptionsSize);
+
+/* Browses a node with all references (following the continuation points).
+ * The result is taken from the cache if possible. */
+UA_StatusCode UA_EXPORT
+UA_Client_browse(UA_Client *client, const UA_BrowseDescription *description,
+                 UA_BrowseResult *result);
+
+/**
+ * Client Pool
+ * ===========
+ * A client pool opens several SecureChannels and Sessions to the same
+ * endpoint. The bulk services of the pool split the operations of a request
+ * into one request per client. The requests are sent at the same time and
+ * are in flight on all connections. So the server can process them in
+ * parallel. The results are merged into one response in the order of the
+ * operations. If a partial request fails, the service result of the merged
+ * response is set to its error. */
+typedef struct UA_ClientPool UA_ClientPool;
+
+UA_ClientPool UA_EXPORT *
+UA_ClientPool_new(UA_ClientConfig config, size_t clientsSize);
+
+void UA_EXPORT UA_ClientPool_delete(UA_ClientPool *pool);
+
+/* Connects all clients. Returns the first error. */
+UA_StatusCode UA_EXPORT
+UA_ClientPool_connect(UA_ClientPool *pool, const char *endpointUrl);
+
+void UA_EXPORT UA_ClientPool_disconnect(UA_ClientPool *pool);
+
+size_t UA_EXPORT UA_ClientPool_size(const UA_ClientPool *pool);
+
+/* The clients can be used individually between the bulk services */
+UA_Client UA_EXPORT *
+UA_ClientPool_getClient(UA_ClientPool *pool, size_t index);
+
+UA_ReadResponse UA_EXPORT
+UA_ClientPool_read(UA_ClientPool *pool, const UA_ReadRequest *request);
+
+UA_WriteResponse UA_EXPORT
+UA_ClientPool_write(UA_ClientPool *pool, const UA_WriteRequest *request);
+
+/* The continuation points of the browse results belong to the session of one
+ * client in the pool. They are continued with UA_ClientPool_browseNext, which
+ * sends every continuation point to the client it belongs to. */
+UA_BrowseResponse UA_EXPORT
+UA_ClientPool_browse(UA_ClientPool *pool, const UA_BrowseRequest *request);
+
+UA_BrowseNextResponse UA_EXPORT
+UA_ClientPool_browseNext(UA_ClientPool *pool, const UA_BrowseNextRequest *request);
+
+#ifdef UA_TYPES_CALLREQUEST
+UA_CallResponse UA_EXPORT
+UA_ClientPool_call(UA_ClientPool *pool, const UA_CallRequest *request);
+#endif
+
 /**
  * Misc Highlevel Functionality
  * ============================ */
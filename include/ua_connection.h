@@ -50,6 +50,15 @@ typedef struct UA_ConnectionConfig {
     UA_UInt32 recvBufferSize;
     UA_UInt32 maxMessageSize;
     UA_UInt32 maxChunkCount;
+    UA_UInt32 maxSendQueueSize; /* Bytes that may be queued for a slow receiver
+                                   before the connection is dropped. 0 is
+                                   unlimited. Not negotiated with the peer. */
+    UA_UInt32 maxChunkedRequests; /* Requests of a channel whose chunks are
+                                     reassembled at the same time. 0 is
+                                     unlimited. Not negotiated with the peer. */
+    UA_UInt32 maxChunkMemory; /* Bytes of a channel reserved for the
+                                 reassembly. 0 is unlimited. Not negotiated
+                                 with the peer. */
 } UA_ConnectionConfig;
 
 extern const UA_EXPORT UA_ConnectionConfig UA_ConnectionConfig_standard;
@@ -78,6 +87,8 @@ struct UA_Connection {
     void *handle;                    /* A pointer to the networklayer */
     UA_ByteString incompleteMessage; /* A half-received message (TCP is a
                                         streaming protocol) is stored here */
+    struct UA_RecvRing *recvRing;    /* Optional receive ring of the
+                                        connection (see below) */
 
     /* Get a buffer for sending */
     UA_StatusCode (*getSendBuffer)(UA_Connection *connection, size_t length,
@@ -94,6 +105,16 @@ struct UA_Connection {
      * @return Returns an error code or UA_STATUSCODE_GOOD. */
     UA_StatusCode (*send)(UA_Connection *connection, UA_ByteString *buf);
 
+    /* Sends several buffers (e.g. the chunks of a message) with as few system
+     * calls as possible. The buffers are always freed, even if sending fails.
+     * Optional, may be NULL.
+     *
+     * @param connection The connection
+     * @param bufs The message buffers
+     * @param bufsSize The number of buffers
+     * @return Returns an error code or UA_STATUSCODE_GOOD. */
+    UA_StatusCode (*sendBatch)(UA_Connection *connection, UA_ByteString *bufs, size_t bufsSize);
+
     /* Receive a message from the remote connection
      *
      * @param connection The connection
@@ -101,9 +122,10 @@ struct UA_Connection {
      *        and needs to be freed with connection->releaseBuffer
      * @param timeout Timeout of the recv operation in milliseconds
      * @return Returns UA_STATUSCODE_BADCOMMUNICATIONERROR if the recv operation
-     *         can be repeated, UA_STATUSCODE_GOOD if it succeeded and
-     *         UA_STATUSCODE_BADCONNECTIONCLOSED if the connection was
-     *         closed. */
+     *         can be repeated, UA_STATUSCODE_GOOD if it succeeded,
+     *         UA_STATUSCODE_GOODNONCRITICALTIMEOUT if nothing was received
+     *         within the timeout and UA_STATUSCODE_BADCONNECTIONCLOSED if the
+     *         connection was closed. */
     UA_StatusCode (*recv)(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeout);
 
     /* Release the buffer of a received message */
@@ -116,6 +138,37 @@ struct UA_Connection {
 void UA_EXPORT UA_Connection_init(UA_Connection *connection);
 void UA_EXPORT UA_Connection_deleteMembers(UA_Connection *connection);
 
+/**
+ * Receive Ring
+ * ------------
+ * A network layer can receive directly into a ring buffer of the connection
+ * instead of a buffer of its own. The received bytes are appended behind the
+ * incomplete message in the ring. The complete messages are then handed out as
+ * views into the ring, and the incomplete rest stays in place for the next
+ * receive. Only when the incomplete message reaches the end of the ring is it
+ * copied to the beginning. The views are released in the releaseRecvBuffer
+ * callback of the connection with UA_Connection_releaseRecvRing. */
+
+/* Returns the free space behind the received data of the ring. The space holds
+ * at least localConf.recvBufferSize bytes. The network layer receives into the
+ * space and hands out the received bytes with the data pointer unchanged. The
+ * ring is allocated with the first call.
+ *
+ * @param connection The connection
+ * @param space The free space of the ring is returned here
+ * @return Returns UA_STATUSCODE_GOOD or UA_STATUSCODE_BADOUTOFMEMORY */
+UA_StatusCode UA_EXPORT
+UA_Connection_getRecvSpace(UA_Connection *connection, UA_ByteString *space);
+
+/* Releases a received message if it is a view into the receive ring. The
+ * buffer is reset to an empty ByteString then.
+ *
+ * @param connection The connection
+ * @param buf The received message
+ * @return Returns true if the buffer was part of the receive ring */
+UA_Boolean UA_EXPORT
+UA_Connection_releaseRecvRing(UA_Connection *connection, UA_ByteString *buf);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2014-2016 the contributors as stated in the AUTHORS file
+ *
+ * This file is part of open62541. open62541 is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU Lesser General
+ * Public License, version 3 (as published by the Free Software Foundation) with
+ * a static linking exception as stated in the LICENSE file provided with
+ * open62541.
+ *
+ * open62541 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ */
+
+#ifndef UA_CRYPTO_H_
+#define UA_CRYPTO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_types.h"
+
+/**
+ * Symmetric Crypto
+ * ----------------
+ * A SecureChannel in the security mode Sign or SignAndEncrypt protects every
+ * chunk with the symmetric algorithms of its security policy. The crypto
+ * backend is a plugin. It holds the keys of one channel in its context, so
+ * that hardware acceleration (AES-NI, ARMv8 crypto extensions, offloading) can
+ * be used where available.
+ *
+ * The chunks are protected in place. The send buffers of the connection leave
+ * room for the padding and the signature behind the content. Before a chunk is
+ * sent, the padding is appended, the chunk is signed from the message header
+ * up to the padding and the signature is written behind it. With encryption,
+ * everything behind the security header is then encrypted in the same buffer.
+ * Received chunks are decrypted and verified in the receive buffer. No copies
+ * of the chunk are made.
+ *
+ * The encrypt and decrypt callbacks work on whole blocks. The signature is
+ * computed with the sending keys and verified with the receiving keys. */
+
+typedef struct {
+    void *context;
+    size_t blockSize; /* of the cipher. 1 if the chunks are not encrypted. */
+    size_t signatureSize;
+
+    /* Writes the signature of the data to signature */
+    UA_StatusCode (*sign)(void *context, const UA_Byte *data, size_t length,
+                          UA_Byte *signature);
+    UA_StatusCode (*verify)(void *context, const UA_Byte *data, size_t length,
+                            const UA_Byte *signature);
+
+    /* The length is a multiple of the block size. Can be NULL for the
+     * security mode Sign. */
+    UA_StatusCode (*encrypt)(void *context, UA_Byte *data, size_t length);
+    UA_StatusCode (*decrypt)(void *context, UA_Byte *data, size_t length);
+
+    void (*deleteMembers)(void *context);
+} UA_SymmetricCrypto;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_CRYPTO_H_ */
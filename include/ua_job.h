@@ -27,6 +27,15 @@ typedef struct UA_Server UA_Server;
 
 typedef void (*UA_ServerCallback)(UA_Server *server, void *data);
 
+/** With multithreading, jobs of every priority are dispatched to a separate
+    lane. Workers prefer realtime jobs but reserve a share for the normal lane
+    (see realtimeJobsWeight in the server config). */
+typedef enum {
+    UA_JOBPRIORITY_NORMAL = 0, ///< Service requests and everything else
+    UA_JOBPRIORITY_REALTIME = 1, ///< Sampling, publishing and keepalives
+} UA_JobPriority;
+#define UA_JOBPRIORITY_COUNT 2
+
 /** Jobs describe work that is executed once or repeatedly in the server */
 typedef struct {
     enum {
@@ -48,6 +57,7 @@ typedef struct {
             UA_ServerCallback method;
         } methodCall;
     } job;
+    UA_JobPriority priority;
 } UA_Job;
 
 #ifdef __cplusplus
@@ -27,7 +27,8 @@ extern "C" {
  * -------
  * Servers and clients may contain a logger. Every logger needs to implement the
  * `UA_Logger` signature. An example logger that writes to stdout is provided in
- * the plugins folder.
+ * the plugins folder. The asynchronous logger in the plugins folder
+ * (UA_ENABLE_LOG_ASYNC) moves the writing to a background thread.
  *
  * Every log-message consists of a log-level, a log-category and a string
  * message content. The timestamp of the log-message is created within the
@@ -57,7 +58,9 @@ typedef enum {
  * formatted according to the rules of the printf command.
  *
  * Do not use the logger directly but make use of the following macros that take
- * the minimum log-level defined in ua_config.h into account. */
+ * the minimum log-level defined in ua_config.h into account. Messages below
+ * UA_LOGLEVEL are removed at compile time, including the evaluation of their
+ * arguments. UA_LOGLEVEL 700 removes all messages. */
 typedef void (*UA_Logger)(UA_LogLevel level, UA_LogCategory category, const char *msg, ...);
 
 /**
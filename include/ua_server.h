@@ -25,6 +25,7 @@ extern "C" {
 #include "ua_types_generated.h"
 #include "ua_nodeids.h"
 #include "ua_log.h"
+#include "ua_allocator.h"
 #include "ua_job.h"
 #include "ua_connection.h"
 
@@ -36,7 +37,20 @@ extern "C" {
  * -------------
  * Interface to the binary network layers. The functions in the network layer
  * are never called in parallel but only sequentially from the server's main
- * loop. So the network layer does not need to be thread-safe. */
+ * loop. So the network layer does not need to be thread-safe.
+ *
+ * The job arrays returned from ``getJobs`` and ``stop`` are owned by the
+ * network layer. The server does not free them. An array stays valid until
+ * the next call to ``getJobs`` or ``stop``, and the array from ``stop`` until
+ * ``deleteMembers``. So a network layer can reuse one buffer for the jobs.
+ *
+ * Version 2 of the interface changed this contract. Up to version 1, the
+ * server freed the returned arrays with ``UA_free``. Network layers that still
+ * allocate a new array per call must free it themselves now. Version 2 also
+ * widened the timeout of ``getJobs`` from ``UA_UInt16`` to ``UA_UInt32`` and
+ * added ``flush``. */
+#define UA_SERVERNETWORKLAYER_VERSION 2
+
 struct UA_ServerNetworkLayer;
 typedef struct UA_ServerNetworkLayer UA_ServerNetworkLayer;
 
@@ -56,17 +70,26 @@ struct UA_ServerNetworkLayer {
      *
      * @param nl The network layer
      * @param jobs When the returned integer is >0, *jobs points to an array of UA_Job of the
-     *             returned size.
+     *             returned size. The array is owned by the network layer.
      * @param timeout The timeout during which an event must arrive in microseconds
      * @return The size of the jobs array. If the result is negative, an error has occurred. */
-    size_t (*getJobs)(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout);
+    size_t (*getJobs)(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt32 timeout);
+
+    /* Sends the messages the network layer has held back while the jobs from
+     * getJobs were processed. Gets called after the jobs are finished by the
+     * thread that processed them, i.e. the main server loop without
+     * multithreading or the reactor thread of the network layer. Optional, may
+     * be NULL.
+     *
+     * @param nl The network layer */
+    void (*flush)(UA_ServerNetworkLayer *nl);
 
     /* Closes the network connection and returns all the jobs that need to be
      * finished before the network layer can be safely deleted.
      *
      * @param nl The network layer
      * @param jobs When the returned integer is >0, jobs points to an array of UA_Job of the
-     *             returned size.
+     *             returned size. The array is owned by the network layer.
      * @return The size of the jobs array. If the result is negative, an error has occurred. */
     size_t (*stop)(UA_ServerNetworkLayer *nl, UA_Job **jobs);
 
@@ -95,8 +118,37 @@ typedef struct {
 
 typedef struct {
     UA_UInt16 nThreads; /* only if multithreading is enabled */
+    UA_Boolean connectionAffinity; /* only if multithreading is enabled. Process
+                                      all messages of a connection in the same
+                                      worker thread, in the order of arrival. */
+    UA_UInt16 realtimeJobsWeight; /* only if multithreading is enabled. Number of
+                                     realtime job batches a worker processes
+                                     before it takes a waiting normal batch. */
+    UA_Boolean networkReactors; /* only if multithreading is enabled. Every
+                                   network layer gets a reactor thread that
+                                   receives, processes and answers the messages
+                                   of its connections. The workers process
+                                   only the repeated and dispatched jobs. Use
+                                   several network layers that share a port
+                                   (e.g. UA_ServerNetworkLayerTCPReusePort) to
+                                   spread the connections over the reactors. */
+
+    /* Pin the threads to CPUs (Linux only). Bit i of a mask selects CPU i.
+     * Threads with an empty mask are not pinned. Worker i uses the mask
+     * workerCpuMasks[i % workerCpuMasksSize]. The reactor threads follow the
+     * workers, reactor i uses workerCpuMasks[(nThreads + i) %
+     * workerCpuMasksSize]. Memory is allocated on the NUMA
+     * node of the first thread that touches it. So the nodes added by a pinned
+     * worker end up close to that worker. */
+    UA_UInt64 mainLoopCpuMask;
+    size_t workerCpuMasksSize; /* only if multithreading is enabled */
+    UA_UInt64 *workerCpuMasks;
     UA_Logger logger;
 
+    /* The allocator for the small objects of the stack. NULL uses UA_malloc.
+     * See the section on the memory allocator. */
+    const UA_Allocator *allocator;
+
     /* Server Description */
     UA_BuildInfo buildInfo;
     UA_ApplicationDescription applicationDescription;
@@ -119,16 +171,43 @@ typedef struct {
     /* Limits for Sessions */
     UA_UInt16 maxSessions;
     UA_Double maxSessionTimeout; /* in ms */
+    UA_UInt16 maxBrowseContinuationPoints; /* per session, 0 -> unlimited */
+    size_t maxSessionMemory; /* bytes, 0 is unlimited (see UA_SessionMemory) */
+
+    /* Limits for the requests of a Session. Requests beyond the limits are
+     * answered with BadTcpServerTooBusy before the service is called. Publish
+     * and Republish requests are not limited here. */
+    UA_UInt32 maxSessionRequestRate; /* per second, 0 is unlimited */
+    UA_UInt32 maxSessionRequestBurst; /* requests beyond the rate that are
+                                         accepted after a quiet period */
+    UA_UInt32 operationsPerRequest; /* a request with n operations counts as
+                                       1 + n / operationsPerRequest requests
+                                       (at most a full burst). 0 counts every
+                                       request once. */
+    UA_UInt32 maxSessionInflightRequests; /* requests waiting for asynchronous
+                                             reads, 0 is unlimited */
 
     /* Limits for Subscriptions */
     UA_DoubleRange publishingIntervalLimits;
     UA_UInt32Range lifeTimeCountLimits;
     UA_UInt32Range keepAliveCountLimits;
     UA_UInt32 maxNotificationsPerPublish;
+    UA_UInt32 maxRetransmissionQueueSize; /* per subscription */
+    UA_UInt32 maxSessionRetransmissionQueueSize; /* over all subscriptions of a session */
+    size_t maxSubscriptionMemory; /* bytes, 0 is unlimited */
 
     /* Limits for MonitoredItems */
-    UA_DoubleRange samplingIntervalLimits;
+    UA_DoubleRange samplingIntervalLimits; /* ms, the sampling is scheduled
+                                              with microsecond resolution down
+                                              to 0.05ms */
     UA_UInt32Range queueSizeLimits;
+
+    /* History of the variables with the Historizing attribute set (only with
+     * UA_ENABLE_HISTORIZING) */
+    size_t maxHistoryBytesPerNode; /* the oldest values are dropped beyond
+                                      the limit, 0 is unlimited */
+    UA_UInt32 historySamplingInterval; /* ms, variables with a data source
+                                          are sampled. 0 disables sampling. */
 } UA_ServerConfig;
 
 /**
@@ -177,6 +256,12 @@ UA_StatusCode UA_EXPORT UA_Server_run_shutdown(UA_Server *server);
 UA_StatusCode UA_EXPORT UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
                                                  UA_UInt32 interval, UA_Guid *jobId);
 
+/* Add a job for cyclic repetition with an interval in microseconds. The
+ * interval must be at least 50us. The main loop waits for the network with a
+ * timeout of the same resolution. */
+UA_StatusCode UA_EXPORT UA_Server_addRepeatedJobUsec(UA_Server *server, UA_Job job,
+                                                     UA_UInt64 interval, UA_Guid *jobId);
+
 /* Remove repeated job. The entry will be removed asynchronously during the next
  * iteration of the server main loop.
  *
@@ -185,9 +270,263 @@ UA_StatusCode UA_EXPORT UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
  * @return Upon sucess, UA_STATUSCODE_GOOD is returned. An error code otherwise. */
 UA_StatusCode UA_EXPORT UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId);
 
+/* With multithreading, replaced nodes are freed once the jobs that may still
+ * access them have finished. This covers the main loop, the worker and the
+ * reactor threads. Other threads of the application that call the server API
+ * (e.g. UA_Server_read) need to enclose the calls between
+ * UA_Server_beginAccess and UA_Server_endAccess. Pointers into the nodes
+ * remain valid until the matching end. The calls nest. Keep the section short,
+ * it holds back the reclamation for the entire server. Without multithreading,
+ * and in the server threads, the calls do nothing. */
+void UA_EXPORT UA_Server_beginAccess(UA_Server *server);
+void UA_EXPORT UA_Server_endAccess(UA_Server *server);
+
+/**
+ * Scheduler Statistics
+ * --------------------
+ * With UA_ENABLE_SCHEDULER_STATISTICS, the main loop and every worker thread
+ * record how long the jobs wait and run. The counters are written without
+ * locks by their own thread only. So a reader sees a consistent snapshot only
+ * approximately. The histograms have logarithmic buckets: bucket 0 counts the
+ * durations below 1 microsecond, bucket i those in [2^(i-1), 2^i) microseconds
+ * and the last bucket all longer durations. */
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+#define UA_JOBSTATISTICS_BUCKETS 20
+#define UA_JOBSTATISTICS_TYPES (UA_JOBTYPE_METHODCALL_DELAYED + 1)
+
+typedef struct {
+    UA_UInt64 jobsCount[UA_JOBSTATISTICS_TYPES]; /* indexed by the job type */
+    UA_UInt64 runTime[UA_JOBSTATISTICS_TYPES]; /* summed up [100ns] */
+    UA_UInt64 runTimeHistogram[UA_JOBSTATISTICS_BUCKETS];
+    UA_UInt64 waitTimeHistogram[UA_JOBSTATISTICS_BUCKETS]; /* from the dispatch
+                                                              in the main loop
+                                                              until a worker
+                                                              starts the job */
+    UA_UInt64 busyTime; /* [100ns] */
+    UA_UInt64 idleTime; /* [100ns], waiting for work (workers only) */
+} UA_JobStatistics;
+
+typedef struct {
+    UA_UInt64 iterations; /* of the main loop */
+    UA_UInt64 iterationTime; /* summed up [100ns], without waiting on the network */
+    UA_UInt64 maxIterationTime; /* [100ns] */
+    UA_UInt64 overruns; /* iterations that took longer than the max. timeout */
+    UA_UInt64 queueDepth; /* batches dispatched but not yet taken by a worker */
+    UA_JobStatistics mainLoop; /* jobs executed in the main loop */
+} UA_SchedulerStatistics;
+
+UA_StatusCode UA_EXPORT
+UA_Server_getSchedulerStatistics(UA_Server *server, UA_SchedulerStatistics *stats);
+
+/* Returns the statistics of the worker thread with the given index (only for
+ * a running server with multithreading). The reactor threads follow the
+ * workers at the indices from nThreads. */
+UA_StatusCode UA_EXPORT
+UA_Server_getWorkerStatistics(UA_Server *server, size_t workerIndex, UA_JobStatistics *stats);
+#endif
+
+/**
+ * Service Statistics
+ * ------------------
+ * With UA_ENABLE_SERVICE_STATISTICS, the server counts the requests of every
+ * service it receives over the network. The time to handle a request is split
+ * into decoding the request, executing the service and encoding and sending
+ * the response. Responses that are not sent right after the service (Publish
+ * and asynchronous reads) and reads that are encoded straight from the nodes
+ * count their encoding as execution time and their response size is not
+ * counted. The statistics are also exposed as UInt64 array variables in the
+ * ``ServiceStatistics`` object of the ServerDiagnostics. Every variable has the
+ * name of the service and holds the members of the structure below in order.
+ * The counters are not reset. */
+typedef struct {
+    UA_UInt64 requests;
+    UA_UInt64 errors; /* responses with a bad service result */
+    UA_UInt64 decodeTime; /* summed up [100ns] */
+    UA_UInt64 executeTime; /* summed up [100ns] */
+    UA_UInt64 encodeTime; /* summed up [100ns] */
+    UA_UInt64 bytesIn; /* of the encoded requests */
+    UA_UInt64 bytesOut; /* of the encoded responses */
+} UA_ServiceStatistics;
+
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+/* Returns the statistics of the service with the given request type, e.g.
+ * &UA_TYPES[UA_TYPES_READREQUEST] */
+UA_StatusCode UA_EXPORT
+UA_Server_getServiceStatistics(UA_Server *server, const UA_DataType *requestType,
+                               UA_ServiceStatistics *stats);
+#endif
+
+/**
+ * Node Statistics
+ * ---------------
+ * With UA_ENABLE_NODE_STATISTICS, the server counts how often every node is
+ * accessed. Reads count every attribute read from the node, also the samples of
+ * the monitored items and local reads. Writes count the attribute writes of
+ * existing nodes. Monitored items count how often an item was attached to the
+ * node, also when the item is modified. Browses count the nodes the browse
+ * starts from. The counters of a node are created with its first access and
+ * removed when the node is deleted.
+ *
+ * Nodes with many reads and no monitored items are polled by the clients.
+ * Their values are better sent in a subscription. */
+typedef struct {
+    UA_NodeId nodeId;
+    UA_UInt64 reads;
+    UA_UInt64 writes;
+    UA_UInt64 monitoredItems;
+    UA_UInt64 browses;
+} UA_NodeStatistics;
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+/* Returns the statistics of up to maxNodes nodes with the most accesses in
+ * total, the most accessed node first. Delete the array with
+ * UA_NodeStatistics_deleteArray. */
+UA_StatusCode UA_EXPORT
+UA_Server_getHottestNodes(UA_Server *server, size_t maxNodes,
+                          UA_NodeStatistics **stats, size_t *statsSize);
+
+void UA_EXPORT
+UA_NodeStatistics_deleteArray(UA_NodeStatistics *stats, size_t statsSize);
+#endif
+
+/**
+ * Session Memory
+ * --------------
+ * The server accounts for the memory that every session holds in bytes. The
+ * subscriptions, monitored items, queued samples, retransmission queues and
+ * continuation points of a session count against ``maxSessionMemory``. The
+ * subscription alone with its items, samples and retransmissions counts against
+ * ``maxSubscriptionMemory``. When a quota is reached, new subscriptions,
+ * monitored items and continuation points are rejected and larger queues are
+ * not granted. A new sample replaces the oldest sample of its monitored item,
+ * and a new notification message replaces the oldest retransmission of the
+ * session. The incomplete chunked requests belong to the SecureChannel of the
+ * session. They are reported, but they are limited only by the message size
+ * and chunk count of the connection. The sums over all sessions are also
+ * exposed as a UInt64 array variable ``SessionMemory`` in the
+ * ServerDiagnostics that holds the members of the structure below in order. */
+typedef struct {
+    size_t subscriptions; /* with their monitored items and sample rings */
+    size_t samples; /* queued in the monitored items */
+    size_t retransmissions; /* sent notification messages kept for Republish */
+    size_t continuationPoints;
+    size_t chunks; /* incomplete requests on the SecureChannel */
+    size_t discarded; /* items, samples and messages rejected or dropped for
+                         the quota */
+} UA_SessionMemory;
+
+/* Returns the memory of the session with the given id. The sum over all
+ * sessions is returned if the id is NULL. */
+UA_StatusCode UA_EXPORT
+UA_Server_getSessionMemory(UA_Server *server, const UA_NodeId *sessionId,
+                           UA_SessionMemory *memory);
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+/* Returns the bytes held by a subscription of the session with the given id */
+UA_StatusCode UA_EXPORT
+UA_Server_getSubscriptionMemory(UA_Server *server, const UA_NodeId *sessionId,
+                                UA_UInt32 subscriptionId, size_t *memory);
+#endif
+
 /* Add a new namespace to the server. Returns the index of the new namespace */
 UA_UInt16 UA_EXPORT UA_Server_addNamespace(UA_Server *server, const char* name);
 
+/**
+ * Nodestore Snapshots
+ * ^^^^^^^^^^^^^^^^^^^
+ * A populated information model can be saved into a binary snapshot and
+ * restored when the server is started the next time. Restoring inserts the
+ * nodes directly into the nodestore. The checks of the AddNodes service are
+ * not repeated and the references are restored as they were saved. So a
+ * snapshot is only as consistent as the server it was taken from. Nodes of
+ * the snapshot replace the nodes of the server with the same NodeId. The
+ * namespaces of the snapshot are added to the server. The namespaces that
+ * exist already must be the same as in the snapshot.
+ *
+ * Callbacks are not saved. That are data sources, value callbacks, method
+ * callbacks, lifecycle management and instance handles. Replaced nodes pass
+ * their callbacks on to the restored nodes. So the data sources of namespace
+ * zero remain intact. For all other nodes, the callbacks have to be set again
+ * after restoring. Variables that had a data source are restored with an empty
+ * value.
+ *
+ * The snapshot is decoded from the buffer without copying it first. So it can
+ * point to a memory-mapped file. The snapshot should be restored before the
+ * server is started. If restoring fails, the nodes up to the error remain in
+ * the nodestore. */
+
+/* Saves all nodes of the server. The snapshot is allocated and must be
+ * deleted with UA_ByteString_deleteMembers. */
+UA_StatusCode UA_EXPORT
+UA_Server_saveSnapshot(UA_Server *server, UA_ByteString *snapshot);
+
+UA_StatusCode UA_EXPORT
+UA_Server_loadSnapshot(UA_Server *server, const UA_ByteString *snapshot);
+
+/**
+ * Value Publishers
+ * ^^^^^^^^^^^^^^^^
+ * A value publisher reads a fixed set of variables in a repeated job and
+ * encodes their values into a single message. The message is handed to a
+ * transport, for example a UDP multicast group (see ua_network_udp.h). So any
+ * number of receivers get the values for the cost of one read and one send per
+ * cycle, without sessions and subscriptions. The values are read with the
+ * rights of the server. Receivers are not authenticated.
+ *
+ * The message is encoded in the binary encoding. It contains the publisher id
+ * (UInt32), a sequence number (UInt32) that is incremented with every message,
+ * the publish time (DateTime) and an array of DataValues in the order of the
+ * configured nodes. If the values do not fit into maxMessageSize, the cycle is
+ * skipped with a warning. */
+typedef struct {
+    void *handle;
+    UA_StatusCode (*send)(void *handle, const UA_ByteString *message);
+    void (*deleteMembers)(void *handle); /* can be NULL */
+    size_t maxMessageSize;
+} UA_ValuePublisherTransport;
+
+/* The publisher takes ownership of the transport, also when adding fails. The
+ * interval is given in milliseconds. */
+UA_StatusCode UA_EXPORT
+UA_Server_addValuePublisher(UA_Server *server, UA_UInt32 publisherId,
+                            const UA_NodeId *nodes, size_t nodesSize,
+                            UA_UInt32 interval, UA_TimestampsToReturn timestamps,
+                            UA_ValuePublisherTransport transport, UA_Guid *publisherGuid);
+
+UA_StatusCode UA_EXPORT
+UA_Server_removeValuePublisher(UA_Server *server, const UA_Guid publisherGuid);
+
+typedef struct {
+    UA_UInt32 publisherId;
+    UA_UInt32 sequenceNumber;
+    UA_DateTime publishTime;
+    size_t valuesSize;
+    UA_DataValue *values;
+} UA_ValuePublisherMessage;
+
+/* Decodes a message on the receiving side. The values are allocated and have
+ * to be deleted with UA_ValuePublisherMessage_deleteMembers. */
+UA_StatusCode UA_EXPORT
+UA_ValuePublisherMessage_decode(const UA_ByteString *message, UA_ValuePublisherMessage *msg);
+
+void UA_EXPORT UA_ValuePublisherMessage_deleteMembers(UA_ValuePublisherMessage *msg);
+
+/**
+ * Static Nodes
+ * ^^^^^^^^^^^^
+ * The nodeset compiler generates tables of constant nodes with the option
+ * ``--static``. The nodes are used from the table without a copy on the heap.
+ * So they can be placed in read-only memory and adding them does not parse or
+ * allocate anything. Only when a static node is changed or deleted, the
+ * nodestore keeps the new version on the heap. Nodes of the server that are
+ * referenced by the static nodes receive the inverse references. The table
+ * must not be deleted before the server and can be added to one server at a
+ * time. */
+typedef struct UA_StaticNodeTable UA_StaticNodeTable;
+
+UA_StatusCode UA_EXPORT
+UA_Server_addStaticNodes(UA_Server *server, const UA_StaticNodeTable *table);
+
 /**
  * Reading / Writing Node Attributes
  * ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -204,7 +543,10 @@ UA_UInt16 UA_EXPORT UA_Server_addNamespace(UA_Server *server, const char* name);
  *
  * - UserWriteMask
  * - UserAccessLevel
- * - UserExecutable */
+ * - UserExecutable
+ *
+ * The returned attributes are private copies owned by the caller. This includes
+ * values that the server shares between the node and its readers. */
 /* Don't use this function. There are typed versions for every supported attribute. */
 UA_StatusCode UA_EXPORT
 __UA_Server_read(UA_Server *server, const UA_NodeId *nodeId,
@@ -309,6 +651,26 @@ UA_Server_readExecutable(UA_Server *server, const UA_NodeId nodeId,
                          UA_Boolean *outExecutable) {
     return __UA_Server_read(server, &nodeId, UA_ATTRIBUTEID_EXECUTABLE, outExecutable); }
 
+/* Reads the value of a variable without copying it. The callback gets the
+ * value in place and is called before the function returns. The value must
+ * not be changed and not be used after the callback returns. Do not write to
+ * the node from within the callback.
+ *
+ * With multithreading, the call is enclosed in UA_Server_beginAccess and
+ * UA_Server_endAccess. So it can be used from any thread. The callback holds
+ * back the reclamation of replaced nodes for the entire server and should
+ * return quickly.
+ *
+ * Values bound to memory are copied to the stack first if they are small.
+ * Values of data sources cannot be borrowed. They are read into a temporary
+ * value that is deleted after the callback. */
+typedef void (*UA_BorrowedValueCallback)(void *context, const UA_NodeId *nodeId,
+                                         const UA_Variant *value);
+
+UA_StatusCode UA_EXPORT
+UA_Server_readValueBorrowed(UA_Server *server, const UA_NodeId nodeId,
+                            UA_BorrowedValueCallback callback, void *context);
+
 /**
  * Writing Node Attributes
  * ~~~~~~~~~~~~~~~~~~~~~~~
@@ -407,6 +769,15 @@ UA_Server_writeExecutable(UA_Server *server, const UA_NodeId nodeId,
     return __UA_Server_write(server, &nodeId, UA_ATTRIBUTEID_EXECUTABLE,
                              &UA_TYPES[UA_TYPES_BOOLEAN], &executable); }
 
+/* Writes the values of many variables in one call. The values are swapped in
+ * the nodes in place. The monitored items on the written values are notified
+ * once for the whole batch. The result of every write is stored in the results
+ * array of the same size. Returns UA_STATUSCODE_BADNOTHINGTODO for an empty
+ * batch and UA_STATUSCODE_GOOD otherwise. */
+UA_StatusCode UA_EXPORT
+UA_Server_writeValues(UA_Server *server, size_t size, const UA_NodeId *nodeIds,
+                      const UA_Variant *values, UA_StatusCode *results);
+
 /**
  * Browsing
  * -------- */
@@ -466,7 +837,19 @@ UA_Server_call(UA_Server *server, const UA_CallMethodRequest *request);
  * that contains the value content and additional timestamps.
  *
  * It is expected that the read callback is implemented. The write callback can
- * be set to a null-pointer. */
+ * be set to a null-pointer.
+ *
+ * Data sources that talk to slow backends can additionally implement the
+ * readAsync callback. It starts the read and returns right away. The value is
+ * handed to the server later with ``UA_Server_completeAsyncRead``. Meanwhile,
+ * the server goes on to process other requests. Read requests and the sampling
+ * of monitored items use readAsync if it is set. A ReadResponse is sent when
+ * the last pending read of the request has completed. The blocking read
+ * callback is still used where the value is needed immediately (e.g. in
+ * ``UA_Server_read``). */
+struct UA_AsyncRead;
+typedef struct UA_AsyncRead UA_AsyncRead;
+
 typedef struct {
     void *handle; /* A custom pointer to reuse the same datasource functions for
                      multiple sources */
@@ -502,8 +885,51 @@ typedef struct {
      */
     UA_StatusCode (*write)(void *handle, const UA_NodeId nodeid,
                            const UA_Variant *data, const UA_NumericRange *range);
+
+    /* Starts reading from the data source. Can be a null-pointer.
+     *
+     * @param handle An optional pointer to user-defined data for the specific data source
+     * @param nodeid Id of the read node
+     * @param includeSourceTimeStamp If true, then the datasource is expected to set the source
+     *        timestamp in the completed value
+     * @param range If not null, then the datasource shall return only a
+     *        selection of the (nonscalar) data. The range is valid only during
+     *        the call.
+     * @param pending The handle of the read. It is passed to
+     *        UA_Server_completeAsyncRead exactly once, possibly already before
+     *        readAsync returns.
+     * @return If an error is returned, the read was not started and must not
+     *         be completed. The error is then returned to the client. */
+    UA_StatusCode (*readAsync)(void *handle, const UA_NodeId nodeid,
+                               UA_Boolean includeSourceTimeStamp, const UA_NumericRange *range,
+                               UA_AsyncRead *pending);
+
+    /* Copies the data of several nodes from the source at once. Can be a
+     * null-pointer. A ReadRequest or a sampling pass reads the values of all
+     * nodes with the same handle and readBatch callback in a single call. Reads
+     * with an index range use the read callback.
+     *
+     * @param handle The handle that is shared by the nodes
+     * @param nodeids The ids of the read nodes
+     * @param nodeidsSize The number of read nodes
+     * @param includeSourceTimeStamp If true, then the datasource is expected to set the source
+     *        timestamps in the returned values
+     * @param values Array of nodeidsSize initialized DataValues that are
+     *        returned to the client in the order of the nodeids.
+     * @return Returns a status code that is set in all values. If an error is
+     *         returned, then no releasing of the values is done. */
+    UA_StatusCode (*readBatch)(void *handle, const UA_NodeId *nodeids, size_t nodeidsSize,
+                               UA_Boolean includeSourceTimeStamp, UA_DataValue *values);
 } UA_DataSource;
 
+/* Completes a read that was started with the readAsync callback of a data
+ * source. The value is copied. With multithreading, this can be called from any
+ * thread. Otherwise, call it from the thread that runs the server (e.g. from a
+ * repeated job that polls the backend). All pending reads must be completed
+ * before the server is deleted. */
+void UA_EXPORT
+UA_Server_completeAsyncRead(UA_Server *server, UA_AsyncRead *pending, const UA_DataValue *value);
+
 UA_StatusCode UA_EXPORT
 UA_Server_setVariableNode_dataSource(UA_Server *server, const UA_NodeId nodeId,
                                      const UA_DataSource dataSource);
@@ -525,6 +951,55 @@ UA_StatusCode UA_EXPORT
 UA_Server_setVariableNode_valueCallback(UA_Server *server, const UA_NodeId nodeId,
                                         const UA_ValueCallback callback);
 
+/**
+ * Value Memory
+ * ~~~~~~~~~~~~
+ * The value of a variable can be bound to memory that is updated outside of
+ * the server, for example the process image of a PLC runtime in a shared-memory
+ * segment. The writer updates the memory without calling into the server.
+ * Reads and the sampling of monitored items take the value from the memory
+ * without a callback.
+ *
+ * The memory is protected by a sequence lock. Before an update, the writer
+ * increments the sequence counter to an odd number. Afterwards, it increments
+ * the counter to the next even number (see ``UA_ValueMemory_beginWrite`` and
+ * ``UA_ValueMemory_endWrite``). Readers retry until their snapshot was taken
+ * with an even and unchanged counter. Several values can share one counter, so
+ * that a whole process image is updated consistently.
+ *
+ * Only types without pointers can be bound. The value cannot be written over
+ * the server. */
+typedef struct {
+    volatile UA_UInt32 *sequence;
+    const UA_DataType *type; /* a type with fixedSize set */
+    void *data; /* the scalar or arrayLength elements of the type */
+    size_t arrayLength; /* 0 for a scalar */
+    volatile UA_DateTime *sourceTimestamp; /* optional, updated by the writer */
+} UA_ValueMemory;
+
+static UA_INLINE void
+UA_ValueMemory_beginWrite(volatile UA_UInt32 *sequence) {
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+    *sequence = *sequence + 1;
+#endif
+}
+
+static UA_INLINE void
+UA_ValueMemory_endWrite(volatile UA_UInt32 *sequence) {
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+#else
+    *sequence = *sequence + 1;
+#endif
+}
+
+UA_StatusCode UA_EXPORT
+UA_Server_setVariableNode_valueMemory(UA_Server *server, const UA_NodeId nodeId,
+                                      const UA_ValueMemory memory);
+
 /**
  * Object Lifecycle Management Callbacks
  * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -675,6 +1150,21 @@ UA_Server_addDataTypeNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                                &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES],
                                instantiationCallback, outNewNodeId); }
 
+/* Adds many nodes at once. This is much faster than adding the nodes one by
+ * one when large address spaces are loaded. The nodestore grows once for the
+ * whole batch, the parents, reference types and type definitions are checked
+ * once for consecutive items that share them, and every parent is edited once
+ * for all of its new children. So the items should be ordered by parent. An
+ * item may use a node that was added earlier in the same batch as its parent.
+ *
+ * The results array has itemsSize entries and contains the status and the
+ * NodeId of every added node. It is to be deleted with UA_Array_delete.
+ * Returns UA_STATUSCODE_BADOUTOFMEMORY if the results cannot be allocated.
+ * Otherwise, the status of every item is found in the results. */
+UA_StatusCode UA_EXPORT
+UA_Server_addNodes(UA_Server *server, const UA_AddNodesItem *items, size_t itemsSize,
+                   UA_AddNodesResult **results);
+
 UA_StatusCode UA_EXPORT
 UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
                                     const UA_NodeId parentNodeId,
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014-2016 the contributors as stated in the AUTHORS file
+ *
+ * This file is part of open62541. open62541 is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU Lesser General
+ * Public License, version 3 (as published by the Free Software Foundation) with
+ * a static linking exception as stated in the LICENSE file provided with
+ * open62541.
+ *
+ * open62541 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ */
+
+#ifndef UA_TRACE_H_
+#define UA_TRACE_H_
+
+#include "ua_config.h"
+
+/**
+ * Tracepoints
+ * -----------
+ * With UA_ENABLE_TRACEPOINTS, the stack contains static probes (USDT) in the
+ * provider ``open62541``. A probe is a single nop instruction until a tracer
+ * such as bpftrace, perf or SystemTap attaches to it. Only the arguments, which
+ * are already at hand, are loaded. Without UA_ENABLE_TRACEPOINTS, the probes
+ * are removed entirely.
+ *
+ * The probes and their arguments are
+ *
+ * - ``message_received``: connection, channel, bytes
+ * - ``chunk_assembled``: channel, request, bytes
+ * - ``service_start``: channel, request, request type
+ * - ``service_end``: channel, session, request, request type, error
+ * - ``batch_dispatched``: worker, jobs, priority
+ * - ``batch_taken``: worker, jobs, priority
+ * - ``sample_taken``: session, sampler, monitored item, status (once for every
+ *   item of the sampler)
+ * - ``publish_sent``: channel, session, subscription, sequence number,
+ *   notifications
+ * - ``bytes_written``: connection, bytes
+ *
+ * The session is the first field (data1) of the session id, as it appears in
+ * the log. The sampler is its address. Example::
+ *
+ *    bpftrace -e 'usdt:./server:open62541:service_end { @[arg3] = count(); }' */
+
+#ifdef UA_ENABLE_TRACEPOINTS
+# include <sys/sdt.h>
+# define UA_TRACE2(PROBE, A, B) DTRACE_PROBE2(open62541, PROBE, A, B)
+# define UA_TRACE3(PROBE, A, B, C) DTRACE_PROBE3(open62541, PROBE, A, B, C)
+# define UA_TRACE4(PROBE, A, B, C, D) DTRACE_PROBE4(open62541, PROBE, A, B, C, D)
+# define UA_TRACE5(PROBE, A, B, C, D, E) DTRACE_PROBE5(open62541, PROBE, A, B, C, D, E)
+#else
+# define UA_TRACE2(PROBE, A, B) do {} while(0)
+# define UA_TRACE3(PROBE, A, B, C) do {} while(0)
+# define UA_TRACE4(PROBE, A, B, C, D) do {} while(0)
+# define UA_TRACE5(PROBE, A, B, C, D, E) do {} while(0)
+#endif
+
+#endif /* UA_TRACE_H_ */
@@ -493,7 +493,7 @@ typedef struct {
     } encoding;
     union {
         struct {
-            UA_NodeId typeId;   /* The nodeid of the datatype */
+            UA_NodeId typeId;   /* The nodeid of the datatype encoding */
             UA_ByteString body; /* The bytestring of the encoded data */
         } encoded;
         struct {
@@ -503,6 +503,12 @@ typedef struct {
     } content;
 } UA_ExtensionObject;
 
+/* Decodes an encoded body in place if the datatype is known. The
+ * ExtensionObject is decoded afterwards. Does nothing if it is already decoded.
+ * Returns UA_STATUSCODE_BADDATATYPEIDUNKNOWN if the datatype is unknown. */
+UA_StatusCode UA_EXPORT
+UA_ExtensionObject_decodeContent(UA_ExtensionObject *eo);
+
 /**
  * .. _variant:
  *
@@ -534,6 +540,11 @@ typedef struct {
         UA_VARIANT_DATA,          /* The data has the same lifecycle as the variant */
         UA_VARIANT_DATA_NODELETE, /* The data is "borrowed" by the variant and shall not be
                                      deleted at the end of the variant's lifecycle. */
+        UA_VARIANT_DATA_SHARED    /* The data is immutable and reference-counted. Copying
+                                     the variant adds a reference instead of copying the
+                                     data. The data is deleted with the last reference.
+                                     NEVER write into shared data. Call UA_Variant_unshare
+                                     first to get a private copy. */
     } storageType;
     size_t arrayLength;  // The number of elements in the data array
     void *data; // Points to the scalar or array data
@@ -588,6 +599,24 @@ UA_StatusCode UA_EXPORT
 UA_Variant_setArrayCopy(UA_Variant *v, const void *array,
                         size_t arraySize, const UA_DataType *type);
 
+/* Move the data of the variant into an immutable, reference-counted buffer.
+ * Afterwards, copies of the variant share the data. The members of the elements
+ * are moved and not copied. Variants that are empty, already shared or borrow
+ * their data are not changed. The range setters below make a private copy of
+ * the data before writing into it if the data has more than one reference.
+ *
+ * @param v The variant
+ * @return Indicates whether the operation succeeded or returns an error code */
+UA_StatusCode UA_EXPORT UA_Variant_share(UA_Variant *v);
+
+/* Replace shared or borrowed data with a private copy that the variant owns.
+ * Afterwards, the data can be modified in place. Variants that already own
+ * their data are not changed.
+ *
+ * @param v The variant
+ * @return Indicates whether the operation succeeded or returns an error code */
+UA_StatusCode UA_EXPORT UA_Variant_unshare(UA_Variant *v);
+
 /**
  * NumericRanges are used to indicate subsets of a (multidimensional) variant
  * array. NumericRange has no official type structure in the standard. On the
@@ -613,6 +642,18 @@ typedef struct {
 UA_StatusCode UA_EXPORT
 UA_Variant_copyRange(const UA_Variant *src, UA_Variant *dst, const UA_NumericRange range);
 
+/* Like UA_Variant_copyRange, but the target borrows the data from the source if
+ * the range is a contiguous part of an array with at most one dimension. The
+ * target is then valid only as long as the source data. Other ranges are
+ * copied.
+ *
+ * @param src The source variant
+ * @param dst The target variant
+ * @param range The range of the data
+ * @return Returns UA_STATUSCODE_GOOD or an error code */
+UA_StatusCode UA_EXPORT
+UA_Variant_borrowRange(const UA_Variant *src, UA_Variant *dst, const UA_NumericRange range);
+
 /* Insert a range of data into an existing variant. The data array can't be reused afterwards if it
  * contains types without a fixed size (e.g. strings) since the members are moved into the variant
  * and take on its lifecycle.
@@ -737,6 +778,11 @@ UA_init(void *p, const UA_DataType *type) {
 /* Copies the content of two variables. If copying fails (e.g. because no memory was
  * available for an array), then dst is emptied and initialized to prevent memory leaks.
  *
+ * ATTENTION: The copy is not deep for variants with UA_VARIANT_DATA_SHARED
+ * (also inside DataValues and structures). The copy references the same
+ * immutable data as the source. Use UA_Variant_unshare before writing into the
+ * data of a copied variant.
+ *
  * @param src The memory location of the source variable
  * @param dst The memory location of the destination variable
  * @param type The datatype description
@@ -0,0 +1,217 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#include <stdlib.h> // malloc, free
+#include <string.h> // memset
+#include "ua_allocator_slab.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+# include <urcu/uatomic.h>
+#endif
+
+#if __STDC_VERSION__ >= 201112L
+# define SLAB_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+# define SLAB_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+# define SLAB_THREAD_LOCAL __declspec(thread)
+#else
+# define SLAB_THREAD_LOCAL
+#endif
+
+#define SLAB_MINSHIFT 5 /* the smallest size class has 32 bytes */
+#define SLAB_CLASSES 6 /* up to 1024 bytes */
+#define SLAB_PAGESIZE (64 * 1024)
+#define SLAB_CACHESIZE 64 /* objects per size class in a thread cache */
+#define SLAB_BATCHSIZE (SLAB_CACHESIZE / 2) /* moved between a cache and the pool */
+
+typedef struct SlabObject {
+    struct SlabObject *next;
+} SlabObject;
+
+typedef struct SlabPage {
+    struct SlabPage *next;
+    void *align; /* keep the objects aligned to 2 pointers */
+} SlabPage;
+
+typedef struct {
+    UA_Allocator allocator;
+    UA_UInt64 id;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock;
+#endif
+    SlabPage *pages;
+    SlabObject *pool[SLAB_CLASSES]; /* free objects that are in no thread cache */
+    size_t bytesInUse[UA_MEMCATEGORY_COUNT];
+} SlabAllocator;
+
+/* A thread caches the objects of only one allocator at a time. The id of the
+ * allocator is unique, so a cache of a deleted allocator is never used. */
+typedef struct {
+    UA_UInt64 owner;
+    SlabObject *objects[SLAB_CLASSES];
+    size_t count[SLAB_CLASSES];
+} SlabCache;
+
+static SLAB_THREAD_LOCAL SlabCache slabCache;
+static UA_UInt64 slabNextId = 1;
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define SLAB_LOCK(slab) pthread_mutex_lock(&(slab)->lock)
+# define SLAB_UNLOCK(slab) pthread_mutex_unlock(&(slab)->lock)
+# define SLAB_ACCOUNT(slab, category, size) \
+    uatomic_add(&(slab)->bytesInUse[category], size)
+# define SLAB_UNACCOUNT(slab, category, size) \
+    (void)uatomic_sub_return(&(slab)->bytesInUse[category], size)
+#else
+# define SLAB_LOCK(slab)
+# define SLAB_UNLOCK(slab)
+# define SLAB_ACCOUNT(slab, category, size) (slab)->bytesInUse[category] += size
+# define SLAB_UNACCOUNT(slab, category, size) (slab)->bytesInUse[category] -= size
+#endif
+
+/* Returns SLAB_CLASSES for objects that are too large */
+static size_t sizeClass(size_t size) {
+    size_t c = 0;
+    size_t classSize = (size_t)1 << SLAB_MINSHIFT;
+    while(c < SLAB_CLASSES && classSize < size) {
+        classSize <<= 1;
+        c++;
+    }
+    return c;
+}
+
+/* Call with the lock held */
+static UA_StatusCode addPage(SlabAllocator *slab, size_t c) {
+    SlabPage *page = malloc(SLAB_PAGESIZE);
+    if(!page)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    page->next = slab->pages;
+    slab->pages = page;
+    size_t objSize = (size_t)1 << (SLAB_MINSHIFT + c);
+    uintptr_t pos = (uintptr_t)page + sizeof(SlabPage);
+    uintptr_t end = (uintptr_t)page + SLAB_PAGESIZE;
+    for(; pos + objSize <= end; pos += objSize) {
+        SlabObject *o = (SlabObject*)pos;
+        o->next = slab->pool[c];
+        slab->pool[c] = o;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void claimCache(SlabAllocator *slab) {
+    if(slabCache.owner == slab->id)
+        return;
+    /* The objects of another allocator stay in its pages */
+    memset(&slabCache, 0, sizeof(SlabCache));
+    slabCache.owner = slab->id;
+}
+
+/* Move a batch from the pool into the thread cache */
+static void refillCache(SlabAllocator *slab, size_t c) {
+    SLAB_LOCK(slab);
+    if(!slab->pool[c] && addPage(slab, c) != UA_STATUSCODE_GOOD) {
+        SLAB_UNLOCK(slab);
+        return;
+    }
+    for(size_t i = 0; i < SLAB_BATCHSIZE && slab->pool[c]; i++) {
+        SlabObject *o = slab->pool[c];
+        slab->pool[c] = o->next;
+        o->next = slabCache.objects[c];
+        slabCache.objects[c] = o;
+        slabCache.count[c]++;
+    }
+    SLAB_UNLOCK(slab);
+}
+
+/* Move a batch from the thread cache back into the pool */
+static void flushCache(SlabAllocator *slab, size_t c) {
+    SLAB_LOCK(slab);
+    for(size_t i = 0; i < SLAB_BATCHSIZE && slabCache.objects[c]; i++) {
+        SlabObject *o = slabCache.objects[c];
+        slabCache.objects[c] = o->next;
+        slabCache.count[c]--;
+        o->next = slab->pool[c];
+        slab->pool[c] = o;
+    }
+    SLAB_UNLOCK(slab);
+}
+
+static void * slabAlloc(void *context, UA_MemCategory category, size_t size) {
+    SlabAllocator *slab = context;
+    size_t c = sizeClass(size);
+    void *p;
+    if(c >= SLAB_CLASSES) {
+        p = malloc(size);
+    } else {
+        claimCache(slab);
+        if(!slabCache.objects[c])
+            refillCache(slab, c);
+        SlabObject *o = slabCache.objects[c];
+        if(o) {
+            slabCache.objects[c] = o->next;
+            slabCache.count[c]--;
+        }
+        p = o;
+    }
+    if(p)
+        SLAB_ACCOUNT(slab, category, size);
+    return p;
+}
+
+static void slabFree(void *context, UA_MemCategory category, void *p, size_t size) {
+    SlabAllocator *slab = context;
+    SLAB_UNACCOUNT(slab, category, size);
+    size_t c = sizeClass(size);
+    if(c >= SLAB_CLASSES) {
+        free(p);
+        return;
+    }
+    claimCache(slab);
+    SlabObject *o = p;
+    o->next = slabCache.objects[c];
+    slabCache.objects[c] = o;
+    slabCache.count[c]++;
+    if(slabCache.count[c] > SLAB_CACHESIZE)
+        flushCache(slab, c);
+}
+
+UA_Allocator * UA_Allocator_Slab_new(void) {
+    SlabAllocator *slab = malloc(sizeof(SlabAllocator));
+    if(!slab)
+        return NULL;
+    memset(slab, 0, sizeof(SlabAllocator));
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&slab->lock, NULL);
+    slab->id = uatomic_add_return(&slabNextId, 1);
+#else
+    slab->id = ++slabNextId;
+#endif
+    slab->allocator.context = slab;
+    slab->allocator.alloc = slabAlloc;
+    slab->allocator.free = slabFree;
+    return &slab->allocator;
+}
+
+void UA_Allocator_Slab_delete(UA_Allocator *allocator) {
+    SlabAllocator *slab = allocator->context;
+    if(slabCache.owner == slab->id)
+        memset(&slabCache, 0, sizeof(SlabCache));
+    SlabPage *page = slab->pages;
+    while(page) {
+        SlabPage *next = page->next;
+        free(page);
+        page = next;
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&slab->lock);
+#endif
+    free(slab);
+}
+
+size_t
+UA_Allocator_Slab_bytesInUse(const UA_Allocator *allocator, UA_MemCategory category) {
+    const SlabAllocator *slab = allocator->context;
+    return slab->bytesInUse[category];
+}
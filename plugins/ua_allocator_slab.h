@@ -0,0 +1,33 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_ALLOCATOR_SLAB_H_
+#define UA_ALLOCATOR_SLAB_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_types.h"
+#include "ua_allocator.h"
+
+/* Create a slab allocator. Objects of up to 1024 bytes are cut from 64kB pages
+ * in power-of-two size classes. Every thread keeps a cache of free objects for
+ * each size class. So the threads take and return most objects without a lock.
+ * Larger objects are taken from malloc. The pages are freed only when the
+ * allocator is deleted. */
+UA_Allocator UA_EXPORT * UA_Allocator_Slab_new(void);
+
+/* Delete the allocator and all pages. All objects taken from the allocator
+ * must have been returned. */
+void UA_EXPORT UA_Allocator_Slab_delete(UA_Allocator *allocator);
+
+/* The bytes of the objects of a category that are currently in use */
+size_t UA_EXPORT
+UA_Allocator_Slab_bytesInUse(const UA_Allocator *allocator, UA_MemCategory category);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_ALLOCATOR_SLAB_H_ */
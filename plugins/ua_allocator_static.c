@@ -0,0 +1,175 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#include "ua_allocator_static.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+/* The number of objects per size class 32, 64, 128, ..., 16384 bytes */
+#ifndef UA_STATICPOOL_NODESTORE_COUNTS
+# define UA_STATICPOOL_NODESTORE_COUNTS 0,0,128,1024,512,32,0,0,0,0
+#endif
+#ifndef UA_STATICPOOL_SESSION_COUNTS
+# define UA_STATICPOOL_SESSION_COUNTS 0,0,0,0,32,0,0,0,0,0
+#endif
+#ifndef UA_STATICPOOL_SUBSCRIPTION_COUNTS
+# define UA_STATICPOOL_SUBSCRIPTION_COUNTS 0,0,64,64,64,0,4,4,2,2
+#endif
+#ifndef UA_STATICPOOL_NETWORK_COUNTS
+# define UA_STATICPOOL_NETWORK_COUNTS 0,0,128,0,32,0,0,0,0,0
+#endif
+#ifndef UA_STATICPOOL_JOBS_COUNTS
+# define UA_STATICPOOL_JOBS_COUNTS 32,32,96,0,0,0,0,0,0,0
+#endif
+
+#define STATICPOOL_MINSHIFT 5 /* the smallest size class has 32 bytes */
+#define STATICPOOL_CLASSES 10 /* up to 16384 bytes */
+
+#define STATICPOOL_BYTES_(c0, c1, c2, c3, c4, c5, c6, c7, c8, c9)         \
+    (((c0) << 5) + ((c1) << 6) + ((c2) << 7) + ((c3) << 8) + ((c4) << 9) + \
+     ((c5) << 10) + ((c6) << 11) + ((c7) << 12) + ((c8) << 13) + ((c9) << 14))
+#define STATICPOOL_BYTES(...) STATICPOOL_BYTES_(__VA_ARGS__)
+
+/* The pools are aligned for all types the objects contain */
+typedef union {
+    void *p;
+    UA_UInt64 u;
+    UA_Double d;
+} StaticPoolWord;
+
+/* One word more, so that a pool without objects is no empty array */
+#define STATICPOOL_WORDS(BYTES) ((BYTES) / sizeof(StaticPoolWord) + 1)
+
+static StaticPoolWord poolNodeStore[STATICPOOL_WORDS(STATICPOOL_BYTES(UA_STATICPOOL_NODESTORE_COUNTS))];
+static StaticPoolWord poolSession[STATICPOOL_WORDS(STATICPOOL_BYTES(UA_STATICPOOL_SESSION_COUNTS))];
+static StaticPoolWord poolSubscription[STATICPOOL_WORDS(STATICPOOL_BYTES(UA_STATICPOOL_SUBSCRIPTION_COUNTS))];
+static StaticPoolWord poolNetwork[STATICPOOL_WORDS(STATICPOOL_BYTES(UA_STATICPOOL_NETWORK_COUNTS))];
+static StaticPoolWord poolJobs[STATICPOOL_WORDS(STATICPOOL_BYTES(UA_STATICPOOL_JOBS_COUNTS))];
+
+typedef struct StaticPoolObject {
+    struct StaticPoolObject *next;
+} StaticPoolObject;
+
+/* The objects of a size class are cut from the front of its slab */
+typedef struct {
+    uintptr_t next;
+    uintptr_t end;
+    StaticPoolObject *free;
+} StaticSlab;
+
+typedef struct {
+    StaticPoolWord *start;
+    size_t counts[STATICPOOL_CLASSES];
+    StaticSlab slabs[STATICPOOL_CLASSES];
+    size_t bytesInUse;
+    size_t failures;
+} StaticPool;
+
+static StaticPool staticPools[UA_MEMCATEGORY_COUNT] = {
+    {poolNodeStore, {UA_STATICPOOL_NODESTORE_COUNTS}, {{0, 0, NULL}}, 0, 0},
+    {poolSession, {UA_STATICPOOL_SESSION_COUNTS}, {{0, 0, NULL}}, 0, 0},
+    {poolSubscription, {UA_STATICPOOL_SUBSCRIPTION_COUNTS}, {{0, 0, NULL}}, 0, 0},
+    {poolNetwork, {UA_STATICPOOL_NETWORK_COUNTS}, {{0, 0, NULL}}, 0, 0},
+    {poolJobs, {UA_STATICPOOL_JOBS_COUNTS}, {{0, 0, NULL}}, 0, 0}
+};
+
+static UA_Boolean staticPoolsReady = false;
+
+#ifdef UA_ENABLE_MULTITHREADING
+static pthread_mutex_t staticPoolLock = PTHREAD_MUTEX_INITIALIZER;
+# define STATICPOOL_LOCK() pthread_mutex_lock(&staticPoolLock)
+# define STATICPOOL_UNLOCK() pthread_mutex_unlock(&staticPoolLock)
+#else
+# define STATICPOOL_LOCK()
+# define STATICPOOL_UNLOCK()
+#endif
+
+/* Reserve the slabs of all size classes in the pools */
+static void resetPools(void) {
+    for(size_t i = 0; i < UA_MEMCATEGORY_COUNT; i++) {
+        StaticPool *pool = &staticPools[i];
+        uintptr_t next = (uintptr_t)pool->start;
+        for(size_t c = 0; c < STATICPOOL_CLASSES; c++) {
+            StaticSlab *slab = &pool->slabs[c];
+            slab->next = next;
+            next += pool->counts[c] << (STATICPOOL_MINSHIFT + c);
+            slab->end = next;
+            slab->free = NULL;
+        }
+        pool->bytesInUse = 0;
+        pool->failures = 0;
+    }
+    staticPoolsReady = true;
+}
+
+/* Returns STATICPOOL_CLASSES for objects that are too large */
+static size_t sizeClass(size_t size) {
+    size_t c = 0;
+    size_t classSize = (size_t)1 << STATICPOOL_MINSHIFT;
+    while(c < STATICPOOL_CLASSES && classSize < size) {
+        classSize <<= 1;
+        c++;
+    }
+    return c;
+}
+
+static void * staticAlloc(void *context, UA_MemCategory category, size_t size) {
+    StaticPool *pool = &staticPools[category];
+    size_t c = sizeClass(size);
+    void *p = NULL;
+    STATICPOOL_LOCK();
+    if(c < STATICPOOL_CLASSES) {
+        StaticSlab *slab = &pool->slabs[c];
+        size_t objSize = (size_t)1 << (STATICPOOL_MINSHIFT + c);
+        if(slab->free) {
+            p = slab->free;
+            slab->free = slab->free->next;
+        } else if(slab->end - slab->next >= objSize) {
+            p = (void*)slab->next;
+            slab->next += objSize;
+        }
+    }
+    if(p)
+        pool->bytesInUse += size;
+    else
+        pool->failures++;
+    STATICPOOL_UNLOCK();
+    return p;
+}
+
+static void staticFree(void *context, UA_MemCategory category, void *p, size_t size) {
+    StaticPool *pool = &staticPools[category];
+    StaticSlab *slab = &pool->slabs[sizeClass(size)];
+    StaticPoolObject *o = p;
+    STATICPOOL_LOCK();
+    o->next = slab->free;
+    slab->free = o;
+    pool->bytesInUse -= size;
+    STATICPOOL_UNLOCK();
+}
+
+static UA_Allocator staticAllocator = {NULL, staticAlloc, staticFree};
+
+UA_Allocator * UA_Allocator_Static_get(void) {
+    STATICPOOL_LOCK();
+    if(!staticPoolsReady)
+        resetPools();
+    STATICPOOL_UNLOCK();
+    return &staticAllocator;
+}
+
+void UA_Allocator_Static_reset(void) {
+    STATICPOOL_LOCK();
+    resetPools();
+    STATICPOOL_UNLOCK();
+}
+
+size_t UA_Allocator_Static_bytesInUse(UA_MemCategory category) {
+    return staticPools[category].bytesInUse;
+}
+
+size_t UA_Allocator_Static_failures(UA_MemCategory category) {
+    return staticPools[category].failures;
+}
@@ -0,0 +1,53 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_ALLOCATOR_STATIC_H_
+#define UA_ALLOCATOR_STATIC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_types.h"
+#include "ua_allocator.h"
+
+/* An allocator with static pools for devices that run for a long time. It
+ * serves the objects that the stack takes from the allocator plugin (see
+ * ua_allocator.h). Strings, arrays, variant contents and message buffers are
+ * still taken from UA_malloc. So the allocator bounds the memory of the
+ * objects per subsystem, but does not replace the heap.
+ *
+ * Every category has a static pool. The pool is divided into slabs for the
+ * power-of-two size classes from 32 to 16384 bytes. The number of objects per
+ * size class is fixed at compile time and its slab is reserved up front. So
+ * one size class cannot take the memory of another. A returned object is kept
+ * in the free list of its slab. So allocations take constant time and the
+ * memory does not fragment. An allocation fails when the slab of its size
+ * class is used up. Objects of more than 16384 bytes (with a header of two
+ * pointers) are always rejected. The largest objects of the stack are the
+ * sample queues of monitored items with about 112 bytes per queued value. The
+ * queue sizes are bounded with the queueSizeLimits of the server
+ * configuration.
+ *
+ * The object counts are set with the definitions
+ * UA_STATICPOOL_NODESTORE_COUNTS, UA_STATICPOOL_SESSION_COUNTS,
+ * UA_STATICPOOL_SUBSCRIPTION_COUNTS, UA_STATICPOOL_NETWORK_COUNTS and
+ * UA_STATICPOOL_JOBS_COUNTS when the library is built. Each is a list of ten
+ * comma-separated counts for the size classes 32, 64, ..., 16384 bytes. */
+UA_Allocator UA_EXPORT * UA_Allocator_Static_get(void);
+
+/* Return all pools to their initial state. No object of the allocator may be
+ * in use. */
+void UA_EXPORT UA_Allocator_Static_reset(void);
+
+/* The bytes of the objects of a category that are currently in use */
+size_t UA_EXPORT UA_Allocator_Static_bytesInUse(UA_MemCategory category);
+
+/* The allocations of a category that failed since the last reset */
+size_t UA_EXPORT UA_Allocator_Static_failures(UA_MemCategory category);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_ALLOCATOR_STATIC_H_ */
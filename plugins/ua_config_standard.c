@@ -20,7 +20,14 @@ UA_UsernamePasswordLogin usernamePasswords[2] = {
 
 const UA_ServerConfig UA_ServerConfig_standard = {
     .nThreads = 1,
+    .connectionAffinity = false,
+    .realtimeJobsWeight = 4,
+    .networkReactors = false,
+    .mainLoopCpuMask = 0,
+    .workerCpuMasksSize = 0,
+    .workerCpuMasks = NULL,
     .logger = UA_Log_Stdout,
+    .allocator = NULL,
 
     /* Server Description */
     .buildInfo = {
@@ -59,16 +66,29 @@ const UA_ServerConfig UA_ServerConfig_standard = {
     /* Limits for Sessions */
     .maxSessions = 100,
     .maxSessionTimeout = 60.0 * 60.0 * 1000.0, /* 1h */
+    .maxBrowseContinuationPoints = 5,
+    .maxSessionMemory = 0, /* unlimited */
+    .maxSessionRequestRate = 0, /* unlimited */
+    .maxSessionRequestBurst = 0,
+    .operationsPerRequest = 0,
+    .maxSessionInflightRequests = 0, /* unlimited */
 
     /* Limits for Subscriptions */
     .publishingIntervalLimits = { .min = 100.0, .max = 3600.0 * 1000.0 },
     .lifeTimeCountLimits = { .max = 15000, .min = 3 },
     .keepAliveCountLimits = { .max = 100, .min = 1 },
     .maxNotificationsPerPublish = 1000,
+    .maxRetransmissionQueueSize = 16,
+    .maxSessionRetransmissionQueueSize = 64,
+    .maxSubscriptionMemory = 0, /* unlimited */
 
     /* Limits for MonitoredItems */
     .samplingIntervalLimits = { .min = 50.0, .max = 24.0 * 3600.0 * 1000.0 },
-    .queueSizeLimits = { .max = 100, .min = 1 }
+    .queueSizeLimits = { .max = 100, .min = 1 },
+
+    /* History */
+    .maxHistoryBytesPerNode = 1024 * 1024, /* 1MB */
+    .historySamplingInterval = 1000 /* 1s */
 };
 
 const UA_EXPORT UA_ClientConfig UA_ClientConfig_standard = {
@@ -81,5 +101,7 @@ const UA_EXPORT UA_ClientConfig UA_ClientConfig_standard = {
         .recvBufferSize  = 65535,
         .maxMessageSize = 65535,
         .maxChunkCount = 1 },
-    .connectionFunc = UA_ClientConnectionTCP
+    .connectionFunc = UA_ClientConnectionTCP,
+    .lazyExtensionObjects = false,
+    .applicationUri = {0, NULL}
 };
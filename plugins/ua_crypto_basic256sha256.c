@@ -0,0 +1,554 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#include "ua_crypto_basic256sha256.h"
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy, memset
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define UA_AESNI
+# include <wmmintrin.h>
+#endif
+
+#define BASIC256SHA256_KEYLENGTH 32
+#define BASIC256SHA256_BLOCKSIZE 16
+#define BASIC256SHA256_SIGNATURESIZE 32
+#define AES256_ROUNDS 14
+
+/***********/
+/* SHA-256 */
+/***********/
+
+typedef struct {
+    UA_UInt32 h[8];
+    UA_UInt64 length; /* hashed bytes */
+    UA_Byte block[64];
+    size_t blockFill;
+} Sha256;
+
+static const UA_UInt32 sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256Compress(UA_UInt32 *h, const UA_Byte *block) {
+    UA_UInt32 w[64];
+    for(size_t i = 0; i < 16; i++)
+        w[i] = (UA_UInt32)block[4*i] << 24 | (UA_UInt32)block[4*i+1] << 16 |
+            (UA_UInt32)block[4*i+2] << 8 | (UA_UInt32)block[4*i+3];
+    for(size_t i = 16; i < 64; i++) {
+        UA_UInt32 s0 = ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ (w[i-15] >> 3);
+        UA_UInt32 s1 = ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+    UA_UInt32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for(size_t i = 0; i < 64; i++) {
+        UA_UInt32 t1 = k + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) +
+            ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        UA_UInt32 t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+static void sha256Init(Sha256 *s) {
+    static const UA_UInt32 init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(s->h, init, sizeof(init));
+    s->length = 0;
+    s->blockFill = 0;
+}
+
+static void sha256Update(Sha256 *s, const UA_Byte *data, size_t length) {
+    s->length += length;
+    if(s->blockFill > 0) {
+        size_t n = 64 - s->blockFill;
+        if(n > length)
+            n = length;
+        memcpy(&s->block[s->blockFill], data, n);
+        s->blockFill += n;
+        data += n;
+        length -= n;
+        if(s->blockFill < 64)
+            return;
+        sha256Compress(s->h, s->block);
+        s->blockFill = 0;
+    }
+    /* Hash whole blocks directly from the data */
+    for(; length >= 64; data += 64, length -= 64)
+        sha256Compress(s->h, data);
+    memcpy(s->block, data, length);
+    s->blockFill = length;
+}
+
+static void sha256Final(Sha256 *s, UA_Byte *digest) {
+    UA_UInt64 bits = s->length * 8;
+    s->block[s->blockFill++] = 0x80;
+    if(s->blockFill > 56) {
+        memset(&s->block[s->blockFill], 0, 64 - s->blockFill);
+        sha256Compress(s->h, s->block);
+        s->blockFill = 0;
+    }
+    memset(&s->block[s->blockFill], 0, 56 - s->blockFill);
+    for(size_t i = 0; i < 8; i++)
+        s->block[56 + i] = (UA_Byte)(bits >> (56 - 8 * i));
+    sha256Compress(s->h, s->block);
+    for(size_t i = 0; i < 8; i++) {
+        digest[4*i] = (UA_Byte)(s->h[i] >> 24);
+        digest[4*i+1] = (UA_Byte)(s->h[i] >> 16);
+        digest[4*i+2] = (UA_Byte)(s->h[i] >> 8);
+        digest[4*i+3] = (UA_Byte)s->h[i];
+    }
+}
+
+/***************/
+/* HMAC-SHA256 */
+/***************/
+
+/* The states after hashing the inner and the outer padded key */
+typedef struct {
+    Sha256 inner;
+    Sha256 outer;
+} HmacKey;
+
+static void hmacKeyInit(HmacKey *hk, const UA_Byte *key, size_t keyLength) {
+    UA_Byte k[64];
+    memset(k, 0, 64);
+    if(keyLength > 64) {
+        Sha256 s;
+        sha256Init(&s);
+        sha256Update(&s, key, keyLength);
+        sha256Final(&s, k);
+    } else {
+        memcpy(k, key, keyLength);
+    }
+    UA_Byte pad[64];
+    for(size_t i = 0; i < 64; i++)
+        pad[i] = k[i] ^ 0x36;
+    sha256Init(&hk->inner);
+    sha256Update(&hk->inner, pad, 64);
+    for(size_t i = 0; i < 64; i++)
+        pad[i] = k[i] ^ 0x5c;
+    sha256Init(&hk->outer);
+    sha256Update(&hk->outer, pad, 64);
+    memset(k, 0, 64);
+    memset(pad, 0, 64);
+}
+
+static void hmacFinal(const HmacKey *hk, Sha256 *s, UA_Byte *mac) {
+    UA_Byte innerDigest[32];
+    sha256Final(s, innerDigest);
+    *s = hk->outer;
+    sha256Update(s, innerDigest, 32);
+    sha256Final(s, mac);
+}
+
+static void hmac(const HmacKey *hk, const UA_Byte *data, size_t length, UA_Byte *mac) {
+    Sha256 s = hk->inner;
+    sha256Update(&s, data, length);
+    hmacFinal(hk, &s, mac);
+}
+
+/* P_SHA256 from TLS 1.2 (RFC 5246, 5) */
+static void pSha256(const UA_ByteString *secret, const UA_ByteString *seed,
+                    UA_Byte *out, size_t outLength) {
+    HmacKey hk;
+    hmacKeyInit(&hk, secret->data, secret->length);
+    UA_Byte a[32];
+    hmac(&hk, seed->data, seed->length, a); /* A(1) */
+    while(outLength > 0) {
+        UA_Byte block[32];
+        Sha256 s = hk.inner;
+        sha256Update(&s, a, 32);
+        sha256Update(&s, seed->data, seed->length);
+        hmacFinal(&hk, &s, block);
+        size_t n = outLength < 32 ? outLength : 32;
+        memcpy(out, block, n);
+        out += n;
+        outLength -= n;
+        hmac(&hk, a, 32, a); /* A(i+1) */
+    }
+    memset(&hk, 0, sizeof(HmacKey));
+    memset(a, 0, 32);
+}
+
+/***********/
+/* AES-256 */
+/***********/
+
+/* The round keys in the byte order of FIPS 197. AES-NI loads them without
+ * conversion. The decryption keys for AES-NI are the encryption keys in
+ * reverse order after InvMixColumns. */
+typedef struct {
+    UA_Byte rk[(AES256_ROUNDS + 1) * 16];
+    UA_Byte drk[(AES256_ROUNDS + 1) * 16];
+    UA_Byte iv[16];
+} Aes256;
+
+static const UA_Byte sbox[256] = {
+0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16
+};
+
+static const UA_Byte invSbox[256] = {
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e,
+    0x81, 0xf3, 0xd7, 0xfb, 0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87,
+    0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb, 0x54, 0x7b, 0x94, 0x32,
+    0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49,
+    0x6d, 0x8b, 0xd1, 0x25, 0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16,
+    0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92, 0x6c, 0x70, 0x48, 0x50,
+    0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05,
+    0xb8, 0xb3, 0x45, 0x06, 0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02,
+    0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b, 0x3a, 0x91, 0x11, 0x41,
+    0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8,
+    0x1c, 0x75, 0xdf, 0x6e, 0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89,
+    0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b, 0xfc, 0x56, 0x3e, 0x4b,
+    0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59,
+    0x27, 0x80, 0xec, 0x5f, 0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d,
+    0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef, 0xa0, 0xe0, 0x3b, 0x4d,
+    0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63,
+    0x55, 0x21, 0x0c, 0x7d
+};
+
+static UA_Byte xtime(UA_Byte x) {
+    return (UA_Byte)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static void aes256ExpandKey(Aes256 *aes, const UA_Byte *key) {
+    UA_Byte *rk = aes->rk;
+    memcpy(rk, key, 32);
+    UA_Byte rcon = 0x01;
+    for(size_t i = 8; i < 4 * (AES256_ROUNDS + 1); i++) {
+        UA_Byte t[4];
+        memcpy(t, &rk[(i - 1) * 4], 4);
+        if(i % 8 == 0) {
+            UA_Byte t0 = t[0];
+            t[0] = (UA_Byte)(sbox[t[1]] ^ rcon);
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[t0];
+            rcon = xtime(rcon);
+        } else if(i % 8 == 4) {
+            for(size_t j = 0; j < 4; j++)
+                t[j] = sbox[t[j]];
+        }
+        for(size_t j = 0; j < 4; j++)
+            rk[i * 4 + j] = rk[(i - 8) * 4 + j] ^ t[j];
+    }
+}
+
+static void addRoundKey(UA_Byte *s, const UA_Byte *rk) {
+    for(size_t i = 0; i < 16; i++)
+        s[i] ^= rk[i];
+}
+
+/* SubBytes and ShiftRows. The state is in column order. */
+static void subShiftRows(UA_Byte *s) {
+    UA_Byte t[16];
+    for(size_t c = 0; c < 4; c++)
+        for(size_t r = 0; r < 4; r++)
+            t[r + 4 * c] = sbox[s[r + 4 * ((c + r) % 4)]];
+    memcpy(s, t, 16);
+}
+
+static void invSubShiftRows(UA_Byte *s) {
+    UA_Byte t[16];
+    for(size_t c = 0; c < 4; c++)
+        for(size_t r = 0; r < 4; r++)
+            t[r + 4 * ((c + r) % 4)] = invSbox[s[r + 4 * c]];
+    memcpy(s, t, 16);
+}
+
+static void mixColumns(UA_Byte *s) {
+    for(size_t c = 0; c < 16; c += 4) {
+        UA_Byte a0 = s[c], a1 = s[c+1], a2 = s[c+2], a3 = s[c+3];
+        UA_Byte t = a0 ^ a1 ^ a2 ^ a3;
+        s[c] = a0 ^ t ^ xtime(a0 ^ a1);
+        s[c+1] = a1 ^ t ^ xtime(a1 ^ a2);
+        s[c+2] = a2 ^ t ^ xtime(a2 ^ a3);
+        s[c+3] = a3 ^ t ^ xtime(a3 ^ a0);
+    }
+}
+
+static void invMixColumns(UA_Byte *s) {
+    for(size_t c = 0; c < 16; c += 4) {
+        UA_Byte u = xtime(xtime(s[c] ^ s[c+2]));
+        UA_Byte v = xtime(xtime(s[c+1] ^ s[c+3]));
+        s[c] ^= u;
+        s[c+1] ^= v;
+        s[c+2] ^= u;
+        s[c+3] ^= v;
+    }
+    mixColumns(s);
+}
+
+/* The portable implementation uses lookup tables and is not hardened against
+ * timing attacks on the cache */
+static void aes256EncryptBlock(const Aes256 *aes, UA_Byte *s) {
+    addRoundKey(s, aes->rk);
+    for(size_t r = 1; r < AES256_ROUNDS; r++) {
+        subShiftRows(s);
+        mixColumns(s);
+        addRoundKey(s, &aes->rk[16 * r]);
+    }
+    subShiftRows(s);
+    addRoundKey(s, &aes->rk[16 * AES256_ROUNDS]);
+}
+
+static void aes256DecryptBlock(const Aes256 *aes, UA_Byte *s) {
+    addRoundKey(s, &aes->rk[16 * AES256_ROUNDS]);
+    for(size_t r = AES256_ROUNDS - 1; r > 0; r--) {
+        invSubShiftRows(s);
+        addRoundKey(s, &aes->rk[16 * r]);
+        invMixColumns(s);
+    }
+    invSubShiftRows(s);
+    addRoundKey(s, aes->rk);
+}
+
+static void aes256EncryptCBC(const Aes256 *aes, UA_Byte *data, size_t length) {
+    const UA_Byte *feedback = aes->iv;
+    for(size_t i = 0; i < length; i += 16) {
+        for(size_t j = 0; j < 16; j++)
+            data[i + j] ^= feedback[j];
+        aes256EncryptBlock(aes, &data[i]);
+        feedback = &data[i];
+    }
+}
+
+static void aes256DecryptCBC(const Aes256 *aes, UA_Byte *data, size_t length) {
+    UA_Byte feedback[16], cipher[16];
+    memcpy(feedback, aes->iv, 16);
+    for(size_t i = 0; i < length; i += 16) {
+        memcpy(cipher, &data[i], 16);
+        aes256DecryptBlock(aes, &data[i]);
+        for(size_t j = 0; j < 16; j++)
+            data[i + j] ^= feedback[j];
+        memcpy(feedback, cipher, 16);
+    }
+}
+
+#ifdef UA_AESNI
+
+/* The decryption keys for the equivalent inverse cipher */
+__attribute__((target("aes")))
+static void aesniExpandDecryptionKey(Aes256 *aes) {
+    __m128i k = _mm_loadu_si128((const __m128i*)(const void*)&aes->rk[16 * AES256_ROUNDS]);
+    _mm_storeu_si128((__m128i*)(void*)aes->drk, k);
+    for(size_t r = 1; r < AES256_ROUNDS; r++) {
+        k = _mm_loadu_si128((const __m128i*)(const void*)&aes->rk[16 * (AES256_ROUNDS - r)]);
+        _mm_storeu_si128((__m128i*)(void*)&aes->drk[16 * r], _mm_aesimc_si128(k));
+    }
+    k = _mm_loadu_si128((const __m128i*)(const void*)aes->rk);
+    _mm_storeu_si128((__m128i*)(void*)&aes->drk[16 * AES256_ROUNDS], k);
+}
+
+/* CBC encryption is sequential. Every block depends on the previous one. */
+__attribute__((target("aes")))
+static void aesniEncryptCBC(const Aes256 *aes, UA_Byte *data, size_t length) {
+    __m128i rk[AES256_ROUNDS + 1];
+    for(size_t r = 0; r <= AES256_ROUNDS; r++)
+        rk[r] = _mm_loadu_si128((const __m128i*)(const void*)&aes->rk[16 * r]);
+    __m128i feedback = _mm_loadu_si128((const __m128i*)(const void*)aes->iv);
+    for(size_t i = 0; i < length; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(void*)&data[i]);
+        b = _mm_xor_si128(_mm_xor_si128(b, feedback), rk[0]);
+        for(size_t r = 1; r < AES256_ROUNDS; r++)
+            b = _mm_aesenc_si128(b, rk[r]);
+        feedback = _mm_aesenclast_si128(b, rk[AES256_ROUNDS]);
+        _mm_storeu_si128((__m128i*)(void*)&data[i], feedback);
+    }
+}
+
+/* CBC decryption of four blocks is interleaved to fill the pipeline of the
+ * AES unit */
+__attribute__((target("aes")))
+static void aesniDecryptCBC(const Aes256 *aes, UA_Byte *data, size_t length) {
+    __m128i dk[AES256_ROUNDS + 1];
+    for(size_t r = 0; r <= AES256_ROUNDS; r++)
+        dk[r] = _mm_loadu_si128((const __m128i*)(const void*)&aes->drk[16 * r]);
+    __m128i feedback = _mm_loadu_si128((const __m128i*)(const void*)aes->iv);
+    size_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        __m128i c0 = _mm_loadu_si128((const __m128i*)(void*)&data[i]);
+        __m128i c1 = _mm_loadu_si128((const __m128i*)(void*)&data[i + 16]);
+        __m128i c2 = _mm_loadu_si128((const __m128i*)(void*)&data[i + 32]);
+        __m128i c3 = _mm_loadu_si128((const __m128i*)(void*)&data[i + 48]);
+        __m128i b0 = _mm_xor_si128(c0, dk[0]);
+        __m128i b1 = _mm_xor_si128(c1, dk[0]);
+        __m128i b2 = _mm_xor_si128(c2, dk[0]);
+        __m128i b3 = _mm_xor_si128(c3, dk[0]);
+        for(size_t r = 1; r < AES256_ROUNDS; r++) {
+            b0 = _mm_aesdec_si128(b0, dk[r]);
+            b1 = _mm_aesdec_si128(b1, dk[r]);
+            b2 = _mm_aesdec_si128(b2, dk[r]);
+            b3 = _mm_aesdec_si128(b3, dk[r]);
+        }
+        b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, dk[AES256_ROUNDS]), feedback);
+        b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, dk[AES256_ROUNDS]), c0);
+        b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, dk[AES256_ROUNDS]), c1);
+        b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, dk[AES256_ROUNDS]), c2);
+        _mm_storeu_si128((__m128i*)(void*)&data[i], b0);
+        _mm_storeu_si128((__m128i*)(void*)&data[i + 16], b1);
+        _mm_storeu_si128((__m128i*)(void*)&data[i + 32], b2);
+        _mm_storeu_si128((__m128i*)(void*)&data[i + 48], b3);
+        feedback = c3;
+    }
+    for(; i < length; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(void*)&data[i]);
+        __m128i b = _mm_xor_si128(c, dk[0]);
+        for(size_t r = 1; r < AES256_ROUNDS; r++)
+            b = _mm_aesdec_si128(b, dk[r]);
+        b = _mm_xor_si128(_mm_aesdeclast_si128(b, dk[AES256_ROUNDS]), feedback);
+        _mm_storeu_si128((__m128i*)(void*)&data[i], b);
+        feedback = c;
+    }
+}
+
+#endif /* UA_AESNI */
+
+/*********************/
+/* Crypto of Channel */
+/*********************/
+
+typedef struct {
+    HmacKey localSigningKey;
+    HmacKey remoteSigningKey;
+    Aes256 localAes;
+    Aes256 remoteAes;
+    UA_Boolean aesni;
+} Basic256Sha256;
+
+static UA_StatusCode
+basic256Sha256Sign(void *context, const UA_Byte *data, size_t length, UA_Byte *signature) {
+    Basic256Sha256 *b = context;
+    hmac(&b->localSigningKey, data, length, signature);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+basic256Sha256Verify(void *context, const UA_Byte *data, size_t length, const UA_Byte *signature) {
+    Basic256Sha256 *b = context;
+    UA_Byte mac[BASIC256SHA256_SIGNATURESIZE];
+    hmac(&b->remoteSigningKey, data, length, mac);
+    /* compare in constant time */
+    UA_Byte diff = 0;
+    for(size_t i = 0; i < BASIC256SHA256_SIGNATURESIZE; i++)
+        diff |= mac[i] ^ signature[i];
+    return diff == 0 ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+}
+
+static UA_StatusCode basic256Sha256Encrypt(void *context, UA_Byte *data, size_t length) {
+    Basic256Sha256 *b = context;
+    if(length % BASIC256SHA256_BLOCKSIZE != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+#ifdef UA_AESNI
+    if(b->aesni) {
+        aesniEncryptCBC(&b->localAes, data, length);
+        return UA_STATUSCODE_GOOD;
+    }
+#endif
+    aes256EncryptCBC(&b->localAes, data, length);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode basic256Sha256Decrypt(void *context, UA_Byte *data, size_t length) {
+    Basic256Sha256 *b = context;
+    if(length % BASIC256SHA256_BLOCKSIZE != 0)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+#ifdef UA_AESNI
+    if(b->aesni) {
+        aesniDecryptCBC(&b->remoteAes, data, length);
+        return UA_STATUSCODE_GOOD;
+    }
+#endif
+    aes256DecryptCBC(&b->remoteAes, data, length);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void basic256Sha256DeleteMembers(void *context) {
+    /* do not leave the keys in the freed memory */
+    memset(context, 0, sizeof(Basic256Sha256));
+    free(context);
+}
+
+/* The keys of one side: the signing key, the encryption key and the IV */
+static void
+deriveKeys(const UA_ByteString *secret, const UA_ByteString *seed,
+           HmacKey *signingKey, Aes256 *aes, UA_Boolean aesni) {
+    UA_Byte keys[2 * BASIC256SHA256_KEYLENGTH + BASIC256SHA256_BLOCKSIZE];
+    pSha256(secret, seed, keys, sizeof(keys));
+    hmacKeyInit(signingKey, keys, BASIC256SHA256_KEYLENGTH);
+    aes256ExpandKey(aes, &keys[BASIC256SHA256_KEYLENGTH]);
+    memcpy(aes->iv, &keys[2 * BASIC256SHA256_KEYLENGTH], BASIC256SHA256_BLOCKSIZE);
+#ifdef UA_AESNI
+    if(aesni)
+        aesniExpandDecryptionKey(aes);
+#endif
+    memset(keys, 0, sizeof(keys));
+}
+
+UA_StatusCode
+UA_SymmetricCrypto_Basic256Sha256(const UA_ByteString *localNonce,
+                                  const UA_ByteString *remoteNonce,
+                                  UA_SymmetricCrypto *crypto) {
+    if(localNonce->length == 0 || remoteNonce->length == 0)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+    Basic256Sha256 *b = malloc(sizeof(Basic256Sha256));
+    if(!b)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+#ifdef UA_AESNI
+    b->aesni = __builtin_cpu_supports("aes");
+#else
+    b->aesni = false;
+#endif
+    /* The keys of a side are derived with the nonce of the other side as the
+     * secret and its own nonce as the seed */
+    deriveKeys(remoteNonce, localNonce, &b->localSigningKey, &b->localAes, b->aesni);
+    deriveKeys(localNonce, remoteNonce, &b->remoteSigningKey, &b->remoteAes, b->aesni);
+
+    crypto->context = b;
+    crypto->blockSize = BASIC256SHA256_BLOCKSIZE;
+    crypto->signatureSize = BASIC256SHA256_SIGNATURESIZE;
+    crypto->sign = basic256Sha256Sign;
+    crypto->verify = basic256Sha256Verify;
+    crypto->encrypt = basic256Sha256Encrypt;
+    crypto->decrypt = basic256Sha256Decrypt;
+    crypto->deleteMembers = basic256Sha256DeleteMembers;
+    return UA_STATUSCODE_GOOD;
+}
@@ -0,0 +1,32 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_CRYPTO_BASIC256SHA256_H_
+#define UA_CRYPTO_BASIC256SHA256_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_types.h"
+#include "ua_crypto.h"
+
+/* The symmetric algorithms of the security policy Basic256Sha256. Chunks are
+ * signed with HMAC-SHA256 and encrypted with AES-256-CBC. The keys are derived
+ * from the nonces of both sides with P_SHA256 (Part 6, 6.7.5). The local side
+ * signs and encrypts with the keys derived from its own nonce and verifies and
+ * decrypts with the keys of the remote side.
+ *
+ * AES is computed with the AES-NI instructions if the processor supports them
+ * and in portable C otherwise. The HMAC states of the keys are precomputed, so
+ * that signing a chunk does not hash the keys again. */
+UA_StatusCode UA_EXPORT
+UA_SymmetricCrypto_Basic256Sha256(const UA_ByteString *localNonce,
+                                  const UA_ByteString *remoteNonce,
+                                  UA_SymmetricCrypto *crypto);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_CRYPTO_BASIC256SHA256_H_ */
@@ -0,0 +1,204 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#include "ua_log_async.h" // first, defines _DEFAULT_SOURCE for nanosleep
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h> // malloc, free
+#include <time.h> // nanosleep
+#include <pthread.h>
+
+#if __STDC_VERSION__ >= 201112L
+# define ASYNCLOG_THREAD_LOCAL _Thread_local
+#else
+# define ASYNCLOG_THREAD_LOCAL __thread
+#endif
+
+#define ASYNCLOG_RINGSIZE 256 /* messages per thread, a power of two */
+#define ASYNCLOG_MSGSIZE 256 /* longer messages are truncated */
+#define ASYNCLOG_IDLE_NS 1000000 /* sleep when all rings are empty */
+
+static const char *asyncLogLevelNames[6] =
+    {"trace", "debug", "info", "warning", "error", "fatal"};
+static const char *asyncLogCategoryNames[6] =
+    {"network", "channel", "session", "server", "client", "userland"};
+
+typedef struct {
+    UA_DateTime time;
+    UA_LogLevel level;
+    UA_LogCategory category;
+    char msg[ASYNCLOG_MSGSIZE];
+} AsyncLogEntry;
+
+/* A ring has a single producer (the owning thread) and a single consumer (the
+ * background thread). The positions grow monotonically. When the owning thread
+ * exits, the ring is handed to the next thread that starts logging. */
+typedef struct AsyncLogRing {
+    struct AsyncLogRing *next;
+    size_t head; /* advanced by the background thread */
+    size_t tail; /* advanced by the owning thread */
+    UA_Boolean abandoned;
+    AsyncLogEntry entries[ASYNCLOG_RINGSIZE];
+} AsyncLogRing;
+
+static AsyncLogRing *asyncLogRings; /* rings are only removed in stop */
+static UA_Boolean asyncLogRunning;
+static size_t asyncLogDropped;
+static UA_UInt32 asyncLogGeneration; /* invalidates the rings of the threads */
+static pthread_t asyncLogThread;
+static pthread_key_t asyncLogKey;
+
+static ASYNCLOG_THREAD_LOCAL AsyncLogRing *threadRing;
+static ASYNCLOG_THREAD_LOCAL UA_UInt32 threadRingGeneration;
+
+static void writeEntry(const AsyncLogEntry *entry) {
+    UA_DateTimeStruct t = UA_DateTime_toStruct(entry->time);
+    printf("[%02u/%02u/%04u %02u:%02u:%02u.%03u] %s/%s\t%s\n",
+           t.month, t.day, t.year, t.hour, t.min, t.sec, t.milliSec,
+           asyncLogLevelNames[entry->level], asyncLogCategoryNames[entry->category],
+           entry->msg);
+}
+
+/* Called when a thread with a ring exits */
+static void abandonRing(void *data) {
+    AsyncLogRing *ring = (AsyncLogRing*)data;
+    __atomic_store_n(&ring->abandoned, true, __ATOMIC_RELEASE);
+}
+
+static AsyncLogRing * getRing(void) {
+    if(!__atomic_load_n(&asyncLogRunning, __ATOMIC_ACQUIRE))
+        return NULL;
+    UA_UInt32 generation = __atomic_load_n(&asyncLogGeneration, __ATOMIC_ACQUIRE);
+    if(threadRing && threadRingGeneration == generation)
+        return threadRing;
+
+    /* take over the ring of an exited thread */
+    AsyncLogRing *ring = __atomic_load_n(&asyncLogRings, __ATOMIC_ACQUIRE);
+    for(; ring; ring = ring->next) {
+        UA_Boolean expected = true;
+        if(__atomic_compare_exchange_n(&ring->abandoned, &expected, false, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+    }
+
+    /* or add a new ring */
+    if(!ring) {
+        ring = malloc(sizeof(AsyncLogRing));
+        if(!ring)
+            return NULL;
+        ring->head = 0;
+        ring->tail = 0;
+        ring->abandoned = false;
+        ring->next = __atomic_load_n(&asyncLogRings, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&asyncLogRings, &ring->next, ring, true,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+    }
+
+    pthread_setspecific(asyncLogKey, ring);
+    threadRing = ring;
+    threadRingGeneration = generation;
+    return ring;
+}
+
+#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+
+void UA_Log_Async(UA_LogLevel level, UA_LogCategory category, const char *msg, ...) {
+    va_list ap;
+    va_start(ap, msg);
+    AsyncLogRing *ring = getRing();
+    if(!ring) {
+        AsyncLogEntry entry;
+        entry.time = UA_DateTime_now();
+        entry.level = level;
+        entry.category = category;
+        vsnprintf(entry.msg, ASYNCLOG_MSGSIZE, msg, ap);
+        writeEntry(&entry);
+        va_end(ap);
+        return;
+    }
+
+    size_t tail = ring->tail;
+    if(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= ASYNCLOG_RINGSIZE) {
+        __atomic_fetch_add(&asyncLogDropped, 1, __ATOMIC_RELAXED);
+        va_end(ap);
+        return;
+    }
+    AsyncLogEntry *entry = &ring->entries[tail & (ASYNCLOG_RINGSIZE - 1)];
+    entry->time = UA_DateTime_now();
+    entry->level = level;
+    entry->category = category;
+    vsnprintf(entry->msg, ASYNCLOG_MSGSIZE, msg, ap);
+    va_end(ap);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))
+#pragma GCC diagnostic pop
+#endif
+
+/* Returns the number of written messages */
+static size_t drainRings(void) {
+    size_t written = 0;
+    AsyncLogRing *ring = __atomic_load_n(&asyncLogRings, __ATOMIC_ACQUIRE);
+    for(; ring; ring = ring->next) {
+        size_t head = ring->head;
+        size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if(head == tail)
+            continue;
+        for(; head != tail; head++)
+            writeEntry(&ring->entries[head & (ASYNCLOG_RINGSIZE - 1)]);
+        written += tail - ring->head;
+        __atomic_store_n(&ring->head, tail, __ATOMIC_RELEASE);
+    }
+    if(written > 0)
+        fflush(stdout);
+    return written;
+}
+
+static void * asyncLogLoop(void *data) {
+    struct timespec idle = {0, ASYNCLOG_IDLE_NS};
+    while(__atomic_load_n(&asyncLogRunning, __ATOMIC_ACQUIRE)) {
+        if(drainRings() == 0)
+            nanosleep(&idle, NULL);
+    }
+    drainRings();
+    return NULL;
+}
+
+UA_StatusCode UA_Log_Async_start(void) {
+    if(asyncLogRunning)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    if(pthread_key_create(&asyncLogKey, abandonRing) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    asyncLogDropped = 0;
+    __atomic_store_n(&asyncLogRunning, true, __ATOMIC_RELEASE);
+    if(pthread_create(&asyncLogThread, NULL, asyncLogLoop, NULL) != 0) {
+        __atomic_store_n(&asyncLogRunning, false, __ATOMIC_RELEASE);
+        pthread_key_delete(asyncLogKey);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_Log_Async_stop(void) {
+    if(!asyncLogRunning)
+        return;
+    __atomic_store_n(&asyncLogRunning, false, __ATOMIC_RELEASE);
+    pthread_join(asyncLogThread, NULL);
+    pthread_key_delete(asyncLogKey);
+    AsyncLogRing *ring = asyncLogRings;
+    while(ring) {
+        AsyncLogRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    asyncLogRings = NULL;
+    __atomic_fetch_add(&asyncLogGeneration, 1, __ATOMIC_RELEASE);
+}
+
+size_t UA_Log_Async_dropped(void) {
+    return __atomic_load_n(&asyncLogDropped, __ATOMIC_RELAXED);
+}
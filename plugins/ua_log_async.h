@@ -0,0 +1,35 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_LOG_ASYNC_H_
+#define UA_LOG_ASYNC_H_
+
+#include "ua_types.h"
+#include "ua_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A logger that does not block on stdout. Every logging thread formats the
+ * message into a ring buffer of its own. A background thread adds the
+ * timestamp and writes the messages to stdout. Messages are dropped when the
+ * ring of a thread is full. Before UA_Log_Async_start and after
+ * UA_Log_Async_stop, the messages are written directly. */
+UA_EXPORT void UA_Log_Async(UA_LogLevel level, UA_LogCategory category, const char *msg, ...);
+
+/* Start the background thread */
+UA_StatusCode UA_EXPORT UA_Log_Async_start(void);
+
+/* Write the remaining messages, stop the background thread and free the ring
+ * buffers. No thread may log concurrently. */
+void UA_EXPORT UA_Log_Async_stop(void);
+
+/* The number of messages that were dropped since the start */
+size_t UA_EXPORT UA_Log_Async_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UA_LOG_ASYNC_H_ */
@@ -0,0 +1,940 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#include "ua_network_iouring.h"
+
+#include <stdlib.h> // malloc, free
+#include <stdio.h> // snprintf
+#include <string.h> // memset
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h> // close, syscall
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h> // iovec
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+#ifndef IORING_RECV_MULTISHOT
+# error "The io_uring network layer requires the kernel headers of Linux 6.0 or newer"
+#endif
+
+/**
+ * The network layer owns one io_uring. The kernel accepts new connections
+ * with a multishot accept on the server socket. Every connection has a
+ * multishot receive armed that picks buffers from a ring of receive buffers
+ * registered with the kernel. The completions carry the buffer id, the buffer
+ * is handed to the server as it is and put back into the ring when the server
+ * releases it.
+ *
+ * Sending appends the buffers to the queue of the connection. At most one
+ * sendmsg is in flight per connection (so the stream stays ordered) and it
+ * gathers the queued buffers. In the single-threaded mode, the submission
+ * queue is only flushed to the kernel when the server asks for new jobs or
+ * flushes the network layer. So all responses of an iteration cost a single
+ * system call. With multithreading, the workers submit right away.
+ *
+ * The completions are only reaped in getJobs. A connection is freed once the
+ * server detached it and no operation on it is in flight anymore.
+ *
+ * Only the thread calling getJobs reads the completion queue. The submission
+ * queue, the send queues and the buffer ring are guarded by the layer lock
+ * with multithreading. */
+
+#define MAXBACKLOG 100
+#define RINGENTRIES 256    /* submission queue entries. the completion queue has 4x */
+#define RECVBUFFERS 128    /* receive buffers in the ring, a power of two */
+#define BUFFERGROUP 0
+#define MAXIOV 64          /* buffers gathered into one sendmsg */
+#define MAXCOMPLETIONS 256 /* completions handled per call to getJobs */
+#define STOPWAIT 10        /* ms to wait for the cancelled operations per round */
+#define STOPROUNDS 100
+
+/* the operation is encoded in the lower bits of the user data */
+#define OP_ACCEPT 0
+#define OP_RECV 1
+#define OP_SEND 2
+#define OP_CANCEL 3
+#define OP_MASK 3
+
+/* The UA_Connection is the first member, so the pointer handed to the
+ * server can be cast back */
+typedef struct IoUringConnection {
+    UA_Connection connection;
+    struct IoUringConnection *next;        /* in the list of the layer */
+    struct IoUringConnection *nextStarved; /* waits for receive buffers */
+    UA_Boolean starved;
+    UA_Boolean recvArmed; /* the multishot receive is active */
+    UA_Boolean sending;   /* a sendmsg is in flight */
+    UA_Boolean detached;  /* the server was told to detach the connection */
+
+    UA_ByteString *sendQueue;
+    size_t sendQueueCapacity;
+    size_t sendQueueStart;
+    size_t sendQueueCount;
+    size_t sendQueueOffset; /* bytes of the first buffer already sent */
+    size_t sendQueueSize;   /* bytes not yet sent */
+
+    /* arguments of the sendmsg in flight */
+    struct msghdr msg;
+    struct iovec iov[MAXIOV];
+} IoUringConnection;
+
+#define IoUringConnection_queueHead(ic) \
+    (&(ic)->sendQueue[(ic)->sendQueueStart])
+
+typedef struct {
+    UA_ConnectionConfig conf;
+    UA_UInt16 port;
+    UA_Logger logger; // Set during start
+
+    UA_Int32 serversockfd;
+    UA_Boolean stopping;
+    IoUringConnection *connections;
+    size_t connectionsSize;
+    IoUringConnection *starved; /* connections without an armed receive */
+    size_t inflight; /* operations with completions outstanding */
+
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock;
+#endif
+
+    /* the ring */
+    UA_Int32 ringfd;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing; /* equals sqRing with IORING_FEAT_SINGLE_MMAP */
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned sqLocalTail; /* entries prepared, published when submitted */
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+
+    /* receive buffers registered with the kernel */
+    struct io_uring_buf_ring *bufRing;
+    size_t bufRingSize;
+    UA_Byte *bufs;
+    size_t bufSize;
+    size_t bufsFree;
+
+    /* jobs returned to the server. reused between the calls to getJobs. */
+    size_t jobsCapacity;
+    UA_Job *jobs;
+} ServerNetworkLayerIoUring;
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define IoUring_lock(layer) pthread_mutex_lock(&(layer)->lock)
+# define IoUring_unlock(layer) pthread_mutex_unlock(&(layer)->lock)
+#else
+# define IoUring_lock(layer)
+# define IoUring_unlock(layer)
+#endif
+
+/********/
+/* Ring */
+/********/
+
+static void
+IoUring_unmap(void **ptr, size_t size) {
+    if(*ptr && *ptr != MAP_FAILED)
+        munmap(*ptr, size);
+    *ptr = NULL;
+}
+
+static void
+IoUring_close(ServerNetworkLayerIoUring *layer) {
+    if(layer->cqRing == layer->sqRing)
+        layer->cqRing = NULL;
+    IoUring_unmap(&layer->cqRing, layer->cqRingSize);
+    IoUring_unmap(&layer->sqRing, layer->sqRingSize);
+    IoUring_unmap((void**)&layer->sqes, layer->sqesSize);
+    if(layer->ringfd >= 0)
+        close(layer->ringfd);
+    layer->ringfd = -1;
+    IoUring_unmap((void**)&layer->bufRing, layer->bufRingSize);
+    IoUring_unmap((void**)&layer->bufs, layer->bufSize * RECVBUFFERS);
+}
+
+/* Puts the receive buffer back into the ring. Call with the lock held. */
+static void
+IoUring_recycle(ServerNetworkLayerIoUring *layer, unsigned short bid) {
+    unsigned short tail = layer->bufRing->tail;
+    struct io_uring_buf *b = &layer->bufRing->bufs[tail & (RECVBUFFERS - 1)];
+    b->addr = (__u64)(uintptr_t)&layer->bufs[bid * layer->bufSize];
+    b->len = (__u32)layer->bufSize;
+    b->bid = bid;
+    __atomic_store_n(&layer->bufRing->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+    layer->bufsFree++;
+}
+
+static UA_StatusCode
+IoUring_init(ServerNetworkLayerIoUring *layer) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = RINGENTRIES * 4;
+    layer->ringfd = (UA_Int32)syscall(__NR_io_uring_setup, RINGENTRIES, &p);
+    if(layer->ringfd < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "io_uring is not available, errno %i", errno);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    if(!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "The io_uring of the kernel is too old");
+        goto error;
+    }
+
+    /* map the rings */
+    layer->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    layer->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        if(layer->cqRingSize > layer->sqRingSize)
+            layer->sqRingSize = layer->cqRingSize;
+        layer->cqRingSize = layer->sqRingSize;
+    }
+    layer->sqRing = mmap(NULL, layer->sqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, layer->ringfd, IORING_OFF_SQ_RING);
+    if(layer->sqRing == MAP_FAILED)
+        goto error;
+    if(p.features & IORING_FEAT_SINGLE_MMAP) {
+        layer->cqRing = layer->sqRing;
+    } else {
+        layer->cqRing = mmap(NULL, layer->cqRingSize, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, layer->ringfd, IORING_OFF_CQ_RING);
+        if(layer->cqRing == MAP_FAILED)
+            goto error;
+    }
+    layer->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    layer->sqes = mmap(NULL, layer->sqesSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, layer->ringfd, IORING_OFF_SQES);
+    if(layer->sqes == MAP_FAILED)
+        goto error;
+
+    UA_Byte *sq = layer->sqRing;
+    layer->sqHead = (unsigned*)(sq + p.sq_off.head);
+    layer->sqTail = (unsigned*)(sq + p.sq_off.tail);
+    layer->sqArray = (unsigned*)(sq + p.sq_off.array);
+    layer->sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    layer->sqEntries = p.sq_entries;
+    layer->sqLocalTail = *layer->sqTail;
+    UA_Byte *cq = layer->cqRing;
+    layer->cqHead = (unsigned*)(cq + p.cq_off.head);
+    layer->cqTail = (unsigned*)(cq + p.cq_off.tail);
+    layer->cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    layer->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    /* register the receive buffers */
+    layer->bufSize = layer->conf.recvBufferSize;
+    layer->bufRingSize = RECVBUFFERS * sizeof(struct io_uring_buf);
+    layer->bufRing = mmap(NULL, layer->bufRingSize, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    layer->bufs = mmap(NULL, layer->bufSize * RECVBUFFERS, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(layer->bufRing == MAP_FAILED || layer->bufs == MAP_FAILED)
+        goto error;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (__u64)(uintptr_t)layer->bufRing;
+    reg.ring_entries = RECVBUFFERS;
+    reg.bgid = BUFFERGROUP;
+    if(syscall(__NR_io_uring_register, layer->ringfd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Cannot register the receive buffers with io_uring, errno %i", errno);
+        goto error;
+    }
+    layer->bufsFree = 0;
+    for(unsigned short i = 0; i < RECVBUFFERS; i++)
+        IoUring_recycle(layer, i);
+    return UA_STATUSCODE_GOOD;
+
+ error:
+    if(layer->sqRing == MAP_FAILED || layer->cqRing == MAP_FAILED ||
+       layer->sqes == MAP_FAILED || layer->bufRing == MAP_FAILED || layer->bufs == MAP_FAILED)
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Cannot map the io_uring");
+    IoUring_close(layer);
+    return UA_STATUSCODE_BADINTERNALERROR;
+}
+
+/* Hands the prepared entries to the kernel. Call with the lock held. */
+static void
+IoUring_submit(ServerNetworkLayerIoUring *layer) {
+    unsigned pending = layer->sqLocalTail - __atomic_load_n(layer->sqHead, __ATOMIC_ACQUIRE);
+    if(pending == 0)
+        return;
+    __atomic_store_n(layer->sqTail, layer->sqLocalTail, __ATOMIC_RELEASE);
+    /* on failure (EAGAIN, EBUSY) the entries are submitted with the next call */
+    syscall(__NR_io_uring_enter, layer->ringfd, pending, 0, 0, NULL, 0);
+}
+
+/* Returns a cleared submission entry or NULL if the queue is full even after
+ * submitting. Call with the lock held. */
+static struct io_uring_sqe *
+IoUring_getSqe(ServerNetworkLayerIoUring *layer, void *data, UA_UInt32 op) {
+    unsigned head = __atomic_load_n(layer->sqHead, __ATOMIC_ACQUIRE);
+    if(layer->sqLocalTail - head >= layer->sqEntries) {
+        IoUring_submit(layer);
+        head = __atomic_load_n(layer->sqHead, __ATOMIC_ACQUIRE);
+        if(layer->sqLocalTail - head >= layer->sqEntries)
+            return NULL;
+    }
+    unsigned index = layer->sqLocalTail & layer->sqMask;
+    struct io_uring_sqe *sqe = &layer->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = (__u64)(uintptr_t)data | op;
+    layer->sqArray[index] = index;
+    layer->sqLocalTail++;
+    if(op != OP_CANCEL)
+        layer->inflight++;
+    return sqe;
+}
+
+static UA_StatusCode
+IoUring_armAccept(ServerNetworkLayerIoUring *layer) {
+    struct io_uring_sqe *sqe = IoUring_getSqe(layer, NULL, OP_ACCEPT);
+    if(!sqe)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = layer->serversockfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Starts the multishot receive or remembers the connection until receive
+ * buffers are returned. Call with the lock held. */
+static void
+IoUring_armRecv(ServerNetworkLayerIoUring *layer, IoUringConnection *ic) {
+    struct io_uring_sqe *sqe = NULL;
+    if(layer->bufsFree > 0)
+        sqe = IoUring_getSqe(layer, ic, OP_RECV);
+    if(!sqe) {
+        if(!ic->starved) {
+            ic->starved = true;
+            ic->nextStarved = layer->starved;
+            layer->starved = ic;
+        }
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = ic->connection.sockfd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFERGROUP;
+    ic->recvArmed = true;
+}
+
+/* Sends the queued buffers with one sendmsg. Call with the lock held. */
+static void
+IoUring_armSend(ServerNetworkLayerIoUring *layer, IoUringConnection *ic) {
+    struct io_uring_sqe *sqe = IoUring_getSqe(layer, ic, OP_SEND);
+    if(!sqe) {
+        /* retried with the next completion or send on the connection */
+        return;
+    }
+    size_t iovSize = 0;
+    for(; iovSize < MAXIOV && iovSize < ic->sendQueueCount; iovSize++) {
+        UA_ByteString *b = &ic->sendQueue[(ic->sendQueueStart + iovSize) % ic->sendQueueCapacity];
+        size_t skip = (iovSize == 0) ? ic->sendQueueOffset : 0;
+        ic->iov[iovSize].iov_base = b->data + skip;
+        ic->iov[iovSize].iov_len = b->length - skip;
+    }
+    memset(&ic->msg, 0, sizeof(ic->msg));
+    ic->msg.msg_iov = ic->iov;
+    ic->msg.msg_iovlen = iovSize;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = ic->connection.sockfd;
+    sqe->addr = (__u64)(uintptr_t)&ic->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    ic->sending = true;
+}
+
+/* Cancels all operations in flight */
+static void
+IoUring_cancelAll(ServerNetworkLayerIoUring *layer) {
+    struct io_uring_sqe *sqe = IoUring_getSqe(layer, NULL, OP_CANCEL);
+    if(!sqe)
+        return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+}
+
+/* Waits up to timeout us for a completion. Does not require the lock, the
+ * waiting thread does not touch the submission queue. */
+static void
+IoUring_wait(ServerNetworkLayerIoUring *layer, UA_UInt32 timeout) {
+    if(*layer->cqHead != __atomic_load_n(layer->cqTail, __ATOMIC_ACQUIRE) || timeout == 0)
+        return;
+    struct __kernel_timespec ts = {.tv_sec = timeout / 1000000,
+                                   .tv_nsec = (long long)(timeout % 1000000) * 1000};
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (__u64)(uintptr_t)&ts;
+    syscall(__NR_io_uring_enter, layer->ringfd, 0, 1,
+            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/***************/
+/* Connections */
+/***************/
+
+static void
+IoUringConnection_popQueue(IoUringConnection *ic) {
+    UA_ByteString_deleteMembers(IoUringConnection_queueHead(ic));
+    ic->sendQueueStart = (ic->sendQueueStart + 1) % ic->sendQueueCapacity;
+    ic->sendQueueCount--;
+    ic->sendQueueOffset = 0;
+}
+
+static void
+IoUringConnection_clearQueue(IoUringConnection *ic) {
+    while(ic->sendQueueCount > 0)
+        IoUringConnection_popQueue(ic);
+    ic->sendQueueSize = 0;
+}
+
+/* Appends the buffers to the queue and takes them over */
+static UA_StatusCode
+IoUringConnection_enqueue(IoUringConnection *ic, UA_ByteString *bufs, size_t bufsSize) {
+    if(ic->sendQueueCount + bufsSize > ic->sendQueueCapacity) {
+        size_t capacity = ic->sendQueueCapacity * 2;
+        if(capacity < ic->sendQueueCount + bufsSize)
+            capacity = ic->sendQueueCount + bufsSize;
+        if(capacity < 8)
+            capacity = 8;
+        UA_ByteString *q = malloc(sizeof(UA_ByteString) * capacity);
+        if(!q)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = 0; i < ic->sendQueueCount; i++)
+            q[i] = ic->sendQueue[(ic->sendQueueStart + i) % ic->sendQueueCapacity];
+        free(ic->sendQueue);
+        ic->sendQueue = q;
+        ic->sendQueueCapacity = capacity;
+        ic->sendQueueStart = 0;
+    }
+    for(size_t i = 0; i < bufsSize; i++) {
+        if(bufs[i].length == 0) {
+            UA_ByteString_deleteMembers(&bufs[i]);
+            continue;
+        }
+        size_t pos = (ic->sendQueueStart + ic->sendQueueCount) % ic->sendQueueCapacity;
+        ic->sendQueue[pos] = bufs[i];
+        ic->sendQueueCount++;
+        ic->sendQueueSize += bufs[i].length;
+        UA_ByteString_init(&bufs[i]);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+static void FreeConnectionCallback(UA_Server *server, void *ptr) {
+    IoUringConnection *ic = ptr;
+    IoUringConnection_clearQueue(ic);
+    free(ic->sendQueue);
+    close(ic->connection.sockfd);
+    UA_Connection_deleteMembers(&ic->connection);
+    free(ic);
+}
+
+static UA_StatusCode
+ServerNetworkLayerIoUring_getSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static void
+ServerNetworkLayerIoUring_releaseSendBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+}
+
+static void
+ServerNetworkLayerIoUring_releaseRecvBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    ServerNetworkLayerIoUring *layer = connection->handle;
+    if(!buf->data)
+        return;
+    size_t bid = (size_t)(buf->data - layer->bufs) / layer->bufSize;
+    IoUring_lock(layer);
+    IoUring_recycle(layer, (unsigned short)bid);
+    IoUring_unlock(layer);
+    UA_ByteString_init(buf);
+}
+
+/* Never blocks. The buffers are queued and sent asynchronously. A receiver
+ * that lets the queue grow beyond maxSendQueueSize is disconnected. */
+static UA_StatusCode
+ServerNetworkLayerIoUring_sendBatch(UA_Connection *connection, UA_ByteString *bufs, size_t bufsSize) {
+    IoUringConnection *ic = (IoUringConnection*)connection;
+    ServerNetworkLayerIoUring *layer = connection->handle;
+    size_t length = 0;
+    for(size_t i = 0; i < bufsSize; i++)
+        length += bufs[i].length;
+
+    IoUring_lock(layer);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_UInt32 limit = connection->localConf.maxSendQueueSize;
+    if(connection->state == UA_CONNECTION_CLOSED || ic->detached) {
+        retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+    } else if(limit > 0 && ic->sendQueueSize + length > limit) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i | The send queue is full, closing the connection",
+                       connection->sockfd);
+        retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+    } else {
+        retval = IoUringConnection_enqueue(ic, bufs, bufsSize);
+    }
+    if(retval == UA_STATUSCODE_GOOD && !ic->sending && ic->sendQueueCount > 0) {
+        IoUring_armSend(layer, ic);
+#ifdef UA_ENABLE_MULTITHREADING
+        IoUring_submit(layer); /* else submitted when the server flushes */
+#endif
+    }
+    IoUring_unlock(layer);
+
+    /* a partially sent message leaves the stream unusable */
+    if(retval != UA_STATUSCODE_GOOD && connection->state != UA_CONNECTION_CLOSED)
+        connection->close(connection);
+    for(size_t i = 0; i < bufsSize; i++)
+        UA_ByteString_deleteMembers(&bufs[i]);
+    return retval;
+}
+
+static UA_StatusCode
+ServerNetworkLayerIoUring_send(UA_Connection *connection, UA_ByteString *buf) {
+    return ServerNetworkLayerIoUring_sendBatch(connection, buf, 1);
+}
+
+/* callback triggered from the server. the queued messages are still sent,
+ * then the socket is shut down. this ends the receive, where the server is
+ * told to detach the connection. */
+static void
+ServerNetworkLayerIoUring_closeConnection(UA_Connection *connection) {
+    IoUringConnection *ic = (IoUringConnection*)connection;
+    ServerNetworkLayerIoUring *layer = connection->handle;
+    IoUring_lock(layer);
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        IoUring_unlock(layer);
+        return;
+    }
+    connection->state = UA_CONNECTION_CLOSED;
+    if(!ic->sending)
+        shutdown(connection->sockfd, SHUT_RDWR);
+    IoUring_unlock(layer);
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Connection %i | Force closing the connection", connection->sockfd);
+}
+
+/* call only from the network thread */
+static void
+ServerNetworkLayerIoUring_add(ServerNetworkLayerIoUring *layer, UA_Int32 newsockfd) {
+    IoUringConnection *ic = calloc(1, sizeof(IoUringConnection));
+    if(!ic) {
+        UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
+        close(newsockfd);
+        return;
+    }
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(struct sockaddr_in);
+    if(getpeername(newsockfd, (struct sockaddr*)&addr, &addrlen) == 0) {
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "Connection %i | New connection over TCP from %s:%d",
+                    newsockfd, inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    }
+    int i = 1;
+    setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY, (void *)&i, sizeof(i));
+
+    UA_Connection *c = &ic->connection;
+    UA_Connection_init(c);
+    c->sockfd = newsockfd;
+    c->handle = layer;
+    c->localConf = layer->conf;
+    c->send = ServerNetworkLayerIoUring_send;
+    c->sendBatch = ServerNetworkLayerIoUring_sendBatch;
+    c->close = ServerNetworkLayerIoUring_closeConnection;
+    c->getSendBuffer = ServerNetworkLayerIoUring_getSendBuffer;
+    c->releaseSendBuffer = ServerNetworkLayerIoUring_releaseSendBuffer;
+    c->releaseRecvBuffer = ServerNetworkLayerIoUring_releaseRecvBuffer;
+    c->state = UA_CONNECTION_OPENING;
+    ic->next = layer->connections;
+    layer->connections = ic;
+    layer->connectionsSize++;
+    IoUring_armRecv(layer, ic);
+}
+
+/* Unlinks the connection once nothing is in flight and returns the job that
+ * frees it (delayed until the workers are done with it). Call with the lock
+ * held. */
+static size_t
+ServerNetworkLayerIoUring_retire(ServerNetworkLayerIoUring *layer, IoUringConnection *ic, UA_Job *job) {
+    if(!ic->detached || ic->sending || ic->recvArmed || ic->starved)
+        return 0;
+    for(IoUringConnection **prev = &layer->connections; *prev; prev = &(*prev)->next) {
+        if(*prev == ic) {
+            *prev = ic->next;
+            break;
+        }
+    }
+    layer->connectionsSize--;
+    job->type = UA_JOBTYPE_METHODCALL_DELAYED;
+    job->job.methodCall.method = FreeConnectionCallback;
+    job->job.methodCall.data = ic;
+    job->priority = UA_JOBPRIORITY_NORMAL;
+    return 1;
+}
+
+/* The connection ended. The server is told to detach it. Returns the number
+ * of jobs. Call with the lock held. */
+static size_t
+ServerNetworkLayerIoUring_detach(ServerNetworkLayerIoUring *layer, IoUringConnection *ic, UA_Job *jobs) {
+    if(ic->detached)
+        return ServerNetworkLayerIoUring_retire(layer, ic, jobs);
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Connection %i | Connection closed", ic->connection.sockfd);
+    ic->connection.state = UA_CONNECTION_CLOSED;
+    ic->detached = true;
+    IoUringConnection_clearQueue(ic); /* the in-flight sendmsg fails */
+    shutdown(ic->connection.sockfd, SHUT_RDWR);
+    jobs[0].type = UA_JOBTYPE_DETACHCONNECTION;
+    jobs[0].job.closeConnection = &ic->connection;
+    jobs[0].priority = UA_JOBPRIORITY_NORMAL;
+    return 1 + ServerNetworkLayerIoUring_retire(layer, ic, &jobs[1]);
+}
+
+static void
+ServerNetworkLayerIoUring_sent(ServerNetworkLayerIoUring *layer, IoUringConnection *ic, __s32 res) {
+    ic->sending = false;
+    if(ic->detached)
+        return; /* the queue was dropped */
+    if(res < 0) {
+        if(res != -ECANCELED)
+            UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                        "Connection %i | Sending failed with errno %i", ic->connection.sockfd, -res);
+        IoUringConnection_clearQueue(ic);
+        ic->connection.state = UA_CONNECTION_CLOSED;
+        shutdown(ic->connection.sockfd, SHUT_RDWR);
+        return;
+    }
+    size_t sent = (size_t)res;
+    ic->sendQueueSize -= sent;
+    while(sent > 0 && ic->sendQueueCount > 0) {
+        size_t left = IoUringConnection_queueHead(ic)->length - ic->sendQueueOffset;
+        if(sent < left) {
+            ic->sendQueueOffset += sent;
+            break;
+        }
+        sent -= left;
+        IoUringConnection_popQueue(ic);
+    }
+    if(ic->sendQueueCount > 0 && !layer->stopping)
+        IoUring_armSend(layer, ic);
+    else if(ic->connection.state == UA_CONNECTION_CLOSED)
+        shutdown(ic->connection.sockfd, SHUT_RDWR); /* closed while sending */
+}
+
+/* Processes the available completions and returns the number of jobs */
+static size_t
+ServerNetworkLayerIoUring_reap(ServerNetworkLayerIoUring *layer) {
+    UA_Job *js = layer->jobs;
+    size_t j = 0;
+    unsigned head = *layer->cqHead;
+    unsigned tail = __atomic_load_n(layer->cqTail, __ATOMIC_ACQUIRE);
+    IoUring_lock(layer);
+    for(size_t k = 0; head != tail && k < MAXCOMPLETIONS; head++, k++) {
+        struct io_uring_cqe *cqe = &layer->cqes[head & layer->cqMask];
+        UA_UInt32 op = (UA_UInt32)(cqe->user_data & OP_MASK);
+        IoUringConnection *ic = (IoUringConnection*)(uintptr_t)(cqe->user_data & ~(__u64)OP_MASK);
+        UA_Boolean more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        if(op != OP_CANCEL && !more)
+            layer->inflight--;
+
+        switch(op) {
+        case OP_ACCEPT:
+            if(cqe->res >= 0) {
+                if(layer->stopping)
+                    close(cqe->res);
+                else
+                    ServerNetworkLayerIoUring_add(layer, cqe->res);
+            }
+            if(!more && !layer->stopping && IoUring_armAccept(layer) != UA_STATUSCODE_GOOD)
+                UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                               "Cannot accept new connections");
+            break;
+
+        case OP_RECV:
+            if(!more)
+                ic->recvArmed = false;
+            if(cqe->flags & IORING_CQE_F_BUFFER) {
+                layer->bufsFree--;
+                unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                if(cqe->res > 0 && ic->connection.state != UA_CONNECTION_CLOSED) {
+                    js[j].job.binaryMessage.connection = &ic->connection;
+                    js[j].job.binaryMessage.message.data = &layer->bufs[bid * layer->bufSize];
+                    js[j].job.binaryMessage.message.length = (size_t)cqe->res;
+                    js[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+                    js[j].priority = UA_JOBPRIORITY_NORMAL;
+                    j++;
+                } else {
+                    IoUring_recycle(layer, bid);
+                }
+            }
+            if(more || ic->detached)
+                break;
+            if(cqe->res == -ENOBUFS || (cqe->res > 0 && !layer->stopping))
+                IoUring_armRecv(layer, ic); /* starved until buffers are returned */
+            else
+                j += ServerNetworkLayerIoUring_detach(layer, ic, &js[j]);
+            break;
+
+        case OP_SEND:
+            ServerNetworkLayerIoUring_sent(layer, ic, cqe->res);
+            j += ServerNetworkLayerIoUring_retire(layer, ic, &js[j]);
+            break;
+
+        default:
+            break;
+        }
+    }
+    __atomic_store_n(layer->cqHead, head, __ATOMIC_RELEASE);
+    IoUring_unlock(layer);
+    return j;
+}
+
+/* Arms the receives of the connections that ran out of buffers. Closed
+ * connections are detached right away. Call with the lock held. */
+static size_t
+ServerNetworkLayerIoUring_rearm(ServerNetworkLayerIoUring *layer, UA_Job *jobs) {
+    size_t j = 0;
+    IoUringConnection *ic = layer->starved;
+    layer->starved = NULL;
+    while(ic) {
+        IoUringConnection *next = ic->nextStarved;
+        ic->starved = false;
+        ic->nextStarved = NULL;
+        if(ic->connection.state == UA_CONNECTION_CLOSED || layer->stopping)
+            j += ServerNetworkLayerIoUring_detach(layer, ic, &jobs[j]);
+        else
+            IoUring_armRecv(layer, ic);
+        ic = next;
+    }
+    return j;
+}
+
+/*****************/
+/* Network Layer */
+/*****************/
+
+/* Returns the jobs buffer with room for at least size jobs */
+static UA_Job *
+ServerNetworkLayerIoUring_reserveJobs(ServerNetworkLayerIoUring *layer, size_t size) {
+    if(size <= layer->jobsCapacity)
+        return layer->jobs;
+    UA_Job *js = realloc(layer->jobs, sizeof(UA_Job) * size);
+    if(!js)
+        return NULL;
+    layer->jobs = js;
+    layer->jobsCapacity = size;
+    return js;
+}
+
+static UA_StatusCode
+ServerNetworkLayerIoUring_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    ServerNetworkLayerIoUring *layer = nl->handle;
+    layer->logger = logger;
+    layer->stopping = false;
+
+    /* get the discovery url from the hostname */
+    UA_String du = UA_STRING_NULL;
+    char hostname[256];
+    char discoveryUrl[256];
+    if(gethostname(hostname, 255) == 0) {
+        du.length = (size_t)snprintf(discoveryUrl, 255, "opc.tcp://%s:%d", hostname, layer->port);
+        du.data = (UA_Byte*)discoveryUrl;
+    }
+    UA_String_copy(&du, &nl->discoveryUrl);
+
+    /* a completion carries two jobs at most */
+    if(!ServerNetworkLayerIoUring_reserveJobs(layer, MAXCOMPLETIONS * 2))
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(IoUring_init(layer) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    /* open the server socket */
+    if((layer->serversockfd = socket(PF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
+        IoUring_close(layer);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    const struct sockaddr_in serv_addr =
+        {.sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY,
+         .sin_port = htons(layer->port), .sin_zero = {0}};
+    int optval = 1;
+    if(setsockopt(layer->serversockfd, SOL_SOCKET, SO_REUSEADDR,
+                  (const char *)&optval, sizeof(optval)) == -1 ||
+       bind(layer->serversockfd, (const struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 ||
+       listen(layer->serversockfd, MAXBACKLOG) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during socket binding");
+        close(layer->serversockfd);
+        IoUring_close(layer);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    IoUring_armAccept(layer);
+    IoUring_submit(layer);
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "io_uring network layer listening on %.*s",
+                nl->discoveryUrl.length, nl->discoveryUrl.data);
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t
+ServerNetworkLayerIoUring_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt32 timeout) {
+    ServerNetworkLayerIoUring *layer = nl->handle;
+
+    /* the jobs of the receives rearmed now go out with the next call */
+    IoUring_lock(layer);
+    size_t j = ServerNetworkLayerIoUring_rearm(layer, layer->jobs);
+    IoUring_submit(layer);
+    IoUring_unlock(layer);
+    if(j > 0) {
+        *jobs = layer->jobs;
+        return j;
+    }
+
+    IoUring_wait(layer, timeout);
+    j = ServerNetworkLayerIoUring_reap(layer);
+
+    /* send what the completions queued up (e.g. the next part of a long
+       message) and rearm the accept/receives */
+    IoUring_lock(layer);
+    IoUring_submit(layer);
+    IoUring_unlock(layer);
+    *jobs = layer->jobs;
+    return j;
+}
+
+static void
+ServerNetworkLayerIoUring_flush(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerIoUring *layer = nl->handle;
+    IoUring_lock(layer);
+    IoUring_submit(layer);
+    IoUring_unlock(layer);
+}
+
+static size_t
+ServerNetworkLayerIoUring_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    ServerNetworkLayerIoUring *layer = nl->handle;
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                "Shutting down the io_uring network layer with %d open connection(s)",
+                layer->connectionsSize);
+
+    /* cancel everything in flight and wait until the kernel is done with the
+       connections and buffers */
+    IoUring_lock(layer);
+    layer->stopping = true;
+    shutdown(layer->serversockfd, SHUT_RDWR);
+    for(IoUringConnection *ic = layer->connections; ic; ic = ic->next) {
+        ic->connection.state = UA_CONNECTION_CLOSED;
+        shutdown(ic->connection.sockfd, SHUT_RDWR);
+    }
+    IoUring_cancelAll(layer);
+    IoUring_submit(layer);
+    IoUring_unlock(layer);
+
+    /* the server is told to detach all connections. those already detached
+       are only freed. */
+    size_t total = layer->connectionsSize * 2 + MAXCOMPLETIONS * 2;
+    UA_Job *items = malloc(sizeof(UA_Job) * total);
+    size_t j = 0;
+    for(size_t round = 0; layer->inflight > 0 && round < STOPROUNDS; round++) {
+        IoUring_wait(layer, STOPWAIT);
+        size_t reaped = ServerNetworkLayerIoUring_reap(layer);
+        if(items && j + reaped <= total) {
+            memcpy(&items[j], layer->jobs, sizeof(UA_Job) * reaped);
+            j += reaped;
+        }
+    }
+    if(layer->inflight > 0)
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "%d io_uring operations did not complete, leaking their connections",
+                       layer->inflight);
+    close(layer->serversockfd);
+    if(!items)
+        return 0;
+
+    /* received messages are discarded (the connections are closed) */
+    size_t k = 0;
+    for(size_t i = 0; i < j; i++) {
+        if(items[i].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER) {
+            UA_Connection *c = items[i].job.binaryMessage.connection;
+            c->releaseRecvBuffer(c, &items[i].job.binaryMessage.message);
+            continue;
+        }
+        items[k++] = items[i];
+    }
+    IoUring_lock(layer);
+    k += ServerNetworkLayerIoUring_rearm(layer, &items[k]);
+    IoUringConnection *next;
+    for(IoUringConnection *ic = layer->connections; ic; ic = next) {
+        next = ic->next;
+        if(k + 2 > total)
+            break;
+        k += ServerNetworkLayerIoUring_detach(layer, ic, &items[k]);
+    }
+    IoUring_unlock(layer);
+    free(layer->jobs);
+    layer->jobs = items;
+    layer->jobsCapacity = total;
+    *jobs = items;
+    return k;
+}
+
+/* run only when the server is stopped */
+static void
+ServerNetworkLayerIoUring_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerIoUring *layer = nl->handle;
+    IoUring_close(layer);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&layer->lock);
+#endif
+    free(layer->jobs);
+    free(layer);
+    UA_String_deleteMembers(&nl->discoveryUrl);
+}
+
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerIoUring(UA_ConnectionConfig conf, UA_UInt16 port) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    ServerNetworkLayerIoUring *layer = calloc(1, sizeof(ServerNetworkLayerIoUring));
+    if(!layer)
+        return nl;
+    layer->conf = conf;
+    layer->port = port;
+    layer->ringfd = -1;
+    layer->serversockfd = -1;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&layer->lock, NULL);
+#endif
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerIoUring_start;
+    nl.getJobs = ServerNetworkLayerIoUring_getJobs;
+    nl.flush = ServerNetworkLayerIoUring_flush;
+    nl.stop = ServerNetworkLayerIoUring_stop;
+    nl.deleteMembers = ServerNetworkLayerIoUring_deleteMembers;
+    return nl;
+}
@@ -0,0 +1,25 @@
+/* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
+
+#ifndef UA_NETWORK_IOURING_H_
+#define UA_NETWORK_IOURING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ua_server.h"
+
+/* TCP server network layer on the io_uring interface of Linux (6.0 or newer).
+ * The sockets are received with multishot receives into a ring of buffers
+ * registered with the kernel and the responses are sent asynchronously. So
+ * there is no system call per received or sent message. Starting the network
+ * layer fails with an older kernel. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerIoUring(UA_ConnectionConfig conf, UA_UInt16 port);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* UA_NETWORK_IOURING_H_ */
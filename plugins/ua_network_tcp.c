@@ -2,6 +2,7 @@
  * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
 
 #include "ua_network_tcp.h"
+#include "ua_trace.h"
 
 #include <stdlib.h> // malloc, free
 #include <stdio.h> // snprintf
@@ -22,6 +23,9 @@
 #  include <netinet/tcp.h>
 # endif
 # include <sys/ioctl.h>
+# include <sys/uio.h> // iovec
+# include <sys/un.h> // sockaddr_un
+# include <sys/stat.h> // lstat
 # include <netdb.h> //gethostbyname for the client
 # include <unistd.h> // read, write, close
 # include <arpa/inet.h>
@@ -45,7 +49,21 @@
 # define UA_fd_isset(fd, fds) FD_ISSET((unsigned int)fd, fds)
 #endif
 
+/* readiness backend of the server network layer. epoll on linux, kqueue on the
+   bsds and macos. select is the fallback and limited to FD_SETSIZE sockets. */
+#if defined(__linux__)
+# define UA_TCP_EPOLL
+# include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || \
+      defined(__NetBSD__) || defined(__DragonFly__)
+# define UA_TCP_KQUEUE
+# include <sys/types.h>
+# include <sys/event.h>
+# include <sys/time.h>
+#endif
+
 #ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
 # include <urcu/uatomic.h>
 #endif
 
@@ -53,6 +71,244 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+/***************/
+/* Buffer Pool */
+/***************/
+
+/* Send and receive buffers are recycled through size-classed free lists.
+ * Every thread keeps a small cache per size class that is used without
+ * locking. A full or empty cache exchanges half of its buffers with the shared
+ * depot. Buffers above the largest size class bypass the pool. */
+
+#define POOL_MINSHIFT 10   /* the smallest class holds 1 KiB */
+#define POOL_CLASSES 7     /* the largest class holds 64 KiB */
+#define POOL_CACHESIZE 16  /* buffers per class in a thread cache */
+#define POOL_DEPOTSIZE 256 /* buffers per class in the shared depot */
+
+/* Header in front of every buffer handed out */
+typedef struct PoolBuffer {
+    struct PoolBuffer *next;
+    size_t sizeClass; /* POOL_CLASSES if not pooled */
+} PoolBuffer;
+
+typedef struct PoolCache {
+    PoolBuffer *lists[POOL_CLASSES];
+    size_t counts[POOL_CLASSES];
+    UA_NetworkBufferPoolStatistics statistics;
+#ifdef UA_ENABLE_MULTITHREADING
+    struct PoolCache *next; /* all thread caches are listed in the depot */
+#endif
+} PoolCache;
+
+static PoolCache depot;
+
+#ifdef UA_ENABLE_MULTITHREADING
+static pthread_mutex_t depotLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t cacheKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t cacheKey;
+static PoolCache *threadCaches;
+# define depot_lock() pthread_mutex_lock(&depotLock)
+# define depot_unlock() pthread_mutex_unlock(&depotLock)
+#else
+static PoolCache mainCache;
+# define depot_lock()
+# define depot_unlock()
+#endif
+
+static size_t
+BufferPool_sizeClass(size_t length) {
+    size_t c = 0;
+    while(c < POOL_CLASSES && ((size_t)1 << (c + POOL_MINSHIFT)) < length)
+        c++;
+    return c;
+}
+
+/* Moves count buffers of a class from one cache to the other. Call with the
+ * depot lock held. */
+static void
+PoolCache_move(PoolCache *from, PoolCache *to, size_t c, size_t count) {
+    for(; count > 0 && from->lists[c]; count--) {
+        PoolBuffer *b = from->lists[c];
+        from->lists[c] = b->next;
+        from->counts[c]--;
+        b->next = to->lists[c];
+        to->lists[c] = b;
+        to->counts[c]++;
+    }
+}
+
+/* Frees all cached buffers. Call with the depot lock held. */
+static void
+PoolCache_clear(PoolCache *cache) {
+    for(size_t c = 0; c < POOL_CLASSES; c++) {
+        while(cache->lists[c]) {
+            PoolBuffer *b = cache->lists[c];
+            cache->lists[c] = b->next;
+            free(b);
+            cache->statistics.released++;
+        }
+        cache->counts[c] = 0;
+    }
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+/* A thread ends. Its buffers and counters go to the depot. */
+static void
+BufferPool_retireCache(void *data) {
+    PoolCache *cache = data;
+    depot_lock();
+    for(PoolCache **prev = &threadCaches; *prev; prev = &(*prev)->next) {
+        if(*prev == cache) {
+            *prev = cache->next;
+            break;
+        }
+    }
+    for(size_t c = 0; c < POOL_CLASSES; c++) {
+        size_t room = depot.counts[c] < POOL_DEPOTSIZE ? POOL_DEPOTSIZE - depot.counts[c] : 0;
+        PoolCache_move(cache, &depot, c, room);
+    }
+    PoolCache_clear(cache);
+    depot.statistics.hits += cache->statistics.hits;
+    depot.statistics.misses += cache->statistics.misses;
+    depot.statistics.released += cache->statistics.released;
+    depot_unlock();
+    free(cache);
+}
+
+static void
+BufferPool_createKey(void) {
+    pthread_key_create(&cacheKey, BufferPool_retireCache);
+}
+
+/* Returns NULL if no cache can be allocated. The pool is bypassed then. */
+static PoolCache *
+BufferPool_getCache(void) {
+    pthread_once(&cacheKeyOnce, BufferPool_createKey);
+    PoolCache *cache = pthread_getspecific(cacheKey);
+    if(cache)
+        return cache;
+    cache = calloc(1, sizeof(PoolCache));
+    if(!cache)
+        return NULL;
+    if(pthread_setspecific(cacheKey, cache) != 0) {
+        free(cache);
+        return NULL;
+    }
+    depot_lock();
+    cache->next = threadCaches;
+    threadCaches = cache;
+    depot_unlock();
+    return cache;
+}
+
+#else
+
+static PoolCache *
+BufferPool_getCache(void) {
+    return &mainCache;
+}
+
+#endif
+
+static UA_StatusCode
+BufferPool_alloc(UA_ByteString *buf, size_t length) {
+    if(length == 0) {
+        UA_ByteString_init(buf);
+        return UA_STATUSCODE_GOOD;
+    }
+    size_t c = BufferPool_sizeClass(length);
+    PoolCache *cache = BufferPool_getCache();
+    PoolBuffer *b = NULL;
+    if(cache && c < POOL_CLASSES) {
+        if(!cache->lists[c]) {
+            depot_lock();
+            PoolCache_move(&depot, cache, c, POOL_CACHESIZE / 2);
+            depot_unlock();
+        }
+        b = cache->lists[c];
+        if(b) {
+            cache->lists[c] = b->next;
+            cache->counts[c]--;
+            cache->statistics.hits++;
+        }
+    }
+    if(!b) {
+        size_t size = (c < POOL_CLASSES) ? ((size_t)1 << (c + POOL_MINSHIFT)) : length;
+        b = malloc(sizeof(PoolBuffer) + size);
+        if(!b) {
+            UA_ByteString_init(buf);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        b->sizeClass = c;
+        if(cache)
+            cache->statistics.misses++;
+    }
+    buf->data = (UA_Byte*)&b[1];
+    buf->length = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+BufferPool_release(UA_ByteString *buf) {
+    if(!buf->data)
+        return;
+    PoolBuffer *b = &((PoolBuffer*)buf->data)[-1];
+    UA_ByteString_init(buf);
+    size_t c = b->sizeClass;
+    PoolCache *cache = BufferPool_getCache();
+    if(!cache || c >= POOL_CLASSES) {
+        free(b);
+        if(cache)
+            cache->statistics.released++;
+        return;
+    }
+    if(cache->counts[c] >= POOL_CACHESIZE) {
+        depot_lock();
+        PoolCache_move(cache, &depot, c, POOL_CACHESIZE / 2);
+        while(depot.counts[c] > POOL_DEPOTSIZE) {
+            PoolBuffer *d = depot.lists[c];
+            depot.lists[c] = d->next;
+            depot.counts[c]--;
+            free(d);
+            cache->statistics.released++;
+        }
+        depot_unlock();
+    }
+    b->next = cache->lists[c];
+    cache->lists[c] = b;
+    cache->counts[c]++;
+}
+
+void
+UA_NetworkBufferPool_getStatistics(UA_NetworkBufferPoolStatistics *stats) {
+    depot_lock();
+    *stats = depot.statistics;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* the counters of other threads are read without synchronization */
+    for(PoolCache *cache = threadCaches; cache; cache = cache->next) {
+        stats->hits += cache->statistics.hits;
+        stats->misses += cache->statistics.misses;
+        stats->released += cache->statistics.released;
+    }
+#else
+    stats->hits += mainCache.statistics.hits;
+    stats->misses += mainCache.statistics.misses;
+    stats->released += mainCache.statistics.released;
+#endif
+    depot_unlock();
+}
+
+void
+UA_NetworkBufferPool_trim(void) {
+    PoolCache *cache = BufferPool_getCache();
+    depot_lock();
+    if(cache)
+        PoolCache_clear(cache);
+    PoolCache_clear(&depot);
+    depot_unlock();
+}
+
 /****************************/
 /* Generic Socket Functions */
 /****************************/
@@ -81,7 +337,7 @@ socket_write(UA_Connection *connection, UA_ByteString *buf) {
             if(n < 0 && last_error != WSAEINTR && last_error != WSAEWOULDBLOCK) {
                 connection->close(connection);
                 socket_close(connection);
-                UA_ByteString_deleteMembers(buf);
+                BufferPool_release(buf);
                 return UA_STATUSCODE_BADCONNECTIONCLOSED;
             }
 #else
@@ -89,24 +345,26 @@ socket_write(UA_Connection *connection, UA_ByteString *buf) {
             if(n == -1L && errno != EINTR && errno != EAGAIN) {
                 connection->close(connection);
                 socket_close(connection);
-                UA_ByteString_deleteMembers(buf);
+                BufferPool_release(buf);
                 return UA_STATUSCODE_BADCONNECTIONCLOSED;
             }
 #endif
         } while(n == -1L);
+        UA_TRACE2(bytes_written, connection->sockfd, n);
         nWritten += (size_t)n;
     } while(nWritten < buf->length);
-    UA_ByteString_deleteMembers(buf);
+    BufferPool_release(buf);
     return UA_STATUSCODE_GOOD;
 }
 
+/* Receives into the ring of the connection. So the client reuses the same
+ * buffer for every receive. */
 static UA_StatusCode
 socket_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeout) {
-    response->data = malloc(connection->localConf.recvBufferSize);
-    if(!response->data) {
-        response->length = 0;
+    UA_ByteString space;
+    if(UA_Connection_getRecvSpace(connection, &space) != UA_STATUSCODE_GOOD)
         return UA_STATUSCODE_BADOUTOFMEMORY; /* not enough memory retry */
-    }
+    UA_ByteString_init(response);
 
     if(timeout > 0) {
         /* currently, only the client uses timeouts */
@@ -123,7 +381,6 @@ socket_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeou
         int ret = setsockopt(connection->sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout_dw, sizeof(DWORD));
 #endif
         if(0 != ret) {
-            UA_ByteString_deleteMembers(response);
             socket_close(connection);
             return UA_STATUSCODE_BADCONNECTIONCLOSED;
         }
@@ -147,28 +404,30 @@ socket_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeou
         UA_fd_set(connection->sockfd, &fdset);
         retval = select(connection->sockfd+1, &fdset, NULL, NULL, &tmptv);
         if(retval && UA_fd_isset(connection->sockfd, &fdset)) {
-            ret = recv(connection->sockfd, (char*)response->data, connection->localConf.recvBufferSize, 0);
+            ret = recv(connection->sockfd, (char*)space.data, connection->localConf.recvBufferSize, 0);
         } else {
-            ret = 0;
+            return UA_STATUSCODE_GOODNONCRITICALTIMEOUT;
         }
     } else {
-        ret = recv(connection->sockfd, (char*)response->data, connection->localConf.recvBufferSize, 0);
+        ret = recv(connection->sockfd, (char*)space.data, connection->localConf.recvBufferSize, 0);
     }
 #else
-    ssize_t ret = recv(connection->sockfd, (char*)response->data, connection->localConf.recvBufferSize, 0);
+    ssize_t ret = recv(connection->sockfd, (char*)space.data, connection->localConf.recvBufferSize, 0);
 #endif
 
     if(ret == 0) {
         /* server has closed the connection */
-        UA_ByteString_deleteMembers(response);
         socket_close(connection);
         return UA_STATUSCODE_BADCONNECTIONCLOSED;
     } else if(ret < 0) {
-        UA_ByteString_deleteMembers(response);
 #ifdef _WIN32
         const int last_error = WSAGetLastError();
+        if(timeout > 0 && (last_error == WSAETIMEDOUT || last_error == WSAEWOULDBLOCK))
+            return UA_STATUSCODE_GOODNONCRITICALTIMEOUT;
         #define TEST_RETRY (last_error == WSAEINTR || (timeout > 0) ? 0 : (last_error == WSAEWOULDBLOCK))
 #else
+        if(timeout > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return UA_STATUSCODE_GOODNONCRITICALTIMEOUT; /* nothing received in time */
         #define TEST_RETRY (errno == EINTR || (timeout > 0) ? 0 : (errno == EAGAIN || errno == EWOULDBLOCK))
 #endif
         if (TEST_RETRY)
@@ -178,6 +437,40 @@ socket_recv(UA_Connection *connection, UA_ByteString *response, UA_UInt32 timeou
             return UA_STATUSCODE_BADCONNECTIONCLOSED;
         }
     }
+    response->data = space.data;
+    response->length = (size_t)ret;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Receive into the ring of the connection. So no copy is needed when a message
+ * was received partially. */
+static UA_StatusCode
+ServerNetworkLayerTCP_recv(UA_Connection *connection, UA_ByteString *response) {
+    UA_ByteString space;
+    if(UA_Connection_getRecvSpace(connection, &space) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY; /* not enough memory retry */
+    UA_ByteString_init(response);
+#ifdef _WIN32
+    int ret = recv(connection->sockfd, (char*)space.data, (int)space.length, 0);
+#else
+    ssize_t ret = recv(connection->sockfd, (char*)space.data, space.length, 0);
+#endif
+    if(ret == 0) {
+        /* the client has closed the connection */
+        socket_close(connection);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    } else if(ret < 0) {
+#ifdef _WIN32
+        const int last_error = WSAGetLastError();
+        if(last_error == WSAEINTR || last_error == WSAEWOULDBLOCK)
+#else
+        if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+            return UA_STATUSCODE_GOOD; /* retry */
+        socket_close(connection);
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+    response->data = space.data;
     response->length = (size_t)ret;
     return UA_STATUSCODE_GOOD;
 }
@@ -195,11 +488,6 @@ static UA_StatusCode socket_set_nonblocking(UA_Int32 sockfd) {
     return UA_STATUSCODE_GOOD;
 }
 
-static void FreeConnectionCallback(UA_Server *server, void *ptr) {
-    UA_Connection_deleteMembers((UA_Connection*)ptr);
-    free(ptr);
- }
-
 /***************************/
 /* Server NetworkLayer TCP */
 /***************************/
@@ -235,10 +523,56 @@ static void FreeConnectionCallback(UA_Server *server, void *ptr) {
  */
 
 #define MAXBACKLOG 100
+#define MAXEVENTS 256 /* ready sockets handled per call to getJobs */
+
+/* Server connections queue the messages that are not sent right away in a
+ * ring of buffers. The queue is sent with a single gathering system call once
+ * the socket is writable. In the single-threaded mode, the connections are
+ * corked: Everything sent while the server processes the jobs of an iteration
+ * is queued and sent together when the server flushes the network layer (or
+ * asks for new jobs). The UA_Connection is the
+ * first member, so the pointer handed to the server can be cast back. */
+typedef struct TCPConnection {
+    UA_Connection connection;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t sendLock; /* workers send, the network thread flushes */
+#else
+    struct TCPConnection *nextCorked; /* in the list of the layer */
+    UA_Boolean corked;
+#endif
+    UA_ByteString *sendQueue;
+    size_t sendQueueCapacity;
+    size_t sendQueueStart;
+    size_t sendQueueCount;
+    size_t sendQueueOffset; /* bytes of the first buffer already sent */
+    size_t sendQueueSize;   /* bytes not yet sent */
+    UA_Boolean writeArmed;  /* the backend reports writability */
+} TCPConnection;
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define TCPConnection_lock(tc) pthread_mutex_lock(&(tc)->sendLock)
+# define TCPConnection_unlock(tc) pthread_mutex_unlock(&(tc)->sendLock)
+#else
+# define TCPConnection_lock(tc)
+# define TCPConnection_unlock(tc)
+#endif
+
+#define TCPConnection_queueHead(tc) \
+    (&(tc)->sendQueue[(tc)->sendQueueStart])
+
+static void
+TCPConnection_popQueue(TCPConnection *tc) {
+    BufferPool_release(TCPConnection_queueHead(tc));
+    tc->sendQueueStart = (tc->sendQueueStart + 1) % tc->sendQueueCapacity;
+    tc->sendQueueCount--;
+    tc->sendQueueOffset = 0;
+}
 
 typedef struct {
     UA_ConnectionConfig conf;
     UA_UInt16 port;
+    UA_Boolean reusePort; /* bind with SO_REUSEPORT */
+    char *socketPath; /* listen on a Unix domain socket instead of the port */
     UA_Logger logger; // Set during start
 
     /* open sockets and connections */
@@ -248,23 +582,252 @@ typedef struct {
         UA_Connection *connection;
         UA_Int32 sockfd;
     } *mappings;
+
+#ifndef UA_ENABLE_MULTITHREADING
+    TCPConnection *corked; /* connections with messages queued since the last getJobs */
+#endif
+
+#if defined(UA_TCP_EPOLL) || defined(UA_TCP_KQUEUE)
+    /* the epoll/kqueue descriptor. the event data points to the connection,
+       or is NULL for the server socket. */
+    UA_Int32 pollfd;
+#endif
+#ifdef UA_HAVE_EPOLL_PWAIT2
+    UA_Boolean noPwait2; /* the kernel is older than 5.11 */
+#endif
+
+    /* connections with pending events found by the last wait */
+    size_t readyCapacity;
+    struct ReadyConnection {
+        TCPConnection *connection;
+        UA_Boolean readable;
+        UA_Boolean writable;
+    } *ready;
+
+    /* jobs returned to the server. reused between the calls to getJobs. */
+    size_t jobsCapacity;
+    UA_Job *jobs;
 } ServerNetworkLayerTCP;
 
+static void FreeConnectionCallback(UA_Server *server, void *ptr) {
+    TCPConnection *tc = ptr;
+    while(tc->sendQueueCount > 0)
+        TCPConnection_popQueue(tc);
+    free(tc->sendQueue);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&tc->sendLock);
+#else
+    if(tc->corked) {
+        /* remove from the list of corked connections */
+        ServerNetworkLayerTCP *layer = tc->connection.handle;
+        for(TCPConnection **prev = &layer->corked; *prev; prev = &(*prev)->nextCorked) {
+            if(*prev == tc) {
+                *prev = tc->nextCorked;
+                break;
+            }
+        }
+    }
+#endif
+    UA_Connection_deleteMembers(&tc->connection);
+    free(tc);
+}
+
+/* Returns the jobs buffer with room for at least size jobs */
+static UA_Job *
+ServerNetworkLayerTCP_reserveJobs(ServerNetworkLayerTCP *layer, size_t size) {
+    if(size <= layer->jobsCapacity)
+        return layer->jobs;
+    UA_Job *js = realloc(layer->jobs, sizeof(UA_Job) * size);
+    if(!js)
+        return NULL;
+    layer->jobs = js;
+    layer->jobsCapacity = size;
+    return js;
+}
+
 static UA_StatusCode
 ServerNetworkLayerGetSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
     if(length > connection->remoteConf.recvBufferSize)
         return UA_STATUSCODE_BADCOMMUNICATIONERROR;
-    return UA_ByteString_allocBuffer(buf, length);
+    return BufferPool_alloc(buf, length);
 }
 
 static void
 ServerNetworkLayerReleaseSendBuffer(UA_Connection *connection, UA_ByteString *buf) {
-    UA_ByteString_deleteMembers(buf);
+    BufferPool_release(buf);
 }
 
 static void
 ServerNetworkLayerReleaseRecvBuffer(UA_Connection *connection, UA_ByteString *buf) {
-    UA_ByteString_deleteMembers(buf);
+    /* the server connections receive into the ring of the connection */
+    UA_Connection_releaseRecvRing(connection, buf);
+}
+
+/* Returns the buffer for the ready connections with room for at least size entries */
+static struct ReadyConnection *
+ServerNetworkLayerTCP_reserveReady(ServerNetworkLayerTCP *layer, size_t size) {
+    if(size <= layer->readyCapacity)
+        return layer->ready;
+    struct ReadyConnection *r = realloc(layer->ready, sizeof(struct ReadyConnection) * size);
+    if(!r)
+        return NULL;
+    layer->ready = r;
+    layer->readyCapacity = size;
+    return r;
+}
+
+#if defined(UA_TCP_EPOLL)
+
+static UA_StatusCode
+ServerNetworkLayerTCP_initPoll(ServerNetworkLayerTCP *layer) {
+    layer->pollfd = epoll_create1(EPOLL_CLOEXEC);
+    if(layer->pollfd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* the socket is removed from the epoll set implicitly when it is closed */
+static UA_StatusCode
+ServerNetworkLayerTCP_watch(ServerNetworkLayerTCP *layer, UA_Int32 sockfd, TCPConnection *tc) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = tc;
+    if(epoll_ctl(layer->pollfd, EPOLL_CTL_ADD, sockfd, &ev) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* call with the send lock held */
+static void
+ServerNetworkLayerTCP_armWrite(ServerNetworkLayerTCP *layer, TCPConnection *tc, UA_Boolean arm) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = arm ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.ptr = tc;
+    epoll_ctl(layer->pollfd, EPOLL_CTL_MOD, tc->connection.sockfd, &ev);
+    tc->writeArmed = arm;
+}
+
+/* waits with microsecond resolution if the kernel supports it. otherwise, the
+   timeout is rounded up to the next millisecond. the jobs are late then, but
+   the loop does not spin. */
+static int
+epollWait(ServerNetworkLayerTCP *layer, struct epoll_event *events, UA_UInt32 timeout) {
+#ifdef UA_HAVE_EPOLL_PWAIT2
+    if(!layer->noPwait2) {
+        struct timespec tmpts = {timeout / 1000000, (long)(timeout % 1000000) * 1000};
+        int n = epoll_pwait2(layer->pollfd, events, MAXEVENTS, &tmpts, NULL);
+        if(n >= 0 || errno != ENOSYS)
+            return n;
+        layer->noPwait2 = true;
+    }
+#endif
+    return epoll_wait(layer->pollfd, events, MAXEVENTS, (int)((timeout + 999) / 1000));
+}
+
+static size_t
+ServerNetworkLayerTCP_wait(ServerNetworkLayerTCP *layer, UA_UInt32 timeout,
+                           UA_Boolean *acceptable) {
+    struct epoll_event events[MAXEVENTS];
+    *acceptable = false;
+    struct ReadyConnection *ready = ServerNetworkLayerTCP_reserveReady(layer, MAXEVENTS);
+    if(!ready)
+        return 0;
+    int n = epollWait(layer, events, timeout);
+    size_t readySize = 0;
+    for(int i = 0; i < n; i++) {
+        if(!events[i].data.ptr) {
+            *acceptable = true;
+            continue;
+        }
+        ready[readySize].connection = events[i].data.ptr;
+        ready[readySize].readable = (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+        ready[readySize].writable = (events[i].events & EPOLLOUT) != 0;
+        readySize++;
+    }
+    return readySize;
+}
+
+#elif defined(UA_TCP_KQUEUE)
+
+static UA_StatusCode
+ServerNetworkLayerTCP_initPoll(ServerNetworkLayerTCP *layer) {
+    layer->pollfd = kqueue();
+    if(layer->pollfd < 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* the socket is removed from the kqueue implicitly when it is closed */
+static UA_StatusCode
+ServerNetworkLayerTCP_watch(ServerNetworkLayerTCP *layer, UA_Int32 sockfd, TCPConnection *tc) {
+    struct kevent ev;
+    EV_SET(&ev, sockfd, EVFILT_READ, EV_ADD, 0, 0, tc);
+    if(kevent(layer->pollfd, &ev, 1, NULL, 0, NULL) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* call with the send lock held */
+static void
+ServerNetworkLayerTCP_armWrite(ServerNetworkLayerTCP *layer, TCPConnection *tc, UA_Boolean arm) {
+    struct kevent ev;
+    EV_SET(&ev, tc->connection.sockfd, EVFILT_WRITE, arm ? EV_ADD : EV_DELETE, 0, 0, tc);
+    kevent(layer->pollfd, &ev, 1, NULL, 0, NULL);
+    tc->writeArmed = arm;
+}
+
+static size_t
+ServerNetworkLayerTCP_wait(ServerNetworkLayerTCP *layer, UA_UInt32 timeout,
+                           UA_Boolean *acceptable) {
+    struct kevent events[MAXEVENTS];
+    *acceptable = false;
+    struct ReadyConnection *ready = ServerNetworkLayerTCP_reserveReady(layer, MAXEVENTS);
+    if(!ready)
+        return 0;
+    struct timespec tmpts = {timeout / 1000000, (long)(timeout % 1000000) * 1000};
+    int n = kevent(layer->pollfd, NULL, 0, events, MAXEVENTS, &tmpts);
+    size_t readySize = 0;
+    for(int i = 0; i < n; i++) {
+        if(!events[i].udata) {
+            *acceptable = true;
+            continue;
+        }
+        /* read and write readiness arrive as separate events */
+        ready[readySize].connection = events[i].udata;
+        ready[readySize].readable = (events[i].filter == EVFILT_READ);
+        ready[readySize].writable = (events[i].filter == EVFILT_WRITE);
+        readySize++;
+    }
+    return readySize;
+}
+
+#else
+
+static UA_StatusCode
+ServerNetworkLayerTCP_initPoll(ServerNetworkLayerTCP *layer) {
+    return UA_STATUSCODE_GOOD;
+}
+
+/* select can only watch sockets below FD_SETSIZE (except on windows, where
+   FD_SETSIZE limits the number of sockets in the set) */
+static UA_StatusCode
+ServerNetworkLayerTCP_watch(ServerNetworkLayerTCP *layer, UA_Int32 sockfd, TCPConnection *tc) {
+#ifdef _WIN32
+    if(layer->mappingsSize >= FD_SETSIZE)
+        return UA_STATUSCODE_BADMAXCONNECTIONSREACHED;
+#else
+    if(sockfd >= FD_SETSIZE)
+        return UA_STATUSCODE_BADMAXCONNECTIONSREACHED;
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
+/* call with the send lock held. the flag is picked up by the next select. */
+static void
+ServerNetworkLayerTCP_armWrite(ServerNetworkLayerTCP *layer, TCPConnection *tc, UA_Boolean arm) {
+    tc->writeArmed = arm;
 }
 
 /* after every select, we need to reset the sockets we want to listen on */
@@ -281,6 +844,251 @@ setFDSet(ServerNetworkLayerTCP *layer, fd_set *fdset) {
     return highestfd;
 }
 
+static size_t
+ServerNetworkLayerTCP_wait(ServerNetworkLayerTCP *layer, UA_UInt32 timeout,
+                           UA_Boolean *acceptable) {
+    *acceptable = false;
+    struct ReadyConnection *ready = ServerNetworkLayerTCP_reserveReady(layer, layer->mappingsSize);
+    if(!ready && layer->mappingsSize > 0)
+        return 0;
+    fd_set fdset, errset, writeset;
+    UA_Int32 highestfd = setFDSet(layer, &fdset);
+    setFDSet(layer, &errset);
+    FD_ZERO(&writeset);
+    for(size_t i = 0; i < layer->mappingsSize; i++) {
+        if(((TCPConnection*)layer->mappings[i].connection)->writeArmed)
+            UA_fd_set(layer->mappings[i].sockfd, &writeset);
+    }
+    struct timeval tmptv = {timeout / 1000000, timeout % 1000000};
+    UA_Int32 resultsize = select(highestfd+1, &fdset, &writeset, &errset, &tmptv);
+    if(resultsize <= 0)
+        return 0;
+    if(UA_fd_isset(layer->serversockfd, &fdset))
+        *acceptable = true;
+    size_t readySize = 0;
+    for(size_t i = 0; i < layer->mappingsSize; i++) {
+        UA_Int32 sockfd = layer->mappings[i].sockfd;
+        UA_Boolean readable = UA_fd_isset(sockfd, &errset) || UA_fd_isset(sockfd, &fdset);
+        UA_Boolean writable = UA_fd_isset(sockfd, &writeset);
+        if(!readable && !writable)
+            continue;
+        ready[readySize].connection = (TCPConnection*)layer->mappings[i].connection;
+        ready[readySize].readable = readable;
+        ready[readySize].writable = writable;
+        readySize++;
+    }
+    return readySize;
+}
+
+#endif
+
+static void
+ServerNetworkLayerTCP_closePoll(ServerNetworkLayerTCP *layer) {
+#if defined(UA_TCP_EPOLL) || defined(UA_TCP_KQUEUE)
+    if(layer->pollfd >= 0)
+        close(layer->pollfd);
+    layer->pollfd = -1;
+#endif
+}
+
+/* swap-remove the connection from the mappings. only called when a connection
+   closes, the ready sockets are found without scanning the mappings. */
+static void
+ServerNetworkLayerTCP_remove(ServerNetworkLayerTCP *layer, UA_Connection *c) {
+    for(size_t i = 0; i < layer->mappingsSize; i++) {
+        if(layer->mappings[i].connection != c)
+            continue;
+        layer->mappings[i] = layer->mappings[layer->mappingsSize-1];
+        layer->mappingsSize--;
+        return;
+    }
+}
+
+#define MAXIOV 64 /* buffers gathered into one system call */
+
+#ifdef _WIN32
+typedef WSABUF UA_IoVec;
+# define UA_IOVEC_SET(v, d, l) do { (v)->buf = (char*)(d); (v)->len = (ULONG)(l); } while(0)
+#else
+typedef struct iovec UA_IoVec;
+# define UA_IOVEC_SET(v, d, l) do { (v)->iov_base = (d); (v)->iov_len = (l); } while(0)
+#endif
+
+/* Sends as much of the buffers as the socket takes without blocking. Returns
+ * the number of bytes sent or -1 if the connection is broken. */
+static ssize_t
+socket_sendv(UA_Int32 sockfd, UA_IoVec *iov, size_t iovSize) {
+    while(true) {
+#ifdef _WIN32
+        DWORD n = 0;
+        if(WSASend((SOCKET)sockfd, iov, (DWORD)iovSize, &n, 0, NULL, NULL) == 0)
+            return (ssize_t)n;
+        const int last_error = WSAGetLastError();
+        if(last_error == WSAEINTR)
+            continue;
+        return (last_error == WSAEWOULDBLOCK) ? 0 : -1;
+#else
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovSize;
+        ssize_t n = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if(n >= 0)
+            return n;
+        if(errno == EINTR)
+            continue;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+#endif
+    }
+}
+
+/* Sends queued buffers until the socket would block. Call with the send lock
+ * held. */
+static UA_StatusCode
+TCPConnection_flush(TCPConnection *tc) {
+    while(tc->sendQueueCount > 0) {
+        UA_IoVec iov[MAXIOV];
+        size_t iovSize = 0;
+        for(; iovSize < MAXIOV && iovSize < tc->sendQueueCount; iovSize++) {
+            UA_ByteString *b = &tc->sendQueue[(tc->sendQueueStart + iovSize) % tc->sendQueueCapacity];
+            size_t skip = (iovSize == 0) ? tc->sendQueueOffset : 0;
+            UA_IOVEC_SET(&iov[iovSize], b->data + skip, b->length - skip);
+        }
+        ssize_t n = socket_sendv(tc->connection.sockfd, iov, iovSize);
+        if(n < 0)
+            return UA_STATUSCODE_BADCONNECTIONCLOSED;
+        if(n == 0)
+            return UA_STATUSCODE_GOOD;
+        UA_TRACE2(bytes_written, tc->connection.sockfd, n);
+        size_t sent = (size_t)n;
+        tc->sendQueueSize -= sent;
+        while(sent > 0) {
+            size_t left = TCPConnection_queueHead(tc)->length - tc->sendQueueOffset;
+            if(sent < left) {
+                tc->sendQueueOffset += sent;
+                break;
+            }
+            sent -= left;
+            TCPConnection_popQueue(tc);
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Appends the buffers to the queue and takes them over. Call with the send
+ * lock held. */
+static UA_StatusCode
+TCPConnection_enqueue(TCPConnection *tc, UA_ByteString *bufs, size_t bufsSize) {
+    if(tc->sendQueueCount + bufsSize > tc->sendQueueCapacity) {
+        size_t capacity = tc->sendQueueCapacity * 2;
+        if(capacity < tc->sendQueueCount + bufsSize)
+            capacity = tc->sendQueueCount + bufsSize;
+        if(capacity < 8)
+            capacity = 8;
+        UA_ByteString *q = malloc(sizeof(UA_ByteString) * capacity);
+        if(!q)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = 0; i < tc->sendQueueCount; i++)
+            q[i] = tc->sendQueue[(tc->sendQueueStart + i) % tc->sendQueueCapacity];
+        free(tc->sendQueue);
+        tc->sendQueue = q;
+        tc->sendQueueCapacity = capacity;
+        tc->sendQueueStart = 0;
+    }
+    for(size_t i = 0; i < bufsSize; i++) {
+        if(bufs[i].length == 0) {
+            BufferPool_release(&bufs[i]);
+            continue;
+        }
+        size_t pos = (tc->sendQueueStart + tc->sendQueueCount) % tc->sendQueueCapacity;
+        tc->sendQueue[pos] = bufs[i];
+        tc->sendQueueCount++;
+        tc->sendQueueSize += bufs[i].length;
+        UA_ByteString_init(&bufs[i]);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Never blocks. What the socket does not take is queued on the connection and
+ * sent from getJobs once the socket is writable again. A receiver that lets
+ * the queue grow beyond maxSendQueueSize is disconnected. */
+static UA_StatusCode
+ServerNetworkLayerTCP_sendBatch(UA_Connection *connection, UA_ByteString *bufs, size_t bufsSize) {
+    TCPConnection *tc = (TCPConnection*)connection;
+    ServerNetworkLayerTCP *layer = connection->handle;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(connection->state == UA_CONNECTION_CLOSED) {
+        retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+        goto cleanup;
+    }
+
+    size_t length = 0;
+    for(size_t i = 0; i < bufsSize; i++)
+        length += bufs[i].length;
+
+    TCPConnection_lock(tc);
+    UA_UInt32 limit = connection->localConf.maxSendQueueSize;
+    if(limit > 0 && tc->sendQueueSize + length > limit) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i | The send queue is full, closing the connection",
+                       connection->sockfd);
+        retval = UA_STATUSCODE_BADCONNECTIONCLOSED;
+    } else {
+        retval = TCPConnection_enqueue(tc, bufs, bufsSize);
+    }
+    if(retval == UA_STATUSCODE_GOOD) {
+#ifdef UA_ENABLE_MULTITHREADING
+        /* send right away unless we wait for the socket to become writable */
+        if(!tc->writeArmed)
+            retval = TCPConnection_flush(tc);
+        if(retval == UA_STATUSCODE_GOOD && tc->sendQueueCount > 0 && !tc->writeArmed)
+            ServerNetworkLayerTCP_armWrite(layer, tc, true);
+#else
+        /* cork until the next call to getJobs */
+        if(!tc->corked) {
+            tc->corked = true;
+            tc->nextCorked = layer->corked;
+            layer->corked = tc;
+        }
+#endif
+    }
+    TCPConnection_unlock(tc);
+
+    /* a partially sent message leaves the stream unusable */
+    if(retval != UA_STATUSCODE_GOOD)
+        connection->close(connection);
+
+ cleanup:
+    for(size_t i = 0; i < bufsSize; i++)
+        BufferPool_release(&bufs[i]);
+    return retval;
+}
+
+static UA_StatusCode
+ServerNetworkLayerTCP_send(UA_Connection *connection, UA_ByteString *buf) {
+    return ServerNetworkLayerTCP_sendBatch(connection, buf, 1);
+}
+
+#ifndef UA_ENABLE_MULTITHREADING
+/* Sends what was queued for the corked connections since the last call. Runs
+ * at the beginning of getJobs and when the server has processed the jobs. */
+static void
+ServerNetworkLayerTCP_uncork(ServerNetworkLayerTCP *layer) {
+    while(layer->corked) {
+        TCPConnection *tc = layer->corked;
+        layer->corked = tc->nextCorked;
+        tc->nextCorked = NULL;
+        tc->corked = false;
+        if(tc->connection.state == UA_CONNECTION_CLOSED || tc->writeArmed)
+            continue;
+        if(TCPConnection_flush(tc) != UA_STATUSCODE_GOOD)
+            tc->connection.close(&tc->connection);
+        else if(tc->sendQueueCount > 0)
+            ServerNetworkLayerTCP_armWrite(layer, tc, true);
+    }
+}
+#endif
+
 /* callback triggered from the server */
 static void
 ServerNetworkLayerTCP_closeConnection(UA_Connection *connection) {
@@ -298,22 +1106,29 @@ ServerNetworkLayerTCP_closeConnection(UA_Connection *connection) {
     UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Connection %i | Force closing the connection",
                 connection->sockfd);
 #endif
-    /* only "shutdown" here. this triggers the select, where the socket is
-       "closed" in the mainloop */
+    /* send what is still queued (without blocking). only "shutdown" here. this
+       triggers the select, where the socket is "closed" in the mainloop */
+    TCPConnection *tc = (TCPConnection*)connection;
+    TCPConnection_lock(tc);
+    TCPConnection_flush(tc);
+    TCPConnection_unlock(tc);
     shutdown(connection->sockfd, 2);
 }
 
 /* call only from the single networking thread */
 static UA_StatusCode
 ServerNetworkLayerTCP_add(ServerNetworkLayerTCP *layer, UA_Int32 newsockfd) {
-    UA_Connection *c = malloc(sizeof(UA_Connection));
-    if(!c)
+    TCPConnection *tc = calloc(1, sizeof(TCPConnection));
+    if(!tc)
         return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Connection *c = &tc->connection;
 
     struct sockaddr_in addr;
     socklen_t addrlen = sizeof(struct sockaddr_in);
-    int res = getpeername(newsockfd, (struct sockaddr*)&addr, &addrlen);
-    if(res == 0) {
+    if(layer->socketPath) {
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Connection %i | New connection over %s",
+                    newsockfd, layer->socketPath);
+    } else if(getpeername(newsockfd, (struct sockaddr*)&addr, &addrlen) == 0) {
         UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Connection %i | New connection over TCP from %s:%d",
                     newsockfd, inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
     } else {
@@ -324,7 +1139,8 @@ ServerNetworkLayerTCP_add(ServerNetworkLayerTCP *layer, UA_Int32 newsockfd) {
     c->sockfd = newsockfd;
     c->handle = layer;
     c->localConf = layer->conf;
-    c->send = socket_write;
+    c->send = ServerNetworkLayerTCP_send;
+    c->sendBatch = ServerNetworkLayerTCP_sendBatch;
     c->close = ServerNetworkLayerTCP_closeConnection;
     c->getSendBuffer = ServerNetworkLayerGetSendBuffer;
     c->releaseSendBuffer = ServerNetworkLayerReleaseSendBuffer;
@@ -334,25 +1150,32 @@ ServerNetworkLayerTCP_add(ServerNetworkLayerTCP *layer, UA_Int32 newsockfd) {
     nm = realloc(layer->mappings, sizeof(struct ConnectionMapping)*(layer->mappingsSize+1));
     if(!nm) {
         UA_LOG_ERROR(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for a new Connection");
-        free(c);
+        free(tc);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
     layer->mappings = nm;
+    UA_StatusCode retval = ServerNetworkLayerTCP_watch(layer, newsockfd, tc);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "Connection %i | Cannot watch the socket, closing the connection", newsockfd);
+        free(tc);
+        return retval;
+    }
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&tc->sendLock, NULL);
+#endif
     layer->mappings[layer->mappingsSize] = (struct ConnectionMapping){c, newsockfd};
     layer->mappingsSize++;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
-    ServerNetworkLayerTCP *layer = nl->handle;
-    layer->logger = logger;
-
+ServerNetworkLayerTCP_bind(UA_ServerNetworkLayer *nl, ServerNetworkLayerTCP *layer) {
     /* get the discovery url from the hostname */
     UA_String du = UA_STRING_NULL;
     char hostname[256];
+    char discoveryUrl[256];
     if(gethostname(hostname, 255) == 0) {
-        char discoveryUrl[256];
 #ifndef _MSC_VER
         du.length = (size_t)snprintf(discoveryUrl, 255, "opc.tcp://%s:%d", hostname, layer->port);
 #else
@@ -387,112 +1210,225 @@ ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
         CLOSESOCKET(layer->serversockfd);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
+    if(layer->reusePort) {
+#ifdef SO_REUSEPORT
+        if(setsockopt(layer->serversockfd, SOL_SOCKET,
+                      SO_REUSEPORT, (const char *)&optval, sizeof(optval)) == -1) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                           "Error during setting of SO_REUSEPORT");
+            CLOSESOCKET(layer->serversockfd);
+            return UA_STATUSCODE_BADINTERNALERROR;
+        }
+#else
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK,
+                       "SO_REUSEPORT is not supported on this platform");
+#endif
+    }
     if(bind(layer->serversockfd, (const struct sockaddr *)&serv_addr,
             sizeof(serv_addr)) < 0) {
         UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during socket binding");
         CLOSESOCKET(layer->serversockfd);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
+    return UA_STATUSCODE_GOOD;
+}
+
+#ifndef _WIN32
+/* Removes the socket file of a previous run that was not shut down. Only a
+ * socket that refuses connections is removed. Other files and the sockets of
+ * running servers are kept, so that the bind fails. */
+static void
+ServerNetworkLayerUnix_removeStale(ServerNetworkLayerTCP *layer, const struct sockaddr_un *addr) {
+    struct stat st;
+    if(lstat(layer->socketPath, &st) != 0 || !S_ISSOCK(st.st_mode))
+        return;
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(probe < 0)
+        return;
+    socket_set_nonblocking(probe); /* the backlog of a running server can be full */
+    if(connect(probe, (const struct sockaddr *)addr, sizeof(*addr)) < 0 && errno == ECONNREFUSED) {
+        UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
+                    "Removing the stale socket file %s", layer->socketPath);
+        unlink(layer->socketPath);
+    }
+    CLOSESOCKET(probe);
+}
+
+static UA_StatusCode
+ServerNetworkLayerUnix_bind(UA_ServerNetworkLayer *nl, ServerNetworkLayerTCP *layer) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    size_t pathLength = strlen(layer->socketPath);
+    if(pathLength >= sizeof(addr.sun_path)) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "The socket path is too long");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    memcpy(addr.sun_path, layer->socketPath, pathLength);
+
+    char discoveryUrl[sizeof(addr.sun_path) + 16];
+    UA_String du;
+    du.length = (size_t)snprintf(discoveryUrl, sizeof(discoveryUrl), "opc.unix://%s",
+                                 layer->socketPath);
+    du.data = (UA_Byte*)discoveryUrl;
+    UA_String_copy(&du, &nl->discoveryUrl);
+
+    if((layer->serversockfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    ServerNetworkLayerUnix_removeStale(layer, &addr);
+    if(bind(layer->serversockfd, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error during socket binding");
+        CLOSESOCKET(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+#endif
+
+static UA_StatusCode
+ServerNetworkLayerTCP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    ServerNetworkLayerTCP *layer = nl->handle;
+    layer->logger = logger;
+#ifndef _WIN32
+    UA_StatusCode retval = layer->socketPath ? ServerNetworkLayerUnix_bind(nl, layer) :
+        ServerNetworkLayerTCP_bind(nl, layer);
+#else
+    UA_StatusCode retval = ServerNetworkLayerTCP_bind(nl, layer);
+#endif
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
     socket_set_nonblocking(layer->serversockfd);
     listen(layer->serversockfd, MAXBACKLOG);
-    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "TCP network layer listening on %.*s",
+    if(ServerNetworkLayerTCP_initPoll(layer) != UA_STATUSCODE_GOOD ||
+       ServerNetworkLayerTCP_watch(layer, layer->serversockfd, NULL) != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error setting up the event backend");
+        ServerNetworkLayerTCP_closePoll(layer);
+        CLOSESOCKET(layer->serversockfd);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Network layer listening on %.*s",
                 nl->discoveryUrl.length, nl->discoveryUrl.data);
     return UA_STATUSCODE_GOOD;
 }
 
 static size_t
-ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+ServerNetworkLayerTCP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt32 timeout) {
     ServerNetworkLayerTCP *layer = nl->handle;
-    fd_set fdset, errset;
-    UA_Int32 highestfd = setFDSet(layer, &fdset);
-    setFDSet(layer, &errset);
-    struct timeval tmptv = {0, timeout * 1000};
-    UA_Int32 resultsize = select(highestfd+1, &fdset, NULL, &errset, &tmptv);
-    if(resultsize < 0) {
-        *jobs = NULL;
-        return 0;
-    }
+#ifndef UA_ENABLE_MULTITHREADING
+    ServerNetworkLayerTCP_uncork(layer);
+#endif
+    UA_Boolean acceptable = false;
+    size_t readySize = ServerNetworkLayerTCP_wait(layer, timeout, &acceptable);
 
-    /* accept new connections (can only be a single one) */
-    if(UA_fd_isset(layer->serversockfd, &fdset)) {
-        resultsize--;
+    /* accept all pending connections (up to the backlog) */
+    for(size_t k = 0; acceptable && k < MAXBACKLOG; k++) {
         struct sockaddr_in cli_addr;
         socklen_t cli_len = sizeof(cli_addr);
         int newsockfd = accept(layer->serversockfd, (struct sockaddr *) &cli_addr, &cli_len);
         int i = 1;
-        if(newsockfd >= 0) {
-            /* Send messages directly and do wait to merge packets (disable Nagle's algorithm) */
+        if(newsockfd < 0)
+            break;
+        /* Send messages directly and do wait to merge packets (disable Nagle's algorithm) */
+        if(!layer->socketPath)
             setsockopt(newsockfd, IPPROTO_TCP, TCP_NODELAY, (void *)&i, sizeof(i));
-
-            socket_set_nonblocking(newsockfd);
-            ServerNetworkLayerTCP_add(layer, newsockfd);
-        }
+        socket_set_nonblocking(newsockfd);
+        if(ServerNetworkLayerTCP_add(layer, newsockfd) != UA_STATUSCODE_GOOD)
+            CLOSESOCKET(newsockfd);
     }
 
     /* alloc enough space for a cleanup-connection and free-connection job per resulted socket */
-    if(resultsize == 0)
+    if(readySize == 0)
         return 0;
-    UA_Job *js = malloc(sizeof(UA_Job) * (size_t)resultsize * 2);
+    UA_Job *js = ServerNetworkLayerTCP_reserveJobs(layer, readySize * 2);
     if(!js)
         return 0;
 
     /* read from established sockets */
     size_t j = 0;
     UA_ByteString buf = UA_BYTESTRING_NULL;
-    for(size_t i = 0; i < layer->mappingsSize && j < (size_t)resultsize; i++) {
-        if(!UA_fd_isset(layer->mappings[i].sockfd, &errset) &&
-           !UA_fd_isset(layer->mappings[i].sockfd, &fdset))
-          continue;
+    for(size_t i = 0; i < readySize; i++) {
+        TCPConnection *tc = layer->ready[i].connection;
+        UA_Connection *c = &tc->connection;
 
-        UA_StatusCode retval = socket_recv(layer->mappings[i].connection, &buf, 0);
+        /* send the queued messages */
+        if(layer->ready[i].writable && c->state != UA_CONNECTION_CLOSED) {
+            TCPConnection_lock(tc);
+            UA_StatusCode retval = TCPConnection_flush(tc);
+            if(retval == UA_STATUSCODE_GOOD && tc->sendQueueCount == 0 && tc->writeArmed)
+                ServerNetworkLayerTCP_armWrite(layer, tc, false);
+            TCPConnection_unlock(tc);
+            if(retval != UA_STATUSCODE_GOOD)
+                c->close(c); /* the read below detects the closed socket */
+        }
+
+        if(!layer->ready[i].readable)
+            continue;
+        UA_StatusCode retval = ServerNetworkLayerTCP_recv(c, &buf);
         if(retval == UA_STATUSCODE_GOOD) {
-            js[j].job.binaryMessage.connection = layer->mappings[i].connection;
+            if(buf.length == 0)
+                continue; /* spurious wakeup */
+            js[j].job.binaryMessage.connection = c;
             js[j].job.binaryMessage.message = buf;
             js[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+            js[j].priority = UA_JOBPRIORITY_NORMAL;
             j++;
         } else if (retval == UA_STATUSCODE_BADCONNECTIONCLOSED) {
-            UA_Connection *c = layer->mappings[i].connection;
             UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
                         "Connection %i | Connection closed from remote", c->sockfd);
             /* the socket was closed from remote */
             js[j].type = UA_JOBTYPE_DETACHCONNECTION;
-            js[j].job.closeConnection = layer->mappings[i].connection;
-            layer->mappings[i] = layer->mappings[layer->mappingsSize-1];
-            layer->mappingsSize--;
+            js[j].job.closeConnection = c;
+            js[j].priority = UA_JOBPRIORITY_NORMAL;
+            ServerNetworkLayerTCP_remove(layer, c);
             j++;
             js[j].type = UA_JOBTYPE_METHODCALL_DELAYED;
             js[j].job.methodCall.method = FreeConnectionCallback;
             js[j].job.methodCall.data = c;
+            js[j].priority = UA_JOBPRIORITY_NORMAL;
             j++;
         }
     }
 
-    if(j == 0) {
-        free(js);
-        js = NULL;
-    }
-
     *jobs = js;
     return j;
 }
 
+static void
+ServerNetworkLayerTCP_flush(UA_ServerNetworkLayer *nl) {
+#ifndef UA_ENABLE_MULTITHREADING
+    ServerNetworkLayerTCP_uncork(nl->handle);
+#endif
+}
+
 static size_t
 ServerNetworkLayerTCP_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
     ServerNetworkLayerTCP *layer = nl->handle;
     UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK,
                 "Shutting down the TCP network layer with %d open connection(s)", layer->mappingsSize);
+#ifndef UA_ENABLE_MULTITHREADING
+    ServerNetworkLayerTCP_uncork(layer); /* best effort, does not block */
+#endif
     shutdown(layer->serversockfd,2);
     CLOSESOCKET(layer->serversockfd);
-    UA_Job *items = malloc(sizeof(UA_Job) * layer->mappingsSize * 2);
+#ifndef _WIN32
+    if(layer->socketPath)
+        unlink(layer->socketPath);
+#endif
+    ServerNetworkLayerTCP_closePoll(layer);
+    UA_Job *items = ServerNetworkLayerTCP_reserveJobs(layer, layer->mappingsSize * 2);
     if(!items)
         return 0;
     for(size_t i = 0; i < layer->mappingsSize; i++) {
         socket_close(layer->mappings[i].connection);
         items[i*2].type = UA_JOBTYPE_DETACHCONNECTION;
         items[i*2].job.closeConnection = layer->mappings[i].connection;
+        items[i*2].priority = UA_JOBPRIORITY_NORMAL;
         items[(i*2)+1].type = UA_JOBTYPE_METHODCALL_DELAYED;
         items[(i*2)+1].job.methodCall.method = FreeConnectionCallback;
         items[(i*2)+1].job.methodCall.data = layer->mappings[i].connection;
+        items[(i*2)+1].priority = UA_JOBPRIORITY_NORMAL;
     }
 #ifdef _WIN32
     WSACleanup();
@@ -505,7 +1441,11 @@ ServerNetworkLayerTCP_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
 static void ServerNetworkLayerTCP_deleteMembers(UA_ServerNetworkLayer *nl) {
     ServerNetworkLayerTCP *layer = nl->handle;
     free(layer->mappings);
+    free(layer->ready);
+    free(layer->jobs);
+    free(layer->socketPath);
     free(layer);
+    UA_NetworkBufferPool_trim();
     UA_String_deleteMembers(&nl->discoveryUrl);
 }
 
@@ -526,15 +1466,46 @@ UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port) {
     
     layer->conf = conf;
     layer->port = port;
+#if defined(UA_TCP_EPOLL) || defined(UA_TCP_KQUEUE)
+    layer->pollfd = -1;
+#endif
 
     nl.handle = layer;
     nl.start = ServerNetworkLayerTCP_start;
     nl.getJobs = ServerNetworkLayerTCP_getJobs;
+    nl.flush = ServerNetworkLayerTCP_flush;
     nl.stop = ServerNetworkLayerTCP_stop;
     nl.deleteMembers = ServerNetworkLayerTCP_deleteMembers;
     return nl;
 }
 
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerTCPReusePort(UA_ConnectionConfig conf, UA_UInt16 port) {
+    UA_ServerNetworkLayer nl = UA_ServerNetworkLayerTCP(conf, port);
+    if(nl.handle)
+        ((ServerNetworkLayerTCP*)nl.handle)->reusePort = true;
+    return nl;
+}
+
+#ifndef _WIN32
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerUnix(UA_ConnectionConfig conf, const char *socketPath) {
+    UA_ServerNetworkLayer nl = UA_ServerNetworkLayerTCP(conf, 0);
+    ServerNetworkLayerTCP *layer = nl.handle;
+    if(!layer)
+        return nl;
+    size_t pathLength = strlen(socketPath);
+    layer->socketPath = malloc(pathLength + 1);
+    if(!layer->socketPath) {
+        free(layer);
+        nl.handle = NULL;
+        return nl;
+    }
+    memcpy(layer->socketPath, socketPath, pathLength + 1);
+    return nl;
+}
+#endif
+
 /***************************/
 /* Client NetworkLayer TCP */
 /***************************/
@@ -545,12 +1516,17 @@ ClientNetworkLayerGetBuffer(UA_Connection *connection, size_t length, UA_ByteStr
         return UA_STATUSCODE_BADCOMMUNICATIONERROR;
     if(connection->state == UA_CONNECTION_CLOSED)
         return UA_STATUSCODE_BADCONNECTIONCLOSED;
-    return UA_ByteString_allocBuffer(buf, connection->remoteConf.recvBufferSize);
+    return BufferPool_alloc(buf, connection->remoteConf.recvBufferSize);
 }
 
 static void
 ClientNetworkLayerReleaseBuffer(UA_Connection *connection, UA_ByteString *buf) {
-    UA_ByteString_deleteMembers(buf);
+    BufferPool_release(buf);
+}
+
+static void
+ClientNetworkLayerReleaseRecvBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_Connection_releaseRecvRing(connection, buf);
 }
 
 static void
@@ -566,20 +1542,23 @@ ClientNetworkLayerClose(UA_Connection *connection) {
     socket_close(connection);
 }
 
+static void
+ClientConnection_init(UA_Connection *connection, UA_ConnectionConfig localConf) {
+    UA_Connection_init(connection);
+    connection->localConf = localConf;
+    connection->send = socket_write;
+    connection->recv = socket_recv;
+    connection->close = ClientNetworkLayerClose;
+    connection->getSendBuffer = ClientNetworkLayerGetBuffer;
+    connection->releaseSendBuffer = ClientNetworkLayerReleaseBuffer;
+    connection->releaseRecvBuffer = ClientNetworkLayerReleaseRecvBuffer;
+}
+
 /* we have no networklayer. instead, attach the reusable buffer to the handle */
 UA_Connection
 UA_ClientConnectionTCP(UA_ConnectionConfig localConf, const char *endpointUrl, UA_Logger logger) {
     UA_Connection connection;
-    UA_Connection_init(&connection);
-    connection.localConf = localConf;
-
-    //socket_set_nonblocking(connection.sockfd);
-    connection.send = socket_write;
-    connection.recv = socket_recv;
-    connection.close = ClientNetworkLayerClose;
-    connection.getSendBuffer = ClientNetworkLayerGetBuffer;
-    connection.releaseSendBuffer = ClientNetworkLayerReleaseBuffer;
-    connection.releaseRecvBuffer = ClientNetworkLayerReleaseBuffer;
+    ClientConnection_init(&connection, localConf);
 
     size_t urlLength = strlen(endpointUrl);
     if(urlLength < 11 || urlLength >= 512) {
@@ -650,3 +1629,46 @@ UA_ClientConnectionTCP(UA_ConnectionConfig localConf, const char *endpointUrl, U
 
     return connection;
 }
+
+#ifndef _WIN32
+UA_Connection
+UA_ClientConnectionUnix(UA_ConnectionConfig localConf, const char *endpointUrl, UA_Logger logger) {
+    UA_Connection connection;
+    ClientConnection_init(&connection, localConf);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    if(strncmp(endpointUrl, "opc.unix://", 11) != 0) {
+        UA_LOG_WARNING((*logger), UA_LOGCATEGORY_NETWORK, "Server url does not begin with opc.unix://");
+        return connection;
+    }
+    size_t pathLength = strlen(&endpointUrl[11]);
+    if(pathLength == 0 || pathLength >= sizeof(addr.sun_path)) {
+        UA_LOG_WARNING((*logger), UA_LOGCATEGORY_NETWORK, "Socket path size invalid");
+        return connection;
+    }
+    memcpy(addr.sun_path, &endpointUrl[11], pathLength);
+
+    if((connection.sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        UA_LOG_WARNING((*logger), UA_LOGCATEGORY_NETWORK, "Could not create socket");
+        return connection;
+    }
+    connection.state = UA_CONNECTION_OPENING;
+    if(connect(connection.sockfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        ClientNetworkLayerClose(&connection);
+        UA_LOG_WARNING((*logger), UA_LOGCATEGORY_NETWORK, "Connection failed");
+        return connection;
+    }
+
+#ifdef SO_NOSIGPIPE
+    int val = 1;
+    if(setsockopt(connection.sockfd, SOL_SOCKET, SO_NOSIGPIPE, (void*)&val, sizeof(val)) < 0) {
+        UA_LOG_WARNING((*logger), UA_LOGCATEGORY_NETWORK, "Couldn't set SO_NOSIGPIPE");
+        return connection;
+    }
+#endif
+
+    return connection;
+}
+#endif
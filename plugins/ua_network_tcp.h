@@ -14,9 +14,46 @@ extern "C" {
 UA_ServerNetworkLayer UA_EXPORT
 UA_ServerNetworkLayerTCP(UA_ConnectionConfig conf, UA_UInt16 port);
 
+/* Binds the listening socket with SO_REUSEPORT. Several of these network
+ * layers can listen on the same port and the kernel spreads the incoming
+ * connections over them. Use with the networkReactors of the server config. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerTCPReusePort(UA_ConnectionConfig conf, UA_UInt16 port);
+
 UA_Connection UA_EXPORT
 UA_ClientConnectionTCP(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
 
+#ifndef _WIN32
+/* Clients on the same host connect over a Unix domain socket instead of the
+ * loopback interface. The messages are framed as over TCP. The discovery url
+ * of the network layer is opc.unix:// followed by the path of the socket. The
+ * socket file is created when the server starts and removed when it stops. A
+ * socket file that is left from a previous run is replaced. The start fails if
+ * the path is another file or the socket of a running server. */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerUnix(UA_ConnectionConfig conf, const char *socketPath);
+
+/* Connects to an endpointUrl of the form opc.unix://<socket path> */
+UA_Connection UA_EXPORT
+UA_ClientConnectionUnix(UA_ConnectionConfig conf, const char *endpointUrl, UA_Logger logger);
+#endif
+
+/* The send and receive buffers of the TCP connections are taken from a pool
+ * that is shared by all server and client connections. */
+typedef struct {
+    size_t hits;     /* buffers reused from the pool */
+    size_t misses;   /* buffers that had to be allocated */
+    size_t released; /* buffers returned to the heap */
+} UA_NetworkBufferPoolStatistics;
+
+void UA_EXPORT
+UA_NetworkBufferPool_getStatistics(UA_NetworkBufferPoolStatistics *stats);
+
+/* Returns the buffers cached by the calling thread and the shared buffers to
+ * the heap. Buffers cached by other threads are returned when they end. */
+void UA_EXPORT
+UA_NetworkBufferPool_trim(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1,104 +1,224 @@
 /* This work is licensed under a Creative Commons CCZero 1.0 Universal License.
  * See http://creativecommons.org/publicdomain/zero/1.0/ for more information. */
 
-#include "networklayer_udp.h"
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* recvmmsg, sendmmsg */
+#endif
+
+#include "ua_network_udp.h"
 #include <stdlib.h> // malloc, free
 #include <stdio.h>
 #include <string.h> // memset
 
 #ifdef UA_ENABLE_MULTITHREADING
-# include <urcu/uatomic.h>
+# include <pthread.h>
 #endif
 
 /* with a space so amalgamation does not remove the includes */
 # include <errno.h> // errno, EINTR
 # include <fcntl.h> // fcntl
-# include <strings.h> //bzero
 # include <sys/select.h>
+# include <sys/socket.h>
+# include <sys/uio.h> // iovec
 # include <netinet/in.h>
-# include <netinet/tcp.h>
-# include <sys/socketvar.h>
-# include <sys/ioctl.h>
 # include <unistd.h> // read, write, close
 # include <arpa/inet.h>
-#ifdef __QNX__
-#include <sys/socket.h>
-#endif
 # define CLOSESOCKET(S) close(S)
 
-#define MAXBACKLOG 100
-
 #ifdef _WIN32
 # error udp not yet implemented for windows
 #endif
 
-/*****************************/
-/* Generic Buffer Management */
-/*****************************/
-
-static UA_StatusCode GetMallocedBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
-    if(length > connection->remoteConf.recvBufferSize)
-        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
-    return UA_ByteString_newMembers(buf, connection->remoteConf.recvBufferSize);
-}
+/* receive and send several datagrams per system call */
+#if defined(__linux__)
+# define UA_UDP_MMSG
+#endif
 
-static void ReleaseMallocedBuffer(UA_Connection *connection, UA_ByteString *buf) {
-    UA_ByteString_deleteMembers(buf);
-}
+#define RECVBATCH 64 /* datagrams received per call to getJobs */
+#define SENDBATCH 64 /* datagrams sent with one system call */
+#define UA_UDP_PUBLISHER_MAXMESSAGE 1472 /* the payload of an unfragmented
+                                            datagram on ethernet */
 
 /*********************/
 /* UDP Network Layer */
 /*********************/
 
 /* Forwarded to the server as a (UA_Connection) and used for callbacks back into
-   the networklayer */
+   the networklayer. The layer owns one per slot of the receive ring. */
 typedef struct {
     UA_Connection connection;
-    struct sockaddr from;
+    struct sockaddr_storage from;
     socklen_t fromlen;
+    UA_Boolean inUse; /* until the server releases the datagram */
 } UDPConnection;
 
 typedef struct {
-    UA_ServerNetworkLayer layer;
+    UA_ByteString buf;
+    struct sockaddr_storage to;
+    socklen_t tolen;
+} UDPDatagram;
+
+typedef struct {
     UA_ConnectionConfig conf;
-    fd_set fdset;
+    UA_UInt16 port;
+    UA_Logger logger; // Set during start
     UA_Int32 serversockfd;
-    UA_UInt32 port;
-} ServerNetworkLayerUDP;
 
-/** Accesses only the sockfd in the handle. Can be run from parallel threads. */
-static UA_StatusCode sendUDP(UA_Connection *connection, UA_ByteString *buf) {
-    UDPConnection *udpc = (UDPConnection*)connection;
-    ServerNetworkLayerUDP *layer = (ServerNetworkLayerUDP*)connection->handle;
-    size_t nWritten = 0;
-    struct sockaddr_in *sin = NULL;
-
-    if (udpc->from.sa_family == AF_INET) {
-#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-align"
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock; /* the slots are released from the workers */
 #endif
-        sin = (struct sockaddr_in *) &udpc->from;
-#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))
-#pragma GCC diagnostic pop
+
+    /* receive ring. the datagram of connection i is received into
+       recvBuffers + i * conf.recvBufferSize */
+    UA_Byte *recvBuffers;
+    UDPConnection connections[RECVBATCH];
+
+    /* preallocated send buffers of conf.sendBufferSize and the free slots */
+    UA_Byte *sendBuffers;
+    size_t sendFree[SENDBATCH];
+    size_t sendFreeSize;
+
+    /* datagrams sent together when the server flushes the layer (only
+       without multithreading, the workers send right away) */
+    UDPDatagram queue[SENDBATCH];
+    size_t queueSize;
+
+    UA_Job jobs[RECVBATCH];
+} ServerNetworkLayerUDP;
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define UDP_lock(layer) pthread_mutex_lock(&(layer)->lock)
+# define UDP_unlock(layer) pthread_mutex_unlock(&(layer)->lock)
+#else
+# define UDP_lock(layer)
+# define UDP_unlock(layer)
 #endif
+
+/* Returns a send buffer to the pool or the heap. Call with the lock held. */
+static void
+releaseSendSlot(ServerNetworkLayerUDP *layer, UA_ByteString *buf) {
+    size_t slotSize = layer->conf.sendBufferSize;
+    if(buf->data >= layer->sendBuffers && buf->data < &layer->sendBuffers[slotSize * SENDBATCH]) {
+        layer->sendFree[layer->sendFreeSize] = (size_t)(buf->data - layer->sendBuffers) / slotSize;
+        layer->sendFreeSize++;
+        UA_ByteString_init(buf);
     } else {
         UA_ByteString_deleteMembers(buf);
-        return UA_STATUSCODE_BADINTERNALERROR;
     }
+}
 
-    while (nWritten < (size_t)buf->length) {
-        UA_Int32 n = sendto(layer->serversockfd, buf->data, buf->length, 0,
-                            (struct sockaddr*)sin, sizeof(struct sockaddr_in));
-        if(n == -1L) {
-            UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i", errno);
-            UA_ByteString_deleteMembers(buf);
-            return UA_STATUSCODE_BADINTERNALERROR;
+/* Sends the queued datagrams. Call with the lock held. */
+static void
+flushUDP(ServerNetworkLayerUDP *layer) {
+    size_t sent = 0;
+#ifdef UA_UDP_MMSG
+    struct mmsghdr msgs[SENDBATCH];
+    struct iovec iov[SENDBATCH];
+    memset(msgs, 0, sizeof(struct mmsghdr) * layer->queueSize);
+    for(size_t i = 0; i < layer->queueSize; i++) {
+        iov[i].iov_base = layer->queue[i].buf.data;
+        iov[i].iov_len = layer->queue[i].buf.length;
+        msgs[i].msg_hdr.msg_name = &layer->queue[i].to;
+        msgs[i].msg_hdr.msg_namelen = layer->queue[i].tolen;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while(sent < layer->queueSize) {
+        int n = sendmmsg(layer->serversockfd, &msgs[sent], (unsigned int)(layer->queueSize - sent), 0);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i, dropping %i datagram(s)",
+                           errno, (int)(layer->queueSize - sent));
+            break;
         }
-        nWritten += n;
+        sent += (size_t)n;
     }
-    UA_ByteString_deleteMembers(buf);
-    return UA_STATUSCODE_GOOD;
+#else
+    for(; sent < layer->queueSize; sent++) {
+        UDPDatagram *d = &layer->queue[sent];
+        if(sendto(layer->serversockfd, d->buf.data, d->buf.length, 0,
+                  (struct sockaddr*)&d->to, d->tolen) < 0) {
+            UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i", errno);
+        }
+    }
+#endif
+    for(size_t i = 0; i < layer->queueSize; i++)
+        releaseSendSlot(layer, &layer->queue[i].buf);
+    layer->queueSize = 0;
+}
+
+static UA_StatusCode
+GetSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    ServerNetworkLayerUDP *layer = connection->handle;
+    if(length > connection->remoteConf.recvBufferSize)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    if(length <= layer->conf.sendBufferSize) {
+        UDP_lock(layer);
+#ifndef UA_ENABLE_MULTITHREADING
+        if(layer->sendFreeSize == 0)
+            flushUDP(layer); /* the queued datagrams hold the buffers */
+#endif
+        if(layer->sendFreeSize > 0) {
+            layer->sendFreeSize--;
+            size_t slot = layer->sendFree[layer->sendFreeSize];
+            UDP_unlock(layer);
+            buf->data = &layer->sendBuffers[slot * layer->conf.sendBufferSize];
+            buf->length = length;
+            return UA_STATUSCODE_GOOD;
+        }
+        UDP_unlock(layer);
+    }
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static void
+ReleaseSendBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    ServerNetworkLayerUDP *layer = connection->handle;
+    UDP_lock(layer);
+    releaseSendSlot(layer, buf);
+    UDP_unlock(layer);
+}
+
+/* The datagram slot is received into again */
+static void
+ReleaseRecvBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_init(buf);
+#ifdef UA_ENABLE_MULTITHREADING
+    ServerNetworkLayerUDP *layer = connection->handle;
+    UDP_lock(layer);
+    ((UDPConnection*)connection)->inUse = false;
+    UDP_unlock(layer);
+#else
+    ((UDPConnection*)connection)->inUse = false;
+#endif
+}
+
+/** Without multithreading, the datagram is queued until the server flushes
+ * the layer. Else it is sent right away. */
+static UA_StatusCode
+sendUDP(UA_Connection *connection, UA_ByteString *buf) {
+    UDPConnection *udpc = (UDPConnection*)connection;
+    ServerNetworkLayerUDP *layer = connection->handle;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(sendto(layer->serversockfd, buf->data, buf->length, 0,
+              (struct sockaddr*)&udpc->from, udpc->fromlen) < 0) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "UDP send error %i", errno);
+        retval = UA_STATUSCODE_BADINTERNALERROR;
+    }
+    ReleaseSendBuffer(connection, buf);
+#else
+    UDPDatagram *d = &layer->queue[layer->queueSize];
+    d->buf = *buf;
+    d->to = udpc->from;
+    d->tolen = udpc->fromlen;
+    layer->queueSize++;
+    UA_ByteString_init(buf);
+    if(layer->queueSize == SENDBATCH)
+        flushUDP(layer);
+#endif
+    return retval;
 }
 
 static UA_StatusCode socket_set_nonblocking(UA_Int32 sockfd) {
@@ -108,20 +228,40 @@ static UA_StatusCode socket_set_nonblocking(UA_Int32 sockfd) {
     return UA_STATUSCODE_GOOD;
 }
 
-static void setFDSet(ServerNetworkLayerUDP *layer) {
-    FD_ZERO(&layer->fdset);
-    FD_SET(layer->serversockfd, &layer->fdset);
+/* datagrams have no connection to tear down */
+static void closeConnectionUDP(UA_Connection *connection) {
+    connection->state = UA_CONNECTION_CLOSED;
 }
 
-static void closeConnectionUDP(UA_Connection *handle) {
-    free(handle);
-}
+static UA_StatusCode
+ServerNetworkLayerUDP_start(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    layer->logger = logger;
+
+    /* get the discovery url from the hostname */
+    UA_String du = UA_STRING_NULL;
+    char hostname[256];
+    char discoveryUrl[256];
+    if(gethostname(hostname, 255) == 0) {
+        du.length = (size_t)snprintf(discoveryUrl, 255, "opc.udp://%s:%d", hostname, layer->port);
+        du.data = (UA_Byte*)discoveryUrl;
+    }
+    UA_String_copy(&du, &nl->discoveryUrl);
+
+    /* preallocate the datagram buffers */
+    layer->recvBuffers = malloc(layer->conf.recvBufferSize * RECVBATCH);
+    layer->sendBuffers = malloc(layer->conf.sendBufferSize * SENDBATCH);
+    if(!layer->recvBuffers || !layer->sendBuffers) {
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "No memory for the datagram buffers");
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for(size_t i = 0; i < SENDBATCH; i++)
+        layer->sendFree[i] = i;
+    layer->sendFreeSize = SENDBATCH;
 
-static UA_StatusCode ServerNetworkLayerUDP_start(ServerNetworkLayerUDP *layer, UA_Logger logger) {
-    layer->layer.logger = logger;
     layer->serversockfd = socket(PF_INET, SOCK_DGRAM, 0);
     if(layer->serversockfd < 0) {
-        UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Error opening socket");
         return UA_STATUSCODE_BADINTERNALERROR;
     }
     const struct sockaddr_in serv_addr =
@@ -130,98 +270,234 @@ static UA_StatusCode ServerNetworkLayerUDP_start(ServerNetworkLayerUDP *layer, U
     int optval = 1;
     if(setsockopt(layer->serversockfd, SOL_SOCKET,
                   SO_REUSEADDR, (const char *)&optval, sizeof(optval)) == -1) {
-        UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Could not setsockopt");
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Could not setsockopt");
         CLOSESOCKET(layer->serversockfd);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
     if(bind(layer->serversockfd, (const struct sockaddr *)&serv_addr,
             sizeof(serv_addr)) < 0) {
-        UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Could not bind the socket");
+        UA_LOG_WARNING(layer->logger, UA_LOGCATEGORY_NETWORK, "Could not bind the socket");
         CLOSESOCKET(layer->serversockfd);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
     socket_set_nonblocking(layer->serversockfd);
-    UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "Listening for UDP connections on %s:%d",
-                   inet_ntoa(serv_addr.sin_addr), ntohs(serv_addr.sin_port));
+    UA_LOG_INFO(layer->logger, UA_LOGCATEGORY_NETWORK, "Listening for UDP connections on %.*s",
+                nl->discoveryUrl.length, nl->discoveryUrl.data);
     return UA_STATUSCODE_GOOD;
 }
 
-static size_t ServerNetworkLayerUDP_getJobs(ServerNetworkLayerUDP *layer, UA_Job **jobs, UA_UInt16 timeout) {
-    UA_Job *items = NULL;
-    setFDSet(layer);
-    struct timeval tmptv = {0, timeout};
-    UA_Int32 resultsize = select(layer->serversockfd+1, &layer->fdset, NULL, NULL, &tmptv);
-    if(resultsize <= 0 || !FD_ISSET(layer->serversockfd, &layer->fdset)) {
-        *jobs = items;
+/* Prepares the connection of the slot for the next datagram */
+static void
+resetConnection(ServerNetworkLayerUDP *layer, UDPConnection *c) {
+    UA_Connection_deleteMembers(&c->connection);
+    UA_Connection_init(&c->connection);
+    c->connection.sockfd = layer->serversockfd;
+    c->connection.getSendBuffer = GetSendBuffer;
+    c->connection.releaseSendBuffer = ReleaseSendBuffer;
+    c->connection.releaseRecvBuffer = ReleaseRecvBuffer;
+    c->connection.handle = layer;
+    c->connection.send = sendUDP;
+    c->connection.close = closeConnectionUDP;
+    c->connection.localConf = layer->conf;
+    c->connection.remoteConf = layer->conf;
+    c->connection.state = UA_CONNECTION_OPENING;
+}
+
+static size_t
+ServerNetworkLayerUDP_getJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt32 timeout) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    UDP_lock(layer);
+    flushUDP(layer);
+    UDP_unlock(layer);
+
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(layer->serversockfd, &fdset);
+    struct timeval tmptv = {timeout / 1000000, timeout % 1000000};
+    if(select(layer->serversockfd+1, &fdset, NULL, NULL, &tmptv) <= 0)
         return 0;
+
+    /* collect the free slots of the ring */
+    UDPConnection *slots[RECVBATCH];
+    size_t slotsSize = 0;
+    UDP_lock(layer);
+    for(size_t i = 0; i < RECVBATCH; i++) {
+        if(!layer->connections[i].inUse)
+            slots[slotsSize++] = &layer->connections[i];
     }
-    items = malloc(sizeof(UA_Job)*resultsize);
-    // read from established sockets
-    UA_Int32 j = 0;
-    UA_ByteString buf = {-1, NULL};
-    if(!buf.data) {
-        buf.data = malloc(sizeof(UA_Byte) * layer->conf.recvBufferSize);
-        if(!buf.data)
-            UA_LOG_WARNING(layer->layer.logger, UA_LOGCATEGORY_NETWORK, "malloc failed");
-    }
-    struct sockaddr sender;
-    socklen_t sendsize = sizeof(sender);
-    bzero(&sender, sizeof(sender));
-    ssize_t rec_result = recvfrom(layer->serversockfd, buf.data, layer->conf.recvBufferSize, 0, &sender, &sendsize);
-    if (rec_result > 0) {
-        buf.length = rec_result;
-        UDPConnection *c = malloc(sizeof(UDPConnection));
-        if(!c){
-                free(items);
-            return UA_STATUSCODE_BADINTERNALERROR;
-        }
-        UA_Connection_init(&c->connection);
-        c->from = sender;
-        c->fromlen = sendsize;
-        // c->sockfd = newsockfd;
-        c->connection.getSendBuffer = GetMallocedBuffer;
-        c->connection.releaseSendBuffer = ReleaseMallocedBuffer;
-        c->connection.releaseRecvBuffer = ReleaseMallocedBuffer;
-        c->connection.handle = layer;
-        c->connection.send = sendUDP;
-        c->connection.close = closeConnectionUDP;
-        c->connection.localConf = layer->conf;
-        c->connection.state = UA_CONNECTION_OPENING;
-
-        items[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
-        items[j].job.binaryMessage.message = buf;
-        items[j].job.binaryMessage.connection = (UA_Connection*)c;
-        buf.data = NULL;
+    UDP_unlock(layer);
+
+    /* receive into the free slots */
+    size_t received = 0;
+    size_t lengths[RECVBATCH];
+#ifdef UA_UDP_MMSG
+    struct mmsghdr msgs[RECVBATCH];
+    struct iovec iov[RECVBATCH];
+    memset(msgs, 0, sizeof(struct mmsghdr) * slotsSize);
+    for(size_t i = 0; i < slotsSize; i++) {
+        size_t index = (size_t)(slots[i] - layer->connections);
+        iov[i].iov_base = &layer->recvBuffers[index * layer->conf.recvBufferSize];
+        iov[i].iov_len = layer->conf.recvBufferSize;
+        msgs[i].msg_hdr.msg_name = &slots[i]->from;
+        msgs[i].msg_hdr.msg_namelen = sizeof(slots[i]->from);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = 0;
+    if(slotsSize > 0)
+        n = recvmmsg(layer->serversockfd, msgs, (unsigned int)slotsSize, MSG_DONTWAIT, NULL);
+    for(int i = 0; i < n; i++) {
+        if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+            lengths[i] = 0; /* does not fit into the buffer */
+        else
+            lengths[i] = msgs[i].msg_len;
+        slots[i]->fromlen = msgs[i].msg_hdr.msg_namelen;
+        received++;
+    }
+#else
+    for(; received < slotsSize; received++) {
+        size_t index = (size_t)(slots[received] - layer->connections);
+        slots[received]->fromlen = sizeof(slots[received]->from);
+        ssize_t r = recvfrom(layer->serversockfd, &layer->recvBuffers[index * layer->conf.recvBufferSize],
+                             layer->conf.recvBufferSize, MSG_DONTWAIT,
+                             (struct sockaddr*)&slots[received]->from, &slots[received]->fromlen);
+        if(r < 0)
+            break;
+        lengths[received] = (size_t)r;
+    }
+#endif
+
+    size_t j = 0;
+    for(size_t i = 0; i < received; i++) {
+        if(lengths[i] == 0)
+            continue;
+        UDPConnection *c = slots[i];
+        size_t index = (size_t)(c - layer->connections);
+        resetConnection(layer, c);
+        c->inUse = true;
+        layer->jobs[j].type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+        layer->jobs[j].job.binaryMessage.message.data = &layer->recvBuffers[index * layer->conf.recvBufferSize];
+        layer->jobs[j].job.binaryMessage.message.length = lengths[i];
+        layer->jobs[j].job.binaryMessage.connection = &c->connection;
+        layer->jobs[j].priority = UA_JOBPRIORITY_NORMAL;
         j++;
-        *jobs = items;
-    } else {
-        free(items);
-        *jobs = NULL;
     }
-    if(buf.data)
-        free(buf.data);
+    *jobs = layer->jobs;
     return j;
 }
 
-static UA_Int32 ServerNetworkLayerUDP_stop(ServerNetworkLayerUDP * layer, UA_Job **jobs) {
+static void
+ServerNetworkLayerUDP_flush(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    UDP_lock(layer);
+    flushUDP(layer);
+    UDP_unlock(layer);
+}
+
+static size_t
+ServerNetworkLayerUDP_stop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    UDP_lock(layer);
+    flushUDP(layer);
+    UDP_unlock(layer);
     CLOSESOCKET(layer->serversockfd);
     return 0;
 }
 
-static void ServerNetworkLayerUDP_deleteMembers(ServerNetworkLayerUDP *layer) {
+/* run only when the server is stopped */
+static void
+ServerNetworkLayerUDP_deleteMembers(UA_ServerNetworkLayer *nl) {
+    ServerNetworkLayerUDP *layer = nl->handle;
+    for(size_t i = 0; i < RECVBATCH; i++)
+        UA_Connection_deleteMembers(&layer->connections[i].connection);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&layer->lock);
+#endif
+    free(layer->recvBuffers);
+    free(layer->sendBuffers);
+    free(layer);
+    UA_String_deleteMembers(&nl->discoveryUrl);
 }
 
-UA_ServerNetworkLayer * ServerNetworkLayerUDP_new(UA_ConnectionConfig conf, UA_UInt32 port) {
-    ServerNetworkLayerUDP *layer = malloc(sizeof(ServerNetworkLayerUDP));
+UA_ServerNetworkLayer
+UA_ServerNetworkLayerUDP(UA_ConnectionConfig conf, UA_UInt16 port) {
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    ServerNetworkLayerUDP *layer = calloc(1, sizeof(ServerNetworkLayerUDP));
     if(!layer)
-        return NULL;
-    memset(layer, 0, sizeof(ServerNetworkLayerUDP));
-
+        return nl;
     layer->conf = conf;
     layer->port = port;
-    layer->layer.start = (UA_StatusCode(*)(UA_ServerNetworkLayer*,UA_Logger))ServerNetworkLayerUDP_start;
-    layer->layer.getJobs = (size_t(*)(UA_ServerNetworkLayer*,UA_Job**,UA_UInt16))ServerNetworkLayerUDP_getJobs;
-    layer->layer.stop = (size_t(*)(UA_ServerNetworkLayer*, UA_Job**))ServerNetworkLayerUDP_stop;
-    layer->layer.deleteMembers = (void(*)(UA_ServerNetworkLayer*))ServerNetworkLayerUDP_deleteMembers;
-    return &layer->layer;
+    layer->serversockfd = -1;
+    for(size_t i = 0; i < RECVBATCH; i++)
+        UA_Connection_init(&layer->connections[i].connection);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&layer->lock, NULL);
+#endif
+
+    nl.handle = layer;
+    nl.start = ServerNetworkLayerUDP_start;
+    nl.getJobs = ServerNetworkLayerUDP_getJobs;
+    nl.flush = ServerNetworkLayerUDP_flush;
+    nl.stop = ServerNetworkLayerUDP_stop;
+    nl.deleteMembers = ServerNetworkLayerUDP_deleteMembers;
+    return nl;
+}
+
+/*******************/
+/* Value Publisher */
+/*******************/
+
+typedef struct {
+    UA_Int32 sockfd;
+    struct sockaddr_in group;
+} UDPValuePublisher;
+
+static UA_StatusCode
+UDPValuePublisher_send(void *handle, const UA_ByteString *message) {
+    UDPValuePublisher *p = handle;
+    ssize_t n = sendto(p->sockfd, message->data, message->length, 0,
+                       (struct sockaddr*)&p->group, sizeof(p->group));
+    if(n < 0 || (size_t)n != message->length)
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void UDPValuePublisher_deleteMembers(void *handle) {
+    UDPValuePublisher *p = handle;
+    CLOSESOCKET(p->sockfd);
+    free(p);
+}
+
+UA_StatusCode
+UA_ValuePublisherTransportUDP(const char *group, UA_UInt16 port, UA_Byte ttl,
+                              UA_ValuePublisherTransport *transport) {
+    UDPValuePublisher *p = malloc(sizeof(UDPValuePublisher));
+    if(!p)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memset(&p->group, 0, sizeof(p->group));
+    p->group.sin_family = AF_INET;
+    p->group.sin_port = htons(port);
+    if(inet_pton(AF_INET, group, &p->group.sin_addr) != 1) {
+        free(p);
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    }
+    p->sockfd = socket(PF_INET, SOCK_DGRAM, 0);
+    if(p->sockfd < 0) {
+        free(p);
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    }
+    /* A blocking send would stall the worker that publishes. The messages are
+       dropped instead. */
+    unsigned char mttl = ttl;
+    if(setsockopt(p->sockfd, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl)) < 0 ||
+       socket_set_nonblocking(p->sockfd) != UA_STATUSCODE_GOOD) {
+        UDPValuePublisher_deleteMembers(p);
+        return UA_STATUSCODE_BADCOMMUNICATIONERROR;
+    }
+    transport->handle = p;
+    transport->send = UDPValuePublisher_send;
+    transport->deleteMembers = UDPValuePublisher_deleteMembers;
+    transport->maxMessageSize = UA_UDP_PUBLISHER_MAXMESSAGE;
+    return UA_STATUSCODE_GOOD;
 }
@@ -9,13 +9,20 @@ extern "C" {
 #endif
 
 #include "ua_server.h"
-#include "ua_client.h"
 
-/* Create the UDP networklayer and listen to the specified port */
-UA_ServerNetworkLayer UA_EXPORT * ServerNetworkLayerUDP_new(UA_ConnectionConfig conf, UA_UInt32 port);
+/* Create the UDP networklayer and listen to the specified port. Every datagram
+ * carries a complete stateless request (UA_ENABLE_NONSTANDARD_STATELESS). The
+ * datagrams are received and sent in batches (recvmmsg/sendmmsg on Linux). */
+UA_ServerNetworkLayer UA_EXPORT
+UA_ServerNetworkLayerUDP(UA_ConnectionConfig conf, UA_UInt16 port);
 
-UA_Connection UA_EXPORT
-ClientNetworkLayerUDP_connect(UA_ConnectionConfig conf, char endpointUrl[], UA_Logger logger);
+/* Create a transport for a value publisher (see UA_Server_addValuePublisher)
+ * that sends every message as one datagram to an IPv4 multicast group. The ttl
+ * limits the number of routers the datagrams pass. Messages are limited to 1472
+ * bytes, so that the datagrams are not fragmented on ethernet. */
+UA_StatusCode UA_EXPORT
+UA_ValuePublisherTransportUDP(const char *group, UA_UInt16 port, UA_Byte ttl,
+                              UA_ValuePublisherTransport *transport);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -28,6 +28,15 @@ static void UA_Client_init(UA_Client* client, UA_ClientConfig config) {
 
     UA_NodeId_init(&client->authenticationToken);
     client->requestHandle = 0;
+    client->batching = false;
+    client->batch = NULL;
+    client->batchSize = 0;
+    client->batchCapacity = 0;
+    UA_Arena_init(&client->responseArena, NULL, 0);
+    UA_ByteString_init(&client->responseMessage);
+    client->responseMessageRealloced = false;
+    memset(&client->cache, 0, sizeof(UA_Client_Cache));
+    LIST_INIT(&client->asyncServiceCalls);
 
     client->config = config;
     client->scRenewAt = 0;
@@ -36,6 +45,8 @@ static void UA_Client_init(UA_Client* client, UA_ClientConfig config) {
     client->monitoredItemHandles = 0;
     LIST_INIT(&client->pendingNotificationsAcks);
     LIST_INIT(&client->subscriptions);
+    client->outstandingPublishRequests = 0;
+    client->maxOutstandingPublishRequests = 0;
 #endif
 }
 
@@ -48,13 +59,40 @@ UA_Client * UA_Client_new(UA_ClientConfig config) {
     return client;
 }
 
+static void cancelAsyncServiceCalls(UA_Client *client, UA_StatusCode statusCode);
+static void releaseResponseMessage(UA_Client *client);
+
+/* The response of the synchronous request. Responses to other requests are
+ * dispatched to their asynchronous callbacks. */
+typedef struct {
+    UA_Boolean received;
+    UA_UInt32 requestId;
+    void *response;
+    const UA_DataType *responseType;
+    UA_Arena *arena; /* Decode the response into the arena if set */
+} SyncResponseDescription;
+
+static UA_StatusCode
+receiveServiceResponses(UA_Client *client, SyncResponseDescription *rd, UA_DateTime maxDate);
+
 static void UA_Client_deleteMembers(UA_Client* client) {
     UA_Client_disconnect(client);
+    cancelAsyncServiceCalls(client, UA_STATUSCODE_BADSHUTDOWN);
+    releaseResponseMessage(client);
+    UA_Client_Cache_clear(client);
     UA_Connection_deleteMembers(&client->connection);
     UA_SecureChannel_deleteMembersCleanup(&client->channel);
     if(client->endpointUrl.data)
         UA_String_deleteMembers(&client->endpointUrl);
     UA_UserTokenPolicy_deleteMembers(&client->token);
+    for(size_t i = 0; i < client->batchSize; i++) {
+        UA_Client_BatchedOperation *op = &client->batch[i];
+        if(op->isWrite)
+            UA_WriteValue_deleteMembers(&op->item.write);
+        else
+            UA_ReadValueId_deleteMembers(&op->item.read);
+    }
+    UA_free(client->batch);
     if(client->username.data)
         UA_String_deleteMembers(&client->username);
     if(client->password.data)
@@ -69,9 +107,11 @@ static void UA_Client_deleteMembers(UA_Client* client) {
     LIST_FOREACH_SAFE(sub, &client->subscriptions, listEntry, tmps) {
         LIST_REMOVE(sub, listEntry);
         UA_Client_MonitoredItem *mon, *tmpmon;
+        /* The client is disconnected. Only the local handlers remain. */
         LIST_FOREACH_SAFE(mon, &sub->MonitoredItems, listEntry, tmpmon) {
-            UA_Client_Subscriptions_removeMonitoredItem(client, sub->SubscriptionID,
-                                                        mon->MonitoredItemId);
+            LIST_REMOVE(mon, listEntry);
+            UA_NodeId_deleteMembers(&mon->monitoredNodeId);
+            UA_free(mon);
         }
         free(sub);
     }
@@ -251,49 +291,21 @@ static UA_StatusCode SecureChannelHandshake(UA_Client *client, UA_Boolean renew)
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
-    UA_ByteString reply;
-    UA_ByteString_init(&reply);
-    UA_Boolean realloced = false;
-    do {
-        retval = c->recv(c, &reply, client->config.timeout);
-        retval |= UA_Connection_completeMessages(c, &reply, &realloced);
-        if(retval != UA_STATUSCODE_GOOD) {
-            UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
-                         "Receiving OpenSecureChannelResponse failed");
-            return retval;
-        }
-    } while(reply.length == 0);
-
-    offset = 0;
-    UA_SecureConversationMessageHeader_decodeBinary(&reply, &offset, &messageHeader);
-    UA_AsymmetricAlgorithmSecurityHeader_decodeBinary(&reply, &offset, &asymHeader);
-    UA_SequenceHeader_decodeBinary(&reply, &offset, &seqHeader);
-    UA_NodeId_decodeBinary(&reply, &offset, &requestType);
-    UA_NodeId expectedRequest = UA_NODEID_NUMERIC(0, UA_NS0ID_OPENSECURECHANNELRESPONSE +
-                                                  UA_ENCODINGOFFSET_BINARY);
-    if(!UA_NodeId_equal(&requestType, &expectedRequest)) {
-        UA_ByteString_deleteMembers(&reply);
-        UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
-        UA_NodeId_deleteMembers(&requestType);
-        UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
-                     "Reply answers the wrong request. Expected OpenSecureChannelResponse.");
-        return UA_STATUSCODE_BADINTERNALERROR;
-    }
-
+    /* The response is dispatched with the responses to the outstanding
+     * asynchronous requests (e.g. publish requests during a renewal) */
     UA_OpenSecureChannelResponse response;
     UA_OpenSecureChannelResponse_init(&response);
-    retval = UA_OpenSecureChannelResponse_decodeBinary(&reply, &offset, &response);
-    if(!realloced)
-        c->releaseRecvBuffer(c, &reply);
-    else
-        UA_ByteString_deleteMembers(&reply);
-
+    SyncResponseDescription rd = {false, seqHeader.requestId, &response,
+                                  &UA_TYPES[UA_TYPES_OPENSECURECHANNELRESPONSE], NULL};
+    UA_DateTime maxDate = UA_DateTime_nowMonotonic() +
+        (UA_DateTime)client->config.timeout * UA_MSEC_TO_DATETIME;
+    retval = receiveServiceResponses(client, &rd, maxDate);
+    if(retval == UA_STATUSCODE_GOOD && !rd.received)
+        retval = UA_STATUSCODE_BADTIMEOUT;
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_SECURECHANNEL,
-                     "Decoding OpenSecureChannelResponse failed");
-        UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
-        UA_OpenSecureChannelResponse_init(&response);
-        response.responseHeader.serviceResult = retval;
+                     "Receiving OpenSecureChannelResponse failed");
+        UA_OpenSecureChannelResponse_deleteMembers(&response);
         return retval;
     }
 
@@ -320,7 +332,6 @@ static UA_StatusCode SecureChannelHandshake(UA_Client *client, UA_Boolean renew)
                      "not be opened / renewed with statuscode %i", retval);
     }
     UA_OpenSecureChannelResponse_deleteMembers(&response);
-    UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
     return retval;
 }
 
@@ -463,6 +474,8 @@ static UA_StatusCode SessionHandshake(UA_Client *client) {
     request.requestHeader.timestamp = UA_DateTime_now();
     request.requestHeader.timeoutHint = 10000;
     UA_ByteString_copy(&client->channel.clientNonce, &request.clientNonce);
+    UA_String_copy(&client->config.applicationUri, &request.clientDescription.applicationUri);
+    request.clientDescription.applicationType = UA_APPLICATIONTYPE_CLIENT;
     request.requestedSessionTimeout = 1200000;
     request.maxResponseMessageSize = UA_INT32_MAX;
 
@@ -636,6 +649,75 @@ UA_Client_connect(UA_Client *client, const char *endpointUrl) {
     return retval;
 }
 
+/* Closes the connection and the SecureChannel. The session remains. */
+static void closeChannel(UA_Client *client) {
+    cancelAsyncServiceCalls(client, UA_STATUSCODE_BADCONNECTIONCLOSED);
+    releaseResponseMessage(client);
+    if(client->connection.close)
+        client->connection.close(&client->connection);
+    UA_Connection_deleteMembers(&client->connection);
+    UA_SecureChannel_deleteMembersCleanup(&client->channel);
+    UA_SecureChannel_init(&client->channel);
+    client->channel.connection = &client->connection;
+}
+
+UA_StatusCode
+UA_Client_reconnect(UA_Client *client) {
+    if(!client->endpointUrl.data || UA_NodeId_equal(&client->authenticationToken, &UA_NODEID_NULL))
+        return UA_STATUSCODE_BADNOTCONNECTED;
+    closeChannel(client);
+
+    char endpointUrl[512];
+    if(client->endpointUrl.length >= sizeof(endpointUrl))
+        return UA_STATUSCODE_BADTCPENDPOINTURLINVALID;
+    memcpy(endpointUrl, client->endpointUrl.data, client->endpointUrl.length);
+    endpointUrl[client->endpointUrl.length] = 0;
+    client->connection = client->config.connectionFunc(UA_ConnectionConfig_standard, endpointUrl,
+                                                       client->config.logger);
+    client->channel.connection = &client->connection;
+    if(client->connection.state != UA_CONNECTION_OPENING) {
+        client->state = UA_CLIENTSTATE_ERRORED;
+        return UA_STATUSCODE_BADCONNECTIONCLOSED;
+    }
+    client->connection.localConf = client->config.localConnectionConfig;
+    UA_StatusCode retval = HelAckHandshake(client);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = SecureChannelHandshake(client, false);
+    if(retval != UA_STATUSCODE_GOOD) {
+        client->state = UA_CLIENTSTATE_ERRORED;
+        return retval;
+    }
+
+    /* Move the session to the new SecureChannel. The endpoint and the user
+     * token policy of the first connect are reused. */
+    retval = ActivateSession(client);
+    UA_Boolean newSession = (retval != UA_STATUSCODE_GOOD);
+    if(newSession) {
+        /* The session has timed out. Take the subscriptions over to a new
+         * session. */
+        UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                    "The session is lost. Create a new session.");
+        UA_NodeId_deleteMembers(&client->authenticationToken);
+        retval = SessionHandshake(client);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = ActivateSession(client);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        client->state = UA_CLIENTSTATE_ERRORED;
+        return retval;
+    }
+    client->connection.state = UA_CONNECTION_ESTABLISHED;
+    client->state = UA_CLIENTSTATE_CONNECTED;
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* Take the subscriptions over to a new session and fetch the notifications
+     * that were sent while the client was away. The values may have changed in
+     * a new session. */
+    UA_Client_Subscriptions_transfer(client, newSession);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_StatusCode UA_Client_disconnect(UA_Client *client) {
     if(client->state != UA_CLIENTSTATE_CONNECTED)
         return UA_STATUSCODE_BADNOTCONNECTED;
@@ -647,6 +729,8 @@ UA_StatusCode UA_Client_disconnect(UA_Client *client) {
     /* Is a secure channel established? */
     if(client->channel.connection->state == UA_CONNECTION_ESTABLISHED)
         retval |= CloseSecureChannel(client);
+    cancelAsyncServiceCalls(client, UA_STATUSCODE_BADSHUTDOWN);
+    releaseResponseMessage(client);
     return retval;
 }
 
@@ -661,21 +745,214 @@ UA_StatusCode UA_Client_manuallyRenewSecureChannel(UA_Client *client) {
 /* Raw Services */
 /****************/
 
-void __UA_Client_Service(UA_Client *client, const void *r, const UA_DataType *requestType,
-                         void *response, const UA_DataType *responseType) {
+static void releaseResponseMessage(UA_Client *client) {
+    if(client->responseMessage.data) {
+        if(client->responseMessageRealloced)
+            UA_ByteString_deleteMembers(&client->responseMessage);
+        else
+            client->connection.releaseRecvBuffer(&client->connection, &client->responseMessage);
+        UA_ByteString_init(&client->responseMessage);
+    }
+    UA_Arena_deleteMembers(&client->responseArena);
+}
+
+static void cancelAsyncServiceCalls(UA_Client *client, UA_StatusCode statusCode) {
+    AsyncServiceCall *ac;
+    while((ac = LIST_FIRST(&client->asyncServiceCalls))) {
+        LIST_REMOVE(ac, pointers);
+        void *response = UA_new(ac->responseType);
+        if(response) {
+            ((UA_ResponseHeader*)response)->serviceResult = statusCode;
+            ac->callback(client, ac->userdata, ac->requestId, response);
+            UA_delete(response, ac->responseType);
+        }
+        UA_free(ac);
+    }
+}
+
+static UA_StatusCode
+decodeServiceResponse(UA_Client *client, const UA_ByteString *message, size_t *offset,
+                      const UA_NodeId *responseId, void *response, const UA_DataType *responseType,
+                      UA_Arena *arena) {
+    UA_ResponseHeader *respHeader = (UA_ResponseHeader*)response;
+    UA_NodeId expectedNodeId = UA_NODEID_NUMERIC(0, responseType->typeId.identifier.numeric +
+                                                 UA_ENCODINGOFFSET_BINARY);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(!UA_NodeId_equal(responseId, &expectedNodeId)) {
+        if(responseId->identifier.numeric != UA_NS0ID_SERVICEFAULT + UA_ENCODINGOFFSET_BINARY) {
+            UA_LOG_ERROR(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                         "Reply answers the wrong request. Expected ns=%i,i=%i. But retrieved ns=%i,i=%i",
+                         expectedNodeId.namespaceIndex, expectedNodeId.identifier.numeric,
+                         responseId->namespaceIndex, responseId->identifier.numeric);
+            respHeader->serviceResult = UA_STATUSCODE_BADINTERNALERROR;
+        } else if(arena) {
+            retval = UA_decodeBinaryChunked(message, offset, respHeader, &UA_TYPES[UA_TYPES_SERVICEFAULT],
+                                            NULL, NULL, 0, arena);
+        } else
+            retval = UA_decodeBinary(message, offset, respHeader, &UA_TYPES[UA_TYPES_SERVICEFAULT]);
+    } else if(arena) {
+        retval = UA_decodeBinaryChunked(message, offset, response, responseType, NULL, NULL, 0, arena);
+    } else if(client->config.lazyExtensionObjects) {
+        retval = UA_decodeBinaryLazy(message, offset, response, responseType);
+    } else {
+        retval = UA_decodeBinary(message, offset, response, responseType);
+    }
+    if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+        retval = UA_STATUSCODE_BADRESPONSETOOLARGE;
+    if(retval != UA_STATUSCODE_GOOD)
+        respHeader->serviceResult = retval;
+    return retval;
+}
+
+/* Processes the message at the offset and moves the offset behind it. Returns
+ * an error if the message cannot be decoded or the synchronous response is
+ * broken. */
+static UA_StatusCode
+processServiceResponse(UA_Client *client, const UA_ByteString *message, size_t *offset,
+                       SyncResponseDescription *rd) {
+    size_t start = *offset;
+    UA_SecureConversationMessageHeader msgHeader;
+    UA_StatusCode retval = UA_SecureConversationMessageHeader_decodeBinary(message, offset, &msgHeader);
+    if(retval != UA_STATUSCODE_GOOD || msgHeader.messageHeader.messageSize > message->length - start)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    size_t end = start + msgHeader.messageHeader.messageSize;
+    UA_UInt32 messageType = msgHeader.messageHeader.messageTypeAndChunkType & 0x00ffffff;
+    if(messageType != UA_MESSAGETYPE_MSG && messageType != UA_MESSAGETYPE_OPN) {
+        UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                    "Received an unexpected message type. Ignore.");
+        *offset = end;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_SymmetricAlgorithmSecurityHeader symHeader;
+    UA_SymmetricAlgorithmSecurityHeader_init(&symHeader);
+    if(messageType == UA_MESSAGETYPE_MSG) {
+        /* Decrypt and verify the chunk in the receive buffer */
+        UA_ByteString chunk = {msgHeader.messageHeader.messageSize, &message->data[start]};
+        size_t chunkLength;
+        if(UA_SecureChannel_unprotectChunk(&client->channel, &chunk, &chunkLength) != UA_STATUSCODE_GOOD) {
+            UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                        "Received a message that failed the security checks");
+            return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+        }
+        retval |= UA_SymmetricAlgorithmSecurityHeader_decodeBinary(message, offset, &symHeader);
+    } else {
+        /* The OpenSecureChannelResponse (without security) */
+        UA_AsymmetricAlgorithmSecurityHeader asymHeader;
+        retval |= UA_AsymmetricAlgorithmSecurityHeader_decodeBinary(message, offset, &asymHeader);
+        UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
+    }
+
+    UA_SequenceHeader seqHeader;
+    UA_NodeId responseId;
+    retval |= UA_SequenceHeader_decodeBinary(message, offset, &seqHeader);
+    retval |= UA_NodeId_decodeBinary(message, offset, &responseId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    /* The synchronous request */
+    if(rd && seqHeader.requestId == rd->requestId) {
+        rd->received = true;
+        retval = decodeServiceResponse(client, message, offset, &responseId,
+                                       rd->response, rd->responseType, rd->arena);
+        goto finish;
+    }
+
+    /* An asynchronous request */
+    AsyncServiceCall *ac;
+    LIST_FOREACH(ac, &client->asyncServiceCalls, pointers) {
+        if(ac->requestId == seqHeader.requestId)
+            break;
+    }
+    if(!ac) {
+        UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                    "Received a response to the unknown request %u. Ignore.", seqHeader.requestId);
+        goto finish;
+    }
+    LIST_REMOVE(ac, pointers);
+    void *response = UA_alloca(ac->responseType->memSize);
+    UA_init(response, ac->responseType);
+    decodeServiceResponse(client, message, offset, &responseId, response, ac->responseType, NULL);
+    ac->callback(client, ac->userdata, ac->requestId, response);
+    UA_deleteMembers(response, ac->responseType);
+    UA_free(ac);
+
+ finish:
+    UA_SymmetricAlgorithmSecurityHeader_deleteMembers(&symHeader);
+    UA_NodeId_deleteMembers(&responseId);
+    *offset = end;
+    return retval;
+}
+
+/* Receives until the synchronous response has arrived or the maxDate
+ * (monotonic) has passed. Without a synchronous request, returns after the
+ * first received messages. */
+static UA_StatusCode
+receiveServiceResponses(UA_Client *client, SyncResponseDescription *rd, UA_DateTime maxDate) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    do {
+        /* A timeout of zero would block */
+        UA_DateTime now = UA_DateTime_nowMonotonic();
+        UA_UInt32 timeout = 1;
+        if(maxDate - now > UA_MSEC_TO_DATETIME)
+            timeout = (UA_UInt32)((maxDate - now) / UA_MSEC_TO_DATETIME);
+
+        UA_ByteString reply = UA_BYTESTRING_NULL;
+        UA_Boolean realloced = false;
+        retval = client->connection.recv(&client->connection, &reply, timeout);
+        if(retval == UA_STATUSCODE_GOODNONCRITICALTIMEOUT) {
+            retval = UA_STATUSCODE_GOOD;
+            continue;
+        }
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = UA_Connection_completeMessages(&client->connection, &reply, &realloced);
+        if(retval != UA_STATUSCODE_GOOD) {
+            client->state = UA_CLIENTSTATE_ERRORED;
+            return retval;
+        }
+        if(!reply.data)
+            continue; /* incomplete */
+
+        /* Process all complete messages */
+        UA_Boolean received = rd && rd->received;
+        size_t offset = 0;
+        while(offset < reply.length && retval == UA_STATUSCODE_GOOD)
+            retval = processServiceResponse(client, &reply, &offset, rd);
+        if(rd && rd->arena && rd->received && !received) {
+            /* The response decoded into the arena points into the message */
+            client->responseMessage = reply;
+            client->responseMessageRealloced = realloced;
+        } else if(!realloced)
+            client->connection.releaseRecvBuffer(&client->connection, &reply);
+        else
+            UA_ByteString_deleteMembers(&reply);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT, "Error receiving the response");
+            client->state = UA_CLIENTSTATE_FAULTED;
+            return retval;
+        }
+        if(!rd)
+            break;
+    } while((!rd || !rd->received) && UA_DateTime_nowMonotonic() < maxDate);
+    return retval;
+}
+
+/* The responses to the asynchronous requests that arrive before the response
+ * to the renewal are dispatched while it is received */
+static UA_StatusCode renewSecureChannel(UA_Client *client) {
+    return UA_Client_manuallyRenewSecureChannel(client);
+}
+
+static UA_StatusCode
+sendServiceRequest(UA_Client *client, const void *r, const UA_DataType *requestType,
+                   UA_UInt32 *requestId) {
     /* Requests always begin witih a RequestHeader, therefore we can cast. */
     UA_RequestHeader *request = (void*)(uintptr_t)r;
-    UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    UA_init(response, responseType);
-    UA_ResponseHeader *respHeader = (UA_ResponseHeader*)response;
 
     /* make sure we have a valid session */
-    retval = UA_Client_manuallyRenewSecureChannel(client);
-    if(retval != UA_STATUSCODE_GOOD) {
-        respHeader->serviceResult = retval;
-        client->state = UA_CLIENTSTATE_ERRORED;
-        return;
-    }
+    UA_StatusCode retval = renewSecureChannel(client);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
 
     /* handling request parameters */
     UA_NodeId_copy(&client->authenticationToken, &request->authenticationToken);
@@ -683,80 +960,176 @@ void __UA_Client_Service(UA_Client *client, const void *r, const UA_DataType *re
     request->requestHandle = ++client->requestHandle;
 
     /* Send the request */
-    UA_UInt32 requestId = ++client->requestId;
+    *requestId = ++client->requestId;
     UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
                  "Sending a request of type %i", requestType->typeId.identifier.numeric);
-    retval = UA_SecureChannel_sendBinaryMessage(&client->channel, requestId, request, requestType);
+    retval = UA_SecureChannel_sendBinaryMessage(&client->channel, *requestId, request, requestType);
+    if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+        retval = UA_STATUSCODE_BADREQUESTTOOLARGE;
+    return retval;
+}
+
+/* Receives the response of the synchronous request. Responses to asynchronous
+ * requests that arrive in the meantime are dispatched. */
+static void
+receiveServiceResponse(UA_Client *client, UA_UInt32 requestId, void *response,
+                       const UA_DataType *responseType, UA_Arena *arena) {
+    UA_ResponseHeader *respHeader = (UA_ResponseHeader*)response;
+    SyncResponseDescription rd = {false, requestId, response, responseType, arena};
+    UA_DateTime maxDate = UA_DateTime_nowMonotonic() +
+        (UA_DateTime)client->config.timeout * UA_MSEC_TO_DATETIME;
+    UA_StatusCode retval = receiveServiceResponses(client, &rd, maxDate);
+    if(retval == UA_STATUSCODE_GOOD && !rd.received)
+        retval = UA_STATUSCODE_BADTIMEOUT;
     if(retval != UA_STATUSCODE_GOOD) {
-        if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
-            respHeader->serviceResult = UA_STATUSCODE_BADREQUESTTOOLARGE;
-        else
-            respHeader->serviceResult = retval;
+        respHeader->serviceResult = retval;
+        return;
+    }
+    client->state = UA_CLIENTSTATE_CONNECTED;
+    UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                 "Received a response of type %i", responseType->typeId.identifier.numeric);
+}
+
+void __UA_Client_Service(UA_Client *client, const void *request, const UA_DataType *requestType,
+                         void *response, const UA_DataType *responseType) {
+    UA_init(response, responseType);
+    UA_ResponseHeader *respHeader = (UA_ResponseHeader*)response;
+
+    UA_UInt32 requestId;
+    UA_StatusCode retval = sendServiceRequest(client, request, requestType, &requestId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        respHeader->serviceResult = retval;
         client->state = UA_CLIENTSTATE_ERRORED;
         return;
     }
+    receiveServiceResponse(client, requestId, response, responseType, NULL);
+}
 
-    /* Retrieve the response */
-    // Todo: push this into the generic securechannel implementation for client and server
-    UA_ByteString reply;
-    UA_ByteString_init(&reply);
-    UA_Boolean realloced = false;
-    do {
-        retval = client->connection.recv(&client->connection, &reply, client->config.timeout);
-        retval |= UA_Connection_completeMessages(&client->connection, &reply, &realloced);
-        if(retval != UA_STATUSCODE_GOOD) {
-            respHeader->serviceResult = retval;
-            client->state = UA_CLIENTSTATE_ERRORED;
-            return;
-        }
-    } while(!reply.data);
+UA_StatusCode
+__UA_Client_AsyncService(UA_Client *client, const void *request, const UA_DataType *requestType,
+                         UA_ClientAsyncServiceCallback callback, const UA_DataType *responseType,
+                         void *userdata, UA_UInt32 *requestId) {
+    AsyncServiceCall *ac = UA_malloc(sizeof(AsyncServiceCall));
+    if(!ac)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = sendServiceRequest(client, request, requestType, &ac->requestId);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(ac);
+        return retval;
+    }
+    ac->callback = callback;
+    ac->responseType = responseType;
+    ac->userdata = userdata;
+    LIST_INSERT_HEAD(&client->asyncServiceCalls, ac, pointers);
+    if(requestId)
+        *requestId = ac->requestId;
+    return UA_STATUSCODE_GOOD;
+}
 
-    size_t offset = 0;
-    UA_SecureConversationMessageHeader msgHeader;
-    retval |= UA_SecureConversationMessageHeader_decodeBinary(&reply, &offset, &msgHeader);
-    UA_SymmetricAlgorithmSecurityHeader symHeader;
-    retval |= UA_SymmetricAlgorithmSecurityHeader_decodeBinary(&reply, &offset, &symHeader);
-    UA_SequenceHeader seqHeader;
-    retval |= UA_SequenceHeader_decodeBinary(&reply, &offset, &seqHeader);
-    UA_NodeId responseId;
-    retval |= UA_NodeId_decodeBinary(&reply, &offset, &responseId);
-    UA_NodeId expectedNodeId = UA_NODEID_NUMERIC(0, responseType->typeId.identifier.numeric +
-                                                 UA_ENCODINGOFFSET_BINARY);
+UA_StatusCode UA_Client_run_iterate(UA_Client *client, UA_UInt16 timeout) {
+    if(client->state != UA_CLIENTSTATE_CONNECTED)
+        return UA_STATUSCODE_BADSERVERNOTCONNECTED;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_Client_Subscriptions_sendPublishRequests(client);
+#endif
+    UA_DateTime maxDate = UA_DateTime_nowMonotonic() + (UA_DateTime)timeout * UA_MSEC_TO_DATETIME;
+    return receiveServiceResponses(client, NULL, maxDate);
+}
 
+/*********************/
+/* Prepared Requests */
+/*********************/
+
+/* The encoded size of the RequestHeader fields that change for every send */
+static size_t
+preparedFieldsSize(const UA_RequestHeader *header) {
+    return UA_calcSizeBinary((void*)(uintptr_t)&header->authenticationToken,
+                             &UA_TYPES[UA_TYPES_NODEID]) +
+        sizeof(UA_DateTime) + sizeof(UA_UInt32);
+}
+
+UA_StatusCode
+UA_Client_prepareRequest(const void *request, const UA_DataType *requestType,
+                         const UA_DataType *responseType, UA_PreparedRequest *prepared) {
+    /* Requests always begin with a RequestHeader */
+    const UA_RequestHeader *header = (const UA_RequestHeader*)request;
+    size_t skip = preparedFieldsSize(header);
+    size_t size = UA_calcSizeBinary((void*)(uintptr_t)request, requestType);
+
+    UA_ByteString buf;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&buf, size);
     if(retval != UA_STATUSCODE_GOOD)
-        goto finish;
+        return retval;
+    size_t offset = 0;
+    retval = UA_encodeBinary(request, requestType, NULL, NULL, &buf, &offset);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&buf);
+        return retval;
+    }
 
-    /* Todo: we need to demux responses since a publish responses may come at any time */
-    if(!UA_NodeId_equal(&responseId, &expectedNodeId) || seqHeader.requestId != requestId) {
-        if(responseId.identifier.numeric != UA_NS0ID_SERVICEFAULT + UA_ENCODINGOFFSET_BINARY) {
-            UA_LOG_ERROR(client->config.logger, UA_LOGCATEGORY_CLIENT,
-                         "Reply answers the wrong request. Expected ns=%i,i=%i. But retrieved ns=%i,i=%i",
-                         expectedNodeId.namespaceIndex, expectedNodeId.identifier.numeric,
-                         responseId.namespaceIndex, responseId.identifier.numeric);
-            respHeader->serviceResult = UA_STATUSCODE_BADINTERNALERROR;
-        } else
-            retval = UA_decodeBinary(&reply, &offset, respHeader, &UA_TYPES[UA_TYPES_SERVICEFAULT]);
-        goto finish;
-    } 
-    
-    retval = UA_decodeBinary(&reply, &offset, response, responseType);
-    if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
-        retval = UA_STATUSCODE_BADRESPONSETOOLARGE;
+    /* Keep only the encoding behind the changing fields */
+    memmove(buf.data, &buf.data[skip], offset - skip);
+    buf.length = offset - skip;
+    prepared->requestType = requestType;
+    prepared->responseType = responseType;
+    prepared->encoding = buf;
+    return UA_STATUSCODE_GOOD;
+}
 
- finish:
-    UA_SymmetricAlgorithmSecurityHeader_deleteMembers(&symHeader);
-    if(!realloced)
-        client->connection.releaseRecvBuffer(&client->connection, &reply);
-    else
-        UA_ByteString_deleteMembers(&reply);
+void UA_PreparedRequest_deleteMembers(UA_PreparedRequest *prepared) {
+    UA_ByteString_deleteMembers(&prepared->encoding);
+}
 
-    if(retval != UA_STATUSCODE_GOOD){
-        UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT, "Error receiving the response");
-        client->state = UA_CLIENTSTATE_FAULTED;
+static UA_StatusCode
+sendPreparedRequest(UA_Client *client, const UA_PreparedRequest *prepared,
+                    void *response, UA_Arena *arena) {
+    UA_ResponseHeader *respHeader = (UA_ResponseHeader*)response;
+    UA_StatusCode retval = renewSecureChannel(client);
+    if(retval != UA_STATUSCODE_GOOD) {
         respHeader->serviceResult = retval;
-    } else {
-      client->state = UA_CLIENTSTATE_CONNECTED;
+        return retval;
     }
-    UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
-                 "Received a response of type %i", responseId.identifier.numeric);
+
+    /* Encode the changing fields of the RequestHeader and copy the rest */
+    UA_DateTime timestamp = UA_DateTime_now();
+    UA_UInt32 requestHandle = ++client->requestHandle;
+    UA_UInt32 requestId = ++client->requestId;
+    UA_MessageContext mc;
+    retval = UA_SecureChannel_beginMessage(&client->channel, requestId, prepared->requestType, &mc);
+    if(retval == UA_STATUSCODE_GOOD) {
+        retval |= UA_SecureChannel_encodeMessage(&mc, &client->authenticationToken,
+                                                 &UA_TYPES[UA_TYPES_NODEID]);
+        retval |= UA_SecureChannel_encodeMessage(&mc, &timestamp, &UA_TYPES[UA_TYPES_DATETIME]);
+        retval |= UA_SecureChannel_encodeMessage(&mc, &requestHandle, &UA_TYPES[UA_TYPES_UINT32]);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = UA_SecureChannel_writeMessageBytes(&mc, &prepared->encoding);
+        retval = UA_SecureChannel_finishMessage(&mc, retval);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+            retval = UA_STATUSCODE_BADREQUESTTOOLARGE;
+        respHeader->serviceResult = retval;
+        client->state = UA_CLIENTSTATE_ERRORED;
+        return retval;
+    }
+
+    receiveServiceResponse(client, requestId, response, prepared->responseType, arena);
+    return respHeader->serviceResult;
+}
+
+UA_StatusCode
+UA_Client_sendPreparedRequest(UA_Client *client, const UA_PreparedRequest *prepared,
+                              void *response) {
+    UA_deleteMembers(response, prepared->responseType);
+    return sendPreparedRequest(client, prepared, response, NULL);
+}
+
+UA_StatusCode
+UA_Client_sendPreparedRequestArena(UA_Client *client, const UA_PreparedRequest *prepared,
+                                   void *response, void *arenaBuf, size_t arenaBufSize) {
+    /* The previous response becomes invalid */
+    releaseResponseMessage(client);
+    UA_Arena_init(&client->responseArena, arenaBuf, arenaBufSize);
+    UA_init(response, prepared->responseType);
+    return sendPreparedRequest(client, prepared, response, &client->responseArena);
 }
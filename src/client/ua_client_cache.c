@@ -0,0 +1,332 @@
+#include "ua_client_highlevel.h"
+#include "ua_client_internal.h"
+#include "ua_util.h"
+
+/* The cache is a hash-map with chaining. All entries of a node are in the same
+ * bucket, so that the node can be invalidated at once. */
+
+#define UA_CLIENT_CACHE_MINBUCKETS 64
+
+static UA_UInt32
+nodeIdHash(const UA_NodeId *n) {
+    const UA_Byte *data;
+    size_t len;
+    switch(n->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        /* Knuth's multiplicative hashing */
+        return (UA_UInt32)((n->identifier.numeric + n->namespaceIndex) * 2654435761u);
+    case UA_NODEIDTYPE_GUID:
+        data = (const UA_Byte*)&n->identifier.guid;
+        len = sizeof(UA_Guid);
+        break;
+    default: /* string and bytestring */
+        data = n->identifier.string.data;
+        len = n->identifier.string.length;
+        break;
+    }
+    /* FNV-1a */
+    UA_UInt32 h = 2166136261u ^ n->namespaceIndex;
+    for(size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void
+deleteEntry(UA_Client_CacheEntry *entry) {
+    if(entry->attributeId == 0) {
+        UA_BrowseDescription_deleteMembers(&entry->key.browse);
+        UA_BrowseResult_deleteMembers(&entry->content.browseResult);
+    } else {
+        UA_NodeId_deleteMembers(&entry->key.nodeId);
+        UA_DataValue_deleteMembers(&entry->content.value);
+    }
+    UA_free(entry);
+}
+
+static const UA_NodeId *
+entryNodeId(const UA_Client_CacheEntry *entry) {
+    if(entry->attributeId == 0)
+        return &entry->key.browse.nodeId;
+    return &entry->key.nodeId;
+}
+
+void UA_Client_Cache_clear(UA_Client *client) {
+    UA_Client_Cache *cache = &client->cache;
+    for(size_t i = 0; i < cache->bucketsSize; i++) {
+        UA_Client_CacheEntry *entry = cache->buckets[i];
+        while(entry) {
+            UA_Client_CacheEntry *next = entry->next;
+            deleteEntry(entry);
+            entry = next;
+        }
+    }
+    UA_free(cache->buckets);
+    cache->buckets = NULL;
+    cache->bucketsSize = 0;
+    cache->entriesSize = 0;
+}
+
+UA_StatusCode
+UA_Client_Cache_enable(UA_Client *client, UA_UInt32 ttl) {
+    if(ttl == 0)
+        UA_Client_Cache_clear(client);
+    client->cache.ttl = (UA_DateTime)ttl * UA_MSEC_TO_DATETIME;
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_Client_Cache_invalidate(UA_Client *client, const UA_NodeId nodeId) {
+    UA_Client_Cache *cache = &client->cache;
+    if(cache->entriesSize == 0)
+        return;
+    UA_Client_CacheEntry **pos = &cache->buckets[nodeIdHash(&nodeId) & (cache->bucketsSize - 1)];
+    while(*pos) {
+        UA_Client_CacheEntry *entry = *pos;
+        if(!UA_NodeId_equal(entryNodeId(entry), &nodeId)) {
+            pos = &entry->next;
+            continue;
+        }
+        *pos = entry->next;
+        deleteEntry(entry);
+        cache->entriesSize--;
+    }
+}
+
+/* Returns the matching entry. Expired entries are removed on the way. */
+static UA_Client_CacheEntry *
+findEntry(UA_Client_Cache *cache, const UA_NodeId *nodeId, UA_UInt32 attributeId,
+          const UA_BrowseDescription *bd) {
+    if(cache->entriesSize == 0)
+        return NULL;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_Client_CacheEntry **pos = &cache->buckets[nodeIdHash(nodeId) & (cache->bucketsSize - 1)];
+    while(*pos) {
+        UA_Client_CacheEntry *entry = *pos;
+        if(entry->expires <= now) {
+            *pos = entry->next;
+            deleteEntry(entry);
+            cache->entriesSize--;
+            continue;
+        }
+        if(entry->attributeId == attributeId && UA_NodeId_equal(entryNodeId(entry), nodeId)) {
+            const UA_BrowseDescription *k = &entry->key.browse;
+            if(attributeId != 0 ||
+               (k->browseDirection == bd->browseDirection &&
+                UA_NodeId_equal(&k->referenceTypeId, &bd->referenceTypeId) &&
+                k->includeSubtypes == bd->includeSubtypes &&
+                k->nodeClassMask == bd->nodeClassMask &&
+                k->resultMask == bd->resultMask))
+                return entry;
+        }
+        pos = &entry->next;
+    }
+    return NULL;
+}
+
+static UA_StatusCode
+resize(UA_Client_Cache *cache, size_t bucketsSize) {
+    UA_Client_CacheEntry **buckets = UA_calloc(bucketsSize, sizeof(UA_Client_CacheEntry*));
+    if(!buckets)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < cache->bucketsSize; i++) {
+        UA_Client_CacheEntry *entry = cache->buckets[i];
+        while(entry) {
+            UA_Client_CacheEntry *next = entry->next;
+            size_t b = nodeIdHash(entryNodeId(entry)) & (bucketsSize - 1);
+            entry->next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+    UA_free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucketsSize = bucketsSize;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void
+insertEntry(UA_Client_Cache *cache, UA_Client_CacheEntry *entry) {
+    if(cache->entriesSize >= cache->bucketsSize) {
+        size_t bucketsSize = cache->bucketsSize ? cache->bucketsSize * 2 : UA_CLIENT_CACHE_MINBUCKETS;
+        if(resize(cache, bucketsSize) != UA_STATUSCODE_GOOD && cache->bucketsSize == 0) {
+            deleteEntry(entry);
+            return;
+        }
+    }
+    entry->expires = UA_DateTime_nowMonotonic() + cache->ttl;
+    size_t b = nodeIdHash(entryNodeId(entry)) & (cache->bucketsSize - 1);
+    entry->next = cache->buckets[b];
+    cache->buckets[b] = entry;
+    cache->entriesSize++;
+}
+
+const UA_DataValue *
+UA_Client_Cache_getAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_UInt32 attributeId) {
+    UA_Client_CacheEntry *entry = findEntry(&client->cache, nodeId, attributeId, NULL);
+    return entry ? &entry->content.value : NULL;
+}
+
+void
+UA_Client_Cache_putAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_UInt32 attributeId,
+                             const UA_DataValue *value) {
+    UA_Client_Cache *cache = &client->cache;
+    if(cache->ttl == 0)
+        return;
+    UA_Client_CacheEntry *old = findEntry(cache, nodeId, attributeId, NULL);
+    if(old)
+        return;
+    UA_Client_CacheEntry *entry = UA_calloc(1, sizeof(UA_Client_CacheEntry));
+    if(!entry)
+        return;
+    entry->attributeId = attributeId;
+    if(UA_NodeId_copy(nodeId, &entry->key.nodeId) != UA_STATUSCODE_GOOD ||
+       UA_DataValue_copy(value, &entry->content.value) != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return;
+    }
+    insertEntry(cache, entry);
+}
+
+static void
+putBrowseResult(UA_Client_Cache *cache, const UA_BrowseDescription *bd,
+                const UA_BrowseResult *result) {
+    if(cache->ttl == 0 || result->statusCode != UA_STATUSCODE_GOOD ||
+       findEntry(cache, &bd->nodeId, 0, bd))
+        return;
+    UA_Client_CacheEntry *entry = UA_calloc(1, sizeof(UA_Client_CacheEntry));
+    if(!entry)
+        return;
+    if(UA_BrowseDescription_copy(bd, &entry->key.browse) != UA_STATUSCODE_GOOD ||
+       UA_BrowseResult_copy(result, &entry->content.browseResult) != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return;
+    }
+    insertEntry(cache, entry);
+}
+
+/**********/
+/* Browse */
+/**********/
+
+/* Moves the references of next behind the references of result */
+static UA_StatusCode
+appendReferences(UA_BrowseResult *result, UA_BrowseResult *next) {
+    if(next->referencesSize == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_ReferenceDescription *refs =
+        UA_realloc(result->referencesSize > 0 ? result->references : NULL,
+                   (result->referencesSize + next->referencesSize) * sizeof(UA_ReferenceDescription));
+    if(!refs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memcpy(&refs[result->referencesSize], next->references,
+           next->referencesSize * sizeof(UA_ReferenceDescription));
+    result->references = refs;
+    result->referencesSize += next->referencesSize;
+    UA_free(next->references);
+    next->references = NULL;
+    next->referencesSize = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Browses the nodes in one request and follows the continuation points with
+ * batched BrowseNext requests until the results are complete. The results are
+ * empty if the browse fails. */
+static UA_StatusCode
+browseComplete(UA_Client *client, const UA_BrowseDescription *bds, size_t bdsSize,
+               UA_BrowseResult *results) {
+    for(size_t i = 0; i < bdsSize; i++)
+        UA_BrowseResult_init(&results[i]);
+    UA_BrowseRequest request;
+    UA_BrowseRequest_init(&request);
+    request.nodesToBrowse = (UA_BrowseDescription*)(uintptr_t)bds;
+    request.nodesToBrowseSize = bdsSize;
+    UA_BrowseResponse response = UA_Client_Service_browse(client, request);
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if(retval == UA_STATUSCODE_GOOD && response.resultsSize != bdsSize)
+        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_BrowseResponse_deleteMembers(&response);
+        return retval;
+    }
+    memcpy(results, response.results, bdsSize * sizeof(UA_BrowseResult));
+    UA_free(response.results);
+    response.results = NULL;
+    response.resultsSize = 0;
+    UA_BrowseResponse_deleteMembers(&response);
+
+    /* Continue all incomplete results at once */
+    size_t *indices = UA_malloc(bdsSize * sizeof(size_t));
+    UA_ByteString *cps = UA_malloc(bdsSize * sizeof(UA_ByteString));
+    if(!indices || !cps)
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    while(retval == UA_STATUSCODE_GOOD) {
+        size_t cpsSize = 0;
+        for(size_t i = 0; i < bdsSize; i++) {
+            if(results[i].continuationPoint.length == 0)
+                continue;
+            indices[cpsSize] = i;
+            cps[cpsSize] = results[i].continuationPoint;
+            cpsSize++;
+        }
+        if(cpsSize == 0)
+            break;
+
+        UA_BrowseNextRequest nextRequest;
+        UA_BrowseNextRequest_init(&nextRequest);
+        nextRequest.continuationPoints = cps;
+        nextRequest.continuationPointsSize = cpsSize;
+        UA_BrowseNextResponse nextResponse = UA_Client_Service_browseNext(client, nextRequest);
+        retval = nextResponse.responseHeader.serviceResult;
+        if(retval == UA_STATUSCODE_GOOD && nextResponse.resultsSize != cpsSize)
+            retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        for(size_t j = 0; j < cpsSize && retval == UA_STATUSCODE_GOOD; j++) {
+            UA_BrowseResult *result = &results[indices[j]];
+            UA_BrowseResult *next = &nextResponse.results[j];
+            UA_ByteString_deleteMembers(&result->continuationPoint);
+            result->continuationPoint = next->continuationPoint;
+            UA_ByteString_init(&next->continuationPoint);
+            result->statusCode = next->statusCode;
+            retval = appendReferences(result, next);
+        }
+        UA_BrowseNextResponse_deleteMembers(&nextResponse);
+    }
+    UA_free(indices);
+    UA_free(cps);
+    if(retval != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < bdsSize; i++)
+            UA_BrowseResult_deleteMembers(&results[i]);
+    }
+    return retval;
+}
+
+UA_StatusCode
+UA_Client_browse(UA_Client *client, const UA_BrowseDescription *bd, UA_BrowseResult *result) {
+    UA_Client_CacheEntry *entry = findEntry(&client->cache, &bd->nodeId, 0, bd);
+    if(entry)
+        return UA_BrowseResult_copy(&entry->content.browseResult, result);
+    UA_StatusCode retval = browseComplete(client, bd, 1, result);
+    if(retval == UA_STATUSCODE_GOOD)
+        putBrowseResult(&client->cache, bd, result);
+    return retval;
+}
+
+UA_StatusCode
+UA_Client_Cache_prefetch(UA_Client *client, const UA_BrowseDescription *bds, size_t bdsSize) {
+    if(client->cache.ttl == 0)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    if(bdsSize == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_BrowseResult *results = UA_malloc(bdsSize * sizeof(UA_BrowseResult));
+    if(!results)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = browseComplete(client, bds, bdsSize, results);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(results);
+        return retval;
+    }
+    for(size_t i = 0; i < bdsSize; i++)
+        putBrowseResult(&client->cache, &bds[i], &results[i]);
+    UA_Array_delete(results, bdsSize, &UA_TYPES[UA_TYPES_BROWSERESULT]);
+    return UA_STATUSCODE_GOOD;
+}
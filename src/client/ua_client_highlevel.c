@@ -1,6 +1,7 @@
 #include "ua_client.h"
 #include "ua_nodeids.h"
 #include "ua_client_highlevel.h"
+#include "ua_client_internal.h"
 #include "ua_types_encoding_binary.h"
 #include "ua_util.h"
 #include "ua_types.h"
@@ -46,34 +47,22 @@ UA_Client_NamespaceGetIndex(UA_Client *client, UA_String *namespaceUri, UA_UInt1
 
 UA_StatusCode
 UA_Client_forEachChildNodeCall(UA_Client *client, UA_NodeId parentNodeId, UA_NodeIteratorCallback callback, void *handle) {
-  UA_StatusCode retval = UA_STATUSCODE_GOOD;
-  
-  UA_BrowseRequest bReq;
-  UA_BrowseRequest_init(&bReq);
-  bReq.requestedMaxReferencesPerNode = 0;
-  bReq.nodesToBrowse = UA_BrowseDescription_new();
-  bReq.nodesToBrowseSize = 1;
-  UA_NodeId_copy(&parentNodeId, &bReq.nodesToBrowse[0].nodeId);
-  bReq.nodesToBrowse[0].resultMask = UA_BROWSERESULTMASK_ALL; //return everything
-  bReq.nodesToBrowse[0].browseDirection = UA_BROWSEDIRECTION_BOTH;
-  
-  UA_BrowseResponse bResp = UA_Client_Service_browse(client, bReq);
-  
-  if(bResp.responseHeader.serviceResult == UA_STATUSCODE_GOOD) {
-    for (size_t i = 0; i < bResp.resultsSize; ++i) {
-      for (size_t j = 0; j < bResp.results[i].referencesSize; ++j) {
-        UA_ReferenceDescription *ref = &(bResp.results[i].references[j]);
-        retval |= callback(ref->nodeId.nodeId, ! ref->isForward, ref->referenceTypeId, handle);
-      }
-    }
+  UA_BrowseDescription bd;
+  UA_BrowseDescription_init(&bd);
+  bd.nodeId = parentNodeId;
+  bd.resultMask = UA_BROWSERESULTMASK_ALL; //return everything
+  bd.browseDirection = UA_BROWSEDIRECTION_BOTH;
+
+  UA_BrowseResult result;
+  UA_StatusCode retval = UA_Client_browse(client, &bd, &result);
+  if(retval != UA_STATUSCODE_GOOD)
+    return retval;
+
+  for (size_t j = 0; j < result.referencesSize; ++j) {
+    UA_ReferenceDescription *ref = &(result.references[j]);
+    retval |= callback(ref->nodeId.nodeId, ! ref->isForward, ref->referenceTypeId, handle);
   }
-  else
-    retval = bResp.responseHeader.serviceResult;
-  
-  
-  UA_BrowseRequest_deleteMembers(&bReq);
-  UA_BrowseResponse_deleteMembers(&bResp);
-  
+  UA_BrowseResult_deleteMembers(&result);
   return retval;
 }
 
@@ -81,10 +70,14 @@ UA_Client_forEachChildNodeCall(UA_Client *client, UA_NodeId parentNodeId, UA_Nod
 /* Node Management */
 /*******************/
 
+#ifdef UA_TYPES_ADDNODESREQUEST
+
 UA_StatusCode UA_EXPORT
 UA_Client_addReference(UA_Client *client, const UA_NodeId sourceNodeId, const UA_NodeId referenceTypeId,
                        UA_Boolean isForward, const UA_String targetServerUri,
                        const UA_ExpandedNodeId targetNodeId, UA_NodeClass targetNodeClass) {
+    UA_Client_Cache_invalidate(client, sourceNodeId);
+    UA_Client_Cache_invalidate(client, targetNodeId.nodeId);
     UA_AddReferencesItem item;
     UA_AddReferencesItem_init(&item);
     item.sourceNodeId = sourceNodeId;
@@ -116,6 +109,8 @@ UA_StatusCode UA_EXPORT
 UA_Client_deleteReference(UA_Client *client, const UA_NodeId sourceNodeId, const UA_NodeId referenceTypeId,
                           UA_Boolean isForward, const UA_ExpandedNodeId targetNodeId,
                           UA_Boolean deleteBidirectional) {
+    UA_Client_Cache_invalidate(client, sourceNodeId);
+    UA_Client_Cache_invalidate(client, targetNodeId.nodeId);
     UA_DeleteReferencesItem item;
     UA_DeleteReferencesItem_init(&item);
     item.sourceNodeId = sourceNodeId;
@@ -144,6 +139,8 @@ UA_Client_deleteReference(UA_Client *client, const UA_NodeId sourceNodeId, const
 
 UA_StatusCode
 UA_Client_deleteNode(UA_Client *client, const UA_NodeId nodeId, UA_Boolean deleteTargetReferences) {
+    /* The browse results of the referencing nodes expire with the ttl */
+    UA_Client_Cache_invalidate(client, nodeId);
     UA_DeleteNodesItem item;
     UA_DeleteNodesItem_init(&item);
     item.nodeId = nodeId;
@@ -172,6 +169,7 @@ __UA_Client_addNode(UA_Client *client, const UA_NodeClass nodeClass, const UA_No
                     const UA_NodeId parentNodeId, const UA_NodeId referenceTypeId,
                     const UA_QualifiedName browseName, const UA_NodeId typeDefinition,
                     const UA_NodeAttributes *attr, const UA_DataType *attributeType, UA_NodeId *outNewNodeId) {
+    UA_Client_Cache_invalidate(client, parentNodeId);
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_AddNodesRequest request;
     UA_AddNodesRequest_init(&request);
@@ -207,10 +205,14 @@ __UA_Client_addNode(UA_Client *client, const UA_NodeClass nodeClass, const UA_No
     return retval;
 }
 
+#endif
+
 /********/
 /* Call */
 /********/
 
+#ifdef UA_TYPES_CALLREQUEST
+
 UA_StatusCode
 UA_Client_call(UA_Client *client, const UA_NodeId objectId, const UA_NodeId methodId, size_t inputSize,
                const UA_Variant *input, size_t *outputSize, UA_Variant **output) {
@@ -246,11 +248,67 @@ UA_Client_call(UA_Client *client, const UA_NodeId objectId, const UA_NodeId meth
     UA_CallResponse_deleteMembers(&response);
     return retval;
 }
+#endif
+
+/**********************/
+/* Batched Operations */
+/**********************/
+
+static UA_Client_BatchedOperation *
+appendBatchedOperation(UA_Client *client) {
+    if(client->batchSize == client->batchCapacity) {
+        size_t newCapacity = client->batchCapacity ? client->batchCapacity * 2 : 8;
+        UA_Client_BatchedOperation *newBatch =
+            UA_realloc(client->batch, newCapacity * sizeof(UA_Client_BatchedOperation));
+        if(!newBatch)
+            return NULL;
+        client->batch = newBatch;
+        client->batchCapacity = newCapacity;
+    }
+    UA_Client_BatchedOperation *op = &client->batch[client->batchSize];
+    memset(op, 0, sizeof(UA_Client_BatchedOperation));
+    return op;
+}
+
+UA_StatusCode
+UA_Client_beginBatch(UA_Client *client) {
+    if(client->batching)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    client->batching = true;
+    return UA_STATUSCODE_GOOD;
+}
 
 /********************/
 /* Write Attributes */
 /********************/
 
+/* Sends the write, or queues a copy of it if a batch is open */
+static UA_StatusCode
+writeValue(UA_Client *client, const UA_WriteValue *wValue) {
+    UA_Client_Cache_invalidate(client, wValue->nodeId);
+    if(client->batching) {
+        UA_Client_BatchedOperation *op = appendBatchedOperation(client);
+        if(!op)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_StatusCode retval = UA_WriteValue_copy(wValue, &op->item.write);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        op->isWrite = true;
+        client->batchSize++;
+        return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+    }
+
+    UA_WriteRequest wReq;
+    UA_WriteRequest_init(&wReq);
+    wReq.nodesToWrite = (UA_WriteValue*)(uintptr_t)wValue;
+    wReq.nodesToWriteSize = 1;
+
+    UA_WriteResponse wResp = UA_Client_Service_write(client, wReq);
+    UA_StatusCode retval = wResp.responseHeader.serviceResult;
+    UA_WriteResponse_deleteMembers(&wResp);
+    return retval;
+}
+
 UA_StatusCode 
 __UA_Client_writeAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_AttributeId attributeId,
                            const void *in, const UA_DataType *inDataType) {
@@ -266,15 +324,7 @@ __UA_Client_writeAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_Attrib
     else
         UA_Variant_setScalar(&wValue.value.value, (void*)(uintptr_t)in, inDataType); /* hack. is never written into. */
     wValue.value.hasValue = true;
-    UA_WriteRequest wReq;
-    UA_WriteRequest_init(&wReq);
-    wReq.nodesToWrite = &wValue;
-    wReq.nodesToWriteSize = 1;
-    
-    UA_WriteResponse wResp = UA_Client_Service_write(client, wReq);
-    UA_StatusCode retval = wResp.responseHeader.serviceResult;
-    UA_WriteResponse_deleteMembers(&wResp);
-    return retval;
+    return writeValue(client, &wValue);
 }
 
 UA_StatusCode
@@ -290,21 +340,35 @@ UA_Client_writeArrayDimensionsAttribute(UA_Client *client, const UA_NodeId nodeI
     UA_Variant_setArray(&wValue.value.value, (void*)(uintptr_t)newArrayDimensions,
                         newArrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
     wValue.value.hasValue = true;
-    UA_WriteRequest wReq;
-    UA_WriteRequest_init(&wReq);
-    wReq.nodesToWrite = &wValue;
-    wReq.nodesToWriteSize = 1;
-    
-    UA_WriteResponse wResp = UA_Client_Service_write(client, wReq);
-    UA_StatusCode retval = wResp.responseHeader.serviceResult;
-    UA_WriteResponse_deleteMembers(&wResp);
-    return retval;
+    return writeValue(client, &wValue);
 }
 
 /*******************/
 /* Read Attributes */
 /*******************/
 
+/* Moves the result of a single attribute read into out */
+static UA_StatusCode
+processReadResult(UA_DataValue *res, UA_AttributeId attributeId,
+                  void *out, const UA_DataType *outDataType) {
+    if(res->hasStatus && res->status != UA_STATUSCODE_GOOD)
+        return res->status;
+    if(!res->hasValue || !UA_Variant_isScalar(&res->value))
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+
+    if(attributeId == UA_ATTRIBUTEID_VALUE) {
+        memcpy(out, &res->value, sizeof(UA_Variant));
+        UA_Variant_init(&res->value);
+        return UA_STATUSCODE_GOOD;
+    }
+    if(res->value.type != outDataType)
+        return UA_STATUSCODE_BADUNEXPECTEDERROR;
+    memcpy(out, res->value.data, res->value.type->memSize);
+    UA_free(res->value.data);
+    res->value.data = NULL;
+    return UA_STATUSCODE_GOOD;
+}
+
 UA_StatusCode 
 __UA_Client_readAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_AttributeId attributeId,
                           void *out, const UA_DataType *outDataType) {
@@ -312,6 +376,35 @@ __UA_Client_readAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_Attribu
     UA_ReadValueId_init(&item);
     item.nodeId = *nodeId;
     item.attributeId = attributeId;
+
+    if(client->batching) {
+        UA_Client_BatchedOperation *op = appendBatchedOperation(client);
+        if(!op)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        UA_StatusCode retval = UA_ReadValueId_copy(&item, &op->item.read);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        op->out = out;
+        op->outDataType = outDataType;
+        client->batchSize++;
+        return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+    }
+
+    /* Attributes other than the value are cached */
+    UA_Boolean cacheable = (client->cache.ttl > 0 && attributeId != UA_ATTRIBUTEID_VALUE);
+    if(cacheable) {
+        const UA_DataValue *cached = UA_Client_Cache_getAttribute(client, nodeId, attributeId);
+        if(cached) {
+            UA_DataValue res;
+            UA_StatusCode retval = UA_DataValue_copy(cached, &res);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            retval = processReadResult(&res, attributeId, out, outDataType);
+            UA_DataValue_deleteMembers(&res);
+            return retval;
+        }
+    }
+
     UA_ReadRequest request;
     UA_ReadRequest_init(&request);
     request.nodesToRead = &item;
@@ -320,33 +413,11 @@ __UA_Client_readAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_Attribu
     UA_StatusCode retval = response.responseHeader.serviceResult;
     if(retval == UA_STATUSCODE_GOOD && response.resultsSize != 1)
         retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_ReadResponse_deleteMembers(&response);
-        return retval;
-    }
-
-    UA_DataValue *res = response.results;
-    if(res->hasStatus != UA_STATUSCODE_GOOD)
-        retval = res->hasStatus;
-    else if(!res->hasValue || !UA_Variant_isScalar(&res->value))
-        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_ReadResponse_deleteMembers(&response);
-        return retval;
-    }
-
-    if(attributeId == UA_ATTRIBUTEID_VALUE) {
-        memcpy(out, &res->value, sizeof(UA_Variant));
-        UA_Variant_init(&res->value);
-    } else if(UA_Variant_isScalar(&res->value) &&
-              res->value.type == outDataType) {
-        memcpy(out, res->value.data, res->value.type->memSize);
-        UA_free(res->value.data);
-        res->value.data = NULL;
-    } else {
-        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
-    }
-
+    if(retval == UA_STATUSCODE_GOOD && cacheable &&
+       (!response.results->hasStatus || response.results->status == UA_STATUSCODE_GOOD))
+        UA_Client_Cache_putAttribute(client, nodeId, attributeId, response.results);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = processReadResult(response.results, attributeId, out, outDataType);
     UA_ReadResponse_deleteMembers(&response);
     return retval;
 }
@@ -370,8 +441,8 @@ UA_Client_readArrayDimensionsAttribute(UA_Client *client, const UA_NodeId nodeId
         goto cleanup;
 
     UA_DataValue *res = response.results;
-    if(res->hasStatus != UA_STATUSCODE_GOOD)
-        retval = res->hasStatus;
+    if(res->hasStatus && res->status != UA_STATUSCODE_GOOD)
+        retval = res->status;
     else if(!res->hasValue || UA_Variant_isScalar(&res->value))
         retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
     if(retval != UA_STATUSCODE_GOOD)
@@ -394,3 +465,129 @@ UA_Client_readArrayDimensionsAttribute(UA_Client *client, const UA_NodeId nodeId
     return retval;
 
 }
+
+/*******************/
+/* Flush the Batch */
+/*******************/
+
+static void
+setOperationResults(UA_StatusCode *results, size_t size, UA_StatusCode status) {
+    if(!results)
+        return;
+    for(size_t i = 0; i < size; i++)
+        results[i] = status;
+}
+
+static UA_StatusCode
+flushReads(UA_Client *client, UA_Client_BatchedOperation *ops, size_t opsSize,
+           UA_StatusCode *results) {
+    /* The request points to the queued items without copying them */
+    UA_ReadValueId *items = UA_malloc(opsSize * sizeof(UA_ReadValueId));
+    if(!items) {
+        setOperationResults(results, opsSize, UA_STATUSCODE_BADOUTOFMEMORY);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for(size_t i = 0; i < opsSize; i++)
+        items[i] = ops[i].item.read;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = items;
+    request.nodesToReadSize = opsSize;
+    UA_ReadResponse response = UA_Client_Service_read(client, request);
+    UA_free(items);
+
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if(retval == UA_STATUSCODE_GOOD && response.resultsSize != opsSize)
+        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if(retval != UA_STATUSCODE_GOOD) {
+        setOperationResults(results, opsSize, retval);
+    } else {
+        for(size_t i = 0; i < opsSize; i++) {
+            UA_StatusCode res = processReadResult(&response.results[i], ops[i].item.read.attributeId,
+                                                  ops[i].out, ops[i].outDataType);
+            if(results)
+                results[i] = res;
+        }
+    }
+    UA_ReadResponse_deleteMembers(&response);
+    return retval;
+}
+
+static UA_StatusCode
+flushWrites(UA_Client *client, UA_Client_BatchedOperation *ops, size_t opsSize,
+            UA_StatusCode *results) {
+    UA_WriteValue *items = UA_malloc(opsSize * sizeof(UA_WriteValue));
+    if(!items) {
+        setOperationResults(results, opsSize, UA_STATUSCODE_BADOUTOFMEMORY);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for(size_t i = 0; i < opsSize; i++)
+        items[i] = ops[i].item.write;
+    UA_WriteRequest request;
+    UA_WriteRequest_init(&request);
+    request.nodesToWrite = items;
+    request.nodesToWriteSize = opsSize;
+    UA_WriteResponse response = UA_Client_Service_write(client, request);
+    UA_free(items);
+
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if(retval == UA_STATUSCODE_GOOD && response.resultsSize != opsSize)
+        retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if(retval != UA_STATUSCODE_GOOD)
+        setOperationResults(results, opsSize, retval);
+    else if(results)
+        memcpy(results, response.results, opsSize * sizeof(UA_StatusCode));
+    UA_WriteResponse_deleteMembers(&response);
+    return retval;
+}
+
+UA_StatusCode
+UA_Client_flushBatch(UA_Client *client, UA_StatusCode **operationResults,
+                     size_t *operationResultsSize) {
+    if(!client->batching)
+        return UA_STATUSCODE_BADINVALIDSTATE;
+    client->batching = false;
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_StatusCode *results = NULL;
+    if(operationResults && client->batchSize > 0) {
+        results = UA_Array_new(client->batchSize, &UA_TYPES[UA_TYPES_STATUSCODE]);
+        if(!results)
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    /* Send every run of consecutive reads or writes as one request */
+    size_t i = 0;
+    while(retval == UA_STATUSCODE_GOOD && i < client->batchSize) {
+        UA_Client_BatchedOperation *ops = &client->batch[i];
+        size_t opsSize = 1;
+        while(i + opsSize < client->batchSize && ops[opsSize].isWrite == ops->isWrite)
+            opsSize++;
+        UA_StatusCode *runResults = results ? &results[i] : NULL;
+        if(ops->isWrite)
+            retval = flushWrites(client, ops, opsSize, runResults);
+        else
+            retval = flushReads(client, ops, opsSize, runResults);
+        i += opsSize;
+    }
+
+    /* Operations that were not sent after a failed request */
+    if(results)
+        setOperationResults(&results[i], client->batchSize - i, retval);
+
+    for(size_t j = 0; j < client->batchSize; j++) {
+        UA_Client_BatchedOperation *op = &client->batch[j];
+        if(op->isWrite)
+            UA_WriteValue_deleteMembers(&op->item.write);
+        else
+            UA_ReadValueId_deleteMembers(&op->item.read);
+    }
+
+    if(operationResults) {
+        *operationResults = results;
+        if(operationResultsSize)
+            *operationResultsSize = results ? client->batchSize : 0;
+    }
+    client->batchSize = 0;
+    return retval;
+}
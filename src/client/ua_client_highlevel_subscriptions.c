@@ -36,6 +36,7 @@ UA_StatusCode UA_Client_Subscriptions_new(UA_Client *client, UA_SubscriptionSett
         newSub->SubscriptionID = response.subscriptionId;
         newSub->NotificationsPerPublish = request.maxNotificationsPerPublish;
         newSub->Priority = request.priority;
+        newSub->lastSequenceNumber = 0;
         if(newSubscriptionId)
             *newSubscriptionId = newSub->SubscriptionID;
         LIST_INSERT_HEAD(&client->subscriptions, newSub, listEntry);
@@ -198,17 +199,76 @@ UA_Client_Subscriptions_removeMonitoredItem(UA_Client *client, UA_UInt32 subscri
     return retval;
 }
 
+/* Hands the notifications to the monitored items and queues the
+ * acknowledgement. Messages that were received before are only acknowledged
+ * again (e.g. if they were republished after a reconnect). */
 static void
-UA_Client_processPublishResponse(UA_Client *client, UA_PublishRequest *request, UA_PublishResponse *response) {
-    if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+processNotificationMessage(UA_Client *client, UA_Client_Subscription *sub,
+                           UA_NotificationMessage *msg) {
+    size_t notificationDataSize = msg->notificationDataSize;
+    if(notificationDataSize > 0 && msg->sequenceNumber <= sub->lastSequenceNumber) {
+        UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                     "Skipping the notification message %u on subscription %u, "
+                     "received before", msg->sequenceNumber, sub->SubscriptionID);
+        notificationDataSize = 0; /* only acknowledge */
+    }
+
+    for(size_t k = 0; k < notificationDataSize; k++) {
+        UA_ExtensionObject_decodeContent(&msg->notificationData[k]);
+        if(msg->notificationData[k].encoding != UA_EXTENSIONOBJECT_DECODED)
+            continue;
+
+        /* Currently only dataChangeNotifications are supported */
+        if(msg->notificationData[k].content.decoded.type != &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION])
+            continue;
+
+        UA_DataChangeNotification *dataChangeNotification = msg->notificationData[k].content.decoded.data;
+        for(size_t j = 0; j < dataChangeNotification->monitoredItemsSize; j++) {
+            UA_MonitoredItemNotification *mitemNot = &dataChangeNotification->monitoredItems[j];
+            UA_Client_MonitoredItem *mon;
+            LIST_FOREACH(mon, &sub->MonitoredItems, listEntry) {
+                if(mon->ClientHandle == mitemNot->clientHandle) {
+                    mon->handler(mon->MonitoredItemId, &mitemNot->value, mon->handlerContext);
+                    break;
+                }
+            }
+            if(!mon)
+                UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                             "Could not process a notification with clienthandle %u on subscription %u",
+                             mitemNot->clientHandle, sub->SubscriptionID);
+        }
+    }
+    if(notificationDataSize > 0)
+        sub->lastSequenceNumber = msg->sequenceNumber;
+
+    /* Add to the list of pending acks */
+    UA_Client_NotificationsAckNumber *tmpAck = UA_malloc(sizeof(UA_Client_NotificationsAckNumber));
+    if(!tmpAck)
         return;
+    tmpAck->subAck.sequenceNumber = msg->sequenceNumber;
+    tmpAck->subAck.subscriptionId = sub->SubscriptionID;
+    LIST_INSERT_HEAD(&client->pendingNotificationsAcks, tmpAck, listEntry);
+}
 
-    /* Find the subscription */
+static UA_Client_Subscription *
+findSubscription(UA_Client *client, UA_UInt32 subscriptionId) {
     UA_Client_Subscription *sub;
     LIST_FOREACH(sub, &client->subscriptions, listEntry) {
-        if(sub->SubscriptionID == response->subscriptionId)
+        if(sub->SubscriptionID == subscriptionId)
             break;
     }
+    return sub;
+}
+
+/* Without a request, the acknowledgements were already removed when the
+ * request was sent */
+static void
+UA_Client_processPublishResponse(UA_Client *client, UA_PublishRequest *request, UA_PublishResponse *response) {
+    if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+        return;
+
+    /* Find the subscription */
+    UA_Client_Subscription *sub = findSubscription(client, response->subscriptionId);
     if(!sub)
         return;
 
@@ -217,7 +277,8 @@ UA_Client_processPublishResponse(UA_Client *client, UA_PublishRequest *request,
                  sub->SubscriptionID, response->notificationMessage.notificationDataSize);
 
     /* Check if the server has acknowledged any of the sent ACKs */
-    for(size_t i = 0; i < response->resultsSize && i < request->subscriptionAcknowledgementsSize; i++) {
+    for(size_t i = 0; request && i < response->resultsSize &&
+            i < request->subscriptionAcknowledgementsSize; i++) {
         /* remove also acks that are unknown to the server */
         if(response->results[i] != UA_STATUSCODE_GOOD &&
            response->results[i] != UA_STATUSCODE_BADSEQUENCENUMBERUNKNOWN)
@@ -238,37 +299,31 @@ UA_Client_processPublishResponse(UA_Client *client, UA_PublishRequest *request,
     }
 
     /* Process the notification messages */
-    UA_NotificationMessage *msg = &response->notificationMessage;
-    for(size_t k = 0; k < msg->notificationDataSize; k++) {
-        if(msg->notificationData[k].encoding != UA_EXTENSIONOBJECT_DECODED)
-            continue;
+    processNotificationMessage(client, sub, &response->notificationMessage);
+}
 
-        /* Currently only dataChangeNotifications are supported */
-        if(msg->notificationData[k].content.decoded.type != &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION])
-            continue;
+/* Acknowledges all received notifications */
+static UA_StatusCode
+setAcknowledgements(UA_Client *client, UA_PublishRequest *request) {
+    request->subscriptionAcknowledgementsSize = 0;
+    UA_Client_NotificationsAckNumber *ack;
+    LIST_FOREACH(ack, &client->pendingNotificationsAcks, listEntry)
+        request->subscriptionAcknowledgementsSize++;
+    if(request->subscriptionAcknowledgementsSize == 0)
+        return UA_STATUSCODE_GOOD;
 
-        UA_DataChangeNotification *dataChangeNotification = msg->notificationData[k].content.decoded.data;
-        for(size_t j = 0; j < dataChangeNotification->monitoredItemsSize; j++) {
-            UA_MonitoredItemNotification *mitemNot = &dataChangeNotification->monitoredItems[j];
-            UA_Client_MonitoredItem *mon;
-            LIST_FOREACH(mon, &sub->MonitoredItems, listEntry) {
-                if(mon->ClientHandle == mitemNot->clientHandle) {
-                    mon->handler(mon->MonitoredItemId, &mitemNot->value, mon->handlerContext);
-                    break;
-                }
-            }
-            if(!mon)
-                UA_LOG_DEBUG(client->config.logger, UA_LOGCATEGORY_CLIENT,
-                             "Could not process a notification with clienthandle %u on subscription %u",
-                             mitemNot->clientHandle, sub->SubscriptionID);
-        }
+    request->subscriptionAcknowledgements =
+        UA_malloc(sizeof(UA_SubscriptionAcknowledgement) * request->subscriptionAcknowledgementsSize);
+    if(!request->subscriptionAcknowledgements) {
+        request->subscriptionAcknowledgementsSize = 0;
+        return UA_STATUSCODE_BADOUTOFMEMORY;
     }
-
-    /* Add to the list of pending acks */
-    UA_Client_NotificationsAckNumber *tmpAck = UA_malloc(sizeof(UA_Client_NotificationsAckNumber));
-    tmpAck->subAck.sequenceNumber = msg->sequenceNumber;
-    tmpAck->subAck.subscriptionId = sub->SubscriptionID;
-    LIST_INSERT_HEAD(&client->pendingNotificationsAcks, tmpAck, listEntry);
+    size_t i = 0;
+    LIST_FOREACH(ack, &client->pendingNotificationsAcks, listEntry) {
+        request->subscriptionAcknowledgements[i] = ack->subAck;
+        i++;
+    }
+    return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode UA_Client_Subscriptions_manuallySendPublishRequest(UA_Client *client) {
@@ -279,24 +334,8 @@ UA_StatusCode UA_Client_Subscriptions_manuallySendPublishRequest(UA_Client *clie
     while(moreNotifications) {
         UA_PublishRequest request;
         UA_PublishRequest_init(&request);
-        request.subscriptionAcknowledgementsSize = 0;
-
-        UA_Client_NotificationsAckNumber *ack;
-        LIST_FOREACH(ack, &client->pendingNotificationsAcks, listEntry)
-            request.subscriptionAcknowledgementsSize++;
-        if(request.subscriptionAcknowledgementsSize > 0) {
-            request.subscriptionAcknowledgements =
-                UA_malloc(sizeof(UA_SubscriptionAcknowledgement) * request.subscriptionAcknowledgementsSize);
-            if(!request.subscriptionAcknowledgements)
-                return UA_STATUSCODE_GOOD;
-        }
-        
-        int i = 0;
-        LIST_FOREACH(ack, &client->pendingNotificationsAcks, listEntry) {
-            request.subscriptionAcknowledgements[i].sequenceNumber = ack->subAck.sequenceNumber;
-            request.subscriptionAcknowledgements[i].subscriptionId = ack->subAck.subscriptionId;
-            i++;
-        }
+        if(setAcknowledgements(client, &request) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_GOOD;
         
         UA_PublishResponse response = UA_Client_Service_publish(client, request);
         UA_Client_processPublishResponse(client, &request, &response);
@@ -308,4 +347,190 @@ UA_StatusCode UA_Client_Subscriptions_manuallySendPublishRequest(UA_Client *clie
     return UA_STATUSCODE_GOOD;
 }
 
+/*************/
+/* Reconnect */
+/*************/
+
+static void removeSubscription(UA_Client *client, UA_Client_Subscription *sub) {
+    LIST_REMOVE(sub, listEntry);
+    UA_Client_MonitoredItem *mon, *tmpmon;
+    LIST_FOREACH_SAFE(mon, &sub->MonitoredItems, listEntry, tmpmon) {
+        LIST_REMOVE(mon, listEntry);
+        UA_NodeId_deleteMembers(&mon->monitoredNodeId);
+        UA_free(mon);
+    }
+    UA_free(sub);
+}
+
+/* Republishes the messages of the subscription that the client has not
+ * received. A message that is no longer available is skipped. */
+static void
+republishMessages(UA_Client *client, UA_Client_Subscription *sub,
+                  const UA_UInt32 *sequenceNumbers, size_t sequenceNumbersSize) {
+    for(size_t i = 0; i < sequenceNumbersSize; i++) {
+        if(sequenceNumbers[i] <= sub->lastSequenceNumber)
+            continue;
+        UA_RepublishRequest request;
+        UA_RepublishRequest_init(&request);
+        request.subscriptionId = sub->SubscriptionID;
+        request.retransmitSequenceNumber = sequenceNumbers[i];
+        UA_RepublishResponse response = UA_Client_Service_republish(client, request);
+        UA_StatusCode retval = response.responseHeader.serviceResult;
+        if(retval == UA_STATUSCODE_GOOD &&
+           response.notificationMessage.sequenceNumber != request.retransmitSequenceNumber)
+            retval = UA_STATUSCODE_BADMESSAGENOTAVAILABLE;
+        if(retval == UA_STATUSCODE_GOOD)
+            processNotificationMessage(client, sub, &response.notificationMessage);
+        else
+            UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                        "Message %u of subscription %u could not be republished "
+                        "with statuscode 0x%08x", request.retransmitSequenceNumber,
+                        sub->SubscriptionID, retval);
+        UA_RepublishResponse_deleteMembers(&response);
+    }
+}
+
+void UA_Client_Subscriptions_transfer(UA_Client *client, UA_Boolean sendInitialValues) {
+    UA_TransferSubscriptionsRequest request;
+    UA_TransferSubscriptionsRequest_init(&request);
+    UA_Client_Subscription *sub, *tmpsub;
+    LIST_FOREACH(sub, &client->subscriptions, listEntry)
+        request.subscriptionIdsSize++;
+    if(request.subscriptionIdsSize == 0)
+        return;
+    request.subscriptionIds = UA_Array_new(request.subscriptionIdsSize, &UA_TYPES[UA_TYPES_UINT32]);
+    if(!request.subscriptionIds)
+        return;
+    size_t i = 0;
+    LIST_FOREACH(sub, &client->subscriptions, listEntry)
+        request.subscriptionIds[i++] = sub->SubscriptionID;
+    request.sendInitialValues = sendInitialValues;
+
+    UA_TransferSubscriptionsResponse response =
+        UA_Client_Service_transferSubscriptions(client, request);
+    i = 0; /* the results are in the order of the list */
+    LIST_FOREACH_SAFE(sub, &client->subscriptions, listEntry, tmpsub) {
+        UA_StatusCode retval = response.responseHeader.serviceResult;
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = i < response.resultsSize ? response.results[i].statusCode :
+                UA_STATUSCODE_BADUNEXPECTEDERROR;
+        i++;
+        if(retval == UA_STATUSCODE_GOOD) {
+            /* Fetch the notifications that were sent while the client was away */
+            const UA_TransferResult *tr = &response.results[i-1];
+            republishMessages(client, sub, tr->availableSequenceNumbers,
+                              tr->availableSequenceNumbersSize);
+            continue;
+        }
+        UA_LOG_WARNING(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                       "Subscription %u could not be transferred to the session "
+                       "with statuscode 0x%08x and is removed", sub->SubscriptionID, retval);
+        removeSubscription(client, sub);
+    }
+    UA_TransferSubscriptionsRequest_deleteMembers(&request);
+    UA_TransferSubscriptionsResponse_deleteMembers(&response);
+}
+
+/*************************/
+/* Background Publishing */
+/*************************/
+
+/* The acknowledgements of an outstanding publish request. They are queued
+ * again unless the server has processed them. */
+typedef struct {
+    size_t acksSize;
+    UA_SubscriptionAcknowledgement *acks;
+} PublishAcks;
+
+static void
+requeueAcknowledgements(UA_Client *client, PublishAcks *pa, const UA_PublishResponse *response) {
+    for(size_t i = 0; i < pa->acksSize; i++) {
+        /* remove also acks that are unknown to the server */
+        if(response->responseHeader.serviceResult == UA_STATUSCODE_GOOD &&
+           i < response->resultsSize &&
+           (response->results[i] == UA_STATUSCODE_GOOD ||
+            response->results[i] == UA_STATUSCODE_BADSEQUENCENUMBERUNKNOWN))
+            continue;
+        UA_Client_NotificationsAckNumber *ack = UA_malloc(sizeof(UA_Client_NotificationsAckNumber));
+        if(!ack)
+            break;
+        ack->subAck = pa->acks[i];
+        LIST_INSERT_HEAD(&client->pendingNotificationsAcks, ack, listEntry);
+    }
+    UA_free(pa->acks);
+    UA_free(pa);
+}
+
+static void
+publishResponseCallback(UA_Client *client, void *userdata, UA_UInt32 requestId,
+                        const void *r) {
+    /* The response is deleted after the callback. Decoding the notifications
+     * in place is fine. */
+    UA_PublishResponse *response = (UA_PublishResponse*)(uintptr_t)r;
+    client->outstandingPublishRequests--;
+    requeueAcknowledgements(client, (PublishAcks*)userdata, response);
+    if(response->responseHeader.serviceResult == UA_STATUSCODE_BADTOOMANYPUBLISHREQUESTS) {
+        if(client->maxOutstandingPublishRequests > client->outstandingPublishRequests + 1)
+            client->maxOutstandingPublishRequests = client->outstandingPublishRequests + 1;
+        UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                    "Too many publish requests. Reduce to %u outstanding requests",
+                    client->maxOutstandingPublishRequests);
+        return;
+    }
+    UA_Client_processPublishResponse(client, NULL, response);
+}
+
+void UA_Client_Subscriptions_sendPublishRequests(UA_Client *client) {
+    while(client->outstandingPublishRequests < client->maxOutstandingPublishRequests &&
+          !LIST_EMPTY(&client->subscriptions)) {
+        PublishAcks *pa = UA_malloc(sizeof(PublishAcks));
+        if(!pa)
+            return;
+        UA_PublishRequest request;
+        UA_PublishRequest_init(&request);
+        if(setAcknowledgements(client, &request) != UA_STATUSCODE_GOOD) {
+            UA_free(pa);
+            return;
+        }
+        UA_StatusCode retval =
+            __UA_Client_AsyncService(client, &request, &UA_TYPES[UA_TYPES_PUBLISHREQUEST],
+                                     publishResponseCallback, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE],
+                                     pa, NULL);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_PublishRequest_deleteMembers(&request);
+            UA_free(pa);
+            UA_LOG_INFO(client->config.logger, UA_LOGCATEGORY_CLIENT,
+                        "Could not send a publish request with error code 0x%08x", retval);
+            return;
+        }
+        client->outstandingPublishRequests++;
+
+        /* The sent acknowledgements are kept with the request until the
+         * response arrives */
+        pa->acks = request.subscriptionAcknowledgements;
+        pa->acksSize = request.subscriptionAcknowledgementsSize;
+        request.subscriptionAcknowledgements = NULL;
+        request.subscriptionAcknowledgementsSize = 0;
+        UA_PublishRequest_deleteMembers(&request);
+        UA_Client_NotificationsAckNumber *ack, *tmpAck;
+        LIST_FOREACH_SAFE(ack, &client->pendingNotificationsAcks, listEntry, tmpAck) {
+            LIST_REMOVE(ack, listEntry);
+            UA_free(ack);
+        }
+    }
+}
+
+UA_StatusCode
+UA_Client_Subscriptions_startPublishing(UA_Client *client, UA_UInt16 outstandingPublishRequests) {
+    if(client->state != UA_CLIENTSTATE_CONNECTED)
+        return UA_STATUSCODE_BADSERVERNOTCONNECTED;
+    client->maxOutstandingPublishRequests = outstandingPublishRequests;
+    UA_Client_Subscriptions_sendPublishRequests(client);
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_Client_Subscriptions_stopPublishing(UA_Client *client) {
+    client->maxOutstandingPublishRequests = 0;
+}
+
 #endif /* UA_ENABLE_SUBSCRIPTIONS */
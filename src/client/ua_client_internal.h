@@ -2,6 +2,7 @@
 #define UA_CLIENT_INTERNAL_H_
 
 #include "ua_securechannel.h"
+#include "ua_arena.h"
 #include "queue.h"
 
 /**************************/
@@ -36,12 +37,85 @@ typedef struct UA_Client_Subscription_s {
     UA_UInt32 SubscriptionID;
     UA_UInt32 NotificationsPerPublish;
     UA_UInt32 Priority;
+    UA_UInt32 lastSequenceNumber; /* of the last notification message, 0 before */
     LIST_ENTRY(UA_Client_Subscription_s) listEntry;
     LIST_HEAD(UA_ListOfClientMonitoredItems, UA_Client_MonitoredItem_s) MonitoredItems;
 } UA_Client_Subscription;
 
+/* Sends PublishRequests until the configured number is outstanding */
+void UA_Client_Subscriptions_sendPublishRequests(UA_Client *client);
+
+/* Transfers the subscriptions to the current session. The subscriptions that
+ * cannot be transferred are removed. The messages that the server still holds
+ * for retransmission (availableSequenceNumbers) and that the client has not
+ * received are republished. A transfer to the same session only returns the
+ * available messages. */
+void UA_Client_Subscriptions_transfer(UA_Client *client, UA_Boolean sendInitialValues);
+
 #endif
 
+/**************************/
+/* Asynchronous Services */
+/**************************/
+
+typedef struct AsyncServiceCall {
+    LIST_ENTRY(AsyncServiceCall) pointers;
+    UA_UInt32 requestId;
+    UA_ClientAsyncServiceCallback callback;
+    const UA_DataType *responseType;
+    void *userdata;
+} AsyncServiceCall;
+
+/**********************/
+/* Batched Operations */
+/**********************/
+
+/* A read or write of the highlevel attribute functions that is queued until
+ * the batch is flushed */
+typedef struct {
+    UA_Boolean isWrite;
+    union {
+        UA_ReadValueId read;
+        UA_WriteValue write;
+    } item;
+    void *out; /* of reads */
+    const UA_DataType *outDataType;
+} UA_Client_BatchedOperation;
+
+/****************/
+/* Client Cache */
+/****************/
+
+/* Browse results are keyed by the BrowseDescription and attributes by the
+ * NodeId and attributeId (which is zero for browse results) */
+typedef struct UA_Client_CacheEntry {
+    struct UA_Client_CacheEntry *next; /* in the bucket */
+    UA_DateTime expires; /* monotonic */
+    UA_UInt32 attributeId;
+    union {
+        UA_BrowseDescription browse;
+        UA_NodeId nodeId;
+    } key;
+    union {
+        UA_BrowseResult browseResult;
+        UA_DataValue value;
+    } content;
+} UA_Client_CacheEntry;
+
+typedef struct {
+    UA_DateTime ttl; /* zero if the cache is disabled */
+    size_t entriesSize;
+    size_t bucketsSize; /* a power of two */
+    UA_Client_CacheEntry **buckets;
+} UA_Client_Cache;
+
+const UA_DataValue *
+UA_Client_Cache_getAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_UInt32 attributeId);
+
+void
+UA_Client_Cache_putAttribute(UA_Client *client, const UA_NodeId *nodeId, UA_UInt32 attributeId,
+                             const UA_DataValue *value);
+
 /**********/
 /* Client */
 /**********/
@@ -70,11 +144,31 @@ struct UA_Client {
     UA_UserTokenPolicy token;
     UA_NodeId authenticationToken;
     UA_UInt32 requestHandle;
+
+    /* Queued operations between UA_Client_beginBatch and UA_Client_flushBatch */
+    UA_Boolean batching;
+    UA_Client_BatchedOperation *batch;
+    size_t batchSize;
+    size_t batchCapacity;
+
+    /* The response decoded with UA_Client_sendPreparedRequestArena points into
+     * the arena and the received message. Both are kept until the next call. */
+    UA_Arena responseArena;
+    UA_ByteString responseMessage;
+    UA_Boolean responseMessageRealloced;
+
+    /* Browse results and attributes */
+    UA_Client_Cache cache;
+
+    /* Requests waiting for their response */
+    LIST_HEAD(ListOfAsyncServiceCall, AsyncServiceCall) asyncServiceCalls;
     
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     UA_UInt32 monitoredItemHandles;
     LIST_HEAD(UA_ListOfUnacknowledgedNotificationNumbers, UA_Client_NotificationsAckNumber_s) pendingNotificationsAcks;
     LIST_HEAD(UA_ListOfClientSubscriptionItems, UA_Client_Subscription_s) subscriptions;
+    UA_UInt16 outstandingPublishRequests;
+    UA_UInt16 maxOutstandingPublishRequests; /* zero if background publishing is off */
 #endif
     
     /* Config */
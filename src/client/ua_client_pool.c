@@ -0,0 +1,379 @@
+#include "ua_client_highlevel.h"
+#include "ua_client_internal.h"
+#include "ua_util.h"
+
+/* A partial request that is in flight on one client of the pool. The
+ * requestId tells whether a response belongs to the current bulk service. A
+ * response that arrives after the bulk service has timed out is ignored. */
+typedef struct {
+    UA_UInt32 requestId;
+    UA_Boolean pending;
+    UA_UInt32 client; /* the index of the client in the pool */
+    size_t first; /* the first operation of the partial request */
+    size_t count;
+    const size_t *indices; /* the positions of the results in the merged
+                              response. NULL if they follow from first. */
+    void *response; /* the merged response */
+    size_t resultsOffset;
+    const UA_DataType *resultType;
+} PartialRequest;
+
+struct UA_ClientPool {
+    size_t clientsSize;
+    UA_Client **clients;
+    PartialRequest *partials;
+};
+
+UA_ClientPool *
+UA_ClientPool_new(UA_ClientConfig config, size_t clientsSize) {
+    if(clientsSize == 0)
+        return NULL;
+    UA_ClientPool *pool = UA_calloc(1, sizeof(UA_ClientPool));
+    if(!pool)
+        return NULL;
+    pool->clients = UA_calloc(clientsSize, sizeof(UA_Client*));
+    pool->partials = UA_calloc(clientsSize, sizeof(PartialRequest));
+    if(!pool->clients || !pool->partials) {
+        UA_ClientPool_delete(pool);
+        return NULL;
+    }
+    for(size_t i = 0; i < clientsSize; i++) {
+        pool->clients[i] = UA_Client_new(config);
+        if(!pool->clients[i]) {
+            UA_ClientPool_delete(pool);
+            return NULL;
+        }
+        pool->clientsSize++;
+    }
+    return pool;
+}
+
+void UA_ClientPool_delete(UA_ClientPool *pool) {
+    /* Deleting the clients calls back the pending requests. So the partial
+     * requests are freed last. */
+    for(size_t i = 0; i < pool->clientsSize; i++)
+        UA_Client_delete(pool->clients[i]);
+    UA_free(pool->clients);
+    UA_free(pool->partials);
+    UA_free(pool);
+}
+
+UA_StatusCode
+UA_ClientPool_connect(UA_ClientPool *pool, const char *endpointUrl) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < pool->clientsSize; i++) {
+        UA_StatusCode res = UA_Client_connect(pool->clients[i], endpointUrl);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = res;
+    }
+    return retval;
+}
+
+void UA_ClientPool_disconnect(UA_ClientPool *pool) {
+    for(size_t i = 0; i < pool->clientsSize; i++)
+        UA_Client_disconnect(pool->clients[i]);
+}
+
+size_t UA_ClientPool_size(const UA_ClientPool *pool) {
+    return pool->clientsSize;
+}
+
+UA_Client *
+UA_ClientPool_getClient(UA_ClientPool *pool, size_t index) {
+    if(index >= pool->clientsSize)
+        return NULL;
+    return pool->clients[index];
+}
+
+/*****************/
+/* Bulk Services */
+/*****************/
+
+/* Arrays in the generated structures are stored as the size followed by the
+ * pointer */
+#define ARRAYSIZE(p, offset) (*(size_t*)((uintptr_t)(p) + (offset)))
+#define ARRAYPTR(p, offset) (*(void**)((uintptr_t)(p) + (offset) + sizeof(size_t)))
+
+/* A continuation point belongs to the session that browsed. The pool prefixes
+ * the continuation points it returns with the index of the client. */
+#define CLIENTTAGSIZE sizeof(UA_UInt32)
+
+static void
+tagContinuationPoint(UA_BrowseResult *result, UA_UInt32 client) {
+    UA_ByteString *cp = &result->continuationPoint;
+    if(cp->length == 0)
+        return;
+    UA_Byte *data = UA_malloc(cp->length + CLIENTTAGSIZE);
+    if(!data) {
+        /* The continuation point is dropped. It is released with the session
+         * on the server. */
+        UA_ByteString_deleteMembers(cp);
+        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    memcpy(data, &client, CLIENTTAGSIZE);
+    memcpy(&data[CLIENTTAGSIZE], cp->data, cp->length);
+    UA_free(cp->data);
+    cp->data = data;
+    cp->length += CLIENTTAGSIZE;
+}
+
+static void
+partialResponseCallback(UA_Client *client, void *userdata, UA_UInt32 requestId,
+                        const void *r) {
+    PartialRequest *partial = (PartialRequest*)userdata;
+    if(!partial->pending || partial->requestId != requestId)
+        return; /* the bulk service has timed out */
+    partial->pending = false;
+
+    UA_ResponseHeader *header = (UA_ResponseHeader*)partial->response;
+    UA_StatusCode serviceResult = ((const UA_ResponseHeader*)r)->serviceResult;
+    if(serviceResult == UA_STATUSCODE_GOOD &&
+       ARRAYSIZE(r, partial->resultsOffset) != partial->count)
+        serviceResult = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    if(serviceResult != UA_STATUSCODE_GOOD) {
+        if(header->serviceResult == UA_STATUSCODE_GOOD)
+            header->serviceResult = serviceResult;
+        return;
+    }
+
+    /* Move the results into the merged response. The response is deleted
+     * after the callback and must no longer point to them. */
+    uintptr_t results = (uintptr_t)ARRAYPTR(r, partial->resultsOffset);
+    uintptr_t merged = (uintptr_t)ARRAYPTR(partial->response, partial->resultsOffset);
+    size_t memSize = partial->resultType->memSize;
+    for(size_t i = 0; i < partial->count; i++) {
+        size_t index = partial->indices ? partial->indices[i] : partial->first + i;
+        void *result = (void*)(merged + index * memSize);
+        memcpy(result, (void*)(results + i * memSize), memSize);
+        if(partial->resultType == &UA_TYPES[UA_TYPES_BROWSERESULT])
+            tagContinuationPoint((UA_BrowseResult*)result, partial->client);
+    }
+    UA_free((void*)results);
+    ARRAYSIZE(r, partial->resultsOffset) = 0;
+    ARRAYPTR(r, partial->resultsOffset) = NULL;
+}
+
+/* Sends the partial request on the client. The partial request is a shallow
+ * copy of the request that points into its arrays. */
+static UA_StatusCode
+sendPartial(UA_ClientPool *pool, PartialRequest *partial, void *partialRequest,
+            const UA_DataType *requestType, const UA_DataType *responseType) {
+    UA_StatusCode retval =
+        __UA_Client_AsyncService(pool->clients[partial->client], partialRequest, requestType,
+                                 partialResponseCallback, responseType,
+                                 partial, &partial->requestId);
+    /* The authenticationToken was copied into the shallow copy */
+    UA_NodeId_deleteMembers(&((UA_RequestHeader*)partialRequest)->authenticationToken);
+    partial->pending = (retval == UA_STATUSCODE_GOOD);
+    return retval;
+}
+
+/* Receives on all clients until the responses have arrived */
+static void
+receivePartials(UA_ClientPool *pool, UA_ResponseHeader *header) {
+    UA_DateTime maxDate = UA_DateTime_nowMonotonic() +
+        (UA_DateTime)pool->clients[0]->config.timeout * UA_MSEC_TO_DATETIME;
+    UA_Boolean pending = true;
+    while(pending) {
+        pending = false;
+        for(size_t i = 0; i < pool->clientsSize; i++) {
+            if(!pool->partials[i].pending)
+                continue;
+            UA_StatusCode retval = UA_Client_run_iterate(pool->clients[i], 1);
+            if(retval != UA_STATUSCODE_GOOD) {
+                pool->partials[i].pending = false;
+                if(header->serviceResult == UA_STATUSCODE_GOOD)
+                    header->serviceResult = retval;
+                continue;
+            }
+            pending |= pool->partials[i].pending;
+        }
+        if(pending && UA_DateTime_nowMonotonic() > maxDate) {
+            for(size_t i = 0; i < pool->clientsSize; i++)
+                pool->partials[i].pending = false;
+            header->serviceResult = UA_STATUSCODE_BADTIMEOUT;
+            break;
+        }
+    }
+}
+
+static void
+bulkService(UA_ClientPool *pool, const void *request, const UA_DataType *requestType,
+            size_t itemsOffset, const UA_DataType *itemType,
+            void *response, const UA_DataType *responseType,
+            size_t resultsOffset, const UA_DataType *resultType) {
+    UA_init(response, responseType);
+    UA_ResponseHeader *header = (UA_ResponseHeader*)response;
+    size_t itemsSize = ARRAYSIZE(request, itemsOffset);
+    if(itemsSize == 0) {
+        __UA_Client_Service(pool->clients[0], request, requestType, response, responseType);
+        return;
+    }
+
+    void *results = UA_Array_new(itemsSize, resultType);
+    if(!results) {
+        header->serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    ARRAYSIZE(response, resultsOffset) = itemsSize;
+    ARRAYPTR(response, resultsOffset) = results;
+
+    /* Send a partial request on every client */
+    size_t perClient = (itemsSize + pool->clientsSize - 1) / pool->clientsSize;
+    void *partialRequest = UA_alloca(requestType->memSize);
+    uintptr_t items = (uintptr_t)ARRAYPTR(request, itemsOffset);
+    size_t first = 0;
+    for(size_t i = 0; i < pool->clientsSize && first < itemsSize; i++) {
+        PartialRequest *partial = &pool->partials[i];
+        partial->client = (UA_UInt32)i;
+        partial->first = first;
+        partial->count = perClient;
+        if(partial->count > itemsSize - first)
+            partial->count = itemsSize - first;
+        partial->indices = NULL;
+        partial->response = response;
+        partial->resultsOffset = resultsOffset;
+        partial->resultType = resultType;
+        memcpy(partialRequest, request, requestType->memSize);
+        ARRAYSIZE(partialRequest, itemsOffset) = partial->count;
+        ARRAYPTR(partialRequest, itemsOffset) = (void*)(items + first * itemType->memSize);
+        UA_StatusCode retval = sendPartial(pool, partial, partialRequest, requestType, responseType);
+        if(retval != UA_STATUSCODE_GOOD) {
+            header->serviceResult = retval;
+            break;
+        }
+        first += partial->count;
+    }
+
+    receivePartials(pool, header);
+}
+
+UA_ReadResponse
+UA_ClientPool_read(UA_ClientPool *pool, const UA_ReadRequest *request) {
+    UA_ReadResponse response;
+    bulkService(pool, request, &UA_TYPES[UA_TYPES_READREQUEST],
+                offsetof(UA_ReadRequest, nodesToReadSize), &UA_TYPES[UA_TYPES_READVALUEID],
+                &response, &UA_TYPES[UA_TYPES_READRESPONSE],
+                offsetof(UA_ReadResponse, resultsSize), &UA_TYPES[UA_TYPES_DATAVALUE]);
+    return response;
+}
+
+UA_WriteResponse
+UA_ClientPool_write(UA_ClientPool *pool, const UA_WriteRequest *request) {
+    UA_WriteResponse response;
+    bulkService(pool, request, &UA_TYPES[UA_TYPES_WRITEREQUEST],
+                offsetof(UA_WriteRequest, nodesToWriteSize), &UA_TYPES[UA_TYPES_WRITEVALUE],
+                &response, &UA_TYPES[UA_TYPES_WRITERESPONSE],
+                offsetof(UA_WriteResponse, resultsSize), &UA_TYPES[UA_TYPES_STATUSCODE]);
+    return response;
+}
+
+UA_BrowseResponse
+UA_ClientPool_browse(UA_ClientPool *pool, const UA_BrowseRequest *request) {
+    UA_BrowseResponse response;
+    bulkService(pool, request, &UA_TYPES[UA_TYPES_BROWSEREQUEST],
+                offsetof(UA_BrowseRequest, nodesToBrowseSize), &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION],
+                &response, &UA_TYPES[UA_TYPES_BROWSERESPONSE],
+                offsetof(UA_BrowseResponse, resultsSize), &UA_TYPES[UA_TYPES_BROWSERESULT]);
+    return response;
+}
+
+/* The continuation points are grouped by the client in the prefix. Every
+ * client gets one partial request with its continuation points. */
+UA_BrowseNextResponse
+UA_ClientPool_browseNext(UA_ClientPool *pool, const UA_BrowseNextRequest *request) {
+    UA_BrowseNextResponse response;
+    UA_BrowseNextResponse_init(&response);
+    size_t cpsSize = request->continuationPointsSize;
+    if(cpsSize == 0) {
+        __UA_Client_Service(pool->clients[0], request, &UA_TYPES[UA_TYPES_BROWSENEXTREQUEST],
+                            &response, &UA_TYPES[UA_TYPES_BROWSENEXTRESPONSE]);
+        return response;
+    }
+
+    /* The continuation points without the prefix, sorted by the client */
+    response.results = UA_Array_new(cpsSize, &UA_TYPES[UA_TYPES_BROWSERESULT]);
+    if(response.results)
+        response.resultsSize = cpsSize;
+    UA_ByteString *cps = UA_malloc(cpsSize * sizeof(UA_ByteString));
+    size_t *indices = UA_malloc(cpsSize * sizeof(size_t));
+    size_t *counts = UA_calloc(pool->clientsSize, sizeof(size_t));
+    if(!response.results || !cps || !indices || !counts) {
+        response.responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        goto cleanup;
+    }
+    for(size_t i = 0; i < cpsSize; i++) {
+        const UA_ByteString *cp = &request->continuationPoints[i];
+        UA_UInt32 client = 0;
+        if(cp->length > CLIENTTAGSIZE)
+            memcpy(&client, cp->data, CLIENTTAGSIZE);
+        if(cp->length <= CLIENTTAGSIZE || client >= pool->clientsSize) {
+            response.results[i].statusCode = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+            continue;
+        }
+        counts[client]++;
+    }
+    size_t first = 0;
+    for(size_t i = 0; i < pool->clientsSize; i++) {
+        PartialRequest *partial = &pool->partials[i];
+        partial->client = (UA_UInt32)i;
+        partial->first = first;
+        partial->count = 0;
+        partial->indices = &indices[first];
+        partial->response = &response;
+        partial->resultsOffset = offsetof(UA_BrowseNextResponse, resultsSize);
+        partial->resultType = &UA_TYPES[UA_TYPES_BROWSERESULT];
+        first += counts[i];
+    }
+    for(size_t i = 0; i < cpsSize; i++) {
+        if(response.results[i].statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        const UA_ByteString *cp = &request->continuationPoints[i];
+        UA_UInt32 client;
+        memcpy(&client, cp->data, CLIENTTAGSIZE);
+        PartialRequest *partial = &pool->partials[client];
+        size_t pos = partial->first + partial->count;
+        cps[pos].data = &cp->data[CLIENTTAGSIZE]; /* shallow copy */
+        cps[pos].length = cp->length - CLIENTTAGSIZE;
+        indices[pos] = i;
+        partial->count++;
+    }
+
+    /* Send the partial requests */
+    UA_BrowseNextRequest partialRequest;
+    for(size_t i = 0; i < pool->clientsSize; i++) {
+        PartialRequest *partial = &pool->partials[i];
+        if(partial->count == 0)
+            continue;
+        partialRequest = *request;
+        partialRequest.continuationPoints = &cps[partial->first];
+        partialRequest.continuationPointsSize = partial->count;
+        UA_StatusCode retval = sendPartial(pool, partial, &partialRequest,
+                                           &UA_TYPES[UA_TYPES_BROWSENEXTREQUEST],
+                                           &UA_TYPES[UA_TYPES_BROWSENEXTRESPONSE]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            response.responseHeader.serviceResult = retval;
+            break;
+        }
+    }
+    receivePartials(pool, &response.responseHeader);
+
+ cleanup:
+    UA_free(cps);
+    UA_free(indices);
+    UA_free(counts);
+    return response;
+}
+
+#ifdef UA_TYPES_CALLREQUEST
+UA_CallResponse
+UA_ClientPool_call(UA_ClientPool *pool, const UA_CallRequest *request) {
+    UA_CallResponse response;
+    bulkService(pool, request, &UA_TYPES[UA_TYPES_CALLREQUEST],
+                offsetof(UA_CallRequest, methodsToCallSize), &UA_TYPES[UA_TYPES_CALLMETHODREQUEST],
+                &response, &UA_TYPES[UA_TYPES_CALLRESPONSE],
+                offsetof(UA_CallResponse, resultsSize), &UA_TYPES[UA_TYPES_CALLMETHODRESULT]);
+    return response;
+}
+#endif
@@ -1,7 +1,741 @@
 #include "ua_nodes.h"
 #include "ua_util.h"
+#ifdef UA_ENABLE_MULTITHREADING
+# include <pthread.h>
+#endif
+
+/********************/
+/* Interned Strings */
+/********************/
+
+#define UA_STRINGTABLE_MINSIZE 256
+
+/* The string data is stored directly after the entry */
+typedef struct InternedString {
+    struct InternedString *next;
+    size_t length;
+    size_t refCount;
+    UA_UInt32 hash;
+} InternedString;
+
+#define INTERNED_DATA(entry) ((UA_Byte*)(entry) + sizeof(InternedString))
+#define INTERNED_ENTRY(data) ((InternedString*)(uintptr_t)((data) - sizeof(InternedString)))
+
+static struct {
+    InternedString **buckets;
+    size_t size; /* a power of two */
+    size_t count;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock;
+#endif
+} stringTable = {
+    NULL, 0, 0,
+#ifdef UA_ENABLE_MULTITHREADING
+    PTHREAD_MUTEX_INITIALIZER
+#endif
+};
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define STRINGTABLE_LOCK() pthread_mutex_lock(&stringTable.lock)
+# define STRINGTABLE_UNLOCK() pthread_mutex_unlock(&stringTable.lock)
+#else
+# define STRINGTABLE_LOCK()
+# define STRINGTABLE_UNLOCK()
+#endif
+
+/* FNV-1a */
+static UA_UInt32 stringHash(const UA_String *s) {
+    UA_UInt32 h = 2166136261u;
+    for(size_t i = 0; i < s->length; i++) {
+        h ^= s->data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Doubles the number of buckets. If this fails, the chains just grow longer. */
+static void growStringTable(void) {
+    size_t newSize = stringTable.size * 2;
+    if(newSize < UA_STRINGTABLE_MINSIZE)
+        newSize = UA_STRINGTABLE_MINSIZE;
+    InternedString **buckets = UA_calloc(newSize, sizeof(InternedString*));
+    if(!buckets)
+        return;
+    for(size_t i = 0; i < stringTable.size; i++) {
+        InternedString *entry = stringTable.buckets[i];
+        while(entry) {
+            InternedString *next = entry->next;
+            InternedString **bucket = &buckets[entry->hash & (newSize - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    UA_free(stringTable.buckets);
+    stringTable.buckets = buckets;
+    stringTable.size = newSize;
+}
+
+/* Call with the lock held. Returns a new reference to the interned copy. */
+static UA_StatusCode internString(const UA_String *s, UA_String *interned) {
+    if(stringTable.count >= stringTable.size)
+        growStringTable();
+    if(stringTable.size == 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_UInt32 h = stringHash(s);
+    InternedString **bucket = &stringTable.buckets[h & (stringTable.size - 1)];
+    InternedString *entry = *bucket;
+    for(; entry; entry = entry->next) {
+        if(entry->hash == h && entry->length == s->length &&
+           memcmp(INTERNED_DATA(entry), s->data, s->length) == 0)
+            break;
+    }
+    if(!entry) {
+        entry = UA_malloc(sizeof(InternedString) + s->length);
+        if(!entry)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        entry->length = s->length;
+        entry->refCount = 0;
+        entry->hash = h;
+        memcpy(INTERNED_DATA(entry), s->data, s->length);
+        entry->next = *bucket;
+        *bucket = entry;
+        stringTable.count++;
+    }
+    entry->refCount++;
+    interned->length = entry->length;
+    interned->data = INTERNED_DATA(entry);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Call with the lock held */
+static void releaseString(UA_String *s) {
+    InternedString *entry = INTERNED_ENTRY(s->data);
+    UA_String_init(s);
+    if(--entry->refCount > 0)
+        return;
+    InternedString **prev = &stringTable.buckets[entry->hash & (stringTable.size - 1)];
+    while(*prev != entry)
+        prev = &(*prev)->next;
+    *prev = entry->next;
+    UA_free(entry);
+    stringTable.count--;
+    if(stringTable.count == 0) {
+        UA_free(stringTable.buckets);
+        stringTable.buckets = NULL;
+        stringTable.size = 0;
+    }
+}
+
+/* Replaces the strings with interned copies. Either all strings are interned
+ * or none. */
+static UA_StatusCode internStrings(UA_String **strings, size_t count) {
+    UA_String stackInterned[8];
+    UA_String *interned = stackInterned;
+    if(count > 8) {
+        interned = UA_malloc(count * sizeof(UA_String));
+        if(!interned)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    STRINGTABLE_LOCK();
+    size_t i = 0;
+    for(; i < count; i++) {
+        retval = internString(strings[i], &interned[i]);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        for(size_t j = 0; j < i; j++)
+            releaseString(&interned[j]);
+    }
+    STRINGTABLE_UNLOCK();
+    if(retval == UA_STATUSCODE_GOOD) {
+        for(i = 0; i < count; i++) {
+            UA_String_deleteMembers(strings[i]);
+            *strings[i] = interned[i];
+        }
+    }
+    if(interned != stackInterned)
+        UA_free(interned);
+    return retval;
+}
+
+static void releaseStrings(UA_String **strings, size_t count) {
+    STRINGTABLE_LOCK();
+    for(size_t i = 0; i < count; i++)
+        releaseString(strings[i]);
+    STRINGTABLE_UNLOCK();
+}
+
+/* Empty strings are not interned */
+static size_t addString(UA_String *s, UA_String **strings, size_t count) {
+    if(s->length > 0)
+        strings[count++] = s;
+    return count;
+}
+
+static size_t nodeIdStrings(UA_NodeId *id, UA_String **strings, size_t count) {
+    if(id->identifierType == UA_NODEIDTYPE_STRING ||
+       id->identifierType == UA_NODEIDTYPE_BYTESTRING)
+        count = addString(&id->identifier.string, strings, count);
+    return count;
+}
+
+/* Collects the strings of a member. These are at most three. */
+#define UA_MEMBER_MAXSTRINGS 3
+
+static size_t memberStrings(void *member, const UA_DataType *type, UA_String **strings) {
+    size_t count = 0;
+    if(type == &UA_TYPES[UA_TYPES_QUALIFIEDNAME]) {
+        count = addString(&((UA_QualifiedName*)member)->name, strings, count);
+    } else if(type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]) {
+        UA_LocalizedText *lt = member;
+        count = addString(&lt->locale, strings, count);
+        count = addString(&lt->text, strings, count);
+    } else if(type == &UA_TYPES[UA_TYPES_REFERENCENODE]) {
+        UA_ReferenceNode *rn = member;
+        count = nodeIdStrings(&rn->referenceTypeId, strings, count);
+        count = nodeIdStrings(&rn->targetId.nodeId, strings, count);
+        count = addString(&rn->targetId.namespaceUri, strings, count);
+    }
+    return count;
+}
+
+/* Without the references */
+#define UA_NODE_MAXSTRINGS 8
+
+static size_t nodeStrings(UA_Node *node, UA_String **strings) {
+    size_t count = nodeIdStrings(&node->nodeId, strings, 0);
+    count += memberStrings(&node->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME], &strings[count]);
+    count += memberStrings(&node->displayName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], &strings[count]);
+    count += memberStrings(&node->description, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], &strings[count]);
+    if(node->nodeClass == UA_NODECLASS_REFERENCETYPE)
+        count += memberStrings(&((UA_ReferenceTypeNode*)node)->inverseName,
+                               &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], &strings[count]);
+    return count;
+}
+
+void UA_Node_internStrings(UA_Node *node) {
+    if(node->internedStrings)
+        return;
+    size_t max = UA_NODE_MAXSTRINGS + (node->referencesSize * UA_MEMBER_MAXSTRINGS);
+    UA_String **strings = UA_malloc(max * sizeof(UA_String*));
+    if(!strings)
+        return;
+    size_t count = nodeStrings(node, strings);
+    for(size_t i = 0; i < node->referencesSize; i++)
+        count += memberStrings(&node->references[i], &UA_TYPES[UA_TYPES_REFERENCENODE],
+                               &strings[count]);
+    if(internStrings(strings, count) == UA_STATUSCODE_GOOD)
+        node->internedStrings = true;
+    UA_free(strings);
+}
+
+UA_StatusCode
+UA_Node_internMember(const UA_Node *node, void *member, const UA_DataType *type) {
+    if(!node->internedStrings)
+        return UA_STATUSCODE_GOOD;
+    UA_String *strings[UA_MEMBER_MAXSTRINGS];
+    size_t count = memberStrings(member, type, strings);
+    return internStrings(strings, count);
+}
+
+void UA_Node_deleteMember(const UA_Node *node, void *member, const UA_DataType *type) {
+    if(node->internedStrings) {
+        UA_String *strings[UA_MEMBER_MAXSTRINGS];
+        size_t count = memberStrings(member, type, strings);
+        releaseStrings(strings, count);
+    }
+    UA_deleteMembers(member, type);
+}
+
+static void releaseNodeStrings(UA_Node *node) {
+    UA_String *strings[UA_NODE_MAXSTRINGS];
+    size_t count = nodeStrings(node, strings);
+    releaseStrings(strings, count);
+    for(size_t i = 0; i < node->referencesSize; i++)
+        UA_Node_deleteMember(node, &node->references[i], &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    node->internedStrings = false;
+}
+
+/**************/
+/* References */
+/**************/
+
+static UA_Int32 orderInts(UA_UInt32 a, UA_UInt32 b) {
+    if(a == b)
+        return 0;
+    return a < b ? -1 : 1;
+}
+
+static UA_Int32 orderStrings(const UA_String *a, const UA_String *b) {
+    if(a->length != b->length)
+        return a->length < b->length ? -1 : 1;
+    if(a->length == 0 || a->data == b->data)
+        return 0;
+    return memcmp(a->data, b->data, a->length);
+}
+
+UA_Int32 UA_NodeId_order(const UA_NodeId *a, const UA_NodeId *b) {
+    if(a->namespaceIndex != b->namespaceIndex)
+        return orderInts(a->namespaceIndex, b->namespaceIndex);
+    if(a->identifierType != b->identifierType)
+        return orderInts(a->identifierType, b->identifierType);
+    switch(a->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        return orderInts(a->identifier.numeric, b->identifier.numeric);
+    case UA_NODEIDTYPE_GUID: {
+        const UA_Guid *ga = &a->identifier.guid;
+        const UA_Guid *gb = &b->identifier.guid;
+        if(ga->data1 != gb->data1)
+            return orderInts(ga->data1, gb->data1);
+        if(ga->data2 != gb->data2)
+            return orderInts(ga->data2, gb->data2);
+        if(ga->data3 != gb->data3)
+            return orderInts(ga->data3, gb->data3);
+        return memcmp(ga->data4, gb->data4, sizeof(ga->data4));
+    }
+    default: /* string and bytestring */
+        return orderStrings(&a->identifier.string, &b->identifier.string);
+    }
+}
+
+/* Compares the reference with the key. Without a target, all references of
+ * the type and direction are equal to the key. */
+static UA_Int32
+orderKey(const UA_ReferenceNode *ref, const UA_NodeId *referenceTypeId,
+         UA_Boolean isInverse, const UA_NodeId *targetId) {
+    UA_Int32 order = UA_NodeId_order(&ref->referenceTypeId, referenceTypeId);
+    if(order != 0)
+        return order;
+    if(ref->isInverse != isInverse)
+        return ref->isInverse ? 1 : -1;
+    if(!targetId)
+        return 0;
+    return UA_NodeId_order(&ref->targetId.nodeId, targetId);
+}
+
+UA_Int32 UA_ReferenceNode_order(const UA_ReferenceNode *a, const UA_ReferenceNode *b) {
+    return orderKey(a, &b->referenceTypeId, b->isInverse, &b->targetId.nodeId);
+}
+
+/* Every change of the references gets a new version from a process-wide
+   counter. So a version is never reused, not even by a new node with the
+   NodeId of a deleted node. */
+static size_t lastReferencesVersion = 0;
+
+static void newReferencesVersion(UA_Node *node) {
+#ifdef UA_ENABLE_MULTITHREADING
+    node->referencesVersion = uatomic_add_return(&lastReferencesVersion, 1);
+#else
+    node->referencesVersion = ++lastReferencesVersion;
+#endif
+}
+
+/* The references of nodes in the nodestore are changed in place only without
+ * multithreading. With multithreading, only unpublished copies are edited and
+ * copies have no index or method arguments. */
+static void dropReferenceCaches(UA_Node *node) {
+    newReferencesVersion(node);
+    UA_free(node->browseNameIndex);
+    node->browseNameIndex = NULL;
+    if(node->nodeClass == UA_NODECLASS_METHOD) {
+        UA_MethodNode *mn = (UA_MethodNode*)node;
+        UA_MethodArguments_delete(mn->arguments);
+        mn->arguments = NULL;
+    }
+}
+
+static int compareReferences(const void *a, const void *b) {
+    return UA_ReferenceNode_order((const UA_ReferenceNode*)a, (const UA_ReferenceNode*)b);
+}
+
+void UA_Node_sortReferences(UA_Node *node) {
+    /* The references were set directly, e.g. decoded from a snapshot */
+    if(node->referencesVersion == 0)
+        newReferencesVersion(node);
+    for(size_t i = 1; i < node->referencesSize; i++) {
+        if(UA_ReferenceNode_order(&node->references[i-1], &node->references[i]) <= 0)
+            continue;
+        qsort(node->references, node->referencesSize, sizeof(UA_ReferenceNode), compareReferences);
+        return;
+    }
+}
+
+/* Returns the first reference that is ordered after the key (upper) or not
+ * before the key (lower) */
+static size_t
+findBound(const UA_Node *node, const UA_NodeId *referenceTypeId, UA_Boolean isInverse,
+          const UA_NodeId *targetId, UA_Boolean upper) {
+    size_t low = 0;
+    size_t high = node->referencesSize;
+    while(low < high) {
+        size_t mid = low + ((high - low) / 2);
+        UA_Int32 order = orderKey(&node->references[mid], referenceTypeId, isInverse, targetId);
+        if(order < 0 || (upper && order == 0))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+void UA_Node_findReferences(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                            UA_BrowseDirection direction, size_t *begin, size_t *end) {
+    UA_Boolean inverse = (direction == UA_BROWSEDIRECTION_INVERSE);
+    *begin = findBound(node, referenceTypeId, inverse, NULL, false);
+    if(direction == UA_BROWSEDIRECTION_BOTH)
+        inverse = true;
+    *end = findBound(node, referenceTypeId, inverse, NULL, true);
+}
+
+size_t UA_Node_findReference(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                             UA_Boolean isInverse, const UA_NodeId *targetId) {
+    size_t i = findBound(node, referenceTypeId, isInverse, targetId, false);
+    if(i < node->referencesSize &&
+       orderKey(&node->references[i], referenceTypeId, isInverse, targetId) == 0)
+        return i;
+    return node->referencesSize;
+}
+
+UA_UInt32 UA_QualifiedName_hash(const UA_QualifiedName *qn) {
+    UA_UInt32 h = stringHash(&qn->name) ^ qn->namespaceIndex;
+    if(h == UA_BROWSENAMEINDEX_UNRESOLVED)
+        h++;
+    return h;
+}
+
+size_t UA_BrowseNameIndex_find(const UA_BrowseNameIndex *index, UA_UInt32 hash) {
+    size_t low = 0;
+    size_t high = index->entriesSize;
+    while(low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if(index->entries[mid].hash < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+UA_StatusCode UA_Node_addReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                                   UA_Boolean isInverse, const UA_ExpandedNodeId *targetId) {
+    size_t size = node->referencesSize;
+    size_t refssize = (size+1) | 3; // so the realloc is not necessary every time
+    UA_ReferenceNode *refs = UA_realloc(node->references, sizeof(UA_ReferenceNode) * refssize);
+    if(!refs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->references = refs;
+
+    UA_ReferenceNode ref;
+    UA_ReferenceNode_init(&ref);
+    UA_StatusCode retval = UA_NodeId_copy(referenceTypeId, &ref.referenceTypeId);
+    retval |= UA_ExpandedNodeId_copy(targetId, &ref.targetId);
+    ref.isInverse = isInverse;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_Node_internMember(node, &ref, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_ReferenceNode_deleteMembers(&ref);
+        return retval;
+    }
+
+    /* New children are mostly added with increasing nodeids. Then only the
+       references of the following types and directions are moved. */
+    size_t pos = findBound(node, referenceTypeId, isInverse, &targetId->nodeId, true);
+    memmove(&refs[pos+1], &refs[pos], sizeof(UA_ReferenceNode) * (size - pos));
+    refs[pos] = ref;
+    node->referencesSize = size+1;
+    dropReferenceCaches(node);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_Node_addReferences(UA_Node *node, const UA_ReferenceNode *refs, size_t refsSize) {
+    size_t size = node->referencesSize;
+    UA_ReferenceNode *newrefs = UA_realloc(node->references, sizeof(UA_ReferenceNode) * (size + refsSize));
+    if(!newrefs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->references = newrefs;
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    size_t i = 0;
+    for(; i < refsSize; i++) {
+        UA_ReferenceNode *ref = &newrefs[size + i];
+        retval = UA_ReferenceNode_copy(&refs[i], ref);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = UA_Node_internMember(node, ref, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_ReferenceNode_deleteMembers(ref);
+            break;
+        }
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        for(size_t j = 0; j < i; j++)
+            UA_Node_deleteMember(node, &newrefs[size + j], &UA_TYPES[UA_TYPES_REFERENCENODE]);
+        return retval;
+    }
+
+    /* A single sort of the whole array instead of moving the tail for every
+       reference */
+    node->referencesSize = size + refsSize;
+    UA_Node_sortReferences(node);
+    dropReferenceCaches(node);
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_Node_removeReference(UA_Node *node, size_t index) {
+    dropReferenceCaches(node);
+    UA_Node_deleteMember(node, &node->references[index], &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    node->referencesSize--;
+    memmove(&node->references[index], &node->references[index+1],
+            sizeof(UA_ReferenceNode) * (node->referencesSize - index));
+    if(node->referencesSize == 0) {
+        UA_free(node->references);
+        node->references = NULL;
+    }
+}
+
+/****************/
+/* Value Chunks */
+/****************/
+
+/* The elements of a chunk follow after the header. The header size keeps the
+   alignment of the elements. */
+typedef struct {
+    size_t refCount;
+} ValueChunk;
+
+#define UA_VALUECHUNK_ALIGN (2 * sizeof(void*))
+#define UA_VALUECHUNK_HEADER \
+    ((sizeof(ValueChunk) + UA_VALUECHUNK_ALIGN - 1) & ~(UA_VALUECHUNK_ALIGN - 1))
+
+enum {
+    CHUNKS_UNASSEMBLED,
+    CHUNKS_ASSEMBLING,
+    CHUNKS_ASSEMBLED
+};
+
+struct UA_ValueChunks {
+    UA_Variant base; /* shared data of the value before the first range write */
+    UA_Variant assembled; /* shared data for the readers */
+    UA_UInt32 state; /* of the assembled data */
+    size_t chunkLength; /* elements per chunk */
+    size_t chunksSize;
+    ValueChunk *chunks[]; /* NULL if the chunk points into the base */
+};
+
+static void releaseChunk(ValueChunk *chunk) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_sub_return(&chunk->refCount, 1) > 0)
+        return;
+#else
+    if(--chunk->refCount > 0)
+        return;
+#endif
+    UA_free(chunk);
+}
+
+static UA_Byte * chunkData(const UA_ValueChunks *c, size_t index) {
+    if(c->chunks[index])
+        return (UA_Byte*)c->chunks[index] + UA_VALUECHUNK_HEADER;
+    return (UA_Byte*)c->base.data + (index * c->chunkLength * c->base.type->memSize);
+}
+
+/* The last chunk can be shorter */
+static size_t chunkLength(const UA_ValueChunks *c, size_t index) {
+    size_t first = index * c->chunkLength;
+    size_t length = c->base.arrayLength - first;
+    return length < c->chunkLength ? length : c->chunkLength;
+}
+
+/* The chunks of older values have more than one reference */
+static UA_StatusCode makeChunkWritable(UA_ValueChunks *c, size_t index) {
+    ValueChunk *chunk = c->chunks[index];
+#ifdef UA_ENABLE_MULTITHREADING
+    if(chunk && uatomic_read(&chunk->refCount) == 1)
+        return UA_STATUSCODE_GOOD;
+#else
+    if(chunk && chunk->refCount == 1)
+        return UA_STATUSCODE_GOOD;
+#endif
+    size_t size = chunkLength(c, index) * c->base.type->memSize;
+    ValueChunk *copy = UA_malloc(UA_VALUECHUNK_HEADER + size);
+    if(!copy)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    copy->refCount = 1;
+    memcpy((UA_Byte*)copy + UA_VALUECHUNK_HEADER, chunkData(c, index), size);
+    if(chunk)
+        releaseChunk(chunk);
+    c->chunks[index] = copy;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean UA_ValueChunks_applicable(const UA_Variant *value) {
+    if(!value->type || !value->type->fixedSize || UA_Variant_isScalar(value))
+        return false;
+    return value->arrayLength * value->type->memSize > UA_VALUECHUNK_SIZE;
+}
+
+typedef struct {
+    UA_ValueChunks *chunks;
+    const UA_Byte *elements;
+    size_t remaining; /* elements not yet written */
+} ChunkWrite;
+
+static UA_StatusCode writeRangeBlock(ChunkWrite *cw, size_t offset, size_t length) {
+    if(length > cw->remaining)
+        return UA_STATUSCODE_BADINDEXRANGEINVALID;
+    cw->remaining -= length;
+    UA_ValueChunks *c = cw->chunks;
+    size_t elemSize = c->base.type->memSize;
+    while(length > 0) {
+        size_t index = offset / c->chunkLength;
+        size_t pos = offset % c->chunkLength;
+        size_t n = chunkLength(c, index) - pos;
+        if(n > length)
+            n = length;
+        UA_StatusCode retval = makeChunkWritable(c, index);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        memcpy(chunkData(c, index) + (pos * elemSize), cw->elements, n * elemSize);
+        cw->elements += n * elemSize;
+        offset += n;
+        length -= n;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_ValueChunks_writeRange(const UA_VariableNode *node, const UA_Variant *elements,
+                          const UA_NumericRange range, UA_Variant *value,
+                          UA_ValueChunks **chunks) {
+    const UA_Variant *current = &node->value.variant.value;
+    const UA_ValueChunks *old = node->valueChunks;
+    UA_assert(UA_ValueChunks_applicable(current));
+    size_t chunkLength = UA_VALUECHUNK_SIZE / current->type->memSize;
+    if(chunkLength == 0)
+        chunkLength = 1;
+    size_t chunksSize = (current->arrayLength + chunkLength - 1) / chunkLength;
+    UA_ValueChunks *c = UA_calloc(1, sizeof(UA_ValueChunks) + (chunksSize * sizeof(ValueChunk*)));
+    if(!c)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    c->chunkLength = chunkLength;
+    c->chunksSize = chunksSize;
+
+    /* Take references to the base and the chunks of the current value. The
+       first range write takes a reference to the shared data of the value. */
+    UA_StatusCode retval;
+    if(old) {
+        retval = UA_Variant_copy(&old->base, &c->base);
+        for(size_t i = 0; i < chunksSize; i++) {
+            c->chunks[i] = old->chunks[i];
+            if(c->chunks[i]) {
+#ifdef UA_ENABLE_MULTITHREADING
+                uatomic_inc(&c->chunks[i]->refCount);
+#else
+                c->chunks[i]->refCount++;
+#endif
+            }
+        }
+    } else {
+        retval = UA_Variant_copy(current, &c->base);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = UA_Variant_share(&c->base);
+    }
+
+    /* Write the range into the chunks */
+    if(retval == UA_STATUSCODE_GOOD) {
+        ChunkWrite cw = {c, (const UA_Byte*)elements->data, elements->arrayLength};
+        retval = UA_Variant_forRangeBlocks(current, range,
+                                           (UA_RangeBlockCallback)writeRangeBlock, &cw);
+        if(retval == UA_STATUSCODE_GOOD && cw.remaining > 0)
+            retval = UA_STATUSCODE_BADINDEXRANGEINVALID;
+    }
+
+    /* The buffer for the readers is allocated with the value. So reading
+       cannot fail. */
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_Variant_allocShared(&c->assembled, current->type, current->arrayLength);
+
+    /* The value keeps the type and the dimensions */
+    UA_Variant_init(value);
+    if(retval == UA_STATUSCODE_GOOD && current->arrayDimensionsSize > 0) {
+        retval = UA_Array_copy(current->arrayDimensions, current->arrayDimensionsSize,
+                               (void**)&value->arrayDimensions, &UA_TYPES[UA_TYPES_INT32]);
+        value->arrayDimensionsSize = current->arrayDimensionsSize;
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Variant_deleteMembers(value);
+        UA_ValueChunks_delete(c);
+        return retval;
+    }
+    value->type = current->type;
+    value->arrayLength = current->arrayLength;
+    *chunks = c;
+    return UA_STATUSCODE_GOOD;
+}
+
+const void * UA_ValueChunks_getChunk(const UA_ValueChunks *chunks, size_t index) {
+    if(index >= chunks->chunksSize)
+        return NULL;
+    return chunkData(chunks, index);
+}
+
+static void assembleChunks(UA_ValueChunks *c) {
+    UA_Byte *dst = (UA_Byte*)c->assembled.data;
+    size_t elemSize = c->base.type->memSize;
+    for(size_t i = 0; i < c->chunksSize; i++) {
+        size_t size = chunkLength(c, i) * elemSize;
+        memcpy(dst, chunkData(c, i), size);
+        dst += size;
+    }
+}
+
+/* The first reader puts the array together. Concurrent readers wait for it. */
+static const UA_Variant * getAssembled(UA_ValueChunks *c) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_read(&c->state) != CHUNKS_ASSEMBLED) {
+        if(uatomic_cmpxchg(&c->state, CHUNKS_UNASSEMBLED, CHUNKS_ASSEMBLING) ==
+           CHUNKS_UNASSEMBLED) {
+            assembleChunks(c);
+            cmm_smp_mb();
+            uatomic_set(&c->state, CHUNKS_ASSEMBLED);
+        } else {
+            while(uatomic_read(&c->state) != CHUNKS_ASSEMBLED)
+                caa_cpu_relax();
+        }
+    }
+    cmm_smp_mb();
+#else
+    if(c->state != CHUNKS_ASSEMBLED) {
+        assembleChunks(c);
+        c->state = CHUNKS_ASSEMBLED;
+    }
+#endif
+    return &c->assembled;
+}
+
+void UA_ValueChunks_delete(UA_ValueChunks *chunks) {
+    if(!chunks)
+        return;
+    for(size_t i = 0; i < chunks->chunksSize; i++) {
+        if(chunks->chunks[i])
+            releaseChunk(chunks->chunks[i]);
+    }
+    UA_Variant_deleteMembers(&chunks->base);
+    UA_Variant_deleteMembers(&chunks->assembled);
+    UA_free(chunks);
+}
+
+/*********/
+/* Nodes */
+/*********/
 
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
+    /* release the interned strings. the remaining members are empty. */
+    if(node->internedStrings)
+        releaseNodeStrings(node);
+
     /* delete standard content */
     UA_NodeId_deleteMembers(&node->nodeId);
     UA_QualifiedName_deleteMembers(&node->browseName);
@@ -10,6 +744,7 @@ void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
     UA_Array_delete(node->references, node->referencesSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
     node->references = NULL;
     node->referencesSize = 0;
+    dropReferenceCaches(node);
 
     /* delete unique content of the nodeclass */
     switch(node->nodeClass) {
@@ -24,6 +759,7 @@ void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
         UA_VariableNode *p = (UA_VariableNode*)node;
         if(p->valueSource == UA_VALUESOURCE_VARIANT)
             UA_Variant_deleteMembers(&p->value.variant.value);
+        UA_ValueChunks_delete(p->valueChunks);
         break;
     }
     case UA_NODECLASS_REFERENCETYPE: {
@@ -47,17 +783,97 @@ UA_ObjectNode_copy(const UA_ObjectNode *src, UA_ObjectNode *dst) {
     return UA_STATUSCODE_GOOD;
 }
 
+UA_UInt32 UA_VariableNode_getValue(const UA_VariableNode *node, UA_Variant *value) {
+    UA_ValueChunks *chunks;
+    UA_UInt32 seq;
+#ifndef UA_ENABLE_MULTITHREADING
+    *value = node->value.variant.value;
+    chunks = node->valueChunks;
+    seq = node->valueSeq;
+#else
+    do {
+        seq = uatomic_read(&node->valueSeq);
+        cmm_smp_mb();
+        *value = node->value.variant.value;
+        chunks = node->valueChunks;
+        cmm_smp_mb();
+    } while((seq & 1) || seq != uatomic_read(&node->valueSeq));
+#endif
+    if(chunks) {
+        value->data = getAssembled(chunks)->data;
+        value->storageType = UA_VARIANT_DATA_SHARED;
+    }
+    return seq;
+}
+
+/* The writer of the memory runs concurrently, also without multithreading in
+ * the server. A reader that sees an odd counter spins a bounded number of
+ * times. */
+#define UA_VALUEMEMORY_RETRIES 10000
+
+#if defined(__GNUC__) || defined(__clang__)
+# define UA_SEQ_LOAD(seq) __atomic_load_n(seq, __ATOMIC_ACQUIRE)
+# define UA_SEQ_RELOAD(seq) (__atomic_thread_fence(__ATOMIC_ACQUIRE), \
+                             __atomic_load_n(seq, __ATOMIC_RELAXED))
+#else
+# define UA_SEQ_LOAD(seq) (*(seq))
+# define UA_SEQ_RELOAD(seq) (*(seq))
+#endif
+
+UA_StatusCode
+UA_ValueMemory_read(const UA_ValueMemory *memory, void *buf, size_t bufSize,
+                    UA_Variant *value, UA_DateTime *sourceTimestamp) {
+    size_t length = memory->arrayLength > 0 ? memory->arrayLength : 1;
+    size_t size = length * memory->type->memSize;
+    void *data = buf;
+    if(size > bufSize) {
+        data = UA_malloc(size);
+        if(!data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    UA_DateTime time = 0;
+    size_t i = 0;
+    for(; i < UA_VALUEMEMORY_RETRIES; i++) {
+        UA_UInt32 seq = UA_SEQ_LOAD(memory->sequence);
+        if(seq & 1)
+            continue;
+        memcpy(data, memory->data, size);
+        if(memory->sourceTimestamp)
+            time = *memory->sourceTimestamp;
+        if(UA_SEQ_RELOAD(memory->sequence) == seq)
+            break;
+    }
+    if(i == UA_VALUEMEMORY_RETRIES) {
+        if(data != buf)
+            UA_free(data);
+        return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+    }
+
+    UA_Variant_init(value);
+    value->type = memory->type;
+    value->data = data;
+    value->storageType = (data == buf) ? UA_VARIANT_DATA_NODELETE : UA_VARIANT_DATA;
+    if(memory->arrayLength > 0)
+        value->arrayLength = memory->arrayLength;
+    if(memory->sourceTimestamp && sourceTimestamp)
+        *sourceTimestamp = time;
+    return UA_STATUSCODE_GOOD;
+}
+
 static UA_StatusCode
 UA_VariableNode_copy(const UA_VariableNode *src, UA_VariableNode *dst) {
     dst->valueRank = src->valueRank;
     dst->valueSource = src->valueSource;
     if(src->valueSource == UA_VALUESOURCE_VARIANT) {
-        UA_StatusCode retval = UA_Variant_copy(&src->value.variant.value, &dst->value.variant.value);
+        UA_Variant value;
+        dst->valueSeq = UA_VariableNode_getValue(src, &value);
+        UA_StatusCode retval = UA_Variant_copy(&value, &dst->value.variant.value);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
         dst->value.variant.callback = src->value.variant.callback;
     } else
-        dst->value.dataSource = src->value.dataSource;
+        dst->value = src->value;
     dst->accessLevel = src->accessLevel;
     dst->userAccessLevel = src->accessLevel;
     dst->minimumSamplingInterval = src->minimumSamplingInterval;
@@ -65,6 +881,13 @@ UA_VariableNode_copy(const UA_VariableNode *src, UA_VariableNode *dst) {
     return UA_STATUSCODE_GOOD;
 }
 
+void UA_MethodArguments_delete(UA_MethodArguments *args) {
+    if(!args)
+        return;
+    UA_Array_delete(args->inputArguments, args->inputArgumentsSize, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    UA_free(args);
+}
+
 static UA_StatusCode
 UA_MethodNode_copy(const UA_MethodNode *src, UA_MethodNode *dst) {
     dst->executable = src->executable;
@@ -86,12 +909,14 @@ UA_VariableTypeNode_copy(const UA_VariableTypeNode *src, UA_VariableTypeNode *ds
     dst->valueRank = src->valueRank;
     dst->valueSource = src->valueSource;
     if(src->valueSource == UA_VALUESOURCE_VARIANT){
-        UA_StatusCode retval = UA_Variant_copy(&src->value.variant.value, &dst->value.variant.value);
+        UA_Variant value;
+        dst->valueSeq = UA_VariableNode_getValue((const UA_VariableNode*)src, &value);
+        UA_StatusCode retval = UA_Variant_copy(&value, &dst->value.variant.value);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
         dst->value.variant.callback = src->value.variant.callback;
     } else
-        dst->value.dataSource = src->value.dataSource;
+        dst->value = src->value;
     dst->isAbstract = src->isAbstract;
     return UA_STATUSCODE_GOOD;
 }
@@ -140,6 +965,7 @@ UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst) {
         return retval;
     }
     dst->referencesSize = src->referencesSize;
+    dst->referencesVersion = src->referencesVersion;
 
     /* copy unique content of the nodeclass */
     switch(src->nodeClass) {
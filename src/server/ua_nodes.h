@@ -14,13 +14,16 @@
 #define UA_STANDARD_NODEMEMBERS                 \
     UA_NodeId nodeId;                           \
     UA_NodeClass nodeClass;                     \
+    UA_Boolean internedStrings;                 \
     UA_QualifiedName browseName;                \
     UA_LocalizedText displayName;               \
     UA_LocalizedText description;               \
     UA_UInt32 writeMask;                        \
     UA_UInt32 userWriteMask;                    \
     size_t referencesSize;                      \
-    UA_ReferenceNode *references;
+    UA_ReferenceNode *references;               \
+    size_t referencesVersion;                   \
+    struct UA_BrowseNameIndex *browseNameIndex;
 
 typedef struct {
     UA_STANDARD_NODEMEMBERS
@@ -29,6 +32,106 @@ typedef struct {
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node);
 UA_StatusCode UA_Node_copyAnyNodeClass(const UA_Node *src, UA_Node *dst);
 
+/**
+ * Interned Strings
+ * ----------------
+ * Large address spaces repeat the same strings many times: the locales of the
+ * names, the browse names of instances of the same type and the string
+ * identifiers of reference targets. When a node is added to the nodestore, its
+ * strings are replaced by shared copies from a process-wide table of
+ * immutable, reference-counted strings. This applies to the NodeId, the
+ * browse-, display- and inverse name, the description and the referenceTypeId
+ * and target of every reference. Interned strings with equal content share the
+ * same data pointer. So comparing them does not need to look at the content.
+ *
+ * Interned strings must not be changed or freed directly. Copies of a node
+ * (e.g. from ``UA_NodeStore_getCopy``) contain ordinary heap strings. */
+
+/* Interns the strings of the node. If the strings cannot be interned, the
+ * node is left unchanged and keeps its own copies. */
+void UA_Node_internStrings(UA_Node *node);
+
+/* Interns the strings of a member that was just added to the node if the
+ * strings of the node are interned. The member is a QualifiedName,
+ * LocalizedText or ReferenceNode. If interning fails, the member is unchanged
+ * and must not be added to the node. */
+UA_StatusCode UA_Node_internMember(const UA_Node *node, void *member, const UA_DataType *type);
+
+/* Deletes the content of a member of the node. Interned strings are released
+ * instead of freed. */
+void UA_Node_deleteMember(const UA_Node *node, void *member, const UA_DataType *type);
+
+/**
+ * References
+ * ----------
+ * The references of a node are sorted by reference type, direction (forward
+ * before inverse) and target nodeid. So the references of one type and
+ * direction are stored next to each other and are found with a binary search.
+ * The nodestore sorts the references of inserted and replaced nodes. Nodes
+ * that are edited in place keep the order with the functions below. */
+
+/* Orders the nodeids by namespace, identifier type and identifier. Numeric
+ * identifiers are ordered by value, strings by length and content. */
+UA_Int32 UA_NodeId_order(const UA_NodeId *a, const UA_NodeId *b);
+
+/* The order of the references within a node. The server index and namespace
+ * uri of the targets are not compared. */
+UA_Int32 UA_ReferenceNode_order(const UA_ReferenceNode *a, const UA_ReferenceNode *b);
+
+void UA_Node_sortReferences(UA_Node *node);
+
+/* Returns the index range [*begin, *end) of the references of the given type
+ * and direction. UA_BROWSEDIRECTION_BOTH returns the forward references
+ * followed by the inverse references. */
+void UA_Node_findReferences(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                            UA_BrowseDirection direction, size_t *begin, size_t *end);
+
+/* Returns the index of the reference or referencesSize if there is none */
+size_t UA_Node_findReference(const UA_Node *node, const UA_NodeId *referenceTypeId,
+                             UA_Boolean isInverse, const UA_NodeId *targetId);
+
+/* Adds a copy of the reference at its position in the order. The strings are
+ * interned if those of the node are interned. */
+UA_StatusCode UA_Node_addReference(UA_Node *node, const UA_NodeId *referenceTypeId,
+                                   UA_Boolean isInverse, const UA_ExpandedNodeId *targetId);
+
+/* Adds copies of many references at once and restores the order afterwards.
+ * Either all or none of the references are added. */
+UA_StatusCode UA_Node_addReferences(UA_Node *node, const UA_ReferenceNode *refs, size_t refsSize);
+
+void UA_Node_removeReference(UA_Node *node, size_t index);
+
+/**
+ * Browse Name Index
+ * -----------------
+ * TranslateBrowsePathsToNodeIds looks for the targets of a node with a given
+ * browse name. The index of a node holds the hash of the browse name of the
+ * target of every reference, ordered by the hash and then by the position of
+ * the reference. It is built on demand and dropped when the references of the
+ * node change. Copies of a node have no index. The browse names of the
+ * targets change independently of the node. So the index is tagged with a
+ * version that the server increments whenever a browse name may have changed.
+ * Matches in the index are always confirmed with the target node. */
+
+#define UA_BROWSENAMEINDEX_MINREFERENCES 8 /* smaller nodes are scanned */
+#define UA_BROWSENAMEINDEX_UNRESOLVED 0 /* hash for targets that were not found */
+
+typedef struct {
+    UA_UInt32 hash;
+    UA_UInt32 reference; /* position in the references of the node */
+} UA_BrowseNameIndexEntry;
+
+typedef struct UA_BrowseNameIndex {
+    UA_UInt32 version;
+    size_t entriesSize;
+    UA_BrowseNameIndexEntry *entries; /* allocated together with the index */
+} UA_BrowseNameIndex;
+
+UA_UInt32 UA_QualifiedName_hash(const UA_QualifiedName *qn);
+
+/* Returns the position of the first entry with the hash */
+size_t UA_BrowseNameIndex_find(const UA_BrowseNameIndex *index, UA_UInt32 hash);
+
 /**************/
 /* ObjectNode */
 /**************/
@@ -51,7 +154,8 @@ typedef struct {
 
 typedef enum {
     UA_VALUESOURCE_VARIANT,
-    UA_VALUESOURCE_DATASOURCE
+    UA_VALUESOURCE_DATASOURCE,
+    UA_VALUESOURCE_MEMORY /* see UA_ValueMemory */
 } UA_ValueSource;
 
 /****************/
@@ -66,12 +170,15 @@ typedef struct {
                              n = -2: the value can be a scalar or an array with any number of dimensions.
                              n = -3:  the value can be a scalar or a one dimensional array. */
     UA_ValueSource valueSource;
+    UA_UInt32 valueSeq; /* odd while the value is swapped (see below) */
+    struct UA_ValueChunks *valueChunks; /* the array after range writes (see below) */
     union {
         struct {
         UA_Variant value;
         UA_ValueCallback callback;
         } variant;
         UA_DataSource dataSource;
+        UA_ValueMemory memory;
     } value;
     /* <--- similar to variabletypenodes up to there--->*/
     UA_Byte accessLevel;
@@ -88,17 +195,76 @@ typedef struct {
     UA_STANDARD_NODEMEMBERS
     UA_Int32 valueRank;
     UA_ValueSource valueSource;
+    UA_UInt32 valueSeq;
+    struct UA_ValueChunks *valueChunks;
     union {
         struct {
             UA_Variant value;
             UA_ValueCallback callback;
         } variant;
         UA_DataSource dataSource;
+        UA_ValueMemory memory;
     } value;
     /* <--- similar to variablenodes up to there--->*/
     UA_Boolean isAbstract;
 } UA_VariableTypeNode;
 
+/**
+ * Value Updates
+ * ^^^^^^^^^^^^^
+ * Writing the value of a variable (type) node does not copy the node. The
+ * nodestore swaps the value in place (see ``UA_NodeStore_editValue``). Every
+ * swap increases ``valueSeq`` twice. With multithreading, readers take a
+ * snapshot of the value and retry if the sequence number was odd or changed in
+ * the meantime. Replaced values are freed when no job can access them anymore.
+ * So the snapshot stays valid until the end of the current job.
+ *
+ * Value Chunks
+ * ^^^^^^^^^^^^
+ * Large arrays of a fixed-size type are stored in chunks once a range is
+ * written. The value of the node then holds only the type and the dimensions.
+ * A range write copies the chunks it touches into the new value. The other
+ * chunks are shared with the old value. Chunks that were never written point
+ * into the data of the value before the first range write. So a range write
+ * does not copy the array, also while readers hold the old value. Readers get
+ * the array in one piece. It is put together on the first read of every value
+ * in a buffer that was allocated with the value. */
+
+#define UA_VALUECHUNK_SIZE 4096 /* bytes per chunk */
+
+typedef struct UA_ValueChunks UA_ValueChunks;
+
+/* Test if range writes into the value of a node are done in chunks */
+UA_Boolean UA_ValueChunks_applicable(const UA_Variant *value);
+
+/* Computes the chunks of the value of a node after a range write. The node is
+ * not changed. The value receives the type and dimensions of the array. */
+UA_StatusCode
+UA_ValueChunks_writeRange(const UA_VariableNode *node, const UA_Variant *elements,
+                          const UA_NumericRange range, UA_Variant *value,
+                          UA_ValueChunks **chunks);
+
+/* Returns the data of a chunk */
+const void * UA_ValueChunks_getChunk(const UA_ValueChunks *chunks, size_t index);
+
+void UA_ValueChunks_delete(UA_ValueChunks *chunks);
+
+/* Returns a shallow copy of the value of a variable or variable type node with
+ * a variant value source. Values in chunks are put together first. The
+ * snapshot must not be deleted. Copy it with
+ * ``UA_Variant_copy`` to keep it beyond the current job. Returns the sequence
+ * number of the value. */
+UA_UInt32 UA_VariableNode_getValue(const UA_VariableNode *node, UA_Variant *value);
+
+/* Takes a consistent snapshot of the memory bound to a variable. The data is
+ * placed in buf if it fits into bufSize bytes. Otherwise it is allocated. The
+ * source timestamp is set only if the memory has one. Returns
+ * UA_STATUSCODE_BADRESOURCEUNAVAILABLE if the writer does not finish its
+ * update. */
+UA_StatusCode
+UA_ValueMemory_read(const UA_ValueMemory *memory, void *buf, size_t bufSize,
+                    UA_Variant *value, UA_DateTime *sourceTimestamp);
+
 /*********************/
 /* ReferenceTypeNode */
 /*********************/
@@ -120,8 +286,29 @@ typedef struct {
     UA_Boolean userExecutable;
     void *methodHandle;
     UA_MethodCallback attachedMethod;
+    struct UA_MethodArguments *arguments; /* built on demand */
 } UA_MethodNode;
 
+/**
+ * Method Arguments
+ * ^^^^^^^^^^^^^^^^
+ * The Call service checks the input arguments against the definitions in the
+ * InputArguments property of the method. The definitions are copied into a
+ * cache of the method node at the first call. The cache is dropped when the
+ * references of the method change. Copies of a method node have no cache. The
+ * properties can be written independently of the method. So the cache is
+ * tagged with a version that the server increments whenever an argument
+ * definition may have changed. */
+
+typedef struct UA_MethodArguments {
+    UA_UInt32 version;
+    size_t inputArgumentsSize;
+    UA_Argument *inputArguments;
+    size_t outputArgumentsSize;
+} UA_MethodArguments;
+
+void UA_MethodArguments_delete(UA_MethodArguments *args);
+
 /************/
 /* ViewNode */
 /************/
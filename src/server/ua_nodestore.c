@@ -5,19 +5,72 @@
 
 #define UA_NODESTORE_MINSIZE 64
 
+/* Number of slots of the previous table that are moved to the current table
+ * with every insert and remove during a resize */
+#define UA_NODESTORE_MIGRATESTEPS 64
+
+#include "ua_nodestore_hash.inc"
+
 typedef struct UA_NodeStoreEntry {
     struct UA_NodeStoreEntry *orig; // the version this is a copy from (or NULL)
     UA_Node node;
 } UA_NodeStoreEntry;
 
-struct UA_NodeStore {
+/* The slots of the hash-map contain the hash and, for numeric nodeids, the
+ * identifier. So probing does not need to dereference the entries. The highest
+ * bit of the stored hash marks numeric nodeids. The hash of numeric nodeids is
+ * a bijection of identifier + namespaceIndex. So when the hash and the
+ * identifier are equal, the namespaceIndex is equal as well. */
+typedef struct {
+    hash_t hash;
+    UA_UInt32 numeric;
+    UA_NodeStoreEntry *entry;
+} UA_NodeStoreSlot;
+
+#define UA_NODESTORE_NUMERIC 0x80000000
+
+/* Marks a slot whose entry was removed. Lookups continue probing after it. */
+#define UA_NODESTORE_TOMBSTONE ((UA_NodeStoreEntry*)0x01)
+
+/* The orig of copies from static nodes */
+#define UA_NODESTORE_STATICORIG ((UA_NodeStoreEntry*)0x02)
+
+/* Numeric nodeids in the first namespaces are mostly dense, e.g. in ns0 and
+ * in generated nodesets. They are stored in an array indexed by the
+ * identifier, as long as the array stays reasonably filled. Other nodes, and
+ * nodes whose identifier would make the array too sparse, are stored in the
+ * hash-map. */
+#define UA_NODESTORE_DENSENAMESPACES 4
+#define UA_NODESTORE_DENSEMINSIZE 1024
+
+typedef struct {
     UA_NodeStoreEntry **entries;
     UA_UInt32 size;
     UA_UInt32 count;
+} UA_NodeStoreDense;
+
+/* The hash-map grows and shrinks incrementally. During a resize, the previous
+ * table is kept and its entries are moved to the current table a few at a
+ * time. Lookups look into both tables. So no single insert pays for the
+ * rehashing of the entire nodestore. */
+struct UA_NodeStore {
+    UA_NodeStoreSlot *slots;
+    UA_UInt32 size;
+    UA_UInt32 used; // slots that are not empty (includes tombstones)
+    UA_UInt32 count; // number of nodes in the nodestore
     UA_UInt32 sizePrimeIndex;
-};
 
-#include "ua_nodestore_hash.inc"
+    /* The previous table during a resize (or NULL) */
+    UA_NodeStoreSlot *oldSlots;
+    UA_UInt32 oldSize;
+    UA_UInt32 migrateIndex; // the next slot of the previous table to move
+
+    UA_NodeStoreDense dense[UA_NODESTORE_DENSENAMESPACES];
+
+    /* Looked up when a node is not found in the tables above */
+    const UA_StaticNodeTable **statics;
+    size_t staticsSize;
+};
 
 /* The size of the hash-map is always a prime number. They are chosen to be
    close to the next power of 2. So the size ca. doubles with each prime. */
@@ -72,7 +125,7 @@ static UA_NodeStoreEntry * instantiateEntry(UA_NodeClass nodeClass) {
     default:
         return NULL;
     }
-    UA_NodeStoreEntry *entry = UA_calloc(1, size);
+    UA_NodeStoreEntry *entry = UA_objcalloc(UA_MEMCATEGORY_NODESTORE, size);
     if(!entry)
         return NULL;
     entry->node.nodeClass = nodeClass;
@@ -81,93 +134,268 @@ static UA_NodeStoreEntry * instantiateEntry(UA_NodeClass nodeClass) {
 
 static void deleteEntry(UA_NodeStoreEntry *entry) {
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
-    UA_free(entry);
+    UA_objfree(entry);
 }
 
-/* Returns true if an entry was found under the nodeid. Otherwise, returns
-   false and sets slot to a pointer to the next free slot. */
-static UA_Boolean
-containsNodeId(const UA_NodeStore *ns, const UA_NodeId *nodeid, UA_NodeStoreEntry ***entry) {
-    hash_t h = hash(nodeid);
-    UA_UInt32 size = ns->size;
-    hash_t idx = mod(h, size);
-    UA_NodeStoreEntry *e = ns->entries[idx];
+static hash_t slotHash(const UA_NodeId *nodeid) {
+    hash_t h = hash(nodeid) & ~(hash_t)UA_NODESTORE_NUMERIC;
+    if(nodeid->identifierType == UA_NODEIDTYPE_NUMERIC)
+        h |= UA_NODESTORE_NUMERIC;
+    return h;
+}
 
-    if(!e) {
-        *entry = &ns->entries[idx];
+static UA_Boolean
+slotMatches(const UA_NodeStoreSlot *slot, const UA_NodeId *nodeid, hash_t h) {
+    if(slot->hash != h || slot->entry == UA_NODESTORE_TOMBSTONE)
         return false;
-    }
+    if(h & UA_NODESTORE_NUMERIC)
+        return slot->numeric == nodeid->identifier.numeric;
+    return UA_NodeId_equal(&slot->entry->node.nodeId, nodeid);
+}
 
-    if(UA_NodeId_equal(&e->node.nodeId, nodeid)) {
-        *entry = &ns->entries[idx];
-        return true;
+/* Returns the slot of the entry with the nodeid or NULL */
+static UA_NodeStoreSlot *
+findSlot(UA_NodeStoreSlot *slots, UA_UInt32 size, const UA_NodeId *nodeid, hash_t h) {
+    hash_t idx = mod(h, size);
+    hash_t hash2 = mod2(h, size);
+    for(;;) {
+        UA_NodeStoreSlot *slot = &slots[idx];
+        if(!slot->entry)
+            return NULL;
+        if(slotMatches(slot, nodeid, h))
+            return slot;
+        idx += hash2;
+        if(idx >= size)
+            idx -= size;
     }
+}
 
+/* Returns the first empty slot or tombstone for the hash */
+static UA_NodeStoreSlot *
+freeSlot(UA_NodeStoreSlot *slots, UA_UInt32 size, hash_t h) {
+    hash_t idx = mod(h, size);
     hash_t hash2 = mod2(h, size);
-    for(;;) {
+    while(slots[idx].entry && slots[idx].entry != UA_NODESTORE_TOMBSTONE) {
         idx += hash2;
         if(idx >= size)
             idx -= size;
-        e = ns->entries[idx];
-        if(!e) {
-            *entry = &ns->entries[idx];
-            return false;
-        }
-        if(UA_NodeId_equal(&e->node.nodeId, nodeid)) {
-            *entry = &ns->entries[idx];
-            return true;
-        }
     }
+    return &slots[idx];
+}
 
-    /* NOTREACHED */
-    return true;
+/* Returns the dense index for the nodeid or NULL */
+static UA_NodeStoreDense *
+denseIndex(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    if(nodeid->identifierType != UA_NODEIDTYPE_NUMERIC ||
+       nodeid->namespaceIndex >= UA_NODESTORE_DENSENAMESPACES)
+        return NULL;
+    return &ns->dense[nodeid->namespaceIndex];
 }
 
-/* The occupancy of the table after the call will be about 50% */
-static UA_StatusCode expand(UA_NodeStore *ns) {
-    UA_UInt32 osize = ns->size;
+/* Returns a pointer to the entry with the nodeid or NULL. If tableSlot is not
+   NULL, it is set to the slot in the hash-map (or NULL if the entry is stored
+   in a dense index). */
+static UA_NodeStoreEntry **
+containsNodeId(UA_NodeStore *ns, const UA_NodeId *nodeid, UA_NodeStoreSlot **tableSlot) {
+    UA_NodeStoreDense *dense = denseIndex(ns, nodeid);
+    if(dense && nodeid->identifier.numeric < dense->size &&
+       dense->entries[nodeid->identifier.numeric]) {
+        if(tableSlot)
+            *tableSlot = NULL;
+        return &dense->entries[nodeid->identifier.numeric];
+    }
+    hash_t h = slotHash(nodeid);
+    UA_NodeStoreSlot *slot = findSlot(ns->slots, ns->size, nodeid, h);
+    if(!slot && ns->oldSlots)
+        slot = findSlot(ns->oldSlots, ns->oldSize, nodeid, h);
+    if(!slot)
+        return NULL;
+    if(tableSlot)
+        *tableSlot = slot;
+    return &slot->entry;
+}
+
+/* Moves entries from the previous table to the current table */
+static void migrate(UA_NodeStore *ns, UA_UInt32 steps) {
+    if(!ns->oldSlots)
+        return;
+    UA_UInt32 end = ns->migrateIndex + steps;
+    if(end > ns->oldSize || end < ns->migrateIndex)
+        end = ns->oldSize;
+    for(UA_UInt32 i = ns->migrateIndex; i < end; i++) {
+        UA_NodeStoreSlot *old = &ns->oldSlots[i];
+        if(!old->entry || old->entry == UA_NODESTORE_TOMBSTONE)
+            continue;
+        UA_NodeStoreSlot *slot = freeSlot(ns->slots, ns->size, old->hash);
+        if(!slot->entry)
+            ns->used++;
+        *slot = *old;
+        old->entry = UA_NODESTORE_TOMBSTONE; // keep the probe sequences intact
+    }
+    ns->migrateIndex = end;
+    if(end < ns->oldSize)
+        return;
+    UA_free(ns->oldSlots);
+    ns->oldSlots = NULL;
+    ns->oldSize = 0;
+    ns->migrateIndex = 0;
+}
+
+/* The number of nodes in the hash-map */
+static UA_UInt32 tableCount(const UA_NodeStore *ns) {
     UA_UInt32 count = ns->count;
-    /* Resize only when table after removal of unused elements is either too full or too empty  */
-    if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODESTORE_MINSIZE))
-        return UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < UA_NODESTORE_DENSENAMESPACES; i++)
+        count -= ns->dense[i].count;
+    return count;
+}
 
-    UA_NodeStoreEntry **oentries = ns->entries;
+/* Starts moving the entries to a new table where the occupancy will be about
+ * 50% with the given number of nodes. A resize that is still in progress is
+ * completed beforehand. */
+static UA_StatusCode startResize(UA_NodeStore *ns, UA_UInt32 count) {
+    migrate(ns, ns->oldSize);
     UA_UInt32 nindex = higher_prime_index(count * 2);
+    if(nindex < higher_prime_index(UA_NODESTORE_MINSIZE))
+        nindex = higher_prime_index(UA_NODESTORE_MINSIZE);
     UA_UInt32 nsize = primes[nindex];
-    UA_NodeStoreEntry **nentries;
-    if(!(nentries = UA_calloc(nsize, sizeof(UA_NodeStoreEntry*))))
+    UA_NodeStoreSlot *nslots = UA_calloc(nsize, sizeof(UA_NodeStoreSlot));
+    if(!nslots)
         return UA_STATUSCODE_BADOUTOFMEMORY;
-
-    ns->entries = nentries;
+    ns->oldSlots = ns->slots;
+    ns->oldSize = ns->size;
+    ns->migrateIndex = 0;
+    ns->slots = nslots;
     ns->size = nsize;
+    ns->used = 0;
     ns->sizePrimeIndex = nindex;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns the dense slot for a new node or NULL if the node shall be stored in
+   the hash-map. The dense index grows as long as twice the identifier is
+   covered by the number of nodes in the index. */
+static UA_NodeStoreEntry **
+denseInsertSlot(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_NodeStoreDense *dense = denseIndex(ns, nodeid);
+    if(!dense)
+        return NULL;
+    UA_UInt32 id = nodeid->identifier.numeric;
+    if(id >= dense->size) {
+        if(id >= UA_NODESTORE_DENSEMINSIZE && id / 2 > dense->count)
+            return NULL;
+        UA_UInt32 nsize = dense->size > 0 ? dense->size : UA_NODESTORE_DENSEMINSIZE;
+        while(nsize <= id)
+            nsize *= 2;
+        UA_NodeStoreEntry **entries = UA_realloc(dense->entries, nsize * sizeof(UA_NodeStoreEntry*));
+        if(!entries)
+            return NULL;
+        memset(&entries[dense->size], 0, (nsize - dense->size) * sizeof(UA_NodeStoreEntry*));
+        dense->entries = entries;
+        dense->size = nsize;
+    }
+    dense->count++;
+    return &dense->entries[id];
+}
 
-    /* recompute the position of every entry and insert the pointer */
-    for(size_t i = 0, j = 0; i < osize && j < count; i++) {
-        if(!oentries[i])
+static void deleteTable(UA_NodeStoreSlot *slots, UA_UInt32 size) {
+    for(UA_UInt32 i = 0; i < size; i++) {
+        if(slots[i].entry && slots[i].entry != UA_NODESTORE_TOMBSTONE)
+            deleteEntry(slots[i].entry);
+    }
+    UA_free(slots);
+}
+
+/* Returns the static node with the nodeid if it is not hidden, or NULL */
+static const UA_Node *
+findStatic(UA_NodeStore *ns, const UA_NodeId *nodeid,
+           const UA_StaticNodeTable **table, size_t *index) {
+    for(size_t i = 0; i < ns->staticsSize; i++) {
+        const UA_StaticNodeTable *t = ns->statics[i];
+        size_t j = UA_StaticNodeTable_find(t, nodeid);
+        if(j == t->nodesSize)
             continue;
-        UA_NodeStoreEntry **e;
-        containsNodeId(ns, &oentries[i]->node.nodeId, &e);  /* We know this returns an empty entry here */
-        *e = oentries[i];
-        j++;
+        if(UA_StaticNodeTable_isHidden(t, j))
+            return NULL;
+        if(table) {
+            *table = t;
+            *index = j;
+        }
+        return t->nodes[j];
+    }
+    return NULL;
+}
+
+static UA_Boolean nodeIdExists(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    return containsNodeId(ns, nodeid, NULL) || findStatic(ns, nodeid, NULL, NULL);
+}
+
+/* Stores the entry in the dense index or the hash-map. The nodeid must not
+   exist yet. If insertion fails, the entry is not deleted. */
+static UA_StatusCode insertEntry(UA_NodeStore *ns, UA_NodeStoreEntry *entry) {
+    UA_NodeStoreEntry **denseSlot = denseInsertSlot(ns, &entry->node.nodeId);
+    if(denseSlot) {
+        *denseSlot = entry;
+        ns->count++;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Keep at least a quarter of the slots empty. Otherwise, probing gets
+       slow. If no new table can be allocated, continue as long as there is
+       still an empty slot left. */
+    if((ns->used + 1) * 4 > ns->size * 3) {
+        if(startResize(ns, tableCount(ns)) != UA_STATUSCODE_GOOD && ns->used + 1 >= ns->size)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    } else {
+        migrate(ns, UA_NODESTORE_MIGRATESTEPS);
     }
 
-    UA_free(oentries);
+    hash_t h = slotHash(&entry->node.nodeId);
+    UA_NodeStoreSlot *slot = freeSlot(ns->slots, ns->size, h);
+    if(!slot->entry)
+        ns->used++;
+    slot->hash = h;
+    slot->numeric = entry->node.nodeId.identifier.numeric;
+    slot->entry = entry;
+    ns->count++;
     return UA_STATUSCODE_GOOD;
 }
 
+/* Copies a static node to the heap so that it can be edited in place. Returns
+   the slot of the copy or NULL. */
+static UA_NodeStoreEntry **
+materializeStatic(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    const UA_StaticNodeTable *table;
+    size_t index;
+    const UA_Node *node = findStatic(ns, nodeid, &table, &index);
+    if(!node)
+        return NULL;
+    UA_NodeStoreEntry *entry = instantiateEntry(node->nodeClass);
+    if(!entry)
+        return NULL;
+    if(UA_Node_copyAnyNodeClass(node, &entry->node) != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return NULL;
+    }
+    UA_Node_internStrings(&entry->node);
+    if(insertEntry(ns, entry) != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return NULL;
+    }
+    UA_StaticNodeTable_hide(table, index);
+    return containsNodeId(ns, nodeid, NULL);
+}
+
 /**********************/
 /* Exported functions */
 /**********************/
 
 UA_NodeStore * UA_NodeStore_new(void) {
     UA_NodeStore *ns;
-    if(!(ns = UA_malloc(sizeof(UA_NodeStore))))
+    if(!(ns = UA_calloc(1, sizeof(UA_NodeStore))))
         return NULL;
     ns->sizePrimeIndex = higher_prime_index(UA_NODESTORE_MINSIZE);
     ns->size = primes[ns->sizePrimeIndex];
-    ns->count = 0;
-    if(!(ns->entries = UA_calloc(ns->size, sizeof(UA_NodeStoreEntry*)))) {
+    if(!(ns->slots = UA_calloc(ns->size, sizeof(UA_NodeStoreSlot)))) {
         UA_free(ns);
         return NULL;
     }
@@ -175,13 +403,18 @@ UA_NodeStore * UA_NodeStore_new(void) {
 }
 
 void UA_NodeStore_delete(UA_NodeStore *ns) {
-    UA_UInt32 size = ns->size;
-    UA_NodeStoreEntry **entries = ns->entries;
-    for(UA_UInt32 i = 0; i < size; i++) {
-        if(entries[i])
-            deleteEntry(entries[i]);
+    deleteTable(ns->slots, ns->size);
+    if(ns->oldSlots)
+        deleteTable(ns->oldSlots, ns->oldSize);
+    for(size_t i = 0; i < UA_NODESTORE_DENSENAMESPACES; i++) {
+        UA_NodeStoreDense *dense = &ns->dense[i];
+        for(UA_UInt32 j = 0; j < dense->size; j++) {
+            if(dense->entries[j])
+                deleteEntry(dense->entries[j]);
+        }
+        UA_free(dense->entries);
     }
-    UA_free(ns->entries);
+    UA_free(ns->statics);
     UA_free(ns);
 }
 
@@ -197,15 +430,10 @@ void UA_NodeStore_deleteNode(UA_Node *node) {
 }
 
 UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
-    if(ns->size * 3 <= ns->count * 4) {
-        if(expand(ns) != UA_STATUSCODE_GOOD)
-            return UA_STATUSCODE_BADINTERNALERROR;
-    }
-
+    UA_NodeStoreEntry *newEntry = container_of(node, UA_NodeStoreEntry, node);
     UA_NodeId tempNodeid;
     tempNodeid = node->nodeId;
     tempNodeid.namespaceIndex = 0;
-    UA_NodeStoreEntry **entry;
     if(UA_NodeId_isNull(&tempNodeid)) {
         if(node->nodeId.namespaceIndex == 0)
             node->nodeId.namespaceIndex = 1;
@@ -215,80 +443,274 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
         hash_t increase = mod2(identifier, size);
         while(true) {
             node->nodeId.identifier.numeric = identifier;
-            if(!containsNodeId(ns, &node->nodeId, &entry))
+            if(!nodeIdExists(ns, &node->nodeId))
                 break;
             identifier += increase;
             if(identifier >= size)
                 identifier -= size;
         }
     } else {
-        if(containsNodeId(ns, &node->nodeId, &entry)) {
-            deleteEntry(container_of(node, UA_NodeStoreEntry, node));
+        if(nodeIdExists(ns, &node->nodeId)) {
+            deleteEntry(newEntry);
             return UA_STATUSCODE_BADNODEIDEXISTS;
         }
     }
 
-    *entry = container_of(node, UA_NodeStoreEntry, node);
-    ns->count++;
+    UA_Node_sortReferences(node);
+    UA_Node_internStrings(node);
+    UA_StatusCode retval = insertEntry(ns, newEntry);
+    if(retval != UA_STATUSCODE_GOOD)
+        deleteEntry(newEntry);
+    return retval;
+}
+
+UA_StatusCode UA_NodeStore_reserve(UA_NodeStore *ns, size_t count) {
+    if(count > (size_t)(UA_UINT32_MAX / 4) - ns->count)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_UInt32 target = tableCount(ns) + (UA_UInt32)count;
+    if((target + 1) * 4 <= ns->size * 3)
+        return UA_STATUSCODE_GOOD;
+    /* Move all entries right away. Otherwise, the inserts of the batch pay for
+       the migration. */
+    UA_StatusCode retval = startResize(ns, target);
+    migrate(ns, ns->oldSize);
+    return retval;
+}
+
+/* The value was swapped in place since the copy was made */
+static UA_Boolean valueSwapped(const UA_Node *node, const UA_Node *copy) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE && node->nodeClass != UA_NODECLASS_VARIABLETYPE)
+        return false;
+    return ((const UA_VariableNode*)node)->valueSeq != ((const UA_VariableNode*)copy)->valueSeq;
+}
+
+/* The replaced static node is hidden. The new version is stored on the heap. */
+static UA_StatusCode
+replaceStatic(UA_NodeStore *ns, UA_NodeStoreEntry *newEntry) {
+    const UA_StaticNodeTable *table = NULL;
+    size_t index = 0;
+    const UA_Node *node = findStatic(ns, &newEntry->node.nodeId, &table, &index);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(!node)
+        retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    else if(newEntry->orig != UA_NODESTORE_STATICORIG || valueSwapped(node, &newEntry->node))
+        retval = UA_STATUSCODE_BADINTERNALERROR;
+    if(retval == UA_STATUSCODE_GOOD) {
+        UA_Node_internStrings(&newEntry->node);
+        retval = insertEntry(ns, newEntry);
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteEntry(newEntry);
+        return retval;
+    }
+    UA_StaticNodeTable_hide(table, index);
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
-    UA_NodeStoreEntry **entry;
-    if(!containsNodeId(ns, &node->nodeId, &entry))
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
     UA_NodeStoreEntry *newEntry = container_of(node, UA_NodeStoreEntry, node);
-    if(*entry != newEntry->orig) {
+    UA_Node_sortReferences(node);
+    UA_NodeStoreEntry **slot = containsNodeId(ns, &node->nodeId, NULL);
+    if(!slot)
+        return replaceStatic(ns, newEntry);
+    if(*slot != newEntry->orig || valueSwapped(&(*slot)->node, node)) {
         deleteEntry(newEntry);
         return UA_STATUSCODE_BADINTERNALERROR; // the node was replaced since the copy was made
     }
-    deleteEntry(*entry);
-    *entry = newEntry;
+    UA_Node_internStrings(node);
+    deleteEntry(*slot);
+    *slot = newEntry;
     return UA_STATUSCODE_GOOD;
 }
 
 const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **entry;
-    if(!containsNodeId(ns, nodeid, &entry))
-        return NULL;
-    return (const UA_Node*)&(*entry)->node;
+    UA_NodeStoreEntry **slot = containsNodeId(ns, nodeid, NULL);
+    if(!slot)
+        return findStatic(ns, nodeid, NULL, NULL);
+    return (const UA_Node*)&(*slot)->node;
 }
 
 UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot;
-    if(!containsNodeId(ns, nodeid, &slot))
-        return NULL;
-    UA_NodeStoreEntry *entry = *slot;
-    UA_NodeStoreEntry *new = instantiateEntry(entry->node.nodeClass);
+    UA_NodeStoreEntry **slot = containsNodeId(ns, nodeid, NULL);
+    const UA_Node *node;
+    UA_NodeStoreEntry *orig;
+    if(slot) {
+        orig = *slot;
+        node = &orig->node;
+    } else {
+        orig = UA_NODESTORE_STATICORIG;
+        node = findStatic(ns, nodeid, NULL, NULL);
+        if(!node)
+            return NULL;
+    }
+    UA_NodeStoreEntry *new = instantiateEntry(node->nodeClass);
     if(!new)
         return NULL;
-    if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
+    if(UA_Node_copyAnyNodeClass(node, &new->node) != UA_STATUSCODE_GOOD) {
         deleteEntry(new);
         return NULL;
     }
-    new->orig = entry;
+    new->orig = orig;
     return &new->node;
 }
 
+/* Finds the variable (type) node whose value is changed. Static nodes are
+ * materialized first. */
+static UA_StatusCode
+findValueNode(UA_NodeStore *ns, const UA_NodeId *nodeid, UA_VariableNode **node) {
+    UA_NodeStoreEntry **slot = containsNodeId(ns, nodeid, NULL);
+    if(!slot) {
+        const UA_Node *snode = findStatic(ns, nodeid, NULL, NULL);
+        if(!snode)
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        if(snode->nodeClass != UA_NODECLASS_VARIABLE && snode->nodeClass != UA_NODECLASS_VARIABLETYPE)
+            return UA_STATUSCODE_BADNODECLASSINVALID;
+        /* Static values cannot be changed in place */
+        slot = materializeStatic(ns, nodeid);
+        if(!slot)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    *node = (UA_VariableNode*)&(*slot)->node;
+    if((*node)->nodeClass != UA_NODECLASS_VARIABLE && (*node)->nodeClass != UA_NODECLASS_VARIABLETYPE)
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_NodeStore_editValue(UA_NodeStore *ns, const UA_NodeId *nodeid,
+                       UA_NodeStore_valueEditor editor, void *data) {
+    UA_VariableNode *node = NULL;
+    UA_StatusCode retval = findValueNode(ns, nodeid, &node);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_Variant value;
+    UA_Variant_init(&value);
+    UA_ValueChunks *chunks = NULL;
+    retval = editor(node, &value, &chunks, data);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    /* Without multithreading, readers hold their own references to shared
+       data. So the old value is deleted right away. */
+    UA_Variant_deleteMembers(&node->value.variant.value);
+    UA_ValueChunks_delete(node->valueChunks);
+    node->value.variant.value = value;
+    node->valueChunks = chunks;
+    node->valueSeq += 2;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_NodeStore_writeValue(UA_NodeStore *ns, const UA_NodeId *nodeid,
+                        UA_NodeStore_valueWriter writer, void *data) {
+    UA_VariableNode *node = NULL;
+    UA_StatusCode retval = findValueNode(ns, nodeid, &node);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = writer(node, data);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    /* Copies of the node cannot overwrite the changed value */
+    node->valueSeq += 2;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_UInt32 UA_NodeStore_hash(const UA_NodeId *nodeid) {
+    return hash(nodeid);
+}
+
 UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot;
-    if(!containsNodeId(ns, nodeid, &slot))
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    UA_NodeStoreSlot *tableSlot;
+    UA_NodeStoreEntry **slot = containsNodeId(ns, nodeid, &tableSlot);
+    if(!slot) {
+        const UA_StaticNodeTable *table;
+        size_t index;
+        if(!findStatic(ns, nodeid, &table, &index))
+            return UA_STATUSCODE_BADNODEIDUNKNOWN;
+        UA_StaticNodeTable_hide(table, index);
+        return UA_STATUSCODE_GOOD;
+    }
     deleteEntry(*slot);
-    *slot = NULL;
     ns->count--;
-    /* Downsize the hashmap if it is very empty */
-    if(ns->count * 8 < ns->size && ns->size > 32)
-        expand(ns); // this can fail. we just continue with the bigger hashmap.
+    if(!tableSlot) {
+        *slot = NULL;
+        denseIndex(ns, nodeid)->count--;
+        return UA_STATUSCODE_GOOD;
+    }
+    *slot = UA_NODESTORE_TOMBSTONE;
+    /* Downsize the hashmap if it is very empty. If this fails, we just
+       continue with the bigger hashmap. */
+    if(!ns->oldSlots && tableCount(ns) * 8 < ns->size && ns->size > UA_NODESTORE_MINSIZE)
+        startResize(ns, tableCount(ns));
+    else
+        migrate(ns, UA_NODESTORE_MIGRATESTEPS);
     return UA_STATUSCODE_GOOD;
 }
 
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
-    for(UA_UInt32 i = 0; i < ns->size; i++) {
-        if(ns->entries[i])
-            visitor((UA_Node*)&ns->entries[i]->node);
+void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor, void *handle) {
+    UA_NodeStore_iteratePartition(ns, 0, 1, visitor, handle);
+}
+
+/* Every array of nodes is split into the partitions */
+void UA_NodeStore_iteratePartition(UA_NodeStore *ns, size_t partition, size_t partitions,
+                                   UA_NodeStore_nodeVisitor visitor, void *handle) {
+    size_t begin, end;
+    for(size_t i = 0; i < UA_NODESTORE_DENSENAMESPACES; i++) {
+        UA_NodeStoreDense *dense = &ns->dense[i];
+        partitionRange(dense->size, partition, partitions, &begin, &end);
+        for(size_t j = begin; j < end; j++) {
+            if(dense->entries[j])
+                visitor(handle, (UA_Node*)&dense->entries[j]->node);
+        }
+    }
+    partitionRange(ns->size, partition, partitions, &begin, &end);
+    for(size_t i = begin; i < end; i++) {
+        if(ns->slots[i].entry && ns->slots[i].entry != UA_NODESTORE_TOMBSTONE)
+            visitor(handle, (UA_Node*)&ns->slots[i].entry->node);
+    }
+    /* The slots before migrateIndex were moved already */
+    partitionRange(ns->oldSize - ns->migrateIndex, partition, partitions, &begin, &end);
+    for(size_t i = ns->migrateIndex + begin; i < ns->migrateIndex + end; i++) {
+        if(ns->oldSlots[i].entry && ns->oldSlots[i].entry != UA_NODESTORE_TOMBSTONE)
+            visitor(handle, (UA_Node*)&ns->oldSlots[i].entry->node);
+    }
+    for(size_t i = 0; i < ns->staticsSize; i++) {
+        const UA_StaticNodeTable *table = ns->statics[i];
+        partitionRange(table->nodesSize, partition, partitions, &begin, &end);
+        for(size_t j = begin; j < end; j++) {
+            if(!UA_StaticNodeTable_isHidden(table, j))
+                visitor(handle, table->nodes[j]);
+        }
+    }
+}
+
+UA_Boolean UA_NodeStore_isStatic(UA_NodeStore *ns, const UA_Node *node) {
+    for(size_t i = 0; i < ns->staticsSize; i++) {
+        const UA_StaticNodeTable *table = ns->statics[i];
+        size_t j = UA_StaticNodeTable_find(table, &node->nodeId);
+        if(j < table->nodesSize && table->nodes[j] == node)
+            return true;
+    }
+    return false;
+}
+
+UA_StatusCode
+UA_NodeStore_addStaticNodes(UA_NodeStore *ns, const UA_StaticNodeTable *table) {
+    if(UA_StaticNodeTable_check(table) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    for(size_t i = 0; i < table->nodesSize; i++) {
+        if(nodeIdExists(ns, &table->nodes[i]->nodeId))
+            return UA_STATUSCODE_BADNODEIDEXISTS;
     }
+    const UA_StaticNodeTable **statics =
+        UA_realloc(ns->statics, (ns->staticsSize + 1) * sizeof(UA_StaticNodeTable*));
+    if(!statics)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    memset(table->hidden, 0, (table->nodesSize + 7) / 8);
+    statics[ns->staticsSize] = table;
+    ns->statics = statics;
+    ns->staticsSize++;
+    return UA_STATUSCODE_GOOD;
 }
 
 #endif /* UA_ENABLE_MULTITHREADING */
@@ -22,10 +22,17 @@ typedef struct UA_NodeStore UA_NodeStore;
 /* Create a new nodestore */
 UA_NodeStore * UA_NodeStore_new(void);
 
-/* Delete the nodestore and all nodes in it. Do not call from a read-side
-   critical section (multithreading). */
+/* Delete the nodestore and all nodes in it. No other thread may access the
+   nodestore anymore (multithreading). */
 void UA_NodeStore_delete(UA_NodeStore *ns);
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Readers take no locks (multithreading). Removed and replaced nodes are freed
+   with the delayed callbacks of the server when no job can access them
+   anymore. Without a server, they are freed right away. */
+void UA_NodeStore_setServer(UA_NodeStore *ns, UA_Server *server);
+#endif
+
 /**
  * Node Lifecycle
  * ---------------
@@ -56,6 +63,11 @@ void UA_NodeStore_deleteNode(UA_Node *node);
  * deleted. */
 UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node);
 
+/* Grows the nodestore so that count more nodes can be inserted without
+ * resizing in between. Returns UA_STATUSCODE_BADOUTOFMEMORY if the memory cannot
+ * be allocated. The nodestore remains usable in that case. */
+UA_StatusCode UA_NodeStore_reserve(UA_NodeStore *ns, size_t count);
+
 /* The returned node is immutable. */
 const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid);
 
@@ -70,16 +82,97 @@ UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid);
  * node is deleted. */
 UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node);
 
+/* Computes the new value of a variable (type) node from the current value.
+ * The new value is owned by the nodestore if the editor returns
+ * UA_STATUSCODE_GOOD. So are the chunks if the editor stores the array of the
+ * new value in chunks (see UA_ValueChunks). The editor must not change the
+ * node. With multithreading, it runs while other writers of the node are
+ * blocked. */
+typedef UA_StatusCode
+(*UA_NodeStore_valueEditor)(const UA_VariableNode *node, UA_Variant *value,
+                            UA_ValueChunks **chunks, void *data);
+
+/* Swaps the value of a variable (type) node in place without copying the
+ * node. The old value is freed when no reader can access it anymore. Copies
+ * of the node that were made before the value was swapped cannot be replaced
+ * anymore (UA_STATUSCODE_BADINTERNALERROR). */
+UA_StatusCode
+UA_NodeStore_editValue(UA_NodeStore *ns, const UA_NodeId *nodeid,
+                       UA_NodeStore_valueEditor editor, void *data);
+
+#ifndef UA_ENABLE_MULTITHREADING
+/* Changes the value of a variable (type) node in place. Readers hold their own
+ * references to shared data. So the writer must copy shared data with more
+ * than one reference before writing into it (see UA_Variant_setRange). The
+ * value must be unchanged if the writer fails. With multithreading, readers
+ * take snapshots without references and values can only be swapped. */
+typedef UA_StatusCode
+(*UA_NodeStore_valueWriter)(UA_VariableNode *node, void *data);
+
+UA_StatusCode
+UA_NodeStore_writeValue(UA_NodeStore *ns, const UA_NodeId *nodeid,
+                        UA_NodeStore_valueWriter writer, void *data);
+#endif
+
 /* Remove a node in the nodestore. */
 UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid);
 
+/* The hash of a nodeid as used by the nodestore. For other indices over
+ * nodeids. */
+UA_UInt32 UA_NodeStore_hash(const UA_NodeId *nodeid);
+
 /**
  * Iteration
  * ---------
  * The following definitions are used to call a callback for every node in the
  * nodestore. */
-typedef void (*UA_NodeStore_nodeVisitor)(const UA_Node *node);
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor);
+typedef void (*UA_NodeStore_nodeVisitor)(void *handle, const UA_Node *node);
+void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor, void *handle);
+
+/* Visits one of several disjoint partitions of the nodestore. Together, the
+ * partitions 0 to partitions-1 visit every node once. The partitions can be
+ * visited at the same time from different threads. With multithreading, nodes
+ * that are inserted, removed or moved by a resize in the meantime may be
+ * missed or visited twice. */
+void UA_NodeStore_iteratePartition(UA_NodeStore *ns, size_t partition, size_t partitions,
+                                   UA_NodeStore_nodeVisitor visitor, void *handle);
+
+/**
+ * Static Nodes
+ * ------------
+ * Tables of constant nodes are generated by the nodeset compiler (option
+ * ``--static``) and can be placed in read-only memory. The nodestore looks up
+ * the static nodes in the tables when they are not found among the nodes on
+ * the heap. Replacing or editing the value of a static node stores the new
+ * version on the heap and hides the static node. Removed static nodes are
+ * hidden as well. The tables must outlive the nodestore. A table can be added
+ * to one nodestore at a time. */
+struct UA_StaticNodeTable {
+    const UA_Node * const *nodes; /* sorted by UA_NodeId_order */
+    size_t nodesSize;
+    UA_Byte *hidden; /* one bit per node in writable memory */
+};
+
+/* Adds a table of static nodes. No other thread may use the nodestore in the
+ * meantime. Returns UA_STATUSCODE_BADINVALIDARGUMENT if the nodes or their
+ * references are not sorted and UA_STATUSCODE_BADNODEIDEXISTS if one of the nodes exists
+ * already. */
+UA_StatusCode
+UA_NodeStore_addStaticNodes(UA_NodeStore *ns, const UA_StaticNodeTable *table);
+
+/* Checks that the nodes are sorted without duplicates and that the references
+ * of every node are sorted */
+UA_StatusCode UA_StaticNodeTable_check(const UA_StaticNodeTable *table);
+
+/* Returns the index of the node or nodesSize if the table does not contain the
+ * nodeid. Hidden nodes are found as well. */
+size_t UA_StaticNodeTable_find(const UA_StaticNodeTable *table, const UA_NodeId *nodeid);
+
+UA_Boolean UA_StaticNodeTable_isHidden(const UA_StaticNodeTable *table, size_t index);
+void UA_StaticNodeTable_hide(const UA_StaticNodeTable *table, size_t index);
+
+/* The node is taken from a static table and must not be edited in place */
+UA_Boolean UA_NodeStore_isStatic(UA_NodeStore *ns, const UA_Node *node);
 
 #ifdef __cplusplus
 } // extern "C"
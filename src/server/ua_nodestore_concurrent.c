@@ -1,16 +1,80 @@
 #include "ua_util.h"
 #include "ua_nodestore.h"
+#include "ua_server_internal.h"
 
 #ifdef UA_ENABLE_MULTITHREADING /* conditional compilation */
 
+#include <pthread.h>
+
+/* The nodestore is split into shards that are selected by the highest bits of
+ * the hash. Every shard is an open-addressing hash-map with linear probing.
+ * Readers take no locks. Writers take the lock of the shard. Tables and entries
+ * that readers may still see are freed with the delayed callbacks of the
+ * server, when all jobs that were dispatched before have finished. */
+
+#define UA_NODESTORE_SHARDBITS 4
+#define UA_NODESTORE_SHARDS (1 << UA_NODESTORE_SHARDBITS)
+#define UA_NODESTORE_MINSIZE 64 /* a power of two */
+
+#include "ua_nodestore_hash.inc"
+
 struct nodeEntry {
-    struct cds_lfht_node htn; ///< Contains the next-ptr for urcu-hashmap
-    struct rcu_head rcu_head; ///< For call-rcu
-    struct nodeEntry *orig; //< the version this is a copy from (or NULL)
-    UA_Node node; ///< Might be cast from any _bigger_ UA_Node* type. Allocate enough memory!
+    struct nodeEntry *orig; // the version this is a copy from (or NULL)
+    UA_Node node; // Might be cast from any _bigger_ UA_Node* type. Allocate enough memory!
 };
 
-#include "ua_nodestore_hash.inc"
+/* Marks a slot whose entry was removed. Lookups continue probing after it. */
+#define UA_NODESTORE_TOMBSTONE ((struct nodeEntry*)0x01)
+
+/* The orig of copies from static nodes */
+#define UA_NODESTORE_STATICORIG ((struct nodeEntry*)0x02)
+
+/* The hash is written before the entry is published. Readers that see a stale
+ * hash compare the nodeid of the entry in addition. So they can at most miss an
+ * entry that is inserted concurrently. */
+typedef struct {
+    hash_t hash;
+    struct nodeEntry *entry;
+} UA_NodeStoreSlot;
+
+typedef struct {
+    UA_UInt32 size;
+    UA_UInt32 used; // slots that are not empty (includes tombstones)
+    UA_NodeStoreSlot slots[];
+} UA_NodeStoreTable;
+
+typedef struct {
+    pthread_mutex_t lock; // taken by writers
+    UA_NodeStoreTable *table;
+    UA_UInt32 count;
+} UA_NodeStoreShard;
+
+struct UA_NodeStore {
+    UA_Server *server; // for the delayed freeing of entries and tables
+    UA_UInt32 nextIdentifier; // for the creation of unique nodeids
+    UA_NodeStoreShard shards[UA_NODESTORE_SHARDS];
+
+    /* Looked up when a node is not found in the shards. Static nodes are
+       hidden with the lock of the shard that the nodeid belongs to. A new
+       table is added by replacing the array. The array is published before
+       its size. */
+    pthread_mutex_t staticsLock; // taken by writers
+    const UA_StaticNodeTable **statics;
+    size_t staticsSize;
+};
+
+/* Returns the tables and their number. Can be used by readers without the
+   lock. */
+static const UA_StaticNodeTable **
+loadStatics(UA_NodeStore *ns, size_t *staticsSize) {
+    *staticsSize = uatomic_read(&ns->staticsSize);
+    cmm_smp_mb(); // pairs with the barrier before the size is published
+    return uatomic_read(&ns->statics);
+}
+
+static UA_NodeStoreShard * getShard(UA_NodeStore *ns, hash_t h) {
+    return &ns->shards[h >> (32 - UA_NODESTORE_SHARDBITS)];
+}
 
 static struct nodeEntry * instantiateEntry(UA_NodeClass class) {
     size_t size = sizeof(struct nodeEntry) - sizeof(UA_Node);
@@ -42,47 +106,254 @@ static struct nodeEntry * instantiateEntry(UA_NodeClass class) {
     default:
         return NULL;
     }
-    struct nodeEntry *entry = UA_calloc(1, size);
+    struct nodeEntry *entry = UA_objcalloc(UA_MEMCATEGORY_NODESTORE, size);
     if(!entry)
         return NULL;
     entry->node.nodeClass = class;
     return entry;
 }
 
-static void deleteEntry(struct rcu_head *head) {
-    struct nodeEntry *entry = container_of(head, struct nodeEntry, rcu_head);
+static void deleteEntry(struct nodeEntry *entry) {
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
-    UA_free(entry);
+    UA_objfree(entry);
+}
+
+static void delayedDeleteEntry(UA_Server *server, void *entry) {
+    deleteEntry((struct nodeEntry*)entry);
+}
+
+/* Readers may still access the entry */
+static void retireEntry(UA_NodeStore *ns, struct nodeEntry *entry) {
+    if(!ns->server)
+        deleteEntry(entry);
+    else
+        UA_Server_delayedCallback(ns->server, delayedDeleteEntry, entry);
+}
+
+/* A value that was swapped out of a node */
+typedef struct {
+    UA_Variant value;
+    UA_ValueChunks *chunks;
+} RetiredValue;
+
+static void deleteRetiredValue(RetiredValue *old) {
+    UA_Variant_deleteMembers(&old->value);
+    UA_ValueChunks_delete(old->chunks);
+    UA_free(old);
+}
+
+static void delayedDeleteValue(UA_Server *server, void *old) {
+    deleteRetiredValue((RetiredValue*)old);
+}
+
+/* Readers may still hold a snapshot of the value and are about to take a
+   reference to its shared data */
+static void retireValue(UA_NodeStore *ns, RetiredValue *old) {
+    if(!ns->server)
+        deleteRetiredValue(old);
+    else
+        UA_Server_delayedCallback(ns->server, delayedDeleteValue, old);
+}
+
+/* Tables of the shards and arrays of the static tables */
+static void retireMemory(UA_NodeStore *ns, void *p) {
+    if(!ns->server)
+        UA_free(p);
+    else
+        UA_Server_delayedFree(ns->server, p);
 }
 
-/* We are in a rcu_read lock. So the node will not be freed under our feet. */
-static int compare(struct cds_lfht_node *htn, const void *orig) {
-    const UA_NodeId *origid = (const UA_NodeId *)orig;
-    /* The htn is first in the entry structure. */
-    const UA_NodeId *newid  = &((struct nodeEntry *)htn)->node.nodeId;
-    return UA_NodeId_equal(newid, origid);
+static UA_NodeStoreTable * newTable(UA_UInt32 size) {
+    UA_NodeStoreTable *table =
+        UA_calloc(1, sizeof(UA_NodeStoreTable) + (size * sizeof(UA_NodeStoreSlot)));
+    if(table)
+        table->size = size;
+    return table;
 }
 
+/* Returns the slot of the entry with the nodeid or NULL. Can be used by readers
+   without the lock. */
+static UA_NodeStoreSlot *
+findSlot(UA_NodeStoreTable *table, const UA_NodeId *nodeid, hash_t h) {
+    UA_UInt32 mask = table->size - 1;
+    for(UA_UInt32 idx = h & mask; ; idx = (idx + 1) & mask) {
+        UA_NodeStoreSlot *slot = &table->slots[idx];
+        hash_t slotHash = CMM_LOAD_SHARED(slot->hash);
+        struct nodeEntry *entry = uatomic_read(&slot->entry);
+        if(!entry)
+            return NULL;
+        if(entry != UA_NODESTORE_TOMBSTONE && slotHash == h &&
+           UA_NodeId_equal(&entry->node.nodeId, nodeid))
+            return slot;
+    }
+}
+
+/* Returns the first empty slot or tombstone for the hash */
+static UA_NodeStoreSlot * freeSlot(UA_NodeStoreTable *table, hash_t h) {
+    UA_UInt32 mask = table->size - 1;
+    UA_UInt32 idx = h & mask;
+    while(table->slots[idx].entry && table->slots[idx].entry != UA_NODESTORE_TOMBSTONE)
+        idx = (idx + 1) & mask;
+    return &table->slots[idx];
+}
+
+/* Call with the lock of the shard held. The new entry becomes visible for
+   readers once the entry pointer is set. */
+static void publishEntry(UA_NodeStoreTable *table, UA_NodeStoreSlot *slot,
+                         hash_t h, struct nodeEntry *entry) {
+    if(!slot->entry)
+        table->used++;
+    CMM_STORE_SHARED(slot->hash, h);
+    cmm_smp_mb();
+    uatomic_set(&slot->entry, entry);
+}
+
+/* Call with the lock of the shard held. Moves the entries to a new table where
+ * the occupancy is about 50% with the given number of nodes. Readers continue
+ * on the old table until the new one is published. */
+static UA_StatusCode
+resizeShard(UA_NodeStore *ns, UA_NodeStoreShard *shard, UA_UInt32 count) {
+    UA_UInt32 size = UA_NODESTORE_MINSIZE;
+    while(size < count * 2)
+        size *= 2;
+    UA_NodeStoreTable *table = newTable(size);
+    if(!table)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_NodeStoreTable *old = shard->table;
+    for(UA_UInt32 i = 0; i < old->size; i++) {
+        UA_NodeStoreSlot *slot = &old->slots[i];
+        if(!slot->entry || slot->entry == UA_NODESTORE_TOMBSTONE)
+            continue;
+        UA_NodeStoreSlot *s = freeSlot(table, slot->hash);
+        s->hash = slot->hash;
+        s->entry = slot->entry;
+        table->used++;
+    }
+    cmm_smp_mb();
+    uatomic_set(&shard->table, table);
+    retireMemory(ns, old);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns the static node with the nodeid if it is not hidden, or NULL. Can
+   be used by readers without the lock. */
+static const UA_Node *
+findStatic(UA_NodeStore *ns, const UA_NodeId *nodeid,
+           const UA_StaticNodeTable **table, size_t *index) {
+    size_t staticsSize;
+    const UA_StaticNodeTable **statics = loadStatics(ns, &staticsSize);
+    for(size_t i = 0; i < staticsSize; i++) {
+        const UA_StaticNodeTable *t = statics[i];
+        size_t j = UA_StaticNodeTable_find(t, nodeid);
+        if(j == t->nodesSize)
+            continue;
+        if(UA_StaticNodeTable_isHidden(t, j))
+            return NULL;
+        if(table) {
+            *table = t;
+            *index = j;
+        }
+        return t->nodes[j];
+    }
+    return NULL;
+}
+
+/* Call with the lock of the shard held. The nodeid must not exist. */
+static UA_StatusCode
+publishNewEntry(UA_NodeStore *ns, UA_NodeStoreShard *shard, hash_t h, struct nodeEntry *entry) {
+    /* Keep at least a quarter of the slots empty. If no new table can be
+       allocated, continue as long as there is still an empty slot left. */
+    UA_NodeStoreTable *table = shard->table;
+    if((table->used + 1) * 4 > table->size * 3) {
+        if(resizeShard(ns, shard, shard->count) != UA_STATUSCODE_GOOD && table->used + 1 >= table->size)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        table = shard->table;
+    }
+    publishEntry(table, freeSlot(table, h), h, entry);
+    shard->count++;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Inserts the entry if no entry with the same nodeid exists */
+static UA_StatusCode
+insertEntry(UA_NodeStore *ns, struct nodeEntry *entry) {
+    hash_t h = hash(&entry->node.nodeId);
+    UA_NodeStoreShard *shard = getShard(ns, h);
+    pthread_mutex_lock(&shard->lock);
+    UA_StatusCode retval = UA_STATUSCODE_BADNODEIDEXISTS;
+    if(!findSlot(shard->table, &entry->node.nodeId, h) &&
+       !findStatic(ns, &entry->node.nodeId, NULL, NULL))
+        retval = publishNewEntry(ns, shard, h, entry);
+    pthread_mutex_unlock(&shard->lock);
+    return retval;
+}
+
+/* Call with the lock of the shard held. Copies a static node to the heap so
+   that it can be edited in place. Returns the slot of the copy or NULL. */
+static UA_NodeStoreSlot *
+materializeStatic(UA_NodeStore *ns, UA_NodeStoreShard *shard, hash_t h,
+                  const UA_StaticNodeTable *table, size_t index) {
+    const UA_Node *node = table->nodes[index];
+    struct nodeEntry *entry = instantiateEntry(node->nodeClass);
+    if(!entry)
+        return NULL;
+    if(UA_Node_copyAnyNodeClass(node, &entry->node) != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return NULL;
+    }
+    UA_Node_internStrings(&entry->node);
+    if(publishNewEntry(ns, shard, h, entry) != UA_STATUSCODE_GOOD) {
+        deleteEntry(entry);
+        return NULL;
+    }
+    /* Readers find the copy before the static node is hidden */
+    UA_StaticNodeTable_hide(table, index);
+    return findSlot(shard->table, &node->nodeId, h);
+}
+
+/**********************/
+/* Exported functions */
+/**********************/
+
 UA_NodeStore * UA_NodeStore_new() {
-    /* 64 is the minimum size for the hashtable. */
-    return (UA_NodeStore*)cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+    UA_NodeStore *ns = UA_calloc(1, sizeof(UA_NodeStore));
+    if(!ns)
+        return NULL;
+    for(size_t i = 0; i < UA_NODESTORE_SHARDS; i++) {
+        UA_NodeStoreShard *shard = &ns->shards[i];
+        shard->table = newTable(UA_NODESTORE_MINSIZE);
+        if(!shard->table) {
+            for(size_t j = 0; j < i; j++) {
+                pthread_mutex_destroy(&ns->shards[j].lock);
+                UA_free(ns->shards[j].table);
+            }
+            UA_free(ns);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+    pthread_mutex_init(&ns->staticsLock, NULL);
+    return ns;
+}
+
+void UA_NodeStore_setServer(UA_NodeStore *ns, UA_Server *server) {
+    ns->server = server;
 }
 
-/* do not call with read-side critical section held!! */
+/* No readers may access the nodestore anymore */
 void UA_NodeStore_delete(UA_NodeStore *ns) {
-    UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
-    struct cds_lfht_iter iter;
-    cds_lfht_first(ht, &iter);
-    while(iter.node) {
-        if(!cds_lfht_del(ht, iter.node)) {
-            /* points to the htn entry, which is first */
-            struct nodeEntry *entry = (struct nodeEntry*) iter.node;
-            call_rcu(&entry->rcu_head, deleteEntry);
+    for(size_t i = 0; i < UA_NODESTORE_SHARDS; i++) {
+        UA_NodeStoreShard *shard = &ns->shards[i];
+        UA_NodeStoreTable *table = shard->table;
+        for(UA_UInt32 j = 0; j < table->size; j++) {
+            if(table->slots[j].entry && table->slots[j].entry != UA_NODESTORE_TOMBSTONE)
+                deleteEntry(table->slots[j].entry);
         }
-        cds_lfht_next(ht, &iter);
+        UA_free(table);
+        pthread_mutex_destroy(&shard->lock);
     }
-    cds_lfht_destroy(ht, NULL);
+    pthread_mutex_destroy(&ns->staticsLock);
+    UA_free(ns->statics);
     UA_free(ns);
 }
 
@@ -94,135 +365,318 @@ UA_Node * UA_NodeStore_newNode(UA_NodeClass class) {
 }
 
 void UA_NodeStore_deleteNode(UA_Node *node) {
-    struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    deleteEntry(&entry->rcu_head);
+    deleteEntry(container_of(node, struct nodeEntry, node));
 }
 
 UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
-    UA_ASSERT_RCU_LOCKED();
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
-    cds_lfht_node_init(&entry->htn);
-    struct cds_lfht_node *result;
+    UA_Node_sortReferences(node);
+    UA_Node_internStrings(node);
     //namespace index is assumed to be valid
     UA_NodeId tempNodeid;
     tempNodeid = node->nodeId;
     tempNodeid.namespaceIndex = 0;
+    UA_StatusCode retval;
     if(!UA_NodeId_isNull(&tempNodeid)) {
-        hash_t h = hash(&node->nodeId);
-        result = cds_lfht_add_unique(ht, h, compare, &node->nodeId, &entry->htn);
-        /* If the nodeid exists already */
-        if(result != &entry->htn) {
-            deleteEntry(&entry->rcu_head);
-            return UA_STATUSCODE_BADNODEIDEXISTS;
-        }
+        retval = insertEntry(ns, entry);
     } else {
         /* create a unique nodeid */
         node->nodeId.identifierType = UA_NODEIDTYPE_NUMERIC;
         if(node->nodeId.namespaceIndex == 0) // original request for ns=0 should yield ns=1
             node->nodeId.namespaceIndex = 1;
+        do {
+            node->nodeId.identifier.numeric = uatomic_add_return(&ns->nextIdentifier, 1);
+            retval = insertEntry(ns, entry);
+        } while(retval == UA_STATUSCODE_BADNODEIDEXISTS);
+    }
+    if(retval != UA_STATUSCODE_GOOD)
+        deleteEntry(entry);
+    return retval;
+}
 
-        unsigned long identifier;
-        long before, after;
-        cds_lfht_count_nodes(ht, &before, &identifier, &after); // current number of nodes stored
-        identifier++;
-
-        node->nodeId.identifier.numeric = (UA_UInt32)identifier;
-        while(true) {
-            hash_t h = hash(&node->nodeId);
-            result = cds_lfht_add_unique(ht, h, compare, &node->nodeId, &entry->htn);
-            if(result == &entry->htn)
-                break;
-            node->nodeId.identifier.numeric += (UA_UInt32)(identifier * 2654435761);
-        }
+UA_StatusCode UA_NodeStore_reserve(UA_NodeStore *ns, size_t count) {
+    /* The hash distributes the nodes evenly over the shards. Some headroom is
+       added for the variance. */
+    size_t perShard = count / UA_NODESTORE_SHARDS;
+    perShard += perShard / 8 + 1;
+    if(perShard > (size_t)(UA_UINT32_MAX / 8))
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < UA_NODESTORE_SHARDS && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_NodeStoreShard *shard = &ns->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        UA_UInt32 target = shard->count + (UA_UInt32)perShard;
+        if((target + 1) * 4 > shard->table->size * 3)
+            retval = resizeShard(ns, shard, target);
+        pthread_mutex_unlock(&shard->lock);
     }
-    return UA_STATUSCODE_GOOD;
+    return retval;
 }
 
-UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
-    UA_ASSERT_RCU_LOCKED();
-    struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+/* The value was swapped in place since the copy was made. Call with the lock
+   held. */
+static UA_Boolean valueSwapped(const UA_Node *node, const UA_Node *copy) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE && node->nodeClass != UA_NODECLASS_VARIABLETYPE)
+        return false;
+    return ((const UA_VariableNode*)node)->valueSeq != ((const UA_VariableNode*)copy)->valueSeq;
+}
 
-    /* Get the current version */
-    hash_t h = hash(&node->nodeId);
-    struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, &node->nodeId, &iter);
-    if(!iter.node)
+/* Call with the lock of the shard held. The replaced static node is hidden.
+   The new version is stored on the heap. */
+static UA_StatusCode
+replaceStatic(UA_NodeStore *ns, UA_NodeStoreShard *shard, hash_t h, struct nodeEntry *entry) {
+    const UA_StaticNodeTable *table = NULL;
+    size_t index = 0;
+    const UA_Node *node = findStatic(ns, &entry->node.nodeId, &table, &index);
+    if(!node)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if(entry->orig != UA_NODESTORE_STATICORIG || valueSwapped(node, &entry->node))
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_StatusCode retval = publishNewEntry(ns, shard, h, entry);
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_StaticNodeTable_hide(table, index);
+    return retval;
+}
 
+UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
+    struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
+    hash_t h = hash(&node->nodeId);
+    UA_NodeStoreShard *shard = getShard(ns, h);
+    UA_Node_sortReferences(node);
+    UA_Node_internStrings(node);
+    pthread_mutex_lock(&shard->lock);
+    UA_NodeStoreSlot *slot = findSlot(shard->table, &node->nodeId, h);
+    if(!slot) {
+        UA_StatusCode retval = replaceStatic(ns, shard, h, entry);
+        pthread_mutex_unlock(&shard->lock);
+        if(retval != UA_STATUSCODE_GOOD)
+            deleteEntry(entry);
+        return retval;
+    }
     /* We try to replace an obsolete version of the node */
-    struct nodeEntry *oldEntry = (struct nodeEntry*)iter.node;
-    if(oldEntry != entry->orig)
-        return UA_STATUSCODE_BADINTERNALERROR;
-    
-    cds_lfht_node_init(&entry->htn);
-    if(cds_lfht_replace(ht, &iter, h, compare, &node->nodeId, &entry->htn) != 0) {
-        /* Replacing failed. Maybe the node got replaced just before this thread tried to.*/
-        deleteEntry(&entry->rcu_head);
+    struct nodeEntry *oldEntry = slot->entry;
+    if(oldEntry != entry->orig || valueSwapped(&oldEntry->node, node)) {
+        pthread_mutex_unlock(&shard->lock);
+        deleteEntry(entry);
         return UA_STATUSCODE_BADINTERNALERROR;
     }
-        
-    /* If an entry got replaced, mark it as dead. */
-    call_rcu(&oldEntry->rcu_head, deleteEntry);
+    cmm_smp_mb();
+    uatomic_set(&slot->entry, entry);
+    pthread_mutex_unlock(&shard->lock);
+    retireEntry(ns, oldEntry);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_NodeStore_editValue(UA_NodeStore *ns, const UA_NodeId *nodeid,
+                       UA_NodeStore_valueEditor editor, void *data) {
+    /* The cell for the old value is allocated before anything is changed */
+    RetiredValue *old = UA_calloc(1, sizeof(RetiredValue));
+    if(!old)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    hash_t h = hash(nodeid);
+    UA_NodeStoreShard *shard = getShard(ns, h);
+    pthread_mutex_lock(&shard->lock);
+    UA_NodeStoreSlot *slot = findSlot(shard->table, nodeid, h);
+    UA_StatusCode retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    if(!slot) {
+        /* Static values cannot be swapped in place */
+        const UA_StaticNodeTable *table = NULL;
+        size_t index = 0;
+        const UA_Node *snode = findStatic(ns, nodeid, &table, &index);
+        if(snode && snode->nodeClass != UA_NODECLASS_VARIABLE &&
+           snode->nodeClass != UA_NODECLASS_VARIABLETYPE)
+            retval = UA_STATUSCODE_BADNODECLASSINVALID;
+        else if(snode && !(slot = materializeStatic(ns, shard, h, table, index)))
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(!slot) {
+        pthread_mutex_unlock(&shard->lock);
+        UA_free(old);
+        return retval;
+    }
+    UA_VariableNode *node = (UA_VariableNode*)&slot->entry->node;
+    retval = UA_STATUSCODE_BADNODECLASSINVALID;
+    if(node->nodeClass == UA_NODECLASS_VARIABLE || node->nodeClass == UA_NODECLASS_VARIABLETYPE) {
+        UA_Variant value;
+        UA_Variant_init(&value);
+        UA_ValueChunks *chunks = NULL;
+        retval = editor(node, &value, &chunks, data);
+        if(retval == UA_STATUSCODE_GOOD) {
+            /* Readers retry while the sequence number is odd or has changed */
+            old->value = node->value.variant.value;
+            old->chunks = node->valueChunks;
+            uatomic_inc(&node->valueSeq);
+            cmm_smp_mb();
+            node->value.variant.value = value;
+            node->valueChunks = chunks;
+            cmm_smp_mb();
+            uatomic_inc(&node->valueSeq);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(old);
+        return retval;
+    }
+    retireValue(ns, old);
     return UA_STATUSCODE_GOOD;
 }
 
+UA_UInt32 UA_NodeStore_hash(const UA_NodeId *nodeid) {
+    return hash(nodeid);
+}
+
 UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     hash_t h = hash(nodeid);
-    struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
-    if(!iter.node || cds_lfht_del(ht, iter.node) != 0)
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    struct nodeEntry *entry = (struct nodeEntry*)iter.node;
-    call_rcu(&entry->rcu_head, deleteEntry);
+    UA_NodeStoreShard *shard = getShard(ns, h);
+    pthread_mutex_lock(&shard->lock);
+    UA_NodeStoreSlot *slot = findSlot(shard->table, nodeid, h);
+    if(!slot) {
+        const UA_StaticNodeTable *table = NULL;
+        size_t index = 0;
+        UA_StatusCode retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
+        if(findStatic(ns, nodeid, &table, &index)) {
+            UA_StaticNodeTable_hide(table, index);
+            retval = UA_STATUSCODE_GOOD;
+        }
+        pthread_mutex_unlock(&shard->lock);
+        return retval;
+    }
+    struct nodeEntry *entry = slot->entry;
+    uatomic_set(&slot->entry, UA_NODESTORE_TOMBSTONE);
+    shard->count--;
+    /* Downsize the table if it is very empty. If this fails, we just continue
+       with the bigger table. */
+    if(shard->count * 8 < shard->table->size && shard->table->size > UA_NODESTORE_MINSIZE)
+        resizeShard(ns, shard, shard->count);
+    pthread_mutex_unlock(&shard->lock);
+    retireEntry(ns, entry);
     return UA_STATUSCODE_GOOD;
 }
 
-const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
+/* Returns the entry on the heap, UA_NODESTORE_STATICORIG for a static node
+   or NULL */
+static struct nodeEntry *
+getEntry(UA_NodeStore *ns, const UA_NodeId *nodeid, const UA_Node **node) {
     hash_t h = hash(nodeid);
-    struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
-    struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
-    if(!found_entry)
+    UA_NodeStoreTable *table = uatomic_read(&getShard(ns, h)->table);
+    UA_NodeStoreSlot *slot = findSlot(table, nodeid, h);
+    if(!slot) {
+        *node = findStatic(ns, nodeid, NULL, NULL);
+        return *node ? UA_NODESTORE_STATICORIG : NULL;
+    }
+    struct nodeEntry *entry = uatomic_read(&slot->entry);
+    if(entry == UA_NODESTORE_TOMBSTONE)
+        return NULL; /* removed in the meantime */
+    *node = &entry->node;
+    return entry;
+}
+
+const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    const UA_Node *node;
+    if(!getEntry(ns, nodeid, &node))
         return NULL;
-    return &found_entry->node;
+    return node;
 }
 
 UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
-    hash_t h = hash(nodeid);
-    struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
-    struct nodeEntry *entry = (struct nodeEntry*)iter.node;
+    const UA_Node *node;
+    struct nodeEntry *entry = getEntry(ns, nodeid, &node);
     if(!entry)
         return NULL;
-    struct nodeEntry *new = instantiateEntry(entry->node.nodeClass);
+    struct nodeEntry *new = instantiateEntry(node->nodeClass);
     if(!new)
         return NULL;
-    if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
-        deleteEntry(&new->rcu_head);
+    if(UA_Node_copyAnyNodeClass(node, &new->node) != UA_STATUSCODE_GOOD) {
+        deleteEntry(new);
         return NULL;
     }
     new->orig = entry;
     return &new->node;
 }
 
-void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
-    UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
-    struct cds_lfht_iter iter;
-    cds_lfht_first(ht, &iter);
-    while(iter.node != NULL) {
-        struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
-        visitor(&found_entry->node);
-        cds_lfht_next(ht, &iter);
+void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor, void *handle) {
+    UA_NodeStore_iteratePartition(ns, 0, 1, visitor, handle);
+}
+
+/* Partitions take whole shards as long as there are more shards than
+ * partitions. Otherwise, the table of every shard is split as well. */
+void UA_NodeStore_iteratePartition(UA_NodeStore *ns, size_t partition, size_t partitions,
+                                   UA_NodeStore_nodeVisitor visitor, void *handle) {
+    size_t begin, end;
+    for(size_t i = 0; i < UA_NODESTORE_SHARDS; i++) {
+        UA_NodeStoreTable *table = uatomic_read(&ns->shards[i].table);
+        /* The partitions that visit the shard */
+        size_t first, last;
+        partitionRange(partitions, i, UA_NODESTORE_SHARDS, &first, &last);
+        if(last == first)
+            last = first + 1;
+        if(partition < first || partition >= last)
+            continue;
+        partitionRange(table->size, partition - first, last - first, &begin, &end);
+        for(size_t j = begin; j < end; j++) {
+            struct nodeEntry *entry = uatomic_read(&table->slots[j].entry);
+            if(entry && entry != UA_NODESTORE_TOMBSTONE)
+                visitor(handle, &entry->node);
+        }
+    }
+    size_t staticsSize;
+    const UA_StaticNodeTable **statics = loadStatics(ns, &staticsSize);
+    for(size_t i = 0; i < staticsSize; i++) {
+        const UA_StaticNodeTable *table = statics[i];
+        partitionRange(table->nodesSize, partition, partitions, &begin, &end);
+        for(size_t j = begin; j < end; j++) {
+            if(!UA_StaticNodeTable_isHidden(table, j))
+                visitor(handle, table->nodes[j]);
+        }
+    }
+}
+
+UA_Boolean UA_NodeStore_isStatic(UA_NodeStore *ns, const UA_Node *node) {
+    size_t staticsSize;
+    const UA_StaticNodeTable **statics = loadStatics(ns, &staticsSize);
+    for(size_t i = 0; i < staticsSize; i++) {
+        const UA_StaticNodeTable *table = statics[i];
+        size_t j = UA_StaticNodeTable_find(table, &node->nodeId);
+        if(j < table->nodesSize && table->nodes[j] == node)
+            return true;
     }
+    return false;
+}
+
+UA_StatusCode
+UA_NodeStore_addStaticNodes(UA_NodeStore *ns, const UA_StaticNodeTable *table) {
+    if(UA_StaticNodeTable_check(table) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    pthread_mutex_lock(&ns->staticsLock);
+    for(size_t i = 0; i < table->nodesSize; i++) {
+        if(UA_NodeStore_get(ns, &table->nodes[i]->nodeId)) {
+            pthread_mutex_unlock(&ns->staticsLock);
+            return UA_STATUSCODE_BADNODEIDEXISTS;
+        }
+    }
+
+    /* Readers may still iterate over the old array */
+    size_t size = ns->staticsSize;
+    const UA_StaticNodeTable **statics = UA_malloc((size + 1) * sizeof(UA_StaticNodeTable*));
+    if(!statics) {
+        pthread_mutex_unlock(&ns->staticsLock);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(size > 0)
+        memcpy(statics, ns->statics, size * sizeof(UA_StaticNodeTable*));
+    memset(table->hidden, 0, (table->nodesSize + 7) / 8);
+    statics[size] = table;
+    const UA_StaticNodeTable **old = ns->statics;
+    cmm_smp_mb();
+    uatomic_set(&ns->statics, statics);
+    cmm_smp_mb(); // the new array is published before its size
+    uatomic_set(&ns->staticsSize, size + 1);
+    pthread_mutex_unlock(&ns->staticsLock);
+    if(old)
+        retireMemory(ns, (void*)old);
+    return UA_STATUSCODE_GOOD;
 }
 
 #endif /* UA_ENABLE_MULTITHREADING */
@@ -0,0 +1,54 @@
+#include "ua_nodestore.h"
+#include "ua_util.h"
+
+UA_StatusCode UA_StaticNodeTable_check(const UA_StaticNodeTable *table) {
+    for(size_t i = 0; i < table->nodesSize; i++) {
+        const UA_Node *node = table->nodes[i];
+        if(i > 0 && UA_NodeId_order(&table->nodes[i-1]->nodeId, &node->nodeId) >= 0)
+            return UA_STATUSCODE_BADINVALIDARGUMENT;
+        for(size_t j = 1; j < node->referencesSize; j++) {
+            if(UA_ReferenceNode_order(&node->references[j-1], &node->references[j]) > 0)
+                return UA_STATUSCODE_BADINVALIDARGUMENT;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+size_t UA_StaticNodeTable_find(const UA_StaticNodeTable *table, const UA_NodeId *nodeid) {
+    size_t low = 0;
+    size_t high = table->nodesSize;
+    while(low < high) {
+        size_t mid = low + ((high - low) / 2);
+        UA_Int32 order = UA_NodeId_order(&table->nodes[mid]->nodeId, nodeid);
+        if(order == 0)
+            return mid;
+        if(order < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return table->nodesSize;
+}
+
+UA_Boolean UA_StaticNodeTable_isHidden(const UA_StaticNodeTable *table, size_t index) {
+    UA_Byte mask = (UA_Byte)(1 << (index % 8));
+#ifdef UA_ENABLE_MULTITHREADING
+    return (uatomic_read(&table->hidden[index / 8]) & mask) != 0;
+#else
+    return (table->hidden[index / 8] & mask) != 0;
+#endif
+}
+
+void UA_StaticNodeTable_hide(const UA_StaticNodeTable *table, size_t index) {
+    UA_Byte *bits = &table->hidden[index / 8];
+    UA_Byte mask = (UA_Byte)(1 << (index % 8));
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Neighbouring nodes can be hidden under the locks of other shards */
+    UA_Byte old = uatomic_read(bits);
+    UA_Byte seen;
+    while((seen = uatomic_cmpxchg(bits, old, (UA_Byte)(old | mask))) != old)
+        old = seen;
+#else
+    *bits |= mask;
+#endif
+}
@@ -5,60 +5,131 @@
 #define STARTCHANNELID 1
 #define STARTTOKENID 1
 
+#ifdef UA_ENABLE_MULTITHREADING
+# define CM_LOCK(cm) pthread_mutex_lock(&(cm)->lock)
+# define CM_UNLOCK(cm) pthread_mutex_unlock(&(cm)->lock)
+#else
+# define CM_LOCK(cm)
+# define CM_UNLOCK(cm)
+#endif
+
 UA_StatusCode
 UA_SecureChannelManager_init(UA_SecureChannelManager *cm, UA_Server *server) {
-    LIST_INIT(&cm->channels);
+    UA_TimeoutIndex_init(&cm->channels);
+    LIST_INIT(&cm->renewed);
     cm->lastChannelId = STARTCHANNELID;
     cm->lastTokenId = STARTTOKENID;
-    cm->currentChannelCount = 0;
     cm->server = server;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&cm->lock, NULL);
+#endif
     return UA_STATUSCODE_GOOD;
 }
 
+static channel_list_entry * channelAt(UA_SecureChannelManager *cm, size_t i) {
+    return container_of(cm->channels.heap[i], channel_list_entry, timeoutEntry);
+}
+
 void UA_SecureChannelManager_deleteMembers(UA_SecureChannelManager *cm) {
-    channel_list_entry *entry, *temp;
-    LIST_FOREACH_SAFE(entry, &cm->channels, pointers, temp) {
-        LIST_REMOVE(entry, pointers);
+    for(size_t i = 0; i < cm->channels.size; i++) {
+        channel_list_entry *entry = channelAt(cm, i);
         UA_SecureChannel_deleteMembersCleanup(&entry->channel);
-        UA_free(entry);
+        UA_objfree(entry);
     }
+    UA_TimeoutIndex_deleteMembers(&cm->channels);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&cm->lock);
+#endif
+}
+
+/*********/
+/* Index */
+/*********/
+
+static channel_list_entry *
+findChannel(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
+    struct UA_TimeoutBucket *bucket = UA_TimeoutIndex_bucket(&cm->channels, channelId);
+    if(!bucket)
+        return NULL;
+    UA_TimeoutEntry *te;
+    LIST_FOREACH(te, bucket, pointers) {
+        channel_list_entry *entry = container_of(te, channel_list_entry, timeoutEntry);
+        if(entry->channel.securityToken.channelId == channelId)
+            return entry;
+    }
+    return NULL;
 }
 
+static UA_DateTime tokenTimeout(const UA_ChannelSecurityToken *token) {
+    return token->createdAt + (UA_DateTime)(token->revisedLifetime * UA_MSEC_TO_DATETIME);
+}
+
+/************/
+/* Channels */
+/************/
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void freeChannelEntry(UA_Server *server, void *entry) {
+    UA_objfree(entry);
+}
+#endif
+
+/* Call with the lock held */
 static void removeSecureChannel(UA_SecureChannelManager *cm, channel_list_entry *entry){
-    LIST_REMOVE(entry, pointers);
+    UA_TimeoutIndex_remove(&cm->channels, &entry->timeoutEntry);
+    if(entry->renewed)
+        LIST_REMOVE(entry, renewedPointers);
     UA_SecureChannel_deleteMembersCleanup(&entry->channel);
 #ifndef UA_ENABLE_MULTITHREADING
-    cm->currentChannelCount--;
-    UA_free(entry);
+    UA_objfree(entry);
 #else
-    cm->currentChannelCount = uatomic_add_return(&cm->currentChannelCount, -1);
-    UA_Server_delayedFree(cm->server, entry);
+    UA_Server_delayedCallback(cm->server, freeChannelEntry, entry);
 #endif
 }
+
 /* remove channels that were not renewed or who have no connection attached */
 void UA_SecureChannelManager_cleanupTimedOut(UA_SecureChannelManager *cm, UA_DateTime now) {
+    CM_LOCK(cm);
+
+    /* Move to the next security token */
     channel_list_entry *entry, *temp;
-    LIST_FOREACH_SAFE(entry, &cm->channels, pointers, temp) {
-        UA_DateTime timeout =
-            entry->channel.securityToken.createdAt +
-            (UA_DateTime)(entry->channel.securityToken.revisedLifetime * UA_MSEC_TO_DATETIME);
-        if(timeout < now || !entry->channel.connection) {
-            UA_LOG_DEBUG_CHANNEL(cm->server->config.logger, (&entry->channel), "SecureChannel has timed out");
-            removeSecureChannel(cm, entry);
-        } else if(entry->channel.nextSecurityToken.tokenId > 0) {
-            UA_SecureChannel_revolveTokens(&entry->channel);
+    LIST_FOREACH_SAFE(entry, &cm->renewed, renewedPointers, temp) {
+        LIST_REMOVE(entry, renewedPointers);
+        entry->renewed = false;
+        UA_SecureChannel_revolveTokens(&entry->channel);
+        if(entry->timeoutEntry.timeout != 0) {
+            entry->timeoutEntry.timeout = tokenTimeout(&entry->channel.securityToken);
+            UA_TimeoutIndex_update(&cm->channels, &entry->timeoutEntry);
+        }
+    }
+
+    /* Remove the channels with the earliest timeout */
+    UA_TimeoutEntry *first;
+    while((first = UA_TimeoutIndex_first(&cm->channels))) {
+        entry = container_of(first, channel_list_entry, timeoutEntry);
+        if(entry->channel.connection) {
+            /* The token can have been revolved when a message arrived */
+            first->timeout = tokenTimeout(&entry->channel.securityToken);
+            if(first->timeout >= now) {
+                UA_TimeoutIndex_update(&cm->channels, first);
+                if(UA_TimeoutIndex_first(&cm->channels) == first)
+                    break;
+                continue;
+            }
         }
+        UA_LOG_DEBUG_CHANNEL(cm->server->config.logger, (&entry->channel), "SecureChannel has timed out");
+        removeSecureChannel(cm, entry);
     }
+    CM_UNLOCK(cm);
 }
 
-/* remove the first channel that has no session attached */
+/* remove the channel without a session that expires first */
 static UA_Boolean purgeFirstChannelWithoutSession(UA_SecureChannelManager *cm) {
-    channel_list_entry *entry;
-    LIST_FOREACH(entry, &cm->channels, pointers) {
+    for(size_t i = 0; i < cm->channels.size; i++) {
+        channel_list_entry *entry = channelAt(cm, i);
         if(LIST_EMPTY(&(entry->channel.sessions))){
             UA_LOG_DEBUG_CHANNEL(cm->server->config.logger, (&entry->channel), "Channel was purged since maxSecureChannels was reached and channel had no session attached");
             removeSecureChannel(cm, entry);
-            UA_assert(entry != LIST_FIRST(&cm->channels));
             return true;
         }
     }
@@ -71,28 +142,26 @@ UA_SecureChannelManager_open(UA_SecureChannelManager *cm, UA_Connection *conn,
                              UA_OpenSecureChannelResponse *response) {
     if(request->securityMode != UA_MESSAGESECURITYMODE_NONE)
         return UA_STATUSCODE_BADSECURITYMODEREJECTED;
+    channel_list_entry *entry = UA_objalloc(UA_MEMCATEGORY_NETWORK, sizeof(channel_list_entry));
+    if(!entry)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    CM_LOCK(cm);
     //check if there exists a free SC, otherwise try to purge one SC without a session
     //the purge has been introduced to pass CTT, it is not clear what strategy is expected here
-    if(cm->currentChannelCount >= cm->server->config.maxSecureChannels && !purgeFirstChannelWithoutSession(cm)){
+    if(cm->channels.size >= cm->server->config.maxSecureChannels && !purgeFirstChannelWithoutSession(cm)){
+        CM_UNLOCK(cm);
+        UA_objfree(entry);
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
-    channel_list_entry *entry = UA_malloc(sizeof(channel_list_entry));
-    if(!entry)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-#ifndef UA_ENABLE_MULTITHREADING
-    cm->currentChannelCount++;
-#else
-    cm->currentChannelCount = uatomic_add_return(&cm->currentChannelCount, 1);
-#endif
-
     UA_SecureChannel_init(&entry->channel);
     response->responseHeader.stringTableSize = 0;
-    response->responseHeader.timestamp = UA_DateTime_now();
+    response->responseHeader.timestamp = UA_Server_now(cm->server);
     response->serverProtocolVersion = 0;
 
     entry->channel.securityToken.channelId = cm->lastChannelId++;
     entry->channel.securityToken.tokenId = cm->lastTokenId++;
-    entry->channel.securityToken.createdAt = UA_DateTime_now();
+    entry->channel.securityToken.createdAt = UA_Server_now(cm->server);
     entry->channel.securityToken.revisedLifetime =
         (request->requestedLifetime > cm->server->config.maxSecurityTokenLifetime) ?
         cm->server->config.maxSecurityTokenLifetime : request->requestedLifetime;
@@ -109,8 +178,17 @@ UA_SecureChannelManager_open(UA_SecureChannelManager *cm, UA_Connection *conn,
     UA_ChannelSecurityToken_copy(&entry->channel.securityToken,
             &response->securityToken);
 
+    entry->renewed = false;
+    entry->timeoutEntry.hash = entry->channel.securityToken.channelId;
+    entry->timeoutEntry.timeout = tokenTimeout(&entry->channel.securityToken);
+    if(UA_TimeoutIndex_insert(&cm->channels, &entry->timeoutEntry) != UA_STATUSCODE_GOOD) {
+        CM_UNLOCK(cm);
+        UA_SecureChannel_deleteMembersCleanup(&entry->channel);
+        UA_objfree(entry);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
     UA_Connection_attachSecureChannel(conn, &entry->channel);
-    LIST_INSERT_HEAD(&cm->channels, entry, pointers);
+    CM_UNLOCK(cm);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -126,13 +204,22 @@ UA_SecureChannelManager_renew(UA_SecureChannelManager *cm, UA_Connection *conn,
     if(channel->nextSecurityToken.tokenId == 0) {
         channel->nextSecurityToken.channelId = channel->securityToken.channelId;
         channel->nextSecurityToken.tokenId = cm->lastTokenId++;
-        channel->nextSecurityToken.createdAt = UA_DateTime_now();
+        channel->nextSecurityToken.createdAt = UA_Server_now(cm->server);
         channel->nextSecurityToken.revisedLifetime =
             (request->requestedLifetime > cm->server->config.maxSecurityTokenLifetime) ?
             cm->server->config.maxSecurityTokenLifetime : request->requestedLifetime;
         /* lifetime 0 -> return the max lifetime */
         if(channel->nextSecurityToken.revisedLifetime == 0)
             channel->nextSecurityToken.revisedLifetime = cm->server->config.maxSecurityTokenLifetime;
+
+        /* The next token is taken over during the next cleanup */
+        CM_LOCK(cm);
+        channel_list_entry *entry = (channel_list_entry*)channel;
+        if(!entry->renewed) {
+            entry->renewed = true;
+            LIST_INSERT_HEAD(&cm->renewed, entry, renewedPointers);
+        }
+        CM_UNLOCK(cm);
     }
 
     if(channel->clientNonce.data)
@@ -145,31 +232,32 @@ UA_SecureChannelManager_renew(UA_SecureChannelManager *cm, UA_Connection *conn,
 }
 
 UA_SecureChannel * UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
-    channel_list_entry *entry;
-    LIST_FOREACH(entry, &cm->channels, pointers) {
-        if(entry->channel.securityToken.channelId == channelId)
-            return &entry->channel;
-    }
-    return NULL;
+    CM_LOCK(cm);
+    channel_list_entry *entry = findChannel(cm, channelId);
+    CM_UNLOCK(cm);
+    if(!entry)
+        return NULL;
+    return &entry->channel;
 }
 
 UA_StatusCode UA_SecureChannelManager_close(UA_SecureChannelManager *cm, UA_UInt32 channelId) {
-    channel_list_entry *entry;
-    LIST_FOREACH(entry, &cm->channels, pointers) {
-        if(entry->channel.securityToken.channelId == channelId)
-            break;
-    }
+    CM_LOCK(cm);
+    channel_list_entry *entry = findChannel(cm, channelId);
+    if(entry)
+        removeSecureChannel(cm, entry);
+    CM_UNLOCK(cm);
     if(!entry)
         return UA_STATUSCODE_BADINTERNALERROR;
-
-    LIST_REMOVE(entry, pointers);
-    UA_SecureChannel_deleteMembersCleanup(&entry->channel);
-#ifndef UA_ENABLE_MULTITHREADING
-    cm->currentChannelCount--;
-    UA_free(entry);
-#else
-    cm->currentChannelCount = uatomic_add_return(&cm->currentChannelCount, -1);
-    UA_Server_delayedFree(cm->server, entry);
-#endif
     return UA_STATUSCODE_GOOD;
 }
+
+void
+UA_SecureChannelManager_detached(UA_SecureChannelManager *cm, UA_SecureChannel *channel) {
+    CM_LOCK(cm);
+    channel_list_entry *entry = findChannel(cm, channel->securityToken.channelId);
+    if(entry == (channel_list_entry*)channel) {
+        entry->timeoutEntry.timeout = 0;
+        UA_TimeoutIndex_update(&cm->channels, &entry->timeoutEntry);
+    }
+    CM_UNLOCK(cm);
+}
@@ -5,18 +5,32 @@
 #include "ua_server.h"
 #include "ua_securechannel.h"
 #include "queue.h"
+#include "ua_timeout_index.h"
+
+/**
+ * The channels are kept in a timeout index with their channelId as the hash.
+ * The channelIds are handed out sequentially, so that the lower bits
+ * distribute well. The timeout is the expiry of the current security token.
+ */
 
 typedef struct channel_list_entry {
     UA_SecureChannel channel;
-    LIST_ENTRY(channel_list_entry) pointers;
+    UA_TimeoutEntry timeoutEntry; ///> The current security token expires
+    LIST_ENTRY(channel_list_entry) renewedPointers; ///> Entry in the list of renewed channels
+    UA_Boolean renewed; ///> A next security token was issued
 } channel_list_entry;
 
+LIST_HEAD(channel_list, channel_list_entry);
+
 typedef struct UA_SecureChannelManager {
-    LIST_HEAD(channel_list, channel_list_entry) channels; // doubly-linked list of channels
-    size_t currentChannelCount;
+    UA_TimeoutIndex channels;
+    struct channel_list renewed; // channels with a next security token
     UA_UInt32 lastChannelId;
     UA_UInt32 lastTokenId;
     UA_Server *server;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock;
+#endif
 } UA_SecureChannelManager;
 
 UA_StatusCode
@@ -42,4 +56,9 @@ UA_SecureChannelManager_get(UA_SecureChannelManager *cm, UA_UInt32 channelId);
 UA_StatusCode
 UA_SecureChannelManager_close(UA_SecureChannelManager *cm, UA_UInt32 channelId);
 
+/* The connection of the channel was closed. The channel is removed during the
+   next cleanup. */
+void
+UA_SecureChannelManager_detached(UA_SecureChannelManager *cm, UA_SecureChannel *channel);
+
 #endif /* UA_CHANNEL_MANAGER_H_ */
@@ -48,6 +48,18 @@ static const UA_NodeId nodeIdNonHierarchicalReferences = {
 /* Namespace Handling */
 /**********************/
 
+/* The NamespaceArray is read as a shared value. A read adds a reference
+ * instead of copying the strings. */
+void UA_Server_updateNamespacesValue(UA_Server *server) {
+    UA_Variant_deleteMembers(&server->namespacesValue);
+    UA_StatusCode retval = UA_Variant_setArrayCopy(&server->namespacesValue, server->namespaces,
+                                                   server->namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_Variant_share(&server->namespacesValue);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_Variant_deleteMembers(&server->namespacesValue); /* copied for every read */
+}
+
 static UA_UInt16 addNamespaceInternal(UA_Server *server, const UA_String *name) {
     //check if the namespace already exists in the server's namespace array
     for(UA_UInt16 i=0;i<server->namespacesSize;i++) {
@@ -59,11 +71,12 @@ static UA_UInt16 addNamespaceInternal(UA_Server *server, const UA_String *name)
         sizeof(UA_String) * (server->namespacesSize + 1));
     UA_String_copy(name, &(server->namespaces[server->namespacesSize]));
     server->namespacesSize++;
+    UA_Server_updateNamespacesValue(server);
     return (UA_UInt16)(server->namespacesSize - 1);
 }
 
 UA_UInt16 UA_Server_addNamespace(UA_Server *server, const char* name) {
-    UA_String nameString = UA_STRING_ALLOC(name);
+    UA_String nameString = UA_STRING((char*)(uintptr_t)name);
     return addNamespaceInternal(server, &nameString);
 }
 
@@ -86,6 +99,9 @@ static void UA_Server_deleteExternalNamespaces(UA_Server *server) {
         server->externalNamespaces = NULL;
         server->externalNamespacesSize = 0;
     }
+    UA_free(server->externalNamespaceTable);
+    server->externalNamespaceTable = NULL;
+    server->externalNamespaceTableSize = 0;
 }
 
 UA_StatusCode UA_EXPORT
@@ -94,16 +110,113 @@ UA_Server_addExternalNamespace(UA_Server *server, const UA_String *url,
     if(!nodeStore)
         return UA_STATUSCODE_BADARGUMENTSMISSING;
     size_t size = server->externalNamespacesSize;
-    server->externalNamespaces =
+    if(size >= UA_UINT16_MAX)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_UInt16 index = (UA_UInt16)server->namespacesSize;
+    UA_ExternalNamespace *ens =
         UA_realloc(server->externalNamespaces, sizeof(UA_ExternalNamespace) * (size + 1));
-    server->externalNamespaces[size].externalNodeStore = *nodeStore;
-    server->externalNamespaces[size].index = (UA_UInt16)server->namespacesSize;
-    *assignedNamespaceIndex = (UA_UInt16)server->namespacesSize;
-    UA_String_copy(url, &server->externalNamespaces[size].url);
+    if(!ens)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    server->externalNamespaces = ens;
+    UA_UInt16 *table = UA_realloc(server->externalNamespaceTable, sizeof(UA_UInt16) * (index + 1u));
+    if(!table)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = server->externalNamespaceTableSize; i < index; i++)
+        table[i] = 0;
+    table[index] = (UA_UInt16)(size + 1);
+    server->externalNamespaceTable = table;
+    server->externalNamespaceTableSize = index + 1u;
+
+    ens[size].externalNodeStore = *nodeStore;
+    ens[size].index = index;
+    *assignedNamespaceIndex = index;
+    UA_String_copy(url, &ens[size].url);
     server->externalNamespacesSize++;
     addNamespaceInternal(server, url);
     return UA_STATUSCODE_GOOD;
 }
+
+static UA_UInt16
+itemNamespace(const void *items, size_t i, size_t itemSize, size_t nodeIdOffset) {
+    const UA_NodeId *id = (const UA_NodeId*)((uintptr_t)items + (i * itemSize) + nodeIdOffset);
+    return id->namespaceIndex;
+}
+
+UA_StatusCode
+UA_ExternalRouting_init(UA_ExternalRouting *routing, const UA_Server *server,
+                        const void *items, size_t itemsSize, size_t itemSize,
+                        size_t nodeIdOffset) {
+    memset(routing, 0, sizeof(UA_ExternalRouting));
+    if(server->externalNamespacesSize == 0)
+        return UA_STATUSCODE_GOOD;
+
+    /* Count the items per external namespace */
+    size_t *counts = UA_calloc(server->externalNamespacesSize, sizeof(size_t));
+    if(!counts)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    size_t external = 0;
+    for(size_t i = 0; i < itemsSize; i++) {
+        UA_UInt16 ns = itemNamespace(items, i, itemSize, nodeIdOffset);
+        if(ns >= server->externalNamespaceTableSize || server->externalNamespaceTable[ns] == 0)
+            continue;
+        counts[server->externalNamespaceTable[ns] - 1]++;
+        external++;
+    }
+    if(external == 0) {
+        UA_free(counts);
+        return UA_STATUSCODE_GOOD;
+    }
+    for(size_t j = 0; j < server->externalNamespacesSize; j++) {
+        if(counts[j] > 0)
+            routing->routesSize++;
+    }
+
+    /* Cut the index arrays of the routes from one allocation */
+    routing->isExternal = UA_calloc(itemsSize, sizeof(UA_Boolean));
+    routing->indices = UA_malloc(sizeof(UA_UInt32) * external);
+    routing->routes = UA_malloc(sizeof(UA_ExternalRoute) * routing->routesSize);
+    /* The position of the route of every external namespace */
+    size_t *routeOf = UA_malloc(sizeof(size_t) * server->externalNamespacesSize);
+    if(!routing->isExternal || !routing->indices || !routing->routes || !routeOf) {
+        UA_free(counts);
+        UA_free(routeOf);
+        UA_ExternalRouting_deleteMembers(routing);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    size_t r = 0;
+    UA_UInt32 *indices = routing->indices;
+    for(size_t j = 0; j < server->externalNamespacesSize; j++) {
+        if(counts[j] == 0)
+            continue;
+        routeOf[j] = r;
+        routing->routes[r].ens = &server->externalNamespaces[j].externalNodeStore;
+        routing->routes[r].indices = indices;
+        routing->routes[r].indicesSize = 0;
+        indices = &indices[counts[j]];
+        r++;
+    }
+    UA_free(counts);
+
+    /* Fill the routes in the order of the items */
+    for(size_t i = 0; i < itemsSize; i++) {
+        UA_UInt16 ns = itemNamespace(items, i, itemSize, nodeIdOffset);
+        if(ns >= server->externalNamespaceTableSize || server->externalNamespaceTable[ns] == 0)
+            continue;
+        UA_ExternalRoute *route = &routing->routes[routeOf[server->externalNamespaceTable[ns] - 1]];
+        route->indices[route->indicesSize] = (UA_UInt32)i;
+        route->indicesSize++;
+        routing->isExternal[i] = true;
+    }
+    UA_free(routeOf);
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_ExternalRouting_deleteMembers(UA_ExternalRouting *routing) {
+    UA_free(routing->isExternal);
+    UA_free(routing->indices);
+    UA_free(routing->routes);
+    memset(routing, 0, sizeof(UA_ExternalRouting));
+}
 #endif /* UA_ENABLE_EXTERNAL_NAMESPACES*/
 
 UA_StatusCode
@@ -234,6 +347,18 @@ __UA_Server_addNode(UA_Server *server, const UA_NodeClass nodeClass,
     return result.statusCode;
 }
 
+UA_StatusCode
+UA_Server_addNodes(UA_Server *server, const UA_AddNodesItem *items, size_t itemsSize,
+                   UA_AddNodesResult **results) {
+    *results = UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_ADDNODESRESULT]);
+    if(!*results && itemsSize > 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_RCU_LOCK();
+    Service_AddNodes_batch(server, &adminSession, items, itemsSize, *results);
+    UA_RCU_UNLOCK();
+    return UA_STATUSCODE_GOOD;
+}
+
 /**********/
 /* Server */
 /**********/
@@ -242,6 +367,7 @@ __UA_Server_addNode(UA_Server *server, const UA_NodeClass nodeClass,
 void UA_Server_delete(UA_Server *server) {
     // Delete the timed work
     UA_Server_deleteAllRepeatedJobs(server);
+    UA_Server_deleteValuePublishers(server);
 
     // Delete all internal data
     UA_SecureChannelManager_deleteMembers(&server->secureChannelManager);
@@ -249,24 +375,43 @@ void UA_Server_delete(UA_Server *server) {
     UA_RCU_LOCK();
     UA_NodeStore_delete(server->nodestore);
     UA_RCU_UNLOCK();
+    UA_ReferenceTypeIndex_delete(server->referenceTypeIndex);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Free the nodes and sessions that were removed after the server loop
+       stopped or while it was never started */
+    UA_Server_reclaimDelayed(server);
+#endif
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     UA_Server_deleteExternalNamespaces(server);
 #endif
     UA_Array_delete(server->namespaces, server->namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+    UA_Variant_deleteMembers(&server->namespacesValue);
+    UA_Server_deleteDiscoveryCache(server);
     UA_Array_delete(server->endpointDescriptions, server->endpointDescriptionsSize,
                     &UA_TYPES[UA_TYPES_ENDPOINTDESCRIPTION]);
-
-#ifdef UA_ENABLE_MULTITHREADING
-    pthread_cond_destroy(&server->dispatchQueue_condition);
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    UA_free(server->serviceStatistics);
+#endif
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_Server_deleteSamplers(server);
+#endif
+#ifdef UA_ENABLE_HISTORIZING
+    UA_Server_deleteHistory(server);
 #endif
+#ifdef UA_ENABLE_NODE_STATISTICS
+    UA_Server_deleteNodeStatistics(server);
+#endif
+
+    /* Objects that are still in use remember their allocator */
+    if(server->config.allocator && UA_getAllocator() == server->config.allocator)
+        UA_setAllocator(NULL);
     UA_free(server);
 }
 
 /* Recurring cleanup. Removing unused and timed-out channels and sessions */
 static void UA_Server_cleanup(UA_Server *server, void *_) {
-    UA_DateTime now = UA_DateTime_now();
-    UA_SessionManager_cleanupTimedOut(&server->sessionManager, now);
-    UA_SecureChannelManager_cleanupTimedOut(&server->secureChannelManager, now);
+    UA_SessionManager_cleanupTimedOut(&server->sessionManager, server->now);
+    UA_SecureChannelManager_cleanupTimedOut(&server->secureChannelManager, server->now);
 }
 
 static UA_StatusCode
@@ -308,13 +453,10 @@ readServiceLevel(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStam
         return UA_STATUSCODE_GOOD;
     }
 
-    value->value.type = &UA_TYPES[UA_TYPES_BYTE];
-    value->value.arrayLength = 0;
-    UA_Byte *byte = UA_Byte_new();
-    *byte = 255;
-    value->value.data = byte;
-    value->value.arrayDimensionsSize = 0;
-    value->value.arrayDimensions = NULL;
+    /* The constant value is borrowed and not allocated for every read */
+    static UA_Byte serviceLevel = 255;
+    UA_Variant_setScalar(&value->value, &serviceLevel, &UA_TYPES[UA_TYPES_BYTE]);
+    value->value.storageType = UA_VARIANT_DATA_NODELETE;
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -333,13 +475,9 @@ readAuditing(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
         return UA_STATUSCODE_GOOD;
     }
 
-    value->value.type = &UA_TYPES[UA_TYPES_BOOLEAN];
-    value->value.arrayLength = 0;
-    UA_Boolean *boolean = UA_Boolean_new();
-    *boolean = false;
-    value->value.data = boolean;
-    value->value.arrayDimensionsSize = 0;
-    value->value.arrayDimensions = NULL;
+    static UA_Boolean auditing = false;
+    UA_Variant_setScalar(&value->value, &auditing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    value->value.storageType = UA_VARIANT_DATA_NODELETE;
     value->hasValue = true;
     if(sourceTimeStamp) {
         value->hasSourceTimestamp = true;
@@ -358,8 +496,11 @@ readNamespaces(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimestamp,
     }
     UA_Server *server = (UA_Server*)handle;
     UA_StatusCode retval;
-    retval = UA_Variant_setArrayCopy(&value->value, server->namespaces,
-                                     server->namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+    if(server->namespacesValue.data)
+        retval = UA_Variant_copy(&server->namespacesValue, &value->value);
+    else
+        retval = UA_Variant_setArrayCopy(&value->value, server->namespaces,
+                                         server->namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     value->hasValue = true;
@@ -390,6 +531,119 @@ readCurrentTime(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp
     return UA_STATUSCODE_GOOD;
 }
 
+static UA_StatusCode
+readSessionMemory(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+                  const UA_NumericRange *range, UA_DataValue *value) {
+    if(range) {
+        value->hasStatus = true;
+        value->status = UA_STATUSCODE_BADINDEXRANGEINVALID;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_SessionMemory memory;
+    UA_Server_getSessionMemory((UA_Server*)handle, NULL, &memory);
+    UA_UInt64 counters[6] = {memory.subscriptions, memory.samples, memory.retransmissions,
+                             memory.continuationPoints, memory.chunks, memory.discarded};
+    UA_StatusCode retval = UA_Variant_setArrayCopy(&value->value, counters, 6, &UA_TYPES[UA_TYPES_UINT64]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    value->hasValue = true;
+    if(sourceTimeStamp) {
+        value->hasSourceTimestamp = true;
+        value->sourceTimestamp = UA_DateTime_now();
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Not defined by the standard and added to the namespace of the server */
+static void addSessionMemoryNode(UA_Server *server) {
+    UA_VariableNode *counters = UA_NodeStore_newVariableNode();
+    counters->nodeId = UA_NODEID_STRING_ALLOC(1, "SessionMemory");
+    counters->browseName = UA_QUALIFIEDNAME_ALLOC(1, "SessionMemory");
+    counters->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "SessionMemory");
+    counters->description = UA_LOCALIZEDTEXT_ALLOC("en_US", "Bytes of subscriptions, samples, retransmissions, "
+                                                    "continuation points and chunks over all sessions, "
+                                                    "discarded items");
+    counters->valueRank = 1;
+    counters->valueSource = UA_VALUESOURCE_DATASOURCE;
+    counters->value.dataSource = (UA_DataSource) {.handle = server, .read = readSessionMemory,
+                                                  .write = NULL};
+    UA_AddNodesResult res = addNodeInternal(server, (UA_Node*)counters,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERDIAGNOSTICS),
+                                            nodeIdHasComponent);
+    addReferenceInternal(server, res.addedNodeId, nodeIdHasTypeDefinition,
+                         expandedNodeIdBaseDataVariabletype, true);
+    UA_AddNodesResult_deleteMembers(&res);
+}
+
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+static UA_StatusCode
+readServiceStatistics(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+                      const UA_NumericRange *range, UA_DataValue *value) {
+    if(range) {
+        value->hasStatus = true;
+        value->status = UA_STATUSCODE_BADINDEXRANGEINVALID;
+        return UA_STATUSCODE_GOOD;
+    }
+    const UA_ServiceStatistics *stats = (const UA_ServiceStatistics*)handle;
+    UA_UInt64 counters[7] = {stats->requests, stats->errors, stats->decodeTime, stats->executeTime,
+                             stats->encodeTime, stats->bytesIn, stats->bytesOut};
+    UA_StatusCode retval = UA_Variant_setArrayCopy(&value->value, counters, 7, &UA_TYPES[UA_TYPES_UINT64]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    value->hasValue = true;
+    if(sourceTimeStamp) {
+        value->hasSourceTimestamp = true;
+        value->sourceTimestamp = UA_DateTime_now();
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The statistics nodes are not defined by the standard and are added to the
+ * namespace of the server */
+static void addServiceStatisticsNodes(UA_Server *server) {
+    UA_ObjectNode *statistics = UA_NodeStore_newObjectNode();
+    statistics->nodeId = UA_NODEID_STRING_ALLOC(1, "ServiceStatistics");
+    statistics->browseName = UA_QUALIFIEDNAME_ALLOC(1, "ServiceStatistics");
+    statistics->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "ServiceStatistics");
+    statistics->description = UA_LOCALIZEDTEXT_ALLOC("en_US", "ServiceStatistics");
+    UA_AddNodesResult res = addNodeInternal(server, (UA_Node*)statistics,
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERDIAGNOSTICS),
+                                            nodeIdHasComponent);
+    addReferenceInternal(server, res.addedNodeId, nodeIdHasTypeDefinition,
+                         UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), true);
+
+    const UA_String prefix = UA_STRING("ServiceStatistics.");
+    for(size_t i = 0; i < UA_ServicesSize; i++) {
+        const char *name = UA_Services[i].name;
+        size_t nameLength = strlen(name);
+        UA_VariableNode *counters = UA_NodeStore_newVariableNode();
+        counters->nodeId.namespaceIndex = 1;
+        counters->nodeId.identifierType = UA_NODEIDTYPE_STRING;
+        UA_String *id = &counters->nodeId.identifier.string;
+        id->data = UA_malloc(prefix.length + nameLength);
+        if(id->data) {
+            memcpy(id->data, prefix.data, prefix.length);
+            memcpy(&id->data[prefix.length], name, nameLength);
+            id->length = prefix.length + nameLength;
+        }
+        counters->browseName = UA_QUALIFIEDNAME_ALLOC(1, name);
+        counters->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", name);
+        counters->description = UA_LOCALIZEDTEXT_ALLOC("en_US", "Requests, errors, decode-, execute- "
+                                                        "and encode time [100ns], bytes in and out");
+        counters->valueRank = 1;
+        counters->valueSource = UA_VALUESOURCE_DATASOURCE;
+        counters->value.dataSource = (UA_DataSource) {.handle = &server->serviceStatistics[i],
+                                                      .read = readServiceStatistics, .write = NULL};
+        UA_AddNodesResult vres = addNodeInternal(server, (UA_Node*)counters, res.addedNodeId,
+                                                 nodeIdHasComponent);
+        addReferenceInternal(server, vres.addedNodeId, nodeIdHasTypeDefinition,
+                             expandedNodeIdBaseDataVariabletype, true);
+        UA_AddNodesResult_deleteMembers(&vres);
+    }
+    UA_AddNodesResult_deleteMembers(&res);
+}
+#endif
+
 static void copyNames(UA_Node *node, char *name) {
     node->browseName = UA_QUALIFIEDNAME_ALLOC(0, name);
     node->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", name);
@@ -446,13 +700,30 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
         return NULL;
 
     server->config = config;
+    if(config.allocator)
+        UA_setAllocator(config.allocator);
+
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    /* The statistics are recorded for every request without further checks */
+    server->serviceStatistics = UA_calloc(UA_ServicesSize, sizeof(UA_ServiceStatistics));
+    if(!server->serviceStatistics) {
+        UA_free(server);
+        return NULL;
+    }
+#endif
     server->nodestore = UA_NodeStore_new();
-    LIST_INIT(&server->repeatedJobs);
 
 #ifdef UA_ENABLE_MULTITHREADING
+    UA_NodeStore_setServer(server->nodestore, server);
     rcu_init();
-    cds_wfcq_init(&server->dispatchQueue_head, &server->dispatchQueue_tail);
     cds_lfs_init(&server->mainLoopJobs);
+    cds_lfs_init(&server->orphanedLimbo); /* also before the startup */
+#endif
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_Server_initSamplers(server);
+#endif
+#ifdef UA_ENABLE_NODE_STATISTICS
+    UA_Server_initNodeStatistics(server);
 #endif
 
     /* uncomment for non-reproducible server runs */
@@ -463,6 +734,7 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     server->namespaces[0] = UA_STRING_ALLOC("http://opcfoundation.org/UA/");
     UA_String_copy(&server->config.applicationDescription.applicationUri, &server->namespaces[1]);
     server->namespacesSize = 2;
+    UA_Server_updateNamespacesValue(server);
 
     server->endpointDescriptions = UA_Array_new(server->config.networkLayersSize,
                                                 &UA_TYPES[UA_TYPES_ENDPOINTDESCRIPTION]);
@@ -512,8 +784,12 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     UA_Job cleanup = {.type = UA_JOBTYPE_METHODCALL,
                       .job.methodCall = {.method = UA_Server_cleanup, .data = NULL} };
     UA_Server_addRepeatedJob(server, cleanup, 10000, NULL);
+#ifdef UA_ENABLE_HISTORIZING
+    UA_Server_initHistory(server);
+#endif
 
     server->startTime = UA_DateTime_now();
+    server->now = server->startTime;
 
     /**************/
     /* References */
@@ -925,7 +1201,8 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     maxBrowseContinuationPoints->nodeId.identifier.numeric =
         UA_NS0ID_SERVER_SERVERCAPABILITIES_MAXBROWSECONTINUATIONPOINTS;
     maxBrowseContinuationPoints->value.variant.value.data = UA_UInt16_new();
-    *((UA_UInt16*)maxBrowseContinuationPoints->value.variant.value.data) = MAXCONTINUATIONPOINTS;
+    *((UA_UInt16*)maxBrowseContinuationPoints->value.variant.value.data) =
+        server->config.maxBrowseContinuationPoints;
     maxBrowseContinuationPoints->value.variant.value.type = &UA_TYPES[UA_TYPES_UINT16];
     addNodeInternal(server, (UA_Node*)maxBrowseContinuationPoints,
                     UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERCAPABILITIES), nodeIdHasProperty);
@@ -1234,6 +1511,12 @@ UA_Server * UA_Server_new(const UA_ServerConfig config) {
     addReferenceInternal(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERREDUNDANCY_REDUNDANCYSUPPORT), nodeIdHasTypeDefinition,
                          UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_PROPERTYTYPE), true);
 
+    addSessionMemoryNode(server);
+
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    addServiceStatisticsNodes(server);
+#endif
+
     return server;
 }
 
@@ -1274,6 +1557,10 @@ UA_Server_setVariableNode_valueCallback(UA_Server *server, const UA_NodeId nodeI
     UA_RCU_LOCK();
     UA_StatusCode retval = UA_Server_editNode(server, &adminSession, &nodeId,
                                               (UA_EditNodeCallback)setValueCallback, &callback);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    if(retval == UA_STATUSCODE_GOOD && callback.onRead)
+        UA_Server_pollValueWatchers(server, &nodeId);
+#endif
     UA_RCU_UNLOCK();
     return retval;
 }
@@ -1287,6 +1574,8 @@ setDataSource(UA_Server *server, UA_Session *session,
         UA_Variant_deleteMembers(&node->value.variant.value);
     node->value.dataSource = *dataSource;
     node->valueSource = UA_VALUESOURCE_DATASOURCE;
+    if(dataSource->readBatch)
+        server->batchReadSources = true;
     return UA_STATUSCODE_GOOD;
 }
 
@@ -1296,6 +1585,38 @@ UA_Server_setVariableNode_dataSource(UA_Server *server, const UA_NodeId nodeId,
     UA_RCU_LOCK();
     UA_StatusCode retval = UA_Server_editNode(server, &adminSession, &nodeId,
                                               (UA_EditNodeCallback)setDataSource, &dataSource);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_Server_pollValueWatchers(server, &nodeId);
+#endif
+    UA_RCU_UNLOCK();
+    return retval;
+}
+
+static UA_StatusCode
+setValueMemory(UA_Server *server, UA_Session *session,
+               UA_VariableNode* node, const UA_ValueMemory *memory) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE)
+        return UA_STATUSCODE_BADNODECLASSINVALID;
+    if(node->valueSource == UA_VALUESOURCE_VARIANT)
+        UA_Variant_deleteMembers(&node->value.variant.value);
+    node->value.memory = *memory;
+    node->valueSource = UA_VALUESOURCE_MEMORY;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_setVariableNode_valueMemory(UA_Server *server, const UA_NodeId nodeId,
+                                      const UA_ValueMemory memory) {
+    if(!memory.sequence || !memory.data || !memory.type || !memory.type->fixedSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    UA_RCU_LOCK();
+    UA_StatusCode retval = UA_Server_editNode(server, &adminSession, &nodeId,
+                                              (UA_EditNodeCallback)setValueMemory, &memory);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_Server_pollValueWatchers(server, &nodeId);
+#endif
     UA_RCU_UNLOCK();
     return retval;
 }
@@ -1371,15 +1692,25 @@ __UA_Server_read(UA_Server *server, const UA_NodeId *nodeId, const UA_AttributeI
         return retval;
     }
     if(attributeId == UA_ATTRIBUTEID_VALUE ||
-       attributeId == UA_ATTRIBUTEID_ARRAYDIMENSIONS)
+       attributeId == UA_ATTRIBUTEID_ARRAYDIMENSIONS) {
+        /* The caller owns the result. Shared or borrowed node data is copied. */
+        retval = UA_Variant_unshare(&dv.value);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_DataValue_deleteMembers(&dv);
+            return retval;
+        }
         memcpy(v, &dv.value, sizeof(UA_Variant));
-    else {
+    }
+    else if(dv.value.storageType == UA_VARIANT_DATA_NODELETE) {
+        /* The attribute points into the node */
+        retval = UA_copy(dv.value.data, v, dv.value.type);
+    } else {
         memcpy(v, dv.value.data, dv.value.type->memSize);
         dv.value.data = NULL;
         dv.value.arrayLength = 0;
         UA_Variant_deleteMembers(&dv.value);
     }
-    return UA_STATUSCODE_GOOD;
+    return retval;
 }
 
 UA_BrowseResult
@@ -6,48 +6,104 @@
 #include "ua_types_generated_encoding_binary.h"
 #include "ua_transport_generated.h"
 #include "ua_transport_generated_encoding_binary.h"
+#include "ua_trace.h"
+
+/* Initial size of the arena for decoded requests, on the stack */
+#define REQUEST_ARENA_SIZE 4096
 
 /********************/
 /* Helper Functions */
 /********************/
 
-static void init_response_header(const UA_RequestHeader *p, UA_ResponseHeader *r) {
+static void init_response_header(const UA_RequestHeader *p, UA_ResponseHeader *r,
+                                 UA_DateTime now) {
     r->requestHandle = p->requestHandle;
-    r->timestamp = UA_DateTime_now();
+    r->timestamp = now;
+}
+
+/* A request is decoded from up to two segments: the reassembled previous
+   chunks and the final chunk in the network buffer. Copying the final chunk
+   behind the others is not required. offset is the position in the current
+   segment. */
+typedef struct {
+    UA_ByteString segments[2];
+    size_t segmentsSize;
+    size_t current;
+    size_t offset;
+} RequestSource;
+
+static UA_StatusCode nextSegment(void *handle, UA_ByteString *buf) {
+    RequestSource *src = handle;
+    if(src->current + 1 >= src->segmentsSize)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    src->current++;
+    *buf = src->segments[src->current];
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+decodeRequest(RequestSource *src, void *dst, const UA_DataType *type, UA_Arena *arena) {
+    size_t remaining = 0;
+    for(size_t i = src->current + 1; i < src->segmentsSize; i++)
+        remaining += src->segments[i].length;
+    return UA_decodeBinaryChunked(&src->segments[src->current], &src->offset, dst, type,
+                                  nextSegment, src, remaining, arena);
 }
 
+/* The source is copied to keep the position of the request header */
 static void
-sendError(UA_SecureChannel *channel, const UA_ByteString *msg, size_t offset, const UA_DataType *responseType,
+sendError(UA_SecureChannel *channel, RequestSource src, const UA_DataType *responseType,
           UA_UInt32 requestId, UA_StatusCode error) {
     UA_RequestHeader requestHeader;
-    UA_StatusCode retval = UA_RequestHeader_decodeBinary(msg, &offset, &requestHeader);
+    UA_StatusCode retval = decodeRequest(&src, &requestHeader, &UA_TYPES[UA_TYPES_REQUESTHEADER], NULL);
     if(retval != UA_STATUSCODE_GOOD)
         return;
     void *response = UA_alloca(responseType->memSize);
     UA_init(response, responseType);
     UA_ResponseHeader *responseHeader = (UA_ResponseHeader*)response;
-    init_response_header(&requestHeader, responseHeader);
+    init_response_header(&requestHeader, responseHeader, UA_DateTime_now());
     responseHeader->serviceResult = error;
     UA_SecureChannel_sendBinaryMessage(channel, requestId, response, responseType);
     UA_RequestHeader_deleteMembers(&requestHeader);
     UA_ResponseHeader_deleteMembers(responseHeader);
 }
 
-/* Returns a complete decoded request (without securechannel headers + padding)
-   or UA_BYTESTRING_NULL */
-static UA_ByteString processChunk(UA_SecureChannel *channel, UA_Server *server,
+/* Sets complete if the request is complete. Then the request is set up to
+   decode from the previous chunks (if any) followed by the final chunk. The
+   first of two segments needs to be freed afterwards. Returns
+   BadTcpNotEnoughResources if the channel needs to be closed. */
+static UA_StatusCode processChunk(UA_SecureChannel *channel, UA_Server *server,
                                   const UA_TcpMessageHeader *messageHeader, UA_UInt32 requestId,
                                   const UA_ByteString *msg, size_t offset, size_t chunksize,
-                                  UA_Boolean *deleteRequest) {
-    UA_ByteString bytes = UA_BYTESTRING_NULL;
+                                  RequestSource *request, UA_Boolean *complete) {
+    UA_ByteString previous;
+    UA_StatusCode retval;
+    *complete = false;
     switch(messageHeader->messageTypeAndChunkType & 0xff000000) {
     case UA_CHUNKTYPE_INTERMEDIATE:
         UA_LOG_TRACE_CHANNEL(server->config.logger, channel, "Chunk message");
-        UA_SecureChannel_appendChunk(channel, requestId, msg, offset, chunksize);
+        retval = UA_SecureChannel_appendChunk(channel, requestId, msg, offset, chunksize);
+        if(retval == UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES)
+            return retval;
         break;
     case UA_CHUNKTYPE_FINAL:
         UA_LOG_TRACE_CHANNEL(server->config.logger, channel, "Final chunk message");
-        bytes = UA_SecureChannel_finalizeChunk(channel, requestId, msg, offset, chunksize, deleteRequest);
+        retval = UA_SecureChannel_takeChunks(channel, requestId, msg, offset, chunksize, &previous);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_INFO_CHANNEL(server->config.logger, channel,
+                                "Dropped the chunked request %i with error 0x%08x",
+                                requestId, retval);
+            break;
+        }
+        request->segmentsSize = 0;
+        request->current = 0;
+        request->offset = 0;
+        if(previous.data)
+            request->segments[request->segmentsSize++] = previous;
+        request->segments[request->segmentsSize].data = &msg->data[offset];
+        request->segments[request->segmentsSize].length = chunksize;
+        request->segmentsSize++;
+        *complete = true;
         break;
     case UA_CHUNKTYPE_ABORT:
         UA_LOG_INFO_CHANNEL(server->config.logger, channel, "Chunk aborted");
@@ -56,164 +112,76 @@ static UA_ByteString processChunk(UA_SecureChannel *channel, UA_Server *server,
     default:
         UA_LOG_INFO_CHANNEL(server->config.logger, channel, "Unknown chunk type");
     }
-    return bytes;
+    return UA_STATUSCODE_GOOD;
 }
 
-static void
-getServicePointers(UA_UInt32 requestTypeId, const UA_DataType **requestType,
-                   const UA_DataType **responseType, UA_Service *service,
-                   UA_Boolean *requiresSession) {
-    switch(requestTypeId - UA_ENCODINGOFFSET_BINARY) {
-    case UA_NS0ID_GETENDPOINTSREQUEST:
-        *service = (UA_Service)Service_GetEndpoints;
-        *requestType = &UA_TYPES[UA_TYPES_GETENDPOINTSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_GETENDPOINTSRESPONSE];
-        *requiresSession = false;
-        break;
-    case UA_NS0ID_FINDSERVERSREQUEST:
-        *service = (UA_Service)Service_FindServers;
-        *requestType = &UA_TYPES[UA_TYPES_FINDSERVERSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_FINDSERVERSRESPONSE];
-        *requiresSession = false;
-        break;
-    case UA_NS0ID_CREATESESSIONREQUEST:
-        *service = (UA_Service)Service_CreateSession;
-        *requestType = &UA_TYPES[UA_TYPES_CREATESESSIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CREATESESSIONRESPONSE];
-        *requiresSession = false;
-        break;
-    case UA_NS0ID_ACTIVATESESSIONREQUEST:
-        *service = (UA_Service)Service_ActivateSession;
-        *requestType = &UA_TYPES[UA_TYPES_ACTIVATESESSIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_ACTIVATESESSIONRESPONSE];
-        break;
-    case UA_NS0ID_CLOSESESSIONREQUEST:
-        *service = (UA_Service)Service_CloseSession;
-        *requestType = &UA_TYPES[UA_TYPES_CLOSESESSIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CLOSESESSIONRESPONSE];
-        break;
-    case UA_NS0ID_READREQUEST:
-        *service = (UA_Service)Service_Read;
-        *requestType = &UA_TYPES[UA_TYPES_READREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_READRESPONSE];
-        break;
-    case UA_NS0ID_WRITEREQUEST:
-        *service = (UA_Service)Service_Write;
-        *requestType = &UA_TYPES[UA_TYPES_WRITEREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_WRITERESPONSE];
-        break;
-    case UA_NS0ID_BROWSEREQUEST:
-        *service = (UA_Service)Service_Browse;
-        *requestType = &UA_TYPES[UA_TYPES_BROWSEREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_BROWSERESPONSE];
-        break;
-    case UA_NS0ID_BROWSENEXTREQUEST:
-        *service = (UA_Service)Service_BrowseNext;
-        *requestType = &UA_TYPES[UA_TYPES_BROWSENEXTREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_BROWSENEXTRESPONSE];
-        break;
-    case UA_NS0ID_REGISTERNODESREQUEST:
-        *service = (UA_Service)Service_RegisterNodes;
-        *requestType = &UA_TYPES[UA_TYPES_REGISTERNODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_REGISTERNODESRESPONSE];
-        break;
-    case UA_NS0ID_UNREGISTERNODESREQUEST:
-        *service = (UA_Service)Service_UnregisterNodes;
-        *requestType = &UA_TYPES[UA_TYPES_UNREGISTERNODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_UNREGISTERNODESRESPONSE];
-        break;
-    case UA_NS0ID_TRANSLATEBROWSEPATHSTONODEIDSREQUEST:
-        *service = (UA_Service)Service_TranslateBrowsePathsToNodeIds;
-        *requestType = &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSRESPONSE];
-        break;
+/********************/
+/* Service Dispatch */
+/********************/
 
-#ifdef UA_ENABLE_SUBSCRIPTIONS
-    case UA_NS0ID_CREATESUBSCRIPTIONREQUEST:
-        *service = (UA_Service)Service_CreateSubscription;
-        *requestType = &UA_TYPES[UA_TYPES_CREATESUBSCRIPTIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CREATESUBSCRIPTIONRESPONSE];
-        break;
-    case UA_NS0ID_PUBLISHREQUEST:
-        *requestType = &UA_TYPES[UA_TYPES_PUBLISHREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_PUBLISHRESPONSE];
-        break;
-    case UA_NS0ID_REPUBLISHREQUEST:
-        *service = (UA_Service)Service_Republish;
-        *requestType = &UA_TYPES[UA_TYPES_REPUBLISHREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE];
-        break;
-    case UA_NS0ID_MODIFYSUBSCRIPTIONREQUEST:
-        *service = (UA_Service)Service_ModifySubscription;
-        *requestType = &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_MODIFYSUBSCRIPTIONRESPONSE];
-        break;
-    case UA_NS0ID_SETPUBLISHINGMODEREQUEST:
-        *service = (UA_Service)Service_SetPublishingMode;
-        *requestType = &UA_TYPES[UA_TYPES_SETPUBLISHINGMODEREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_SETPUBLISHINGMODERESPONSE];
-        break;
-    case UA_NS0ID_DELETESUBSCRIPTIONSREQUEST:
-        *service = (UA_Service)Service_DeleteSubscriptions;
-        *requestType = &UA_TYPES[UA_TYPES_DELETESUBSCRIPTIONSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETESUBSCRIPTIONSRESPONSE];
-        break;
-    case UA_NS0ID_CREATEMONITOREDITEMSREQUEST:
-        *service = (UA_Service)Service_CreateMonitoredItems;
-        *requestType = &UA_TYPES[UA_TYPES_CREATEMONITOREDITEMSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CREATEMONITOREDITEMSRESPONSE];
-        break;
-    case UA_NS0ID_DELETEMONITOREDITEMSREQUEST:
-        *service = (UA_Service)Service_DeleteMonitoredItems;
-        *requestType = &UA_TYPES[UA_TYPES_DELETEMONITOREDITEMSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETEMONITOREDITEMSRESPONSE];
-        break;
-    case UA_NS0ID_MODIFYMONITOREDITEMSREQUEST:
-        *service = (UA_Service)Service_ModifyMonitoredItems;
-        *requestType = &UA_TYPES[UA_TYPES_MODIFYMONITOREDITEMSREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_MODIFYMONITOREDITEMSRESPONSE];
-        break;
-    case UA_NS0ID_SETMONITORINGMODEREQUEST:
-        *service = (UA_Service)Service_SetMonitoringMode;
-        *requestType = &UA_TYPES[UA_TYPES_SETMONITORINGMODEREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_SETMONITORINGMODERESPONSE];
-        break;
-#endif
+#define SERVICE(NAME, TYPE, SESSION)                                    \
+    {UA_NS0ID_##TYPE##REQUEST, #NAME, &UA_TYPES[UA_TYPES_##TYPE##REQUEST], \
+     &UA_TYPES[UA_TYPES_##TYPE##RESPONSE], (UA_Service)Service_##NAME, SESSION}
 
+const UA_ServiceDescription UA_Services[] = {
+    SERVICE(FindServers, FINDSERVERS, false),
+    SERVICE(GetEndpoints, GETENDPOINTS, false),
+    SERVICE(CreateSession, CREATESESSION, false),
+    SERVICE(ActivateSession, ACTIVATESESSION, true),
+    SERVICE(CloseSession, CLOSESESSION, true),
+#ifdef UA_ENABLE_NODEMANAGEMENT
+    SERVICE(AddNodes, ADDNODES, true),
+    SERVICE(AddReferences, ADDREFERENCES, true),
+    SERVICE(DeleteNodes, DELETENODES, true),
+    SERVICE(DeleteReferences, DELETEREFERENCES, true),
+#endif
+    SERVICE(Browse, BROWSE, true),
+    SERVICE(BrowseNext, BROWSENEXT, true),
+    SERVICE(TranslateBrowsePathsToNodeIds, TRANSLATEBROWSEPATHSTONODEIDS, true),
+    SERVICE(RegisterNodes, REGISTERNODES, true),
+    SERVICE(UnregisterNodes, UNREGISTERNODES, true),
+    SERVICE(Read, READ, true),
+#ifdef UA_ENABLE_HISTORIZING
+    SERVICE(HistoryRead, HISTORYREAD, true),
+#endif
+    SERVICE(Write, WRITE, true),
 #ifdef UA_ENABLE_METHODCALLS
-    case UA_NS0ID_CALLREQUEST:
-        *service = (UA_Service)Service_Call;
-        *requestType = &UA_TYPES[UA_TYPES_CALLREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_CALLRESPONSE];
-        break;
+    SERVICE(Call, CALL, true),
 #endif
-
-#ifdef UA_ENABLE_NODEMANAGEMENT
-    case UA_NS0ID_ADDNODESREQUEST:
-        *service = (UA_Service)Service_AddNodes;
-        *requestType = &UA_TYPES[UA_TYPES_ADDNODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_ADDNODESRESPONSE];
-        break;
-    case UA_NS0ID_ADDREFERENCESREQUEST:
-        *service = (UA_Service)Service_AddReferences;
-        *requestType = &UA_TYPES[UA_TYPES_ADDREFERENCESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_ADDREFERENCESRESPONSE];
-        break;
-    case UA_NS0ID_DELETENODESREQUEST:
-        *service = (UA_Service)Service_DeleteNodes;
-        *requestType = &UA_TYPES[UA_TYPES_DELETENODESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETENODESRESPONSE];
-        break;
-    case UA_NS0ID_DELETEREFERENCESREQUEST:
-        *service = (UA_Service)Service_DeleteReferences;
-        *requestType = &UA_TYPES[UA_TYPES_DELETEREFERENCESREQUEST];
-        *responseType = &UA_TYPES[UA_TYPES_DELETEREFERENCESRESPONSE];
-        break;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    SERVICE(CreateMonitoredItems, CREATEMONITOREDITEMS, true),
+    SERVICE(ModifyMonitoredItems, MODIFYMONITOREDITEMS, true),
+    SERVICE(SetMonitoringMode, SETMONITORINGMODE, true),
+    SERVICE(DeleteMonitoredItems, DELETEMONITOREDITEMS, true),
+    SERVICE(CreateSubscription, CREATESUBSCRIPTION, true),
+    SERVICE(ModifySubscription, MODIFYSUBSCRIPTION, true),
+    SERVICE(SetPublishingMode, SETPUBLISHINGMODE, true),
+    /* called directly since the response is sent later */
+    {UA_NS0ID_PUBLISHREQUEST, "Publish", &UA_TYPES[UA_TYPES_PUBLISHREQUEST],
+     &UA_TYPES[UA_TYPES_PUBLISHRESPONSE], NULL, true},
+    /* called directly since the response is copied from the stored message */
+    {UA_NS0ID_REPUBLISHREQUEST, "Republish", &UA_TYPES[UA_TYPES_REPUBLISHREQUEST],
+     &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE], NULL, true},
+    SERVICE(TransferSubscriptions, TRANSFERSUBSCRIPTIONS, true),
+    SERVICE(DeleteSubscriptions, DELETESUBSCRIPTIONS, true),
 #endif
-
-    default:
-        break;
+};
+
+const size_t UA_ServicesSize = sizeof(UA_Services) / sizeof(UA_ServiceDescription);
+
+size_t UA_Services_find(UA_UInt32 requestTypeId) {
+    size_t low = 0;
+    size_t high = UA_ServicesSize;
+    while(low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if(UA_Services[mid].requestTypeId < requestTypeId)
+            low = mid + 1;
+        else
+            high = mid;
     }
+    if(low < UA_ServicesSize && UA_Services[low].requestTypeId == requestTypeId)
+        return low;
+    return UA_ServicesSize;
 }
 
 /*************************/
@@ -366,60 +334,76 @@ static void processOPN(UA_Connection *connection, UA_Server *server, const UA_By
     UA_AsymmetricAlgorithmSecurityHeader_deleteMembers(&asymHeader);
 }
 
-static void
-processRequest(UA_SecureChannel *channel, UA_Server *server, UA_UInt32 requestId, const UA_ByteString *msg) {
-    /* At 0, the nodeid starts... */
-    size_t ppos = 0;
-    size_t *offset = &ppos;
+/* The points in time when the phases of a request ended. The time is taken
+ * only with service statistics. */
+typedef struct {
+    UA_DateTime start;
+    UA_DateTime decoded;
+    UA_DateTime executed;
+    size_t bytesOut;
+    UA_Boolean error;
+    UA_UInt32 session; /* for the tracepoints */
+} RequestTiming;
+
+static void markTime(UA_DateTime *t) {
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    *t = UA_DateTime_nowMonotonic();
+#endif
+}
 
-    /* Decode the nodeid */
-    UA_NodeId requestTypeId;
-    UA_StatusCode retval = UA_NodeId_decodeBinary(msg, offset, &requestTypeId);
-    if(retval != UA_STATUSCODE_GOOD)
-        return;
+/* Requests with many operations weigh more against the request rate */
+static size_t
+requestOperations(const void *request, const UA_DataType *requestType) {
+    if(requestType == &UA_TYPES[UA_TYPES_READREQUEST])
+        return ((const UA_ReadRequest*)request)->nodesToReadSize;
+    if(requestType == &UA_TYPES[UA_TYPES_WRITEREQUEST])
+        return ((const UA_WriteRequest*)request)->nodesToWriteSize;
+    if(requestType == &UA_TYPES[UA_TYPES_BROWSEREQUEST])
+        return ((const UA_BrowseRequest*)request)->nodesToBrowseSize;
+    if(requestType == &UA_TYPES[UA_TYPES_TRANSLATEBROWSEPATHSTONODEIDSREQUEST])
+        return ((const UA_TranslateBrowsePathsToNodeIdsRequest*)request)->browsePathsSize;
+#ifdef UA_ENABLE_METHODCALLS
+    if(requestType == &UA_TYPES[UA_TYPES_CALLREQUEST])
+        return ((const UA_CallRequest*)request)->methodsToCallSize;
+#endif
+#ifdef UA_ENABLE_NODEMANAGEMENT
+    if(requestType == &UA_TYPES[UA_TYPES_ADDNODESREQUEST])
+        return ((const UA_AddNodesRequest*)request)->nodesToAddSize;
+#endif
+    return 1;
+}
 
+static void
+handleRequest(UA_SecureChannel *channel, UA_Server *server, UA_UInt32 requestId,
+              RequestSource *msg, const UA_ServiceDescription *sd, RequestTiming *timing) {
     /* Store the start-position of the request */
-    size_t requestPos = *offset;
-
-    /* Test if the service type nodeid has the right format */
-    if(requestTypeId.identifierType != UA_NODEIDTYPE_NUMERIC ||
-       requestTypeId.namespaceIndex != 0) {
-        UA_NodeId_deleteMembers(&requestTypeId);
-        UA_LOG_DEBUG_CHANNEL(server->config.logger, channel, "Received a non-numeric message type NodeId");
-        sendError(channel, msg, requestPos, &UA_TYPES[UA_TYPES_SERVICEFAULT], requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
-    }
-
-    /* Get the service pointers */
-    UA_Service service = NULL;
-    const UA_DataType *requestType = NULL;
-    const UA_DataType *responseType = NULL;
-    UA_Boolean sessionRequired = true;
-    getServicePointers(requestTypeId.identifier.numeric, &requestType, &responseType, &service, &sessionRequired);
-    if(!requestType) {
-        if(requestTypeId.identifier.numeric == 787) {
-            UA_LOG_INFO_CHANNEL(server->config.logger, channel,
-                                "Client requested a subscription, but those are not enabled in the build");
-        } else {
-            UA_LOG_INFO_CHANNEL(server->config.logger, channel, "Unknown request %i",
-                                requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY);
-        }
-        sendError(channel, msg, requestPos, &UA_TYPES[UA_TYPES_SERVICEFAULT], requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
-        return;
-    }
-    UA_assert(responseType);
+    RequestSource requestPos = *msg;
+    const UA_DataType *requestType = sd->requestType;
+    const UA_DataType *responseType = sd->responseType;
+    UA_Boolean sessionRequired = sd->requiresSession;
+    timing->error = true; /* until the response is sent */
 
 #ifdef UA_ENABLE_NONSTANDARD_STATELESS
     /* Stateless extension: Sessions are optional */
     sessionRequired = false;
 #endif
 
-    /* Decode the request */
+    /* Decode the request. The strings and arrays of the request are taken from
+     * an arena that starts on the stack. Most strings point directly into the
+     * message chunks, which outlive the request. The request is not deleted
+     * member by member, but the arena is cleaned up at once. The services copy
+     * what needs to outlive the request. */
+    UA_Byte arenaBuf[REQUEST_ARENA_SIZE];
+    UA_Arena arena;
+    UA_Arena_init(&arena, arenaBuf, sizeof(arenaBuf));
     void *request = UA_alloca(requestType->memSize);
     UA_RequestHeader *requestHeader = (UA_RequestHeader*)request;
-    retval = UA_decodeBinary(msg, offset, request, requestType);
+    UA_StatusCode retval = decodeRequest(msg, request, requestType, &arena);
+    markTime(&timing->decoded);
     if(retval != UA_STATUSCODE_GOOD) {
         UA_LOG_DEBUG_CHANNEL(server->config.logger, channel, "Could not decode the request");
-        sendError(channel, msg, requestPos, responseType, requestId, retval);
+        sendError(channel, requestPos, responseType, requestId, retval);
+        UA_Arena_deleteMembers(&arena);
         return;
     }
 
@@ -441,8 +425,8 @@ processRequest(UA_SecureChannel *channel, UA_Server *server, UA_UInt32 requestId
     if(requestType == &UA_TYPES[UA_TYPES_ACTIVATESESSIONREQUEST]) {
         if(!session) {
             UA_LOG_DEBUG_CHANNEL(server->config.logger, channel, "Trying to activate a session that is not known in the server");
-            sendError(channel, msg, requestPos, responseType, requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
-            UA_deleteMembers(request, requestType);
+            sendError(channel, requestPos, responseType, requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
+            UA_Arena_deleteMembers(&arena);
             return;
         }
         Service_ActivateSession(server, channel, session, request, response);
@@ -454,9 +438,9 @@ processRequest(UA_SecureChannel *channel, UA_Server *server, UA_UInt32 requestId
     if(!session) {
         if(sessionRequired) {
             UA_LOG_INFO_CHANNEL(server->config.logger, channel, "Service request %i without a valid session",
-                                requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY);
-            sendError(channel, msg, requestPos, responseType, requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
-            UA_deleteMembers(request, requestType);
+                                sd->requestTypeId);
+            sendError(channel, requestPos, responseType, requestId, UA_STATUSCODE_BADSESSIONIDINVALID);
+            UA_Arena_deleteMembers(&arena);
             return;
         }
         UA_Session_init(&anonymousSession);
@@ -464,65 +448,219 @@ processRequest(UA_SecureChannel *channel, UA_Server *server, UA_UInt32 requestId
         anonymousSession.channel = channel;
         session = &anonymousSession;
     }
+    timing->session = session->sessionId.identifier.guid.data1;
 
     /* Trying to use a non-activated session? */
     if(!session->activated && sessionRequired) {
         UA_LOG_INFO_SESSION(server->config.logger, session, "Calling service %i on a non-activated session",
-                            requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY);
-        sendError(channel, msg, requestPos, responseType, requestId, UA_STATUSCODE_BADSESSIONNOTACTIVATED);
+                            sd->requestTypeId);
+        sendError(channel, requestPos, responseType, requestId, UA_STATUSCODE_BADSESSIONNOTACTIVATED);
         UA_SessionManager_removeSession(&server->sessionManager, &session->authenticationToken);
-        UA_deleteMembers(request, requestType);
+        UA_Arena_deleteMembers(&arena);
         return;
     }
 
     /* The session is bound to another channel */
     if(session->channel != channel) {
         UA_LOG_DEBUG_CHANNEL(server->config.logger, channel, "Client tries to use an obsolete securechannel");
-        sendError(channel, msg, requestPos, responseType, requestId, UA_STATUSCODE_BADSECURECHANNELIDINVALID);
-        UA_deleteMembers(request, requestType);
+        sendError(channel, requestPos, responseType, requestId, UA_STATUSCODE_BADSECURECHANNELIDINVALID);
+        UA_Arena_deleteMembers(&arena);
         return;
     }
 
     /* Update the session lifetime */
-    UA_Session_updateLifetime(session);
+    UA_Session_updateLifetime(session, UA_Server_now(server));
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     /* The publish request is not answered immediately */
     if(requestType == &UA_TYPES[UA_TYPES_PUBLISHREQUEST]) {
         Service_Publish(server, session, request, requestId);
-        UA_deleteMembers(request, requestType);
+        markTime(&timing->executed);
+        timing->error = false;
+        UA_Arena_deleteMembers(&arena);
+        return;
+    }
+
+    /* The republished message is sent from its stored encoding */
+    if(requestType == &UA_TYPES[UA_TYPES_REPUBLISHREQUEST]) {
+        Service_Republish(server, session, request, requestId);
+        markTime(&timing->executed);
+        timing->error = false;
+        UA_Arena_deleteMembers(&arena);
         return;
     }
 #endif
 
+    /* Is the session beyond its request limits? */
+    if(session != &anonymousSession) {
+        retval = UA_Session_admitRequest(session, &server->config, UA_DateTime_nowMonotonic(),
+                                         requestOperations(request, requestType));
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_DEBUG_SESSION(server->config.logger, session, "Rejecting service %i "
+                                 "beyond the request limits", sd->requestTypeId);
+            sendError(channel, requestPos, responseType, requestId, retval);
+            UA_Arena_deleteMembers(&arena);
+            return;
+        }
+    }
+
+    /* Common reads are encoded straight from the nodes. Otherwise, the
+     * response waits for the reads from asynchronous data sources. */
+    if(requestType == &UA_TYPES[UA_TYPES_READREQUEST] &&
+       (Service_Read_direct(server, session, request, requestId) ||
+        (session != &anonymousSession &&
+         Service_Read_async(server, session, request, requestId)))) {
+        markTime(&timing->executed);
+        timing->error = false;
+        UA_Arena_deleteMembers(&arena);
+        return;
+    }
+
+    /* Clients that connect get the discovery responses from the cache */
+    if((requestType == &UA_TYPES[UA_TYPES_GETENDPOINTSREQUEST] &&
+        Service_GetEndpoints_cached(server, session, request, requestId)) ||
+       (requestType == &UA_TYPES[UA_TYPES_FINDSERVERSREQUEST] &&
+        Service_FindServers_cached(server, session, request, requestId))) {
+        markTime(&timing->executed);
+        timing->error = false;
+        UA_Arena_deleteMembers(&arena);
+        return;
+    }
+
     /* Call the service */
-    service(server, session, request, response);
+    sd->service(server, session, request, response);
 
  send_response:
+    markTime(&timing->executed);
+    timing->error = (((UA_ResponseHeader*)response)->serviceResult != UA_STATUSCODE_GOOD);
+
     /* Send the response */
-    init_response_header(request, response);
-    retval = UA_SecureChannel_sendBinaryMessage(channel, requestId, response, responseType);
+    init_response_header(request, response, UA_Server_now(server));
+    UA_MessageContext mc;
+    retval = UA_SecureChannel_beginMessage(channel, requestId, responseType, &mc);
+    if(retval == UA_STATUSCODE_GOOD) {
+        retval = UA_SecureChannel_encodeMessage(&mc, response, responseType);
+        retval = UA_SecureChannel_finishMessage(&mc, retval);
+        timing->bytesOut = mc.ci.messageSizeSoFar;
+    }
     if(retval != UA_STATUSCODE_GOOD)
         UA_LOG_INFO_CHANNEL(server->config.logger, channel, "Could not send the message over "
                              "the SecureChannel with error code 0x%08x", retval);
 
     /* Clean up */
-    UA_deleteMembers(request, requestType);
+    UA_Arena_deleteMembers(&arena);
     UA_deleteMembers(response, responseType);
 }
 
+static size_t requestSize(const RequestSource *src) {
+    size_t size = src->segments[src->current].length - src->offset;
+    for(size_t i = src->current + 1; i < src->segmentsSize; i++)
+        size += src->segments[i].length;
+    return size;
+}
+
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+
+/* Phases that were not reached take no time */
+static void
+recordRequest(UA_Server *server, size_t serviceIndex, const RequestTiming *timing,
+              size_t bytesIn) {
+    UA_ServiceStatistics *stats = &server->serviceStatistics[serviceIndex];
+    UA_DateTime end = UA_DateTime_nowMonotonic();
+    UA_DateTime decoded = timing->decoded ? timing->decoded : end;
+    UA_DateTime executed = timing->executed ? timing->executed : decoded;
+#ifndef UA_ENABLE_MULTITHREADING
+    stats->requests++;
+    stats->errors += timing->error;
+    stats->decodeTime += (UA_UInt64)(decoded - timing->start);
+    stats->executeTime += (UA_UInt64)(executed - decoded);
+    stats->encodeTime += (UA_UInt64)(end - executed);
+    stats->bytesIn += bytesIn;
+    stats->bytesOut += timing->bytesOut;
+#else
+    uatomic_inc(&stats->requests);
+    if(timing->error)
+        uatomic_inc(&stats->errors);
+    uatomic_add(&stats->decodeTime, (UA_UInt64)(decoded - timing->start));
+    uatomic_add(&stats->executeTime, (UA_UInt64)(executed - decoded));
+    uatomic_add(&stats->encodeTime, (UA_UInt64)(end - executed));
+    uatomic_add(&stats->bytesIn, (UA_UInt64)bytesIn);
+    uatomic_add(&stats->bytesOut, (UA_UInt64)timing->bytesOut);
+#endif
+}
+
+UA_StatusCode
+UA_Server_getServiceStatistics(UA_Server *server, const UA_DataType *requestType,
+                               UA_ServiceStatistics *stats) {
+    size_t index = UA_Services_find(requestType->typeId.identifier.numeric);
+    if(requestType->typeId.namespaceIndex != 0 || index == UA_ServicesSize)
+        return UA_STATUSCODE_BADSERVICEUNSUPPORTED;
+    *stats = server->serviceStatistics[index];
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif
+
+static void
+processRequest(UA_SecureChannel *channel, UA_Server *server, UA_UInt32 requestId, RequestSource *msg) {
+    RequestTiming timing;
+    memset(&timing, 0, sizeof(RequestTiming));
+    markTime(&timing.start);
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    size_t bytesIn = requestSize(msg);
+#endif
+
+    /* Decode the nodeid */
+    UA_NodeId requestTypeId;
+    UA_StatusCode retval = decodeRequest(msg, &requestTypeId, &UA_TYPES[UA_TYPES_NODEID], NULL);
+    if(retval != UA_STATUSCODE_GOOD)
+        return;
+
+    /* Test if the service type nodeid has the right format */
+    if(requestTypeId.identifierType != UA_NODEIDTYPE_NUMERIC ||
+       requestTypeId.namespaceIndex != 0) {
+        UA_NodeId_deleteMembers(&requestTypeId);
+        UA_LOG_DEBUG_CHANNEL(server->config.logger, channel, "Received a non-numeric message type NodeId");
+        sendError(channel, *msg, &UA_TYPES[UA_TYPES_SERVICEFAULT], requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+        return;
+    }
+
+    /* Look up the service */
+    size_t serviceIndex = UA_Services_find(requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY);
+    if(serviceIndex == UA_ServicesSize) {
+        if(requestTypeId.identifier.numeric == 787) {
+            UA_LOG_INFO_CHANNEL(server->config.logger, channel,
+                                "Client requested a subscription, but those are not enabled in the build");
+        } else {
+            UA_LOG_INFO_CHANNEL(server->config.logger, channel, "Unknown request %i",
+                                requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY);
+        }
+        sendError(channel, *msg, &UA_TYPES[UA_TYPES_SERVICEFAULT], requestId, UA_STATUSCODE_BADSERVICEUNSUPPORTED);
+        return;
+    }
+
+    UA_TRACE3(service_start, channel->securityToken.channelId, requestId,
+              UA_Services[serviceIndex].requestTypeId);
+    handleRequest(channel, server, requestId, msg, &UA_Services[serviceIndex], &timing);
+    UA_TRACE5(service_end, channel->securityToken.channelId, timing.session, requestId,
+              UA_Services[serviceIndex].requestTypeId, timing.error);
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    recordRequest(server, serviceIndex, &timing, bytesIn);
+#endif
+}
+
 /* MSG -> Normal request */
 static void
 processMSG(UA_Connection *connection, UA_Server *server, const UA_TcpMessageHeader *messageHeader,
            const UA_ByteString *msg, size_t *offset) {
     /* Decode the header */
+    size_t chunkStart = *offset - 8;
     UA_UInt32 channelId = 0;
     UA_UInt32 tokenId = 0;
-    UA_SequenceHeader sequenceHeader;
     UA_StatusCode retval = UA_UInt32_decodeBinary(msg, offset, &channelId);
     retval |= UA_UInt32_decodeBinary(msg, offset, &tokenId);
-    retval |= UA_SequenceHeader_decodeBinary(msg, offset, &sequenceHeader);
-    if(retval != UA_STATUSCODE_GOOD)
+    if(retval != UA_STATUSCODE_GOOD || messageHeader->messageSize < 24 ||
+       messageHeader->messageSize > msg->length - chunkStart)
         return;
 
     /* Get the SecureChannel */
@@ -544,6 +682,22 @@ processMSG(UA_Connection *connection, UA_Server *server, const UA_TcpMessageHead
         return;
     }
 
+    /* Decrypt and verify the chunk in the receive buffer. The buffer is not
+     * used after the message is processed. */
+    UA_ByteString chunk = {messageHeader->messageSize, &msg->data[chunkStart]};
+    size_t chunkLength;
+    retval = UA_SecureChannel_unprotectChunk(channel, &chunk, &chunkLength);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_INFO_CHANNEL(server->config.logger, channel,
+                            "The chunk failed the security checks. Closing the SecureChannel.");
+        Service_CloseSecureChannel(server, channel);
+        connection->close(connection);
+        return;
+    }
+    UA_SequenceHeader sequenceHeader;
+    if(UA_SequenceHeader_decodeBinary(msg, offset, &sequenceHeader) != UA_STATUSCODE_GOOD)
+        return;
+
     /* Does the sequence number match? */
     if(sequenceHeader.sequenceNumber != channel->receiveSequenceNumber + 1) {
         if(channel->receiveSequenceNumber + 1 > 4294966271 && sequenceHeader.sequenceNumber < 1024) {
@@ -552,7 +706,8 @@ processMSG(UA_Connection *connection, UA_Server *server, const UA_TcpMessageHead
             UA_LOG_INFO_CHANNEL(server->config.logger, channel,
                                 "The sequence number was not increased by one. Got %i, expected %i",
                                 sequenceHeader.sequenceNumber, channel->receiveSequenceNumber + 1);
-            sendError(channel, msg, *offset, &UA_TYPES[UA_TYPES_SERVICEFAULT],
+            RequestSource src = {{*msg}, 1, 0, *offset};
+            sendError(channel, src, &UA_TYPES[UA_TYPES_SERVICEFAULT],
                       sequenceHeader.requestId, UA_STATUSCODE_BADSECURITYCHECKSFAILED);
             return;
         }
@@ -572,15 +727,28 @@ processMSG(UA_Connection *connection, UA_Server *server, const UA_TcpMessageHead
     }
 
     /* Process chunk to get complete request */
-    UA_Boolean deleteRequest = false;
-    UA_ByteString request = processChunk(channel, server, messageHeader, sequenceHeader.requestId,
-                                         msg, *offset, messageHeader->messageSize - 24, &deleteRequest);
+    RequestSource request;
+    UA_Boolean complete;
+    retval = processChunk(channel, server, messageHeader, sequenceHeader.requestId,
+                          msg, *offset, chunkLength - 24, &request, &complete);
     *offset += (messageHeader->messageSize - 24);
-    if(request.length > 0) {
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_INFO_CHANNEL(server->config.logger, channel,
+                            "Cannot reassemble more chunked requests. Closing the SecureChannel.");
+        if(channel == &anonymousChannel)
+            UA_SecureChannel_deleteMembersCleanup(channel);
+        else
+            Service_CloseSecureChannel(server, channel);
+        connection->close(connection);
+        return;
+    }
+    if(complete) {
+        UA_TRACE3(chunk_assembled, channel->securityToken.channelId,
+                  sequenceHeader.requestId, requestSize(&request));
         /* Process the request */
         processRequest(channel, server, sequenceHeader.requestId, &request);
-        if(deleteRequest)
-            UA_ByteString_deleteMembers(&request);
+        if(request.segmentsSize > 1)
+            UA_ByteString_deleteMembers(&request.segments[0]);
     }
 
     /* Clean up a possible anonymous channel */
@@ -615,6 +783,8 @@ processCLO(UA_Connection *connection, UA_Server *server, const UA_ByteString *ms
  * you have to free it youself. use of connection->getSendBuffer() and
  * connection->send() to answer Message */
 void UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection, const UA_ByteString *msg) {
+    UA_TRACE3(message_received, connection->sockfd,
+              connection->channel ? connection->channel->securityToken.channelId : 0, msg->length);
     size_t offset= 0;
     UA_TcpMessageHeader tcpMessageHeader;
     do {
@@ -0,0 +1,856 @@
+#include "ua_server_internal.h"
+#include "ua_services.h"
+#include "ua_types_encoding_binary.h"
+
+#ifdef UA_ENABLE_HISTORIZING
+
+/* The values of a historizing variable are stored in chunks of a fixed size.
+ * Within a chunk, the samples are compressed like in Facebook's Gorilla
+ * time-series database. The first sample is stored raw. Then the timestamps
+ * are encoded as the delta of the delta to the previous timestamp and the
+ * values as the XOR with the previous value. Samples at a regular interval
+ * with slowly changing values take only a few bits.
+ *
+ * Timestamps (delta of delta in 100ns ticks):
+ *   '0'                        same delta as before
+ *   '10'   + 12 bit            -2048 .. 2047
+ *   '110'  + 20 bit            about +-52ms
+ *   '1110' + 32 bit            about +-214s
+ *   '1111' + 64 bit            everything else
+ *
+ * Values (XOR with the previous 64 bit value):
+ *   '0'                        same value
+ *   '10' + meaningful bits     the XOR fits into the window of the previous one
+ *   '11' + 6 bit leading zeros + 6 bit length - 1 + meaningful bits
+ *
+ * Status code:
+ *   '0'                        Good
+ *   '1' + 32 bit               the status code
+ *
+ * Doubles are stored with their bit pattern. Floats are widened to doubles and
+ * integers to 64 bit. Only scalars of a numeric type are recorded. Samples with
+ * a bad status code do not have a value. They repeat the previous value in the
+ * encoding. */
+
+#define UA_HISTORY_CHUNKBYTES 1024
+#define UA_HISTORY_MAXSAMPLEBITS 192 /* the encoding of a sample is shorter */
+#define UA_HISTORY_MAXSAMPLES (UA_HISTORY_CHUNKBYTES * 8 / 3) /* a sample has 3 bits or more */
+#define UA_HISTORY_MINBUCKETS 16 /* a power of two */
+#define UA_HISTORY_NOWINDOW 64 /* no XOR window was set in the chunk */
+
+typedef struct {
+    UA_DateTime firstTime;
+    UA_DateTime lastTime;
+    size_t samples;
+    size_t bits;
+    /* Encoder state after the last sample */
+    UA_Int64 lastDelta;
+    UA_UInt64 lastValue;
+    UA_StatusCode lastStatus;
+    UA_Byte leading;
+    UA_Byte trailing;
+    UA_Byte data[UA_HISTORY_CHUNKBYTES];
+} HistoryChunk;
+
+struct UA_NodeHistory {
+    LIST_ENTRY(UA_NodeHistory) indexEntry;
+    UA_NodeId nodeId;
+    const UA_DataType *type; /* of the recorded values, set with the first */
+    size_t chunksSize;
+    size_t chunksCapacity;
+    HistoryChunk **chunks; /* oldest first */
+};
+
+typedef struct {
+    UA_DateTime time;
+    UA_UInt64 value;
+    UA_StatusCode status;
+} HistorySample;
+
+/* The lock is recursive. Data sources that are sampled with the lock held can
+ * write values. */
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_LOCK_HISTORY(server) pthread_mutex_lock(&(server)->historyLock)
+# define UA_UNLOCK_HISTORY(server) pthread_mutex_unlock(&(server)->historyLock)
+#else
+# define UA_LOCK_HISTORY(server)
+# define UA_UNLOCK_HISTORY(server)
+#endif
+
+/****************/
+/* Bit Encoding */
+/****************/
+
+/* The bits are written from the most significant bit on. The chunk data is
+ * zeroed, so bits are only set. */
+static void
+writeBits(UA_Byte *data, size_t *pos, UA_UInt64 value, size_t count) {
+    while(count > 0) {
+        size_t used = *pos & 7;
+        size_t n = 8 - used;
+        if(n > count)
+            n = count;
+        UA_Byte bits = (UA_Byte)((value >> (count - n)) & ((1u << n) - 1));
+        data[*pos >> 3] |= (UA_Byte)(bits << (8 - used - n));
+        *pos += n;
+        count -= n;
+    }
+}
+
+static UA_UInt64
+readBits(const UA_Byte *data, size_t *pos, size_t count) {
+    UA_UInt64 value = 0;
+    while(count > 0) {
+        size_t used = *pos & 7;
+        size_t n = 8 - used;
+        if(n > count)
+            n = count;
+        UA_Byte bits = (UA_Byte)((data[*pos >> 3] >> (8 - used - n)) & ((1u << n) - 1));
+        value = (value << n) | bits;
+        *pos += n;
+        count -= n;
+    }
+    return value;
+}
+
+/* Reads count bits as a signed two's complement number */
+static UA_Int64
+readSigned(const UA_Byte *data, size_t *pos, size_t count) {
+    UA_UInt64 value = readBits(data, pos, count);
+    if(count < 64 && (value >> (count - 1)) & 1)
+        value |= ~(UA_UInt64)0 << count;
+    return (UA_Int64)value;
+}
+
+static UA_Byte leadingZeros(UA_UInt64 x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (UA_Byte)__builtin_clzll(x);
+#else
+    UA_Byte n = 0;
+    for(UA_UInt64 bit = (UA_UInt64)1 << 63; !(x & bit); bit >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+static UA_Byte trailingZeros(UA_UInt64 x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (UA_Byte)__builtin_ctzll(x);
+#else
+    UA_Byte n = 0;
+    for(; !(x & 1); x >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+static void
+encodeTimestamp(HistoryChunk *c, UA_DateTime time) {
+    UA_Int64 delta = time - c->lastTime;
+    UA_Int64 dod = delta - c->lastDelta;
+    c->lastDelta = delta;
+    if(dod == 0)
+        writeBits(c->data, &c->bits, 0, 1);
+    else if(dod >= -2048 && dod <= 2047) {
+        writeBits(c->data, &c->bits, 2, 2);
+        writeBits(c->data, &c->bits, (UA_UInt64)dod, 12);
+    } else if(dod >= -(1 << 19) && dod < (1 << 19)) {
+        writeBits(c->data, &c->bits, 6, 3);
+        writeBits(c->data, &c->bits, (UA_UInt64)dod, 20);
+    } else if(dod >= INT32_MIN && dod <= INT32_MAX) {
+        writeBits(c->data, &c->bits, 14, 4);
+        writeBits(c->data, &c->bits, (UA_UInt64)dod, 32);
+    } else {
+        writeBits(c->data, &c->bits, 15, 4);
+        writeBits(c->data, &c->bits, (UA_UInt64)dod, 64);
+    }
+}
+
+static void
+encodeValue(HistoryChunk *c, UA_UInt64 value) {
+    UA_UInt64 x = value ^ c->lastValue;
+    c->lastValue = value;
+    if(x == 0) {
+        writeBits(c->data, &c->bits, 0, 1);
+        return;
+    }
+    UA_Byte leading = leadingZeros(x);
+    UA_Byte trailing = trailingZeros(x);
+    if(c->leading != UA_HISTORY_NOWINDOW && leading >= c->leading && trailing >= c->trailing) {
+        /* Reuse the window of the previous value */
+        writeBits(c->data, &c->bits, 2, 2);
+        writeBits(c->data, &c->bits, x >> c->trailing, 64u - c->leading - c->trailing);
+        return;
+    }
+    size_t meaningful = 64u - leading - trailing;
+    writeBits(c->data, &c->bits, 3, 2);
+    writeBits(c->data, &c->bits, leading, 6);
+    writeBits(c->data, &c->bits, meaningful - 1, 6);
+    writeBits(c->data, &c->bits, x >> trailing, meaningful);
+    c->leading = leading;
+    c->trailing = trailing;
+}
+
+static void
+encodeStatus(HistoryChunk *c, UA_StatusCode status) {
+    c->lastStatus = status;
+    if(status == UA_STATUSCODE_GOOD) {
+        writeBits(c->data, &c->bits, 0, 1);
+        return;
+    }
+    writeBits(c->data, &c->bits, 1, 1);
+    writeBits(c->data, &c->bits, status, 32);
+}
+
+static void
+encodeSample(HistoryChunk *c, UA_DateTime time, UA_UInt64 value, UA_StatusCode status) {
+    if(c->samples == 0) {
+        c->firstTime = time;
+        writeBits(c->data, &c->bits, (UA_UInt64)time, 64);
+        writeBits(c->data, &c->bits, value, 64);
+        c->lastValue = value;
+        c->lastDelta = 0;
+        c->leading = UA_HISTORY_NOWINDOW;
+    } else {
+        encodeTimestamp(c, time);
+        encodeValue(c, value);
+    }
+    encodeStatus(c, status);
+    c->lastTime = time;
+    c->samples++;
+}
+
+/* Decodes all samples of the chunk. The decoder replays the state changes of
+ * the encoder. */
+static void
+decodeChunk(const HistoryChunk *c, HistorySample *samples) {
+    size_t pos = 0;
+    UA_DateTime time = 0;
+    UA_Int64 delta = 0;
+    UA_UInt64 value = 0;
+    UA_Byte leading = 0, trailing = 0;
+    for(size_t i = 0; i < c->samples; i++) {
+        if(i == 0) {
+            time = (UA_DateTime)readBits(c->data, &pos, 64);
+            value = readBits(c->data, &pos, 64);
+        } else {
+            /* Timestamp */
+            size_t prefix = 0;
+            while(prefix < 4 && readBits(c->data, &pos, 1))
+                prefix++;
+            static const size_t dodBits[5] = {0, 12, 20, 32, 64};
+            if(prefix > 0)
+                delta += readSigned(c->data, &pos, dodBits[prefix]);
+            time += delta;
+
+            /* Value */
+            if(readBits(c->data, &pos, 1)) {
+                if(readBits(c->data, &pos, 1)) {
+                    leading = (UA_Byte)readBits(c->data, &pos, 6);
+                    size_t meaningful = (size_t)readBits(c->data, &pos, 6) + 1;
+                    trailing = (UA_Byte)(64u - leading - meaningful);
+                }
+                value ^= readBits(c->data, &pos, 64u - leading - trailing) << trailing;
+            }
+        }
+        UA_StatusCode status = UA_STATUSCODE_GOOD;
+        if(readBits(c->data, &pos, 1))
+            status = (UA_StatusCode)readBits(c->data, &pos, 32);
+        samples[i].time = time;
+        samples[i].value = value;
+        samples[i].status = status;
+    }
+}
+
+/**********/
+/* Values */
+/**********/
+
+static UA_Boolean isHistorizableType(const UA_DataType *type) {
+    if(type < UA_TYPES || type >= &UA_TYPES[UA_TYPES_COUNT])
+        return false;
+    switch(type->typeIndex) {
+    case UA_TYPES_BOOLEAN: case UA_TYPES_SBYTE: case UA_TYPES_BYTE:
+    case UA_TYPES_INT16: case UA_TYPES_UINT16: case UA_TYPES_INT32:
+    case UA_TYPES_UINT32: case UA_TYPES_INT64: case UA_TYPES_UINT64:
+    case UA_TYPES_FLOAT: case UA_TYPES_DOUBLE: case UA_TYPES_DATETIME:
+    case UA_TYPES_STATUSCODE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static UA_UInt64 valueToBits(const void *data, const UA_DataType *type) {
+    UA_UInt64 bits = 0;
+    UA_Double d;
+    switch(type->typeIndex) {
+    case UA_TYPES_BOOLEAN: bits = *(const UA_Boolean*)data ? 1 : 0; break;
+    case UA_TYPES_SBYTE: bits = (UA_UInt64)(UA_Int64)*(const UA_SByte*)data; break;
+    case UA_TYPES_BYTE: bits = *(const UA_Byte*)data; break;
+    case UA_TYPES_INT16: bits = (UA_UInt64)(UA_Int64)*(const UA_Int16*)data; break;
+    case UA_TYPES_UINT16: bits = *(const UA_UInt16*)data; break;
+    case UA_TYPES_INT32: bits = (UA_UInt64)(UA_Int64)*(const UA_Int32*)data; break;
+    case UA_TYPES_UINT32: bits = *(const UA_UInt32*)data; break;
+    case UA_TYPES_STATUSCODE: bits = *(const UA_StatusCode*)data; break;
+    case UA_TYPES_INT64: bits = (UA_UInt64)*(const UA_Int64*)data; break;
+    case UA_TYPES_DATETIME: bits = (UA_UInt64)*(const UA_DateTime*)data; break;
+    case UA_TYPES_UINT64: bits = *(const UA_UInt64*)data; break;
+    case UA_TYPES_FLOAT:
+        d = *(const UA_Float*)data;
+        memcpy(&bits, &d, sizeof(UA_Double));
+        break;
+    case UA_TYPES_DOUBLE: memcpy(&bits, data, sizeof(UA_Double)); break;
+    default: break;
+    }
+    return bits;
+}
+
+static void bitsToValue(UA_UInt64 bits, void *data, const UA_DataType *type) {
+    UA_Double d;
+    switch(type->typeIndex) {
+    case UA_TYPES_BOOLEAN: *(UA_Boolean*)data = (bits != 0); break;
+    case UA_TYPES_SBYTE: *(UA_SByte*)data = (UA_SByte)(UA_Int64)bits; break;
+    case UA_TYPES_BYTE: *(UA_Byte*)data = (UA_Byte)bits; break;
+    case UA_TYPES_INT16: *(UA_Int16*)data = (UA_Int16)(UA_Int64)bits; break;
+    case UA_TYPES_UINT16: *(UA_UInt16*)data = (UA_UInt16)bits; break;
+    case UA_TYPES_INT32: *(UA_Int32*)data = (UA_Int32)(UA_Int64)bits; break;
+    case UA_TYPES_UINT32: *(UA_UInt32*)data = (UA_UInt32)bits; break;
+    case UA_TYPES_STATUSCODE: *(UA_StatusCode*)data = (UA_StatusCode)bits; break;
+    case UA_TYPES_INT64: *(UA_Int64*)data = (UA_Int64)bits; break;
+    case UA_TYPES_DATETIME: *(UA_DateTime*)data = (UA_DateTime)bits; break;
+    case UA_TYPES_UINT64: *(UA_UInt64*)data = bits; break;
+    case UA_TYPES_FLOAT:
+        memcpy(&d, &bits, sizeof(UA_Double));
+        *(UA_Float*)data = (UA_Float)d;
+        break;
+    case UA_TYPES_DOUBLE: memcpy(data, &bits, sizeof(UA_Double)); break;
+    default: break;
+    }
+}
+
+static UA_Boolean isBad(UA_StatusCode status) {
+    return (status >> 30) >= 2;
+}
+
+/*********/
+/* Index */
+/*********/
+
+static size_t historyBucket(const UA_Server *server, const UA_NodeId *nodeId) {
+    return (size_t)UA_NodeStore_hash(nodeId) & (server->historySize - 1);
+}
+
+static UA_NodeHistory *findHistory(UA_Server *server, const UA_NodeId *nodeId) {
+    if(server->historyCount == 0)
+        return NULL;
+    UA_NodeHistory *h;
+    LIST_FOREACH(h, &server->history[historyBucket(server, nodeId)], indexEntry) {
+        if(UA_NodeId_equal(&h->nodeId, nodeId))
+            return h;
+    }
+    return NULL;
+}
+
+static UA_StatusCode growHistory(UA_Server *server) {
+    size_t newSize = server->historySize * 2;
+    if(newSize < UA_HISTORY_MINBUCKETS)
+        newSize = UA_HISTORY_MINBUCKETS;
+    struct HistoryBucket *newIndex = UA_malloc(newSize * sizeof(struct HistoryBucket));
+    if(!newIndex)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < newSize; i++)
+        LIST_INIT(&newIndex[i]);
+
+    struct HistoryBucket *oldIndex = server->history;
+    size_t oldSize = server->historySize;
+    server->history = newIndex;
+    server->historySize = newSize;
+    for(size_t i = 0; i < oldSize; i++) {
+        UA_NodeHistory *h, *h_tmp;
+        LIST_FOREACH_SAFE(h, &oldIndex[i], indexEntry, h_tmp) {
+            LIST_REMOVE(h, indexEntry);
+            LIST_INSERT_HEAD(&newIndex[historyBucket(server, &h->nodeId)], h, indexEntry);
+        }
+    }
+    UA_free(oldIndex);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void deleteNodeHistory(UA_NodeHistory *h) {
+    for(size_t i = 0; i < h->chunksSize; i++)
+        UA_free(h->chunks[i]);
+    UA_free(h->chunks);
+    UA_NodeId_deleteMembers(&h->nodeId);
+    UA_free(h);
+}
+
+/*************/
+/* Recording */
+/*************/
+
+static UA_StatusCode
+appendSample(UA_Server *server, UA_NodeHistory *h, UA_DateTime time,
+             UA_UInt64 value, UA_StatusCode status) {
+    HistoryChunk *c = h->chunksSize > 0 ? h->chunks[h->chunksSize - 1] : NULL;
+    if(c) {
+        /* Samples are appended in the order of their timestamps. Unchanged
+         * samples of a data source are taken only once. */
+        if(time < c->lastTime)
+            return UA_STATUSCODE_BADINVALIDTIMESTAMPARGUMENT;
+        if(time == c->lastTime && value == c->lastValue && status == c->lastStatus)
+            return UA_STATUSCODE_GOOD;
+    }
+
+    if(!c || c->bits + UA_HISTORY_MAXSAMPLEBITS > UA_HISTORY_CHUNKBYTES * 8) {
+        /* Drop the oldest chunk if the limit is reached */
+        size_t limit = server->config.maxHistoryBytesPerNode;
+        if(limit > 0 && h->chunksSize > 0 &&
+           (h->chunksSize + 1) * sizeof(HistoryChunk) > limit) {
+            UA_free(h->chunks[0]);
+            h->chunksSize--;
+            memmove(h->chunks, &h->chunks[1], h->chunksSize * sizeof(HistoryChunk*));
+        }
+        if(h->chunksSize == h->chunksCapacity) {
+            size_t newCapacity = h->chunksCapacity == 0 ? 4 : h->chunksCapacity * 2;
+            HistoryChunk **newChunks = UA_realloc(h->chunks, newCapacity * sizeof(HistoryChunk*));
+            if(!newChunks)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            h->chunks = newChunks;
+            h->chunksCapacity = newCapacity;
+        }
+        c = UA_calloc(1, sizeof(HistoryChunk));
+        if(!c)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        h->chunks[h->chunksSize++] = c;
+    }
+    encodeSample(c, time, value, status);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+recordValue(UA_Server *server, UA_NodeHistory *h, const UA_DataValue *value) {
+    UA_DateTime time = value->hasSourceTimestamp ? value->sourceTimestamp : UA_Server_now(server);
+    UA_StatusCode status = value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+    UA_UInt64 bits = 0;
+    if(isBad(status)) {
+        /* Repeat the previous value. It is not returned. */
+        if(h->chunksSize > 0)
+            bits = h->chunks[h->chunksSize - 1]->lastValue;
+    } else {
+        const UA_Variant *v = &value->value;
+        if(!value->hasValue || !UA_Variant_isScalar(v) || !isHistorizableType(v->type))
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        if(!h->type)
+            h->type = v->type;
+        else if(h->type != v->type)
+            return UA_STATUSCODE_BADTYPEMISMATCH;
+        bits = valueToBits(v->data, v->type);
+    }
+    return appendSample(server, h, time, bits, status);
+}
+
+void UA_Server_recordHistory(UA_Server *server, const UA_NodeId *nodeId,
+                             const UA_DataValue *value) {
+    if(server->historyCount == 0)
+        return;
+    UA_LOCK_HISTORY(server);
+    UA_NodeHistory *h = findHistory(server, nodeId);
+    if(h)
+        recordValue(server, h, value);
+    UA_UNLOCK_HISTORY(server);
+}
+
+void UA_Server_historizeNode(UA_Server *server, const UA_NodeId *nodeId,
+                             UA_Boolean historizing) {
+    UA_LOCK_HISTORY(server);
+    UA_NodeHistory *h = findHistory(server, nodeId);
+    if(!historizing) {
+        if(h) {
+            LIST_REMOVE(h, indexEntry);
+            server->historyCount--;
+            deleteNodeHistory(h);
+        }
+        UA_UNLOCK_HISTORY(server);
+        return;
+    }
+    if(h || (server->historyCount >= server->historySize &&
+             growHistory(server) != UA_STATUSCODE_GOOD)) {
+        UA_UNLOCK_HISTORY(server);
+        return;
+    }
+    h = UA_calloc(1, sizeof(UA_NodeHistory));
+    if(h && UA_NodeId_copy(nodeId, &h->nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(h);
+        h = NULL;
+    }
+    if(!h) {
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Out of memory. The values of a historizing node are not recorded.");
+        UA_UNLOCK_HISTORY(server);
+        return;
+    }
+    LIST_INSERT_HEAD(&server->history[historyBucket(server, nodeId)], h, indexEntry);
+    server->historyCount++;
+    UA_UNLOCK_HISTORY(server);
+}
+
+/* The values of variables with a variant value source are recorded when they
+ * are written. Data sources and bound memory are sampled. */
+static void sampleHistory(UA_Server *server, void *_) {
+    if(server->historyCount == 0)
+        return;
+    UA_ReadValueId rvid;
+    UA_ReadValueId_init(&rvid);
+    rvid.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_LOCK_HISTORY(server);
+    for(size_t i = 0; i < server->historySize; i++) {
+        UA_NodeHistory *h;
+        LIST_FOREACH(h, &server->history[i], indexEntry) {
+            const UA_VariableNode *node =
+                (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &h->nodeId);
+            if(!node || node->nodeClass != UA_NODECLASS_VARIABLE ||
+               node->valueSource == UA_VALUESOURCE_VARIANT)
+                continue;
+            UA_DataValue value;
+            UA_DataValue_init(&value);
+            rvid.nodeId = h->nodeId;
+            Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_SOURCE, &rvid, &value);
+            recordValue(server, h, &value);
+            UA_DataValue_deleteMembers(&value);
+        }
+    }
+    UA_UNLOCK_HISTORY(server);
+}
+
+void UA_Server_initHistory(UA_Server *server) {
+    server->history = NULL;
+    server->historySize = 0;
+    server->historyCount = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&server->historyLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+    if(server->config.historySamplingInterval == 0)
+        return;
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = sampleHistory, .data = NULL} };
+    UA_Server_addRepeatedJob(server, job, server->config.historySamplingInterval, NULL);
+}
+
+void UA_Server_deleteHistory(UA_Server *server) {
+    for(size_t i = 0; i < server->historySize; i++) {
+        UA_NodeHistory *h, *h_tmp;
+        LIST_FOREACH_SAFE(h, &server->history[i], indexEntry, h_tmp) {
+            LIST_REMOVE(h, indexEntry);
+            deleteNodeHistory(h);
+        }
+    }
+    UA_free(server->history);
+    server->history = NULL;
+    server->historySize = 0;
+    server->historyCount = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&server->historyLock);
+#endif
+}
+
+/***************/
+/* HistoryRead */
+/***************/
+
+/* The continuation points are stateless. They contain the timestamp of the
+ * last returned value and the number of returned values with that timestamp. */
+#define UA_HISTORY_CONTINUATIONPOINTLENGTH 12
+
+typedef struct {
+    UA_DateTime lower; /* inclusive */
+    UA_DateTime upper; /* inclusive */
+    UA_Boolean reverse;
+    UA_UInt32 maxValues; /* 0 is unlimited */
+    UA_TimestampsToReturn timestamps;
+    const UA_DataType *type;
+
+    /* Continue after the values of a continuation point */
+    UA_Boolean resume;
+    UA_DateTime resumeTime;
+    UA_UInt32 resumeSkip;
+    UA_UInt32 resumeSkipped;
+
+    /* Output */
+    size_t valuesSize;
+    size_t valuesCapacity;
+    UA_DataValue *values;
+    UA_DateTime lastTime;
+    UA_UInt32 lastTimeCount; /* returned values with the last timestamp */
+    UA_Boolean moreData;
+} HistoryReadContext;
+
+static UA_StatusCode
+addResultValue(HistoryReadContext *ctx, const HistorySample *s) {
+    if(ctx->valuesSize == ctx->valuesCapacity) {
+        size_t newCapacity = ctx->valuesCapacity == 0 ? 16 : ctx->valuesCapacity * 2;
+        if(ctx->maxValues > 0 && newCapacity > ctx->maxValues)
+            newCapacity = ctx->maxValues;
+        UA_DataValue *newValues = UA_realloc(ctx->values, newCapacity * sizeof(UA_DataValue));
+        if(!newValues)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        ctx->values = newValues;
+        ctx->valuesCapacity = newCapacity;
+    }
+    UA_DataValue *dv = &ctx->values[ctx->valuesSize];
+    UA_DataValue_init(dv);
+    if(!isBad(s->status)) {
+        void *data = UA_new(ctx->type);
+        if(!data)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        bitsToValue(s->value, data, ctx->type);
+        UA_Variant_setScalar(&dv->value, data, ctx->type);
+        dv->hasValue = true;
+    }
+    if(s->status != UA_STATUSCODE_GOOD) {
+        dv->status = s->status;
+        dv->hasStatus = true;
+    }
+    if(ctx->timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
+       ctx->timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
+        dv->sourceTimestamp = s->time;
+        dv->hasSourceTimestamp = true;
+    }
+    if(ctx->timestamps == UA_TIMESTAMPSTORETURN_SERVER ||
+       ctx->timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
+        dv->serverTimestamp = s->time;
+        dv->hasServerTimestamp = true;
+    }
+    ctx->valuesSize++;
+
+    if(ctx->valuesSize > 1 && s->time == ctx->lastTime)
+        ctx->lastTimeCount++;
+    else
+        ctx->lastTimeCount = 1 + ((ctx->resume && s->time == ctx->resumeTime) ? ctx->resumeSkip : 0);
+    ctx->lastTime = s->time;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns false when no further samples are needed */
+static UA_Boolean
+visitSample(HistoryReadContext *ctx, const HistorySample *s, UA_StatusCode *retval) {
+    if(s->time < ctx->lower || s->time > ctx->upper)
+        return ctx->reverse ? s->time > ctx->upper : s->time < ctx->lower;
+    if(ctx->resume && s->time == ctx->resumeTime && ctx->resumeSkipped < ctx->resumeSkip) {
+        /* Returned before the continuation point */
+        ctx->resumeSkipped++;
+        return true;
+    }
+    if(ctx->maxValues > 0 && ctx->valuesSize >= ctx->maxValues) {
+        ctx->moreData = true;
+        return false;
+    }
+    *retval = addResultValue(ctx, s);
+    return *retval == UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+readChunks(const UA_NodeHistory *h, HistoryReadContext *ctx) {
+    if(h->chunksSize == 0)
+        return UA_STATUSCODE_GOOD;
+    HistorySample *samples = UA_malloc(sizeof(HistorySample) * UA_HISTORY_MAXSAMPLES);
+    if(!samples)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+
+    /* Binary search for the first chunk that can contain a sample in the range.
+     * Forward, that is the first chunk that ends at the lower bound or later.
+     * Reverse, that is the last chunk that begins at the upper bound or
+     * earlier. */
+    size_t low = 0, high = h->chunksSize;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        UA_Boolean before = ctx->reverse ? h->chunks[mid]->firstTime <= ctx->upper
+                                         : h->chunks[mid]->lastTime < ctx->lower;
+        if(before)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_Boolean more = true;
+    if(!ctx->reverse) {
+        for(size_t i = low; i < h->chunksSize && more; i++) {
+            const HistoryChunk *c = h->chunks[i];
+            if(c->firstTime > ctx->upper)
+                break;
+            decodeChunk(c, samples);
+            for(size_t j = 0; j < c->samples && more; j++)
+                more = visitSample(ctx, &samples[j], &retval);
+        }
+    } else {
+        for(size_t i = low; i > 0 && more; i--) {
+            const HistoryChunk *c = h->chunks[i - 1];
+            if(c->lastTime < ctx->lower)
+                break;
+            decodeChunk(c, samples);
+            for(size_t j = c->samples; j > 0 && more; j--)
+                more = visitSample(ctx, &samples[j - 1], &retval);
+        }
+    }
+    UA_free(samples);
+    return retval;
+}
+
+static UA_StatusCode
+setupContext(const UA_ReadRawModifiedDetails *details, UA_TimestampsToReturn timestamps,
+             HistoryReadContext *ctx) {
+    memset(ctx, 0, sizeof(HistoryReadContext));
+    ctx->timestamps = timestamps;
+    ctx->maxValues = details->numValuesPerNode;
+    UA_DateTime start = details->startTime;
+    UA_DateTime end = details->endTime;
+    if(start == 0 && end == 0)
+        return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+    if(start == 0 || end == 0) {
+        /* An open interval needs a limit */
+        if(ctx->maxValues == 0)
+            return UA_STATUSCODE_BADHISTORYOPERATIONINVALID;
+        ctx->reverse = (start == 0);
+        ctx->lower = (start == 0) ? INT64_MIN : start;
+        ctx->upper = (start == 0) ? end : INT64_MAX;
+        return UA_STATUSCODE_GOOD;
+    }
+    ctx->reverse = (start > end);
+    ctx->lower = ctx->reverse ? end : start;
+    ctx->upper = ctx->reverse ? start : end;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+decodeContinuationPoint(const UA_ByteString *cp, HistoryReadContext *ctx) {
+    if(cp->length != UA_HISTORY_CONTINUATIONPOINTLENGTH)
+        return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    size_t offset = 0;
+    UA_StatusCode retval = UA_decodeBinary(cp, &offset, &ctx->resumeTime, &UA_TYPES[UA_TYPES_DATETIME]);
+    retval |= UA_decodeBinary(cp, &offset, &ctx->resumeSkip, &UA_TYPES[UA_TYPES_UINT32]);
+    if(retval != UA_STATUSCODE_GOOD || ctx->resumeTime < ctx->lower || ctx->resumeTime > ctx->upper)
+        return UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+    ctx->resume = true;
+    /* Values beyond the continuation point were returned */
+    if(ctx->reverse)
+        ctx->upper = ctx->resumeTime;
+    else
+        ctx->lower = ctx->resumeTime;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+encodeContinuationPoint(const HistoryReadContext *ctx, UA_ByteString *cp) {
+    UA_StatusCode retval = UA_ByteString_allocBuffer(cp, UA_HISTORY_CONTINUATIONPOINTLENGTH);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    size_t offset = 0;
+    retval = UA_encodeBinary(&ctx->lastTime, &UA_TYPES[UA_TYPES_DATETIME], NULL, NULL, cp, &offset);
+    retval |= UA_encodeBinary(&ctx->lastTimeCount, &UA_TYPES[UA_TYPES_UINT32], NULL, NULL, cp, &offset);
+    return retval;
+}
+
+static void
+readRawHistory(UA_Server *server, const UA_ReadRawModifiedDetails *details,
+               UA_TimestampsToReturn timestamps, const UA_HistoryReadValueId *id,
+               UA_HistoryReadResult *result) {
+    if(id->indexRange.length > 0) {
+        result->statusCode = UA_STATUSCODE_BADINDEXRANGENODATA;
+        return;
+    }
+    HistoryReadContext ctx;
+    result->statusCode = setupContext(details, timestamps, &ctx);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        return;
+    if(id->continuationPoint.length > 0) {
+        result->statusCode = decodeContinuationPoint(&id->continuationPoint, &ctx);
+        if(result->statusCode != UA_STATUSCODE_GOOD)
+            return;
+    }
+
+    UA_LOCK_HISTORY(server);
+    UA_NodeHistory *h = findHistory(server, &id->nodeId);
+    if(!h) {
+        UA_UNLOCK_HISTORY(server);
+        if(!UA_NodeStore_get(server->nodestore, &id->nodeId))
+            result->statusCode = UA_STATUSCODE_BADNODEIDUNKNOWN;
+        else
+            result->statusCode = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+        return;
+    }
+    ctx.type = h->type;
+    result->statusCode = readChunks(h, &ctx);
+    UA_UNLOCK_HISTORY(server);
+
+    UA_HistoryData *data = UA_HistoryData_new();
+    if(!data && result->statusCode == UA_STATUSCODE_GOOD)
+        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+    if(result->statusCode == UA_STATUSCODE_GOOD && ctx.moreData)
+        result->statusCode = encodeContinuationPoint(&ctx, &result->continuationPoint);
+    if(result->statusCode != UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < ctx.valuesSize; i++)
+            UA_DataValue_deleteMembers(&ctx.values[i]);
+        UA_free(ctx.values);
+        UA_HistoryData_delete(data);
+        return;
+    }
+
+    data->dataValuesSize = ctx.valuesSize;
+    data->dataValues = ctx.values;
+    if(ctx.valuesSize == 0) {
+        UA_free(ctx.values);
+        data->dataValues = NULL;
+        if(!ctx.moreData)
+            result->statusCode = UA_STATUSCODE_GOODNODATA;
+    }
+    result->historyData.encoding = UA_EXTENSIONOBJECT_DECODED;
+    result->historyData.content.decoded.type = &UA_TYPES[UA_TYPES_HISTORYDATA];
+    result->historyData.content.decoded.data = data;
+}
+
+void Service_HistoryRead(UA_Server *server, UA_Session *session,
+                         const UA_HistoryReadRequest *request,
+                         UA_HistoryReadResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing HistoryReadRequest");
+    if(request->nodesToReadSize <= 0) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
+        return;
+    }
+    if(request->timestampsToReturn >= UA_TIMESTAMPSTORETURN_NEITHER) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADTIMESTAMPSTORETURNINVALID;
+        return;
+    }
+    const UA_ExtensionObject *details = &request->historyReadDetails;
+    if((details->encoding != UA_EXTENSIONOBJECT_DECODED &&
+        details->encoding != UA_EXTENSIONOBJECT_DECODED_NODELETE) ||
+       details->content.decoded.type != &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS]) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+        return;
+    }
+    const UA_ReadRawModifiedDetails *raw = details->content.decoded.data;
+    if(raw->isReadModified || raw->returnBounds) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED;
+        return;
+    }
+
+    response->results = UA_Array_new(request->nodesToReadSize, &UA_TYPES[UA_TYPES_HISTORYREADRESULT]);
+    if(!response->results) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    response->resultsSize = request->nodesToReadSize;
+    for(size_t i = 0; i < request->nodesToReadSize; i++) {
+        /* The continuation points are stateless. Nothing to release. */
+        if(request->releaseContinuationPoints)
+            continue;
+        readRawHistory(server, raw, request->timestampsToReturn,
+                       &request->nodesToRead[i], &response->results[i]);
+    }
+}
+
+#endif /* UA_ENABLE_HISTORIZING */
@@ -23,49 +23,152 @@ typedef struct UA_ExternalNamespace {
 #endif
 
 #ifdef UA_ENABLE_MULTITHREADING
+#define UA_EPOCHS 4 /* the dispatched batches are counted per epoch modulo UA_EPOCHS */
+
+/* Delayed jobs retired by a thread that wait for the reclamation */
+struct LimboBlock;
+typedef struct {
+    struct LimboBlock *blocks; /* newest first */
+    struct LimboBlock *spare; /* kept for reuse */
+    size_t count; /* number of entries in the blocks */
+} UA_Limbo;
+
 typedef struct {
     UA_Server *server;
+    UA_ServerNetworkLayer *networkLayer; /* driven by the thread if it is a reactor */
     pthread_t thr;
-    UA_UInt32 counter;
     volatile UA_Boolean running;
-    char padding[64 - sizeof(void*) - sizeof(pthread_t) -
-                 sizeof(UA_UInt32) - sizeof(UA_Boolean)]; // separate cache lines
+    UA_Boolean sleeping; /* waiting on the condition for work in the own queue */
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    /* Dispatch queues of the worker, one per job priority. Other workers
+     * steal from them when idle. */
+    struct {
+        struct cds_wfcq_head head;
+        struct cds_wfcq_tail tail;
+    } lanes[UA_JOBPRIORITY_COUNT];
+    UA_UInt16 realtimeBatches; /* realtime batches processed in a row */
+    /* connection-affine jobs, filled by the main loop */
+    struct DispatchJobsList *openSlots[UA_JOBPRIORITY_COUNT];
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    UA_UInt64 takenBatches; /* taken from any queue, for the queue depth */
+    UA_JobStatistics statistics; /* written only by the worker thread */
+#endif
+    UA_Limbo limbo; /* accessed only by the worker thread */
+    UA_DateTime now; /* wall clock time, taken once per batch */
+    char padding[64]; // separate cache lines of neighboring workers
 } UA_Worker;
 #endif
 
 struct UA_Server {
     /* Meta */
     UA_DateTime startTime;
+    UA_DateTime now; /* Wall clock time, taken once per iteration of the main
+                        loop. Read with UA_Server_now. */
     size_t endpointDescriptionsSize;
     UA_EndpointDescription *endpointDescriptions;
 
+    /* Discovery responses that are encoded when the server starts. Every
+     * endpoint is encoded behind its endpointUrl, so that the url can be
+     * replaced with the one in the request. */
+    UA_ByteString encodedServers;
+    UA_ByteString *encodedEndpoints; /* endpointDescriptionsSize entries */
+
     /* Security */
     UA_SecureChannelManager secureChannelManager;
     UA_SessionManager sessionManager;
 
     /* Address Space */
     UA_NodeStore *nodestore;
+    struct UA_ReferenceTypeIndex *referenceTypeIndex; /* built on demand */
+    UA_UInt32 referenceTypeIndexVersion; /* incremented with every invalidation */
+    UA_UInt32 browseNameVersion; /* of the browse name indices of the nodes */
+    UA_UInt32 methodArgumentsVersion; /* of the argument caches of the methods */
+    UA_Boolean batchReadSources; /* a data source with readBatch was added */
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* The samplers of the monitored items of all sessions. Hash index over the
+       nodeids of the samplers. */
+    LIST_HEAD(UA_ListOfSamplingGroups, UA_SamplingGroup) samplingGroups;
+    LIST_HEAD(SamplersBucket, UA_Sampler) *samplers;
+    size_t samplersSize; /* always a power of two */
+    size_t samplersCount;
+    size_t notifiedSamplers;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t samplersLock; /* recursive */
+#endif
+#endif
+
+#ifdef UA_ENABLE_HISTORIZING
+    /* The recorded values of the historizing variables. Hash index over the
+       nodeids. */
+    LIST_HEAD(HistoryBucket, UA_NodeHistory) *history;
+    size_t historySize; /* always a power of two */
+    size_t historyCount;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t historyLock; /* recursive */
+#endif
+#endif
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+    /* The access counters of the nodes. Hash index over the nodeids. */
+    LIST_HEAD(NodeCountersBucket, NodeCounters) *nodeStatistics;
+    size_t nodeStatisticsSize; /* always a power of two */
+    size_t nodeStatisticsCount;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t nodeStatisticsLock;
+#endif
+#endif
+
+    /* Value publishers that send the values of nodes in a repeated job */
+    LIST_HEAD(UA_ListOfValuePublishers, UA_ValuePublisher) valuePublishers;
 
     size_t namespacesSize;
     UA_String *namespaces;
+    UA_Variant namespacesValue; /* shared with the reads of the NamespaceArray */
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     size_t externalNamespacesSize;
     UA_ExternalNamespace *externalNamespaces;
+    /* Indexed by the namespace index. Contains the position in
+       externalNamespaces plus one, or zero for the local nodestore. */
+    UA_UInt16 *externalNamespaceTable;
+    size_t externalNamespaceTableSize;
 #endif
      
-    /* Jobs with a repetition interval */
-    LIST_HEAD(RepeatedJobsList, RepeatedJobs) repeatedJobs;
+    /* Jobs with a repetition interval. The jobs are stored in a binary
+       min-heap ordered by the next execution time. Jobs with an id are also
+       contained in a hash index over the guid. */
+    struct RepeatedJob **repeatedJobs;
+    size_t repeatedJobsSize;
+    size_t repeatedJobsCapacity;
+    LIST_HEAD(RepeatedJobsBucket, RepeatedJob) *repeatedJobsIndex;
+    size_t repeatedJobsIndexSize; /* always a power of two */
+    size_t repeatedJobsIndexCount;
     
 #ifdef UA_ENABLE_MULTITHREADING
-    /* Dispatch queue head for the worker threads (the tail should not be in the same cache line) */
-    struct cds_wfcq_head dispatchQueue_head;
     UA_Worker *workers; /* there are nThread workers in a running server */
+    UA_Worker *reactors; /* one per network layer if the reactors are enabled */
+    UA_UInt16 dispatchWorker; /* next worker for round-robin dispatch */
+    struct DispatchJobsList *dispatchSlots; /* preallocated at startup */
+    struct cds_lfs_stack freeDispatchSlots;
+    struct DispatchJobsList *openDispatchSlots[UA_JOBPRIORITY_COUNT]; /* filled by the main loop */
     struct cds_lfs_stack mainLoopJobs; /* Work that shall be executed only in the main loop and not
                                           by worker threads */
-    struct DelayedJobs *delayedJobs;
-    pthread_cond_t dispatchQueue_condition; /* so the workers don't spin if the queue is empty */
-    struct cds_wfcq_tail dispatchQueue_tail; /* Dispatch queue tail for the worker threads */
+
+    /* Epoch-based reclamation of the delayed jobs */
+    UA_UInt32 epoch; /* advanced only by the main loop */
+    UA_UInt32 inflightBatches[UA_EPOCHS]; /* dispatched and not yet finished */
+    UA_Limbo limbo; /* of the main loop */
+    struct cds_lfs_stack orphanedLimbo; /* limbo blocks passed on by the workers */
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    UA_UInt64 enqueuedBatches; /* written only by the main loop */
+#endif
+#endif
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    UA_SchedulerStatistics statistics;
+#endif
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    UA_ServiceStatistics *serviceStatistics; /* indexed like UA_Services */
 #endif
 
     /* Config is the last element so that MSVC allows the usernamePasswordLogins
@@ -80,10 +183,246 @@ typedef UA_StatusCode (*UA_EditNodeCallback)(UA_Server*, UA_Session*, UA_Node*,
 UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
                                  UA_EditNodeCallback callback, const void *data);
 
+/* Calls run for the parts 0 to parts-1. The parts are taken by the worker
+ * threads and by the calling thread. Returns when all parts are done. Without
+ * multithreading or when the server does not run, the calling thread runs all
+ * parts. Call with the RCU lock held. */
+typedef void (*UA_Server_partRunner)(void *handle, size_t part);
+
+void UA_Server_runParallel(UA_Server *server, UA_Server_partRunner run, void *handle, size_t parts);
+
+/* Services split requests into parts of this many operations for
+ * UA_Server_runParallel */
+#define UA_SERVER_PARALLEL_PARTSIZE 256
+
+/* Visits every node of the nodestore on the worker threads. The nodestore is
+ * split into handlesSize partitions. Every partition is visited with its own
+ * handle. So the visitor needs no synchronization as long as it writes only to
+ * the handle. The calling thread visits partitions as well and returns when all
+ * partitions are done. Then, reduce (if not NULL) is called on the calling
+ * thread with every handle to merge the partial results. Without
+ * multithreading or when the server does not run, the calling thread visits
+ * all partitions. Call with the RCU lock held. */
+typedef void (*UA_Server_nodeReducer)(void *result, void *handle);
+
+UA_StatusCode
+UA_Server_iterateNodesParallel(UA_Server *server, UA_NodeStore_nodeVisitor visitor,
+                               void **handles, size_t handlesSize,
+                               UA_Server_nodeReducer reduce, void *result);
+
+/* Runs the callback in a server thread. Can be called from any thread with
+ * multithreading. Without multithreading, the callback runs right away. */
+UA_StatusCode
+UA_Server_dispatchCallback(UA_Server *server, UA_ServerCallback callback, void *data);
+
+/* Reads from asynchronous data sources that belong to the same request or
+ * sampling pass are collected in a batch. pending counts the outstanding reads
+ * plus one reference that is held while the batch is set up. The finish
+ * callback runs in a server thread when the count drops to zero. */
+typedef struct UA_AsyncReadBatch UA_AsyncReadBatch;
+typedef void (*UA_AsyncReadBatch_finish)(UA_Server *server, UA_AsyncReadBatch *batch);
+
+struct UA_AsyncReadBatch {
+    UA_UInt32 pending;
+    UA_AsyncReadBatch_finish finish;
+};
+
+struct UA_AsyncRead {
+    UA_AsyncReadBatch *batch;
+    UA_DataValue *target;
+    UA_TimestampsToReturn timestamps;
+};
+
+void UA_AsyncReadBatch_init(UA_AsyncReadBatch *batch, UA_AsyncReadBatch_finish finish);
+
+/* Drops the setup reference. Finishes the batch right away if no read is
+ * pending anymore. */
+void UA_AsyncReadBatch_release(UA_Server *server, UA_AsyncReadBatch *batch);
+
+/* Reads from data sources with a readBatch callback. The items are grouped by
+ * the data source. Every group is read with a single call. The result of an
+ * item is moved into its target. */
+typedef struct {
+    const UA_VariableNode *node;
+    UA_TimestampsToReturn timestamps;
+    UA_DataValue *target;
+} UA_BatchReadItem;
+
+/* Returns the node if the attribute is read with the readBatch callback of a
+ * data source. Call with the RCU lock held. */
+const UA_VariableNode *
+UA_Server_getBatchReadNode(UA_Server *server, const UA_NodeId *nodeId,
+                           UA_UInt32 attributeId, const UA_String *indexRange);
+
+/* The items are reordered */
+void UA_Server_readBatched(UA_Server *server, UA_BatchReadItem *items, size_t itemsSize);
+
+/* Closure of the HasSubtype hierarchy of the reference types. Every reference
+ * type has a dense index, its position in the sorted array of the reference
+ * type ids. Row i of the closure is a bitset of the types that are either i or
+ * a subtype of i. The index is built on demand and not changed afterwards.
+ * Changes to the hierarchy drop it and the next lookup rebuilds it. */
+typedef struct UA_ReferenceTypeIndex {
+    size_t typesSize;
+    UA_NodeId *types; /* ordered with UA_NodeId_order */
+    size_t rowSize; /* UA_UInt32 words per row of the closure */
+    UA_UInt32 *closure;
+} UA_ReferenceTypeIndex;
+
+/* Returns the index and builds it if required. Returns NULL if out of memory.
+ * Call with the RCU lock held. The index can be used until the lock is
+ * released. */
+const UA_ReferenceTypeIndex * UA_Server_getReferenceTypeIndex(UA_Server *server);
+
+/* Call after server->namespaces changed. Rebuilds the shared value that is
+ * returned for reads of the NamespaceArray. */
+void UA_Server_updateNamespacesValue(UA_Server *server);
+
+/* Call after a ReferenceType node or its HasSubtype references changed */
+void UA_Server_invalidateReferenceTypeIndex(UA_Server *server);
+
+void UA_ReferenceTypeIndex_delete(UA_ReferenceTypeIndex *rti);
+
+/* Outdates the browse name indices of all nodes. Call when the browse name of
+ * a node may have changed without a change to the references that point to
+ * it. */
+void UA_Server_invalidateBrowseNameIndices(UA_Server *server);
+
+/* Outdates the cached argument definitions of all methods. Call when the value
+ * or browse name of an argument property may have changed. */
+void UA_Server_invalidateMethodArguments(UA_Server *server);
+
+/* Whether the node is the InputArguments or OutputArguments property of a
+ * method */
+UA_Boolean UA_Node_isMethodArguments(const UA_Node *node);
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+/* Call after the value of a node was written. The monitored items on the value
+ * take a sample. With a NULL nodeid, all notified items take a sample. */
+void UA_Server_notifyValueWrite(UA_Server *server, const UA_NodeId *nodeId);
+
+/* Notifies the monitored items of all nodes with a good result at once */
+void UA_Server_notifyValueWrites(UA_Server *server, const UA_NodeId *nodeIds,
+                                 const UA_StatusCode *results, size_t size);
+
+/* Call when the value of a node may change without a write (a data source or
+ * an onRead callback was set). The monitored items on the value are polled
+ * from then on. */
+void UA_Server_pollValueWatchers(UA_Server *server, const UA_NodeId *nodeId);
+
+void UA_Server_initSamplers(UA_Server *server);
+
+/* Call after all sessions are deleted */
+void UA_Server_deleteSamplers(UA_Server *server);
+#endif
+
+/* Encodes the discovery responses after the network layers have started */
+void UA_Server_buildDiscoveryCache(UA_Server *server);
+void UA_Server_deleteDiscoveryCache(UA_Server *server);
+
+struct UA_ValuePublisher;
+typedef struct UA_ValuePublisher UA_ValuePublisher;
+
+#ifdef UA_ENABLE_HISTORIZING
+struct UA_NodeHistory;
+typedef struct UA_NodeHistory UA_NodeHistory;
+
+/* Call when the Historizing attribute of a variable was set. The values of the
+ * variable are recorded from then on. Without historizing, the recorded values
+ * are dropped. */
+void UA_Server_historizeNode(UA_Server *server, const UA_NodeId *nodeId,
+                             UA_Boolean historizing);
+
+/* Call after the value of a node was written. Recorded only if the node
+ * historizes its values. */
+void UA_Server_recordHistory(UA_Server *server, const UA_NodeId *nodeId,
+                             const UA_DataValue *value);
+
+/* Adds the repeated job that samples the data sources */
+void UA_Server_initHistory(UA_Server *server);
+void UA_Server_deleteHistory(UA_Server *server);
+#endif
+
+/* Call after the repeated jobs are deleted */
+void UA_Server_deleteValuePublishers(UA_Server *server);
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+typedef enum {
+    UA_NODEACCESS_READ,
+    UA_NODEACCESS_WRITE,
+    UA_NODEACCESS_MONITOREDITEM,
+    UA_NODEACCESS_BROWSE
+} UA_NodeAccess;
+
+/* Call only for nodes that exist. Otherwise counters are created for nodeids
+ * that the clients make up. */
+void UA_Server_countNodeAccess(UA_Server *server, const UA_NodeId *nodeId,
+                               UA_NodeAccess access);
+
+/* Call when the node is deleted */
+void UA_Server_removeNodeStatistics(UA_Server *server, const UA_NodeId *nodeId);
+
+void UA_Server_initNodeStatistics(UA_Server *server);
+void UA_Server_deleteNodeStatistics(UA_Server *server);
+#endif
+
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+/* Returns NULL if the namespace is in the local nodestore */
+static UA_INLINE UA_ExternalNamespace *
+UA_Server_getExternalNamespace(const UA_Server *server, UA_UInt16 namespaceIndex) {
+    if(namespaceIndex >= server->externalNamespaceTableSize)
+        return NULL;
+    UA_UInt16 pos = server->externalNamespaceTable[namespaceIndex];
+    return pos > 0 ? &server->externalNamespaces[pos - 1] : NULL;
+}
+
+/* The items of a batched request that belong to one external namespace. They
+ * are handed to the external nodestore in a single call. */
+typedef struct {
+    UA_ExternalNodeStore *ens;
+    UA_UInt32 *indices;
+    UA_UInt32 indicesSize;
+} UA_ExternalRoute;
+
+typedef struct {
+    size_t routesSize;
+    UA_ExternalRoute *routes;
+    UA_Boolean *isExternal; /* NULL if all items are local */
+    UA_UInt32 *indices; /* the indices of all routes */
+} UA_ExternalRouting;
+
+/* Groups the items of a request by their external namespace in a single pass.
+ * The NodeId that decides the namespace is found at nodeIdOffset in every item
+ * of itemSize bytes. Returns an error only if out of memory. */
+UA_StatusCode
+UA_ExternalRouting_init(UA_ExternalRouting *routing, const UA_Server *server,
+                        const void *items, size_t itemsSize, size_t itemSize,
+                        size_t nodeIdOffset);
+
+void UA_ExternalRouting_deleteMembers(UA_ExternalRouting *routing);
+#endif
+
+/* Returns the dense index of the reference type or typesSize if unknown */
+size_t UA_ReferenceTypeIndex_find(const UA_ReferenceTypeIndex *rti, const UA_NodeId *referenceTypeId);
+
+static UA_INLINE UA_Boolean
+UA_ReferenceTypeIndex_isSubtype(const UA_ReferenceTypeIndex *rti, size_t type, size_t root) {
+    const UA_UInt32 *row = &rti->closure[root * rti->rowSize];
+    return (row[type / 32] >> (type % 32)) & 1;
+}
+
 void UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection, const UA_ByteString *msg);
 
+/* The wall clock time of the current main loop iteration or worker batch. Use
+ * it where millisecond precision is enough, instead of UA_DateTime_now. */
+UA_DateTime UA_Server_now(const UA_Server *server);
+
 UA_StatusCode UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data);
 UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data);
+#ifdef UA_ENABLE_MULTITHREADING
+/* Runs all delayed callbacks. Call only when the server does not run. */
+void UA_Server_reclaimDelayed(UA_Server *server);
+#endif
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server);
 
 #ifdef UA_BUILD_UNIT_TESTS
@@ -0,0 +1,211 @@
+#include "ua_server_internal.h"
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+
+#define UA_NODESTATISTICS_MINBUCKETS 64 /* a power of two */
+
+/* The counters of a node. Created with the first access. */
+typedef struct NodeCounters {
+    LIST_ENTRY(NodeCounters) indexEntry;
+    UA_NodeStatistics stats;
+} NodeCounters;
+
+/* The lock protects the index and the counters. It is held only for the
+ * lookup and the increment. */
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_LOCK_NODESTATISTICS(server) pthread_mutex_lock(&(server)->nodeStatisticsLock)
+# define UA_UNLOCK_NODESTATISTICS(server) pthread_mutex_unlock(&(server)->nodeStatisticsLock)
+#else
+# define UA_LOCK_NODESTATISTICS(server)
+# define UA_UNLOCK_NODESTATISTICS(server)
+#endif
+
+static size_t countersBucket(const UA_Server *server, const UA_NodeId *nodeId) {
+    return (size_t)UA_NodeStore_hash(nodeId) & (server->nodeStatisticsSize - 1);
+}
+
+static NodeCounters *findCounters(UA_Server *server, const UA_NodeId *nodeId) {
+    if(server->nodeStatisticsCount == 0)
+        return NULL;
+    NodeCounters *c;
+    LIST_FOREACH(c, &server->nodeStatistics[countersBucket(server, nodeId)], indexEntry) {
+        if(UA_NodeId_equal(&c->stats.nodeId, nodeId))
+            return c;
+    }
+    return NULL;
+}
+
+static UA_StatusCode growCounters(UA_Server *server) {
+    size_t newSize = server->nodeStatisticsSize * 2;
+    if(newSize < UA_NODESTATISTICS_MINBUCKETS)
+        newSize = UA_NODESTATISTICS_MINBUCKETS;
+    struct NodeCountersBucket *newIndex = UA_malloc(newSize * sizeof(struct NodeCountersBucket));
+    if(!newIndex)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < newSize; i++)
+        LIST_INIT(&newIndex[i]);
+
+    struct NodeCountersBucket *oldIndex = server->nodeStatistics;
+    size_t oldSize = server->nodeStatisticsSize;
+    server->nodeStatistics = newIndex;
+    server->nodeStatisticsSize = newSize;
+    for(size_t i = 0; i < oldSize; i++) {
+        NodeCounters *c, *c_tmp;
+        LIST_FOREACH_SAFE(c, &oldIndex[i], indexEntry, c_tmp) {
+            LIST_REMOVE(c, indexEntry);
+            LIST_INSERT_HEAD(&newIndex[countersBucket(server, &c->stats.nodeId)], c, indexEntry);
+        }
+    }
+    UA_free(oldIndex);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Returns the counters of the node. They are added with the first access. Call
+ * with the lock held. */
+static NodeCounters *addCounters(UA_Server *server, const UA_NodeId *nodeId) {
+    NodeCounters *c = findCounters(server, nodeId);
+    if(c)
+        return c;
+    if(server->nodeStatisticsCount >= server->nodeStatisticsSize &&
+       growCounters(server) != UA_STATUSCODE_GOOD)
+        return NULL;
+    c = UA_calloc(1, sizeof(NodeCounters));
+    if(!c)
+        return NULL;
+    if(UA_NodeId_copy(nodeId, &c->stats.nodeId) != UA_STATUSCODE_GOOD) {
+        UA_free(c);
+        return NULL;
+    }
+    LIST_INSERT_HEAD(&server->nodeStatistics[countersBucket(server, nodeId)], c, indexEntry);
+    server->nodeStatisticsCount++;
+    return c;
+}
+
+static void incrementCounter(NodeCounters *c, UA_NodeAccess access) {
+    UA_UInt64 *counter;
+    switch(access) {
+    case UA_NODEACCESS_READ: counter = &c->stats.reads; break;
+    case UA_NODEACCESS_WRITE: counter = &c->stats.writes; break;
+    case UA_NODEACCESS_MONITOREDITEM: counter = &c->stats.monitoredItems; break;
+    default: counter = &c->stats.browses; break;
+    }
+    (*counter)++;
+}
+
+void UA_Server_countNodeAccess(UA_Server *server, const UA_NodeId *nodeId,
+                               UA_NodeAccess access) {
+    UA_LOCK_NODESTATISTICS(server);
+    /* The access is not counted if there is no memory for the counters */
+    NodeCounters *c = addCounters(server, nodeId);
+    if(c)
+        incrementCounter(c, access);
+    UA_UNLOCK_NODESTATISTICS(server);
+}
+
+void UA_Server_removeNodeStatistics(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_LOCK_NODESTATISTICS(server);
+    NodeCounters *c = findCounters(server, nodeId);
+    if(c) {
+        LIST_REMOVE(c, indexEntry);
+        server->nodeStatisticsCount--;
+        UA_NodeId_deleteMembers(&c->stats.nodeId);
+        UA_free(c);
+    }
+    UA_UNLOCK_NODESTATISTICS(server);
+}
+
+static UA_UInt64 totalAccesses(const UA_NodeStatistics *s) {
+    return s->reads + s->writes + s->monitoredItems + s->browses;
+}
+
+static int compareStatistics(const void *a, const void *b) {
+    UA_UInt64 ta = totalAccesses((const UA_NodeStatistics*)a);
+    UA_UInt64 tb = totalAccesses((const UA_NodeStatistics*)b);
+    if(ta == tb)
+        return 0;
+    return ta > tb ? -1 : 1; /* the hottest first */
+}
+
+UA_StatusCode
+UA_Server_getHottestNodes(UA_Server *server, size_t maxNodes,
+                          UA_NodeStatistics **stats, size_t *statsSize) {
+    *stats = NULL;
+    *statsSize = 0;
+    UA_LOCK_NODESTATISTICS(server);
+    size_t count = server->nodeStatisticsCount;
+    if(count == 0 || maxNodes == 0) {
+        UA_UNLOCK_NODESTATISTICS(server);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* Take a snapshot of the counters. The nodeids are shallow copies until
+     * the hottest nodes are selected. */
+    UA_NodeStatistics *all = UA_malloc(count * sizeof(UA_NodeStatistics));
+    if(!all) {
+        UA_UNLOCK_NODESTATISTICS(server);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    size_t j = 0;
+    for(size_t i = 0; i < server->nodeStatisticsSize; i++) {
+        NodeCounters *c;
+        LIST_FOREACH(c, &server->nodeStatistics[i], indexEntry) {
+            all[j] = c->stats;
+            j++;
+        }
+    }
+    qsort(all, count, sizeof(UA_NodeStatistics), compareStatistics);
+
+    if(maxNodes > count)
+        maxNodes = count;
+    UA_NodeStatistics *hottest = UA_malloc(maxNodes * sizeof(UA_NodeStatistics));
+    UA_StatusCode retval = hottest ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADOUTOFMEMORY;
+    for(j = 0; j < maxNodes && retval == UA_STATUSCODE_GOOD; j++) {
+        hottest[j] = all[j];
+        retval = UA_NodeId_copy(&all[j].nodeId, &hottest[j].nodeId);
+    }
+    UA_UNLOCK_NODESTATISTICS(server);
+    UA_free(all);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(hottest)
+            UA_NodeStatistics_deleteArray(hottest, j - 1);
+        return retval;
+    }
+    *stats = hottest;
+    *statsSize = maxNodes;
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_NodeStatistics_deleteArray(UA_NodeStatistics *stats, size_t statsSize) {
+    for(size_t i = 0; i < statsSize; i++)
+        UA_NodeId_deleteMembers(&stats[i].nodeId);
+    UA_free(stats);
+}
+
+void UA_Server_initNodeStatistics(UA_Server *server) {
+    server->nodeStatistics = NULL;
+    server->nodeStatisticsSize = 0;
+    server->nodeStatisticsCount = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&server->nodeStatisticsLock, NULL);
+#endif
+}
+
+void UA_Server_deleteNodeStatistics(UA_Server *server) {
+    for(size_t i = 0; i < server->nodeStatisticsSize; i++) {
+        NodeCounters *c, *c_tmp;
+        LIST_FOREACH_SAFE(c, &server->nodeStatistics[i], indexEntry, c_tmp) {
+            LIST_REMOVE(c, indexEntry);
+            UA_NodeId_deleteMembers(&c->stats.nodeId);
+            UA_free(c);
+        }
+    }
+    UA_free(server->nodeStatistics);
+    server->nodeStatistics = NULL;
+    server->nodeStatisticsSize = 0;
+    server->nodeStatisticsCount = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&server->nodeStatisticsLock);
+#endif
+}
+
+#endif /* UA_ENABLE_NODE_STATISTICS */
@@ -0,0 +1,183 @@
+#include "ua_server_internal.h"
+#include "ua_services.h"
+#include "ua_types_encoding_binary.h"
+
+/* A value publisher encodes into a buffer that is allocated once. The header
+ * of the message is followed by the array of the values. */
+struct UA_ValuePublisher {
+    LIST_ENTRY(UA_ValuePublisher) listEntry;
+    UA_Guid guid; /* of the repeated job */
+    UA_UInt32 publisherId;
+    UA_UInt32 sequenceNumber;
+    UA_TimestampsToReturn timestamps;
+    UA_ValuePublisherTransport transport;
+    UA_ByteString buffer;
+    size_t valuesSize;
+    UA_DataValue *values;
+    size_t nodesSize;
+    UA_NodeId nodes[];
+};
+
+static void deleteValuePublisher(UA_ValuePublisher *vp) {
+    if(vp->transport.deleteMembers)
+        vp->transport.deleteMembers(vp->transport.handle);
+    UA_ByteString_deleteMembers(&vp->buffer);
+    UA_free(vp->values);
+    for(size_t i = 0; i < vp->nodesSize; i++)
+        UA_NodeId_deleteMembers(&vp->nodes[i]);
+    UA_free(vp);
+}
+
+static UA_StatusCode
+encodeMessage(UA_ValuePublisher *vp, UA_DateTime now, size_t *offset) {
+    UA_ByteString *buf = &vp->buffer;
+    UA_StatusCode retval = UA_encodeBinary(&vp->publisherId, &UA_TYPES[UA_TYPES_UINT32],
+                                           NULL, NULL, buf, offset);
+    retval |= UA_encodeBinary(&vp->sequenceNumber, &UA_TYPES[UA_TYPES_UINT32],
+                              NULL, NULL, buf, offset);
+    retval |= UA_encodeBinary(&now, &UA_TYPES[UA_TYPES_DATETIME], NULL, NULL, buf, offset);
+    UA_Int32 valuesSize = (UA_Int32)vp->valuesSize;
+    retval |= UA_encodeBinary(&valuesSize, &UA_TYPES[UA_TYPES_INT32], NULL, NULL, buf, offset);
+    for(size_t i = 0; i < vp->valuesSize && retval == UA_STATUSCODE_GOOD; i++)
+        retval = UA_encodeBinary(&vp->values[i], &UA_TYPES[UA_TYPES_DATAVALUE],
+                                 NULL, NULL, buf, offset);
+    return retval;
+}
+
+static void publishValues(UA_Server *server, UA_ValuePublisher *vp) {
+    /* Read the values like the samplers of the monitored items */
+    UA_ReadValueId rvid;
+    UA_ReadValueId_init(&rvid);
+    rvid.attributeId = UA_ATTRIBUTEID_VALUE;
+    for(size_t i = 0; i < vp->nodesSize; i++) {
+        rvid.nodeId = vp->nodes[i];
+        UA_DataValue_init(&vp->values[i]);
+        Service_Read_single(server, &adminSession, vp->timestamps, &rvid, &vp->values[i]);
+    }
+
+    size_t offset = 0;
+    UA_StatusCode retval = encodeMessage(vp, UA_Server_now(server), &offset);
+    for(size_t i = 0; i < vp->valuesSize; i++)
+        UA_DataValue_deleteMembers(&vp->values[i]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Value publisher %u skips a message. The values do not fit "
+                       "into %u bytes.", vp->publisherId, (unsigned)vp->buffer.length);
+        return;
+    }
+
+    UA_ByteString message = {offset, vp->buffer.data};
+    retval = vp->transport.send(vp->transport.handle, &message);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Value publisher %u could not send with status code 0x%08x",
+                       vp->publisherId, retval);
+    vp->sequenceNumber++;
+}
+
+UA_StatusCode
+UA_Server_addValuePublisher(UA_Server *server, UA_UInt32 publisherId,
+                            const UA_NodeId *nodes, size_t nodesSize,
+                            UA_UInt32 interval, UA_TimestampsToReturn timestamps,
+                            UA_ValuePublisherTransport transport, UA_Guid *publisherGuid) {
+    UA_ValuePublisher *vp = UA_malloc(sizeof(UA_ValuePublisher) + sizeof(UA_NodeId) * nodesSize);
+    if(!vp) {
+        if(transport.deleteMembers)
+            transport.deleteMembers(transport.handle);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    vp->publisherId = publisherId;
+    vp->sequenceNumber = 0;
+    vp->timestamps = timestamps;
+    vp->transport = transport;
+    vp->valuesSize = nodesSize;
+    vp->values = UA_malloc(sizeof(UA_DataValue) * nodesSize);
+    vp->nodesSize = 0;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(&vp->buffer, transport.maxMessageSize);
+    if(!vp->values && nodesSize > 0)
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    for(; vp->nodesSize < nodesSize && retval == UA_STATUSCODE_GOOD; vp->nodesSize++)
+        retval = UA_NodeId_copy(&nodes[vp->nodesSize], &vp->nodes[vp->nodesSize]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteValuePublisher(vp);
+        return retval;
+    }
+
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = (UA_ServerCallback)publishValues, .data = vp},
+                  .priority = UA_JOBPRIORITY_REALTIME };
+    retval = UA_Server_addRepeatedJob(server, job, interval, &vp->guid);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteValuePublisher(vp);
+        return retval;
+    }
+    LIST_INSERT_HEAD(&server->valuePublishers, vp, listEntry);
+    if(publisherGuid)
+        *publisherGuid = vp->guid;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_removeValuePublisher(UA_Server *server, const UA_Guid publisherGuid) {
+    UA_ValuePublisher *vp;
+    LIST_FOREACH(vp, &server->valuePublishers, listEntry) {
+        if(UA_Guid_equal(&vp->guid, &publisherGuid))
+            break;
+    }
+    if(!vp)
+        return UA_STATUSCODE_BADNOTFOUND;
+    LIST_REMOVE(vp, listEntry);
+    UA_Server_removeRepeatedJob(server, vp->guid);
+#ifndef UA_ENABLE_MULTITHREADING
+    deleteValuePublisher(vp);
+#else
+    /* the publish job may have been dispatched already */
+    UA_Server_delayedCallback(server, (UA_ServerCallback)deleteValuePublisher, vp);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_Server_deleteValuePublishers(UA_Server *server) {
+    UA_ValuePublisher *vp, *vp_tmp;
+    LIST_FOREACH_SAFE(vp, &server->valuePublishers, listEntry, vp_tmp) {
+        LIST_REMOVE(vp, listEntry);
+        deleteValuePublisher(vp);
+    }
+}
+
+UA_StatusCode
+UA_ValuePublisherMessage_decode(const UA_ByteString *message, UA_ValuePublisherMessage *msg) {
+    memset(msg, 0, sizeof(UA_ValuePublisherMessage));
+    size_t offset = 0;
+    UA_StatusCode retval = UA_decodeBinary(message, &offset, &msg->publisherId,
+                                           &UA_TYPES[UA_TYPES_UINT32]);
+    retval |= UA_decodeBinary(message, &offset, &msg->sequenceNumber, &UA_TYPES[UA_TYPES_UINT32]);
+    retval |= UA_decodeBinary(message, &offset, &msg->publishTime, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Int32 valuesSize = 0;
+    retval |= UA_decodeBinary(message, &offset, &valuesSize, &UA_TYPES[UA_TYPES_INT32]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    if(valuesSize <= 0)
+        return UA_STATUSCODE_GOOD;
+    /* every value takes at least one byte */
+    if((size_t)valuesSize > message->length - offset)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    msg->values = UA_Array_new((size_t)valuesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    if(!msg->values)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    msg->valuesSize = (size_t)valuesSize;
+    for(size_t i = 0; i < msg->valuesSize; i++) {
+        retval = UA_decodeBinary(message, &offset, &msg->values[i], &UA_TYPES[UA_TYPES_DATAVALUE]);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_ValuePublisherMessage_deleteMembers(msg);
+            return retval;
+        }
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_ValuePublisherMessage_deleteMembers(UA_ValuePublisherMessage *msg) {
+    UA_Array_delete(msg->values, msg->valuesSize, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    msg->values = NULL;
+    msg->valuesSize = 0;
+}
@@ -0,0 +1,379 @@
+#include "ua_server_internal.h"
+#include "ua_nodestore.h"
+#include "ua_types_encoding_binary.h"
+
+/* A snapshot starts with the magic number, the format version, the namespace
+ * array and the number of nodes. Every node is encoded as its nodeclass, the
+ * standard attributes, the references and the attributes of the nodeclass. */
+#define UA_SNAPSHOT_MAGIC 0x534e4155 /* "UANS" */
+#define UA_SNAPSHOT_VERSION 1
+
+/* Saving takes two passes. The first pass only sums up the size of the
+ * snapshot. The second pass encodes into a buffer of that size. */
+typedef struct {
+    UA_ByteString *buf; /* NULL when the size is computed */
+    size_t offset;
+    UA_UInt32 nodes;
+    UA_StatusCode retval;
+} SnapshotWriter;
+
+static void
+writeMember(SnapshotWriter *w, const void *p, const UA_DataType *type) {
+    if(w->retval != UA_STATUSCODE_GOOD)
+        return;
+    if(!w->buf) {
+        w->offset += UA_calcSizeBinary((void*)(uintptr_t)p, type);
+        return;
+    }
+    w->retval = UA_encodeBinary(p, type, NULL, NULL, w->buf, &w->offset);
+}
+
+static void
+writeVariableValue(SnapshotWriter *w, const UA_VariableNode *node) {
+    /* Data sources and bound memory cannot be saved. The node is restored with
+     * an empty value. */
+    UA_Variant value;
+    if(node->valueSource == UA_VALUESOURCE_VARIANT)
+        UA_VariableNode_getValue(node, &value);
+    else
+        UA_Variant_init(&value);
+    writeMember(w, &value, &UA_TYPES[UA_TYPES_VARIANT]);
+}
+
+static void writeNode(SnapshotWriter *w, const UA_Node *node) {
+    UA_Int32 nodeClass = (UA_Int32)node->nodeClass;
+    writeMember(w, &nodeClass, &UA_TYPES[UA_TYPES_INT32]);
+    writeMember(w, &node->nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+    writeMember(w, &node->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    writeMember(w, &node->displayName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    writeMember(w, &node->description, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    writeMember(w, &node->writeMask, &UA_TYPES[UA_TYPES_UINT32]);
+    writeMember(w, &node->userWriteMask, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_Int32 referencesSize = (UA_Int32)node->referencesSize;
+    writeMember(w, &referencesSize, &UA_TYPES[UA_TYPES_INT32]);
+    for(size_t i = 0; i < node->referencesSize; i++)
+        writeMember(w, &node->references[i], &UA_TYPES[UA_TYPES_REFERENCENODE]);
+
+    switch(node->nodeClass) {
+    case UA_NODECLASS_OBJECT: {
+        const UA_ObjectNode *on = (const UA_ObjectNode*)node;
+        writeMember(w, &on->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLE: {
+        const UA_VariableNode *vn = (const UA_VariableNode*)node;
+        writeMember(w, &vn->valueRank, &UA_TYPES[UA_TYPES_INT32]);
+        writeVariableValue(w, vn);
+        writeMember(w, &vn->accessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        writeMember(w, &vn->userAccessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        writeMember(w, &vn->minimumSamplingInterval, &UA_TYPES[UA_TYPES_DOUBLE]);
+        writeMember(w, &vn->historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_METHOD: {
+        const UA_MethodNode *mn = (const UA_MethodNode*)node;
+        writeMember(w, &mn->executable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeMember(w, &mn->userExecutable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE: {
+        const UA_ObjectTypeNode *otn = (const UA_ObjectTypeNode*)node;
+        writeMember(w, &otn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLETYPE: {
+        const UA_VariableTypeNode *vtn = (const UA_VariableTypeNode*)node;
+        writeMember(w, &vtn->valueRank, &UA_TYPES[UA_TYPES_INT32]);
+        writeVariableValue(w, (const UA_VariableNode*)vtn);
+        writeMember(w, &vtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        const UA_ReferenceTypeNode *rtn = (const UA_ReferenceTypeNode*)node;
+        writeMember(w, &rtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeMember(w, &rtn->symmetric, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        writeMember(w, &rtn->inverseName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE: {
+        const UA_DataTypeNode *dtn = (const UA_DataTypeNode*)node;
+        writeMember(w, &dtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VIEW: {
+        const UA_ViewNode *vn = (const UA_ViewNode*)node;
+        writeMember(w, &vn->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        writeMember(w, &vn->containsNoLoops, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    default:
+        w->retval = UA_STATUSCODE_BADINTERNALERROR;
+        break;
+    }
+    w->nodes++;
+}
+
+static void snapshotVisitor(void *handle, const UA_Node *node) {
+    writeNode((SnapshotWriter*)handle, node);
+}
+
+static void writeSnapshot(UA_Server *server, SnapshotWriter *w, UA_UInt32 nodes) {
+    UA_UInt32 magic = UA_SNAPSHOT_MAGIC;
+    UA_UInt32 version = UA_SNAPSHOT_VERSION;
+    writeMember(w, &magic, &UA_TYPES[UA_TYPES_UINT32]);
+    writeMember(w, &version, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_Int32 namespacesSize = (UA_Int32)server->namespacesSize;
+    writeMember(w, &namespacesSize, &UA_TYPES[UA_TYPES_INT32]);
+    for(size_t i = 0; i < server->namespacesSize; i++)
+        writeMember(w, &server->namespaces[i], &UA_TYPES[UA_TYPES_STRING]);
+    writeMember(w, &nodes, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_NodeStore_iterate(server->nodestore, snapshotVisitor, w);
+}
+
+UA_StatusCode
+UA_Server_saveSnapshot(UA_Server *server, UA_ByteString *snapshot) {
+    UA_ByteString_init(snapshot);
+    UA_RCU_LOCK();
+    SnapshotWriter w = {NULL, 0, 0, UA_STATUSCODE_GOOD};
+    writeSnapshot(server, &w, 0);
+    UA_StatusCode retval = w.retval;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_ByteString_allocBuffer(snapshot, w.offset);
+    if(retval == UA_STATUSCODE_GOOD) {
+        /* The nodes must not change between the passes */
+        UA_UInt32 nodes = w.nodes;
+        size_t size = w.offset;
+        w = (SnapshotWriter){snapshot, 0, 0, UA_STATUSCODE_GOOD};
+        writeSnapshot(server, &w, nodes);
+        retval = w.retval;
+        if(retval == UA_STATUSCODE_GOOD && (w.nodes != nodes || w.offset != size))
+            retval = UA_STATUSCODE_BADINTERNALERROR;
+    }
+    UA_RCU_UNLOCK();
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_ByteString_deleteMembers(snapshot);
+    return retval;
+}
+
+/*************/
+/* Restoring */
+/*************/
+
+static UA_StatusCode
+readNode(const UA_ByteString *src, size_t *offset, UA_Node **out) {
+    UA_Int32 nodeClass;
+    UA_StatusCode retval = UA_decodeBinary(src, offset, &nodeClass, &UA_TYPES[UA_TYPES_INT32]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_Node *node = UA_NodeStore_newNode((UA_NodeClass)nodeClass);
+    if(!node)
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+    retval |= UA_decodeBinary(src, offset, &node->nodeId, &UA_TYPES[UA_TYPES_NODEID]);
+    retval |= UA_decodeBinary(src, offset, &node->browseName, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    retval |= UA_decodeBinary(src, offset, &node->displayName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    retval |= UA_decodeBinary(src, offset, &node->description, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    retval |= UA_decodeBinary(src, offset, &node->writeMask, &UA_TYPES[UA_TYPES_UINT32]);
+    retval |= UA_decodeBinary(src, offset, &node->userWriteMask, &UA_TYPES[UA_TYPES_UINT32]);
+    UA_Int32 referencesSize = 0;
+    retval |= UA_decodeBinary(src, offset, &referencesSize, &UA_TYPES[UA_TYPES_INT32]);
+    /* Every reference takes more than one byte */
+    if(retval == UA_STATUSCODE_GOOD &&
+       (referencesSize < 0 || (size_t)referencesSize > src->length - *offset))
+        retval = UA_STATUSCODE_BADDECODINGERROR;
+    if(retval == UA_STATUSCODE_GOOD && referencesSize > 0) {
+        node->references = UA_Array_new((size_t)referencesSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+        if(!node->references)
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        else
+            node->referencesSize = (size_t)referencesSize;
+        for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; i++)
+            retval = UA_decodeBinary(src, offset, &node->references[i],
+                                     &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    }
+
+    switch(node->nodeClass) {
+    case UA_NODECLASS_OBJECT: {
+        UA_ObjectNode *on = (UA_ObjectNode*)node;
+        retval |= UA_decodeBinary(src, offset, &on->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLE: {
+        UA_VariableNode *vn = (UA_VariableNode*)node;
+        retval |= UA_decodeBinary(src, offset, &vn->valueRank, &UA_TYPES[UA_TYPES_INT32]);
+        retval |= UA_decodeBinary(src, offset, &vn->value.variant.value, &UA_TYPES[UA_TYPES_VARIANT]);
+        retval |= UA_decodeBinary(src, offset, &vn->accessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        retval |= UA_decodeBinary(src, offset, &vn->userAccessLevel, &UA_TYPES[UA_TYPES_BYTE]);
+        retval |= UA_decodeBinary(src, offset, &vn->minimumSamplingInterval, &UA_TYPES[UA_TYPES_DOUBLE]);
+        retval |= UA_decodeBinary(src, offset, &vn->historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_METHOD: {
+        UA_MethodNode *mn = (UA_MethodNode*)node;
+        retval |= UA_decodeBinary(src, offset, &mn->executable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        retval |= UA_decodeBinary(src, offset, &mn->userExecutable, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_OBJECTTYPE: {
+        UA_ObjectTypeNode *otn = (UA_ObjectTypeNode*)node;
+        retval |= UA_decodeBinary(src, offset, &otn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VARIABLETYPE: {
+        UA_VariableTypeNode *vtn = (UA_VariableTypeNode*)node;
+        retval |= UA_decodeBinary(src, offset, &vtn->valueRank, &UA_TYPES[UA_TYPES_INT32]);
+        retval |= UA_decodeBinary(src, offset, &vtn->value.variant.value, &UA_TYPES[UA_TYPES_VARIANT]);
+        retval |= UA_decodeBinary(src, offset, &vtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_REFERENCETYPE: {
+        UA_ReferenceTypeNode *rtn = (UA_ReferenceTypeNode*)node;
+        retval |= UA_decodeBinary(src, offset, &rtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        retval |= UA_decodeBinary(src, offset, &rtn->symmetric, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        retval |= UA_decodeBinary(src, offset, &rtn->inverseName, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+        break;
+    }
+    case UA_NODECLASS_DATATYPE: {
+        UA_DataTypeNode *dtn = (UA_DataTypeNode*)node;
+        retval |= UA_decodeBinary(src, offset, &dtn->isAbstract, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    case UA_NODECLASS_VIEW: {
+        UA_ViewNode *vn = (UA_ViewNode*)node;
+        retval |= UA_decodeBinary(src, offset, &vn->eventNotifier, &UA_TYPES[UA_TYPES_BYTE]);
+        retval |= UA_decodeBinary(src, offset, &vn->containsNoLoops, &UA_TYPES[UA_TYPES_BOOLEAN]);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(node);
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+    *out = node;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The callbacks cannot be restored from the snapshot. They are taken over from
+ * the node that is replaced. */
+static void takeOverCallbacks(UA_Node *node, const UA_Node *old) {
+    if(node->nodeClass != old->nodeClass)
+        return;
+    switch(node->nodeClass) {
+    case UA_NODECLASS_OBJECT:
+        ((UA_ObjectNode*)node)->instanceHandle = ((const UA_ObjectNode*)old)->instanceHandle;
+        break;
+    case UA_NODECLASS_OBJECTTYPE:
+        ((UA_ObjectTypeNode*)node)->lifecycleManagement =
+            ((const UA_ObjectTypeNode*)old)->lifecycleManagement;
+        break;
+    case UA_NODECLASS_METHOD:
+        ((UA_MethodNode*)node)->methodHandle = ((const UA_MethodNode*)old)->methodHandle;
+        ((UA_MethodNode*)node)->attachedMethod = ((const UA_MethodNode*)old)->attachedMethod;
+        break;
+    case UA_NODECLASS_VARIABLE:
+    case UA_NODECLASS_VARIABLETYPE: {
+        /* The layout of variable type nodes is the same up to the value */
+        UA_VariableNode *vn = (UA_VariableNode*)node;
+        const UA_VariableNode *oldvn = (const UA_VariableNode*)old;
+        if(oldvn->valueSource != UA_VALUESOURCE_VARIANT) {
+            UA_Variant_deleteMembers(&vn->value.variant.value);
+            vn->valueSource = oldvn->valueSource;
+            vn->value = oldvn->value;
+        } else
+            vn->value.variant.callback = oldvn->value.variant.callback;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static UA_StatusCode restoreNode(UA_Server *server, UA_Node *node) {
+    if(node->nodeClass == UA_NODECLASS_VARIABLE || node->nodeClass == UA_NODECLASS_VARIABLETYPE) {
+        /* Variable values are shared between the node and the readers */
+        UA_Variant_share(&((UA_VariableNode*)node)->value.variant.value);
+    }
+    const UA_Node *old = UA_NodeStore_get(server->nodestore, &node->nodeId);
+    if(old) {
+        takeOverCallbacks(node, old);
+        UA_NodeStore_remove(server->nodestore, &node->nodeId);
+    }
+#ifdef UA_ENABLE_HISTORIZING
+    UA_Server_historizeNode(server, &node->nodeId, node->nodeClass == UA_NODECLASS_VARIABLE &&
+                            ((const UA_VariableNode*)node)->historizing);
+#endif
+    return UA_NodeStore_insert(server->nodestore, node);
+}
+
+static UA_StatusCode
+readNamespaces(UA_Server *server, const UA_ByteString *src, size_t *offset) {
+    UA_Int32 namespacesSize;
+    UA_StatusCode retval = UA_decodeBinary(src, offset, &namespacesSize, &UA_TYPES[UA_TYPES_INT32]);
+    if(retval != UA_STATUSCODE_GOOD || namespacesSize < 0 ||
+       (size_t)namespacesSize > src->length - *offset)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_String *namespaces = UA_Array_new((size_t)namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+    if(!namespaces && namespacesSize > 0)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < (size_t)namespacesSize && retval == UA_STATUSCODE_GOOD; i++)
+        retval = UA_decodeBinary(src, offset, &namespaces[i], &UA_TYPES[UA_TYPES_STRING]);
+
+    /* The namespace indices in the snapshot must be valid in the server */
+    UA_Boolean added = false;
+    for(size_t i = 0; i < (size_t)namespacesSize && retval == UA_STATUSCODE_GOOD; i++) {
+        if(i < server->namespacesSize) {
+            if(!UA_String_equal(&namespaces[i], &server->namespaces[i]))
+                retval = UA_STATUSCODE_BADINVALIDARGUMENT;
+            continue;
+        }
+        UA_String *ns = UA_realloc(server->namespaces, sizeof(UA_String) * (server->namespacesSize + 1));
+        if(!ns) {
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            break;
+        }
+        server->namespaces = ns;
+        server->namespaces[server->namespacesSize] = namespaces[i];
+        UA_String_init(&namespaces[i]);
+        server->namespacesSize++;
+        added = true;
+    }
+    if(added)
+        UA_Server_updateNamespacesValue(server);
+    UA_Array_delete(namespaces, (size_t)namespacesSize, &UA_TYPES[UA_TYPES_STRING]);
+    return retval;
+}
+
+UA_StatusCode
+UA_Server_loadSnapshot(UA_Server *server, const UA_ByteString *snapshot) {
+    size_t offset = 0;
+    UA_UInt32 magic = 0, version = 0, nodes = 0;
+    UA_StatusCode retval = UA_decodeBinary(snapshot, &offset, &magic, &UA_TYPES[UA_TYPES_UINT32]);
+    retval |= UA_decodeBinary(snapshot, &offset, &version, &UA_TYPES[UA_TYPES_UINT32]);
+    if(retval != UA_STATUSCODE_GOOD || magic != UA_SNAPSHOT_MAGIC || version != UA_SNAPSHOT_VERSION)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    retval = readNamespaces(server, snapshot, &offset);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_decodeBinary(snapshot, &offset, &nodes, &UA_TYPES[UA_TYPES_UINT32]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    UA_RCU_LOCK();
+    for(UA_UInt32 i = 0; i < nodes && retval == UA_STATUSCODE_GOOD; i++) {
+        UA_Node *node;
+        retval = readNode(snapshot, &offset, &node);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = restoreNode(server, node);
+    }
+    UA_Server_invalidateReferenceTypeIndex(server);
+    UA_Server_invalidateBrowseNameIndices(server);
+    UA_Server_invalidateMethodArguments(server);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_Server_notifyValueWrite(server, NULL);
+#endif
+    UA_RCU_UNLOCK();
+    return retval;
+}
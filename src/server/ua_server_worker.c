@@ -1,5 +1,15 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE // for sched_setaffinity
+#endif
 #include "ua_util.h"
 #include "ua_server_internal.h"
+#include "ua_trace.h"
+#if defined(__linux__) || defined(UA_ENABLE_MULTITHREADING)
+# include <sched.h>
+#endif
+#ifdef UA_ENABLE_MULTITHREADING
+# include <time.h> // nanosleep
+#endif
 
 /**
  * There are four types of job execution:
@@ -13,20 +23,24 @@
  * iteration. This is used e.g. to trigger adding and removing repeated jobs without blocking the
  * mainloop.
  *
- * 4. Delayed jobs are executed once in a worker thread. But only when all normal jobs that were
- * dispatched earlier have been executed. This is achieved by a counter in the worker threads. We
- * compute from the counter if all previous jobs have finished. The delay can be very long, since we
- * try to not interfere too much with normal execution. A use case is to eventually free obsolete
- * structures that _could_ still be accessed from concurrent threads.
+ * 4. Delayed jobs are executed once. But only when all normal jobs that were dispatched before
+ * have finished. The main loop advances a global epoch when all batches that were dispatched
+ * during the previous epoch have finished. Delayed jobs are collected in per-thread limbo lists,
+ * tagged with the epoch, and are executed in bulk two epochs later. A use case is to eventually
+ * free obsolete structures that _could_ still be accessed from concurrent threads.
  *
  * - Remove the entry from the list
  * - mark it as "dead" with an atomic operation
  * - add a delayed job that frees the memory when all concurrent operations have completed
  * 
  * This approach to concurrently accessible memory is known as epoch based reclamation [1]. According to
- * [2], it performs competitively well on many-core systems. Our version of EBR does however not require
- * a global epoch. Instead, every worker thread has its own epoch counter that we observe for changes.
+ * [2], it performs competitively well on many-core systems. Instead of the threads announcing the
+ * epoch they operate in, the batches of jobs carry the epoch in which they were dispatched.
  * 
+ * With the reactors enabled, every network layer is driven by its own thread. It receives the
+ * messages, processes them right away and sends the responses. The batches processed by a reactor
+ * are counted in the epoch in which they begin, like the batches dispatched to the workers.
+ *
  * [1] Fraser, K. 2003. Practical lock freedom. Ph.D. thesis. Computer Laboratory, University of Cambridge.
  * [2] Hart, T. E., McKenney, P. E., Brown, A. D., & Walpole, J. (2007). Performance of memory reclamation
  *     for lockless synchronization. Journal of Parallel and Distributed Computing, 67(12), 1270-1285.
@@ -36,18 +50,73 @@
 
 #define MAXTIMEOUT 500 // max timeout in millisec until the next main loop iteration
 #define BATCHSIZE 20 // max number of jobs that are dispatched at once to workers
+#define DISPATCHSLOTS 64 // number of preallocated dispatch slots per worker
+#define REACTORINTERVAL 10 // max timeout in millisec of the reactors and the main loop with reactors
+#define MININTERVAL 50 // min interval in microsec of the repeated jobs
+
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+static void recordDuration(UA_UInt64 *histogram, UA_DateTime duration, UA_UInt64 count) {
+    UA_UInt64 us = (UA_UInt64)(duration / UA_USEC_TO_DATETIME);
+    size_t bucket = 0;
+    while(us > 0 && bucket < UA_JOBSTATISTICS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    histogram[bucket] += count;
+}
+#endif
 
+/* Pin the calling thread to the CPUs in the mask */
+static void pinThread(UA_Server *server, UA_UInt64 cpuMask) {
+    if(cpuMask == 0)
+        return;
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t i = 0; i < 64 && i < CPU_SETSIZE; i++) {
+        if(cpuMask & ((UA_UInt64)1 << i))
+            CPU_SET(i, &set);
+    }
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0)
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Could not pin the thread to the cpus %llx",
+                       (unsigned long long)cpuMask);
+#else
+    UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                   "Pinning threads to cpus is not supported on this platform");
+#endif
+}
+
+/* The statistics are written only from the calling thread. They are not
+ * recorded if stats is NULL. */
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+# define PROCESSJOBS(server, stats, jobs, jobsSize) processJobs(server, stats, jobs, jobsSize)
+static void processJobs(UA_Server *server, UA_JobStatistics *stats,
+                        UA_Job *jobs, size_t jobsSize) {
+#else
+# define PROCESSJOBS(server, stats, jobs, jobsSize) processJobs(server, jobs, jobsSize)
 static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
+#endif
     UA_ASSERT_RCU_UNLOCKED();
     UA_RCU_LOCK();
     for(size_t i = 0; i < jobsSize; i++) {
         UA_Job *job = &jobs[i];
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        UA_DateTime start = UA_DateTime_nowMonotonic();
+        /* the type of a job is invalid after the execution if it frees itself */
+        size_t type = (size_t)job->type;
+#endif
         switch(job->type) {
         case UA_JOBTYPE_NOTHING:
             break;
-        case UA_JOBTYPE_DETACHCONNECTION:
+        case UA_JOBTYPE_DETACHCONNECTION: {
+            /* the channel is removed during the next cleanup */
+            UA_SecureChannel *channel = job->job.closeConnection->channel;
             UA_Connection_detachSecureChannel(job->job.closeConnection);
+            if(channel)
+                UA_SecureChannelManager_detached(&server->secureChannelManager, channel);
             break;
+        }
         case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER:
             UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
                                            &job->job.binaryMessage.message);
@@ -68,6 +137,17 @@ static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
                            "Trying to execute a job of unknown type");
             break;
         }
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        if(!stats)
+            continue;
+        UA_DateTime duration = UA_DateTime_nowMonotonic() - start;
+        if(type < UA_JOBSTATISTICS_TYPES) {
+            stats->jobsCount[type]++;
+            stats->runTime[type] += (UA_UInt64)duration;
+        }
+        recordDuration(stats->runTimeHistogram, duration, 1);
+        stats->busyTime += (UA_UInt64)duration;
+#endif
     }
     UA_RCU_UNLOCK();
 }
@@ -78,6 +158,31 @@ static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
 
 #ifdef UA_ENABLE_MULTITHREADING
 
+/**
+ * Every worker owns a dispatch queue. The main loop distributes the job batches
+ * round-robin over the worker queues and wakes up only the worker that received
+ * the batch (and only if it sleeps). Workers that run out of work steal batches
+ * from the queues of the other workers before going to sleep. A sleeping
+ * worker is woken up only through its own condition variable. So there is no
+ * thundering herd and no single queue head that all workers contend for.
+ *
+ * Every queue has one lane per job priority. Workers take batches from the
+ * realtime lane first. After config.realtimeJobsWeight realtime batches in a
+ * row, a waiting batch from the normal lane is taken, so that large service
+ * requests cannot delay sampling and publishing by much, and are not starved
+ * by them either.
+ *
+ * With config.connectionAffinity, the jobs of a connection are always sent to
+ * the same worker (selected by a hash over the connection) and work stealing is
+ * disabled. The messages of a connection are then processed in order and the
+ * state of the SecureChannel and the Sessions stays in the cache of one core.
+ *
+ * The batches are copied into dispatch slots that are preallocated when the
+ * server starts. The main loop takes slots from a lock-free stack of free slots
+ * and the workers push them back after the jobs were processed. Only when all
+ * slots are in flight, additional slots are allocated on the heap.
+ */
+
 struct MainLoopJob {
     struct cds_lfs_node node;
     UA_Job job;
@@ -86,299 +191,756 @@ struct MainLoopJob {
 /** Entry in the dispatch queue */
 struct DispatchJobsList {
     struct cds_wfcq_node node; // node for the queue
+    struct cds_lfs_node freeNode; // node in the stack of free slots
+    UA_Boolean pooled; // preallocated or allocated on demand
+    UA_JobPriority priority; // all jobs in the list have the same priority
+    UA_UInt32 epoch; // the epoch when the list was dispatched
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    UA_DateTime dispatchTime;
+#endif
     size_t jobsSize;
-    UA_Job *jobs;
+    UA_Job jobs[BATCHSIZE];
+};
+
+/* Call only from the main loop. The main loop is the only consumer of the
+ * stack of free slots, so no further synchronization is required. */
+static struct DispatchJobsList *
+getDispatchSlot(UA_Server *server, UA_JobPriority priority) {
+    struct cds_lfs_node *node = __cds_lfs_pop(&server->freeDispatchSlots);
+    struct DispatchJobsList *wln;
+    if(node) {
+        wln = container_of(node, struct DispatchJobsList, freeNode);
+    } else {
+        wln = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(struct DispatchJobsList));
+        if(!wln)
+            return NULL;
+        wln->pooled = false;
+    }
+    wln->priority = priority;
+    wln->jobsSize = 0;
+    return wln;
+}
+
+static void
+releaseDispatchSlot(UA_Server *server, struct DispatchJobsList *wln) {
+    if(!wln->pooled) {
+        UA_objfree(wln);
+        return;
+    }
+    cds_lfs_node_init(&wln->freeNode);
+    cds_lfs_push(&server->freeDispatchSlots, &wln->freeNode);
+}
+
+/**
+ * Limbo Lists
+ * -----------
+ * Every worker and the main loop retire delayed jobs into their own limbo
+ * list. The entries are kept in blocks that are tagged with the epoch of the
+ * latest entry. A block is reclaimed by its owner once the global epoch is two
+ * ahead. Workers pass their blocks on to the main loop when they go to sleep or
+ * when they hold too many entries. If the main loop holds more than MAXLIMBO
+ * entries, it waits for the reclamation before it dispatches new work. */
+
+#define LIMBOBLOCKSIZE 64
+#define MAXLIMBO 4096
+
+struct LimboBlock {
+    struct cds_lfs_node node; // for passing the block over to the main loop
+    struct LimboBlock *next;
+    UA_UInt32 epoch; // the epoch of the latest entry
+    UA_Boolean single; // allocated for one entry of an application thread
+    size_t entriesSize;
+    struct {
+        UA_ServerCallback callback;
+        void *data;
+    } entries[LIMBOBLOCKSIZE];
 };
 
+/* The worker that runs in the current thread (NULL in the main loop) */
+static UA_THREAD_LOCAL UA_Worker *currentWorker = NULL;
+
+/* The server whose main loop runs in the current thread */
+static UA_THREAD_LOCAL UA_Server *mainLoopServer = NULL;
+
+/* Application threads that are neither workers nor the main loop. Set
+ * between UA_Server_beginAccess and UA_Server_endAccess. */
+static UA_THREAD_LOCAL size_t accessDepth = 0;
+static UA_THREAD_LOCAL UA_UInt32 accessEpoch = 0;
+
+static UA_Boolean isServerThread(UA_Server *server) {
+    return mainLoopServer == server || (currentWorker && currentWorker->server == server);
+}
+
+static void runLimboBlock(UA_Server *server, struct LimboBlock *block) {
+    UA_RCU_LOCK();
+    for(size_t i = 0; i < block->entriesSize; i++)
+        block->entries[i].callback(server, block->entries[i].data);
+    UA_RCU_UNLOCK();
+}
+
+/* Reclaim the blocks that were retired at least two epochs ago. Call only from
+ * the owning thread and outside of jobs. */
+static void drainLimbo(UA_Server *server, UA_Limbo *limbo) {
+    UA_UInt32 epoch = uatomic_read(&server->epoch);
+    struct LimboBlock *ready = NULL;
+    struct LimboBlock **prev = &limbo->blocks;
+    struct LimboBlock *block;
+    while((block = *prev)) {
+        if((UA_UInt32)(epoch - block->epoch) < 2) {
+            prev = &block->next;
+            continue;
+        }
+        *prev = block->next;
+        limbo->count -= block->entriesSize;
+        block->next = ready; // the oldest block comes first
+        ready = block;
+    }
+
+    /* Unlinked before, since the callbacks may retire new entries */
+    while((block = ready)) {
+        ready = block->next;
+        runLimboBlock(server, block);
+        if(!limbo->spare && !block->single)
+            limbo->spare = block; // keep one block for reuse
+        else
+            UA_free(block);
+    }
+}
+
+/* Pass the blocks on to the main loop */
+static void handOverLimbo(UA_Server *server, UA_Limbo *limbo) {
+    struct LimboBlock *block;
+    while((block = limbo->blocks)) {
+        limbo->blocks = block->next;
+        cds_lfs_node_init(&block->node);
+        cds_lfs_push(&server->orphanedLimbo, &block->node);
+    }
+    limbo->count = 0;
+}
+
+static struct DispatchJobsList *
+dequeueLane(UA_Worker *worker, UA_JobPriority priority) {
+    if(cds_wfcq_empty(&worker->lanes[priority].head, &worker->lanes[priority].tail))
+        return NULL;
+    return (struct DispatchJobsList*)
+        cds_wfcq_dequeue_blocking(&worker->lanes[priority].head, &worker->lanes[priority].tail);
+}
+
+static UA_Boolean
+queueEmpty(UA_Worker *worker) {
+    for(size_t i = 0; i < UA_JOBPRIORITY_COUNT; i++) {
+        if(!cds_wfcq_empty(&worker->lanes[i].head, &worker->lanes[i].tail))
+            return false;
+    }
+    return true;
+}
+
+/* Take the next batch from the queue of the worker. Call only from the worker
+ * thread itself or when the workers are stopped. */
+static struct DispatchJobsList *
+dequeueJobs(UA_Worker *worker) {
+    UA_JobPriority first = UA_JOBPRIORITY_REALTIME;
+    UA_JobPriority second = UA_JOBPRIORITY_NORMAL;
+    if(worker->realtimeBatches >= worker->server->config.realtimeJobsWeight) {
+        first = UA_JOBPRIORITY_NORMAL;
+        second = UA_JOBPRIORITY_REALTIME;
+    }
+    struct DispatchJobsList *wln = dequeueLane(worker, first);
+    if(!wln)
+        wln = dequeueLane(worker, second);
+    if(!wln)
+        return NULL;
+    if(wln->priority == UA_JOBPRIORITY_REALTIME)
+        worker->realtimeBatches++;
+    else
+        worker->realtimeBatches = 0;
+    return wln;
+}
+
+/* Try the queues of the other workers, starting with the right neighbor */
+static struct DispatchJobsList *
+stealJobs(UA_Worker *worker) {
+    UA_Server *server = worker->server;
+    /* Stealing would reorder the jobs of a connection */
+    if(server->config.connectionAffinity)
+        return NULL;
+    size_t nThreads = server->config.nThreads;
+    size_t self = (size_t)(worker - server->workers);
+    for(size_t p = UA_JOBPRIORITY_COUNT; p > 0; p--) {
+        for(size_t i = 1; i < nThreads; i++) {
+            struct DispatchJobsList *wln =
+                dequeueLane(&server->workers[(self + i) % nThreads], (UA_JobPriority)(p - 1));
+            if(wln)
+                return wln;
+        }
+    }
+    return NULL;
+}
+
+static UA_StatusCode
+retireDelayed(UA_Server *server, UA_ServerCallback callback, void *data);
+
+/* Called from the main loop after a batch has been enqueued for the worker */
+static void wakeupWorker(UA_Worker *worker) {
+    /* Pairs with the barrier in the worker loop before it checks its queue for
+     * the last time. Either the worker sees the new batch or we see that it is
+     * sleeping. */
+    cmm_smp_mb();
+    if(!uatomic_read(&worker->sleeping))
+        return;
+    pthread_mutex_lock(&worker->mutex);
+    pthread_cond_signal(&worker->condition);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
 static void * workerLoop(UA_Worker *worker) {
     UA_Server *server = worker->server;
-    UA_UInt32 *counter = &worker->counter;
     volatile UA_Boolean *running = &worker->running;
+    currentWorker = worker;
     
+    /* Pin the worker before it allocates anything */
+    if(server->config.workerCpuMasksSize > 0) {
+        size_t index = (size_t)(worker - server->workers);
+        pinThread(server, server->config.workerCpuMasks[index % server->config.workerCpuMasksSize]);
+    }
+
     /* Initialize the (thread local) random seed with the ram address of worker */
     UA_random_seed((uintptr_t)worker);
    	rcu_register_thread();
 
-    pthread_mutex_t mutex; // required for the condition variable
-    pthread_mutex_init(&mutex,0);
-    pthread_mutex_lock(&mutex);
-
     while(*running) {
-        struct DispatchJobsList *wln = (struct DispatchJobsList*)
-            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head, &server->dispatchQueue_tail);
+        if(worker->limbo.blocks) {
+            drainLimbo(server, &worker->limbo);
+            if(worker->limbo.count > MAXLIMBO)
+                handOverLimbo(server, &worker->limbo);
+        }
+
+        struct DispatchJobsList *wln = dequeueJobs(worker);
+        if(!wln)
+            wln = stealJobs(worker);
         if(!wln) {
-            uatomic_inc(counter);
-            /* sleep until a work arrives (and wakes up all worker threads) */
-            pthread_cond_wait(&server->dispatchQueue_condition, &mutex);
+            /* don't hold back the reclamation while sleeping */
+            handOverLimbo(server, &worker->limbo);
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+            UA_DateTime idleStart = UA_DateTime_nowMonotonic();
+#endif
+            /* sleep until work arrives in our own queue */
+            pthread_mutex_lock(&worker->mutex);
+            uatomic_set(&worker->sleeping, true);
+            cmm_smp_mb();
+            if(*running && queueEmpty(worker))
+                pthread_cond_wait(&worker->condition, &worker->mutex);
+            uatomic_set(&worker->sleeping, false);
+            pthread_mutex_unlock(&worker->mutex);
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+            worker->statistics.idleTime += (UA_UInt64)(UA_DateTime_nowMonotonic() - idleStart);
+#endif
             continue;
         }
-        processJobs(server, wln->jobs, wln->jobsSize);
-        UA_free(wln->jobs);
-        UA_free(wln);
-        uatomic_inc(counter);
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        uatomic_inc(&worker->takenBatches);
+        recordDuration(worker->statistics.waitTimeHistogram,
+                       UA_DateTime_nowMonotonic() - wln->dispatchTime, wln->jobsSize);
+#endif
+        UA_TRACE3(batch_taken, worker - server->workers, wln->jobsSize, wln->priority);
+        UA_UInt32 epoch = wln->epoch;
+        worker->now = UA_DateTime_now();
+        PROCESSJOBS(server, &worker->statistics, wln->jobs, wln->jobsSize);
+        releaseDispatchSlot(server, wln);
+        cmm_smp_mb(); // the jobs have finished before the batch is counted out
+        uatomic_dec(&server->inflightBatches[epoch % UA_EPOCHS]);
     }
+    handOverLimbo(server, &worker->limbo);
+    currentWorker = NULL;
 
-    pthread_mutex_unlock(&mutex);
-    pthread_mutex_destroy(&mutex);
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
    	rcu_unregister_thread();
     return NULL;
 }
 
-/** Dispatch jobs to workers. Slices the job array up if it contains more than
-    BATCHSIZE items. The jobs array is freed in the worker threads. */
-static void dispatchJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
-    size_t startIndex = jobsSize; // start at the end
-    while(jobsSize > 0) {
-        size_t size = BATCHSIZE;
-        if(size > jobsSize)
-            size = jobsSize;
-        startIndex = startIndex - size;
-        struct DispatchJobsList *wln = UA_malloc(sizeof(struct DispatchJobsList));
-        if(startIndex > 0) {
-            wln->jobs = UA_malloc(size * sizeof(UA_Job));
-            memcpy(wln->jobs, &jobs[startIndex], size * sizeof(UA_Job));
-            wln->jobsSize = size;
-        } else {
-            /* forward the original array */
-            wln->jobsSize = size;
-            wln->jobs = jobs;
+static void completeMessages(UA_Server *server, UA_Job *job);
+
+/* Count a batch that is processed outside the dispatch queues into the
+ * current epoch. The epoch is checked again after the batch is counted. So
+ * the main loop cannot have advanced beyond it unnoticed. */
+static UA_UInt32 enterEpoch(UA_Server *server) {
+    while(true) {
+        UA_UInt32 epoch = uatomic_read(&server->epoch);
+        uatomic_inc(&server->inflightBatches[epoch % UA_EPOCHS]);
+        cmm_smp_mb();
+        if(uatomic_read(&server->epoch) == epoch)
+            return epoch;
+        uatomic_dec(&server->inflightBatches[epoch % UA_EPOCHS]);
+    }
+}
+
+static void * reactorLoop(UA_Worker *reactor) {
+    UA_Server *server = reactor->server;
+    UA_ServerNetworkLayer *nl = reactor->networkLayer;
+    volatile UA_Boolean *running = &reactor->running;
+    currentWorker = reactor;
+
+    if(server->config.workerCpuMasksSize > 0) {
+        size_t index = server->config.nThreads + (size_t)(reactor - server->reactors);
+        pinThread(server, server->config.workerCpuMasks[index % server->config.workerCpuMasksSize]);
+    }
+    UA_random_seed((uintptr_t)reactor);
+    rcu_register_thread();
+
+    while(*running) {
+        if(reactor->limbo.blocks) {
+            drainLimbo(server, &reactor->limbo);
+            if(reactor->limbo.count > MAXLIMBO)
+                handOverLimbo(server, &reactor->limbo);
         }
-        cds_wfcq_node_init(&wln->node);
-        cds_wfcq_enqueue(&server->dispatchQueue_head, &server->dispatchQueue_tail, &wln->node);
-        jobsSize -= size;
+
+        UA_Job *jobs = NULL;
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        UA_DateTime waitStart = UA_DateTime_nowMonotonic();
+#endif
+        size_t jobsSize = nl->getJobs(nl, &jobs, REACTORINTERVAL * 1000);
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        reactor->statistics.idleTime += (UA_UInt64)(UA_DateTime_nowMonotonic() - waitStart);
+#endif
+        if(jobsSize == 0)
+            continue;
+        for(size_t k = 0; k < jobsSize; k++) {
+            if(jobs[k].type == UA_JOBTYPE_METHODCALL_DELAYED) {
+                retireDelayed(server, jobs[k].job.methodCall.method, jobs[k].job.methodCall.data);
+                jobs[k].type = UA_JOBTYPE_NOTHING;
+            } else if(jobs[k].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER) {
+                completeMessages(server, &jobs[k]);
+            }
+        }
+        UA_UInt32 epoch = enterEpoch(server);
+        reactor->now = UA_DateTime_now();
+        PROCESSJOBS(server, &reactor->statistics, jobs, jobsSize);
+        cmm_smp_mb(); // the jobs have finished before the batch is counted out
+        uatomic_dec(&server->inflightBatches[epoch % UA_EPOCHS]);
+        if(nl->flush)
+            nl->flush(nl);
+    }
+    handOverLimbo(server, &reactor->limbo);
+    currentWorker = NULL;
+
+    UA_ASSERT_RCU_UNLOCKED();
+    rcu_barrier();
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void enqueueJobs(UA_Worker *worker, struct DispatchJobsList *wln) {
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    wln->dispatchTime = UA_DateTime_nowMonotonic();
+    worker->server->enqueuedBatches++;
+#endif
+    wln->epoch = worker->server->epoch;
+    UA_TRACE3(batch_dispatched, worker - worker->server->workers, wln->jobsSize, wln->priority);
+    uatomic_inc(&worker->server->inflightBatches[wln->epoch % UA_EPOCHS]);
+    cds_wfcq_node_init(&wln->node);
+    cds_wfcq_enqueue(&worker->lanes[wln->priority].head,
+                     &worker->lanes[wln->priority].tail, &wln->node);
+    wakeupWorker(worker);
+}
+
+/* Returns the connection a job belongs to, or NULL */
+static UA_Connection * jobConnection(const UA_Job *job) {
+    switch(job->type) {
+    case UA_JOBTYPE_DETACHCONNECTION:
+        return job->job.closeConnection;
+    case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER:
+    case UA_JOBTYPE_BINARYMESSAGE_ALLOCATED:
+        return job->job.binaryMessage.connection;
+    default:
+        return NULL;
+    }
+}
+
+/* The connection pointer is stable during the lifetime of the connection */
+static UA_Worker * connectionWorker(UA_Server *server, const UA_Connection *connection) {
+    uintptr_t h = (uintptr_t)connection;
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return &server->workers[h % server->config.nThreads];
+}
+
+/* Enqueue an open round-robin slot for the next worker */
+static void flushDispatchSlot(UA_Server *server, UA_JobPriority priority) {
+    struct DispatchJobsList *wln = server->openDispatchSlots[priority];
+    if(!wln)
+        return;
+    server->openDispatchSlots[priority] = NULL;
+    enqueueJobs(&server->workers[server->dispatchWorker], wln);
+    server->dispatchWorker = (UA_UInt16)((server->dispatchWorker + 1) % server->config.nThreads);
+}
+
+/* Enqueue the open round-robin slots and the open connection-affine slots */
+static void flushDispatch(UA_Server *server) {
+    for(size_t p = UA_JOBPRIORITY_COUNT; p > 0; p--)
+        flushDispatchSlot(server, (UA_JobPriority)(p - 1));
+    if(!server->config.connectionAffinity)
+        return;
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        UA_Worker *worker = &server->workers[i];
+        for(size_t p = UA_JOBPRIORITY_COUNT; p > 0; p--) {
+            struct DispatchJobsList *wln = worker->openSlots[p - 1];
+            if(!wln)
+                continue;
+            worker->openSlots[p - 1] = NULL;
+            enqueueJobs(worker, wln);
+        }
+    }
+}
+
+/* Copy a job into the open dispatch slot. Full slots are dispatched right away.
+ * Call flushDispatch to dispatch the remaining jobs. */
+static void dispatchJob(UA_Server *server, const UA_Job *job) {
+    UA_JobPriority priority = job->priority;
+    if(priority >= UA_JOBPRIORITY_COUNT)
+        priority = UA_JOBPRIORITY_NORMAL;
+    UA_Worker *worker = NULL;
+    struct DispatchJobsList **slot = &server->openDispatchSlots[priority];
+    if(server->config.connectionAffinity) {
+        UA_Connection *connection = jobConnection(job);
+        if(connection) {
+            worker = connectionWorker(server, connection);
+            slot = &worker->openSlots[priority];
+        }
+    }
+
+    if(!*slot) {
+        *slot = getDispatchSlot(server, priority);
+        if(!*slot) {
+            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                         "Not enough memory to dispatch a job");
+            return;
+        }
+    }
+    struct DispatchJobsList *wln = *slot;
+    wln->jobs[wln->jobsSize] = *job;
+    wln->jobsSize++;
+    if(wln->jobsSize < BATCHSIZE)
+        return;
+
+    /* The slot is full */
+    if(!worker) {
+        flushDispatchSlot(server, priority);
+        return;
+    }
+    *slot = NULL;
+    enqueueJobs(worker, wln);
+}
+
+/* Enqueue a single job for the worker. Can be called from any thread. The slot
+ * is allocated on the heap, since the pool of free slots belongs to the main
+ * loop. */
+static UA_StatusCode
+enqueueJobAnyThread(UA_Server *server, UA_Worker *worker, const UA_Job *job) {
+    struct DispatchJobsList *wln = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(struct DispatchJobsList));
+    if(!wln)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    wln->pooled = false;
+    wln->priority = job->priority < UA_JOBPRIORITY_COUNT ? job->priority : UA_JOBPRIORITY_NORMAL;
+    wln->jobsSize = 1;
+    wln->jobs[0] = *job;
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    wln->dispatchTime = UA_DateTime_nowMonotonic();
+#endif
+    wln->epoch = enterEpoch(server);
+    UA_TRACE3(batch_dispatched, worker - server->workers, wln->jobsSize, wln->priority);
+    cds_wfcq_node_init(&wln->node);
+    cds_wfcq_enqueue(&worker->lanes[wln->priority].head,
+                     &worker->lanes[wln->priority].tail, &wln->node);
+    wakeupWorker(worker);
+    return UA_STATUSCODE_GOOD;
+}
+
+/** Dispatch jobs to workers in batches of up to BATCHSIZE items. The jobs are
+    copied, so the array remains with the caller. */
+static void dispatchJobs(UA_Server *server, const UA_Job *jobs, size_t jobsSize) {
+    for(size_t i = 0; i < jobsSize; i++) {
+        if(jobs[i].type != UA_JOBTYPE_NOTHING)
+            dispatchJob(server, &jobs[i]);
     }
+    flushDispatch(server);
 }
 
 static void
 emptyDispatchQueue(UA_Server *server) {
-    while(!cds_wfcq_empty(&server->dispatchQueue_head, &server->dispatchQueue_tail)) {
-        struct DispatchJobsList *wln = (struct DispatchJobsList*)
-            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head, &server->dispatchQueue_tail);
-        processJobs(server, wln->jobs, wln->jobsSize);
-        UA_free(wln->jobs);
-        UA_free(wln);
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        struct DispatchJobsList *wln;
+        while((wln = dequeueJobs(&server->workers[i]))) {
+            PROCESSJOBS(server, &server->statistics.mainLoop, wln->jobs, wln->jobsSize);
+            releaseDispatchSlot(server, wln);
+        }
     }
 }
 
 #endif
 
+UA_StatusCode
+UA_Server_dispatchCallback(UA_Server *server, UA_ServerCallback callback, void *data) {
+#ifndef UA_ENABLE_MULTITHREADING
+    callback(server, data);
+    return UA_STATUSCODE_GOOD;
+#else
+    /* Handed to the main loop, which dispatches it with the next jobs */
+    struct MainLoopJob *mlw = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(struct MainLoopJob));
+    if(!mlw)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    mlw->job = (UA_Job) {
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = data, .method = callback}};
+    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+    return UA_STATUSCODE_GOOD;
+#endif
+}
+
 /*****************/
 /* Repeated Jobs */
 /*****************/
 
-struct IdentifiedJob {
-    UA_Job job;
-    UA_Guid id;
-};
-
 /**
- * The RepeatedJobs structure contains an array of jobs that are either executed with the same
- * repetition interval. The linked list is sorted, so we can stop traversing when the first element
- * has nextTime > now.
+ * Repeated jobs are kept in a binary min-heap that is ordered by the next
+ * execution time. Adding, firing and removing a job is O(log n) in the number
+ * of repeated jobs. Jobs that were added with an identifier are additionally
+ * stored in a hash index over the guid, so that they can be found for removal
+ * without walking the heap.
  */
-struct RepeatedJobs {
-    LIST_ENTRY(RepeatedJobs) pointers; ///> Links to the next list of repeated jobs (with a different) interval
-    UA_DateTime nextTime; ///> The next time when the jobs are to be executed
-    UA_UInt32 interval; ///> Interval in 100ns resolution
-    size_t jobsSize; ///> Number of jobs contained
-    struct IdentifiedJob jobs[]; ///> The jobs. This is not a pointer, instead the struct is variable sized.
-};
 
-/* throwaway struct for the mainloop callback */
-struct AddRepeatedJob {
-    struct IdentifiedJob job;
-    UA_UInt32 interval;
+#define REPEATEDJOBS_MINSIZE 64
+
+struct RepeatedJob {
+    LIST_ENTRY(RepeatedJob) indexEntry; ///> Entry in the bucket of the guid index
+    UA_DateTime nextTime; ///> The next time when the job is to be executed
+    UA_UInt64 interval; ///> Interval in 100ns resolution
+    size_t heapIndex; ///> Current position in the heap array
+    UA_Boolean indexed; ///> The job has an id and is contained in the guid index
+    UA_Guid id;
+    UA_Job job;
 };
 
-/* internal. call only from the main loop. */
-static UA_StatusCode addRepeatedJob(UA_Server *server, struct AddRepeatedJob * UA_RESTRICT arw) {
-    struct RepeatedJobs *matchingTw = NULL; // add the item here
-    struct RepeatedJobs *lastTw = NULL; // if there is no repeated job, add a new one this entry
-    struct RepeatedJobs *tempTw;
-    UA_StatusCode retval = UA_STATUSCODE_GOOD;
-
-    /* search for matching entry */
-    UA_DateTime firstTime = UA_DateTime_nowMonotonic();
-    tempTw = LIST_FIRST(&server->repeatedJobs);
-    while(tempTw) {
-        if(arw->interval == tempTw->interval) {
-            matchingTw = tempTw;
-            break;
+static size_t guidBucket(const UA_Server *server, const UA_Guid *id) {
+    /* The guids are random. Mixing the first fields is sufficient. */
+    UA_UInt32 h = id->data1 ^ ((UA_UInt32)id->data2 << 16) ^ id->data3;
+    return (size_t)h & (server->repeatedJobsIndexSize - 1);
+}
+
+static UA_StatusCode growIndex(UA_Server *server) {
+    size_t newSize = server->repeatedJobsIndexSize * 2;
+    if(newSize < REPEATEDJOBS_MINSIZE)
+        newSize = REPEATEDJOBS_MINSIZE;
+    struct RepeatedJobsBucket *newIndex = UA_malloc(newSize * sizeof(struct RepeatedJobsBucket));
+    if(!newIndex)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < newSize; i++)
+        LIST_INIT(&newIndex[i]);
+
+    /* Rehash all entries into the new buckets */
+    struct RepeatedJobsBucket *oldIndex = server->repeatedJobsIndex;
+    size_t oldSize = server->repeatedJobsIndexSize;
+    server->repeatedJobsIndex = newIndex;
+    server->repeatedJobsIndexSize = newSize;
+    for(size_t i = 0; i < oldSize; i++) {
+        struct RepeatedJob *rj, *rj_tmp;
+        LIST_FOREACH_SAFE(rj, &oldIndex[i], indexEntry, rj_tmp) {
+            LIST_REMOVE(rj, indexEntry);
+            LIST_INSERT_HEAD(&newIndex[guidBucket(server, &rj->id)], rj, indexEntry);
         }
-        if(tempTw->nextTime > firstTime)
+    }
+    UA_free(oldIndex);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void heapSet(UA_Server *server, size_t i, struct RepeatedJob *rj) {
+    server->repeatedJobs[i] = rj;
+    rj->heapIndex = i;
+}
+
+static void heapSiftUp(UA_Server *server, size_t i) {
+    struct RepeatedJob *rj = server->repeatedJobs[i];
+    while(i > 0) {
+        size_t parent = (i - 1) / 2;
+        if(server->repeatedJobs[parent]->nextTime <= rj->nextTime)
             break;
-        lastTw = tempTw;
-        tempTw = LIST_NEXT(lastTw, pointers);
+        heapSet(server, i, server->repeatedJobs[parent]);
+        i = parent;
     }
+    heapSet(server, i, rj);
+}
 
-    if(matchingTw) {
-        /* append to matching entry */
-        matchingTw = UA_realloc(matchingTw, sizeof(struct RepeatedJobs) +
-                                (sizeof(struct IdentifiedJob) * (matchingTw->jobsSize + 1)));
-        if(!matchingTw) {
-            retval = UA_STATUSCODE_BADOUTOFMEMORY;
-            goto cleanup;
-        }
-        /* link the reallocated tw into the list */
-        LIST_REPLACE(matchingTw, matchingTw, pointers);
-    } else {
-        /* create a new entry */
-        matchingTw = UA_malloc(sizeof(struct RepeatedJobs) + sizeof(struct IdentifiedJob));
-        if(!matchingTw) {
-            retval = UA_STATUSCODE_BADOUTOFMEMORY;
-            goto cleanup;
-        }
-        matchingTw->jobsSize = 0;
-        matchingTw->nextTime = firstTime;
-        matchingTw->interval = arw->interval;
-        if(lastTw)
-            LIST_INSERT_AFTER(lastTw, matchingTw, pointers);
-        else
-            LIST_INSERT_HEAD(&server->repeatedJobs, matchingTw, pointers);
+static void heapSiftDown(UA_Server *server, size_t i) {
+    struct RepeatedJob *rj = server->repeatedJobs[i];
+    size_t size = server->repeatedJobsSize;
+    while(true) {
+        size_t child = (2 * i) + 1;
+        if(child >= size)
+            break;
+        if(child + 1 < size &&
+           server->repeatedJobs[child + 1]->nextTime < server->repeatedJobs[child]->nextTime)
+            child++;
+        if(rj->nextTime <= server->repeatedJobs[child]->nextTime)
+            break;
+        heapSet(server, i, server->repeatedJobs[child]);
+        i = child;
     }
-    matchingTw->jobs[matchingTw->jobsSize] = arw->job;
-    matchingTw->jobsSize++;
+    heapSet(server, i, rj);
+}
 
- cleanup:
-#ifdef UA_ENABLE_MULTITHREADING
-    UA_free(arw);
-#endif
-    return retval;
+static void heapRemove(UA_Server *server, size_t i) {
+    server->repeatedJobsSize--;
+    if(i == server->repeatedJobsSize)
+        return;
+    heapSet(server, i, server->repeatedJobs[server->repeatedJobsSize]);
+    heapSiftUp(server, i);
+    heapSiftDown(server, server->repeatedJobs[i]->heapIndex);
+}
+
+/* internal. call only from the main loop. */
+static UA_StatusCode addRepeatedJob(UA_Server *server, struct RepeatedJob *rj) {
+    /* Make room in the heap */
+    if(server->repeatedJobsSize >= server->repeatedJobsCapacity) {
+        size_t newCapacity = server->repeatedJobsCapacity * 2;
+        if(newCapacity < REPEATEDJOBS_MINSIZE)
+            newCapacity = REPEATEDJOBS_MINSIZE;
+        struct RepeatedJob **heap =
+            UA_realloc(server->repeatedJobs, newCapacity * sizeof(struct RepeatedJob*));
+        if(!heap)
+            goto error;
+        server->repeatedJobs = heap;
+        server->repeatedJobsCapacity = newCapacity;
+    }
+
+    /* Add to the guid index. Keep the load factor below one. */
+    if(rj->indexed) {
+        if(server->repeatedJobsIndexCount >= server->repeatedJobsIndexSize &&
+           growIndex(server) != UA_STATUSCODE_GOOD)
+            goto error;
+        LIST_INSERT_HEAD(&server->repeatedJobsIndex[guidBucket(server, &rj->id)], rj, indexEntry);
+        server->repeatedJobsIndexCount++;
+    }
+
+    /* The first execution is during the next iteration of the main loop */
+    rj->nextTime = UA_DateTime_nowMonotonic();
+    server->repeatedJobs[server->repeatedJobsSize] = rj;
+    server->repeatedJobsSize++;
+    heapSiftUp(server, server->repeatedJobsSize - 1);
+    return UA_STATUSCODE_GOOD;
+
+ error:
+    UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                 "Not enough memory to add a repeated job");
+    UA_objfree(rj);
+    return UA_STATUSCODE_BADOUTOFMEMORY;
 }
 
 UA_StatusCode UA_Server_addRepeatedJob(UA_Server *server, UA_Job job, UA_UInt32 interval, UA_Guid *jobId) {
     /* the interval needs to be at least 5ms */
     if(interval < 5)
         return UA_STATUSCODE_BADINTERNALERROR;
-    interval *= (UA_UInt32)UA_MSEC_TO_DATETIME; // from ms to 100ns resolution
+    return UA_Server_addRepeatedJobUsec(server, job, (UA_UInt64)interval * 1000, jobId);
+}
 
-#ifdef UA_ENABLE_MULTITHREADING
-    struct AddRepeatedJob *arw = UA_malloc(sizeof(struct AddRepeatedJob));
-    if(!arw)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
+UA_StatusCode
+UA_Server_addRepeatedJobUsec(UA_Server *server, UA_Job job, UA_UInt64 interval, UA_Guid *jobId) {
+    if(interval < MININTERVAL)
+        return UA_STATUSCODE_BADINTERNALERROR;
 
-    arw->interval = interval;
-    arw->job.job = job;
+    struct RepeatedJob *rj = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(struct RepeatedJob));
+    if(!rj)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    rj->interval = interval * UA_USEC_TO_DATETIME; // from us to 100ns resolution
+    rj->job = job;
     if(jobId) {
-        arw->job.id = UA_Guid_random();
-        *jobId = arw->job.id;
-    } else
-        UA_Guid_init(&arw->job.id);
+        rj->id = UA_Guid_random();
+        rj->indexed = true;
+        *jobId = rj->id;
+    } else {
+        UA_Guid_init(&rj->id);
+        rj->indexed = false;
+    }
 
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
+#ifdef UA_ENABLE_MULTITHREADING
+    struct MainLoopJob *mlw = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(struct MainLoopJob));
     if(!mlw) {
-        UA_free(arw);
+        UA_objfree(rj);
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
     mlw->job = (UA_Job) {
         .type = UA_JOBTYPE_METHODCALL,
-        .job.methodCall = {.data = arw, .method = (void (*)(UA_Server*, void*))addRepeatedJob}};
+        .job.methodCall = {.data = rj, .method = (void (*)(UA_Server*, void*))addRepeatedJob}};
     cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+    return UA_STATUSCODE_GOOD;
 #else
-    struct AddRepeatedJob arw;
-    arw.interval = interval;
-    arw.job.job = job;
-    if(jobId) {
-        arw.job.id = UA_Guid_random();
-        *jobId = arw.job.id;
-    } else
-        UA_Guid_init(&arw.job.id);
-    addRepeatedJob(server, &arw);
+    return addRepeatedJob(server, rj);
 #endif
-    return UA_STATUSCODE_GOOD;
 }
 
 /* Returns the next datetime when a repeated job is scheduled */
 static UA_DateTime processRepeatedJobs(UA_Server *server, UA_DateTime current) {
-    struct RepeatedJobs *tw, *tmp_tw;
-    /* Iterate over the list of elements (sorted according to the next execution timestamp) */
-    LIST_FOREACH_SAFE(tw, &server->repeatedJobs, pointers, tmp_tw) {
-        if(tw->nextTime > current)
+    while(server->repeatedJobsSize > 0) {
+        struct RepeatedJob *rj = server->repeatedJobs[0];
+        if(rj->nextTime > current)
             break;
 
+        /* Set the time for the next execution before the job is executed. The
+         * job might remove itself. Executions that were missed are skipped. */
+        rj->nextTime += (UA_DateTime)rj->interval;
+        if(rj->nextTime <= current)
+            rj->nextTime = current + (UA_DateTime)rj->interval;
+        heapSiftDown(server, 0);
+
 #ifdef UA_ENABLE_MULTITHREADING
-        // copy the entry and insert at the new location
-        UA_Job *jobsCopy = UA_malloc(sizeof(UA_Job) * tw->jobsSize);
-        if(!jobsCopy) {
-            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
-                         "Not enough memory to dispatch delayed jobs");
-            break;
-        }
-        for(size_t i=0;i<tw->jobsSize;i++)
-            jobsCopy[i] = tw->jobs[i].job;
-        dispatchJobs(server, jobsCopy, tw->jobsSize); // frees the job pointer
+        dispatchJob(server, &rj->job);
 #else
-		size_t size = tw->jobsSize;
-        for(size_t i = 0; i < size; i++)
-            processJobs(server, &tw->jobs[i].job, 1); // does not free the job ptr
-#endif
-
-		/* Elements are removed only here. Check if empty. */
-		if(tw->jobsSize == 0) {
-			LIST_REMOVE(tw, pointers);
-			UA_free(tw);
-            UA_assert(LIST_FIRST(&server->repeatedJobs) != tw); /* Assert for static code checkers */
-			continue;
-		}
-
-        /* Set the time for the next execution */
-        tw->nextTime += tw->interval;
-        if(tw->nextTime < current)
-            tw->nextTime = current;
-
-        /* Reinsert to keep the list sorted */
-        struct RepeatedJobs *prevTw = LIST_FIRST(&server->repeatedJobs);
-        while(true) {
-            struct RepeatedJobs *n = LIST_NEXT(prevTw, pointers);
-            if(!n || n->nextTime > tw->nextTime)
-                break;
-            prevTw = n;
-        }
-        if(prevTw != tw) {
-            LIST_REMOVE(tw, pointers);
-            LIST_INSERT_AFTER(prevTw, tw, pointers);
-        }
+        UA_Job job = rj->job; /* rj may be freed during the execution */
+        PROCESSJOBS(server, &server->statistics.mainLoop, &job, 1);
+#endif
     }
 
+#ifdef UA_ENABLE_MULTITHREADING
+    flushDispatch(server);
+#endif
+
     // check if the next repeated job is sooner than the usual timeout
     // calc in 32 bit must be ok
-    struct RepeatedJobs *first = LIST_FIRST(&server->repeatedJobs);
     UA_DateTime next = current + (MAXTIMEOUT * UA_MSEC_TO_DATETIME);
-    if(first && first->nextTime < next)
-        next = first->nextTime;
+    if(server->repeatedJobsSize > 0 && server->repeatedJobs[0]->nextTime < next)
+        next = server->repeatedJobs[0]->nextTime;
     return next;
 }
 
 /* Call this function only from the main loop! */
 static void removeRepeatedJob(UA_Server *server, UA_Guid *jobId) {
-    struct RepeatedJobs *tw;
-    LIST_FOREACH(tw, &server->repeatedJobs, pointers) {
-        for(size_t i = 0; i < tw->jobsSize; i++) {
-            if(!UA_Guid_equal(jobId, &tw->jobs[i].id))
-                continue;
-			tw->jobsSize--; /* if size == 0, tw is freed during the next processing */
-            if(tw->jobsSize > 0)
-                tw->jobs[i] = tw->jobs[tw->jobsSize]; // move the last entry to overwrite
-            goto finish;
-        }
+    if(server->repeatedJobsIndexCount == 0)
+        goto finish;
+    struct RepeatedJob *rj;
+    LIST_FOREACH(rj, &server->repeatedJobsIndex[guidBucket(server, jobId)], indexEntry) {
+        if(!UA_Guid_equal(jobId, &rj->id))
+            continue;
+        LIST_REMOVE(rj, indexEntry);
+        server->repeatedJobsIndexCount--;
+        heapRemove(server, rj->heapIndex);
+        UA_objfree(rj);
+        break;
     }
  finish:
 #ifdef UA_ENABLE_MULTITHREADING
-    UA_free(jobId);
+    UA_objfree(jobId);
 #endif
     return;
 }
 
 UA_StatusCode UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId) {
 #ifdef UA_ENABLE_MULTITHREADING
-    UA_Guid *idptr = UA_malloc(sizeof(UA_Guid));
+    UA_Guid *idptr = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(UA_Guid));
     if(!idptr)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     *idptr = jobId;
     // dispatch to the mainloopjobs stack
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
+    struct MainLoopJob *mlw = UA_objalloc(UA_MEMCATEGORY_JOBS, sizeof(struct MainLoopJob));
     mlw->job = (UA_Job) {
         .type = UA_JOBTYPE_METHODCALL,
         .job.methodCall = {.data = idptr, .method = (void (*)(UA_Server*, void*))removeRepeatedJob}};
@@ -390,11 +952,16 @@ UA_StatusCode UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId) {
 }
 
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server) {
-    struct RepeatedJobs *current, *temp;
-    LIST_FOREACH_SAFE(current, &server->repeatedJobs, pointers, temp) {
-        LIST_REMOVE(current, pointers);
-        UA_free(current);
-    }
+    for(size_t i = 0; i < server->repeatedJobsSize; i++)
+        UA_objfree(server->repeatedJobs[i]);
+    UA_free(server->repeatedJobs);
+    UA_free(server->repeatedJobsIndex);
+    server->repeatedJobs = NULL;
+    server->repeatedJobsSize = 0;
+    server->repeatedJobsCapacity = 0;
+    server->repeatedJobsIndex = NULL;
+    server->repeatedJobsIndexSize = 0;
+    server->repeatedJobsIndexCount = 0;
 }
 
 /****************/
@@ -403,56 +970,62 @@ void UA_Server_deleteAllRepeatedJobs(UA_Server *server) {
 
 #ifdef UA_ENABLE_MULTITHREADING
 
-#define DELAYEDJOBSSIZE 100 // Collect delayed jobs until we have DELAYEDWORKSIZE items
-
-struct DelayedJobs {
-    struct DelayedJobs *next;
-    UA_UInt32 *workerCounters; // initially NULL until the counter are set
-    UA_UInt32 jobsCount; // the size of the array is DELAYEDJOBSSIZE, the count may be less
-    UA_Job jobs[DELAYEDJOBSSIZE]; // when it runs full, a new delayedJobs entry is created
-};
+/* Application threads pass every entry on to the main loop in a block of its
+ * own. The main loop takes the block over with the blocks of the workers. */
+static UA_StatusCode
+retireOrphaned(UA_Server *server, UA_ServerCallback callback, void *data) {
+    struct LimboBlock *block =
+        UA_malloc(offsetof(struct LimboBlock, entries) + sizeof(block->entries[0]));
+    if(!block)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    block->next = NULL;
+    block->single = true;
+    block->entries[0].callback = callback;
+    block->entries[0].data = data;
+    block->entriesSize = 1;
+    cmm_smp_mb();
+    block->epoch = uatomic_read(&server->epoch);
+    cds_lfs_node_init(&block->node);
+    cds_lfs_push(&server->orphanedLimbo, &block->node);
+    return UA_STATUSCODE_GOOD;
+}
 
-/* Dispatched as an ordinary job when the DelayedJobs list is full */
-static void getCounters(UA_Server *server, struct DelayedJobs *delayed) {
-    UA_UInt32 *counters = UA_malloc(server->config.nThreads * sizeof(UA_UInt32));
-    for(UA_UInt16 i = 0; i < server->config.nThreads; i++)
-        counters[i] = server->workers[i].counter;
-    delayed->workerCounters = counters;
-}
-
-// Call from the main thread only. This is the only function that modifies
-// server->delayedWork. processDelayedWorkQueue modifies the "next" (after the
-// head).
-static void addDelayedJob(UA_Server *server, UA_Job *job) {
-    struct DelayedJobs *dj = server->delayedJobs;
-    if(!dj || dj->jobsCount >= DELAYEDJOBSSIZE) {
-        /* create a new DelayedJobs and add it to the linked list */
-        dj = UA_malloc(sizeof(struct DelayedJobs));
-        if(!dj) {
-            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
-                         "Not enough memory to add a delayed job");
-            return;
-        }
-        dj->jobsCount = 0;
-        dj->workerCounters = NULL;
-        dj->next = server->delayedJobs;
-        server->delayedJobs = dj;
-
-        /* dispatch a method that sets the counter for the full list that comes afterwards */
-        if(dj->next) {
-            UA_Job *setCounter = UA_malloc(sizeof(UA_Job));
-            *setCounter = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                                    {.method = (void (*)(UA_Server*, void*))getCounters, .data = dj->next}};
-            dispatchJobs(server, setCounter, 1);
+/* The entry is added to the limbo list of the calling worker or main loop.
+ * Other threads hand the entry over to the main loop. The caller may still
+ * hold pointers into the retired object until it returns. */
+static UA_StatusCode
+retireDelayed(UA_Server *server, UA_ServerCallback callback, void *data) {
+    UA_Limbo *limbo = &server->limbo;
+    if(currentWorker && currentWorker->server == server)
+        limbo = &currentWorker->limbo;
+    else if(mainLoopServer != server)
+        return retireOrphaned(server, callback, data);
+
+    struct LimboBlock *block = limbo->blocks;
+    if(!block || block->single || block->entriesSize >= LIMBOBLOCKSIZE) {
+        block = limbo->spare;
+        if(block) {
+            limbo->spare = NULL;
+        } else {
+            block = UA_malloc(sizeof(struct LimboBlock));
+            if(!block)
+                return UA_STATUSCODE_BADOUTOFMEMORY;
         }
+        block->single = false;
+        block->entriesSize = 0;
+        block->next = limbo->blocks;
+        limbo->blocks = block;
     }
-    dj->jobs[dj->jobsCount] = *job;
-    dj->jobsCount++;
-}
-
-static void addDelayedJobAsync(UA_Server *server, UA_Job *job) {
-    addDelayedJob(server, job);
-    UA_free(job);
+    block->entries[block->entriesSize].callback = callback;
+    block->entries[block->entriesSize].data = data;
+    block->entriesSize++;
+    limbo->count++;
+
+    /* The caller has unlinked the object before. Only the batches that were
+     * dispatched until now can still access it. */
+    cmm_smp_mb();
+    block->epoch = uatomic_read(&server->epoch);
+    return UA_STATUSCODE_GOOD;
 }
 
 static void server_free(UA_Server *server, void *data) {
@@ -460,83 +1033,240 @@ static void server_free(UA_Server *server, void *data) {
 }
 
 UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data) {
-    UA_Job *j = UA_malloc(sizeof(UA_Job));
-    if(!j)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    j->type = UA_JOBTYPE_METHODCALL;
-    j->job.methodCall.data = data;
-    j->job.methodCall.method = server_free;
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                         {.data = j, .method = (UA_ServerCallback)addDelayedJobAsync}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
-    return UA_STATUSCODE_GOOD;
+    return retireDelayed(server, server_free, data);
 }
 
 UA_StatusCode
 UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data) {
-    UA_Job *j = UA_malloc(sizeof(UA_Job));
-    if(!j)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    j->type = UA_JOBTYPE_METHODCALL;
-    j->job.methodCall.data = data;
-    j->job.methodCall.method = callback;
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                         {.data = j, .method = (UA_ServerCallback)addDelayedJobAsync}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
-    return UA_STATUSCODE_GOOD;
+    return retireDelayed(server, callback, data);
 }
 
-/* Find out which delayed jobs can be executed now */
-static void
-dispatchDelayedJobs(UA_Server *server, void *_) {
-    /* start at the second */
-    struct DelayedJobs *dw = server->delayedJobs, *beforedw = dw;
-    if(dw)
-        dw = dw->next;
-
-    /* find the first delayedwork where the counters have been set and have moved */
-    while(dw) {
-        if(!dw->workerCounters) {
-            beforedw = dw;
-            dw = dw->next;
-            continue;
-        }
-        UA_Boolean allMoved = true;
-        for(size_t i = 0; i < server->config.nThreads; i++) {
-            if(dw->workerCounters[i] == server->workers[i].counter) {
-                allMoved = false;
-                break;
-            }
-        }
-        if(allMoved)
-            break;
-        beforedw = dw;
-        dw = dw->next;
+/* Call only from the main loop. The epoch advances when all batches that were
+ * dispatched during the previous epoch have finished. */
+static void advanceEpoch(UA_Server *server) {
+    UA_UInt32 epoch = server->epoch;
+    if(uatomic_read(&server->inflightBatches[(epoch - 1) % UA_EPOCHS]) != 0)
+        return;
+    cmm_smp_mb();
+    uatomic_set(&server->epoch, epoch + 1);
+}
+
+/* Take over the limbo blocks of the workers */
+static void collectOrphanedLimbo(UA_Server *server) {
+    struct cds_lfs_head *head = __cds_lfs_pop_all(&server->orphanedLimbo);
+    if(!head)
+        return;
+    struct cds_lfs_node *node = &head->node;
+    while(node) {
+        struct LimboBlock *block = container_of(node, struct LimboBlock, node);
+        node = node->next;
+        block->next = server->limbo.blocks;
+        server->limbo.blocks = block;
+        server->limbo.count += block->entriesSize;
     }
+}
 
-#if (__GNUC__ <= 4 && __GNUC_MINOR__ <= 6)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wextra"
-#pragma GCC diagnostic ignored "-Wcast-qual"
-#pragma GCC diagnostic ignored "-Wunused-value"
-#endif
-    /* process and free all delayed jobs from here on */
-    while(dw) {
-        processJobs(server, dw->jobs, dw->jobsCount);
-        struct DelayedJobs *next = uatomic_xchg(&beforedw->next, NULL);
-        UA_free(dw);
-        UA_free(dw->workerCounters);
-        dw = next;
+/* Call only from the main loop */
+static void reclaimDelayed(UA_Server *server) {
+    collectOrphanedLimbo(server);
+    advanceEpoch(server);
+    drainLimbo(server, &server->limbo);
+
+    /* Limit the memory waiting for reclamation. Wait until the workers have
+     * finished the batches of the epochs that hold back the reclamation. */
+    if(server->limbo.count <= MAXLIMBO)
+        return;
+    UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_SERVER,
+                 "Waiting for the reclamation of %u delayed jobs",
+                 (unsigned int)server->limbo.count);
+    while(server->limbo.count > MAXLIMBO) {
+        sched_yield();
+        advanceEpoch(server);
+        drainLimbo(server, &server->limbo);
+    }
+}
+
+/* Call only when the worker threads are stopped */
+static void reclaimAllDelayed(UA_Server *server) {
+    for(size_t i = 0; server->workers && i < server->config.nThreads; i++) {
+        handOverLimbo(server, &server->workers[i].limbo);
+        UA_free(server->workers[i].limbo.spare);
+        server->workers[i].limbo.spare = NULL;
+    }
+    for(size_t i = 0; server->reactors && i < server->config.networkLayersSize; i++) {
+        handOverLimbo(server, &server->reactors[i].limbo);
+        UA_free(server->reactors[i].limbo.spare);
+        server->reactors[i].limbo.spare = NULL;
     }
-#if (__GNUC__ <= 4 && __GNUC_MINOR__ <= 6)
-#pragma GCC diagnostic pop
+    collectOrphanedLimbo(server);
+    /* The callbacks may retire further entries */
+    struct LimboBlock *block;
+    while((block = server->limbo.blocks)) {
+        server->limbo.blocks = block->next;
+        server->limbo.count -= block->entriesSize;
+        runLimboBlock(server, block);
+        UA_free(block);
+    }
+    UA_free(server->limbo.spare);
+    server->limbo.spare = NULL;
+}
+
+void UA_Server_reclaimDelayed(UA_Server *server) {
+    reclaimAllDelayed(server);
+}
+
+void UA_Server_beginAccess(UA_Server *server) {
+    if(isServerThread(server))
+        return;
+    if(accessDepth++ == 0)
+        accessEpoch = enterEpoch(server);
+}
+
+void UA_Server_endAccess(UA_Server *server) {
+    if(isServerThread(server) || accessDepth == 0)
+        return;
+    if(--accessDepth > 0)
+        return;
+    cmm_smp_mb(); // the accesses have finished before they are counted out
+    uatomic_dec(&server->inflightBatches[accessEpoch % UA_EPOCHS]);
+}
+
+#else
+
+void UA_Server_beginAccess(UA_Server *server) {}
+void UA_Server_endAccess(UA_Server *server) {}
+
 #endif
 
+/*****************/
+/* Parallel Runs */
+/*****************/
+
+/**
+ * The parts are taken from a shared counter by the calling thread and by one
+ * job per worker. So a busy worker holds back no part: the calling thread runs
+ * the parts that were not taken until it runs out of work, and then waits
+ * only for the parts that are in progress. The jobs may run after the call has
+ * returned. So the shared state is reference-counted and freed by the last
+ * participant. */
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+struct ParallelRun {
+    UA_Server_partRunner run;
+    void *handle;
+    size_t parts;
+    size_t nextPart; /* the next part to take */
+    size_t finished; /* number of finished parts */
+    size_t refCount;
+};
+
+static void runParts(struct ParallelRun *pr) {
+    while(true) {
+        size_t p = uatomic_add_return(&pr->nextPart, 1) - 1;
+        if(p >= pr->parts)
+            break;
+        pr->run(pr->handle, p);
+        cmm_smp_mb(); // the part is done before it is counted
+        uatomic_inc(&pr->finished);
+    }
 }
 
+static void releaseRun(struct ParallelRun *pr) {
+    if(uatomic_sub_return(&pr->refCount, 1) == 0)
+        UA_free(pr);
+}
+
+/* Runs in a worker with the RCU lock held */
+static void parallelRunJob(UA_Server *server, void *data) {
+    struct ParallelRun *pr = (struct ParallelRun*)data;
+    runParts(pr);
+    releaseRun(pr);
+}
+
+static UA_StatusCode
+runParallel(UA_Server *server, UA_Server_partRunner run, void *handle, size_t parts) {
+    struct ParallelRun *pr = UA_malloc(sizeof(struct ParallelRun));
+    if(!pr)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    pr->run = run;
+    pr->handle = handle;
+    pr->parts = parts;
+    pr->nextPart = 0;
+    pr->finished = 0;
+    pr->refCount = 1;
+
+    /* One job for every worker that can help. The calling worker does not
+     * need a job. */
+    size_t helpers = server->config.nThreads;
+    if(helpers >= parts)
+        helpers = parts - 1;
+    UA_Job job;
+    job.type = UA_JOBTYPE_METHODCALL;
+    job.job.methodCall.method = parallelRunJob;
+    job.job.methodCall.data = pr;
+    job.priority = UA_JOBPRIORITY_NORMAL;
+    for(size_t i = 0, w = 0; i < helpers; i++, w++) {
+        if(&server->workers[w] == currentWorker)
+            w++;
+        if(w >= server->config.nThreads)
+            break;
+        uatomic_inc(&pr->refCount);
+        if(enqueueJobAnyThread(server, &server->workers[w], &job) != UA_STATUSCODE_GOOD) {
+            uatomic_dec(&pr->refCount);
+            break;
+        }
+    }
+
+    runParts(pr);
+
+    /* Wait for the parts that are run by the workers */
+    while(uatomic_read(&pr->finished) < parts)
+        sched_yield();
+    cmm_smp_mb();
+    releaseRun(pr);
+    return UA_STATUSCODE_GOOD;
+}
+
+#endif
+
+void
+UA_Server_runParallel(UA_Server *server, UA_Server_partRunner run, void *handle, size_t parts) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(parts > 1 && server->workers &&
+       runParallel(server, run, handle, parts) == UA_STATUSCODE_GOOD)
+        return;
 #endif
+    for(size_t p = 0; p < parts; p++)
+        run(handle, p);
+}
+
+struct NodeIteration {
+    UA_NodeStore *ns;
+    UA_NodeStore_nodeVisitor visitor;
+    void **handles;
+    size_t partitions;
+};
+
+static void iterateNodesPart(void *handle, size_t part) {
+    struct NodeIteration *ni = (struct NodeIteration*)handle;
+    UA_NodeStore_iteratePartition(ni->ns, part, ni->partitions, ni->visitor, ni->handles[part]);
+}
+
+UA_StatusCode
+UA_Server_iterateNodesParallel(UA_Server *server, UA_NodeStore_nodeVisitor visitor,
+                               void **handles, size_t handlesSize,
+                               UA_Server_nodeReducer reduce, void *result) {
+    if(handlesSize == 0)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    struct NodeIteration ni = {server->nodestore, visitor, handles, handlesSize};
+    UA_Server_runParallel(server, iterateNodesPart, &ni, handlesSize);
+    if(reduce) {
+        for(size_t i = 0; i < handlesSize; i++)
+            reduce(result, handles[i]);
+    }
+    return UA_STATUSCODE_GOOD;
+}
 
 /********************/
 /* Main Server Loop */
@@ -551,9 +1281,9 @@ static void processMainLoopJobs(UA_Server *server) {
     struct MainLoopJob *mlw = (struct MainLoopJob*)&head->node;
     struct MainLoopJob *next;
     do {
-        processJobs(server, &mlw->job, 1);
+        PROCESSJOBS(server, &server->statistics.mainLoop, &mlw->job, 1);
         next = (struct MainLoopJob*)mlw->node.next;
-        UA_free(mlw);
+        UA_objfree(mlw);
         //cppcheck-suppress unreadVariable
     } while((mlw = next));
     //UA_free(head);
@@ -561,26 +1291,61 @@ static void processMainLoopJobs(UA_Server *server) {
 #endif
 
 UA_StatusCode UA_Server_run_startup(UA_Server *server) {
+    pinThread(server, server->config.mainLoopCpuMask);
 #ifdef UA_ENABLE_MULTITHREADING
     /* Spin up the worker threads */
     UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Spinning up %u worker thread(s)", server->config.nThreads);
-    pthread_cond_init(&server->dispatchQueue_condition, 0);
     server->workers = UA_malloc(server->config.nThreads * sizeof(UA_Worker));
     if(!server->workers)
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    server->reactors = NULL;
+    server->dispatchWorker = 0;
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    server->enqueuedBatches = 0;
+#endif
+    server->epoch = 0;
+    memset(server->inflightBatches, 0, sizeof(server->inflightBatches));
+    mainLoopServer = server;
+
+    /* Preallocate the dispatch slots */
+    for(size_t i = 0; i < UA_JOBPRIORITY_COUNT; i++)
+        server->openDispatchSlots[i] = NULL;
+    cds_lfs_init(&server->freeDispatchSlots);
+    size_t slots = (size_t)server->config.nThreads * DISPATCHSLOTS;
+    server->dispatchSlots = UA_malloc(slots * sizeof(struct DispatchJobsList));
+    if(!server->dispatchSlots) {
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Could not preallocate the dispatch slots");
+        slots = 0;
+    }
+    for(size_t i = 0; i < slots; i++) {
+        server->dispatchSlots[i].pooled = true;
+        releaseDispatchSlot(server, &server->dispatchSlots[i]);
+    }
+
     for(size_t i = 0; i < server->config.nThreads; i++) {
         UA_Worker *worker = &server->workers[i];
         worker->server = server;
-        worker->counter = 0;
         worker->running = true;
+        worker->sleeping = false;
+        worker->realtimeBatches = 0;
+        memset(&worker->limbo, 0, sizeof(UA_Limbo));
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        worker->takenBatches = 0;
+        memset(&worker->statistics, 0, sizeof(UA_JobStatistics));
+#endif
+        pthread_mutex_init(&worker->mutex, NULL);
+        pthread_cond_init(&worker->condition, NULL);
+        for(size_t j = 0; j < UA_JOBPRIORITY_COUNT; j++) {
+            worker->openSlots[j] = NULL;
+            cds_wfcq_init(&worker->lanes[j].head, &worker->lanes[j].tail);
+        }
+    }
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        UA_Worker *worker = &server->workers[i];
         pthread_create(&worker->thr, NULL, (void* (*)(void*))workerLoop, worker);
     }
-
-    /* Try to execute delayed callbacks every 10 sec */
-    UA_Job processDelayed = {.type = UA_JOBTYPE_METHODCALL,
-                             .job.methodCall = {.method = dispatchDelayedJobs, .data = NULL} };
-    UA_Server_addRepeatedJob(server, processDelayed, 10000, NULL);
 #endif
 
     /* Start the networklayers */
@@ -592,6 +1357,30 @@ UA_StatusCode UA_Server_run_startup(UA_Server *server) {
             UA_String_copy(&nl->discoveryUrl, &server->endpointDescriptions[j].endpointUrl);
         }
     }
+    UA_Server_buildDiscoveryCache(server);
+
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Spin up the reactor threads that drive the networklayers */
+    if(server->config.networkReactors && server->config.networkLayersSize > 0) {
+        UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
+                    "Spinning up %u reactor thread(s)",
+                    (unsigned int)server->config.networkLayersSize);
+        server->reactors = UA_calloc(server->config.networkLayersSize, sizeof(UA_Worker));
+        if(!server->reactors)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        for(size_t i = 0; i < server->config.networkLayersSize; i++) {
+            UA_Worker *reactor = &server->reactors[i];
+            reactor->server = server;
+            reactor->networkLayer = &server->config.networkLayers[i];
+            reactor->running = true;
+            pthread_create(&reactor->thr, NULL, (void* (*)(void*))reactorLoop, reactor);
+        }
+    }
+#else
+    if(server->config.networkReactors)
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "The network reactors require multithreading");
+#endif
 
     return result;
 }
@@ -620,35 +1409,125 @@ static void completeMessages(UA_Server *server, UA_Job *job) {
         job->type = UA_JOBTYPE_NOTHING;
 }
 
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+static void recordIteration(UA_Server *server, UA_DateTime duration) {
+    UA_SchedulerStatistics *stats = &server->statistics;
+    stats->iterations++;
+    stats->iterationTime += (UA_UInt64)duration;
+    if((UA_UInt64)duration > stats->maxIterationTime)
+        stats->maxIterationTime = (UA_UInt64)duration;
+    if(duration > MAXTIMEOUT * UA_MSEC_TO_DATETIME)
+        stats->overruns++;
+}
+
+UA_StatusCode
+UA_Server_getSchedulerStatistics(UA_Server *server, UA_SchedulerStatistics *stats) {
+    *stats = server->statistics;
+    stats->queueDepth = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->workers) {
+        UA_UInt64 taken = 0;
+        for(size_t i = 0; i < server->config.nThreads; i++)
+            taken += uatomic_read(&server->workers[i].takenBatches);
+        if(server->enqueuedBatches > taken)
+            stats->queueDepth = server->enqueuedBatches - taken;
+    }
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Server_getWorkerStatistics(UA_Server *server, size_t workerIndex, UA_JobStatistics *stats) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(!server->workers)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if(workerIndex < server->config.nThreads) {
+        *stats = server->workers[workerIndex].statistics;
+        return UA_STATUSCODE_GOOD;
+    }
+    workerIndex -= server->config.nThreads;
+    if(!server->reactors || workerIndex >= server->config.networkLayersSize)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    *stats = server->reactors[workerIndex].statistics;
+    return UA_STATUSCODE_GOOD;
+#else
+    return UA_STATUSCODE_BADINVALIDARGUMENT;
+#endif
+}
+#endif
+
+UA_DateTime UA_Server_now(const UA_Server *server) {
+#ifdef UA_ENABLE_MULTITHREADING
+    if(currentWorker && currentWorker->server == server)
+        return currentWorker->now;
+#endif
+    return server->now;
+}
+
 UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    UA_DateTime iterationStart = UA_DateTime_nowMonotonic();
+    UA_DateTime waitTime = 0;
+#endif
 #ifdef UA_ENABLE_MULTITHREADING
     /* Run work assigned for the main thread */
     processMainLoopJobs(server);
+    /* Reclaim the delayed jobs that have become safe */
+    reclaimDelayed(server);
 #endif
     /* Process repeated work */
+    server->now = UA_DateTime_now();
     UA_DateTime now = UA_DateTime_nowMonotonic();
     UA_DateTime nextRepeated = processRepeatedJobs(server, now);
 
-    UA_UInt16 timeout = 0;
+    UA_UInt32 timeout = 0; /* in microseconds */
     if(waitInternal)
-        timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
+        timeout = (UA_UInt32)((nextRepeated - now) / UA_USEC_TO_DATETIME);
 
     /* Get work from the networklayer */
-    for(size_t i = 0; i < server->config.networkLayersSize; i++) {
+    size_t networkLayersSize = server->config.networkLayersSize;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(server->reactors) {
+        /* The reactors drive the networklayers. Return regularly to advance
+         * the epoch. */
+        networkLayersSize = 0;
+        if(timeout > REACTORINTERVAL * 1000)
+            timeout = REACTORINTERVAL * 1000;
+        if(timeout > 0) {
+# ifdef UA_ENABLE_SCHEDULER_STATISTICS
+            UA_DateTime waitStart = UA_DateTime_nowMonotonic();
+# endif
+            struct timespec ts = {0, (long)timeout * 1000L};
+            nanosleep(&ts, NULL);
+# ifdef UA_ENABLE_SCHEDULER_STATISTICS
+            waitTime += UA_DateTime_nowMonotonic() - waitStart;
+# endif
+        }
+    }
+#endif
+    for(size_t i = 0; i < networkLayersSize; i++) {
         UA_ServerNetworkLayer *nl = &server->config.networkLayers[i];
         UA_Job *jobs;
         size_t jobsSize;
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        UA_DateTime waitStart = UA_DateTime_nowMonotonic();
+#endif
         /* only the last networklayer waits on the tieout */
-        if(i == server->config.networkLayersSize-1)
+        if(i == networkLayersSize-1)
             jobsSize = nl->getJobs(nl, &jobs, timeout);
         else
             jobsSize = nl->getJobs(nl, &jobs, 0);
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+        waitTime += UA_DateTime_nowMonotonic() - waitStart;
+#endif
+        if(jobsSize > 0)
+            server->now = UA_DateTime_now(); /* time has passed while waiting */
 
         for(size_t k = 0; k < jobsSize; k++) {
 #ifdef UA_ENABLE_MULTITHREADING
             /* Filter out delayed work */
             if(jobs[k].type == UA_JOBTYPE_METHODCALL_DELAYED) {
-                addDelayedJob(server, &jobs[k]);
+                retireDelayed(server, jobs[k].job.methodCall.method, jobs[k].job.methodCall.data);
                 jobs[k].type = UA_JOBTYPE_NOTHING;
                 continue;
             }
@@ -660,46 +1539,80 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 
 #ifdef UA_ENABLE_MULTITHREADING
         dispatchJobs(server, jobs, jobsSize);
-        /* Wake up worker threads */
-        if(jobsSize > 0)
-            pthread_cond_broadcast(&server->dispatchQueue_condition);
 #else
-        processJobs(server, jobs, jobsSize);
-        if(jobsSize > 0)
-            UA_free(jobs);
+        PROCESSJOBS(server, &server->statistics.mainLoop, jobs, jobsSize);
+        if(nl->flush)
+            nl->flush(nl);
 #endif
     }
 
     now = UA_DateTime_nowMonotonic();
-    timeout = 0;
-    if(nextRepeated > now)
-        timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
-    return timeout;
+#ifdef UA_ENABLE_SCHEDULER_STATISTICS
+    recordIteration(server, now - iterationStart - waitTime);
+#endif
+    if(nextRepeated <= now)
+        return 0;
+    return (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
 }
 
 UA_StatusCode UA_Server_run_shutdown(UA_Server *server) {
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Stop the reactors before the networklayers they drive */
+    if(server->reactors) {
+        for(size_t i = 0; i < server->config.networkLayersSize; i++)
+            server->reactors[i].running = false;
+        for(size_t i = 0; i < server->config.networkLayersSize; i++)
+            pthread_join(server->reactors[i].thr, NULL);
+    }
+#endif
     for(size_t i = 0; i < server->config.networkLayersSize; i++) {
         UA_ServerNetworkLayer *nl = &server->config.networkLayers[i];
         UA_Job *stopJobs;
         size_t stopJobsSize = nl->stop(nl, &stopJobs);
-        processJobs(server, stopJobs, stopJobsSize);
-        UA_free(stopJobs);
+#ifdef UA_ENABLE_MULTITHREADING
+        /* the workers may still process messages of the connections */
+        for(size_t k = 0; k < stopJobsSize; k++) {
+            if(stopJobs[k].type != UA_JOBTYPE_METHODCALL_DELAYED)
+                continue;
+            retireDelayed(server, stopJobs[k].job.methodCall.method,
+                          stopJobs[k].job.methodCall.data);
+            stopJobs[k].type = UA_JOBTYPE_NOTHING;
+        }
+#endif
+        PROCESSJOBS(server, &server->statistics.mainLoop, stopJobs, stopJobsSize);
     }
 
 #ifdef UA_ENABLE_MULTITHREADING
     UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Shutting down %u worker thread(s)", server->config.nThreads);
     /* Wait for all worker threads to finish */
-    for(size_t i = 0; i < server->config.nThreads; i++)
-        server->workers[i].running = false;
-    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        UA_Worker *worker = &server->workers[i];
+        pthread_mutex_lock(&worker->mutex);
+        worker->running = false;
+        pthread_cond_signal(&worker->condition);
+        pthread_mutex_unlock(&worker->mutex);
+    }
     for(size_t i = 0; i < server->config.nThreads; i++)
         pthread_join(server->workers[i].thr, NULL);
-    UA_free(server->workers);
 
-    /* Manually finish the work still enqueued.
-       This especially contains delayed frees */
+    /* Manually finish the work still enqueued and the delayed jobs */
     emptyDispatchQueue(server);
+    reclaimAllDelayed(server);
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        pthread_mutex_destroy(&server->workers[i].mutex);
+        pthread_cond_destroy(&server->workers[i].condition);
+    }
+    UA_free(server->workers);
+    uatomic_set(&server->workers, NULL);
+    UA_free(server->reactors);
+    server->reactors = NULL;
+    UA_free(server->dispatchSlots);
+
+    /* Run the callbacks that were dispatched to the main loop in the meantime.
+     * Later callers find the server stopped and run their callbacks inline. */
+    processMainLoopJobs(server);
+    mainLoopServer = NULL;
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
 #endif
@@ -23,6 +23,25 @@ extern "C" {
    the response. */
 typedef void (*UA_Service)(UA_Server*, UA_Session*, const void*, void*);
 
+/* The services that are dispatched for binary requests. The table is ordered
+ * by the numeric nodeid of the request type. The Publish service has no
+ * UA_Service signature and is called directly. */
+typedef struct {
+    UA_UInt32 requestTypeId;
+    const char *name;
+    const UA_DataType *requestType;
+    const UA_DataType *responseType;
+    UA_Service service;
+    UA_Boolean requiresSession;
+} UA_ServiceDescription;
+
+extern const UA_ServiceDescription UA_Services[];
+extern const size_t UA_ServicesSize;
+
+/* Returns the index of the service in UA_Services or UA_ServicesSize if the
+ * request type is unknown */
+size_t UA_Services_find(UA_UInt32 requestTypeId);
+
 /**
  * Discovery Service Set
  * ---------------------
@@ -38,6 +57,18 @@ void Service_GetEndpoints(UA_Server *server, UA_Session *session,
                           const UA_GetEndpointsRequest *request,
                           UA_GetEndpointsResponse *response);
 
+/* Send the response over the SecureChannel of the session from the encoding
+ * that was cached when the server started. No response object is built. If
+ * nothing is cached or the request needs the regular service, nothing is sent
+ * and false is returned. */
+UA_Boolean Service_FindServers_cached(UA_Server *server, UA_Session *session,
+                                      const UA_FindServersRequest *request,
+                                      UA_UInt32 requestId);
+
+UA_Boolean Service_GetEndpoints_cached(UA_Server *server, UA_Session *session,
+                                       const UA_GetEndpointsRequest *request,
+                                       UA_UInt32 requestId);
+
 /* Not Implemented: Service_RegisterServer */
 
 /**
@@ -96,14 +127,21 @@ void Service_CloseSession(UA_Server *server, UA_Session *session,
  * Server. */
 
 /* Used to add one or more Nodes into the AddressSpace hierarchy. */
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_AddNodes(UA_Server *server, UA_Session *session,
                       const UA_AddNodesRequest *request,
                       UA_AddNodesResponse *response);
+#endif
 
 void Service_AddNodes_single(UA_Server *server, UA_Session *session,
                              const UA_AddNodesItem *item, UA_AddNodesResult *result,
                              UA_InstantiationCallback *instantiationCallback);
 
+/* Adds many nodes in one pass. The results are initialized by the caller. */
+void Service_AddNodes_batch(UA_Server *server, UA_Session *session,
+                            const UA_AddNodesItem *items, size_t itemsSize,
+                            UA_AddNodesResult *results);
+
 /* Add an existing node. The node is assumed to be "finished", i.e. no
  * instantiation from inheritance is necessary */
 void
@@ -113,26 +151,32 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
                           UA_AddNodesResult *result);
 
 /* Used to add one or more References to one or more Nodes. */
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_AddReferences(UA_Server *server, UA_Session *session,
                            const UA_AddReferencesRequest *request,
                            UA_AddReferencesResponse *response);
+#endif
 
 UA_StatusCode Service_AddReferences_single(UA_Server *server, UA_Session *session,
                                            const UA_AddReferencesItem *item);
 
 /* Used to delete one or more Nodes from the AddressSpace. */
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_DeleteNodes(UA_Server *server, UA_Session *session,
                          const UA_DeleteNodesRequest *request,
                          UA_DeleteNodesResponse *response);
+#endif
 
 UA_StatusCode Service_DeleteNodes_single(UA_Server *server, UA_Session *session,
                                          const UA_NodeId *nodeId,
                                          UA_Boolean deleteReferences);
 
 /* Used to delete one or more References of a Node. */
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_DeleteReferences(UA_Server *server, UA_Session *session,
                               const UA_DeleteReferencesRequest *request,
                               UA_DeleteReferencesResponse *response);
+#endif
 
 UA_StatusCode Service_DeleteReferences_single(UA_Server *server, UA_Session *session,
                                               const UA_DeleteReferencesItem *item);
@@ -220,6 +264,30 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
                          UA_TimestampsToReturn timestamps,
                          const UA_ReadValueId *id, UA_DataValue *v);
 
+struct UA_AsyncReadBatch;
+
+/* Like Service_Read_single, but reads from asynchronous data sources are added
+ * to the batch (if not NULL). Then v is written when the read completes. */
+void Service_Read_singleAsync(UA_Server *server, UA_Session *session,
+                              UA_TimestampsToReturn timestamps,
+                              const UA_ReadValueId *id, struct UA_AsyncReadBatch *batch,
+                              UA_DataValue *v);
+
+/* Processes the request like Service_Read and sends the response over the
+ * SecureChannel of the session. Reads from asynchronous data sources do not
+ * block. The response is sent when the last of them has completed. Returns
+ * false if out of memory. Then nothing was done. */
+UA_Boolean Service_Read_async(UA_Server *server, UA_Session *session,
+                              const UA_ReadRequest *request, UA_UInt32 requestId);
+
+/* Sends the ReadResponse over the SecureChannel of the session, encoded
+ * straight from the nodes. This is done only if every item reads the value of a
+ * variable with a variant value source or bound memory without an index range. Otherwise,
+ * nothing is sent and false is returned. Then the request is processed by
+ * Service_Read. */
+UA_Boolean Service_Read_direct(UA_Server *server, UA_Session *session,
+                               const UA_ReadRequest *request, UA_UInt32 requestId);
+
 /* Used to write one or more Attributes of one or more Nodes. For constructed
  * Attribute values whose elements are indexed, such as an array, this Service
  * allows Clients to write the entire set of indexed values as a composite, to
@@ -231,7 +299,15 @@ void Service_Write(UA_Server *server, UA_Session *session,
 UA_StatusCode Service_Write_single(UA_Server *server, UA_Session *session,
                                    const UA_WriteValue *wvalue);
 
-/* Not Implemented: Service_HistoryRead */
+#ifdef UA_ENABLE_HISTORIZING
+/* Used to read historical values of one or more Nodes. The values are taken
+ * from the recorded history of the historizing variables. Only the raw values
+ * (ReadRawModifiedDetails without modified values and bounds) are supported. */
+void Service_HistoryRead(UA_Server *server, UA_Session *session,
+                         const UA_HistoryReadRequest *request,
+                         UA_HistoryReadResponse *response);
+#endif
+
 /* Not Implemented: Service_HistoryUpdate */
 
 /**
@@ -324,10 +400,10 @@ void Service_Publish(UA_Server *server, UA_Session *session,
                      const UA_PublishRequest *request, UA_UInt32 requestId);
 
 /* Requests the Subscription to republish a NotificationMessage from its
- * retransmission queue. */
+ * retransmission queue. The response is sent directly, since the message is
+ * copied from its stored encoding. */
 void Service_Republish(UA_Server *server, UA_Session *session,
-                       const UA_RepublishRequest *request,
-                       UA_RepublishResponse *response);
+                       const UA_RepublishRequest *request, UA_UInt32 requestId);
 
 /* Invoked to delete one or more Subscriptions that belong to the Client's
  * Session. */
@@ -335,7 +411,12 @@ void Service_DeleteSubscriptions(UA_Server *server, UA_Session *session,
                                  const UA_DeleteSubscriptionsRequest *request,
                                  UA_DeleteSubscriptionsResponse *response);
 
-/* Not Implemented: Service_TransferSubscription */
+/* Used to transfer subscriptions of the same user to the session, e.g. after
+ * the session of a reconnecting client was lost. The subscriptions keep their
+ * ids, items and retransmission queues. */
+void Service_TransferSubscriptions(UA_Server *server, UA_Session *session,
+                                   const UA_TransferSubscriptionsRequest *request,
+                                   UA_TransferSubscriptionsResponse *response);
 
 #endif
 
@@ -100,20 +100,35 @@ UA_StatusCode parse_numericrange(const UA_String *str, UA_NumericRange *range) {
         break;                                                  \
     }
 
-static void handleServerTimestamps(UA_TimestampsToReturn timestamps, UA_DataValue* v) {
+static void handleServerTimestamps(UA_TimestampsToReturn timestamps, UA_DataValue* v,
+                                   UA_DateTime now) {
     if(v && (timestamps == UA_TIMESTAMPSTORETURN_SERVER || timestamps == UA_TIMESTAMPSTORETURN_BOTH)) {
         v->hasServerTimestamp = true;
-        v->serverTimestamp = UA_DateTime_now();
+        v->serverTimestamp = now;
     }
 }
 
-static void handleSourceTimestamps(UA_TimestampsToReturn timestamps, UA_DataValue* v) {
+static void handleSourceTimestamps(UA_TimestampsToReturn timestamps, UA_DataValue* v,
+                                   UA_DateTime now) {
     if(timestamps == UA_TIMESTAMPSTORETURN_SOURCE || timestamps == UA_TIMESTAMPSTORETURN_BOTH) {
         v->hasSourceTimestamp = true;
-        v->sourceTimestamp = UA_DateTime_now();
+        v->sourceTimestamp = now;
     }
 }
 
+/* The snapshot of bound memory is placed in buf if it fits */
+static UA_StatusCode
+readValueMemory(UA_Server *server, const UA_ValueMemory *memory, UA_TimestampsToReturn timestamps,
+                void *buf, size_t bufSize, UA_DataValue *v) {
+    UA_DateTime sourceTimestamp = UA_Server_now(server);
+    UA_StatusCode retval = UA_ValueMemory_read(memory, buf, bufSize, &v->value, &sourceTimestamp);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    v->hasValue = true;
+    handleSourceTimestamps(timestamps, v, sourceTimestamp);
+    return UA_STATUSCODE_GOOD;
+}
+
 /* force cast for zero-copy reading. ensure that the variant is never written into. */
 static void forceVariantSetScalar(UA_Variant *v, const void *p, const UA_DataType *t) {
     UA_Variant_init(v);
@@ -122,9 +137,44 @@ static void forceVariantSetScalar(UA_Variant *v, const void *p, const UA_DataTyp
     v->storageType = UA_VARIANT_DATA_NODELETE;
 }
 
+/* Starts an asynchronous read into v. Returns
+ * UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY if the read is pending. Then v
+ * must not be touched anymore until the batch is finished. */
+static UA_StatusCode
+startAsyncRead(const UA_VariableNode *vn, UA_TimestampsToReturn timestamps,
+               const UA_NumericRange *range, UA_AsyncReadBatch *batch, UA_DataValue *v) {
+    UA_AsyncRead *ar = UA_malloc(sizeof(UA_AsyncRead));
+    if(!ar)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    ar->batch = batch;
+    ar->target = v;
+    ar->timestamps = timestamps;
+#ifndef UA_ENABLE_MULTITHREADING
+    batch->pending++;
+#else
+    uatomic_inc(&batch->pending);
+#endif
+    UA_Boolean sourceTimeStamp = (timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
+                                  timestamps == UA_TIMESTAMPSTORETURN_BOTH);
+    UA_StatusCode retval = vn->value.dataSource.readAsync(vn->value.dataSource.handle, vn->nodeId,
+                                                          sourceTimeStamp, range, ar);
+    if(retval != UA_STATUSCODE_GOOD) {
+        /* Not started. The setup reference keeps the batch from finishing. */
+#ifndef UA_ENABLE_MULTITHREADING
+        batch->pending--;
+#else
+        uatomic_dec(&batch->pending);
+#endif
+        UA_free(ar);
+        return retval;
+    }
+    return UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY;
+}
+
 static UA_StatusCode
 getVariableNodeValue(UA_Server *server, UA_Session *session, const UA_VariableNode *vn,
-                     const UA_TimestampsToReturn timestamps, const UA_ReadValueId *id, UA_DataValue *v) {
+                     const UA_TimestampsToReturn timestamps, const UA_ReadValueId *id,
+                     UA_AsyncReadBatch *batch, UA_DataValue *v) {
     UA_NumericRange range;
     UA_NumericRange *rangeptr = NULL;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
@@ -139,13 +189,37 @@ getVariableNodeValue(UA_Server *server, UA_Session *session, const UA_VariableNo
         if(vn->value.variant.callback.onRead)
             vn->value.variant.callback.onRead(vn->value.variant.callback.handle, vn->nodeId,
                                               &v->value, rangeptr);
+        UA_Variant value;
+        UA_VariableNode_getValue(vn, &value);
         if(!rangeptr) {
-            v->value = vn->value.variant.value;
-            v->value.storageType = UA_VARIANT_DATA_NODELETE;
-        } else
-            retval = UA_Variant_copyRange(&vn->value.variant.value, &v->value, range);
+            /* Shared data gets a new reference. That stays valid when a write
+               replaces the node value. */
+            if(value.storageType == UA_VARIANT_DATA_SHARED)
+                retval = UA_Variant_copy(&value, &v->value);
+            else {
+                v->value = value;
+                v->value.storageType = UA_VARIANT_DATA_NODELETE;
+            }
+        } else if(value.storageType == UA_VARIANT_DATA_SHARED)
+            retval = UA_Variant_copyRange(&value, &v->value, range);
+        else
+            retval = UA_Variant_borrowRange(&value, &v->value, range);
         if(retval == UA_STATUSCODE_GOOD)
-            handleSourceTimestamps(timestamps, v);
+            handleSourceTimestamps(timestamps, v, UA_Server_now(server));
+    } else if(vn->valueSource == UA_VALUESOURCE_MEMORY) {
+        retval = readValueMemory(server, &vn->value.memory, timestamps, NULL, 0, v);
+        if(retval == UA_STATUSCODE_GOOD && rangeptr) {
+            UA_Variant snapshot = v->value;
+            retval = UA_Variant_copyRange(&snapshot, &v->value, range);
+            UA_Variant_deleteMembers(&snapshot);
+        }
+    } else if(batch && vn->value.dataSource.readAsync) {
+        retval = startAsyncRead(vn, timestamps, rangeptr, batch, v);
+    } else if(!vn->value.dataSource.read && vn->value.dataSource.readBatch && !rangeptr) {
+        UA_Boolean sourceTimeStamp = (timestamps == UA_TIMESTAMPSTORETURN_SOURCE ||
+                                      timestamps == UA_TIMESTAMPSTORETURN_BOTH);
+        retval = vn->value.dataSource.readBatch(vn->value.dataSource.handle, &vn->nodeId, 1,
+                                                sourceTimeStamp, v);
     } else {
         if(!vn->value.dataSource.read) {
             UA_LOG_DEBUG_SESSION(server->config.logger, session, "DataSource cannot be read in ReadRequest");
@@ -168,13 +242,17 @@ getVariableNodeDataType(UA_Server *server, UA_Session *session,
                         const UA_VariableNode *vn, UA_DataValue *v) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     if(vn->valueSource == UA_VALUESOURCE_VARIANT) {
-        if(vn->value.variant.value.type) {
-            forceVariantSetScalar(&v->value, &vn->value.variant.value.type->typeId, &UA_TYPES[UA_TYPES_NODEID]);
+        UA_Variant value;
+        UA_VariableNode_getValue(vn, &value);
+        if(value.type) {
+            forceVariantSetScalar(&v->value, &value.type->typeId, &UA_TYPES[UA_TYPES_NODEID]);
         } else {
             UA_NodeId nullid;
             UA_NodeId_init(&nullid);
             UA_Variant_setScalarCopy(&v->value, &nullid, &UA_TYPES[UA_TYPES_NODEID]);
         }
+    } else if(vn->valueSource == UA_VALUESOURCE_MEMORY) {
+        forceVariantSetScalar(&v->value, &vn->value.memory.type->typeId, &UA_TYPES[UA_TYPES_NODEID]);
     } else {
         /* Read from the datasource to see the data type */
         if(!vn->value.dataSource.read) {
@@ -199,9 +277,14 @@ getVariableNodeArrayDimensions(UA_Server *server, UA_Session *session,
                                const UA_VariableNode *vn, UA_DataValue *v) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     if(vn->valueSource == UA_VALUESOURCE_VARIANT) {
-        UA_Variant_setArray(&v->value, vn->value.variant.value.arrayDimensions,
-                            vn->value.variant.value.arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
+        UA_Variant value;
+        UA_VariableNode_getValue(vn, &value);
+        UA_Variant_setArray(&v->value, value.arrayDimensions,
+                            value.arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
         v->value.storageType = UA_VARIANT_DATA_NODELETE;
+    } else if(vn->valueSource == UA_VALUESOURCE_MEMORY) {
+        /* Bound arrays have one dimension */
+        UA_Variant_setArray(&v->value, NULL, 0, &UA_TYPES[UA_TYPES_INT32]);
     } else {
         if(!vn->value.dataSource.read) {
             UA_LOG_DEBUG_SESSION(server->config.logger, session, "DataSource cannot be read in ReadRequest");
@@ -224,10 +307,17 @@ static const UA_String binEncoding = {sizeof("DefaultBinary")-1, (UA_Byte*)"Defa
 /* clang complains about unused variables */
 // static const UA_String xmlEncoding = {sizeof("DefaultXml")-1, (UA_Byte*)"DefaultXml"};
 
-/* Reads a single attribute from a node in the nodestore */
 void Service_Read_single(UA_Server *server, UA_Session *session,
                          const UA_TimestampsToReturn timestamps,
                          const UA_ReadValueId *id, UA_DataValue *v) {
+    Service_Read_singleAsync(server, session, timestamps, id, NULL, v);
+}
+
+/* Reads a single attribute from a node in the nodestore */
+void Service_Read_singleAsync(UA_Server *server, UA_Session *session,
+                              const UA_TimestampsToReturn timestamps,
+                              const UA_ReadValueId *id, UA_AsyncReadBatch *batch,
+                              UA_DataValue *v) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Read the attribute %i", id->attributeId);
     if(id->dataEncoding.name.length > 0 &&
        !UA_String_equal(&binEncoding, &id->dataEncoding.name)) {
@@ -249,6 +339,9 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
         v->status = UA_STATUSCODE_BADNODEIDUNKNOWN;
         return;
     }
+#ifdef UA_ENABLE_NODE_STATISTICS
+    UA_Server_countNodeAccess(server, &id->nodeId, UA_NODEACCESS_READ);
+#endif
 
     /* When setting the value fails in the switch, we get an error code and set hasValue to false */
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
@@ -303,7 +396,10 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
         break;
     case UA_ATTRIBUTEID_VALUE:
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
-        retval = getVariableNodeValue(server, session, (const UA_VariableNode*)node, timestamps, id, v);
+        retval = getVariableNodeValue(server, session, (const UA_VariableNode*)node,
+                                      timestamps, id, batch, v);
+        if(retval == UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY)
+            return; /* v is written when the read completes */
         break;
     case UA_ATTRIBUTEID_DATATYPE:
         CHECK_NODECLASS(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
@@ -360,11 +456,191 @@ void Service_Read_single(UA_Server *server, UA_Session *session,
     }
 
     // Todo: what if the timestamp from the datasource are already present?
-    handleServerTimestamps(timestamps, v);
+    handleServerTimestamps(timestamps, v, UA_Server_now(server));
 }
 
-void Service_Read(UA_Server *server, UA_Session *session,
-                  const UA_ReadRequest *request, UA_ReadResponse *response) {
+/*****************/
+/* Batched Reads */
+/*****************/
+
+const UA_VariableNode *
+UA_Server_getBatchReadNode(UA_Server *server, const UA_NodeId *nodeId,
+                           UA_UInt32 attributeId, const UA_String *indexRange) {
+    if(!server->batchReadSources || attributeId != UA_ATTRIBUTEID_VALUE || indexRange->length > 0)
+        return NULL;
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
+    if(!node || !(node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE)))
+        return NULL;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    if(vn->valueSource != UA_VALUESOURCE_DATASOURCE || !vn->value.dataSource.readBatch)
+        return NULL;
+    return vn;
+}
+
+/* Sorts by the full key of sameDataSource, so that the items of a data source
+ * are adjacent also if different callbacks share the handle */
+static int cmpBatchReadItems(const void *a, const void *b) {
+    const UA_DataSource *da = &((const UA_BatchReadItem*)a)->node->value.dataSource;
+    const UA_DataSource *db = &((const UA_BatchReadItem*)b)->node->value.dataSource;
+    uintptr_t ra = (uintptr_t)da->readBatch;
+    uintptr_t rb = (uintptr_t)db->readBatch;
+    if(ra != rb)
+        return (ra < rb) ? -1 : 1;
+    uintptr_t ha = (uintptr_t)da->handle;
+    uintptr_t hb = (uintptr_t)db->handle;
+    if(ha == hb)
+        return 0;
+    return (ha < hb) ? -1 : 1;
+}
+
+static UA_Boolean sameDataSource(const UA_DataSource *a, const UA_DataSource *b) {
+    return a->handle == b->handle && a->readBatch == b->readBatch;
+}
+
+static UA_Boolean wantsSourceTimestamp(UA_TimestampsToReturn timestamps) {
+    return timestamps == UA_TIMESTAMPSTORETURN_SOURCE || timestamps == UA_TIMESTAMPSTORETURN_BOTH;
+}
+
+static void
+readBatchGroup(UA_Server *server, const UA_DataSource *ds,
+               UA_BatchReadItem *items, size_t itemsSize) {
+    UA_Boolean sourceTimeStamp = false;
+    for(size_t i = 0; i < itemsSize; i++)
+        sourceTimeStamp |= wantsSourceTimestamp(items[i].timestamps);
+
+    /* The data source gets the node ids and the values as arrays */
+    UA_StatusCode retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_NodeId *ids = UA_malloc(sizeof(UA_NodeId) * itemsSize);
+    UA_DataValue *values = UA_malloc(sizeof(UA_DataValue) * itemsSize);
+    if(ids && values) {
+        for(size_t i = 0; i < itemsSize; i++) {
+            ids[i] = items[i].node->nodeId; /* shallow copy */
+            UA_DataValue_init(&values[i]);
+            values[i].hasValue = true;
+        }
+        retval = ds->readBatch(ds->handle, ids, itemsSize, sourceTimeStamp, values);
+    }
+
+    /* Move the results into the targets */
+    for(size_t i = 0; i < itemsSize; i++) {
+        UA_DataValue *v = items[i].target;
+        if(retval == UA_STATUSCODE_GOOD) {
+            *v = values[i];
+            if(!wantsSourceTimestamp(items[i].timestamps))
+                v->hasSourceTimestamp = false;
+        } else {
+            v->hasValue = false;
+            v->hasStatus = true;
+            v->status = retval;
+        }
+        handleServerTimestamps(items[i].timestamps, v, UA_Server_now(server));
+    }
+    UA_free(ids);
+    UA_free(values);
+}
+
+void UA_Server_readBatched(UA_Server *server, UA_BatchReadItem *items, size_t itemsSize) {
+    qsort(items, itemsSize, sizeof(UA_BatchReadItem), cmpBatchReadItems);
+    size_t start = 0;
+    while(start < itemsSize) {
+        const UA_DataSource *ds = &items[start].node->value.dataSource;
+        size_t end = start + 1;
+        while(end < itemsSize && sameDataSource(ds, &items[end].node->value.dataSource))
+            end++;
+        readBatchGroup(server, ds, &items[start], end - start);
+        start = end;
+    }
+}
+
+/* Reads the items of data sources with a readBatch callback. Returns an array
+ * that flags the items that are done (including the external items), or NULL
+ * if no item was read. */
+static UA_Boolean *
+readBatchedItems(UA_Server *server, const UA_ReadRequest *request,
+                 UA_ReadResponse *response, const UA_Boolean *isExternal) {
+    if(!server->batchReadSources)
+        return NULL;
+    size_t size = request->nodesToReadSize;
+    UA_BatchReadItem *items = NULL;
+    UA_Boolean *done = NULL;
+    size_t itemsSize = 0;
+    for(size_t i = 0; i < size; i++) {
+        if(isExternal && isExternal[i])
+            continue;
+        const UA_ReadValueId *id = &request->nodesToRead[i];
+        if(id->dataEncoding.name.length > 0 &&
+           !UA_String_equal(&binEncoding, &id->dataEncoding.name))
+            continue;
+        const UA_VariableNode *vn =
+            UA_Server_getBatchReadNode(server, &id->nodeId, id->attributeId, &id->indexRange);
+        if(!vn)
+            continue;
+        if(!items) {
+            items = UA_malloc(sizeof(UA_BatchReadItem) * size);
+            done = UA_calloc(size, sizeof(UA_Boolean));
+            if(!items || !done) {
+                /* Read one by one */
+                UA_free(items);
+                UA_free(done);
+                return NULL;
+            }
+            if(isExternal)
+                memcpy(done, isExternal, sizeof(UA_Boolean) * size);
+        }
+        items[itemsSize].node = vn;
+        items[itemsSize].timestamps = request->timestampsToReturn;
+        items[itemsSize].target = &response->results[i];
+        itemsSize++;
+        done[i] = true;
+    }
+    if(itemsSize > 0)
+        UA_Server_readBatched(server, items, itemsSize);
+    UA_free(items);
+    return done;
+}
+
+/* The results of a part of the request are written straight into their slots
+ * of the response */
+typedef struct {
+    UA_Server *server;
+    UA_Session *session;
+    const UA_ReadRequest *request;
+    UA_ReadResponse *response;
+    const UA_Boolean *skip; /* NULL if all items are read in the parts */
+    UA_AsyncReadBatch *batch; /* NULL if asynchronous reads are not possible */
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_ExternalRouting *routing;
+    size_t localParts; /* the parts after them call the external nodestores */
+#endif
+} ReadParts;
+
+static void readPart(void *handle, size_t part) {
+    const ReadParts *rp = (const ReadParts*)handle;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(part >= rp->localParts) {
+        const UA_ExternalRoute *route = &rp->routing->routes[part - rp->localParts];
+        route->ens->readNodes(route->ens->ensHandle, &rp->request->requestHeader,
+                              rp->request->nodesToRead, route->indices, route->indicesSize,
+                              rp->response->results, false, rp->response->diagnosticInfos);
+        return;
+    }
+#endif
+    size_t i = part * UA_SERVER_PARALLEL_PARTSIZE;
+    size_t end = i + UA_SERVER_PARALLEL_PARTSIZE;
+    if(end > rp->request->nodesToReadSize)
+        end = rp->request->nodesToReadSize;
+    for(; i < end; i++) {
+        if(rp->skip && rp->skip[i])
+            continue;
+        Service_Read_singleAsync(rp->server, rp->session, rp->request->timestampsToReturn,
+                                 &rp->request->nodesToRead[i], rp->batch,
+                                 &rp->response->results[i]);
+    }
+}
+
+static void
+readService(UA_Server *server, UA_Session *session, const UA_ReadRequest *request,
+            UA_ReadResponse *response, UA_AsyncReadBatch *batch) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest");
     if(request->nodesToReadSize <= 0) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
@@ -390,34 +666,38 @@ void Service_Read(UA_Server *server, UA_Session *session,
         return;
     }
 
+    /* Large requests are processed in parallel */
+    ReadParts rp = {.server = server, .session = session, .request = request,
+                    .response = response, .skip = NULL, .batch = batch};
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-    UA_Boolean isExternal[size];
-    UA_UInt32 indices[size];
-    memset(isExternal, false, sizeof(UA_Boolean) * size);
-    for(size_t j = 0;j<server->externalNamespacesSize;j++) {
-        size_t indexSize = 0;
-        for(size_t i = 0;i < size;i++) {
-            if(request->nodesToRead[i].nodeId.namespaceIndex != server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indexSize] = (UA_UInt32)i;
-            indexSize++;
-        }
-        if(indexSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->readNodes(ens->ensHandle, &request->requestHeader, request->nodesToRead,
-                       indices, (UA_UInt32)indexSize, response->results, false, response->diagnosticInfos);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->nodesToRead, size,
+                               sizeof(UA_ReadValueId), offsetof(UA_ReadValueId, nodeId))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
     }
+    rp.skip = routing.isExternal;
+    rp.routing = &routing;
 #endif
 
-    for(size_t i = 0;i < size;i++) {
+    /* Data sources with a readBatch callback are read once for all their items */
+    UA_Boolean *batched = readBatchedItems(server, request, response, rp.skip);
+    if(batched)
+        rp.skip = batched;
+
+    /* The external nodestores are called once per namespace. They run in
+       parallel to the local parts. */
+    size_t parts = (size + UA_SERVER_PARALLEL_PARTSIZE - 1) / UA_SERVER_PARALLEL_PARTSIZE;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+    rp.localParts = parts;
+    parts += routing.routesSize;
+#endif
+    UA_Server_runParallel(server, readPart, &rp, parts);
+    UA_free(batched);
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    UA_ExternalRouting_deleteMembers(&routing);
 #endif
-            Service_Read_single(server, session, request->timestampsToReturn,
-                                &request->nodesToRead[i], &response->results[i]);
-    }
 
 #ifdef UA_ENABLE_NONSTANDARD_STATELESS
     /* Add an expiry header for caching */
@@ -457,6 +737,322 @@ void Service_Read(UA_Server *server, UA_Session *session,
 #endif
 }
 
+void Service_Read(UA_Server *server, UA_Session *session,
+                  const UA_ReadRequest *request, UA_ReadResponse *response) {
+    readService(server, session, request, response, NULL);
+}
+
+/**********************/
+/* Asynchronous Reads */
+/**********************/
+
+void UA_AsyncReadBatch_init(UA_AsyncReadBatch *batch, UA_AsyncReadBatch_finish finish) {
+    batch->pending = 1;
+    batch->finish = finish;
+}
+
+void UA_AsyncReadBatch_release(UA_Server *server, UA_AsyncReadBatch *batch) {
+#ifndef UA_ENABLE_MULTITHREADING
+    if(--batch->pending == 0)
+        batch->finish(server, batch);
+#else
+    if(uatomic_sub_return(&batch->pending, 1) == 0)
+        batch->finish(server, batch);
+#endif
+}
+
+void UA_Server_completeAsyncRead(UA_Server *server, UA_AsyncRead *pending, const UA_DataValue *value) {
+    UA_AsyncReadBatch *batch = pending->batch;
+    UA_DataValue *v = pending->target;
+    if(UA_DataValue_copy(value, v) != UA_STATUSCODE_GOOD) {
+        v->hasStatus = true;
+        v->status = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    /* May be called from outside the workers */
+    handleServerTimestamps(pending->timestamps, v, UA_DateTime_now());
+    UA_free(pending);
+
+    /* The last read finishes the batch in a server thread */
+#ifndef UA_ENABLE_MULTITHREADING
+    if(--batch->pending == 0)
+        batch->finish(server, batch);
+#else
+    if(uatomic_sub_return(&batch->pending, 1) != 0)
+        return;
+    /* A server that is not running never executes the dispatched callback */
+    if(!uatomic_read(&server->workers)) {
+        batch->finish(server, batch);
+        return;
+    }
+    if(UA_Server_dispatchCallback(server, (UA_ServerCallback)batch->finish, batch) != UA_STATUSCODE_GOOD)
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                     "Could not dispatch the completion of asynchronous reads");
+#endif
+}
+
+/* The response is kept until the last asynchronous read has completed */
+typedef struct {
+    UA_AsyncReadBatch batch; /* must be the first member */
+    UA_NodeId authenticationToken;
+    UA_UInt32 requestId;
+    UA_UInt32 requestHandle;
+    UA_ReadResponse response;
+} AsyncReadRequest;
+
+static void finishAsyncReadRequest(UA_Server *server, AsyncReadRequest *arr) {
+    /* The session may have been closed in the meantime */
+    UA_Session *session = UA_SessionManager_getSession(&server->sessionManager,
+                                                       &arr->authenticationToken);
+    if(session) {
+#ifndef UA_ENABLE_MULTITHREADING
+        session->inflightRequests--;
+#else
+        uatomic_dec(&session->inflightRequests);
+#endif
+    }
+    if(session && session->channel) {
+        arr->response.responseHeader.requestHandle = arr->requestHandle;
+        arr->response.responseHeader.timestamp = UA_DateTime_now();
+        UA_StatusCode retval = UA_SecureChannel_sendBinaryMessage(session->channel, arr->requestId,
+                                                                  &arr->response,
+                                                                  &UA_TYPES[UA_TYPES_READRESPONSE]);
+        if(retval != UA_STATUSCODE_GOOD)
+            UA_LOG_INFO_SESSION(server->config.logger, session, "Could not send the ReadResponse "
+                                "with error code 0x%08x", retval);
+    }
+    UA_ReadResponse_deleteMembers(&arr->response);
+    UA_NodeId_deleteMembers(&arr->authenticationToken);
+    UA_free(arr);
+}
+
+UA_Boolean
+Service_Read_async(UA_Server *server, UA_Session *session,
+                   const UA_ReadRequest *request, UA_UInt32 requestId) {
+    AsyncReadRequest *arr = UA_malloc(sizeof(AsyncReadRequest));
+    if(!arr)
+        return false;
+    if(UA_NodeId_copy(&session->authenticationToken, &arr->authenticationToken) != UA_STATUSCODE_GOOD) {
+        UA_free(arr);
+        return false;
+    }
+    UA_AsyncReadBatch_init(&arr->batch, (UA_AsyncReadBatch_finish)finishAsyncReadRequest);
+    arr->requestId = requestId;
+    arr->requestHandle = request->requestHeader.requestHandle;
+    UA_ReadResponse_init(&arr->response);
+#ifndef UA_ENABLE_MULTITHREADING
+    session->inflightRequests++;
+#else
+    uatomic_inc(&session->inflightRequests);
+#endif
+    readService(server, session, request, &arr->response, &arr->batch);
+    UA_AsyncReadBatch_release(server, &arr->batch);
+    return true;
+}
+
+/****************/
+/* Direct Reads */
+/****************/
+
+/* Reads of the value of variables with a variant value source are encoded
+ * straight from the nodes into the chunks of the response. No response object
+ * is built and the values are not copied. All nodes are looked up before the
+ * first byte is encoded. So requests with other items can still fall back to
+ * Service_Read. */
+
+#define UA_READDIRECT_STACKNODES 64
+#define UA_READDIRECT_MEMORYBUFFER 256 /* bytes */
+
+static const UA_VariableNode *
+getDirectReadNode(UA_Server *server, const UA_ReadValueId *id) {
+    if(id->attributeId != UA_ATTRIBUTEID_VALUE || id->indexRange.length > 0)
+        return NULL;
+    if(id->dataEncoding.name.length > 0 &&
+       !UA_String_equal(&binEncoding, &id->dataEncoding.name))
+        return NULL;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(UA_Server_getExternalNamespace(server, id->nodeId.namespaceIndex))
+        return NULL;
+#endif
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &id->nodeId);
+    if(!node || !(node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE)))
+        return NULL;
+    const UA_VariableNode *vn = (const UA_VariableNode*)node;
+    if(vn->valueSource == UA_VALUESOURCE_DATASOURCE)
+        return NULL;
+    return vn;
+}
+
+static void
+encodeDirectRead(UA_Server *server, UA_Session *session, const UA_ReadRequest *request,
+                 UA_UInt32 requestId, const UA_VariableNode **nodes) {
+    UA_ResponseHeader responseHeader;
+    UA_ResponseHeader_init(&responseHeader);
+    responseHeader.requestHandle = request->requestHeader.requestHandle;
+    responseHeader.timestamp = UA_Server_now(server);
+
+    UA_MessageContext mc;
+    UA_StatusCode retval = UA_SecureChannel_beginMessage(session->channel, requestId,
+                                                         &UA_TYPES[UA_TYPES_READRESPONSE], &mc);
+    if(retval != UA_STATUSCODE_GOOD)
+        goto log_error;
+
+    /* The fields of the ReadResponse in order */
+    UA_Int32 resultsSize = (UA_Int32)request->nodesToReadSize;
+    retval = UA_SecureChannel_encodeMessage(&mc, &responseHeader, &UA_TYPES[UA_TYPES_RESPONSEHEADER]);
+    retval |= UA_SecureChannel_encodeMessage(&mc, &resultsSize, &UA_TYPES[UA_TYPES_INT32]);
+    UA_TimestampsToReturn timestamps = request->timestampsToReturn;
+    for(size_t i = 0; i < request->nodesToReadSize && retval == UA_STATUSCODE_GOOD; i++) {
+        const UA_VariableNode *vn = nodes[i];
+        UA_DataValue v;
+        UA_DataValue_init(&v);
+        if(vn->valueSource == UA_VALUESOURCE_MEMORY) {
+            /* Small values are copied to the stack only */
+            UA_UInt64 buf[UA_READDIRECT_MEMORYBUFFER / sizeof(UA_UInt64)];
+            UA_StatusCode res = readValueMemory(server, &vn->value.memory, timestamps,
+                                                buf, sizeof(buf), &v);
+            if(res != UA_STATUSCODE_GOOD) {
+                v.hasStatus = true;
+                v.status = res;
+            }
+            handleServerTimestamps(timestamps, &v, UA_Server_now(server));
+            retval = UA_SecureChannel_encodeMessage(&mc, &v, &UA_TYPES[UA_TYPES_DATAVALUE]);
+            UA_Variant_deleteMembers(&v.value);
+            continue;
+        }
+        if(vn->value.variant.callback.onRead)
+            vn->value.variant.callback.onRead(vn->value.variant.callback.handle, vn->nodeId,
+                                              &v.value, NULL);
+        /* The snapshot stays valid until the end of the job */
+        UA_VariableNode_getValue(vn, &v.value);
+        v.hasValue = true;
+        handleSourceTimestamps(timestamps, &v, UA_Server_now(server));
+        handleServerTimestamps(timestamps, &v, UA_Server_now(server));
+        retval = UA_SecureChannel_encodeMessage(&mc, &v, &UA_TYPES[UA_TYPES_DATAVALUE]);
+    }
+    UA_Int32 diagnosticInfosSize = -1; /* encoding of an empty array */
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_SecureChannel_encodeMessage(&mc, &diagnosticInfosSize, &UA_TYPES[UA_TYPES_INT32]);
+    retval = UA_SecureChannel_finishMessage(&mc, retval);
+    if(retval == UA_STATUSCODE_GOOD)
+        return;
+
+ log_error:
+    UA_LOG_INFO_SESSION(server->config.logger, session, "Could not send the ReadResponse "
+                        "with error code 0x%08x", retval);
+}
+
+UA_Boolean
+Service_Read_direct(UA_Server *server, UA_Session *session,
+                    const UA_ReadRequest *request, UA_UInt32 requestId) {
+    /* Errors are reported by the regular service */
+    size_t size = request->nodesToReadSize;
+    if(size == 0 || request->timestampsToReturn > UA_TIMESTAMPSTORETURN_NEITHER ||
+       request->maxAge < 0 || !session->channel)
+        return false;
+
+#ifdef UA_ENABLE_NONSTANDARD_STATELESS
+    /* The response gets an expiry header */
+    if(session->sessionId.namespaceIndex == 0 &&
+       session->sessionId.identifierType == UA_NODEIDTYPE_NUMERIC &&
+       session->sessionId.identifier.numeric == 0)
+        return false;
+#endif
+
+    const UA_VariableNode *stackNodes[UA_READDIRECT_STACKNODES];
+    const UA_VariableNode **nodes = stackNodes;
+    if(size > UA_READDIRECT_STACKNODES) {
+        nodes = UA_malloc(sizeof(const UA_VariableNode*) * size);
+        if(!nodes)
+            return false;
+    }
+
+    UA_Boolean direct = true;
+    for(size_t i = 0; i < size && direct; i++) {
+        nodes[i] = getDirectReadNode(server, &request->nodesToRead[i]);
+        direct = (nodes[i] != NULL);
+    }
+
+    if(direct) {
+        UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing ReadRequest directly");
+#ifdef UA_ENABLE_NODE_STATISTICS
+        for(size_t i = 0; i < size; i++)
+            UA_Server_countNodeAccess(server, &request->nodesToRead[i].nodeId, UA_NODEACCESS_READ);
+#endif
+        encodeDirectRead(server, session, request, requestId, nodes);
+    }
+
+    if(nodes != stackNodes)
+        UA_free(nodes);
+    return direct;
+}
+
+static UA_StatusCode
+readValueBorrowed(UA_Server *server, const UA_VariableNode *vn,
+                  UA_BorrowedValueCallback callback, void *context) {
+    UA_Variant value;
+    UA_Variant_init(&value);
+    if(vn->valueSource == UA_VALUESOURCE_VARIANT) {
+        if(vn->value.variant.callback.onRead)
+            vn->value.variant.callback.onRead(vn->value.variant.callback.handle, vn->nodeId,
+                                              &value, NULL);
+        /* The snapshot stays valid until the end of the job */
+        UA_VariableNode_getValue(vn, &value);
+        callback(context, &vn->nodeId, &value);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_DataValue v;
+    UA_DataValue_init(&v);
+    UA_StatusCode retval;
+    if(vn->valueSource == UA_VALUESOURCE_MEMORY) {
+        /* Small values are copied to the stack only */
+        UA_UInt64 buf[UA_READDIRECT_MEMORYBUFFER / sizeof(UA_UInt64)];
+        retval = readValueMemory(server, &vn->value.memory, UA_TIMESTAMPSTORETURN_NEITHER,
+                                 buf, sizeof(buf), &v);
+        if(retval == UA_STATUSCODE_GOOD)
+            callback(context, &vn->nodeId, &v.value);
+        UA_Variant_deleteMembers(&v.value);
+        return retval;
+    }
+
+    UA_ReadValueId id;
+    UA_ReadValueId_init(&id);
+    id.nodeId = vn->nodeId;
+    id.attributeId = UA_ATTRIBUTEID_VALUE;
+    retval = getVariableNodeValue(server, &adminSession, vn, UA_TIMESTAMPSTORETURN_NEITHER,
+                                  &id, NULL, &v);
+    if(retval == UA_STATUSCODE_GOOD && v.hasStatus)
+        retval = v.status;
+    if(retval == UA_STATUSCODE_GOOD)
+        callback(context, &vn->nodeId, &v.value);
+    UA_DataValue_deleteMembers(&v);
+    return retval;
+}
+
+UA_StatusCode
+UA_Server_readValueBorrowed(UA_Server *server, const UA_NodeId nodeId,
+                            UA_BorrowedValueCallback callback, void *context) {
+    /* The node is not reclaimed before the callback returns, also when it is
+     * replaced meanwhile */
+    UA_Server_beginAccess(server);
+    UA_RCU_LOCK();
+    UA_StatusCode retval;
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &nodeId);
+    if(!node)
+        retval = UA_STATUSCODE_BADNODEIDUNKNOWN;
+    else if(!(node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE)))
+        retval = UA_STATUSCODE_BADATTRIBUTEIDINVALID;
+    else {
+#ifdef UA_ENABLE_NODE_STATISTICS
+        UA_Server_countNodeAccess(server, &nodeId, UA_NODEACCESS_READ);
+#endif
+        retval = readValueBorrowed(server, (const UA_VariableNode*)node, callback, context);
+    }
+    UA_RCU_UNLOCK();
+    UA_Server_endAccess(server);
+    return retval;
+}
+
 /*******************/
 /* Write Attribute */
 /*******************/
@@ -469,10 +1065,12 @@ UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const U
         const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
         if(!node)
             return UA_STATUSCODE_BADNODEIDUNKNOWN;
-        UA_Node *editNode = (UA_Node*)(uintptr_t)node; // dirty cast. use only here.
-        retval = callback(server, session, editNode, data);
-        return retval;
-#else
+        if(!UA_NodeStore_isStatic(server->nodestore, node)) {
+            UA_Node *editNode = (UA_Node*)(uintptr_t)node; // dirty cast. use only here.
+            return callback(server, session, editNode, data);
+        }
+#endif
+        /* Static nodes are read-only. They are replaced by an edited copy. */
         UA_Node *copy = UA_NodeStore_getCopy(server->nodestore, nodeId);
         if(!copy)
             return UA_STATUSCODE_BADOUTOFMEMORY;
@@ -482,7 +1080,6 @@ UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const U
             return retval;
         }
         retval = UA_NodeStore_replace(server->nodestore, copy);
-#endif
     } while(retval != UA_STATUSCODE_GOOD);
     return UA_STATUSCODE_GOOD;
 }
@@ -543,13 +1140,42 @@ static enum type_equivalence typeEquivalence(const UA_DataType *t) {
     return TYPE_EQUIVALENCE_NONE;
 }
 
+/* The nodeid on the wire may be != the nodeid in the node: opaque types, enums
+   and bytestrings. Returns the written value with the type definition of the
+   current value or NULL if the types don't match. */
+static const UA_Variant *
+castWrittenValue(const UA_Variant *oldV, const UA_Variant *newV, UA_Variant *cast_v) {
+    if(UA_NodeId_equal(&oldV->type->typeId, &newV->type->typeId))
+        return newV;
+    *cast_v = *newV;
+    enum type_equivalence te1 = typeEquivalence(oldV->type);
+    enum type_equivalence te2 = typeEquivalence(newV->type);
+    if(te1 != TYPE_EQUIVALENCE_NONE && te1 == te2) {
+        /* An enum was sent as an int32, or an opaque type as a bytestring. This is
+           detected with the typeIndex indicated the "true" datatype. */
+        cast_v->type = oldV->type;
+    } else if(oldV->type == &UA_TYPES[UA_TYPES_BYTE] && !UA_Variant_isScalar(oldV) &&
+              newV->type == &UA_TYPES[UA_TYPES_BYTESTRING] && UA_Variant_isScalar(newV)) {
+        /* a string is written to a byte array */
+        UA_ByteString *str = (UA_ByteString*) newV->data;
+        cast_v->arrayLength = str->length;
+        cast_v->data = str->data;
+        cast_v->type = &UA_TYPES[UA_TYPES_BYTE];
+    } else {
+        return NULL;
+    }
+    return cast_v;
+}
+
+/* Computes the new value from the current value of the node. The current value
+   is not changed. */
 static UA_StatusCode
-CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
+computeWrittenValue(const UA_VariableNode *node, const UA_Variant *oldV,
+                    const UA_WriteValue *wvalue, UA_Variant *value) {
     UA_assert(wvalue->attributeId == UA_ATTRIBUTEID_VALUE);
     UA_assert(node->nodeClass == UA_NODECLASS_VARIABLE || node->nodeClass == UA_NODECLASS_VARIABLETYPE);
     UA_assert(node->valueSource == UA_VALUESOURCE_VARIANT);
 
-    UA_Variant *oldV = &node->value.variant.value;
     /* Don't run NodeId_equal on a NULL pointer (happens if the variable never
        held a variant) */
     if(!oldV->type)
@@ -566,46 +1192,170 @@ CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
         rangeptr = &range;
     }
 
-    /* The nodeid on the wire may be != the nodeid in the node: opaque types,
-       enums and bytestrings. nodeV contains the correct type definition. */
-    const UA_Variant *newV = &wvalue->value.value;
     UA_Variant cast_v;
-    if(!UA_NodeId_equal(&oldV->type->typeId, &newV->type->typeId)) {
-        cast_v = wvalue->value.value;
-        newV = &cast_v;
-        enum type_equivalence te1 = typeEquivalence(oldV->type);
-        enum type_equivalence te2 = typeEquivalence(newV->type);
-        if(te1 != TYPE_EQUIVALENCE_NONE && te1 == te2) {
-            /* An enum was sent as an int32, or an opaque type as a bytestring. This is
-               detected with the typeIndex indicated the "true" datatype. */
-            cast_v.type = oldV->type;
-        } else if(oldV->type == &UA_TYPES[UA_TYPES_BYTE] && !UA_Variant_isScalar(oldV) &&
-                  newV->type == &UA_TYPES[UA_TYPES_BYTESTRING] && UA_Variant_isScalar(newV)) {
-            /* a string is written to a byte array */
-            UA_ByteString *str = (UA_ByteString*) newV->data;
-            cast_v.arrayLength = str->length;
-            cast_v.data = str->data;
-            cast_v.type = &UA_TYPES[UA_TYPES_BYTE];
-        } else {
-            if(rangeptr)
-                UA_free(range.dimensions);
-            return UA_STATUSCODE_BADTYPEMISMATCH;
-        }
+    const UA_Variant *newV = castWrittenValue(oldV, &wvalue->value.value, &cast_v);
+    if(!newV) {
+        if(rangeptr)
+            UA_free(range.dimensions);
+        return UA_STATUSCODE_BADTYPEMISMATCH;
     }
 
     if(!rangeptr) {
-        UA_Variant_deleteMembers(&node->value.variant.value);
-        UA_Variant_copy(newV, &node->value.variant.value);
-    } else
-        retval = UA_Variant_setRangeCopy(&node->value.variant.value, newV->data, newV->arrayLength, range);
-    if(node->value.variant.callback.onWrite)
+        retval = UA_Variant_copy(newV, value);
+    } else {
+        /* The new value takes a reference to shared data. The range write
+           makes a private copy before the data is changed. */
+        retval = UA_Variant_copy(oldV, value);
+        if(retval == UA_STATUSCODE_GOOD)
+            retval = UA_Variant_setRangeCopy(value, newV->data, newV->arrayLength, range);
+    }
+    /* Readers and monitored items take references instead of copies */
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_Variant_share(value);
+    if(retval == UA_STATUSCODE_GOOD && node->value.variant.callback.onWrite)
         node->value.variant.callback.onWrite(node->value.variant.callback.handle, node->nodeId,
-                                             &node->value.variant.value, rangeptr);
+                                             value, rangeptr);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_Variant_deleteMembers(value);
     if(rangeptr)
         UA_free(range.dimensions);
     return retval;
 }
 
+static UA_StatusCode
+CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
+    UA_Variant value;
+    UA_Variant_init(&value);
+    UA_StatusCode retval = computeWrittenValue(node, &node->value.variant.value, wvalue, &value);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_Variant_deleteMembers(&node->value.variant.value);
+    node->value.variant.value = value;
+    return UA_STATUSCODE_GOOD;
+}
+
+typedef struct {
+    const UA_WriteValue *wvalue;
+    UA_Boolean dataSource; /* the node has a data source. nothing was written. */
+    UA_Boolean methodArguments; /* the node defines the arguments of a method */
+    UA_Boolean swap; /* the range cannot be written in place. nothing was written. */
+} ValueWrite;
+
+/* Large arrays are written in chunks. The callback gets the entire new value.
+   So the value is not written in chunks if there is a callback. */
+static UA_Boolean writeInChunks(const UA_VariableNode *node, const UA_WriteValue *wvalue) {
+    return wvalue->indexRange.length > 0 && !node->value.variant.callback.onWrite &&
+        UA_ValueChunks_applicable(&node->value.variant.value);
+}
+
+static UA_StatusCode
+writeValueChunks(const UA_VariableNode *node, UA_Variant *value,
+                 UA_ValueChunks **chunks, ValueWrite *vw) {
+    UA_Variant cast_v;
+    const UA_Variant *newV =
+        castWrittenValue(&node->value.variant.value, &vw->wvalue->value.value, &cast_v);
+    if(!newV)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    UA_NumericRange range;
+    UA_StatusCode retval = parse_numericrange(&vw->wvalue->indexRange, &range);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_ValueChunks_writeRange(node, newV, range, value, chunks);
+    UA_free(range.dimensions);
+    return retval;
+}
+
+static UA_StatusCode
+editWrittenValue(const UA_VariableNode *node, UA_Variant *value,
+                 UA_ValueChunks **chunks, ValueWrite *vw) {
+    if(node->valueSource != UA_VALUESOURCE_VARIANT) {
+        vw->dataSource = true;
+        return UA_STATUSCODE_BADWRITENOTSUPPORTED;
+    }
+    vw->methodArguments = UA_Node_isMethodArguments((const UA_Node*)node);
+    if(writeInChunks(node, vw->wvalue))
+        return writeValueChunks(node, value, chunks, vw);
+    /* Only the type of the current value is used if no range is written */
+    UA_Variant current = node->value.variant.value;
+    if(vw->wvalue->indexRange.length > 0)
+        UA_VariableNode_getValue(node, &current);
+    return computeWrittenValue(node, &current, vw->wvalue, value);
+}
+
+#ifndef UA_ENABLE_MULTITHREADING
+/* Writes a range into the current value of the node. Only shared data with
+ * references held by readers is copied before. The new elements of types with
+ * dynamic members are copied before the value is changed. So the value is
+ * unchanged if the write fails. Large arrays are written in chunks instead. */
+static UA_StatusCode
+writeValueRange(UA_VariableNode *node, ValueWrite *vw) {
+    if(node->valueSource != UA_VALUESOURCE_VARIANT) {
+        vw->dataSource = true;
+        return UA_STATUSCODE_BADWRITENOTSUPPORTED;
+    }
+    UA_Variant *value = &node->value.variant.value;
+    if(value->storageType == UA_VARIANT_DATA_NODELETE || node->valueChunks ||
+       writeInChunks(node, vw->wvalue)) {
+        vw->swap = true; /* don't write into borrowed memory or chunks */
+        return UA_STATUSCODE_BADWRITENOTSUPPORTED;
+    }
+    if(!value->type)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Variant cast_v;
+    const UA_Variant *newV = castWrittenValue(value, &vw->wvalue->value.value, &cast_v);
+    if(!newV)
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    UA_NumericRange range;
+    UA_StatusCode retval = parse_numericrange(&vw->wvalue->indexRange, &range);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    vw->methodArguments = UA_Node_isMethodArguments((const UA_Node*)node);
+
+    if(newV->type->fixedSize) {
+        retval = UA_Variant_setRangeCopy(value, newV->data, newV->arrayLength, range);
+    } else {
+        void *elements;
+        retval = UA_Array_copy(newV->data, newV->arrayLength, &elements, newV->type);
+        if(retval == UA_STATUSCODE_GOOD) {
+            retval = UA_Variant_setRange(value, elements, newV->arrayLength, range);
+            if(retval == UA_STATUSCODE_GOOD)
+                UA_free(elements); /* the members have moved into the value */
+            else
+                UA_Array_delete(elements, newV->arrayLength, newV->type);
+        }
+    }
+    if(retval == UA_STATUSCODE_GOOD) {
+        /* Data that readers referenced was copied into a new shared buffer.
+           A private value is shared now. If that fails, readers copy the data
+           instead of taking a reference. */
+        UA_Variant_share(value);
+        if(node->value.variant.callback.onWrite)
+            node->value.variant.callback.onWrite(node->value.variant.callback.handle,
+                                                 node->nodeId, value, &range);
+    }
+    UA_free(range.dimensions);
+    return retval;
+}
+#endif
+
+/* Writes the value in place if only a range is written. Otherwise, the new
+   value is computed and swapped in. Ranges of large arrays are written into
+   chunks of the new value. With multithreading, values are only swapped. */
+static UA_StatusCode
+writeNodeValue(UA_Server *server, ValueWrite *vw) {
+#ifndef UA_ENABLE_MULTITHREADING
+    if(vw->wvalue->indexRange.length > 0) {
+        UA_StatusCode retval =
+            UA_NodeStore_writeValue(server->nodestore, &vw->wvalue->nodeId,
+                                    (UA_NodeStore_valueWriter)writeValueRange, vw);
+        if(!vw->swap)
+            return retval;
+    }
+#endif
+    return UA_NodeStore_editValue(server->nodestore, &vw->wvalue->nodeId,
+                                  (UA_NodeStore_valueEditor)editWrittenValue, vw);
+}
+
 static UA_StatusCode
 CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
                       UA_Node *node, const UA_WriteValue *wvalue) {
@@ -677,6 +1427,8 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
         CHECK_NODECLASS_WRITE(UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE);
         if(((const UA_VariableNode*)node)->valueSource == UA_VALUESOURCE_VARIANT)
             retval = CopyValueIntoNode((UA_VariableNode*)node, wvalue);
+        else if(((const UA_VariableNode*)node)->valueSource == UA_VALUESOURCE_MEMORY)
+            retval = UA_STATUSCODE_BADWRITENOTSUPPORTED;
         else
             retval = Service_Write_single_ValueDataSource(server, session, (const UA_VariableNode*)node, wvalue);
         break;
@@ -715,14 +1467,146 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
         break;
     }
     if(attr_type) {
-        UA_deleteMembers(target, attr_type);
-        retval = UA_copy(value, target, attr_type);
+        /* replace the old value only when the new one is complete */
+        union { UA_QualifiedName qn; UA_LocalizedText lt; } copy;
+        retval = UA_copy(value, &copy, attr_type);
+        if(retval == UA_STATUSCODE_GOOD) {
+            retval = UA_Node_internMember(node, &copy, attr_type);
+            if(retval == UA_STATUSCODE_GOOD) {
+                UA_Node_deleteMember(node, target, attr_type);
+                memcpy(target, &copy, attr_type->memSize);
+            } else
+                UA_deleteMembers(&copy, attr_type);
+        }
     }
     return retval;
 }
 
 UA_StatusCode Service_Write_single(UA_Server *server, UA_Session *session, const UA_WriteValue *wvalue) {
-    return UA_Server_editNode(server, session, &wvalue->nodeId, (UA_EditNodeCallback)CopyAttributeIntoNode, wvalue);
+    /* Values are swapped in place without copying the node */
+    if(wvalue->attributeId == UA_ATTRIBUTEID_VALUE && wvalue->value.hasValue) {
+        ValueWrite vw = {wvalue, false, false, false};
+        UA_StatusCode retval = writeNodeValue(server, &vw);
+        if(retval == UA_STATUSCODE_GOOD && vw.methodArguments)
+            UA_Server_invalidateMethodArguments(server);
+        if(!vw.dataSource) {
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+            if(retval == UA_STATUSCODE_GOOD)
+                UA_Server_notifyValueWrite(server, &wvalue->nodeId);
+#endif
+#ifdef UA_ENABLE_HISTORIZING
+            if(retval == UA_STATUSCODE_GOOD && wvalue->indexRange.length == 0)
+                UA_Server_recordHistory(server, &wvalue->nodeId, &wvalue->value);
+#endif
+#ifdef UA_ENABLE_NODE_STATISTICS
+            if(retval != UA_STATUSCODE_BADNODEIDUNKNOWN)
+                UA_Server_countNodeAccess(server, &wvalue->nodeId, UA_NODEACCESS_WRITE);
+#endif
+            return retval;
+        }
+    }
+    UA_StatusCode retval = UA_Server_editNode(server, session, &wvalue->nodeId,
+                                              (UA_EditNodeCallback)CopyAttributeIntoNode, wvalue);
+    if(retval == UA_STATUSCODE_GOOD && wvalue->attributeId == UA_ATTRIBUTEID_BROWSENAME) {
+        UA_Server_invalidateBrowseNameIndices(server);
+        UA_Server_invalidateMethodArguments(server);
+    }
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    if(retval == UA_STATUSCODE_GOOD && wvalue->attributeId == UA_ATTRIBUTEID_VALUE)
+        UA_Server_notifyValueWrite(server, &wvalue->nodeId);
+#endif
+#ifdef UA_ENABLE_HISTORIZING
+    if(retval == UA_STATUSCODE_GOOD && wvalue->attributeId == UA_ATTRIBUTEID_HISTORIZING)
+        UA_Server_historizeNode(server, &wvalue->nodeId, *(const UA_Boolean*)wvalue->value.value.data);
+#endif
+#ifdef UA_ENABLE_NODE_STATISTICS
+    if(retval != UA_STATUSCODE_BADNODEIDUNKNOWN)
+        UA_Server_countNodeAccess(server, &wvalue->nodeId, UA_NODEACCESS_WRITE);
+#endif
+    return retval;
+}
+
+static UA_StatusCode
+writeValueBatched(UA_Server *server, const UA_WriteValue *wvalue, UA_Boolean *methodArguments) {
+    ValueWrite vw = {wvalue, false, false, false};
+    UA_StatusCode retval = writeNodeValue(server, &vw);
+    *methodArguments |= (retval == UA_STATUSCODE_GOOD && vw.methodArguments);
+    if(vw.dataSource) {
+        /* Data sources are written without editing the node */
+        const UA_VariableNode *node =
+            (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &wvalue->nodeId);
+        if(node && node->valueSource == UA_VALUESOURCE_DATASOURCE)
+            retval = Service_Write_single_ValueDataSource(server, &adminSession, node, wvalue);
+    }
+#ifdef UA_ENABLE_HISTORIZING
+    if(retval == UA_STATUSCODE_GOOD && !vw.dataSource)
+        UA_Server_recordHistory(server, &wvalue->nodeId, &wvalue->value);
+#endif
+#ifdef UA_ENABLE_NODE_STATISTICS
+    if(retval != UA_STATUSCODE_BADNODEIDUNKNOWN)
+        UA_Server_countNodeAccess(server, &wvalue->nodeId, UA_NODEACCESS_WRITE);
+#endif
+    return retval;
+}
+
+UA_StatusCode
+UA_Server_writeValues(UA_Server *server, size_t size, const UA_NodeId *nodeIds,
+                      const UA_Variant *values, UA_StatusCode *results) {
+    if(size == 0)
+        return UA_STATUSCODE_BADNOTHINGTODO;
+    UA_WriteValue wvalue;
+    UA_WriteValue_init(&wvalue);
+    wvalue.attributeId = UA_ATTRIBUTEID_VALUE;
+    wvalue.value.hasValue = true;
+    UA_Boolean methodArguments = false;
+    UA_RCU_LOCK();
+    for(size_t i = 0; i < size; i++) {
+        wvalue.nodeId = nodeIds[i];
+        wvalue.value.value = values[i];
+        results[i] = writeValueBatched(server, &wvalue, &methodArguments);
+    }
+    if(methodArguments)
+        UA_Server_invalidateMethodArguments(server);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_Server_notifyValueWrites(server, nodeIds, results, size);
+#endif
+    UA_RCU_UNLOCK();
+    return UA_STATUSCODE_GOOD;
+}
+
+typedef struct {
+    UA_Server *server;
+    UA_Session *session;
+    const UA_WriteRequest *request;
+    UA_WriteResponse *response;
+    const UA_Boolean *isExternal; /* NULL if all nodes are local */
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_ExternalRouting *routing;
+    size_t localParts; /* the parts after them call the external nodestores */
+#endif
+} WriteParts;
+
+static void writePart(void *handle, size_t part) {
+    const WriteParts *wp = (const WriteParts*)handle;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(part >= wp->localParts) {
+        const UA_ExternalRoute *route = &wp->routing->routes[part - wp->localParts];
+        route->ens->writeNodes(route->ens->ensHandle, &wp->request->requestHeader,
+                               wp->request->nodesToWrite, route->indices, route->indicesSize,
+                               wp->response->results, wp->response->diagnosticInfos);
+        return;
+    }
+#endif
+    size_t i = part * UA_SERVER_PARALLEL_PARTSIZE;
+    size_t end = i + UA_SERVER_PARALLEL_PARTSIZE;
+    if(end > wp->request->nodesToWriteSize)
+        end = wp->request->nodesToWriteSize;
+    for(; i < end; i++) {
+        if(wp->isExternal && wp->isExternal[i])
+            continue;
+        wp->response->results[i] = Service_Write_single(wp->server, wp->session,
+                                                        &wp->request->nodesToWrite[i]);
+    }
 }
 
 void Service_Write(UA_Server *server, UA_Session *session, const UA_WriteRequest *request,
@@ -739,33 +1623,30 @@ void Service_Write(UA_Server *server, UA_Session *session, const UA_WriteRequest
         return;
     }
 
+    response->resultsSize = request->nodesToWriteSize;
+
+    /* Large requests are processed in parallel. The order of writes to the
+       same node within a request is then not defined. The external nodestores
+       are called once per namespace in parallel to the local parts. */
+    WriteParts wp = {.server = server, .session = session, .request = request,
+                     .response = response, .isExternal = NULL};
+    size_t parts = (request->nodesToWriteSize + UA_SERVER_PARALLEL_PARTSIZE - 1) /
+        UA_SERVER_PARALLEL_PARTSIZE;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-    UA_Boolean isExternal[request->nodesToWriteSize];
-    UA_UInt32 indices[request->nodesToWriteSize];
-    memset(isExternal, false, sizeof(UA_Boolean)*request->nodesToWriteSize);
-    for(size_t j = 0; j < server->externalNamespacesSize; j++) {
-        UA_UInt32 indexSize = 0;
-        for(size_t i = 0; i < request->nodesToWriteSize; i++) {
-            if(request->nodesToWrite[i].nodeId.namespaceIndex !=
-               server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indexSize] = (UA_UInt32)i;
-            indexSize++;
-        }
-        if(indexSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->writeNodes(ens->ensHandle, &request->requestHeader, request->nodesToWrite,
-                        indices, indexSize, response->results, response->diagnosticInfos);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->nodesToWrite, request->nodesToWriteSize,
+                               sizeof(UA_WriteValue), offsetof(UA_WriteValue, nodeId))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
     }
+    wp.isExternal = routing.isExternal;
+    wp.routing = &routing;
+    wp.localParts = parts;
+    parts += routing.routesSize;
 #endif
-
-    response->resultsSize = request->nodesToWriteSize;
-    for(size_t i = 0;i < request->nodesToWriteSize;i++) {
+    UA_Server_runParallel(server, writePart, &wp, parts);
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+    UA_ExternalRouting_deleteMembers(&routing);
 #endif
-            response->results[i] = Service_Write_single(server, session, &request->nodesToWrite[i]);
-    }
 }
@@ -1,24 +1,42 @@
 #include "ua_services.h"
 #include "ua_server_internal.h"
 
+/* Argument properties can be written also without method calls */
+
+void UA_Server_invalidateMethodArguments(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    server->methodArgumentsVersion++;
+#else
+    uatomic_inc(&server->methodArgumentsVersion);
+#endif
+}
+
+UA_Boolean UA_Node_isMethodArguments(const UA_Node *node) {
+    UA_String inputArguments = UA_STRING("InputArguments");
+    UA_String outputArguments = UA_STRING("OutputArguments");
+    return node->nodeClass == UA_NODECLASS_VARIABLE && node->browseName.namespaceIndex == 0 &&
+        (UA_String_equal(&node->browseName.name, &inputArguments) ||
+         UA_String_equal(&node->browseName.name, &outputArguments));
+}
+
 #ifdef UA_ENABLE_METHODCALLS /* conditional compilation */
 
 static const UA_VariableNode *
 getArgumentsVariableNode(UA_Server *server, const UA_MethodNode *ofMethod,
                          UA_String withBrowseName) {
     UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
-    for(size_t i = 0; i < ofMethod->referencesSize; i++) {
-        if(ofMethod->references[i].isInverse == false &&
-            UA_NodeId_equal(&hasProperty, &ofMethod->references[i].referenceTypeId)) {
-            const UA_Node *refTarget =
-                UA_NodeStore_get(server->nodestore, &ofMethod->references[i].targetId.nodeId);
-            if(!refTarget)
-                continue;
-            if(refTarget->nodeClass == UA_NODECLASS_VARIABLE &&
-                refTarget->browseName.namespaceIndex == 0 &&
-                UA_String_equal(&withBrowseName, &refTarget->browseName.name)) {
-                return (const UA_VariableNode*) refTarget;
-            }
+    size_t begin, end;
+    UA_Node_findReferences((const UA_Node*)ofMethod, &hasProperty, UA_BROWSEDIRECTION_FORWARD,
+                           &begin, &end);
+    for(size_t i = begin; i < end; i++) {
+        const UA_Node *refTarget =
+            UA_NodeStore_get(server->nodestore, &ofMethod->references[i].targetId.nodeId);
+        if(!refTarget)
+            continue;
+        if(refTarget->nodeClass == UA_NODECLASS_VARIABLE &&
+            refTarget->browseName.namespaceIndex == 0 &&
+            UA_String_equal(&withBrowseName, &refTarget->browseName.name)) {
+            return (const UA_VariableNode*) refTarget;
         }
     }
     return NULL;
@@ -98,26 +116,110 @@ satisfySignature(UA_Server *server, const UA_Variant *var, const UA_Argument *ar
 }
 
 static UA_StatusCode
-argConformsToDefinition(UA_Server *server, const UA_VariableNode *argRequirements, size_t argsSize, const UA_Variant *args) {
-    if(argRequirements->value.variant.value.type != &UA_TYPES[UA_TYPES_ARGUMENT])
-        return UA_STATUSCODE_BADINTERNALERROR;
-    UA_Argument *argReqs = (UA_Argument*)argRequirements->value.variant.value.data;
-    size_t argReqsSize = argRequirements->value.variant.value.arrayLength;
-    if(argRequirements->valueSource != UA_VALUESOURCE_VARIANT)
-        return UA_STATUSCODE_BADINTERNALERROR;
-    if(UA_Variant_isScalar(&argRequirements->value.variant.value))
-        argReqsSize = 1;
-    if(argReqsSize > argsSize)
+argConformsToDefinition(UA_Server *server, const UA_MethodArguments *definition,
+                        size_t argsSize, const UA_Variant *args) {
+    if(definition->inputArgumentsSize > argsSize)
         return UA_STATUSCODE_BADARGUMENTSMISSING;
-    if(argReqsSize != argsSize)
+    if(definition->inputArgumentsSize != argsSize)
         return UA_STATUSCODE_BADINVALIDARGUMENT;
 
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(size_t i = 0; i < argReqsSize; i++)
-        retval |= satisfySignature(server, &args[i], &argReqs[i]);
+    for(size_t i = 0; i < argsSize; i++)
+        retval |= satisfySignature(server, &args[i], &definition->inputArguments[i]);
     return retval;
 }
 
+/* Copies the argument definitions from the properties of the method */
+static UA_StatusCode
+buildMethodArguments(UA_Server *server, const UA_MethodNode *method, UA_UInt32 version,
+                     UA_MethodArguments **arguments) {
+    const UA_VariableNode *inputArguments =
+        getArgumentsVariableNode(server, method, UA_STRING("InputArguments"));
+    if(!inputArguments)
+        return UA_STATUSCODE_BADINVALIDARGUMENT;
+    if(inputArguments->valueSource != UA_VALUESOURCE_VARIANT)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Variant inputValue;
+    UA_VariableNode_getValue(inputArguments, &inputValue);
+    if(inputValue.type != &UA_TYPES[UA_TYPES_ARGUMENT])
+        return UA_STATUSCODE_BADINTERNALERROR;
+
+    const UA_VariableNode *outputArguments =
+        getArgumentsVariableNode(server, method, UA_STRING("OutputArguments"));
+    if(!outputArguments || outputArguments->valueSource != UA_VALUESOURCE_VARIANT)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Variant outputValue;
+    UA_VariableNode_getValue(outputArguments, &outputValue);
+
+    UA_MethodArguments *args = UA_malloc(sizeof(UA_MethodArguments));
+    if(!args)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    args->version = version;
+    args->inputArgumentsSize = inputValue.arrayLength;
+    if(UA_Variant_isScalar(&inputValue))
+        args->inputArgumentsSize = 1;
+    args->outputArgumentsSize = outputValue.arrayLength;
+    UA_StatusCode retval = UA_Array_copy(inputValue.data, args->inputArgumentsSize,
+                                         (void**)&args->inputArguments, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(args);
+        return retval;
+    }
+    *arguments = args;
+    return UA_STATUSCODE_GOOD;
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void freeMethodArguments(UA_Server *server, void *data) {
+    UA_MethodArguments_delete((UA_MethodArguments*)data);
+}
+#endif
+
+/* Returns the cached argument definitions of the method and builds them if
+ * required. Definitions that cannot be cached (static nodes are read-only) are
+ * returned in *uncached and must be deleted after the call. */
+static UA_StatusCode
+getMethodArguments(UA_Server *server, const UA_MethodNode *method,
+                   const UA_MethodArguments **arguments, UA_MethodArguments **uncached) {
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_UInt32 version = server->methodArgumentsVersion;
+    UA_MethodArguments *cached = method->arguments;
+#else
+    UA_UInt32 version = uatomic_read(&server->methodArgumentsVersion);
+    UA_MethodArguments *cached = uatomic_read(&method->arguments);
+#endif
+    if(cached && cached->version == version) {
+        *arguments = cached;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_MethodArguments *newArgs;
+    UA_StatusCode retval = buildMethodArguments(server, method, version, &newArgs);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    *arguments = newArgs;
+    if(UA_NodeStore_isStatic(server->nodestore, (const UA_Node*)method)) {
+        *uncached = newArgs;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    /* The cache is set in the node that is otherwise immutable */
+    UA_MethodArguments **field = &((UA_MethodNode*)(uintptr_t)method)->arguments;
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_MethodArguments_delete(cached);
+    *field = newArgs;
+#else
+    if(uatomic_cmpxchg(field, cached, newArgs) != cached) {
+        /* Another thread was faster */
+        *uncached = newArgs;
+        return UA_STATUSCODE_GOOD;
+    }
+    if(cached)
+        UA_Server_delayedCallback(server, freeMethodArguments, cached);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
 void
 Service_Call_single(UA_Server *server, UA_Session *session, const UA_CallMethodRequest *request,
                     UA_CallMethodResult *result) {
@@ -171,34 +273,32 @@ Service_Call_single(UA_Server *server, UA_Session *session, const UA_CallMethodR
         return;
 
     /* Verify Input Argument count, types and sizes */
-    const UA_VariableNode *inputArguments = getArgumentsVariableNode(server, methodCalled, UA_STRING("InputArguments"));
-    if(!inputArguments) {
-        result->statusCode = UA_STATUSCODE_BADINVALIDARGUMENT;
+    const UA_MethodArguments *arguments;
+    UA_MethodArguments *uncached = NULL;
+    result->statusCode = getMethodArguments(server, methodCalled, &arguments, &uncached);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
-    }
-    result->statusCode = argConformsToDefinition(server, inputArguments, request->inputArgumentsSize,
+    result->statusCode = argConformsToDefinition(server, arguments, request->inputArgumentsSize,
                                                  request->inputArguments);
     if(result->statusCode != UA_STATUSCODE_GOOD)
-        return;
+        goto cleanup;
 
     /* Allocate the output arguments */
-    const UA_VariableNode *outputArguments = getArgumentsVariableNode(server, methodCalled, UA_STRING("OutputArguments"));
-    if(!outputArguments) {
-        result->statusCode = UA_STATUSCODE_BADINTERNALERROR;
-        return;
-    }
-    result->outputArguments = UA_Array_new(outputArguments->value.variant.value.arrayLength, &UA_TYPES[UA_TYPES_VARIANT]);
+    result->outputArguments = UA_Array_new(arguments->outputArgumentsSize, &UA_TYPES[UA_TYPES_VARIANT]);
     if(!result->outputArguments) {
         result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
-        return;
+        goto cleanup;
     }
-    result->outputArgumentsSize = outputArguments->value.variant.value.arrayLength;
+    result->outputArgumentsSize = arguments->outputArgumentsSize;
 
     /* Call the method */
     result->statusCode = methodCalled->attachedMethod(methodCalled->methodHandle, withObject->nodeId,
                                                       request->inputArgumentsSize, request->inputArguments,
                                                       result->outputArgumentsSize, result->outputArguments);
     /* TODO: Verify Output Argument count, types and sizes */
+
+ cleanup:
+    UA_MethodArguments_delete(uncached);
 }
 void Service_Call(UA_Server *server, UA_Session *session, const UA_CallRequest *request,
                   UA_CallResponse *response) {
@@ -216,32 +316,30 @@ void Service_Call(UA_Server *server, UA_Session *session, const UA_CallRequest *
     response->resultsSize = request->methodsToCallSize;
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-    UA_Boolean isExternal[request->methodsToCallSize];
-    UA_UInt32 indices[request->methodsToCallSize];
-    memset(isExternal, false, sizeof(UA_Boolean) * request->methodsToCallSize);
-    for(size_t j = 0;j<server->externalNamespacesSize;j++) {
-        size_t indexSize = 0;
-        for(size_t i = 0;i < request->methodsToCallSize;i++) {
-            if(request->methodsToCall[i].methodId.namespaceIndex != server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indexSize] = (UA_UInt32)i;
-            indexSize++;
-        }
-        if(indexSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->call(ens->ensHandle, &request->requestHeader, request->methodsToCall,
-                       indices, (UA_UInt32)indexSize, response->results);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->methodsToCall, request->methodsToCallSize,
+                               sizeof(UA_CallMethodRequest), offsetof(UA_CallMethodRequest, methodId))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    for(size_t j = 0; j < routing.routesSize; j++) {
+        UA_ExternalRoute *route = &routing.routes[j];
+        route->ens->call(route->ens->ensHandle, &request->requestHeader, request->methodsToCall,
+                         route->indices, route->indicesSize, response->results);
     }
 #endif
-	
-    for(size_t i = 0; i < request->methodsToCallSize;i++){
+
+    for(size_t i = 0; i < request->methodsToCallSize; i++) {
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+        if(routing.isExternal && routing.isExternal[i])
+            continue;
+#endif
+        Service_Call_single(server, session, &request->methodsToCall[i], &response->results[i]);
+    }
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
-#endif    
-			Service_Call_single(server, session, &request->methodsToCall[i], &response->results[i]);
-	}
+    UA_ExternalRouting_deleteMembers(&routing);
+#endif
 }
 
 #endif /* UA_ENABLE_METHODCALLS */
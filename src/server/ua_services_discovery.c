@@ -1,30 +1,22 @@
 #include "ua_server_internal.h"
 #include "ua_services.h"
 #include "ua_util.h"
+#include "ua_types_encoding_binary.h"
 
-void Service_FindServers(UA_Server *server, UA_Session *session,
-                         const UA_FindServersRequest *request, UA_FindServersResponse *response) {
-    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing FindServersRequest");
-    /* copy ApplicationDescription from the config */
-    UA_ApplicationDescription *descr = UA_malloc(sizeof(UA_ApplicationDescription));
-    if(!descr) {
-        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
-        return;
-    }
-    response->responseHeader.serviceResult =
+/* Copy the ApplicationDescription from the config and add the discoveryUrls
+ * from the networklayers */
+static UA_StatusCode
+copyServerDescription(UA_Server *server, UA_ApplicationDescription *descr) {
+    UA_StatusCode retval =
         UA_ApplicationDescription_copy(&server->config.applicationDescription, descr);
-    if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
-        UA_free(descr);
-        return;
-    }
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
 
-    /* add the discoveryUrls from the networklayers */
     UA_String *disc = UA_realloc(descr->discoveryUrls, sizeof(UA_String) *
                                  (descr->discoveryUrlsSize + server->config.networkLayersSize));
     if(!disc) {
-        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
-        UA_ApplicationDescription_delete(descr);
-        return;
+        UA_ApplicationDescription_deleteMembers(descr);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
     }
     size_t existing = descr->discoveryUrlsSize;
     descr->discoveryUrls = disc;
@@ -35,11 +27,38 @@ void Service_FindServers(UA_Server *server, UA_Session *session,
         UA_ServerNetworkLayer *nl = &server->config.networkLayers[i];
         UA_String_copy(&nl->discoveryUrl, &descr->discoveryUrls[existing + i]);
     }
+    return UA_STATUSCODE_GOOD;
+}
 
+void Service_FindServers(UA_Server *server, UA_Session *session,
+                         const UA_FindServersRequest *request, UA_FindServersResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing FindServersRequest");
+    UA_ApplicationDescription *descr = UA_malloc(sizeof(UA_ApplicationDescription));
+    if(!descr) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    response->responseHeader.serviceResult = copyServerDescription(server, descr);
+    if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
+        UA_free(descr);
+        return;
+    }
     response->servers = descr;
     response->serversSize = 1;
 }
 
+/* Test if the supported binary profile shall be returned */
+static UA_Boolean
+isRelevantEndpoint(const UA_GetEndpointsRequest *request, const UA_EndpointDescription *endpoint) {
+    if(request->profileUrisSize == 0)
+        return true;
+    for(size_t i = 0; i < request->profileUrisSize; i++) {
+        if(UA_String_equal(&request->profileUris[i], &endpoint->transportProfileUri))
+            return true;
+    }
+    return false;
+}
+
 void Service_GetEndpoints(UA_Server *server, UA_Session *session, const UA_GetEndpointsRequest *request,
                           UA_GetEndpointsResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing GetEndpointsRequest");
@@ -56,8 +75,7 @@ void Service_GetEndpoints(UA_Server *server, UA_Session *session, const UA_GetEn
     /*     response->endpointsSize = 0; */
     /*     return; */
     /* } */
-    
-    /* test if the supported binary profile shall be returned */
+
 #ifdef NO_ALLOCA
     UA_Boolean relevant_endpoints[server->endpointDescriptionsSize];
 #else
@@ -65,19 +83,9 @@ void Service_GetEndpoints(UA_Server *server, UA_Session *session, const UA_GetEn
 #endif
     size_t relevant_count = 0;
     for(size_t j = 0; j < server->endpointDescriptionsSize; j++) {
-        relevant_endpoints[j] = false;
-        if(request->profileUrisSize == 0) {
-            relevant_endpoints[j] = true;
+        relevant_endpoints[j] = isRelevantEndpoint(request, &server->endpointDescriptions[j]);
+        if(relevant_endpoints[j])
             relevant_count++;
-            continue;
-        }
-        for(size_t i = 0; i < request->profileUrisSize; i++) {
-            if(UA_String_equal(&request->profileUris[i], &server->endpointDescriptions[j].transportProfileUri)) {
-                relevant_endpoints[j] = true;
-                relevant_count++;
-                break;
-            }
-        }
     }
 
     if(relevant_count == 0) {
@@ -114,3 +122,154 @@ void Service_GetEndpoints(UA_Server *server, UA_Session *session, const UA_GetEn
     }
     response->endpointsSize = relevant_count;
 }
+
+/*******************/
+/* Discovery Cache */
+/*******************/
+
+/* The responses to clients that (re)connect are the same for every client.
+ * They are encoded once when the server starts and written as bytes into the
+ * response chunks. Only the response header is encoded for every request. */
+
+static UA_StatusCode
+encodeCached(const void *p, const UA_DataType *type, UA_Int32 arraySize,
+             UA_ByteString *encoded) {
+    size_t size = UA_calcSizeBinary((void*)(uintptr_t)p, type);
+    if(arraySize >= 0)
+        size += sizeof(UA_Int32);
+    UA_StatusCode retval = UA_ByteString_allocBuffer(encoded, size);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    size_t offset = 0;
+    if(arraySize >= 0)
+        retval = UA_encodeBinary(&arraySize, &UA_TYPES[UA_TYPES_INT32], NULL, NULL, encoded, &offset);
+    retval |= UA_encodeBinary(p, type, NULL, NULL, encoded, &offset);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_ByteString_deleteMembers(encoded);
+    return retval;
+}
+
+void UA_Server_buildDiscoveryCache(UA_Server *server) {
+    UA_Server_deleteDiscoveryCache(server);
+
+    /* The servers array of the FindServersResponse */
+    UA_ApplicationDescription descr;
+    UA_StatusCode retval = copyServerDescription(server, &descr);
+    if(retval == UA_STATUSCODE_GOOD) {
+        retval = encodeCached(&descr, &UA_TYPES[UA_TYPES_APPLICATIONDESCRIPTION], 1,
+                              &server->encodedServers);
+        UA_ApplicationDescription_deleteMembers(&descr);
+    }
+
+    /* The endpoints without the leading endpointUrl */
+    if(retval == UA_STATUSCODE_GOOD && server->endpointDescriptionsSize > 0) {
+        server->encodedEndpoints = UA_Array_new(server->endpointDescriptionsSize,
+                                                &UA_TYPES[UA_TYPES_BYTESTRING]);
+        if(!server->encodedEndpoints)
+            retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    for(size_t i = 0; i < server->endpointDescriptionsSize && retval == UA_STATUSCODE_GOOD; i++) {
+        const UA_EndpointDescription *endpoint = &server->endpointDescriptions[i];
+        UA_ByteString *encoded = &server->encodedEndpoints[i];
+        retval = encodeCached(endpoint, &UA_TYPES[UA_TYPES_ENDPOINTDESCRIPTION], -1, encoded);
+        if(retval != UA_STATUSCODE_GOOD)
+            break;
+        size_t urlSize = UA_calcSizeBinary((void*)(uintptr_t)&endpoint->endpointUrl,
+                                           &UA_TYPES[UA_TYPES_STRING]);
+        encoded->length -= urlSize;
+        memmove(encoded->data, &encoded->data[urlSize], encoded->length);
+    }
+
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Could not encode the discovery responses in advance "
+                       "with error code 0x%08x", retval);
+        UA_Server_deleteDiscoveryCache(server);
+    }
+}
+
+void UA_Server_deleteDiscoveryCache(UA_Server *server) {
+    UA_ByteString_deleteMembers(&server->encodedServers);
+    if(!server->encodedEndpoints)
+        return;
+    UA_Array_delete(server->encodedEndpoints, server->endpointDescriptionsSize,
+                    &UA_TYPES[UA_TYPES_BYTESTRING]);
+    server->encodedEndpoints = NULL;
+}
+
+static UA_StatusCode
+beginCachedResponse(UA_Server *server, UA_Session *session, const UA_RequestHeader *requestHeader,
+                    UA_UInt32 requestId, const UA_DataType *responseType, UA_MessageContext *mc) {
+    UA_ResponseHeader responseHeader;
+    UA_ResponseHeader_init(&responseHeader);
+    responseHeader.requestHandle = requestHeader->requestHandle;
+    responseHeader.timestamp = UA_Server_now(server);
+    UA_StatusCode retval = UA_SecureChannel_beginMessage(session->channel, requestId,
+                                                         responseType, mc);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_SecureChannel_encodeMessage(mc, &responseHeader, &UA_TYPES[UA_TYPES_RESPONSEHEADER]);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_SecureChannel_finishMessage(mc, retval);
+    return retval;
+}
+
+UA_Boolean
+Service_FindServers_cached(UA_Server *server, UA_Session *session,
+                           const UA_FindServersRequest *request, UA_UInt32 requestId) {
+    if(server->encodedServers.length == 0 || !session->channel)
+        return false;
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing FindServersRequest from the cache");
+    UA_MessageContext mc;
+    UA_StatusCode retval = beginCachedResponse(server, session, &request->requestHeader, requestId,
+                                               &UA_TYPES[UA_TYPES_FINDSERVERSRESPONSE], &mc);
+    if(retval == UA_STATUSCODE_GOOD) {
+        retval = UA_SecureChannel_writeMessageBytes(&mc, &server->encodedServers);
+        retval = UA_SecureChannel_finishMessage(&mc, retval);
+    }
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_LOG_INFO_SESSION(server->config.logger, session, "Could not send the FindServersResponse "
+                            "with error code 0x%08x", retval);
+    return true;
+}
+
+UA_Boolean
+Service_GetEndpoints_cached(UA_Server *server, UA_Session *session,
+                            const UA_GetEndpointsRequest *request, UA_UInt32 requestId) {
+    if(!server->encodedEndpoints || !session->channel)
+        return false;
+    UA_Int32 endpointsSize = 0;
+    for(size_t j = 0; j < server->endpointDescriptionsSize; j++) {
+        if(isRelevantEndpoint(request, &server->endpointDescriptions[j]))
+            endpointsSize++;
+    }
+    if(endpointsSize == 0)
+        return false; /* the regular service sends the empty array */
+
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing GetEndpointsRequest from the cache");
+    UA_MessageContext mc;
+    UA_StatusCode retval = beginCachedResponse(server, session, &request->requestHeader, requestId,
+                                               &UA_TYPES[UA_TYPES_GETENDPOINTSRESPONSE], &mc);
+    if(retval != UA_STATUSCODE_GOOD)
+        goto log_error;
+    retval = UA_SecureChannel_encodeMessage(&mc, &endpointsSize, &UA_TYPES[UA_TYPES_INT32]);
+    for(size_t j = 0; j < server->endpointDescriptionsSize && retval == UA_STATUSCODE_GOOD; j++) {
+        const UA_EndpointDescription *endpoint = &server->endpointDescriptions[j];
+        if(!isRelevantEndpoint(request, endpoint))
+            continue;
+        /* replace endpoint's URL to the requested one if provided */
+        const UA_String *url = &endpoint->endpointUrl;
+        if(request->endpointUrl.length > 0)
+            url = &request->endpointUrl;
+        retval = UA_SecureChannel_encodeMessage(&mc, url, &UA_TYPES[UA_TYPES_STRING]);
+        retval |= UA_SecureChannel_writeMessageBytes(&mc, &server->encodedEndpoints[j]);
+    }
+    retval = UA_SecureChannel_finishMessage(&mc, retval);
+    if(retval == UA_STATUSCODE_GOOD)
+        return true;
+
+ log_error:
+    UA_LOG_INFO_SESSION(server->config.logger, session, "Could not send the GetEndpointsResponse "
+                        "with error code 0x%08x", retval);
+    return true;
+}
@@ -34,11 +34,9 @@ getTypeHierarchy(UA_NodeStore *ns, const UA_NodeId *root, UA_NodeId **typeHierar
         node = UA_NodeStore_get(ns, &results[idx]);
         if(!node || node->nodeClass != UA_NODECLASS_REFERENCETYPE)
             continue;
-        for(size_t i = 0; i < node->referencesSize; i++) {
-            if(node->references[i].isInverse == true ||
-               !UA_NodeId_equal(&hasSubtypeNodeId, &node->references[i].referenceTypeId))
-                continue;
-
+        size_t begin, end;
+        UA_Node_findReferences(node, &hasSubtypeNodeId, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+        for(size_t i = begin; i < end; i++) {
             if(++last >= results_size) { // is the array big enough?
                 UA_NodeId *new_results = UA_realloc(results, sizeof(UA_NodeId) * results_size * 2);
                 if(!new_results) {
@@ -84,34 +82,23 @@ isNodeInTree(UA_NodeStore *ns, const UA_NodeId *rootNode, const UA_NodeId *nodeT
         return UA_STATUSCODE_BADINTERNALERROR;
 
     maxDepth = maxDepth - 1;
-    for(size_t i = 0; i < node->referencesSize; i++) {
-        /* Search only upwards */
-        if(!node->references[i].isInverse)
-            continue;
-
+    for(size_t j = 0; j < referenceTypeIdsSize; j++) {
         /* Go up only for some reference types */
-        UA_Boolean reftype_found = false;
-        for(size_t j = 0; j < referenceTypeIdsSize; j++) {
-            if(UA_NodeId_equal(&node->references[i].referenceTypeId, &referenceTypeIds[j])) {
-                reftype_found = true;
-                break;
-            }
-        }
-        if(!reftype_found)
-            continue;
+        size_t begin, end;
+        UA_Node_findReferences(node, &referenceTypeIds[j], UA_BROWSEDIRECTION_INVERSE, &begin, &end);
 
         /* Is the it node we seek? */
-        if(UA_NodeId_equal(&node->references[i].targetId.nodeId, nodeToFind)) {
+        if(UA_Node_findReference(node, &referenceTypeIds[j], true, nodeToFind) < end) {
             *found = true;
             return UA_STATUSCODE_GOOD;
         }
 
         /* Recurse */
-        if(maxDepth > 0) {
+        for(size_t i = begin; i < end && maxDepth > 0; i++) {
             retval = isNodeInTree(ns, &node->references[i].targetId.nodeId, nodeToFind,
                                   referenceTypeIds, referenceTypeIdsSize, maxDepth, found);
             if(*found || retval != UA_STATUSCODE_GOOD)
-                break;
+                return retval;
         }
     }
     return retval;
@@ -128,47 +115,121 @@ static UA_StatusCode
 instantiateObjectNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
                       const UA_NodeId *typeId, UA_InstantiationCallback *instantiationCallback);
 
-void
-Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
-                          const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId,
-                          const UA_NodeId *typeDefinition, UA_InstantiationCallback *instantiationCallback,
-                          UA_AddNodesResult *result) {
-    if(node->nodeId.namespaceIndex >= server->namespacesSize) {
-        UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Namespace invalid");
-        result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
-        UA_NodeStore_deleteNode(node);
-        return;
-    }
-
+/* Checks that the node can be added below the parent with the reference type */
+static UA_StatusCode
+checkParentReference(UA_Server *server, UA_Session *session, const UA_NodeId *parentNodeId,
+                     const UA_NodeId *referenceTypeId) {
     const UA_Node *parent = UA_NodeStore_get(server->nodestore, parentNodeId);
     if(!parent) {
         UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Parent node not found");
-        result->statusCode = UA_STATUSCODE_BADPARENTNODEIDINVALID;
-        UA_NodeStore_deleteNode(node);
-        return;
+        return UA_STATUSCODE_BADPARENTNODEIDINVALID;
     }
 
     const UA_ReferenceTypeNode *referenceType =
         (const UA_ReferenceTypeNode *)UA_NodeStore_get(server->nodestore, referenceTypeId);
     if(!referenceType) {
         UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Reference type to the parent not found");
-        result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-        UA_NodeStore_deleteNode(node);
-        return;
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
     }
     if(referenceType->nodeClass != UA_NODECLASS_REFERENCETYPE) {
         UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Reference type to the parent invalid");
-        result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-        UA_NodeStore_deleteNode(node);
-        return;
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
     }
     if(referenceType->isAbstract == true) {
         UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Abstract feference type to the parent invalid");
-        result->statusCode = UA_STATUSCODE_BADREFERENCENOTALLOWED;
+        return UA_STATUSCODE_BADREFERENCENOTALLOWED;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Variable values are shared between the node and the readers */
+static void shareValue(UA_Node *node) {
+    if(node->nodeClass == UA_NODECLASS_VARIABLE || node->nodeClass == UA_NODECLASS_VARIABLETYPE) {
+        UA_VariableNode *vnode = (UA_VariableNode*)node;
+        if(vnode->valueSource == UA_VALUESOURCE_VARIANT)
+            UA_Variant_share(&vnode->value.variant.value);
+    }
+}
+
+/* Adds the type definition of a new object or variable and instantiates the
+ * children of the type. The type definition defaults to BaseObjectType and
+ * BaseVariableType. If typeChecked is set, the type definition is known to be
+ * derived from the base type already. */
+static UA_StatusCode
+instantiateNode(UA_Server *server, UA_Session *session, UA_NodeClass nodeClass,
+                const UA_NodeId *nodeId, const UA_NodeId *typeDefinition, UA_Boolean typeChecked,
+                UA_InstantiationCallback *instantiationCallback) {
+    if(nodeClass != UA_NODECLASS_OBJECT && nodeClass != UA_NODECLASS_VARIABLE) {
+        if(instantiationCallback)
+            instantiationCallback->method(*nodeId, typeDefinition ? *typeDefinition : UA_NODEID_NULL,
+                                          instantiationCallback->handle);
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    const UA_NodeId hassubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    const UA_NodeId basetype = (nodeClass == UA_NODECLASS_OBJECT) ?
+        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE) : UA_NODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE);
+    if(!typeDefinition || UA_NodeId_equal(typeDefinition, &UA_NODEID_NULL)) {
+        /* Objects and variables must have a type reference */
+        typeDefinition = &basetype;
+    } else if(!typeChecked) {
+        /* Check if the supplied type is a subtype of the base type */
+        UA_Boolean found = false;
+        retval = isNodeInTree(server->nodestore, typeDefinition, &basetype, &hassubtype, 1, 10, &found);
+        if(!found)
+            retval = UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
+        if(retval != UA_STATUSCODE_GOOD) {
+            if(nodeClass == UA_NODECLASS_OBJECT) {
+                UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: The object if not derived from BaseObjectType");
+            } else {
+                UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: The variable if not derived from BaseVariableType");
+            }
+            return retval;
+        }
+    }
+
+    if(nodeClass == UA_NODECLASS_OBJECT)
+        retval = instantiateObjectNode(server, session, nodeId, typeDefinition, instantiationCallback);
+    else
+        retval = instantiateVariableNode(server, session, nodeId, typeDefinition, instantiationCallback);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* Custom callback */
+    if(instantiationCallback)
+        instantiationCallback->method(*nodeId, *typeDefinition, instantiationCallback->handle);
+    return UA_STATUSCODE_GOOD;
+}
+
+void
+Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
+                          const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId,
+                          const UA_NodeId *typeDefinition, UA_InstantiationCallback *instantiationCallback,
+                          UA_AddNodesResult *result) {
+    if(node->nodeId.namespaceIndex >= server->namespacesSize) {
+        UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Namespace invalid");
+        result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
+        UA_NodeStore_deleteNode(node);
+        return;
+    }
+
+    result->statusCode = checkParentReference(server, session, parentNodeId, referenceTypeId);
+    if(result->statusCode != UA_STATUSCODE_GOOD) {
         UA_NodeStore_deleteNode(node);
         return;
     }
 
+    shareValue(node);
+
+    /* With multithreading, the node is replaced when references are added. So
+       it must not be accessed after the insertion. */
+    const UA_NodeClass nodeClass = node->nodeClass;
+#ifdef UA_ENABLE_HISTORIZING
+    const UA_Boolean historizing = (nodeClass == UA_NODECLASS_VARIABLE &&
+                                    ((const UA_VariableNode*)node)->historizing);
+#endif
+
     // todo: test if the referencetype is hierarchical
     // todo: namespace index is assumed to be valid
     result->statusCode = UA_NodeStore_insert(server->nodestore, node);
@@ -177,12 +238,18 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
                              result->statusCode);
         return;
     }
+    if(nodeClass == UA_NODECLASS_REFERENCETYPE)
+        UA_Server_invalidateReferenceTypeIndex(server);
     result->statusCode = UA_NodeId_copy(&node->nodeId, &result->addedNodeId);
+#ifdef UA_ENABLE_HISTORIZING
+    if(historizing && result->statusCode == UA_STATUSCODE_GOOD)
+        UA_Server_historizeNode(server, &result->addedNodeId, true);
+#endif
 
     /* Hierarchical reference back to the parent */
     UA_AddReferencesItem item;
     UA_AddReferencesItem_init(&item);
-    item.sourceNodeId = node->nodeId;
+    item.sourceNodeId = result->addedNodeId;
     item.referenceTypeId = *referenceTypeId;
     item.isForward = false;
     item.targetNodeId.nodeId = *parentNodeId;
@@ -192,57 +259,10 @@ Service_AddNodes_existing(UA_Server *server, UA_Session *session, UA_Node *node,
         goto remove_node;
     }
 
-    const UA_NodeId hassubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
-    if(node->nodeClass == UA_NODECLASS_OBJECT) {
-        const UA_NodeId baseobjtype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE);
-        if(!typeDefinition || UA_NodeId_equal(typeDefinition, &UA_NODEID_NULL)) {
-            /* Objects must have a type reference. Default to BaseObjectType */
-            UA_NodeId *writableTypeDef = UA_alloca(sizeof(UA_NodeId));
-            *writableTypeDef = baseobjtype;
-            typeDefinition = writableTypeDef;
-        } else {
-            /* Check if the supplied type is a subtype of BaseObjectType */
-            UA_Boolean found = false;
-            result->statusCode = isNodeInTree(server->nodestore, typeDefinition, &baseobjtype, &hassubtype, 1, 10, &found);
-            if(!found)
-                result->statusCode = UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
-            if(result->statusCode != UA_STATUSCODE_GOOD) {
-                UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: The object if not derived from BaseObjectType");
-                goto remove_node;
-            }
-        }
-        result->statusCode = instantiateObjectNode(server, session, &result->addedNodeId,
-                                                   typeDefinition, instantiationCallback);
-        if(result->statusCode != UA_STATUSCODE_GOOD)
-            goto remove_node;
-    } else if(node->nodeClass == UA_NODECLASS_VARIABLE) {
-        const UA_NodeId basevartype = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEVARIABLETYPE);
-        if(!typeDefinition || UA_NodeId_equal(typeDefinition, &UA_NODEID_NULL)) {
-            /* Variables must have a type reference. Default to BaseVariableType */
-            UA_NodeId *writableTypeDef = UA_alloca(sizeof(UA_NodeId));
-            *writableTypeDef = basevartype;
-            typeDefinition = writableTypeDef;
-        } else {
-            /* Check if the supplied type is a subtype of BaseVariableType */
-            UA_Boolean found = false;
-            result->statusCode = isNodeInTree(server->nodestore, typeDefinition, &basevartype, &hassubtype, 1, 10, &found);
-            if(!found)
-                result->statusCode = UA_STATUSCODE_BADTYPEDEFINITIONINVALID;
-            if(result->statusCode != UA_STATUSCODE_GOOD) {
-                UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: The variable if not derived from BaseVariableType");
-                goto remove_node;
-            }
-        }
-        result->statusCode = instantiateVariableNode(server, session, &result->addedNodeId,
-                                                     typeDefinition, instantiationCallback);
-        if(result->statusCode != UA_STATUSCODE_GOOD)
-            goto remove_node;
-    }
-
-    /* Custom callback */
-    if(instantiationCallback)
-        instantiationCallback->method(result->addedNodeId, *typeDefinition, instantiationCallback->handle);
-
+    result->statusCode = instantiateNode(server, session, nodeClass, &result->addedNodeId,
+                                         typeDefinition, false, instantiationCallback);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        goto remove_node;
     return;
 
  remove_node:
@@ -270,7 +290,9 @@ copyExistingVariable(UA_Server *server, UA_Session *session, const UA_NodeId *va
     attr.writeMask = node->writeMask;
     attr.userWriteMask = node->userWriteMask;
     // todo: handle data sources!!!!
-    UA_Variant_copy(&node->value.variant.value, &attr.value);
+    UA_Variant value;
+    UA_VariableNode_getValue(node, &value);
+    UA_Variant_copy(&value, &attr.value);
     // datatype is taken from the value
     // valuerank is taken from the value
     // array dimensions are taken from the value
@@ -298,13 +320,11 @@ copyExistingVariable(UA_Server *server, UA_Session *session, const UA_NodeId *va
     UA_AddNodesItem_deleteMembers(&item);
 
     // now instantiate the variable for all hastypedefinition references
-    for(size_t i = 0; i < node->referencesSize; i++) {
+    const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    size_t begin, end;
+    UA_Node_findReferences((const UA_Node*)node, &hasTypeDef, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+    for(size_t i = begin; i < end; i++) {
         UA_ReferenceNode *rn = &node->references[i];
-        if(rn->isInverse)
-            continue;
-        const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-        if(!UA_NodeId_equal(&rn->referenceTypeId, &hasTypeDef))
-            continue;
         UA_StatusCode retval = instantiateVariableNode(server, session, &res.addedNodeId, &rn->targetId.nodeId, instantiationCallback);
         if(retval != UA_STATUSCODE_GOOD) {
             Service_DeleteNodes_single(server, &adminSession, &res.addedNodeId, true);
@@ -360,13 +380,11 @@ copyExistingObject(UA_Server *server, UA_Session *session, const UA_NodeId *vari
     UA_AddNodesItem_deleteMembers(&item);
 
     // now instantiate the object for all hastypedefinition references
-    for(size_t i = 0; i < node->referencesSize; i++) {
+    const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+    size_t begin, end;
+    UA_Node_findReferences((const UA_Node*)node, &hasTypeDef, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+    for(size_t i = begin; i < end; i++) {
         UA_ReferenceNode *rn = &node->references[i];
-        if(rn->isInverse)
-            continue;
-        const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-        if(!UA_NodeId_equal(&rn->referenceTypeId, &hasTypeDef))
-            continue;
         UA_StatusCode retval = instantiateObjectNode(server, session, &res.addedNodeId, &rn->targetId.nodeId, instantiationCallback);
         if(retval != UA_STATUSCODE_GOOD) {
             Service_DeleteNodes_single(server, &adminSession, &res.addedNodeId, true);
@@ -626,77 +644,67 @@ dataTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_DataTypeAttribu
     return (UA_Node*)dtnode;
 }
 
-void Service_AddNodes_single(UA_Server *server, UA_Session *session, const UA_AddNodesItem *item,
-                             UA_AddNodesResult *result, UA_InstantiationCallback *instantiationCallback) {
+/* Creates a node from the attributes of the item */
+static UA_StatusCode
+nodeFromAddNodesItem(const UA_AddNodesItem *item, UA_Node **node) {
     if(item->nodeAttributes.encoding < UA_EXTENSIONOBJECT_DECODED ||
-       !item->nodeAttributes.content.decoded.type) {
-        result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-        return;
-    }
+       !item->nodeAttributes.content.decoded.type)
+        return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
 
     /* Create the node */
-    UA_Node *node;
     switch(item->nodeClass) {
     case UA_NODECLASS_OBJECT:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = objectNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = objectNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_VARIABLE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = variableNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = variableNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_OBJECTTYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = objectTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = objectTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_VARIABLETYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = variableTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = variableTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_REFERENCETYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = referenceTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = referenceTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_DATATYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = dataTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = dataTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_VIEW:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VIEWATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = viewNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VIEWATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = viewNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
         break;
     case UA_NODECLASS_METHOD:
     case UA_NODECLASS_UNSPECIFIED:
     default:
-        result->statusCode = UA_STATUSCODE_BADNODECLASSINVALID;
-        return;
+        return UA_STATUSCODE_BADNODECLASSINVALID;
     }
 
-    if(!node) {
-        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+    if(!*node)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return UA_STATUSCODE_GOOD;
+}
+
+void Service_AddNodes_single(UA_Server *server, UA_Session *session, const UA_AddNodesItem *item,
+                             UA_AddNodesResult *result, UA_InstantiationCallback *instantiationCallback) {
+    UA_Node *node = NULL;
+    result->statusCode = nodeFromAddNodesItem(item, &node);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
-    }
 
     /* add it to the server */
     Service_AddNodes_existing(server, session, node, &item->parentNodeId.nodeId,
@@ -706,6 +714,173 @@ void Service_AddNodes_single(UA_Server *server, UA_Session *session, const UA_Ad
         Service_DeleteNodes_single(server, session, &result->addedNodeId, true);
 }
 
+/* The forward reference from the parent to a node of the batch */
+typedef struct {
+    const UA_AddNodesItem *item;
+    UA_AddNodesResult *result;
+} UA_BatchChild;
+
+static int compareBatchChildren(const void *a, const void *b) {
+    const UA_BatchChild *ca = (const UA_BatchChild*)a;
+    const UA_BatchChild *cb = (const UA_BatchChild*)b;
+    UA_Int32 order = UA_NodeId_order(&ca->item->parentNodeId.nodeId, &cb->item->parentNodeId.nodeId);
+    if(order != 0)
+        return order;
+    return (ca->result > cb->result) - (ca->result < cb->result);
+}
+
+typedef struct {
+    const UA_BatchChild *children;
+    size_t childrenSize;
+} UA_BatchParent;
+
+static UA_StatusCode
+addChildReferences(UA_Server *server, UA_Session *session, UA_Node *node, const UA_BatchParent *parent) {
+    UA_ReferenceNode *refs = UA_Array_new(parent->childrenSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    if(!refs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    /* Shallow copies. UA_Node_addReferences makes the deep copies. */
+    for(size_t i = 0; i < parent->childrenSize; i++) {
+        refs[i].referenceTypeId = parent->children[i].item->referenceTypeId;
+        refs[i].isInverse = false;
+        refs[i].targetId.nodeId = parent->children[i].result->addedNodeId;
+    }
+    UA_StatusCode retval = UA_Node_addReferences(node, refs, parent->childrenSize);
+    UA_free(refs);
+    return retval;
+}
+
+/* Adds the nodes of the batch like Service_AddNodes_single, but
+ * - the nodestore grows once for the entire batch,
+ * - the parent and reference type are checked once for consecutive items with
+ *   the same parent and reference type,
+ * - the type definition is checked once for consecutive items of the same type,
+ * - the reference to the parent is added to the new node before it is inserted,
+ * - every parent is edited once to add the references to all of its new
+ *   children. */
+void
+Service_AddNodes_batch(UA_Server *server, UA_Session *session, const UA_AddNodesItem *items,
+                       size_t itemsSize, UA_AddNodesResult *results) {
+    if(itemsSize == 0)
+        return;
+    UA_BatchChild *children = UA_malloc(sizeof(UA_BatchChild) * itemsSize);
+    if(!children) {
+        for(size_t i = 0; i < itemsSize; i++)
+            results[i].statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    size_t childrenSize = 0;
+
+    /* Not enough memory for all nodes is detected with the single inserts */
+    UA_NodeStore_reserve(server->nodestore, itemsSize);
+
+    const UA_AddNodesItem *checkedParent = NULL;
+    UA_StatusCode parentStatus = UA_STATUSCODE_GOOD;
+    const UA_AddNodesItem *checkedType = NULL;
+    UA_Boolean addedReferenceTypes = false;
+    for(size_t i = 0; i < itemsSize; i++) {
+        const UA_AddNodesItem *item = &items[i];
+        UA_AddNodesResult *result = &results[i];
+
+        /* Check the parent */
+        if(!checkedParent ||
+           !UA_NodeId_equal(&checkedParent->parentNodeId.nodeId, &item->parentNodeId.nodeId) ||
+           !UA_NodeId_equal(&checkedParent->referenceTypeId, &item->referenceTypeId)) {
+            parentStatus = checkParentReference(server, session, &item->parentNodeId.nodeId,
+                                                &item->referenceTypeId);
+            checkedParent = item;
+        }
+        result->statusCode = parentStatus;
+        if(result->statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        if(item->requestedNewNodeId.nodeId.namespaceIndex >= server->namespacesSize) {
+            UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Namespace invalid");
+            result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
+            continue;
+        }
+
+        /* Create the node with the reference to the parent */
+        UA_Node *node = NULL;
+        result->statusCode = nodeFromAddNodesItem(item, &node);
+        if(result->statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        UA_ExpandedNodeId parentId;
+        UA_ExpandedNodeId_init(&parentId);
+        parentId.nodeId = item->parentNodeId.nodeId;
+        result->statusCode = UA_Node_addReference(node, &item->referenceTypeId, true, &parentId);
+        if(result->statusCode != UA_STATUSCODE_GOOD) {
+            UA_NodeStore_deleteNode(node);
+            continue;
+        }
+        shareValue(node);
+        const UA_NodeClass nodeClass = node->nodeClass;
+#ifdef UA_ENABLE_HISTORIZING
+        const UA_Boolean historizing = (nodeClass == UA_NODECLASS_VARIABLE &&
+                                        ((const UA_VariableNode*)node)->historizing);
+#endif
+        result->statusCode = UA_NodeStore_insert(server->nodestore, node);
+        if(result->statusCode != UA_STATUSCODE_GOOD) {
+            UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Node could not be added to the nodestore with error code 0x%08x",
+                                 result->statusCode);
+            continue;
+        }
+        if(nodeClass == UA_NODECLASS_REFERENCETYPE)
+            addedReferenceTypes = true;
+        result->statusCode = UA_NodeId_copy(&node->nodeId, &result->addedNodeId);
+        if(result->statusCode != UA_STATUSCODE_GOOD) {
+            UA_NodeStore_remove(server->nodestore, &node->nodeId);
+            continue;
+        }
+#ifdef UA_ENABLE_HISTORIZING
+        if(historizing)
+            UA_Server_historizeNode(server, &result->addedNodeId, true);
+#endif
+
+        /* Instantiate the type */
+        const UA_NodeId *typeDefinition = &item->typeDefinition.nodeId;
+        UA_Boolean typeChecked = (checkedType && checkedType->nodeClass == nodeClass &&
+                                  UA_NodeId_equal(&checkedType->typeDefinition.nodeId, typeDefinition));
+        result->statusCode = instantiateNode(server, session, nodeClass, &result->addedNodeId,
+                                             typeDefinition, typeChecked, NULL);
+        if(result->statusCode != UA_STATUSCODE_GOOD) {
+            Service_DeleteNodes_single(server, &adminSession, &result->addedNodeId, true);
+            UA_AddNodesResult_deleteMembers(result);
+            continue;
+        }
+        checkedType = item;
+
+        children[childrenSize].item = item;
+        children[childrenSize].result = result;
+        childrenSize++;
+    }
+
+    /* Add the references to the parents. Every parent is edited once. */
+    qsort(children, childrenSize, sizeof(UA_BatchChild), compareBatchChildren);
+    for(size_t i = 0; i < childrenSize;) {
+        UA_BatchParent parent = {&children[i], 1};
+        const UA_NodeId *parentNodeId = &children[i].item->parentNodeId.nodeId;
+        while(i + parent.childrenSize < childrenSize &&
+              UA_NodeId_equal(&children[i + parent.childrenSize].item->parentNodeId.nodeId, parentNodeId))
+            parent.childrenSize++;
+        UA_StatusCode retval = UA_Server_editNode(server, session, parentNodeId,
+                                                  (UA_EditNodeCallback)addChildReferences, &parent);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_LOG_DEBUG_SESSION(server->config.logger, session, "AddNodes: Could not add the references to the parent");
+            for(size_t j = 0; j < parent.childrenSize; j++) {
+                UA_AddNodesResult *result = children[i + j].result;
+                Service_DeleteNodes_single(server, &adminSession, &result->addedNodeId, true);
+                UA_AddNodesResult_deleteMembers(result);
+                result->statusCode = retval;
+            }
+        }
+        i += parent.childrenSize;
+    }
+    if(addedReferenceTypes)
+        UA_Server_invalidateReferenceTypeIndex(server);
+    UA_free(children);
+}
+
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_AddNodes(UA_Server *server, UA_Session *session, const UA_AddNodesRequest *request,
                       UA_AddNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing AddNodesRequest");
@@ -722,40 +897,35 @@ void Service_AddNodes(UA_Server *server, UA_Session *session, const UA_AddNodesR
     }
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-#ifdef _MSC_VER
-    UA_Boolean *isExternal = UA_alloca(size);
-    UA_UInt32 *indices = UA_alloca(sizeof(UA_UInt32)*size);
-#else
-    UA_Boolean isExternal[size];
-    UA_UInt32 indices[size];
-#endif
-    memset(isExternal, false, sizeof(UA_Boolean) * size);
-    for(size_t j = 0; j <server->externalNamespacesSize; j++) {
-        size_t indexSize = 0;
-        for(size_t i = 0;i < size;i++) {
-            if(request->nodesToAdd[i].requestedNewNodeId.nodeId.namespaceIndex !=
-               server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indexSize] = (UA_UInt32)i;
-            indexSize++;
-        }
-        if(indexSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->addNodes(ens->ensHandle, &request->requestHeader, request->nodesToAdd,
-                      indices, (UA_UInt32)indexSize, response->results, response->diagnosticInfos);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->nodesToAdd, size, sizeof(UA_AddNodesItem),
+                               offsetof(UA_AddNodesItem, requestedNewNodeId.nodeId))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    for(size_t j = 0; j < routing.routesSize; j++) {
+        UA_ExternalRoute *route = &routing.routes[j];
+        route->ens->addNodes(route->ens->ensHandle, &request->requestHeader, request->nodesToAdd,
+                             route->indices, route->indicesSize, response->results,
+                             response->diagnosticInfos);
     }
 #endif
 
     response->resultsSize = size;
-    for(size_t i = 0; i < size; i++) {
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
-#endif
-            Service_AddNodes_single(server, session, &request->nodesToAdd[i], &response->results[i], NULL);
+    if(routing.isExternal) {
+        for(size_t i = 0; i < size; i++) {
+            if(!routing.isExternal[i])
+                Service_AddNodes_single(server, session, &request->nodesToAdd[i], &response->results[i], NULL);
+        }
+        UA_ExternalRouting_deleteMembers(&routing);
+        return;
     }
+#endif
+    Service_AddNodes_batch(server, session, request->nodesToAdd, size, response->results);
 }
+#endif
 
 /**************************************************/
 /* Add Special Nodes (not possible over the wire) */
@@ -797,6 +967,8 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
     copyStandardAttributes((UA_Node*)node, &item, (UA_NodeAttributes*)&attrCopy);
     node->valueSource = UA_VALUESOURCE_DATASOURCE;
     node->value.dataSource = dataSource;
+    if(dataSource.readBatch)
+        server->batchReadSources = true;
     node->accessLevel = attr.accessLevel;
     node->userAccessLevel = attr.userAccessLevel;
     node->historizing = attr.historizing;
@@ -919,24 +1091,18 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
 /* Add References */
 /******************/
 
+/* The closure of the reference types changes with HasSubtype references */
+static void
+subtypeReferenceChanged(UA_Server *server, const UA_NodeId *referenceTypeId) {
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    if(UA_NodeId_equal(referenceTypeId, &hasSubtype))
+        UA_Server_invalidateReferenceTypeIndex(server);
+}
+
 /* Adds a one-way reference to the local nodestore */
 static UA_StatusCode
 addOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node, const UA_AddReferencesItem *item) {
-    size_t i = node->referencesSize;
-    size_t refssize = (i+1) | 3; // so the realloc is not necessary every time
-    UA_ReferenceNode *new_refs = UA_realloc(node->references, sizeof(UA_ReferenceNode) * refssize);
-    if(!new_refs)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    node->references = new_refs;
-    UA_ReferenceNode_init(&new_refs[i]);
-    UA_StatusCode retval = UA_NodeId_copy(&item->referenceTypeId, &new_refs[i].referenceTypeId);
-    retval |= UA_ExpandedNodeId_copy(&item->targetNodeId, &new_refs[i].targetId);
-    new_refs[i].isInverse = !item->isForward;
-    if(retval == UA_STATUSCODE_GOOD)
-        node->referencesSize = i+1;
-    else
-        UA_ReferenceNode_deleteMembers(&new_refs[i]);
-    return retval;
+    return UA_Node_addReference(node, &item->referenceTypeId, !item->isForward, &item->targetNodeId);
 }
 
 UA_StatusCode
@@ -949,16 +1115,11 @@ UA_StatusCode retval = UA_STATUSCODE_GOOD;
         return UA_STATUSCODE_BADNOTIMPLEMENTED; // currently no expandednodeids are allowed
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-    for(size_t j = 0; j <server->externalNamespacesSize; j++) {
-        if(item->sourceNodeId.namespaceIndex != server->externalNamespaces[j].index) {
-                continue;
-		} else {
-			UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-			retval = ens->addOneWayReference(ens->ensHandle, item);
-			handledExternally = UA_TRUE;
-			break;
-        }
-        
+    UA_ExternalNamespace *ens = UA_Server_getExternalNamespace(server, item->sourceNodeId.namespaceIndex);
+    if(ens) {
+        retval = (UA_StatusCode)
+            ens->externalNodeStore.addOneWayReference(ens->externalNodeStore.ensHandle, item);
+        handledExternally = UA_TRUE;
     }
 	if(handledExternally == UA_FALSE) {
 #endif
@@ -981,16 +1142,11 @@ UA_StatusCode retval = UA_STATUSCODE_GOOD;
     secondItem.isForward = !item->isForward;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     handledExternally = UA_FALSE;
-	for(size_t j = 0; j <server->externalNamespacesSize; j++) {
-        if(secondItem.sourceNodeId.namespaceIndex != server->externalNamespaces[j].index) {
-                continue;
-		} else {
-			UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-			retval = ens->addOneWayReference(ens->ensHandle, &secondItem);
-			handledExternally = UA_TRUE;
-			break;
-        }
-        
+    ens = UA_Server_getExternalNamespace(server, secondItem.sourceNodeId.namespaceIndex);
+    if(ens) {
+        retval = (UA_StatusCode)
+            ens->externalNodeStore.addOneWayReference(ens->externalNodeStore.ensHandle, &secondItem);
+        handledExternally = UA_TRUE;
     }
 	if(handledExternally == UA_FALSE) {
 #endif
@@ -999,10 +1155,12 @@ UA_StatusCode retval = UA_STATUSCODE_GOOD;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
 	}
 #endif
+    subtypeReferenceChanged(server, &item->referenceTypeId);
     // todo: remove reference if the second direction failed
     return retval;
 }
 
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_AddReferences(UA_Server *server, UA_Session *session, const UA_AddReferencesRequest *request,
                            UA_AddReferencesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing AddReferencesRequest");
@@ -1019,38 +1177,69 @@ void Service_AddReferences(UA_Server *server, UA_Session *session, const UA_AddR
     response->resultsSize = size;
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-#ifdef NO_ALLOCA
-    UA_Boolean isExternal[size];
-    UA_UInt32 indices[size];
-#else
-    UA_Boolean *isExternal = UA_alloca(sizeof(UA_Boolean) * size);
-    UA_UInt32 *indices = UA_alloca(sizeof(UA_UInt32) * size);
-#endif /*NO_ALLOCA */
-    memset(isExternal, false, sizeof(UA_Boolean) * size);
-    for(size_t j = 0; j < server->externalNamespacesSize; j++) {
-        size_t indicesSize = 0;
-        for(size_t i = 0;i < size;i++) {
-            if(request->referencesToAdd[i].sourceNodeId.namespaceIndex
-               != server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indicesSize] = (UA_UInt32)i;
-            indicesSize++;
-        }
-        if (indicesSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->addReferences(ens->ensHandle, &request->requestHeader, request->referencesToAdd,
-                           indices, (UA_UInt32)indicesSize, response->results, response->diagnosticInfos);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->referencesToAdd, size,
+                               sizeof(UA_AddReferencesItem),
+                               offsetof(UA_AddReferencesItem, sourceNodeId))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    for(size_t j = 0; j < routing.routesSize; j++) {
+        UA_ExternalRoute *route = &routing.routes[j];
+        route->ens->addReferences(route->ens->ensHandle, &request->requestHeader,
+                                  request->referencesToAdd, route->indices, route->indicesSize,
+                                  response->results, response->diagnosticInfos);
     }
 #endif
 
     for(size_t i = 0; i < response->resultsSize; i++) {
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+        if(routing.isExternal && routing.isExternal[i])
+            continue;
+#endif
+        Service_AddReferences_single(server, session, &request->referencesToAdd[i]);
+    }
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    UA_ExternalRouting_deleteMembers(&routing);
+#endif
+}
 #endif
-            Service_AddReferences_single(server, session, &request->referencesToAdd[i]);
+
+/****************/
+/* Static Nodes */
+/****************/
+
+UA_StatusCode
+UA_Server_addStaticNodes(UA_Server *server, const UA_StaticNodeTable *table) {
+    UA_RCU_LOCK();
+    UA_StatusCode retval = UA_NodeStore_addStaticNodes(server->nodestore, table);
+    /* The nodeset compiler emits the references between the static nodes in
+       both directions. Only the nodes outside the table are linked back. */
+    for(size_t i = 0; i < table->nodesSize && retval == UA_STATUSCODE_GOOD; i++) {
+        const UA_Node *node = table->nodes[i];
+        for(size_t j = 0; j < node->referencesSize && retval == UA_STATUSCODE_GOOD; j++) {
+            const UA_ReferenceNode *ref = &node->references[j];
+            const UA_NodeId *targetId = &ref->targetId.nodeId;
+            if(UA_StaticNodeTable_find(table, targetId) < table->nodesSize)
+                continue;
+            const UA_Node *target = UA_NodeStore_get(server->nodestore, targetId);
+            if(!target || UA_Node_findReference(target, &ref->referenceTypeId, !ref->isInverse,
+                                                 &node->nodeId) < target->referencesSize)
+                continue;
+            UA_AddReferencesItem item;
+            UA_AddReferencesItem_init(&item);
+            item.sourceNodeId = *targetId;
+            item.referenceTypeId = ref->referenceTypeId;
+            item.isForward = ref->isInverse;
+            item.targetNodeId.nodeId = node->nodeId;
+            retval = UA_Server_editNode(server, &adminSession, targetId,
+                                        (UA_EditNodeCallback)addOneWayReference, &item);
+        }
     }
+    UA_Server_invalidateReferenceTypeIndex(server);
+    UA_RCU_UNLOCK();
+    return retval;
 }
 
 /****************/
@@ -1108,9 +1297,31 @@ Service_DeleteNodes_single(UA_Server *server, UA_Session *session, const UA_Node
         UA_BrowseResult_deleteMembers(&result);
     }
 
-    return UA_NodeStore_remove(server->nodestore, nodeId);
+    UA_Boolean isReferenceType = (node->nodeClass == UA_NODECLASS_REFERENCETYPE);
+    UA_StatusCode retval = UA_NodeStore_remove(server->nodestore, nodeId);
+    if(isReferenceType)
+        UA_Server_invalidateReferenceTypeIndex(server);
+    /* A new node with the same nodeid can have a different browse name and value */
+    UA_Server_invalidateBrowseNameIndices(server);
+    UA_Server_invalidateMethodArguments(server);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* The monitored items sample the missing node. A new node with the same
+     * nodeid may have a data source. */
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_Server_pollValueWatchers(server, nodeId);
+#endif
+#ifdef UA_ENABLE_HISTORIZING
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_Server_historizeNode(server, nodeId, false);
+#endif
+#ifdef UA_ENABLE_NODE_STATISTICS
+    if(retval == UA_STATUSCODE_GOOD)
+        UA_Server_removeNodeStatistics(server, nodeId);
+#endif
+    return retval;
 }
 
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void Service_DeleteNodes(UA_Server *server, UA_Session *session, const UA_DeleteNodesRequest *request,
                          UA_DeleteNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing DeleteNodesRequest");
@@ -1130,6 +1341,7 @@ void Service_DeleteNodes(UA_Server *server, UA_Session *session, const UA_Delete
                                                           item->deleteTargetReferences);
     }
 }
+#endif
 
 /*********************/
 /* Delete References */
@@ -1138,29 +1350,12 @@ void Service_DeleteNodes(UA_Server *server, UA_Session *session, const UA_Delete
 static UA_StatusCode
 deleteOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
                       const UA_DeleteReferencesItem *item) {
-    UA_Boolean edited = false;
-    for(size_t i = node->referencesSize-1; ; i--) {
-        if(i > node->referencesSize)
-            break; /* underflow after i == 0 */
-        if(!UA_NodeId_equal(&item->targetNodeId.nodeId, &node->references[i].targetId.nodeId))
-            continue;
-        if(!UA_NodeId_equal(&item->referenceTypeId, &node->references[i].referenceTypeId))
-            continue;
-        if(item->isForward == node->references[i].isInverse)
-            continue;
-        /* move the last entry to override the current position */
-        UA_ReferenceNode_deleteMembers(&node->references[i]);
-        node->references[i] = node->references[node->referencesSize-1];
-        node->referencesSize--;
-        edited = true;
-        break;
-    }
-    if(!edited)
+    size_t i = UA_Node_findReference(node, &item->referenceTypeId, !item->isForward,
+                                     &item->targetNodeId.nodeId);
+    if(i == node->referencesSize)
         return UA_STATUSCODE_UNCERTAINREFERENCENOTDELETED;
-    /* we removed the last reference */
-    if(node->referencesSize == 0 && node->references)
-        UA_free(node->references);
-    return UA_STATUSCODE_GOOD;;
+    UA_Node_removeReference(node, i);
+    return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
@@ -1168,6 +1363,7 @@ Service_DeleteReferences_single(UA_Server *server, UA_Session *session,
                                 const UA_DeleteReferencesItem *item) {
     UA_StatusCode retval = UA_Server_editNode(server, session, &item->sourceNodeId,
                                               (UA_EditNodeCallback)deleteOneWayReference, item);
+    subtypeReferenceChanged(server, &item->referenceTypeId);
     if(!item->deleteBidirectional || item->targetNodeId.serverIndex != 0)
         return retval;
     UA_DeleteReferencesItem secondItem;
@@ -1179,6 +1375,7 @@ Service_DeleteReferences_single(UA_Server *server, UA_Session *session,
                               (UA_EditNodeCallback)deleteOneWayReference, &secondItem);
 }
 
+#ifdef UA_ENABLE_NODEMANAGEMENT
 void
 Service_DeleteReferences(UA_Server *server, UA_Session *session,
                          const UA_DeleteReferencesRequest *request,
@@ -1198,3 +1395,4 @@ Service_DeleteReferences(UA_Server *server, UA_Session *session,
         response->results[i] =
             Service_DeleteReferences_single(server, session, &request->referencesToDelete[i]);
 }
+#endif
@@ -30,6 +30,10 @@ void Service_CreateSession(UA_Server *server, UA_SecureChannel *channel,
     response->revisedSessionTimeout = (UA_Double)newSession->timeout;
     response->authenticationToken = newSession->authenticationToken;
     response->responseHeader.serviceResult = UA_String_copy(&request->sessionName, &newSession->sessionName);
+    response->responseHeader.serviceResult |=
+        UA_ApplicationDescription_copy(&request->clientDescription, &newSession->clientDescription);
+    response->responseHeader.serviceResult |=
+        UA_ByteString_copy(&request->clientCertificate, &newSession->clientCertificate);
     if(server->endpointDescriptionsSize > 0)
         response->responseHeader.serviceResult |= UA_ByteString_copy(&server->endpointDescriptions->serverCertificate,
                                &response->serverCertificate);
@@ -44,7 +48,7 @@ void Service_CreateSession(UA_Server *server, UA_SecureChannel *channel,
 void
 Service_ActivateSession(UA_Server *server, UA_SecureChannel *channel, UA_Session *session,
                         const UA_ActivateSessionRequest *request, UA_ActivateSessionResponse *response) {
-    if(session->validTill < UA_DateTime_now()) {
+    if(session->validTill < UA_Server_now(server)) {
         UA_LOG_INFO_SESSION(server->config.logger, session, "ActivateSession: SecureChannel %i wants "
                             "to activate, but the session has timed out", channel->securityToken.channelId);
         response->responseHeader.serviceResult = UA_STATUSCODE_BADSESSIONIDINVALID;
@@ -120,16 +124,49 @@ Service_ActivateSession(UA_Server *server, UA_SecureChannel *channel, UA_Session
         return;
     }
 
+    /* The user of the session. Subscriptions are only transferred between
+     * sessions of the same user. */
+    const UA_DataType *tokenType = request->userIdentityToken.content.decoded.type;
+    UA_String userName = UA_STRING_NULL;
+    UA_String policyId = UA_STRING_NULL;
+    if(tokenType == &UA_TYPES[UA_TYPES_USERNAMEIDENTITYTOKEN]) {
+        const UA_UserNameIdentityToken *token = request->userIdentityToken.content.decoded.data;
+        response->responseHeader.serviceResult = UA_String_copy(&token->userName, &userName);
+        response->responseHeader.serviceResult |= UA_String_copy(&token->policyId, &policyId);
+    } else {
+        /* An empty policyId is taken as the anonymous policy (see above) */
+        const UA_AnonymousIdentityToken *token = request->userIdentityToken.content.decoded.data;
+        response->responseHeader.serviceResult =
+            UA_String_copy(token->policyId.length > 0 ? &token->policyId : &ap, &policyId);
+    }
+    if(response->responseHeader.serviceResult != UA_STATUSCODE_GOOD) {
+        UA_String_deleteMembers(&userName);
+        UA_String_deleteMembers(&policyId);
+        return;
+    }
+    UA_String_deleteMembers(&session->userName);
+    UA_String_deleteMembers(&session->userPolicyId);
+    session->userName = userName;
+    session->userPolicyId = policyId;
+    session->userTokenType = tokenType;
+
     /* Detach the old SecureChannel */
     if(session->channel && session->channel != channel) {
         UA_LOG_INFO_SESSION(server->config.logger, session, "ActivateSession: Detach from old channel");
         UA_SecureChannel_detachSession(session->channel, session);
     }
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    /* The publish requests of a reconnecting client were received on the old
+     * channel. The client sends new ones. */
+    if(session->channel != channel)
+        UA_Session_discardPublishRequests(session);
+#endif
+
     /* Attach to the SecureChannel and activate */
     UA_SecureChannel_attachSession(channel, session);
     session->activated = true;
-    UA_Session_updateLifetime(session);
+    UA_Session_updateLifetime(session, UA_Server_now(server));
     UA_LOG_INFO_SESSION(server->config.logger, session, "ActivateSession: Session activated");
 }
 
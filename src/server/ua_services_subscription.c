@@ -1,9 +1,10 @@
 #include "ua_server_internal.h"
 #include "ua_services.h"
-#include "ua_subscription.h"
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
+#include "ua_subscription.h"
+
 #define UA_BOUNDEDVALUE_SETWBOUNDS(BOUNDS, SRC, DST) { \
         if(SRC > BOUNDS.max) DST = BOUNDS.max;         \
         else if(SRC < BOUNDS.min) DST = BOUNDS.min;    \
@@ -41,7 +42,13 @@ void Service_CreateSubscription(UA_Server *server, UA_Session *session,
                                 const UA_CreateSubscriptionRequest *request,
                                 UA_CreateSubscriptionResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing CreateSubscriptionRequest");
-    response->subscriptionId = UA_Session_getUniqueSubscriptionID(session);
+    if(server->config.maxSessionMemory > 0 &&
+       UA_Session_memoryUsage(session) + sizeof(UA_Subscription) > server->config.maxSessionMemory) {
+        session->memory.discarded++;
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADTOOMANYSUBSCRIPTIONS;
+        return;
+    }
+    response->subscriptionId = UA_SessionManager_getUniqueSubscriptionID(&server->sessionManager);
     UA_Subscription *newSubscription = UA_Subscription_new(session, response->subscriptionId);
     if(!newSubscription) {
         response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
@@ -122,13 +129,104 @@ setMonitoredItemSettings(UA_Server *server, UA_MonitoredItem *mon,
     /* Check for nan */
     if(samplingInterval != samplingInterval)
         mon->samplingInterval = server->config.samplingIntervalLimits.min;
+    UA_UInt32 revisedQueueSize;
     UA_BOUNDEDVALUE_SETWBOUNDS(server->config.queueSizeLimits,
-                               queueSize, mon->maxQueueSize);
+                               queueSize, revisedQueueSize);
+    /* A larger ring of an existing item must fit into the memory quota */
+    if(revisedQueueSize > mon->maxQueueSize && mon->memory > 0 &&
+       UA_Subscription_exceedsMemory(server, mon->subscription, sizeof(MonitoredItem_queuedValue) *
+                                     (revisedQueueSize - mon->maxQueueSize))) {
+        mon->subscription->session->memory.discarded++;
+        revisedQueueSize = mon->maxQueueSize;
+    }
+    /* Keep the current queue if the ring cannot be reallocated */
+    MonitoredItem_setQueueSize(mon, revisedQueueSize);
     mon->discardOldest = discardOldest;
     if(monitoringMode == UA_MONITORINGMODE_REPORTING)
         MonitoredItem_registerSampleJob(server, mon);
 }
 
+/* Reads the EURange property of an analog item */
+static UA_StatusCode
+getEURange(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId, UA_Range *range) {
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
+    if(!node)
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    const UA_String euRangeName = UA_STRING("EURange");
+    const UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+    size_t begin, end;
+    UA_Node_findReferences(node, &hasProperty, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+    for(size_t i = begin; i < end; i++) {
+        const UA_Node *property = UA_NodeStore_get(server->nodestore, &node->references[i].targetId.nodeId);
+        if(!property || property->nodeClass != UA_NODECLASS_VARIABLE ||
+           property->browseName.namespaceIndex != 0 ||
+           !UA_String_equal(&property->browseName.name, &euRangeName))
+            continue;
+        UA_ReadValueId rvid;
+        UA_ReadValueId_init(&rvid);
+        rvid.nodeId = property->nodeId;
+        rvid.attributeId = UA_ATTRIBUTEID_VALUE;
+        UA_DataValue v;
+        UA_DataValue_init(&v);
+        Service_Read_single(server, session, UA_TIMESTAMPSTORETURN_NEITHER, &rvid, &v);
+        UA_StatusCode retval = UA_STATUSCODE_BADMONITOREDITEMFILTERUNSUPPORTED;
+        if(v.hasValue && UA_Variant_isScalar(&v.value) && v.value.type == &UA_TYPES[UA_TYPES_RANGE]) {
+            *range = *(UA_Range*)v.value.data;
+            retval = UA_STATUSCODE_GOOD;
+        }
+        UA_DataValue_deleteMembers(&v);
+        return retval;
+    }
+    return UA_STATUSCODE_BADMONITOREDITEMFILTERUNSUPPORTED;
+}
+
+/* Without a filter, changes of the status and the value are reported */
+static UA_StatusCode
+setMonitoredItemFilter(UA_Server *server, UA_Session *session, UA_MonitoredItem *mon,
+                       const UA_ExtensionObject *filter) {
+    if(filter->encoding == UA_EXTENSIONOBJECT_ENCODED_NOBODY) {
+        mon->trigger = UA_DATACHANGETRIGGER_STATUSVALUE;
+        mon->deadband = 0.0;
+        return UA_STATUSCODE_GOOD;
+    }
+    if((filter->encoding != UA_EXTENSIONOBJECT_DECODED &&
+        filter->encoding != UA_EXTENSIONOBJECT_DECODED_NODELETE) ||
+       filter->content.decoded.type != &UA_TYPES[UA_TYPES_DATACHANGEFILTER])
+        return UA_STATUSCODE_BADMONITOREDITEMFILTERUNSUPPORTED;
+
+    const UA_DataChangeFilter *dcf = filter->content.decoded.data;
+    if(dcf->trigger > UA_DATACHANGETRIGGER_STATUSVALUETIMESTAMP)
+        return UA_STATUSCODE_BADMONITOREDITEMFILTERINVALID;
+    if(dcf->deadbandType != UA_DEADBANDTYPE_NONE && mon->attributeID != UA_ATTRIBUTEID_VALUE)
+        return UA_STATUSCODE_BADFILTERNOTALLOWED;
+
+    UA_Double deadband = 0.0;
+    switch(dcf->deadbandType) {
+    case UA_DEADBANDTYPE_NONE:
+        break;
+    case UA_DEADBANDTYPE_ABSOLUTE:
+        if(!(dcf->deadbandValue >= 0.0)) /* also catches nan */
+            return UA_STATUSCODE_BADDEADBANDFILTERINVALID;
+        deadband = dcf->deadbandValue;
+        break;
+    case UA_DEADBANDTYPE_PERCENT: {
+        if(!(dcf->deadbandValue >= 0.0 && dcf->deadbandValue <= 100.0))
+            return UA_STATUSCODE_BADDEADBANDFILTERINVALID;
+        UA_Range range;
+        UA_StatusCode retval = getEURange(server, session, &mon->monitoredNodeId, &range);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        deadband = dcf->deadbandValue / 100.0 * (range.high - range.low);
+        break;
+    }
+    default:
+        return UA_STATUSCODE_BADDEADBANDFILTERINVALID;
+    }
+    mon->trigger = dcf->trigger;
+    mon->deadband = deadband;
+    return UA_STATUSCODE_GOOD;
+}
+
 static const UA_String binaryEncoding = {sizeof("Default Binary")-1, (UA_Byte*)"Default Binary"};
 static void
 Service_CreateMonitoredItems_single(UA_Server *server, UA_Session *session, UA_Subscription *sub,
@@ -162,20 +260,41 @@ Service_CreateMonitoredItems_single(UA_Server *server, UA_Session *session, UA_S
         return;
     }
 
+    /* The item and its ring must fit into the memory quota */
+    UA_UInt32 queueSize;
+    UA_BOUNDEDVALUE_SETWBOUNDS(server->config.queueSizeLimits,
+                               request->requestedParameters.queueSize, queueSize);
+    if(UA_Subscription_exceedsMemory(server, sub, sizeof(UA_MonitoredItem) +
+                                     sizeof(MonitoredItem_queuedValue) * queueSize)) {
+        session->memory.discarded++;
+        result->statusCode = UA_STATUSCODE_BADTOOMANYMONITOREDITEMS;
+        return;
+    }
+
     /* Create the monitoreditem */
     UA_MonitoredItem *newMon = UA_MonitoredItem_new();
     if(!newMon) {
         result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
         return;
     }
+    /* The target is set before the item is registered for sampling */
     UA_StatusCode retval = UA_NodeId_copy(&request->itemToMonitor.nodeId, &newMon->monitoredNodeId);
+    retval |= UA_String_copy(&request->itemToMonitor.indexRange, &newMon->indexRange);
     if(retval != UA_STATUSCODE_GOOD) {
         result->statusCode = retval;
+        LIST_INSERT_HEAD(&sub->MonitoredItems, newMon, listEntry);
         MonitoredItem_delete(server, newMon);
         return;
     }
-    newMon->subscription = sub;
     newMon->attributeID = request->itemToMonitor.attributeId;
+    retval = setMonitoredItemFilter(server, session, newMon, &request->requestedParameters.filter);
+    if(retval != UA_STATUSCODE_GOOD) {
+        result->statusCode = retval;
+        LIST_INSERT_HEAD(&sub->MonitoredItems, newMon, listEntry);
+        MonitoredItem_delete(server, newMon);
+        return;
+    }
+    newMon->subscription = sub;
     newMon->itemId = ++(sub->lastMonitoredItemId);
     newMon->timestampsToReturn = timestampsToReturn;
     setMonitoredItemSettings(server, newMon, request->monitoringMode,
@@ -186,7 +305,6 @@ Service_CreateMonitoredItems_single(UA_Server *server, UA_Session *session, UA_S
     LIST_INSERT_HEAD(&sub->MonitoredItems, newMon, listEntry);
 
     /* Prepare the response */
-    UA_String_copy(&request->itemToMonitor.indexRange, &newMon->indexRange);
     result->revisedSamplingInterval = newMon->samplingInterval;
     result->revisedQueueSize = newMon->maxQueueSize;
     result->monitoredItemId = newMon->itemId;
@@ -240,6 +358,10 @@ Service_ModifyMonitoredItems_single(UA_Server *server, UA_Session *session, UA_S
         return;
     }
 
+    result->statusCode = setMonitoredItemFilter(server, session, mon,
+                                                &request->requestedParameters.filter);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        return;
     setMonitoredItemSettings(server, mon, mon->monitoringMode,
                              request->requestedParameters.clientHandle,
                              request->requestedParameters.samplingInterval,
@@ -323,20 +445,26 @@ void
 Service_Publish(UA_Server *server, UA_Session *session,
                 const UA_PublishRequest *request, UA_UInt32 requestId) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing PublishRequest");
-    /* Return an error if the session has no subscription */
-    if(LIST_EMPTY(&session->serverSubscriptions)) {
+    /* Return an error if the session has no subscription or the request
+     * cannot be queued */
+    UA_PublishResponseEntry *entry = NULL;
+    UA_StatusCode retval = UA_STATUSCODE_BADNOSUBSCRIPTION;
+    if(!LIST_EMPTY(&session->serverSubscriptions)) {
+        entry = UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION, sizeof(UA_PublishResponseEntry));
+        retval = UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(!entry) {
         UA_PublishResponse response;
         UA_PublishResponse_init(&response);
         response.responseHeader.requestHandle = request->requestHeader.requestHandle;
-        response.responseHeader.serviceResult = UA_STATUSCODE_BADNOSUBSCRIPTION;
+        response.responseHeader.serviceResult = retval;
         UA_SecureChannel_sendBinaryMessage(session->channel, requestId, &response,
                                            &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
         return;
     }
 
-    // todo error handling for malloc
-    UA_PublishResponseEntry *entry = UA_malloc(sizeof(UA_PublishResponseEntry));
     entry->requestId = requestId;
+    entry->returnDiagnostics = request->requestHeader.returnDiagnostics;
     UA_PublishResponse *response = &entry->response;
     UA_PublishResponse_init(response);
     response->responseHeader.requestHandle = request->requestHeader.requestHandle;
@@ -358,17 +486,7 @@ Service_Publish(UA_Server *server, UA_Session *session,
             continue;
         }
 
-        response->results[i] = UA_STATUSCODE_BADSEQUENCENUMBERUNKNOWN;
-        UA_NotificationMessageEntry *pre, *pre_tmp;
-        LIST_FOREACH_SAFE(pre, &sub->retransmissionQueue, listEntry, pre_tmp) {
-            if(pre->message.sequenceNumber == ack->sequenceNumber) {
-                LIST_REMOVE(pre, listEntry);
-                response->results[i] = UA_STATUSCODE_GOOD;
-                UA_NotificationMessage_deleteMembers(&pre->message);
-                UA_free(pre);
-                break;
-            }
-        }
+        response->results[i] = UA_Subscription_removeRetransmission(sub, ack->sequenceNumber);
     }
 
     /* Queue the publish response */
@@ -376,15 +494,12 @@ Service_Publish(UA_Server *server, UA_Session *session,
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Queued a publication message",
                  session->authenticationToken.identifier.numeric);
 
-    /* Answer immediately to a late subscription */
-    UA_Subscription *immediate;
-    LIST_FOREACH(immediate, &session->serverSubscriptions, listEntry) {
-        if(immediate->state == UA_SUBSCRIPTIONSTATE_LATE) {
-            UA_LOG_DEBUG_SESSION(server->config.logger, session, "Response on a late subscription",
-                                 session->authenticationToken.identifier.numeric);
-            UA_Subscription_publishCallback(server, immediate);
-            return;
-        }
+    /* Answer immediately to the late subscription with the highest priority */
+    UA_Subscription *immediate = UA_Session_getLateSubscription(session);
+    if(immediate) {
+        UA_LOG_DEBUG_SESSION(server->config.logger, session, "Response on a late subscription",
+                             session->authenticationToken.identifier.numeric);
+        UA_Subscription_publishCallback(server, immediate);
     }
 }
 
@@ -440,12 +555,19 @@ void Service_DeleteMonitoredItems(UA_Server *server, UA_Session *session,
 }
 
 void Service_Republish(UA_Server *server, UA_Session *session, const UA_RepublishRequest *request,
-                       UA_RepublishResponse *response) {
+                       UA_UInt32 requestId) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing RepublishRequest");
+    UA_RepublishResponse response;
+    UA_RepublishResponse_init(&response);
+    response.responseHeader.requestHandle = request->requestHeader.requestHandle;
+    response.responseHeader.timestamp = UA_Server_now(server);
+
     /* get the subscription */
     UA_Subscription *sub = UA_Session_getSubscriptionByID(session, request->subscriptionId);
     if (!sub) {
-        response->responseHeader.serviceResult = UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID;
+        response.responseHeader.serviceResult = UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID;
+        UA_SecureChannel_sendBinaryMessage(session->channel, requestId, &response,
+                                           &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE]);
         return;
     }
 
@@ -453,16 +575,94 @@ void Service_Republish(UA_Server *server, UA_Session *session, const UA_Republis
     sub->currentLifetimeCount = 0;
 
     /* Find the notification in the retransmission queue  */
-    UA_NotificationMessageEntry *entry;
-    LIST_FOREACH(entry, &sub->retransmissionQueue, listEntry) {
-        if(entry->message.sequenceNumber == request->retransmitSequenceNumber)
-            break;
-    }
-    if(entry)
-        response->responseHeader.serviceResult =
-            UA_NotificationMessage_copy(&entry->message, &response->notificationMessage);
-    else
-      response->responseHeader.serviceResult = UA_STATUSCODE_BADMESSAGENOTAVAILABLE;
+    UA_NotificationMessageEntry *entry =
+        UA_Subscription_getRetransmission(sub, request->retransmitSequenceNumber);
+    if(!entry) {
+        response.responseHeader.serviceResult = UA_STATUSCODE_BADMESSAGENOTAVAILABLE;
+        UA_SecureChannel_sendBinaryMessage(session->channel, requestId, &response,
+                                           &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE]);
+        return;
+    }
+
+    /* Send the stored encoding of the notification message */
+    UA_MessageContext mc;
+    UA_StatusCode retval = UA_SecureChannel_beginMessage(session->channel, requestId,
+                                                         &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE], &mc);
+    if(retval != UA_STATUSCODE_GOOD)
+        return;
+    retval = UA_SecureChannel_encodeMessage(&mc, &response.responseHeader,
+                                            &UA_TYPES[UA_TYPES_RESPONSEHEADER]);
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = UA_SecureChannel_writeMessageBytes(&mc, &entry->message);
+    UA_SecureChannel_finishMessage(&mc, retval);
+}
+
+static void
+transferSubscription(UA_Server *server, UA_Session *session, UA_UInt32 subscriptionId,
+                     UA_Boolean sendInitialValues, UA_TransferResult *result) {
+    UA_Subscription *sub = UA_SessionManager_getSubscription(&server->sessionManager, subscriptionId);
+    if(!sub) {
+        result->statusCode = UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID;
+        return;
+    }
+
+    /* Only the user of the subscription can take it over */
+    if(sub->session != session && !UA_Session_sameUser(sub->session, session)) {
+        result->statusCode = UA_STATUSCODE_BADUSERACCESSDENIED;
+        return;
+    }
+
+    if(sub->session != session) {
+        if(server->config.maxSessionMemory > 0 &&
+           UA_Session_memoryUsage(session) + sub->memory > server->config.maxSessionMemory) {
+            session->memory.discarded++;
+            result->statusCode = UA_STATUSCODE_BADTOOMANYSUBSCRIPTIONS;
+            return;
+        }
+        UA_LOG_INFO_SESSION(server->config.logger, session, "Subscription %u | "
+                            "Transferred from another session", sub->subscriptionID);
+        UA_Subscription_sendStatusChange(server, sub, UA_STATUSCODE_GOODSUBSCRIPTIONTRANSFERRED);
+        UA_Subscription_moveToSession(sub, session);
+    }
+    sub->currentLifetimeCount = 0;
+
+    /* The client republishes the messages it has missed */
+    if(sub->retransmissionQueueSize > 0) {
+        result->availableSequenceNumbers =
+            UA_Array_new(sub->retransmissionQueueSize, &UA_TYPES[UA_TYPES_UINT32]);
+        if(!result->availableSequenceNumbers) {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        result->availableSequenceNumbersSize = sub->retransmissionQueueSize;
+        size_t i = 0;
+        UA_NotificationMessageEntry *nme;
+        TAILQ_FOREACH(nme, &sub->retransmissionQueue, listEntry)
+            result->availableSequenceNumbers[i++] = nme->sequenceNumber;
+    }
+
+    if(sendInitialValues)
+        UA_Subscription_resendValues(server, sub);
+}
+
+void Service_TransferSubscriptions(UA_Server *server, UA_Session *session,
+                                   const UA_TransferSubscriptionsRequest *request,
+                                   UA_TransferSubscriptionsResponse *response) {
+    UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing TransferSubscriptionsRequest");
+    if(request->subscriptionIdsSize == 0) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
+        return;
+    }
+    response->results = UA_Array_new(request->subscriptionIdsSize,
+                                     &UA_TYPES[UA_TYPES_TRANSFERRESULT]);
+    if(!response->results) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    response->resultsSize = request->subscriptionIdsSize;
+    for(size_t i = 0; i < request->subscriptionIdsSize; i++)
+        transferSubscription(server, session, request->subscriptionIds[i],
+                             request->sendInitialValues, &response->results[i]);
 }
 
 #endif /* UA_ENABLE_SUBSCRIPTIONS */
@@ -18,13 +18,12 @@ fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, UA_ReferenceNode
         retval |= UA_LocalizedText_copy(&curr->displayName, &descr->displayName);
     if(mask & UA_BROWSERESULTMASK_TYPEDEFINITION){
         if(curr->nodeClass == UA_NODECLASS_OBJECT || curr->nodeClass == UA_NODECLASS_VARIABLE) {
-            for(size_t i = 0; i < curr->referencesSize; i++) {
-                UA_ReferenceNode *refnode = &curr->references[i];
-                if(refnode->referenceTypeId.identifier.numeric == UA_NS0ID_HASTYPEDEFINITION) {
-                    retval |= UA_ExpandedNodeId_copy(&refnode->targetId, &descr->typeDefinition);
-                    break;
-                }
-            }
+            const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+            size_t begin, end;
+            UA_Node_findReferences(curr, &hasTypeDef, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+            if(begin < end)
+                retval |= UA_ExpandedNodeId_copy(&curr->references[begin].targetId,
+                                                 &descr->typeDefinition);
         }
     }
     return retval;
@@ -82,38 +81,24 @@ returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription
 #endif
 
 /* Tests if the node is relevant to the browse request and shall be returned. If
-   so, it is retrieved from the Nodestore. If not, null is returned. */
+   so, it is retrieved from the Nodestore. If not, null is returned. The
+   reference type was already matched with the reference index of the node. */
 static const UA_Node *
-returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Boolean return_all,
-                   const UA_ReferenceNode *reference, const UA_NodeId *relevant, size_t relevant_count,
-                   UA_Boolean *isExternal) {
+returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr,
+                   const UA_ReferenceNode *reference, UA_Boolean *isExternal) {
     /* reference in the right direction? */
     if(reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_FORWARD)
         return NULL;
     if(!reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_INVERSE)
         return NULL;
 
-    /* is the reference part of the hierarchy of references we look for? */
-    if(!return_all) {
-        UA_Boolean is_relevant = false;
-        for(size_t i = 0; i < relevant_count; i++) {
-            if(UA_NodeId_equal(&reference->referenceTypeId, &relevant[i])) {
-                is_relevant = true;
-                break;
-            }
-        }
-        if(!is_relevant)
-            return NULL;
-    }
-
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     /* return the node from an external namespace*/
-    for(size_t nsIndex = 0; nsIndex < server->externalNamespacesSize; nsIndex++) {
-        if(reference->targetId.nodeId.namespaceIndex != server->externalNamespaces[nsIndex].index)
-            continue;
+    UA_ExternalNamespace *ens =
+        UA_Server_getExternalNamespace(server, reference->targetId.nodeId.namespaceIndex);
+    if(ens) {
         *isExternal = true;
-        return returnRelevantNodeExternal(&server->externalNamespaces[nsIndex].externalNodeStore,
-                                          descr, reference);
+        return returnRelevantNodeExternal(&ens->externalNodeStore, descr, reference);
     }
 #endif
 
@@ -125,76 +110,307 @@ returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Bool
     return node;
 }
 
-/**
- * We find all subtypes by a single iteration over the array. We start with an array with a single
- * root nodeid at the beginning. When we find relevant references, we add the nodeids to the back of
- * the array and increase the size. Since the hierarchy is not cyclic, we can safely progress in the
- * array to process the newly found referencetype nodeids (emulated recursion).
- */
-static UA_StatusCode
-findSubTypes(UA_NodeStore *ns, const UA_NodeId *root, UA_NodeId **reftypes, size_t *reftypes_count) {
-    const UA_Node *node = UA_NodeStore_get(ns, root);
-    if(!node)
-        return UA_STATUSCODE_BADNOMATCH;
-    if(node->nodeClass != UA_NODECLASS_REFERENCETYPE)
-        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+static int compareNodeIds(const void *a, const void *b) {
+    return UA_NodeId_order((const UA_NodeId*)a, (const UA_NodeId*)b);
+}
 
-    size_t results_size = 20; // probably too big, but saves mallocs
-    UA_NodeId *results = UA_malloc(sizeof(UA_NodeId) * results_size);
-    if(!results)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
+/************************/
+/* Reference Type Index */
+/************************/
 
-    UA_StatusCode retval = UA_NodeId_copy(root, &results[0]);
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_free(results);
-        return retval;
+void UA_ReferenceTypeIndex_delete(UA_ReferenceTypeIndex *rti) {
+    if(!rti)
+        return;
+    UA_Array_delete(rti->types, rti->typesSize, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_free(rti->closure);
+    UA_free(rti);
+}
+
+size_t
+UA_ReferenceTypeIndex_find(const UA_ReferenceTypeIndex *rti, const UA_NodeId *referenceTypeId) {
+    size_t lower = 0;
+    size_t upper = rti->typesSize;
+    while(lower < upper) {
+        size_t mid = lower + ((upper - lower) / 2);
+        UA_Int32 order = UA_NodeId_order(&rti->types[mid], referenceTypeId);
+        if(order == 0)
+            return mid;
+        if(order < 0)
+            lower = mid + 1;
+        else
+            upper = mid;
     }
-        
-    size_t idx = 0; // where are we currently in the array?
-    size_t last = 0; // where is the last element in the array?
-    do {
-        node = UA_NodeStore_get(ns, &results[idx]);
-        if(!node || node->nodeClass != UA_NODECLASS_REFERENCETYPE)
-            continue;
-        for(size_t i = 0; i < node->referencesSize; i++) {
-            if(node->references[i].referenceTypeId.identifier.numeric != UA_NS0ID_HASSUBTYPE ||
-               node->references[i].isInverse == true)
-                continue;
+    return rti->typesSize;
+}
 
-            if(++last >= results_size) { // is the array big enough?
-                UA_NodeId *new_results = UA_realloc(results, sizeof(UA_NodeId) * results_size * 2);
-                if(!new_results) {
-                    retval = UA_STATUSCODE_BADOUTOFMEMORY;
-                    break;
-                }
-                results = new_results;
-                results_size *= 2;
-            }
+typedef struct {
+    UA_NodeId *types;
+    size_t typesSize;
+    size_t typesCapacity;
+    UA_StatusCode retval;
+} ReferenceTypeCollector;
 
-            retval = UA_NodeId_copy(&node->references[i].targetId.nodeId, &results[last]);
-            if(retval != UA_STATUSCODE_GOOD) {
-                last--; // for array_delete
-                break;
+static void collectReferenceType(void *handle, const UA_Node *node) {
+    ReferenceTypeCollector *c = handle;
+    if(node->nodeClass != UA_NODECLASS_REFERENCETYPE || c->retval != UA_STATUSCODE_GOOD)
+        return;
+    if(c->typesSize >= c->typesCapacity) {
+        size_t capacity = c->typesCapacity > 0 ? c->typesCapacity * 2 : 64;
+        UA_NodeId *types = UA_realloc(c->types, sizeof(UA_NodeId) * capacity);
+        if(!types) {
+            c->retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            return;
+        }
+        c->types = types;
+        c->typesCapacity = capacity;
+    }
+    c->retval = UA_NodeId_copy(&node->nodeId, &c->types[c->typesSize]);
+    if(c->retval == UA_STATUSCODE_GOOD)
+        c->typesSize++;
+}
+
+static UA_ReferenceTypeIndex *
+buildReferenceTypeIndex(UA_NodeStore *ns) {
+    ReferenceTypeCollector c = {NULL, 0, 0, UA_STATUSCODE_GOOD};
+    UA_NodeStore_iterate(ns, collectReferenceType, &c);
+    UA_ReferenceTypeIndex *rti = UA_malloc(sizeof(UA_ReferenceTypeIndex));
+    if(!rti || c.retval != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(c.types, c.typesSize, &UA_TYPES[UA_TYPES_NODEID]);
+        UA_free(rti);
+        return NULL;
+    }
+    qsort(c.types, c.typesSize, sizeof(UA_NodeId), compareNodeIds);
+    rti->types = c.types;
+    rti->typesSize = c.typesSize;
+    rti->rowSize = (c.typesSize + 31) / 32;
+    rti->closure = UA_calloc(rti->typesSize * rti->rowSize + 1, sizeof(UA_UInt32));
+    if(!rti->closure) {
+        UA_ReferenceTypeIndex_delete(rti);
+        return NULL;
+    }
+
+    /* Every type is a subtype of itself */
+    for(size_t i = 0; i < rti->typesSize; i++)
+        rti->closure[(i * rti->rowSize) + (i / 32)] |= (UA_UInt32)1 << (i % 32);
+
+    /* Merge the rows of the direct subtypes into the row of the supertype
+       until nothing changes. The number of rounds is bounded by the depth of
+       the hierarchy. */
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    UA_Boolean changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t i = 0; i < rti->typesSize; i++) {
+            const UA_Node *node = UA_NodeStore_get(ns, &rti->types[i]);
+            if(!node)
+                continue;
+            UA_UInt32 *row = &rti->closure[i * rti->rowSize];
+            size_t begin, end;
+            UA_Node_findReferences(node, &hasSubtype, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+            for(size_t j = begin; j < end; j++) {
+                size_t sub = UA_ReferenceTypeIndex_find(rti, &node->references[j].targetId.nodeId);
+                if(sub == rti->typesSize || sub == i)
+                    continue;
+                const UA_UInt32 *subrow = &rti->closure[sub * rti->rowSize];
+                for(size_t k = 0; k < rti->rowSize; k++) {
+                    if((row[k] | subrow[k]) == row[k])
+                        continue;
+                    row[k] |= subrow[k];
+                    changed = true;
+                }
             }
         }
-    } while(++idx <= last && retval == UA_STATUSCODE_GOOD);
+    }
+    return rti;
+}
 
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_Array_delete(results, last, &UA_TYPES[UA_TYPES_NODEID]);
-        return retval;
+#ifdef UA_ENABLE_MULTITHREADING
+static void deleteReferenceTypeIndex(UA_Server *server, void *rti) {
+    UA_ReferenceTypeIndex_delete(rti);
+}
+#endif
+
+const UA_ReferenceTypeIndex *
+UA_Server_getReferenceTypeIndex(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    if(!server->referenceTypeIndex)
+        server->referenceTypeIndex = buildReferenceTypeIndex(server->nodestore);
+    return server->referenceTypeIndex;
+#else
+    UA_ReferenceTypeIndex *rti = uatomic_read(&server->referenceTypeIndex);
+    if(rti)
+        return rti;
+    UA_UInt32 version = uatomic_read(&server->referenceTypeIndexVersion);
+    cmm_smp_mb();
+    rti = buildReferenceTypeIndex(server->nodestore);
+    if(!rti)
+        return NULL;
+    UA_ReferenceTypeIndex *other = uatomic_cmpxchg(&server->referenceTypeIndex, NULL, rti);
+    if(other) {
+        UA_ReferenceTypeIndex_delete(rti);
+        return other;
     }
+    /* The hierarchy was changed during the build. The index is used by the
+       caller but not kept for others. */
+    if(uatomic_read(&server->referenceTypeIndexVersion) != version &&
+       uatomic_cmpxchg(&server->referenceTypeIndex, rti, NULL) == rti)
+        UA_Server_delayedCallback(server, deleteReferenceTypeIndex, rti);
+    return rti;
+#endif
+}
 
-    *reftypes = results;
-    *reftypes_count = last + 1;
-    return UA_STATUSCODE_GOOD;
+void UA_Server_invalidateReferenceTypeIndex(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_ReferenceTypeIndex_delete(server->referenceTypeIndex);
+    server->referenceTypeIndex = NULL;
+#else
+    uatomic_inc(&server->referenceTypeIndexVersion);
+    UA_ReferenceTypeIndex *rti = uatomic_xchg(&server->referenceTypeIndex, NULL);
+    if(rti)
+        UA_Server_delayedCallback(server, deleteReferenceTypeIndex, rti);
+#endif
+}
+
+/* Selects the references of a node with a matching reference type */
+typedef struct {
+    const UA_NodeId *referenceTypeId; /* NULL for all references */
+    const UA_ReferenceTypeIndex *rti; /* set if the subtypes are included */
+    size_t rootType; /* dense index of the reference type in rti */
+    UA_BrowseDirection direction;
+    size_t next; /* where to continue in the references of the node */
+} ReferenceFilter;
+
+static UA_StatusCode
+initReferenceFilter(UA_Server *server, const UA_NodeId *referenceTypeId, UA_Boolean includeSubtypes,
+                    UA_BrowseDirection direction, ReferenceFilter *filter) {
+    memset(filter, 0, sizeof(ReferenceFilter));
+    filter->direction = direction;
+    if(UA_NodeId_isNull(referenceTypeId))
+        return UA_STATUSCODE_GOOD;
+    filter->referenceTypeId = referenceTypeId;
+    if(!includeSubtypes)
+        return UA_STATUSCODE_GOOD;
+    filter->rti = UA_Server_getReferenceTypeIndex(server);
+    if(!filter->rti)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    filter->rootType = UA_ReferenceTypeIndex_find(filter->rti, referenceTypeId);
+    if(filter->rootType < filter->rti->typesSize)
+        return UA_STATUSCODE_GOOD;
+    if(!UA_NodeStore_get(server->nodestore, referenceTypeId))
+        return UA_STATUSCODE_BADNOMATCH;
+    return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+}
+
+/* Returns in [*begin, *end) the next range of matching references. The
+ * references are grouped by their type. With subtypes, the type of every group
+ * is tested with a single lookup in the closure. Returns false if the
+ * references of the node are exhausted. */
+static UA_Boolean
+nextReferences(const UA_Node *node, ReferenceFilter *filter, size_t *begin, size_t *end) {
+    if(filter->next >= node->referencesSize)
+        return false;
+    if(!filter->referenceTypeId) {
+        *begin = 0;
+        *end = node->referencesSize;
+        filter->next = node->referencesSize;
+        return true;
+    }
+    if(!filter->rti) {
+        UA_Node_findReferences(node, filter->referenceTypeId, filter->direction, begin, end);
+        filter->next = node->referencesSize;
+        return *begin < *end;
+    }
+    while(filter->next < node->referencesSize) {
+        const UA_NodeId *type = &node->references[filter->next].referenceTypeId;
+        size_t t = UA_ReferenceTypeIndex_find(filter->rti, type);
+        do {
+            filter->next++;
+        } while(filter->next < node->referencesSize &&
+                UA_NodeId_equal(&node->references[filter->next].referenceTypeId, type));
+        if(t == filter->rti->typesSize ||
+           !UA_ReferenceTypeIndex_isSubtype(filter->rti, t, filter->rootType))
+            continue;
+        UA_Node_findReferences(node, type, filter->direction, begin, end);
+        if(*begin < *end)
+            return true;
+    }
+    return false;
+}
+
+/* The strings of the BrowseDescription are not counted */
+#define CONTINUATIONPOINT_MEMORY (sizeof(struct ContinuationPointEntry) + sizeof(UA_Guid))
+
+/* Returns a free slot for a new continuation point or
+ * continuationPointSlotsSize if there is none. Without a limit, the slots grow
+ * on demand. */
+static UA_UInt32 freeCpSlot(UA_Session *session) {
+    if(session->maxContinuationPoints > 0) {
+        if(session->availableContinuationPoints == 0)
+            return session->continuationPointSlotsSize;
+        if(!session->continuationPointSlots) {
+            /* No continuation point was taken so far */
+            session->continuationPointSlots =
+                UA_calloc(session->maxContinuationPoints, sizeof(struct ContinuationPointEntry*));
+            if(!session->continuationPointSlots)
+                return 0;
+            session->continuationPointSlotsSize = session->maxContinuationPoints;
+        }
+    }
+    UA_UInt32 slot = 0;
+    while(slot < session->continuationPointSlotsSize && session->continuationPointSlots[slot])
+        slot++;
+    if(slot < session->continuationPointSlotsSize || session->maxContinuationPoints > 0)
+        return slot;
+
+    /* Double the slots */
+    UA_UInt32 newSize = session->continuationPointSlotsSize * 2;
+    if(newSize < MAXCONTINUATIONPOINTS)
+        newSize = MAXCONTINUATIONPOINTS;
+    if(newSize <= session->continuationPointSlotsSize)
+        return session->continuationPointSlotsSize;
+    struct ContinuationPointEntry **slots =
+        UA_realloc(session->continuationPointSlots, newSize * sizeof(struct ContinuationPointEntry*));
+    if(!slots)
+        return session->continuationPointSlotsSize;
+    memset(&slots[slot], 0, (newSize - slot) * sizeof(struct ContinuationPointEntry*));
+    session->continuationPointSlots = slots;
+    session->continuationPointSlotsSize = newSize;
+    return slot;
+}
+
+/* The slot is in the first four bytes of the identifier */
+static struct ContinuationPointEntry *
+findCp(UA_Session *session, const UA_ByteString *identifier) {
+    if(identifier->length != sizeof(UA_Guid))
+        return NULL;
+    UA_Guid id;
+    memcpy(&id, identifier->data, sizeof(UA_Guid));
+    if(id.data1 >= session->continuationPointSlotsSize)
+        return NULL;
+    struct ContinuationPointEntry *cp = session->continuationPointSlots[id.data1];
+    if(!cp || !UA_ByteString_equal(&cp->identifier, identifier))
+        return NULL;
+    return cp;
 }
 
 static void removeCp(struct ContinuationPointEntry *cp, UA_Session* session) {
     LIST_REMOVE(cp, pointers);
+    session->continuationPointSlots[cp->slot] = NULL;
     UA_ByteString_deleteMembers(&cp->identifier);
     UA_BrowseDescription_deleteMembers(&cp->browseDescription);
     UA_free(cp);
-    session->availableContinuationPoints++;
+    if(session->maxContinuationPoints > 0)
+        session->availableContinuationPoints++;
+    session->memory.continuationPoints -= CONTINUATIONPOINT_MEMORY;
+}
+
+static void
+storeCpPosition(struct ContinuationPointEntry *cp, const UA_Node *node, const ReferenceFilter *filter,
+                size_t referencesIndex, size_t referencesEnd) {
+    cp->referencesVersion = node->referencesVersion;
+    cp->filterNext = filter->next;
+    cp->referencesIndex = referencesIndex;
+    cp->referencesEnd = referencesEnd;
 }
 
 /**
@@ -229,23 +445,16 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
     }
     
     /* get the references that match the browsedescription */
-    size_t relevant_refs_size = 0;
-    UA_NodeId *relevant_refs = NULL;
-    UA_Boolean all_refs = UA_NodeId_isNull(&descr->referenceTypeId);
-    if(!all_refs) {
-        if(descr->includeSubtypes) {
-            result->statusCode = findSubTypes(server->nodestore, &descr->referenceTypeId,
-                                              &relevant_refs, &relevant_refs_size);
-            if(result->statusCode != UA_STATUSCODE_GOOD)
-                return;
-        } else {
-            const UA_Node *rootRef = UA_NodeStore_get(server->nodestore, &descr->referenceTypeId);
-            if(!rootRef || rootRef->nodeClass != UA_NODECLASS_REFERENCETYPE) {
-                result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-                return;
-            }
-            relevant_refs = (UA_NodeId*)(uintptr_t)&descr->referenceTypeId;
-            relevant_refs_size = 1;
+    ReferenceFilter filter;
+    result->statusCode = initReferenceFilter(server, &descr->referenceTypeId, descr->includeSubtypes,
+                                             descr->browseDirection, &filter);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        return;
+    if(filter.referenceTypeId && !filter.rti) {
+        const UA_Node *rootRef = UA_NodeStore_get(server->nodestore, &descr->referenceTypeId);
+        if(!rootRef || rootRef->nodeClass != UA_NODECLASS_REFERENCETYPE) {
+            result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+            return;
         }
     }
 
@@ -253,19 +462,29 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
     const UA_Node *node = UA_NodeStore_get(server->nodestore, &descr->nodeId);
     if(!node) {
         result->statusCode = UA_STATUSCODE_BADNODEIDUNKNOWN;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
+#ifdef UA_ENABLE_NODE_STATISTICS
+    UA_Server_countNodeAccess(server, &descr->nodeId, UA_NODEACCESS_BROWSE);
+#endif
 
     /* if the node has no references, just return */
     if(node->referencesSize == 0) {
         result->referencesSize = 0;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
+    /* the range of references of the current reference type */
+    size_t referencesEnd = 0;
+
+    /* resume from the stored position if the references were not changed */
+    if(cp && cp->referencesVersion == node->referencesVersion) {
+        filter.next = cp->filterNext;
+        referencesIndex = cp->referencesIndex;
+        referencesEnd = cp->referencesEnd;
+        continuationIndex = 0;
+    }
+
     /* how many references can we return at most? */
     size_t real_maxrefs = maxrefs;
     if(real_maxrefs == 0)
@@ -277,25 +496,30 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
     result->references = UA_Array_new(real_maxrefs, &UA_TYPES[UA_TYPES_REFERENCEDESCRIPTION]);
     if(!result->references) {
         result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
-        goto cleanup;
+        return;
     }
 
-    /* loop over the node's references */
+    /* loop over the node's references. the references of every relevant type
+       are found in the index of the node. */
     size_t skipped = 0;
     UA_Boolean isExternal = false;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(; referencesIndex < node->referencesSize && referencesCount < real_maxrefs; referencesIndex++) {
+    while(referencesCount < real_maxrefs) {
+        if(referencesIndex >= referencesEnd) {
+            if(!nextReferences(node, &filter, &referencesIndex, &referencesEnd))
+                break;
+            continue;
+        }
         isExternal = false;
-        const UA_Node *current =
-            returnRelevantNode(server, descr, all_refs, &node->references[referencesIndex],
-                               relevant_refs, relevant_refs_size, &isExternal);
+        UA_ReferenceNode *ref = &node->references[referencesIndex++];
+        const UA_Node *current = returnRelevantNode(server, descr, ref, &isExternal);
         if(!current)
             continue;
 
         if(skipped < continuationIndex) {
             skipped++;
         } else {
-            retval |= fillReferenceDescription(server->nodestore, current, &node->references[referencesIndex],
+            retval |= fillReferenceDescription(server->nodestore, current, ref,
                                                descr->resultMask, &result->references[referencesCount]);
             referencesCount++;
         }
@@ -312,43 +536,90 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
         result->references = NULL;
         result->referencesSize = 0;
         result->statusCode = retval;
-    }
-
-    cleanup:
-    if(!all_refs && descr->includeSubtypes)
-        UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
-    if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
+    }
 
     /* create, update, delete continuation points */
     if(cp) {
-        if(referencesIndex == node->referencesSize) {
+        if(referencesIndex >= referencesEnd &&
+           !nextReferences(node, &filter, &referencesIndex, &referencesEnd)) {
             /* all done, remove a finished continuationPoint */
             removeCp(cp, session);
         } else {
             /* update the cp and return the cp identifier */
             cp->continuationIndex += (UA_UInt32)referencesCount;
+            storeCpPosition(cp, node, &filter, referencesIndex, referencesEnd);
             UA_ByteString_copy(&cp->identifier, &result->continuationPoint);
         }
     } else if(maxrefs != 0 && referencesCount >= maxrefs) {
         /* create a cp */
-        if(session->availableContinuationPoints <= 0 ||
-           !(cp = UA_malloc(sizeof(struct ContinuationPointEntry)))) {
+        UA_UInt32 slot = freeCpSlot(session);
+        UA_Guid *ident = NULL;
+        if(server->config.maxSessionMemory > 0 &&
+           UA_Session_memoryUsage(session) + CONTINUATIONPOINT_MEMORY > server->config.maxSessionMemory) {
+            session->memory.discarded++;
+            slot = session->continuationPointSlotsSize;
+        }
+        if(slot >= session->continuationPointSlotsSize ||
+           !(cp = UA_malloc(sizeof(struct ContinuationPointEntry))) ||
+           !(ident = UA_Guid_new())) {
+            UA_free(cp);
             result->statusCode = UA_STATUSCODE_BADNOCONTINUATIONPOINTS;
             return;
         }
         UA_BrowseDescription_copy(descr, &cp->browseDescription);
         cp->maxReferences = maxrefs;
         cp->continuationIndex = (UA_UInt32)referencesCount;
-        UA_Guid *ident = UA_Guid_new();
+        storeCpPosition(cp, node, &filter, referencesIndex, referencesEnd);
         *ident = UA_Guid_random();
+        ident->data1 = slot;
+        cp->slot = slot;
         cp->identifier.data = (UA_Byte*)ident;
         cp->identifier.length = sizeof(UA_Guid);
         UA_ByteString_copy(&cp->identifier, &result->continuationPoint);
 
         /* store the cp */
         LIST_INSERT_HEAD(&session->continuationPoints, cp, pointers);
-        session->availableContinuationPoints--;
+        session->continuationPointSlots[slot] = cp;
+        if(session->maxContinuationPoints > 0)
+            session->availableContinuationPoints--;
+        session->memory.continuationPoints += CONTINUATIONPOINT_MEMORY;
+    }
+}
+
+typedef struct {
+    UA_Server *server;
+    UA_Session *session;
+    const UA_BrowseRequest *request;
+    UA_BrowseResponse *response;
+    const UA_Boolean *isExternal; /* NULL if all nodes are local */
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    const UA_ExternalRouting *routing;
+    size_t localParts; /* the parts after them call the external nodestores */
+#endif
+} BrowseParts;
+
+static void browsePart(void *handle, size_t part) {
+    const BrowseParts *bp = (const BrowseParts*)handle;
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    if(part >= bp->localParts) {
+        const UA_ExternalRoute *route = &bp->routing->routes[part - bp->localParts];
+        route->ens->browseNodes(route->ens->ensHandle, &bp->request->requestHeader,
+                                bp->request->nodesToBrowse, route->indices, route->indicesSize,
+                                bp->request->requestedMaxReferencesPerNode,
+                                bp->response->results, bp->response->diagnosticInfos);
+        return;
+    }
+#endif
+    size_t i = part * UA_SERVER_PARALLEL_PARTSIZE;
+    size_t end = i + UA_SERVER_PARALLEL_PARTSIZE;
+    if(end > bp->request->nodesToBrowseSize)
+        end = bp->request->nodesToBrowseSize;
+    for(; i < end; i++) {
+        if(bp->isExternal && bp->isExternal[i])
+            continue;
+        Service_Browse_single(bp->server, bp->session, NULL, &bp->request->nodesToBrowse[i],
+                              bp->request->requestedMaxReferencesPerNode, &bp->response->results[i]);
     }
 }
 
@@ -373,57 +644,50 @@ void Service_Browse(UA_Server *server, UA_Session *session, const UA_BrowseReque
     }
     response->resultsSize = size;
 
+    /* Large requests are processed in parallel. Continuation points are
+       added to the session. So only requests without a limit of the
+       references per node can be split. The external nodestores are called
+       once per namespace. */
+    BrowseParts bp = {.server = server, .session = session, .request = request,
+                      .response = response, .isExternal = NULL};
+    size_t parts = (size + UA_SERVER_PARALLEL_PARTSIZE - 1) / UA_SERVER_PARALLEL_PARTSIZE;
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-#ifdef NO_ALLOCA
-    UA_Boolean isExternal[size];
-    UA_UInt32 indices[size];
-#else
-    UA_Boolean *isExternal = UA_alloca(sizeof(UA_Boolean) * size);
-    UA_UInt32 *indices = UA_alloca(sizeof(UA_UInt32) * size);
-#endif /*NO_ALLOCA */
-    memset(isExternal, false, sizeof(UA_Boolean) * size);
-    for(size_t j = 0; j < server->externalNamespacesSize; j++) {
-        size_t indexSize = 0;
-        for(size_t i = 0; i < size; i++) {
-            if(request->nodesToBrowse[i].nodeId.namespaceIndex != server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indexSize] = (UA_UInt32)i;
-            indexSize++;
-        }
-        if(indexSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->browseNodes(ens->ensHandle, &request->requestHeader, request->nodesToBrowse, indices,
-                         (UA_UInt32)indexSize, request->requestedMaxReferencesPerNode,
-                         response->results, response->diagnosticInfos);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->nodesToBrowse, size,
+                               sizeof(UA_BrowseDescription), offsetof(UA_BrowseDescription, nodeId))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
     }
+    bp.isExternal = routing.isExternal;
+    bp.routing = &routing;
+    bp.localParts = parts;
+    parts += routing.routesSize;
 #endif
-
-    for(size_t i = 0; i < size; i++) {
+    if(request->requestedMaxReferencesPerNode == 0) {
+        UA_Server_runParallel(server, browsePart, &bp, parts);
+    } else {
+        for(size_t p = 0; p < parts; p++)
+            browsePart(&bp, p);
+    }
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+    UA_ExternalRouting_deleteMembers(&routing);
 #endif
-            Service_Browse_single(server, session, NULL, &request->nodesToBrowse[i],
-                                  request->requestedMaxReferencesPerNode, &response->results[i]);
-    }
 }
 
 void
 UA_Server_browseNext_single(UA_Server *server, UA_Session *session, UA_Boolean releaseContinuationPoint,
                             const UA_ByteString *continuationPoint, UA_BrowseResult *result) {
-    result->statusCode = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
-    struct ContinuationPointEntry *cp, *temp;
-    LIST_FOREACH_SAFE(cp, &session->continuationPoints, pointers, temp) {
-        if(UA_ByteString_equal(&cp->identifier, continuationPoint)) {
-            result->statusCode = UA_STATUSCODE_GOOD;
-            if(!releaseContinuationPoint)
-                Service_Browse_single(server, session, cp, NULL, 0, result);
-            else
-                removeCp(cp, session);
-            break;
-        }
+    struct ContinuationPointEntry *cp = findCp(session, continuationPoint);
+    if(!cp) {
+        result->statusCode = UA_STATUSCODE_BADCONTINUATIONPOINTINVALID;
+        return;
     }
+    result->statusCode = UA_STATUSCODE_GOOD;
+    if(!releaseContinuationPoint)
+        Service_Browse_single(server, session, cp, NULL, 0, result);
+    else
+        removeCp(cp, session);
 }
 
 void Service_BrowseNext(UA_Server *server, UA_Session *session, const UA_BrowseNextRequest *request,
@@ -450,37 +714,191 @@ void Service_BrowseNext(UA_Server *server, UA_Session *session, const UA_BrowseN
 /* TranslateBrowsePath */
 /***********************/
 
+void UA_Server_invalidateBrowseNameIndices(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    server->browseNameVersion++;
+#else
+    uatomic_inc(&server->browseNameVersion);
+#endif
+}
+
+static int compareBrowseNameIndexEntries(const void *a, const void *b) {
+    const UA_BrowseNameIndexEntry *ea = (const UA_BrowseNameIndexEntry*)a;
+    const UA_BrowseNameIndexEntry *eb = (const UA_BrowseNameIndexEntry*)b;
+    if(ea->hash != eb->hash)
+        return (ea->hash > eb->hash) - (ea->hash < eb->hash);
+    return (ea->reference > eb->reference) - (ea->reference < eb->reference);
+}
+
+static UA_BrowseNameIndex *
+buildBrowseNameIndex(UA_NodeStore *ns, const UA_Node *node, UA_UInt32 version) {
+    UA_BrowseNameIndex *index = UA_malloc(sizeof(UA_BrowseNameIndex) +
+                                          (sizeof(UA_BrowseNameIndexEntry) * node->referencesSize));
+    if(!index)
+        return NULL;
+    index->version = version;
+    index->entriesSize = node->referencesSize;
+    index->entries = (UA_BrowseNameIndexEntry*)&index[1];
+    for(size_t i = 0; i < node->referencesSize; i++) {
+        const UA_Node *target = UA_NodeStore_get(ns, &node->references[i].targetId.nodeId);
+        index->entries[i].hash = target ? UA_QualifiedName_hash(&target->browseName) :
+            UA_BROWSENAMEINDEX_UNRESOLVED;
+        index->entries[i].reference = (UA_UInt32)i;
+    }
+    qsort(index->entries, index->entriesSize, sizeof(UA_BrowseNameIndexEntry),
+          compareBrowseNameIndexEntries);
+    return index;
+}
+
+/* Returns the browse name index of the node and builds it if required. Returns
+ * NULL if the node shall be scanned instead. */
+static const UA_BrowseNameIndex *
+getBrowseNameIndex(UA_Server *server, const UA_Node *node) {
+    if(node->referencesSize < UA_BROWSENAMEINDEX_MINREFERENCES)
+        return NULL;
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_UInt32 version = server->browseNameVersion;
+    UA_BrowseNameIndex *index = node->browseNameIndex;
+#else
+    UA_UInt32 version = uatomic_read(&server->browseNameVersion);
+    UA_BrowseNameIndex *index = uatomic_read(&node->browseNameIndex);
+#endif
+    if(index && index->version == version)
+        return index;
+
+    /* Static nodes are read-only */
+    if(UA_NodeStore_isStatic(server->nodestore, node))
+        return NULL;
+    UA_BrowseNameIndex *newIndex = buildBrowseNameIndex(server->nodestore, node, version);
+    if(!newIndex)
+        return NULL;
+
+    /* The index is a cache. So it is set in the node that is otherwise
+       immutable. */
+    UA_BrowseNameIndex **field = &((UA_Node*)(uintptr_t)node)->browseNameIndex;
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_free(index);
+    *field = newIndex;
+#else
+    if(uatomic_cmpxchg(field, index, newIndex) != index) {
+        /* Another thread was faster */
+        UA_free(newIndex);
+        return NULL;
+    }
+    if(index)
+        UA_Server_delayedFree(server, index);
+#endif
+    return newIndex;
+}
+
+static UA_Boolean
+referenceMatches(const ReferenceFilter *filter, const UA_ReferenceNode *ref) {
+    if(!filter->referenceTypeId)
+        return true;
+    if(ref->isInverse && filter->direction == UA_BROWSEDIRECTION_FORWARD)
+        return false;
+    if(!ref->isInverse && filter->direction == UA_BROWSEDIRECTION_INVERSE)
+        return false;
+    if(!filter->rti)
+        return UA_NodeId_equal(&ref->referenceTypeId, filter->referenceTypeId);
+    size_t t = UA_ReferenceTypeIndex_find(filter->rti, &ref->referenceTypeId);
+    return t < filter->rti->typesSize &&
+        UA_ReferenceTypeIndex_isSubtype(filter->rti, t, filter->rootType);
+}
+
 static UA_StatusCode
 walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, const UA_RelativePath *path,
                size_t pathindex, UA_BrowsePathTarget **targets, size_t *targets_size,
-               size_t *target_count) {
-    const UA_RelativePathElement *elem = &path->elements[pathindex];
-    UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    UA_NodeId *reftypes = NULL;
-    size_t reftypes_count = 1; // all_refs or no subtypes => 1
-    UA_Boolean all_refs = false;
-    if(UA_NodeId_isNull(&elem->referenceTypeId)) {
-        all_refs = true;
-    } else if(!elem->includeSubtypes) {
-        reftypes = (UA_NodeId*)(uintptr_t)&elem->referenceTypeId; // ptr magic due to const cast
-    } else {
-        retval = findSubTypes(server->nodestore, &elem->referenceTypeId, &reftypes, &reftypes_count);
-        if(retval != UA_STATUSCODE_GOOD)
-            return retval;
+               size_t *target_count);
+
+/* Continues the walk at a target with a matching browse name */
+static UA_StatusCode
+walkBrowsePathTarget(UA_Server *server, UA_Session *session, const UA_Node *next,
+                     const UA_RelativePath *path, size_t pathindex, UA_BrowsePathTarget **targets,
+                     size_t *targets_size, size_t *target_count) {
+    // recursion if the path is longer
+    if(pathindex + 1 < path->elementsSize)
+        return walkBrowsePath(server, session, next, path, pathindex + 1,
+                              targets, targets_size, target_count);
+
+    // add the browsetarget
+    if(*target_count >= *targets_size) {
+        UA_BrowsePathTarget *newtargets;
+        newtargets = UA_realloc(*targets, sizeof(UA_BrowsePathTarget) * (*targets_size) * 2);
+        if(!newtargets)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        *targets = newtargets;
+        *targets_size *= 2;
     }
 
-    for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; i++) {
-        UA_Boolean match = all_refs;
-        for(size_t j = 0; j < reftypes_count && !match; j++) {
-            if(node->references[i].isInverse == elem->isInverse &&
-               UA_NodeId_equal(&node->references[i].referenceTypeId, &reftypes[j]))
-                match = true;
+    UA_BrowsePathTarget *res = *targets;
+    UA_ExpandedNodeId_init(&res[*target_count].targetId);
+    UA_StatusCode retval = UA_NodeId_copy(&next->nodeId, &res[*target_count].targetId.nodeId);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    res[*target_count].remainingPathIndex = UA_UINT32_MAX;
+    *target_count += 1;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Visits the references in the index with the hash of the browse name and
+ * those whose target was not found when the index was built */
+static UA_StatusCode
+walkBrowseNameIndex(UA_Server *server, UA_Session *session, const UA_Node *node,
+                    const UA_BrowseNameIndex *index, const ReferenceFilter *filter,
+                    const UA_RelativePath *path, size_t pathindex, UA_BrowsePathTarget **targets,
+                    size_t *targets_size, size_t *target_count) {
+    const UA_QualifiedName *targetName = &path->elements[pathindex].targetName;
+    const UA_UInt32 hashes[2] = {UA_QualifiedName_hash(targetName), UA_BROWSENAMEINDEX_UNRESOLVED};
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t h = 0; h < 2 && retval == UA_STATUSCODE_GOOD; h++) {
+        for(size_t k = UA_BrowseNameIndex_find(index, hashes[h]);
+            k < index->entriesSize && index->entries[k].hash == hashes[h] &&
+                retval == UA_STATUSCODE_GOOD; k++) {
+            const UA_ReferenceNode *ref = &node->references[index->entries[k].reference];
+            if(!referenceMatches(filter, ref))
+                continue;
+            const UA_Node *next = UA_NodeStore_get(server->nodestore, &ref->targetId.nodeId);
+            if(!next || targetName->namespaceIndex != next->browseName.namespaceIndex ||
+               !UA_String_equal(&targetName->name, &next->browseName.name))
+                continue;
+            retval = walkBrowsePathTarget(server, session, next, path, pathindex,
+                                          targets, targets_size, target_count);
         }
-        if(!match)
+    }
+    return retval;
+}
+
+static UA_StatusCode
+walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, const UA_RelativePath *path,
+               size_t pathindex, UA_BrowsePathTarget **targets, size_t *targets_size,
+               size_t *target_count) {
+    const UA_RelativePathElement *elem = &path->elements[pathindex];
+    UA_BrowseDirection direction = elem->isInverse ? UA_BROWSEDIRECTION_INVERSE : UA_BROWSEDIRECTION_FORWARD;
+    ReferenceFilter filter;
+    UA_StatusCode retval = initReferenceFilter(server, &elem->referenceTypeId, elem->includeSubtypes,
+                                               direction, &filter);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    /* look up the targets by their browse name in large nodes */
+    const UA_BrowseNameIndex *index = getBrowseNameIndex(server, node);
+    if(index)
+        return walkBrowseNameIndex(server, session, node, index, &filter, path, pathindex,
+                                   targets, targets_size, target_count);
+
+    /* the references of every reference type are found in the index of the node */
+    size_t i = 0;
+    size_t end = 0;
+    while(retval == UA_STATUSCODE_GOOD) {
+        if(i >= end) {
+            if(!nextReferences(node, &filter, &i, &end))
+                break;
             continue;
+        }
 
         // get the node, todo: expandednodeid
-        const UA_Node *next = UA_NodeStore_get(server->nodestore, &node->references[i].targetId.nodeId);
+        const UA_Node *next = UA_NodeStore_get(server->nodestore, &node->references[i++].targetId.nodeId);
         if(!next)
             continue;
 
@@ -490,35 +908,9 @@ walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, cons
             continue;
         }
 
-        if(pathindex + 1 < path->elementsSize) {
-            // recursion if the path is longer
-            retval = walkBrowsePath(server, session, next, path, pathindex + 1,
-                                    targets, targets_size, target_count);
-        } else {
-            // add the browsetarget
-            if(*target_count >= *targets_size) {
-                UA_BrowsePathTarget *newtargets;
-                newtargets = UA_realloc(targets, sizeof(UA_BrowsePathTarget) * (*targets_size) * 2);
-                if(!newtargets) {
-                    retval = UA_STATUSCODE_BADOUTOFMEMORY;
-                    break;
-                }
-                *targets = newtargets;
-                *targets_size *= 2;
-            }
-
-            UA_BrowsePathTarget *res = *targets;
-            UA_ExpandedNodeId_init(&res[*target_count].targetId);
-            retval = UA_NodeId_copy(&next->nodeId, &res[*target_count].targetId.nodeId);
-            if(retval != UA_STATUSCODE_GOOD)
-                break;
-            res[*target_count].remainingPathIndex = UA_UINT32_MAX;
-            *target_count += 1;
-        }
+        retval = walkBrowsePathTarget(server, session, next, path, pathindex,
+                                      targets, targets_size, target_count);
     }
-
-    if(!all_refs && elem->includeSubtypes)
-        UA_Array_delete(reftypes, reftypes_count, &UA_TYPES[UA_TYPES_NODEID]);
     return retval;
 }
 
@@ -582,47 +974,40 @@ void Service_TranslateBrowsePathsToNodeIds(UA_Server *server, UA_Session *sessio
     }
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-#ifdef NO_ALLOCA
-    UA_Boolean isExternal[size];
-    UA_UInt32 indices[size];
-#else
-    UA_Boolean *isExternal = UA_alloca(sizeof(UA_Boolean) * size);
-    UA_UInt32 *indices = UA_alloca(sizeof(UA_UInt32) * size);
-#endif /* NO_ALLOCA */
-    memset(isExternal, false, sizeof(UA_Boolean) * size);
-    for(size_t j = 0; j < server->externalNamespacesSize; j++) {
-        size_t indexSize = 0;
-        for(size_t i = 0;i < size;i++) {
-            if(request->browsePaths[i].startingNode.namespaceIndex != server->externalNamespaces[j].index)
-                continue;
-            isExternal[i] = true;
-            indices[indexSize] = (UA_UInt32)i;
-            indexSize++;
-        }
-        if(indexSize == 0)
-            continue;
-        UA_ExternalNodeStore *ens = &server->externalNamespaces[j].externalNodeStore;
-        ens->translateBrowsePathsToNodeIds(ens->ensHandle, &request->requestHeader, request->browsePaths,
-                                           indices, (UA_UInt32)indexSize, response->results,
-                                           response->diagnosticInfos);
+    UA_ExternalRouting routing;
+    if(UA_ExternalRouting_init(&routing, server, request->browsePaths, size,
+                               sizeof(UA_BrowsePath), offsetof(UA_BrowsePath, startingNode))
+       != UA_STATUSCODE_GOOD) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+    for(size_t j = 0; j < routing.routesSize; j++) {
+        UA_ExternalRoute *route = &routing.routes[j];
+        route->ens->translateBrowsePathsToNodeIds(route->ens->ensHandle, &request->requestHeader,
+                                                  request->browsePaths, route->indices,
+                                                  route->indicesSize, response->results,
+                                                  response->diagnosticInfos);
     }
 #endif
 
     response->resultsSize = size;
     for(size_t i = 0; i < size; i++) {
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+        if(routing.isExternal && routing.isExternal[i])
+            continue;
 #endif
-            Service_TranslateBrowsePathsToNodeIds_single(server, session, &request->browsePaths[i],
-                                                         &response->results[i]);
+        Service_TranslateBrowsePathsToNodeIds_single(server, session, &request->browsePaths[i],
+                                                     &response->results[i]);
     }
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+    UA_ExternalRouting_deleteMembers(&routing);
+#endif
 }
 
 void Service_RegisterNodes(UA_Server *server, UA_Session *session, const UA_RegisterNodesRequest *request,
                            UA_RegisterNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing RegisterNodesRequest");
     //TODO: hang the nodeids to the session if really needed
-    response->responseHeader.timestamp = UA_DateTime_now();
     if(request->nodesToRegisterSize <= 0)
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
     else {
@@ -638,7 +1023,6 @@ void Service_UnregisterNodes(UA_Server *server, UA_Session *session, const UA_Un
                              UA_UnregisterNodesResponse *response) {
     UA_LOG_DEBUG_SESSION(server->config.logger, session, "Processing UnRegisterNodesRequest");
     //TODO: remove the nodeids from the session if really needed
-    response->responseHeader.timestamp = UA_DateTime_now();
     if(request->nodesToUnregisterSize==0)
         response->responseHeader.serviceResult = UA_STATUSCODE_BADNOTHINGTODO;
 }
@@ -1,76 +1,154 @@
 #include "ua_session_manager.h"
 #include "ua_server_internal.h"
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+#include "ua_subscription.h"
+#endif
+
+#ifdef UA_ENABLE_MULTITHREADING
+# define SM_LOCK(sm) pthread_mutex_lock(&(sm)->lock)
+# define SM_UNLOCK(sm) pthread_mutex_unlock(&(sm)->lock)
+#else
+# define SM_LOCK(sm)
+# define SM_UNLOCK(sm)
+#endif
 
 UA_StatusCode
 UA_SessionManager_init(UA_SessionManager *sm, UA_Server *server) {
-    LIST_INIT(&sm->sessions);
-    sm->currentSessionCount = 0;
+    UA_TimeoutIndex_init(&sm->sessions);
     sm->server = server;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    sm->lastSubscriptionId = 0;
+#endif
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_init(&sm->lock, NULL);
+#endif
     return UA_STATUSCODE_GOOD;
 }
 
+static session_list_entry * sessionAt(UA_SessionManager *sm, size_t i) {
+    return container_of(sm->sessions.heap[i], session_list_entry, timeoutEntry);
+}
+
 void UA_SessionManager_deleteMembers(UA_SessionManager *sm) {
-    session_list_entry *current, *temp;
-    LIST_FOREACH_SAFE(current, &sm->sessions, pointers, temp) {
-        LIST_REMOVE(current, pointers);
-        UA_Session_deleteMembersCleanup(&current->session, sm->server);
-        UA_free(current);
+    for(size_t i = 0; i < sm->sessions.size; i++) {
+        session_list_entry *entry = sessionAt(sm, i);
+        UA_Session_deleteMembersCleanup(&entry->session, sm->server);
+        UA_objfree(entry);
     }
+    UA_TimeoutIndex_deleteMembers(&sm->sessions);
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&sm->lock);
+#endif
 }
 
-void UA_SessionManager_cleanupTimedOut(UA_SessionManager *sm, UA_DateTime now) {
-    session_list_entry *sentry, *temp;
-    LIST_FOREACH_SAFE(sentry, &sm->sessions, pointers, temp) {
-        if(sentry->session.validTill < now) {
-            UA_LOG_DEBUG(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
-                         "Session with token %i has timed out and is removed",
-                         sentry->session.sessionId.identifier.numeric);
-            LIST_REMOVE(sentry, pointers);
-            UA_Session_deleteMembersCleanup(&sentry->session, sm->server);
+/*********/
+/* Index */
+/*********/
+
+static UA_UInt32 tokenHash(const UA_NodeId *token) {
+    /* The tokens are random guids. Mixing the first fields is sufficient. */
+    UA_UInt32 h = 0;
+    if(token->identifierType == UA_NODEIDTYPE_GUID)
+        h = token->identifier.guid.data1 ^ ((UA_UInt32)token->identifier.guid.data2 << 16) ^
+            token->identifier.guid.data3;
+    else if(token->identifierType == UA_NODEIDTYPE_NUMERIC)
+        h = token->identifier.numeric;
+    return h;
+}
+
+static session_list_entry *
+findSession(UA_SessionManager *sm, const UA_NodeId *token) {
+    struct UA_TimeoutBucket *bucket = UA_TimeoutIndex_bucket(&sm->sessions, tokenHash(token));
+    if(!bucket)
+        return NULL;
+    UA_TimeoutEntry *te;
+    LIST_FOREACH(te, bucket, pointers) {
+        session_list_entry *current = container_of(te, session_list_entry, timeoutEntry);
+        if(UA_NodeId_equal(&current->session.authenticationToken, token))
+            return current;
+    }
+    return NULL;
+}
+
+/************/
+/* Sessions */
+/************/
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void freeSessionEntry(UA_Server *server, void *entry) {
+    UA_objfree(entry);
+}
+#endif
+
+/* Call with the lock held */
+static void removeSession(UA_SessionManager *sm, session_list_entry *entry) {
+    UA_TimeoutIndex_remove(&sm->sessions, &entry->timeoutEntry);
+    UA_Session_deleteMembersCleanup(&entry->session, sm->server);
 #ifndef UA_ENABLE_MULTITHREADING
-            sm->currentSessionCount--;
-            UA_free(sentry);
+    UA_objfree(entry);
 #else
-            sm->currentSessionCount = uatomic_add_return(&sm->currentSessionCount, -1);
-            UA_Server_delayedFree(sm->server, sentry);
+    UA_Server_delayedCallback(sm->server, freeSessionEntry, entry);
 #endif
+}
+
+void UA_SessionManager_cleanupTimedOut(UA_SessionManager *sm, UA_DateTime now) {
+    SM_LOCK(sm);
+    UA_TimeoutEntry *first;
+    while((first = UA_TimeoutIndex_first(&sm->sessions))) {
+        session_list_entry *sentry = container_of(first, session_list_entry, timeoutEntry);
+        if(sentry->session.validTill >= now) {
+            /* The session was used in the meantime */
+            first->timeout = sentry->session.validTill;
+            UA_TimeoutIndex_update(&sm->sessions, first);
+            if(UA_TimeoutIndex_first(&sm->sessions) == first)
+                break;
+            continue;
         }
+        UA_LOG_DEBUG(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
+                     "Session with token %i has timed out and is removed",
+                     sentry->session.sessionId.identifier.numeric);
+        removeSession(sm, sentry);
     }
+    SM_UNLOCK(sm);
 }
 
 UA_Session *
 UA_SessionManager_getSession(UA_SessionManager *sm, const UA_NodeId *token) {
-    session_list_entry *current = NULL;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        if(UA_NodeId_equal(&current->session.authenticationToken, token)) {
-            if(UA_DateTime_now() > current->session.validTill) {
-                UA_LOG_DEBUG(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
-                             "Try to use Session with token " PRINTF_GUID_FORMAT ", but has timed out",
-                             PRINTF_GUID_DATA((*token)));
-                return NULL;
-            }
-            return &current->session;
-        }
+    SM_LOCK(sm);
+    session_list_entry *current = findSession(sm, token);
+    SM_UNLOCK(sm);
+    if(!current) {
+        UA_LOG_DEBUG(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
+                     "Try to use Session with token " PRINTF_GUID_FORMAT " but is not found",
+                     PRINTF_GUID_DATA((*token)));
+        return NULL;
     }
-    UA_LOG_DEBUG(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
-                 "Try to use Session with token " PRINTF_GUID_FORMAT " but is not found",
-                 PRINTF_GUID_DATA((*token)));
-    return NULL;
+    if(UA_Server_now(sm->server) > current->session.validTill) {
+        UA_LOG_DEBUG(sm->server->config.logger, UA_LOGCATEGORY_SESSION,
+                     "Try to use Session with token " PRINTF_GUID_FORMAT ", but has timed out",
+                     PRINTF_GUID_DATA((*token)));
+        return NULL;
+    }
+    return &current->session;
 }
 
 /** Creates and adds a session. But it is not yet attached to a secure channel. */
 UA_StatusCode
 UA_SessionManager_createSession(UA_SessionManager *sm, UA_SecureChannel *channel,
                                 const UA_CreateSessionRequest *request, UA_Session **session) {
-    if(sm->currentSessionCount >= sm->server->config.maxSessions)
-        return UA_STATUSCODE_BADTOOMANYSESSIONS;
-
-    session_list_entry *newentry = UA_malloc(sizeof(session_list_entry));
+    session_list_entry *newentry = UA_objalloc(UA_MEMCATEGORY_SESSION, sizeof(session_list_entry));
     if(!newentry)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
-    sm->currentSessionCount++;
+    SM_LOCK(sm);
+    if(sm->sessions.size >= sm->server->config.maxSessions) {
+        SM_UNLOCK(sm);
+        UA_objfree(newentry);
+        return UA_STATUSCODE_BADTOOMANYSESSIONS;
+    }
     UA_Session_init(&newentry->session);
+    newentry->session.maxContinuationPoints = sm->server->config.maxBrowseContinuationPoints;
+    newentry->session.availableContinuationPoints = sm->server->config.maxBrowseContinuationPoints;
     newentry->session.sessionId = UA_NODEID_GUID(1, UA_Guid_random());
     newentry->session.authenticationToken = UA_NODEID_GUID(1, UA_Guid_random());
 
@@ -80,31 +158,108 @@ UA_SessionManager_createSession(UA_SessionManager *sm, UA_SecureChannel *channel
     else
         newentry->session.timeout = sm->server->config.maxSessionTimeout;
 
-    UA_Session_updateLifetime(&newentry->session);
-    LIST_INSERT_HEAD(&sm->sessions, newentry, pointers);
+    UA_Session_updateLifetime(&newentry->session, UA_Server_now(sm->server));
+
+    newentry->timeoutEntry.hash = tokenHash(&newentry->session.authenticationToken);
+    newentry->timeoutEntry.timeout = newentry->session.validTill;
+    if(UA_TimeoutIndex_insert(&sm->sessions, &newentry->timeoutEntry) != UA_STATUSCODE_GOOD) {
+        SM_UNLOCK(sm);
+        UA_Session_deleteMembersCleanup(&newentry->session, sm->server);
+        UA_objfree(newentry);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    SM_UNLOCK(sm);
     *session = &newentry->session;
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_SessionManager_removeSession(UA_SessionManager *sm, const UA_NodeId *token) {
-    session_list_entry *current;
-    LIST_FOREACH(current, &sm->sessions, pointers) {
-        if(UA_NodeId_equal(&current->session.authenticationToken, token))
-            break;
-    }
-
+    SM_LOCK(sm);
+    session_list_entry *current = findSession(sm, token);
+    if(current)
+        removeSession(sm, current);
+    SM_UNLOCK(sm);
     if(!current)
         return UA_STATUSCODE_BADSESSIONIDINVALID;
+    return UA_STATUSCODE_GOOD;
+}
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
 
-    LIST_REMOVE(current, pointers);
-    UA_Session_deleteMembersCleanup(&current->session, sm->server);
+UA_UInt32
+UA_SessionManager_getUniqueSubscriptionID(UA_SessionManager *sm) {
 #ifndef UA_ENABLE_MULTITHREADING
-    sm->currentSessionCount--;
-    UA_free(current);
+    return ++sm->lastSubscriptionId;
 #else
-    sm->currentSessionCount = uatomic_add_return(&sm->currentSessionCount, -1);
-    UA_Server_delayedFree(sm->server, current);
+    return uatomic_add_return(&sm->lastSubscriptionId, 1);
 #endif
-    return UA_STATUSCODE_GOOD;
 }
+
+UA_Subscription *
+UA_SessionManager_getSubscription(UA_SessionManager *sm, UA_UInt32 subscriptionId) {
+    UA_Subscription *sub = NULL;
+    SM_LOCK(sm);
+    for(size_t i = 0; i < sm->sessions.size && !sub; i++)
+        sub = UA_Session_getSubscriptionByID(&sessionAt(sm, i)->session, subscriptionId);
+    SM_UNLOCK(sm);
+    return sub;
+}
+
+#endif
+
+/**********/
+/* Memory */
+/**********/
+
+static void addSessionMemory(UA_SessionMemory *sum, const UA_Session *session) {
+    sum->subscriptions += session->memory.subscriptions;
+    sum->samples += session->memory.samples;
+    sum->retransmissions += session->memory.retransmissions;
+    sum->continuationPoints += session->memory.continuationPoints;
+    sum->discarded += session->memory.discarded;
+    if(session->channel)
+        sum->chunks += session->channel->chunkMemory;
+}
+
+/* The counters are written without the lock. So they are a snapshot only
+ * approximately with multithreading. */
+UA_StatusCode
+UA_Server_getSessionMemory(UA_Server *server, const UA_NodeId *sessionId,
+                           UA_SessionMemory *memory) {
+    UA_SessionManager *sm = &server->sessionManager;
+    memset(memory, 0, sizeof(UA_SessionMemory));
+    UA_StatusCode retval = sessionId ? UA_STATUSCODE_BADSESSIONIDINVALID : UA_STATUSCODE_GOOD;
+    SM_LOCK(sm);
+    for(size_t i = 0; i < sm->sessions.size; i++) {
+        const UA_Session *session = &sessionAt(sm, i)->session;
+        if(sessionId && !UA_NodeId_equal(sessionId, &session->sessionId))
+            continue;
+        addSessionMemory(memory, session);
+        retval = UA_STATUSCODE_GOOD;
+    }
+    SM_UNLOCK(sm);
+    return retval;
+}
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+UA_StatusCode
+UA_Server_getSubscriptionMemory(UA_Server *server, const UA_NodeId *sessionId,
+                                UA_UInt32 subscriptionId, size_t *memory) {
+    UA_SessionManager *sm = &server->sessionManager;
+    UA_StatusCode retval = UA_STATUSCODE_BADSESSIONIDINVALID;
+    SM_LOCK(sm);
+    for(size_t i = 0; i < sm->sessions.size; i++) {
+        UA_Session *session = &sessionAt(sm, i)->session;
+        if(!UA_NodeId_equal(sessionId, &session->sessionId))
+            continue;
+        UA_Subscription *sub = UA_Session_getSubscriptionByID(session, subscriptionId);
+        if(sub)
+            *memory = sub->memory;
+        retval = sub ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID;
+        break;
+    }
+    SM_UNLOCK(sm);
+    return retval;
+}
+#endif
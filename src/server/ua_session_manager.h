@@ -5,16 +5,30 @@
 #include "ua_server.h"
 #include "ua_util.h"
 #include "ua_session.h"
+#include "ua_timeout_index.h"
+
+/**
+ * The sessions are kept in a timeout index with the hash of their
+ * authenticationToken. Every service call extends the lifetime of a session
+ * without touching the index. So the timeout in the index is a lower bound of
+ * the actual lifetime. The index is updated when a session with the earliest
+ * timeout turns out to be still alive during the cleanup.
+ */
 
 typedef struct session_list_entry {
-    LIST_ENTRY(session_list_entry) pointers;
+    UA_TimeoutEntry timeoutEntry; ///> The timeout is a lower bound of session.validTill
     UA_Session session;
 } session_list_entry;
 
 typedef struct UA_SessionManager {
-    LIST_HEAD(session_list, session_list_entry) sessions; // doubly-linked list of sessions
-    UA_UInt32 currentSessionCount;
+    UA_TimeoutIndex sessions;
     UA_Server *server;
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    UA_UInt32 lastSubscriptionId; // unique across the sessions for transfers
+#endif
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_t lock;
+#endif
 } UA_SessionManager;
 
 UA_StatusCode
@@ -34,4 +48,15 @@ UA_SessionManager_removeSession(UA_SessionManager *sessionManager, const UA_Node
 UA_Session *
 UA_SessionManager_getSession(UA_SessionManager *sessionManager, const UA_NodeId *token);
 
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+/* Subscriptions can be transferred between sessions. So their ids are unique
+ * in the server and not only in the session. */
+UA_UInt32
+UA_SessionManager_getUniqueSubscriptionID(UA_SessionManager *sessionManager);
+
+/* Finds the subscription in all sessions */
+UA_Subscription *
+UA_SessionManager_getSubscription(UA_SessionManager *sessionManager, UA_UInt32 subscriptionId);
+#endif
+
 #endif /* UA_SESSION_MANAGER_H_ */
@@ -1,27 +1,120 @@
-#include "ua_subscription.h"
 #include "ua_server_internal.h"
 #include "ua_services.h"
 #include "ua_nodestore.h"
+#include "ua_types_encoding_binary.h"
+#include "ua_types_generated_encoding_binary.h"
+#include "ua_trace.h"
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS /* conditional compilation */
 
+#include "ua_subscription.h"
+
+#define UA_SAMPLE_STACKBUFSIZE 512
+
 /*****************/
 /* MonitoredItem */
 /*****************/
 
+static MonitoredItem_encodedValue *encodeSample(const UA_DataValue *value) {
+    const UA_DataType *type = &UA_TYPES[UA_TYPES_DATAVALUE];
+    size_t length = UA_calcSizeBinary((void*)(uintptr_t)value, type);
+    MonitoredItem_encodedValue *ev = UA_malloc(sizeof(MonitoredItem_encodedValue) + length);
+    if(!ev)
+        return NULL;
+    UA_ByteString buf = {length, ev->data};
+    size_t offset = 0;
+    if(UA_encodeBinary(value, type, NULL, NULL, &buf, &offset) != UA_STATUSCODE_GOOD) {
+        UA_free(ev);
+        return NULL;
+    }
+    ev->refCount = 1;
+    ev->length = length;
+    return ev;
+}
+
+static MonitoredItem_encodedValue *retainEncodedSample(MonitoredItem_encodedValue *ev) {
+    if(ev) {
+#ifndef UA_ENABLE_MULTITHREADING
+        ev->refCount++;
+#else
+        uatomic_inc(&ev->refCount);
+#endif
+    }
+    return ev;
+}
+
+static void releaseEncodedSample(MonitoredItem_encodedValue *ev) {
+    if(!ev)
+        return;
+#ifndef UA_ENABLE_MULTITHREADING
+    if(--ev->refCount == 0)
+        UA_free(ev);
+#else
+    if(uatomic_sub_return(&ev->refCount, 1) == 0)
+        UA_free(ev);
+#endif
+}
+
+static void deleteQueuedValue(MonitoredItem_queuedValue *qv) {
+    UA_DataValue_deleteMembers(&qv->value);
+    releaseEncodedSample(qv->encoded);
+}
+
+/* The bytes of a subscription are also charged to a category of the session */
+static void chargeMemory(UA_Subscription *sub, size_t *category, size_t bytes) {
+    sub->memory += bytes;
+    *category += bytes;
+}
+
+static void releaseMemory(UA_Subscription *sub, size_t *category, size_t bytes) {
+    sub->memory -= bytes;
+    *category -= bytes;
+}
+
+/* A shared encoding is charged to every item that queues it */
+static size_t queuedValueMemory(const MonitoredItem_queuedValue *qv) {
+    if(!qv->encoded)
+        return 0;
+    return sizeof(MonitoredItem_encodedValue) + qv->encoded->length;
+}
+
+static void discardQueuedValue(UA_MonitoredItem *mon, MonitoredItem_queuedValue *qv) {
+    UA_Subscription *sub = mon->subscription;
+    releaseMemory(sub, &sub->session->memory.samples, queuedValueMemory(qv));
+    deleteQueuedValue(qv);
+}
+
+/* Discards the oldest sample of a non-empty queue */
+static void discardOldestSample(UA_MonitoredItem *mon) {
+    UA_Subscription *sub = mon->subscription;
+    discardQueuedValue(mon, &mon->queue[mon->queueStart]);
+    mon->queueStart = (mon->queueStart + 1) % mon->maxQueueSize;
+    mon->currentQueueSize--;
+    sub->queuedNotifications--;
+    if(mon->currentQueueSize == 0)
+        TAILQ_REMOVE(&sub->readyItems, mon, readyEntry);
+}
+
 UA_MonitoredItem * UA_MonitoredItem_new() {
-    UA_MonitoredItem *new = UA_malloc(sizeof(UA_MonitoredItem));
+    UA_MonitoredItem *new = UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION, sizeof(UA_MonitoredItem));
+    if(!new)
+        return NULL;
     new->subscription = NULL;
     new->currentQueueSize = 0;
     new->maxQueueSize = 0;
     new->monitoredItemType = UA_MONITOREDITEMTYPE_CHANGENOTIFY; /* currently hardcoded */
     new->timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
     UA_String_init(&new->indexRange);
-    TAILQ_INIT(&new->queue);
+    new->queue = NULL;
+    new->queueStart = 0;
+    new->memory = 0;
     UA_NodeId_init(&new->monitoredNodeId);
+    new->lastSampled = false;
+    new->lastSampledType = NULL;
     new->lastSampledValue = UA_BYTESTRING_NULL;
-    memset(&new->sampleJobGuid, 0, sizeof(UA_Guid));
-    new->sampleJobIsRegistered = false;
+    new->trigger = UA_DATACHANGETRIGGER_STATUSVALUE;
+    new->deadband = 0.0;
+    new->sampler = NULL;
     new->itemId = 0;
     return new;
 }
@@ -29,21 +122,245 @@ UA_MonitoredItem * UA_MonitoredItem_new() {
 void MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *monitoredItem) {
     MonitoredItem_unregisterSampleJob(server, monitoredItem);
     /* clear the queued samples */
-    MonitoredItem_queuedValue *val, *val_tmp;
-    TAILQ_FOREACH_SAFE(val, &monitoredItem->queue, listEntry, val_tmp) {
-        TAILQ_REMOVE(&monitoredItem->queue, val, listEntry);
-        UA_DataValue_deleteMembers(&val->value);
-        UA_free(val);
+    for(UA_UInt32 i = 0; i < monitoredItem->currentQueueSize; i++) {
+        UA_UInt32 pos = (monitoredItem->queueStart + i) % monitoredItem->maxQueueSize;
+        discardQueuedValue(monitoredItem, &monitoredItem->queue[pos]);
+    }
+    UA_objfree(monitoredItem->queue);
+    UA_Subscription *sub = monitoredItem->subscription;
+    if(monitoredItem->currentQueueSize > 0) {
+        TAILQ_REMOVE(&sub->readyItems, monitoredItem, readyEntry);
+        sub->queuedNotifications -= monitoredItem->currentQueueSize;
     }
     monitoredItem->currentQueueSize = 0;
+    if(monitoredItem->memory > 0)
+        releaseMemory(sub, &sub->session->memory.subscriptions, monitoredItem->memory);
     LIST_REMOVE(monitoredItem, listEntry);
     UA_String_deleteMembers(&monitoredItem->indexRange);
     UA_ByteString_deleteMembers(&monitoredItem->lastSampledValue);
     UA_NodeId_deleteMembers(&monitoredItem->monitoredNodeId);
-    UA_free(monitoredItem);
+    UA_objfree(monitoredItem);
 }
 
-static void SampleCallback(UA_Server *server, UA_MonitoredItem *monitoredItem) {
+UA_StatusCode MonitoredItem_setQueueSize(UA_MonitoredItem *mon, UA_UInt32 queueSize) {
+    if(queueSize == mon->maxQueueSize && (mon->queue || queueSize == 0))
+        return UA_STATUSCODE_GOOD;
+    MonitoredItem_queuedValue *queue = NULL;
+    if(queueSize > 0) {
+        queue = UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION,
+                            sizeof(MonitoredItem_queuedValue) * queueSize);
+        if(!queue)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+
+    /* Discard the oldest samples that do not fit */
+    UA_UInt32 i = 0;
+    for(; mon->currentQueueSize - i > queueSize; i++) {
+        UA_UInt32 pos = (mon->queueStart + i) % mon->maxQueueSize;
+        discardQueuedValue(mon, &mon->queue[pos]);
+    }
+    if(i > 0) {
+        UA_Subscription *sub = mon->subscription;
+        sub->queuedNotifications -= i;
+        mon->currentQueueSize -= i;
+        if(mon->currentQueueSize == 0)
+            TAILQ_REMOVE(&sub->readyItems, mon, readyEntry);
+    }
+
+    /* Move the remaining samples to the start of the new ring */
+    for(UA_UInt32 j = 0; j < mon->currentQueueSize; j++) {
+        UA_UInt32 pos = (mon->queueStart + i + j) % mon->maxQueueSize;
+        queue[j] = mon->queue[pos];
+    }
+    UA_objfree(mon->queue);
+    mon->queue = queue;
+    mon->queueStart = 0;
+    mon->maxQueueSize = queueSize;
+
+    /* Charge the item with the new ring */
+    UA_Subscription *sub = mon->subscription;
+    if(sub) {
+        releaseMemory(sub, &sub->session->memory.subscriptions, mon->memory);
+        mon->memory = sizeof(UA_MonitoredItem) + sizeof(MonitoredItem_queuedValue) * queueSize;
+        chargeMemory(sub, &sub->session->memory.subscriptions, mon->memory);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The fingerprint of a sample. Values of overlayable types are compared by
+ * their raw content. Other values are encoded piece by piece into a buffer on
+ * the stack and only the length and hash of the encoding are retained. So
+ * nothing is allocated unless the sample is queued. */
+typedef struct {
+    const UA_DataType *type; /* NULL if the encoding is hashed */
+    UA_Boolean scalar;
+    const void *data;
+    size_t size;
+    UA_UInt64 hash;
+} SampleFingerprint;
+
+/* FNV-1a */
+static void
+hashSample(SampleFingerprint *fp, const UA_Byte *data, size_t length) {
+    UA_UInt64 h = fp->hash;
+    for(size_t i = 0; i < length; i++) {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    fp->hash = h;
+    fp->size += length;
+}
+
+static UA_StatusCode
+hashEncodedChunk(void *handle, UA_ByteString *buf, size_t offset) {
+    hashSample((SampleFingerprint*)handle, buf->data, offset);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+fingerprintSample(const UA_Variant *value, SampleFingerprint *fp) {
+    fp->scalar = UA_Variant_isScalar(value);
+    if(value->type && value->type->overlayable && value->arrayDimensionsSize == 0 &&
+       (fp->scalar || value->arrayLength > 0)) {
+        fp->type = value->type;
+        fp->data = value->data;
+        fp->size = value->type->memSize * (fp->scalar ? 1 : value->arrayLength);
+        fp->hash = 0;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    fp->type = NULL;
+    fp->data = NULL;
+    fp->size = 0;
+    fp->hash = 14695981039346656037ull;
+    UA_Byte stackBuf[UA_SAMPLE_STACKBUFSIZE];
+    UA_ByteString buf = {UA_SAMPLE_STACKBUFSIZE, stackBuf};
+    size_t offset = 0;
+    UA_StatusCode retval = UA_encodeBinary(value, &UA_TYPES[UA_TYPES_VARIANT],
+                                           hashEncodedChunk, fp, &buf, &offset);
+    if(retval == UA_STATUSCODE_GOOD) {
+        hashSample(fp, stackBuf, offset);
+        return UA_STATUSCODE_GOOD;
+    }
+    if(retval != UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED)
+        return retval;
+
+    /* Not every member can be split over chunks. Then the value is encoded
+     * into a buffer of its full size and hashed from the start. */
+    fp->hash = 14695981039346656037ull;
+    fp->size = 0;
+    size_t size = UA_calcSizeBinary((void*)(uintptr_t)value, &UA_TYPES[UA_TYPES_VARIANT]);
+    retval = UA_ByteString_allocBuffer(&buf, size);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    offset = 0;
+    retval = UA_encodeBinary(value, &UA_TYPES[UA_TYPES_VARIANT], NULL, NULL, &buf, &offset);
+    if(retval == UA_STATUSCODE_GOOD)
+        hashSample(fp, buf.data, offset);
+    UA_ByteString_deleteMembers(&buf);
+    return retval;
+}
+
+static UA_Boolean
+sampleHasChanged(const UA_MonitoredItem *mon, const SampleFingerprint *fp) {
+    if(!mon->lastSampled || mon->lastSampledType != fp->type ||
+       mon->lastSampledSize != fp->size)
+        return true;
+    if(!fp->type)
+        return mon->lastSampledHash != fp->hash;
+    return mon->lastSampledScalar != fp->scalar ||
+        memcmp(mon->lastSampledValue.data, fp->data, fp->size) != 0;
+}
+
+static UA_Boolean isNumeric(const UA_DataType *type) {
+    return type >= &UA_TYPES[UA_TYPES_SBYTE] && type <= &UA_TYPES[UA_TYPES_DOUBLE];
+}
+
+static UA_Double numericValue(const UA_DataType *type, const void *p) {
+    switch(type->typeIndex) {
+    case UA_TYPES_SBYTE: return *(const UA_SByte*)p;
+    case UA_TYPES_BYTE: return *(const UA_Byte*)p;
+    case UA_TYPES_INT16: return *(const UA_Int16*)p;
+    case UA_TYPES_UINT16: return *(const UA_UInt16*)p;
+    case UA_TYPES_INT32: return *(const UA_Int32*)p;
+    case UA_TYPES_UINT32: return *(const UA_UInt32*)p;
+    case UA_TYPES_INT64: return (UA_Double)*(const UA_Int64*)p;
+    case UA_TYPES_UINT64: return (UA_Double)*(const UA_UInt64*)p;
+    case UA_TYPES_FLOAT: return *(const UA_Float*)p;
+    default: return *(const UA_Double*)p;
+    }
+}
+
+/* An array exceeds the deadband if any element does */
+static UA_Boolean
+exceedsDeadband(const UA_MonitoredItem *mon, const SampleFingerprint *fp) {
+    if(mon->lastSampledType != fp->type || mon->lastSampledScalar != fp->scalar ||
+       mon->lastSampledSize != fp->size)
+        return true;
+    const UA_Byte *last = mon->lastSampledValue.data;
+    const UA_Byte *current = fp->data;
+    for(size_t i = 0; i < fp->size; i += fp->type->memSize) {
+        UA_Double diff = numericValue(fp->type, &current[i]) - numericValue(fp->type, &last[i]);
+        if(diff > mon->deadband || -diff > mon->deadband)
+            return true;
+    }
+    return false;
+}
+
+/* Applies the trigger and the deadband of the item to the sample */
+static UA_Boolean
+sampleTriggers(const UA_MonitoredItem *mon, const UA_DataValue *value,
+               const SampleFingerprint *fp) {
+    if(!mon->lastSampled)
+        return true;
+    UA_StatusCode status = value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+    if(status != mon->lastSampledStatus)
+        return true;
+    if(mon->trigger == UA_DATACHANGETRIGGER_STATUS)
+        return false;
+    if(mon->trigger == UA_DATACHANGETRIGGER_STATUSVALUETIMESTAMP) {
+        UA_DateTime sourceTimestamp = value->hasSourceTimestamp ? value->sourceTimestamp : 0;
+        if(sourceTimestamp != mon->lastSampledSourceTimestamp)
+            return true;
+    }
+    if(mon->deadband > 0.0 && fp->type && isNumeric(fp->type))
+        return exceedsDeadband(mon, fp);
+    return sampleHasChanged(mon, fp);
+}
+
+/* The raw content is overwritten in place while the size stays the same */
+static UA_StatusCode
+retainSample(UA_MonitoredItem *mon, const UA_DataValue *value, const SampleFingerprint *fp) {
+    if(fp->type) {
+        if(mon->lastSampledValue.length != fp->size) {
+            UA_ByteString_deleteMembers(&mon->lastSampledValue);
+            UA_StatusCode retval = UA_ByteString_allocBuffer(&mon->lastSampledValue, fp->size);
+            if(retval != UA_STATUSCODE_GOOD) {
+                mon->lastSampled = false;
+                return retval;
+            }
+        }
+        memcpy(mon->lastSampledValue.data, fp->data, fp->size);
+    } else {
+        UA_ByteString_deleteMembers(&mon->lastSampledValue);
+    }
+    mon->lastSampled = true;
+    mon->lastSampledType = fp->type;
+    mon->lastSampledScalar = fp->scalar;
+    mon->lastSampledSize = fp->size;
+    mon->lastSampledHash = fp->hash;
+    mon->lastSampledStatus = value->hasStatus ? value->status : UA_STATUSCODE_GOOD;
+    mon->lastSampledSourceTimestamp = value->hasSourceTimestamp ? value->sourceTimestamp : 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Queues the sample if it triggers a notification of the item. The value
+ * is moved into the queue if it is not shared with other items. Otherwise, the
+ * first copy moves the data into a shared buffer and further copies only add a
+ * reference. The sample is encoded when it is queued the first time. */
+static void
+queueSample(UA_Server *server, UA_MonitoredItem *monitoredItem, UA_DataValue *value,
+            SampleFingerprint *fp, MonitoredItem_encodedValue **encoded, UA_Boolean move) {
     UA_Subscription *sub = monitoredItem->subscription;
     if(monitoredItem->monitoredItemType != UA_MONITOREDITEMTYPE_CHANGENOTIFY) {
         UA_LOG_DEBUG_SESSION(server->config.logger, sub->session, "MonitoredItem %i | "
@@ -52,92 +369,629 @@ static void SampleCallback(UA_Server *server, UA_MonitoredItem *monitoredItem) {
         return;
     }
 
-    MonitoredItem_queuedValue *newvalue = UA_malloc(sizeof(MonitoredItem_queuedValue));
-    if(!newvalue) {
-        UA_LOG_WARNING_SESSION(server->config.logger, sub->session, "MonitoredItem %i | "
-                            "Skipped a sample due to lack of memory", monitoredItem->itemId);
+    /* the change is not reported */
+    if(!sampleTriggers(monitoredItem, value, fp)) {
+        UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
+                             "Subscription %u | MonitoredItem %u | Do not sample an unchanged value",
+                             sub->subscriptionID, monitoredItem->itemId);
+        return;
+    }
+
+    UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
+                         "Subscription %u | MonitoredItem %u | Sampling the value",
+                         sub->subscriptionID, monitoredItem->itemId);
+
+    /* We cannot remove the oldest value and theres no queue space left. We're
+     * done here. */
+    if(monitoredItem->maxQueueSize == 0 ||
+       (monitoredItem->currentQueueSize >= monitoredItem->maxQueueSize &&
+        !monitoredItem->discardOldest))
         return;
+
+    if(!*encoded)
+        *encoded = encodeSample(value);
+
+    /* Stay within the memory quota. The oldest samples of the item are
+     * replaced if the item discards the oldest. Otherwise, the new sample is
+     * dropped. */
+    size_t sampleMemory = *encoded ? sizeof(MonitoredItem_encodedValue) + (*encoded)->length : 0;
+    while(UA_Subscription_exceedsMemory(server, sub, sampleMemory)) {
+        sub->session->memory.discarded++;
+        if(monitoredItem->currentQueueSize == 0 || !monitoredItem->discardOldest) {
+            UA_LOG_DEBUG_SESSION(server->config.logger, sub->session, "Subscription %u | "
+                                 "MonitoredItem %u | Dropped a sample for the memory quota",
+                                 sub->subscriptionID, monitoredItem->itemId);
+            return;
+        }
+        discardOldestSample(monitoredItem);
+    }
+
+    UA_DataValue newvalue;
+    if(move) {
+        newvalue = *value;
+        UA_DataValue_init(value);
+    } else {
+        if(value->value.storageType == UA_VARIANT_DATA &&
+           UA_Variant_share(&value->value) == UA_STATUSCODE_GOOD && fp->type)
+            fp->data = value->value.data; /* the data has moved */
+        if(UA_DataValue_copy(value, &newvalue) != UA_STATUSCODE_GOOD) {
+            UA_LOG_WARNING_SESSION(server->config.logger, sub->session, "MonitoredItem %i | "
+                                   "Skipped a sample due to lack of memory", monitoredItem->itemId);
+            return;
+        }
+    }
+
+    /* Keep the fingerprint of the sample */
+    if(retainSample(monitoredItem, &newvalue, fp) != UA_STATUSCODE_GOOD) {
+        UA_DataValue_deleteMembers(&newvalue);
+        return;
+    }
+
+    /* discard the oldest sample if the ring is full */
+    if(monitoredItem->currentQueueSize >= monitoredItem->maxQueueSize)
+        discardOldestSample(monitoredItem);
+
+    /* add the sample */
+    UA_UInt32 pos = (monitoredItem->queueStart + monitoredItem->currentQueueSize) %
+        monitoredItem->maxQueueSize;
+    monitoredItem->queue[pos].clientHandle = monitoredItem->clientHandle;
+    monitoredItem->queue[pos].value = newvalue;
+    monitoredItem->queue[pos].encoded = retainEncodedSample(*encoded);
+    chargeMemory(sub, &sub->session->memory.samples, queuedValueMemory(&monitoredItem->queue[pos]));
+    if(monitoredItem->currentQueueSize == 0)
+        TAILQ_INSERT_TAIL(&sub->readyItems, monitoredItem, readyEntry);
+    monitoredItem->currentQueueSize++;
+    sub->queuedNotifications++;
+}
+
+/* Hands the sample to all items of the sampler. The value may be moved out.
+ * Delete it afterwards. */
+static void distributeSample(UA_Server *server, UA_Sampler *sampler, UA_DataValue *value) {
+    SampleFingerprint fp;
+    if(fingerprintSample(&value->value, &fp) != UA_STATUSCODE_GOOD)
+        return;
+    MonitoredItem_encodedValue *encoded = NULL;
+    UA_MonitoredItem *mon;
+    LIST_FOREACH(mon, &sampler->items, samplerEntry) {
+        /* the items of a sampler can belong to different sessions */
+        UA_TRACE4(sample_taken, mon->subscription->session->sessionId.identifier.guid.data1,
+                  sampler, mon->itemId, value->status);
+        queueSample(server, mon, value, &fp, &encoded, sampler->itemsSize == 1);
+    }
+    releaseEncodedSample(encoded);
+}
+
+/************/
+/* Samplers */
+/************/
+
+#define UA_SAMPLERS_MINSIZE 64 /* a power of two */
+
+/* The lock protects the samplers and their groups. It is not held while the
+ * data sources are read (see SamplingGroupCallback). */
+#ifdef UA_ENABLE_MULTITHREADING
+# define UA_LOCK_SAMPLERS(server) pthread_mutex_lock(&(server)->samplersLock)
+# define UA_UNLOCK_SAMPLERS(server) pthread_mutex_unlock(&(server)->samplersLock)
+#else
+# define UA_LOCK_SAMPLERS(server)
+# define UA_UNLOCK_SAMPLERS(server)
+#endif
+
+static size_t samplerBucket(const UA_Server *server, const UA_NodeId *nodeId) {
+    return (size_t)UA_NodeStore_hash(nodeId) & (server->samplersSize - 1);
+}
+
+static UA_StatusCode growSamplers(UA_Server *server) {
+    size_t newSize = server->samplersSize * 2;
+    if(newSize < UA_SAMPLERS_MINSIZE)
+        newSize = UA_SAMPLERS_MINSIZE;
+    struct SamplersBucket *newIndex = UA_malloc(newSize * sizeof(struct SamplersBucket));
+    if(!newIndex)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < newSize; i++)
+        LIST_INIT(&newIndex[i]);
+
+    /* Rehash all samplers into the new buckets */
+    struct SamplersBucket *oldIndex = server->samplers;
+    size_t oldSize = server->samplersSize;
+    server->samplers = newIndex;
+    server->samplersSize = newSize;
+    for(size_t i = 0; i < oldSize; i++) {
+        UA_Sampler *s, *s_tmp;
+        LIST_FOREACH_SAFE(s, &oldIndex[i], indexEntry, s_tmp) {
+            LIST_REMOVE(s, indexEntry);
+            LIST_INSERT_HEAD(&newIndex[samplerBucket(server, &s->nodeId)], s, indexEntry);
+        }
+    }
+    UA_free(oldIndex);
+    return UA_STATUSCODE_GOOD;
+}
+
+static const UA_VariableNode *
+getSampledVariable(UA_Server *server, const UA_Sampler *sampler) {
+    if(sampler->attributeId != UA_ATTRIBUTEID_VALUE)
+        return NULL;
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &sampler->nodeId);
+    if(!node || !(node->nodeClass & (UA_NODECLASS_VARIABLE | UA_NODECLASS_VARIABLETYPE)))
+        return NULL;
+    return (const UA_VariableNode*)node;
+}
+
+/* Only the value of variables with a variant value source changes solely when
+ * written. Values with an onRead callback may be updated when they are read. */
+static UA_Boolean watchesValue(UA_Server *server, const UA_Sampler *sampler) {
+    const UA_VariableNode *vn = getSampledVariable(server, sampler);
+    return vn && vn->valueSource == UA_VALUESOURCE_VARIANT && !vn->value.variant.callback.onRead;
+}
+
+static UA_Boolean readsAsync(UA_Server *server, const UA_Sampler *sampler) {
+    const UA_VariableNode *vn = getSampledVariable(server, sampler);
+    return vn && vn->valueSource == UA_VALUESOURCE_DATASOURCE && vn->value.dataSource.readAsync;
+}
+
+static void deleteSampler(UA_Sampler *sampler) {
+    UA_NodeId_deleteMembers(&sampler->nodeId);
+    UA_String_deleteMembers(&sampler->indexRange);
+    UA_objfree(sampler);
+}
+
+/* A sample from an asynchronous data source. A sampler that loses its last
+ * item in the meantime is deleted when the read has completed. */
+typedef struct {
+    UA_AsyncReadBatch batch; /* must be the first member */
+    UA_Sampler *sampler;
+    UA_DataValue value;
+} AsyncSample;
+
+static void finishAsyncSample(UA_Server *server, AsyncSample *as) {
+    UA_Sampler *sampler = as->sampler;
+    UA_LOCK_SAMPLERS(server);
+    sampler->samplePending = false;
+    if(sampler->itemsSize > 0)
+        distributeSample(server, sampler, &as->value);
+    else
+        deleteSampler(sampler);
+    UA_UNLOCK_SAMPLERS(server);
+    UA_DataValue_deleteMembers(&as->value);
+    UA_free(as);
+}
+
+/* The data sources are read without the lock. So they can take their own
+ * locks and write values. The sampler is marked pending while it is read. A
+ * sampler that loses its last item in the meantime is deleted when the sample
+ * is finished. The session is freed only after the RCU grace period. */
+typedef struct {
+    UA_Sampler *sampler;
+    UA_Session *session; /* the read is done in the context of the session */
+    UA_Boolean async; /* finished by finishAsyncSample */
+    UA_Boolean batched; /* read with the readBatch callback of a data source */
+    UA_DataValue value;
+} SamplerRead;
+
+/* Call with the lock held */
+static UA_Boolean takeSampler(UA_Sampler *sampler, SamplerRead *read) {
+    /* Slow data sources are not asked again before the last sample arrived */
+    if(sampler->samplePending)
+        return false;
+    sampler->samplePending = true;
+    read->sampler = sampler;
+    read->session = LIST_FIRST(&sampler->items)->subscription->session;
+    read->async = false;
+    read->batched = false;
+    UA_DataValue_init(&read->value);
+    return true;
+}
+
+/* Call without the lock */
+static void readSample(UA_Server *server, SamplerRead *read) {
+    UA_Sampler *sampler = read->sampler;
+
+    /* Reads from asynchronous data sources are finished later */
+    AsyncSample *as = NULL;
+    if(readsAsync(server, sampler)) {
+        as = UA_malloc(sizeof(AsyncSample));
+        if(as) {
+            UA_AsyncReadBatch_init(&as->batch, (UA_AsyncReadBatch_finish)finishAsyncSample);
+            as->sampler = sampler;
+            UA_DataValue_init(&as->value);
+        }
     }
-    UA_DataValue_init(&newvalue->value);
-    newvalue->clientHandle = monitoredItem->clientHandle;
 
-    /* Read the value */
     UA_ReadValueId rvid;
     UA_ReadValueId_init(&rvid);
-    rvid.nodeId = monitoredItem->monitoredNodeId;
-    rvid.attributeId = monitoredItem->attributeID;
-    rvid.indexRange = monitoredItem->indexRange;
-    Service_Read_single(server, sub->session, monitoredItem->timestampsToReturn, &rvid, &newvalue->value);
-
-    /* encode to see if the data has changed */
-    size_t binsize = UA_calcSizeBinary(&newvalue->value.value, &UA_TYPES[UA_TYPES_VARIANT]);
-    UA_ByteString newValueAsByteString;
-    UA_StatusCode retval = UA_ByteString_allocBuffer(&newValueAsByteString, binsize);
+    rvid.nodeId = sampler->nodeId;
+    rvid.attributeId = sampler->attributeId;
+    rvid.indexRange = sampler->indexRange;
+    Service_Read_singleAsync(server, read->session, sampler->timestamps, &rvid,
+                             as ? &as->batch : NULL, as ? &as->value : &read->value);
+    if(as) {
+        read->async = true;
+        UA_AsyncReadBatch_release(server, &as->batch);
+    }
+}
+
+/* Call with the lock held */
+static void finishSample(UA_Server *server, SamplerRead *read) {
+    if(!read->async) {
+        UA_Sampler *sampler = read->sampler;
+        sampler->samplePending = false;
+        if(sampler->itemsSize > 0)
+            distributeSample(server, sampler, &read->value);
+        else
+            deleteSampler(sampler);
+    }
+    UA_DataValue_deleteMembers(&read->value);
+}
+
+#ifndef UA_ENABLE_MULTITHREADING
+/* Samples a notified sampler right away */
+static void sampleSampler(UA_Server *server, UA_Sampler *sampler) {
+    SamplerRead read;
+    if(!takeSampler(sampler, &read))
+        return;
+    readSample(server, &read);
+    finishSample(server, &read);
+}
+#endif
+
+/* Reads the samplers of data sources with a readBatch callback together.
+ * Call without the lock. */
+static void readBatchedSamples(UA_Server *server, SamplerRead *reads, size_t readsSize) {
+    UA_BatchReadItem *items = UA_malloc(sizeof(UA_BatchReadItem) * readsSize);
+    if(!items)
+        return;
+    size_t itemsSize = 0;
+    for(size_t i = 0; i < readsSize; i++) {
+        UA_Sampler *s = reads[i].sampler;
+        const UA_VariableNode *vn = UA_Server_getBatchReadNode(server, &s->nodeId,
+                                                               s->attributeId, &s->indexRange);
+        if(!vn)
+            continue;
+        reads[i].batched = true;
+        items[itemsSize].node = vn;
+        items[itemsSize].timestamps = s->timestamps;
+        items[itemsSize].target = &reads[i].value;
+        itemsSize++;
+    }
+    if(itemsSize > 0)
+        UA_Server_readBatched(server, items, itemsSize);
+    UA_free(items);
+}
+
+/* Sample all polled samplers of the group in one pass and the notified
+ * samplers that were written since their last sample. The samplers are taken
+ * from the group with the lock held. Then the values are read without the
+ * lock and distributed with the lock held again. */
+void SamplingGroupCallback(UA_Server *server, UA_SamplingGroup *group) {
+    UA_LOCK_SAMPLERS(server);
+    /* The group may have lost its last sampler after the job was dispatched */
+    SamplerRead *reads = NULL;
+    if(group->samplersSize > 0)
+        reads = UA_malloc(sizeof(SamplerRead) * group->samplersSize);
+    if(!reads) {
+        UA_UNLOCK_SAMPLERS(server);
+        return;
+    }
+    size_t readsSize = 0;
+    UA_Sampler *s;
+    LIST_FOREACH(s, &group->samplers, groupEntry) {
+        if(takeSampler(s, &reads[readsSize]))
+            readsSize++;
+    }
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    while((s = LIST_FIRST(&group->changedSamplers))) {
+        LIST_REMOVE(s, groupEntry);
+        s->changed = false;
+        s->lastSampleTime = now;
+        if(takeSampler(s, &reads[readsSize]))
+            readsSize++;
+    }
+    UA_UNLOCK_SAMPLERS(server);
+
+    if(server->batchReadSources)
+        readBatchedSamples(server, reads, readsSize);
+    for(size_t i = 0; i < readsSize; i++) {
+        if(!reads[i].batched)
+            readSample(server, &reads[i]);
+    }
+
+    UA_LOCK_SAMPLERS(server);
+    for(size_t i = 0; i < readsSize; i++)
+        finishSample(server, &reads[i]);
+    UA_UNLOCK_SAMPLERS(server);
+    UA_free(reads);
+}
+
+static UA_StatusCode
+getSamplingGroup(UA_Server *server, UA_UInt64 samplingInterval, UA_SamplingGroup **out) {
+    /* Find the group for the sampling interval */
+    UA_SamplingGroup *group;
+    LIST_FOREACH(group, &server->samplingGroups, listEntry) {
+        if(group->samplingInterval == samplingInterval) {
+            *out = group;
+            return UA_STATUSCODE_GOOD;
+        }
+    }
+
+    /* Create a new group with a repeated job */
+    group = UA_malloc(sizeof(UA_SamplingGroup));
+    if(!group)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    group->samplingInterval = samplingInterval;
+    group->samplersSize = 0;
+    LIST_INIT(&group->samplers);
+    LIST_INIT(&group->changedSamplers);
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = (UA_ServerCallback)SamplingGroupCallback,
+                                     .data = group},
+                  .priority = UA_JOBPRIORITY_REALTIME };
+    UA_StatusCode retval = UA_Server_addRepeatedJobUsec(server, job, samplingInterval,
+                                                        &group->sampleJobGuid);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_DataValue_deleteMembers(&newvalue->value);
-        UA_free(newvalue);
+        UA_free(group);
+        return retval;
+    }
+    LIST_INSERT_HEAD(&server->samplingGroups, group, listEntry);
+    *out = group;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode removeSamplingGroup(UA_Server *server, UA_SamplingGroup *group) {
+    LIST_REMOVE(group, listEntry);
+    UA_StatusCode retval = UA_Server_removeRepeatedJob(server, group->sampleJobGuid);
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_free(group);
+#else
+    /* the sample job may have been dispatched already */
+    UA_Server_delayedFree(server, group);
+#endif
+    return retval;
+}
+
+/* Call with the lock held */
+static void markChanged(UA_Sampler *sampler) {
+    if(sampler->changed)
         return;
+    sampler->changed = true;
+    LIST_INSERT_HEAD(&sampler->group->changedSamplers, sampler, groupEntry);
+}
+
+/* Call with the lock held */
+static UA_Sampler *
+findSampler(UA_Server *server, const UA_MonitoredItem *mon, UA_UInt64 samplingInterval) {
+    if(server->samplersCount == 0)
+        return NULL;
+    UA_Sampler *s;
+    LIST_FOREACH(s, &server->samplers[samplerBucket(server, &mon->monitoredNodeId)], indexEntry) {
+        if(s->group->samplingInterval == samplingInterval &&
+           s->attributeId == mon->attributeID && s->timestamps == mon->timestampsToReturn &&
+           UA_NodeId_equal(&s->nodeId, &mon->monitoredNodeId) &&
+           UA_String_equal(&s->indexRange, &mon->indexRange))
+            return s;
     }
-    size_t encodingOffset = 0;
-    retval = UA_encodeBinary(&newvalue->value.value, &UA_TYPES[UA_TYPES_VARIANT],
-                             NULL, NULL, &newValueAsByteString, &encodingOffset);
-
-    /* error or the content has not changed */
-    if(retval != UA_STATUSCODE_GOOD ||
-       (monitoredItem->lastSampledValue.data &&
-        UA_String_equal(&newValueAsByteString, &monitoredItem->lastSampledValue))) {
-        UA_ByteString_deleteMembers(&newValueAsByteString);
-        UA_DataValue_deleteMembers(&newvalue->value);
-        UA_free(newvalue);
-        UA_LOG_DEBUG_SESSION(server->config.logger, sub->session, "Subscription %u | "
-                             "MonitoredItem %u | Do not sample an unchanged value",
-                             sub->subscriptionID, monitoredItem->itemId);
+    return NULL;
+}
+
+/* Call with the lock held. The first sample of a notified sampler is taken
+ * with the next run of the group job. */
+static UA_StatusCode
+addSampler(UA_Server *server, const UA_MonitoredItem *mon, UA_UInt64 samplingInterval,
+           UA_Sampler **out) {
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(server->samplersCount >= server->samplersSize)
+        retval = growSamplers(server);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_Sampler *sampler = UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION, sizeof(UA_Sampler));
+    if(!sampler)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    retval = UA_NodeId_copy(&mon->monitoredNodeId, &sampler->nodeId);
+    retval |= UA_String_copy(&mon->indexRange, &sampler->indexRange);
+    UA_SamplingGroup *group = NULL;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = getSamplingGroup(server, samplingInterval, &group);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteSampler(sampler);
+        return retval;
+    }
+
+    sampler->group = group;
+    sampler->attributeId = mon->attributeID;
+    sampler->timestamps = mon->timestampsToReturn;
+    sampler->itemsSize = 0;
+    LIST_INIT(&sampler->items);
+    sampler->samplePending = false;
+    sampler->changed = false;
+    sampler->lastSampleTime = 0;
+    sampler->notified = watchesValue(server, sampler);
+    group->samplersSize++;
+    LIST_INSERT_HEAD(&server->samplers[samplerBucket(server, &sampler->nodeId)],
+                     sampler, indexEntry);
+    server->samplersCount++;
+    if(sampler->notified) {
+        server->notifiedSamplers++;
+        markChanged(sampler);
+    } else {
+        LIST_INSERT_HEAD(&group->samplers, sampler, groupEntry);
+    }
+    *out = sampler;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Call with the lock held */
+static UA_StatusCode removeSampler(UA_Server *server, UA_Sampler *sampler) {
+    LIST_REMOVE(sampler, indexEntry);
+    server->samplersCount--;
+    if(sampler->notified)
+        server->notifiedSamplers--;
+    if(!sampler->notified || sampler->changed)
+        LIST_REMOVE(sampler, groupEntry);
+    UA_SamplingGroup *group = sampler->group;
+    if(!sampler->samplePending)
+        deleteSampler(sampler); /* otherwise deleted when the read has finished */
+    group->samplersSize--;
+    if(group->samplersSize > 0)
+        return UA_STATUSCODE_GOOD;
+    return removeSamplingGroup(server, group);
+}
+
+/* Call with the lock held */
+static void notifySampler(UA_Server *server, UA_Sampler *sampler, UA_DateTime now) {
+    if(sampler->changed)
+        return; /* the sample is taken with the next run of the group job */
+#ifndef UA_ENABLE_MULTITHREADING
+    /* Sample right away once the sampling interval has passed */
+    if(now - sampler->lastSampleTime >=
+       (UA_DateTime)sampler->group->samplingInterval * UA_USEC_TO_DATETIME) {
+        sampler->lastSampleTime = now;
+        sampleSampler(server, sampler);
         return;
     }
+#else
+    /* The writer may run in parallel to the jobs of the sessions. Leave the
+     * sample to the group job. */
+    (void)now;
+#endif
+    markChanged(sampler);
+}
 
-    UA_LOG_DEBUG_SESSION(server->config.logger, sub->session, "Subscription %u | MonitoredItem %u | Sampling the value",
-                         sub->subscriptionID, monitoredItem->itemId);
+static UA_Boolean hasNotifiedSamplers(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    return server->notifiedSamplers > 0;
+#else
+    return uatomic_read(&server->notifiedSamplers) > 0;
+#endif
+}
 
-    /* do we have space in the queue? */
-    if(monitoredItem->currentQueueSize >= monitoredItem->maxQueueSize) {
-        if(!monitoredItem->discardOldest) {
-            // We cannot remove the oldest value and theres no queue space left. We're done here.
-            UA_ByteString_deleteMembers(&newValueAsByteString);
-            UA_DataValue_deleteMembers(&newvalue->value);
-            UA_free(newvalue);
-            return;
+/* Call with the lock held */
+static void notifyNode(UA_Server *server, const UA_NodeId *nodeId, UA_DateTime now) {
+    UA_Sampler *s;
+    LIST_FOREACH(s, &server->samplers[samplerBucket(server, nodeId)], indexEntry) {
+        if(s->notified && UA_NodeId_equal(&s->nodeId, nodeId))
+            notifySampler(server, s, now);
+    }
+}
+
+void UA_Server_notifyValueWrite(UA_Server *server, const UA_NodeId *nodeId) {
+    if(!hasNotifiedSamplers(server))
+        return;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_LOCK_SAMPLERS(server);
+    if(nodeId) {
+        notifyNode(server, nodeId, now);
+    } else {
+        UA_Sampler *s;
+        for(size_t i = 0; i < server->samplersSize; i++) {
+            LIST_FOREACH(s, &server->samplers[i], indexEntry) {
+                if(s->notified)
+                    notifySampler(server, s, now);
+            }
         }
-        MonitoredItem_queuedValue *queueItem = TAILQ_LAST(&monitoredItem->queue, QueueOfQueueDataValues);
-        if (queueItem != NULL) {
-          TAILQ_REMOVE(&monitoredItem->queue, queueItem, listEntry);
-          UA_DataValue_deleteMembers(&queueItem->value);
-          UA_free(queueItem);
-          monitoredItem->currentQueueSize--;
+    }
+    UA_UNLOCK_SAMPLERS(server);
+}
+
+void UA_Server_notifyValueWrites(UA_Server *server, const UA_NodeId *nodeIds,
+                                 const UA_StatusCode *results, size_t size) {
+    if(!hasNotifiedSamplers(server))
+        return;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    UA_LOCK_SAMPLERS(server);
+    for(size_t i = 0; i < size; i++) {
+        if(results[i] == UA_STATUSCODE_GOOD)
+            notifyNode(server, &nodeIds[i], now);
+    }
+    UA_UNLOCK_SAMPLERS(server);
+}
+
+void UA_Server_pollValueWatchers(UA_Server *server, const UA_NodeId *nodeId) {
+    UA_LOCK_SAMPLERS(server);
+    if(server->notifiedSamplers > 0) {
+        UA_Sampler *s;
+        LIST_FOREACH(s, &server->samplers[samplerBucket(server, nodeId)], indexEntry) {
+            if(!s->notified || !UA_NodeId_equal(&s->nodeId, nodeId))
+                continue;
+            s->notified = false;
+            server->notifiedSamplers--;
+            if(s->changed) {
+                LIST_REMOVE(s, groupEntry);
+                s->changed = false;
+            }
+            LIST_INSERT_HEAD(&s->group->samplers, s, groupEntry);
         }
     }
+    UA_UNLOCK_SAMPLERS(server);
+}
 
-    /* add the sample */
-    UA_ByteString_deleteMembers(&monitoredItem->lastSampledValue);
-    monitoredItem->lastSampledValue = newValueAsByteString;
-    TAILQ_INSERT_TAIL(&monitoredItem->queue, newvalue, listEntry);
-    monitoredItem->currentQueueSize++;
+void UA_Server_initSamplers(UA_Server *server) {
+    LIST_INIT(&server->samplingGroups);
+    server->samplers = NULL;
+    server->samplersSize = 0;
+    server->samplersCount = 0;
+    server->notifiedSamplers = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&server->samplersLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+}
+
+void UA_Server_deleteSamplers(UA_Server *server) {
+    UA_free(server->samplers);
+    server->samplers = NULL;
+    server->samplersSize = 0;
+    server->samplersCount = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_mutex_destroy(&server->samplersLock);
+#endif
 }
 
+/* Items with the same target, timestamps and sampling interval share a
+ * sampler. An item that joins a notified sampler needs the current value as
+ * its first sample. */
 UA_StatusCode MonitoredItem_registerSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
-    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
-                  .job.methodCall = {.method = (UA_ServerCallback)SampleCallback, .data = mon} };
-    UA_StatusCode retval = UA_Server_addRepeatedJob(server, job, (UA_UInt32)mon->samplingInterval,
-                                                    &mon->sampleJobGuid);
+    UA_UInt64 samplingInterval = (UA_UInt64)(mon->samplingInterval * 1000.0);
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_LOCK_SAMPLERS(server);
+    if(mon->sampler) {
+        UA_UNLOCK_SAMPLERS(server);
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_Sampler *sampler = findSampler(server, mon, samplingInterval);
+    if(sampler && sampler->notified)
+        markChanged(sampler);
+    if(!sampler)
+        retval = addSampler(server, mon, samplingInterval, &sampler);
+    if(retval == UA_STATUSCODE_GOOD) {
+        LIST_INSERT_HEAD(&sampler->items, mon, samplerEntry);
+        sampler->itemsSize++;
+        mon->sampler = sampler;
+    }
+    UA_UNLOCK_SAMPLERS(server);
+#ifdef UA_ENABLE_NODE_STATISTICS
     if(retval == UA_STATUSCODE_GOOD)
-        mon->sampleJobIsRegistered = true;
+        UA_Server_countNodeAccess(server, &mon->monitoredNodeId, UA_NODEACCESS_MONITOREDITEM);
+#endif
     return retval;
 }
 
 UA_StatusCode MonitoredItem_unregisterSampleJob(UA_Server *server, UA_MonitoredItem *mon) {
-    if(!mon->sampleJobIsRegistered)
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    UA_LOCK_SAMPLERS(server);
+    UA_Sampler *sampler = mon->sampler;
+    if(!sampler) {
+        UA_UNLOCK_SAMPLERS(server);
         return UA_STATUSCODE_GOOD;
-    mon->sampleJobIsRegistered = false;
-    return UA_Server_removeRepeatedJob(server, mon->sampleJobGuid);
+    }
+    LIST_REMOVE(mon, samplerEntry);
+    mon->sampler = NULL;
+    sampler->itemsSize--;
+    if(sampler->itemsSize == 0)
+        retval = removeSampler(server, sampler);
+    UA_UNLOCK_SAMPLERS(server);
+    return retval;
 }
 
 /****************/
@@ -145,7 +999,7 @@ UA_StatusCode MonitoredItem_unregisterSampleJob(UA_Server *server, UA_MonitoredI
 /****************/
 
 UA_Subscription * UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptionID) {
-    UA_Subscription *new = UA_malloc(sizeof(UA_Subscription));
+    UA_Subscription *new = UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION, sizeof(UA_Subscription));
     if(!new)
         return NULL;
     new->session = session;
@@ -159,11 +1013,40 @@ UA_Subscription * UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptio
     new->currentLifetimeCount = 0;
     new->lastMonitoredItemId = 0;
     new->state = UA_SUBSCRIPTIONSTATE_NORMAL; /* The first publish response is sent immediately */
-    LIST_INIT(&new->retransmissionQueue);
+    new->lateSince = 0;
+    new->latePublishRequestCount = 0;
+    TAILQ_INIT(&new->retransmissionQueue);
+    new->retransmissionQueueSize = 0;
     LIST_INIT(&new->MonitoredItems);
+    TAILQ_INIT(&new->readyItems);
+    new->queuedNotifications = 0;
+    new->memory = 0;
+    chargeMemory(new, &session->memory.subscriptions, sizeof(UA_Subscription));
     return new;
 }
 
+UA_Boolean
+UA_Subscription_exceedsMemory(const UA_Server *server, const UA_Subscription *sub,
+                              size_t bytes) {
+    if(server->config.maxSubscriptionMemory > 0 &&
+       sub->memory + bytes > server->config.maxSubscriptionMemory)
+        return true;
+    return server->config.maxSessionMemory > 0 &&
+        UA_Session_memoryUsage(sub->session) + bytes > server->config.maxSessionMemory;
+}
+
+static void removeRetransmission(UA_NotificationMessageEntry *nme) {
+    UA_Subscription *sub = nme->subscription;
+    TAILQ_REMOVE(&sub->retransmissionQueue, nme, listEntry);
+    TAILQ_REMOVE(&sub->session->retransmissionQueue, nme, sessionEntry);
+    sub->retransmissionQueueSize--;
+    sub->session->retransmissionQueueSize--;
+    releaseMemory(sub, &sub->session->memory.retransmissions,
+                  sizeof(UA_NotificationMessageEntry) + nme->message.length);
+    UA_ByteString_deleteMembers(&nme->message);
+    UA_objfree(nme);
+}
+
 void UA_Subscription_deleteMembers(UA_Subscription *subscription, UA_Server *server) {
     Subscription_unregisterPublishJob(server, subscription);
 
@@ -175,12 +1058,301 @@ void UA_Subscription_deleteMembers(UA_Subscription *subscription, UA_Server *ser
     }
 
     /* Delete Retransmission Queue */
-    UA_NotificationMessageEntry *nme, *nme_tmp;
-    LIST_FOREACH_SAFE(nme, &subscription->retransmissionQueue, listEntry, nme_tmp) {
-        LIST_REMOVE(nme, listEntry);
-        UA_NotificationMessage_deleteMembers(&nme->message);
-        UA_free(nme);
+    UA_NotificationMessageEntry *nme;
+    while((nme = TAILQ_FIRST(&subscription->retransmissionQueue)))
+        removeRetransmission(nme);
+    releaseMemory(subscription, &subscription->session->memory.subscriptions,
+                  sizeof(UA_Subscription));
+}
+
+void UA_Subscription_moveToSession(UA_Subscription *sub, UA_Session *session) {
+    UA_Session *old = sub->session;
+    if(old == session)
+        return;
+
+    /* Split the memory of the subscription into the categories */
+    size_t samples = 0;
+    UA_MonitoredItem *mon;
+    TAILQ_FOREACH(mon, &sub->readyItems, readyEntry) {
+        for(UA_UInt32 i = 0; i < mon->currentQueueSize; i++)
+            samples += queuedValueMemory(&mon->queue[(mon->queueStart + i) % mon->maxQueueSize]);
+    }
+    size_t retransmissions = 0;
+    UA_NotificationMessageEntry *nme;
+    TAILQ_FOREACH(nme, &sub->retransmissionQueue, listEntry) {
+        retransmissions += sizeof(UA_NotificationMessageEntry) + nme->message.length;
+        /* Appended behind the messages of the new session, although they may
+         * be older. So they are dropped late when the session queue is full. */
+        TAILQ_REMOVE(&old->retransmissionQueue, nme, sessionEntry);
+        TAILQ_INSERT_TAIL(&session->retransmissionQueue, nme, sessionEntry);
+    }
+    size_t subscriptions = sub->memory - samples - retransmissions;
+    old->retransmissionQueueSize -= sub->retransmissionQueueSize;
+    session->retransmissionQueueSize += sub->retransmissionQueueSize;
+    old->memory.subscriptions -= subscriptions;
+    old->memory.samples -= samples;
+    old->memory.retransmissions -= retransmissions;
+    session->memory.subscriptions += subscriptions;
+    session->memory.samples += samples;
+    session->memory.retransmissions += retransmissions;
+
+    LIST_REMOVE(sub, listEntry);
+    sub->session = session;
+    UA_Session_addSubscription(session, sub);
+}
+
+void UA_Subscription_sendStatusChange(UA_Server *server, UA_Subscription *sub,
+                                      UA_StatusCode status) {
+    UA_Session *session = sub->session;
+    UA_PublishResponseEntry *pre = SIMPLEQ_FIRST(&session->responseQueue);
+    if(!session->channel || !pre)
+        return;
+    UA_StatusChangeNotification *scn = UA_StatusChangeNotification_new();
+    UA_ExtensionObject *data = UA_ExtensionObject_new();
+    if(!scn || !data) {
+        UA_free(scn);
+        UA_free(data);
+        return;
+    }
+    SIMPLEQ_REMOVE_HEAD(&session->responseQueue, listEntry);
+    scn->status = status;
+    data->encoding = UA_EXTENSIONOBJECT_DECODED;
+    data->content.decoded.data = scn;
+    data->content.decoded.type = &UA_TYPES[UA_TYPES_STATUSCHANGENOTIFICATION];
+
+    UA_PublishResponse *response = &pre->response;
+    response->responseHeader.timestamp = UA_Server_now(server);
+    response->subscriptionId = sub->subscriptionID;
+    UA_NotificationMessage *message = &response->notificationMessage;
+    message->publishTime = response->responseHeader.timestamp;
+    message->sequenceNumber = sub->sequenceNumber + 1;
+    message->notificationData = data;
+    message->notificationDataSize = 1;
+    UA_SecureChannel_sendBinaryMessage(session->channel, pre->requestId, response,
+                                       &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    UA_PublishResponse_deleteMembers(response);
+    UA_objfree(pre);
+}
+
+void UA_Subscription_resendValues(UA_Server *server, UA_Subscription *sub) {
+    UA_LOCK_SAMPLERS(server);
+    UA_MonitoredItem *mon;
+    LIST_FOREACH(mon, &sub->MonitoredItems, listEntry) {
+        mon->lastSampled = false;
+        if(mon->sampler && mon->sampler->notified)
+            markChanged(mon->sampler);
+    }
+    UA_UNLOCK_SAMPLERS(server);
+}
+
+UA_NotificationMessageEntry *
+UA_Subscription_getRetransmission(UA_Subscription *sub, UA_UInt32 sequenceNumber) {
+    UA_NotificationMessageEntry *nme;
+    TAILQ_FOREACH(nme, &sub->retransmissionQueue, listEntry) {
+        if(nme->sequenceNumber == sequenceNumber)
+            return nme;
+    }
+    return NULL;
+}
+
+UA_StatusCode
+UA_Subscription_removeRetransmission(UA_Subscription *sub, UA_UInt32 sequenceNumber) {
+    UA_NotificationMessageEntry *nme = UA_Subscription_getRetransmission(sub, sequenceNumber);
+    if(!nme)
+        return UA_STATUSCODE_BADSEQUENCENUMBERUNKNOWN;
+    removeRetransmission(nme);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Takes ownership of the encoded message. Drops the oldest messages of the
+ * subscription and the session to stay within the limits and the memory quota.
+ * Returns NULL if the message is not kept. */
+static UA_NotificationMessageEntry *
+storeRetransmission(UA_Server *server, UA_Subscription *sub, UA_UInt32 sequenceNumber,
+                    UA_ByteString *encoded) {
+    UA_Session *session = sub->session;
+    if(server->config.maxRetransmissionQueueSize == 0 ||
+       server->config.maxSessionRetransmissionQueueSize == 0)
+        return NULL;
+    /* Don't drop the queued messages for a message that cannot fit anyway */
+    size_t memory = sizeof(UA_NotificationMessageEntry) + encoded->length;
+    if((server->config.maxSubscriptionMemory > 0 && memory > server->config.maxSubscriptionMemory) ||
+       (server->config.maxSessionMemory > 0 && memory > server->config.maxSessionMemory)) {
+        session->memory.discarded++;
+        return NULL;
+    }
+    UA_NotificationMessageEntry *nme =
+        UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION, sizeof(UA_NotificationMessageEntry));
+    if(!nme) {
+        UA_LOG_WARNING_SESSION(server->config.logger, session, "Subscription %u | "
+                               "Could not allocate memory for retransmission", sub->subscriptionID);
+        return NULL;
+    }
+    while(sub->retransmissionQueueSize >= server->config.maxRetransmissionQueueSize)
+        removeRetransmission(TAILQ_FIRST(&sub->retransmissionQueue));
+    while(session->retransmissionQueueSize >= server->config.maxSessionRetransmissionQueueSize)
+        removeRetransmission(TAILQ_FIRST(&session->retransmissionQueue));
+    while(UA_Subscription_exceedsMemory(server, sub, memory)) {
+        session->memory.discarded++;
+        UA_NotificationMessageEntry *oldest = TAILQ_FIRST(&sub->retransmissionQueue);
+        if(!oldest)
+            oldest = TAILQ_FIRST(&session->retransmissionQueue);
+        if(!oldest) {
+            UA_objfree(nme);
+            return NULL;
+        }
+        removeRetransmission(oldest);
+    }
+    nme->subscription = sub;
+    nme->sequenceNumber = sequenceNumber;
+    nme->message = *encoded;
+    UA_ByteString_init(encoded);
+    TAILQ_INSERT_TAIL(&sub->retransmissionQueue, nme, listEntry);
+    TAILQ_INSERT_TAIL(&session->retransmissionQueue, nme, sessionEntry);
+    sub->retransmissionQueueSize++;
+    session->retransmissionQueueSize++;
+    chargeMemory(sub, &session->memory.retransmissions, memory);
+    return nme;
+}
+
+/* Removes the oldest sample of the first ready item */
+static void dequeueSample(UA_Subscription *sub, MonitoredItem_queuedValue *qv) {
+    UA_MonitoredItem *mon = TAILQ_FIRST(&sub->readyItems);
+    *qv = mon->queue[mon->queueStart];
+    mon->queueStart = (mon->queueStart + 1) % mon->maxQueueSize;
+    mon->currentQueueSize--;
+    sub->queuedNotifications--;
+    releaseMemory(sub, &sub->session->memory.samples, queuedValueMemory(qv));
+    if(mon->currentQueueSize == 0)
+        TAILQ_REMOVE(&sub->readyItems, mon, readyEntry);
+}
+
+/* Tests if the next samples are encoded and sums up the length of their
+ * MonitoredItemNotifications */
+static UA_Boolean
+samplesEncoded(UA_Subscription *sub, size_t notifications, size_t *samplesSize) {
+    size_t n = 0, size = 0;
+    UA_MonitoredItem *mon;
+    TAILQ_FOREACH(mon, &sub->readyItems, readyEntry) {
+        for(UA_UInt32 i = 0; i < mon->currentQueueSize && n < notifications; i++, n++) {
+            MonitoredItem_queuedValue *qv = &mon->queue[(mon->queueStart + i) % mon->maxQueueSize];
+            if(!qv->encoded)
+                return false;
+            size += sizeof(UA_UInt32) + qv->encoded->length; /* with the client handle */
+        }
+        if(n == notifications)
+            break;
     }
+    *samplesSize = size;
+    return true;
+}
+
+/* Encodes the notification message around the cached encodings of the samples.
+ * Only the client handles are encoded for every sample. The layout is the same
+ * as for a decoded DataChangeNotification in an ExtensionObject. */
+static UA_StatusCode
+encodeCachedNotifications(UA_Subscription *sub, const UA_NotificationMessage *message,
+                          size_t notifications, size_t samplesSize, UA_ByteString *encoded) {
+    UA_NodeId typeId = UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION].typeId;
+    typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
+    size_t bodySize = sizeof(UA_Int32) + samplesSize + sizeof(UA_Int32);
+    if(bodySize > UA_INT32_MAX || notifications > UA_INT32_MAX)
+        return UA_STATUSCODE_BADENCODINGERROR;
+    size_t size = sizeof(UA_UInt32) + sizeof(UA_DateTime) + sizeof(UA_Int32) +
+        UA_calcSizeBinary(&typeId, &UA_TYPES[UA_TYPES_NODEID]) + sizeof(UA_Byte) +
+        sizeof(UA_Int32) + bodySize;
+    UA_StatusCode retval = UA_ByteString_allocBuffer(encoded, size);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+
+    size_t offset = 0;
+    UA_Int32 dataSize = 1;
+    UA_Byte bodyEncoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
+    UA_Int32 bodyLength = (UA_Int32)bodySize;
+    UA_Int32 itemsSize = (UA_Int32)notifications;
+    UA_Int32 noDiagnosticInfos = -1;
+    retval |= UA_UInt32_encodeBinary(&message->sequenceNumber, encoded, &offset);
+    retval |= UA_DateTime_encodeBinary(&message->publishTime, encoded, &offset);
+    retval |= UA_Int32_encodeBinary(&dataSize, encoded, &offset);
+    retval |= UA_NodeId_encodeBinary(&typeId, encoded, &offset);
+    retval |= UA_Byte_encodeBinary(&bodyEncoding, encoded, &offset);
+    retval |= UA_Int32_encodeBinary(&bodyLength, encoded, &offset);
+    retval |= UA_Int32_encodeBinary(&itemsSize, encoded, &offset);
+    for(size_t i = 0; i < notifications; i++) {
+        MonitoredItem_queuedValue qv;
+        dequeueSample(sub, &qv);
+        retval |= UA_UInt32_encodeBinary(&qv.clientHandle, encoded, &offset);
+        memcpy(&encoded->data[offset], qv.encoded->data, qv.encoded->length);
+        offset += qv.encoded->length;
+        deleteQueuedValue(&qv);
+    }
+    retval |= UA_Int32_encodeBinary(&noDiagnosticInfos, encoded, &offset);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_ByteString_deleteMembers(encoded);
+    return retval;
+}
+
+/* Moves the samples into a DataChangeNotification */
+static void
+collectNotifications(UA_Subscription *sub, UA_NotificationMessage *message, size_t notifications) {
+    message->notificationData = UA_ExtensionObject_new();
+    message->notificationDataSize = 1;
+    UA_ExtensionObject *data = message->notificationData;
+    UA_DataChangeNotification *dcn = UA_DataChangeNotification_new();
+    dcn->monitoredItems = UA_Array_new(notifications, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
+    dcn->monitoredItemsSize = notifications;
+    for(size_t l = 0; l < notifications; l++) {
+        MonitoredItem_queuedValue qv;
+        dequeueSample(sub, &qv);
+        UA_MonitoredItemNotification *min = &dcn->monitoredItems[l];
+        min->clientHandle = qv.clientHandle;
+        min->value = qv.value;
+        releaseEncodedSample(qv.encoded);
+    }
+    data->encoding = UA_EXTENSIONOBJECT_DECODED;
+    data->content.decoded.data = dcn;
+    data->content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION];
+}
+
+static UA_StatusCode
+encodeNotificationMessage(UA_NotificationMessage *message, UA_ByteString *encoded) {
+    const UA_DataType *type = &UA_TYPES[UA_TYPES_NOTIFICATIONMESSAGE];
+    UA_StatusCode retval = UA_ByteString_allocBuffer(encoded, UA_calcSizeBinary(message, type));
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    size_t offset = 0;
+    retval = UA_encodeBinary(message, type, NULL, NULL, encoded, &offset);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_ByteString_deleteMembers(encoded);
+    return retval;
+}
+
+/* The members of the response are encoded in order. The notification message
+ * is copied from its encoding. */
+static UA_StatusCode
+sendPublishResponse(UA_SecureChannel *channel, UA_UInt32 requestId,
+                    const UA_PublishResponse *response, const UA_ByteString *message) {
+    UA_MessageContext mc;
+    UA_StatusCode retval =
+        UA_SecureChannel_beginMessage(channel, requestId, &UA_TYPES[UA_TYPES_PUBLISHRESPONSE], &mc);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_SecureChannel_encodeMessage(&mc, &response->responseHeader,
+                                            &UA_TYPES[UA_TYPES_RESPONSEHEADER]);
+    retval |= UA_SecureChannel_encodeMessage(&mc, &response->subscriptionId,
+                                             &UA_TYPES[UA_TYPES_UINT32]);
+    retval |= UA_SecureChannel_encodeMessageArray(&mc, response->availableSequenceNumbers,
+                                                  response->availableSequenceNumbersSize,
+                                                  &UA_TYPES[UA_TYPES_UINT32]);
+    retval |= UA_SecureChannel_encodeMessage(&mc, &response->moreNotifications,
+                                             &UA_TYPES[UA_TYPES_BOOLEAN]);
+    retval |= UA_SecureChannel_writeMessageBytes(&mc, message);
+    retval |= UA_SecureChannel_encodeMessageArray(&mc, response->results, response->resultsSize,
+                                                  &UA_TYPES[UA_TYPES_STATUSCODE]);
+    retval |= UA_SecureChannel_encodeMessageArray(&mc, response->diagnosticInfos,
+                                                  response->diagnosticInfosSize,
+                                                  &UA_TYPES[UA_TYPES_DIAGNOSTICINFO]);
+    return UA_SecureChannel_finishMessage(&mc, retval);
 }
 
 UA_MonitoredItem *
@@ -212,16 +1384,10 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
     size_t notifications = 0;
     UA_Boolean moreNotifications = false;
     if(sub->publishingEnabled) {
-        UA_MonitoredItem *mon;
-        LIST_FOREACH(mon, &sub->MonitoredItems, listEntry) {
-            MonitoredItem_queuedValue *qv;
-            TAILQ_FOREACH(qv, &mon->queue, listEntry) {
-                if(notifications >= sub->notificationsPerPublish) {
-                    moreNotifications = true;
-                    break;
-                }
-                notifications++;
-            }
+        notifications = sub->queuedNotifications;
+        if(notifications > sub->notificationsPerPublish) {
+            notifications = sub->notificationsPerPublish;
+            moreNotifications = true;
         }
     }
 
@@ -237,6 +1403,17 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
     if(!channel)
         return;
 
+    /* Late subscriptions with at least the same priority take the publish
+     * requests first. Stop if a late subscription does not take a request. */
+    UA_Subscription *late;
+    while(!SIMPLEQ_EMPTY(&sub->session->responseQueue) &&
+          (late = UA_Session_getLateSubscription(sub->session)) &&
+          late != sub && late->priority >= sub->priority) {
+        UA_Subscription_publishCallback(server, late);
+        if(late->state == UA_SUBSCRIPTIONSTATE_LATE)
+            break;
+    }
+
     /* Dequeue a response */
     UA_PublishResponseEntry *pre = SIMPLEQ_FIRST(&sub->session->responseQueue);
     if(!pre) {
@@ -245,6 +1422,8 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
                              "since the publish queue is empty", sub->subscriptionID)
         if(sub->state != UA_SUBSCRIPTIONSTATE_LATE) {
             sub->state = UA_SUBSCRIPTIONSTATE_LATE;
+            sub->lateSince = UA_DateTime_nowMonotonic();
+            sub->latePublishRequestCount++;
         } else {
             sub->currentLifetimeCount++;
             if(sub->currentLifetimeCount > sub->lifeTimeCount) {
@@ -261,16 +1440,29 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
     UA_UInt32 requestId = pre->requestId;
 
     /* We have a request. Reset state to normal. */
+    UA_Boolean wasLate = (sub->state == UA_SUBSCRIPTIONSTATE_LATE);
     sub->state = UA_SUBSCRIPTIONSTATE_NORMAL;
     sub->currentKeepAliveCount = 0;
     sub->currentLifetimeCount = 0;
 
     /* Prepare the response */
-    response->responseHeader.timestamp = UA_DateTime_now();
+    response->responseHeader.timestamp = UA_Server_now(server);
+
+    /* Tell the client that the subscription had to wait for a publish request
+     * if the service-level additional info was requested (bit 0x04 of
+     * returnDiagnostics). The client should queue more publish requests. */
+    if(wasLate && (pre->returnDiagnostics & 0x04)) {
+        UA_DiagnosticInfo *di = &response->responseHeader.serviceDiagnostics;
+        di->additionalInfo =
+            UA_String_fromChars("The subscription was late. Not enough publish requests are queued.");
+        di->hasAdditionalInfo = (di->additionalInfo.data != NULL);
+    }
     response->subscriptionId = sub->subscriptionID;
     response->moreNotifications = moreNotifications;
     UA_NotificationMessage *message = &response->notificationMessage;
     message->publishTime = response->responseHeader.timestamp;
+    UA_ByteString encoded = UA_BYTESTRING_NULL;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
     if(notifications == 0) {
         /* Send sequence number for the next notification */
         message->sequenceNumber = sub->sequenceNumber + 1;
@@ -278,70 +1470,55 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
         /* Increase the sequence number */
         message->sequenceNumber = ++sub->sequenceNumber;
 
-        /* Collect the notification messages */
-        message->notificationData = UA_ExtensionObject_new();
-        message->notificationDataSize = 1;
-        UA_ExtensionObject *data = message->notificationData;
-        UA_DataChangeNotification *dcn = UA_DataChangeNotification_new();
-        dcn->monitoredItems = UA_Array_new(notifications, &UA_TYPES[UA_TYPES_MONITOREDITEMNOTIFICATION]);
-        dcn->monitoredItemsSize = notifications;
-        size_t l = 0;
-        UA_MonitoredItem *mon;
-        LIST_FOREACH(mon, &sub->MonitoredItems, listEntry) {
-            MonitoredItem_queuedValue *qv, *qv_tmp;
-            TAILQ_FOREACH_SAFE(qv, &mon->queue, listEntry, qv_tmp) {
-                if(notifications <= l)
-                    break;
-                UA_MonitoredItemNotification *min = &dcn->monitoredItems[l];
-                min->clientHandle = qv->clientHandle;
-                min->value = qv->value;
-                TAILQ_REMOVE(&mon->queue, qv, listEntry);
-                UA_free(qv);
-                mon->currentQueueSize--;
-                l++;
-            }
-        }
-        data->encoding = UA_EXTENSIONOBJECT_DECODED;
-        data->content.decoded.data = dcn;
-        data->content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION];
-
-        /* Put the notification message into the retransmission queue */
-        UA_NotificationMessageEntry *retransmission = malloc(sizeof(UA_NotificationMessageEntry));
-        if(retransmission) {
-            UA_NotificationMessage_copy(&response->notificationMessage, &retransmission->message);
-            LIST_INSERT_HEAD(&sub->retransmissionQueue, retransmission, listEntry);
-        } else {
-            UA_LOG_WARNING_SESSION(server->config.logger, sub->session, "Subscription %u | "
-                                   "Could not allocate memory for retransmission", sub->subscriptionID);
-        }
+        /* Concatenate the cached encodings of the samples if possible.
+         * Otherwise, collect the notification messages. */
+        size_t samplesSize;
+        if(samplesEncoded(sub, notifications, &samplesSize))
+            retval = encodeCachedNotifications(sub, message, notifications, samplesSize, &encoded);
+        if(encoded.length == 0)
+            collectNotifications(sub, message, notifications);
     }
 
+    /* Encode the notification message once. The encoding is sent and kept for
+     * retransmission. */
+    if(encoded.length == 0)
+        retval = encodeNotificationMessage(message, &encoded);
+    UA_NotificationMessageEntry *stored = NULL;
+    if(retval == UA_STATUSCODE_GOOD && notifications > 0)
+        stored = storeRetransmission(server, sub, message->sequenceNumber, &encoded);
+
     /* Get the available sequence numbers from the retransmission queue */
-    size_t available = 0, i = 0;
+    size_t i = 0;
     UA_NotificationMessageEntry *nme;
-    LIST_FOREACH(nme, &sub->retransmissionQueue, listEntry)
-        available++;
     //cppcheck-suppress knownConditionTrueFalse
-    if(available > 0) {
-        response->availableSequenceNumbers = UA_alloca(available * sizeof(UA_UInt32));
-        response->availableSequenceNumbersSize = available;
+    if(sub->retransmissionQueueSize > 0) {
+        response->availableSequenceNumbers = UA_alloca(sub->retransmissionQueueSize * sizeof(UA_UInt32));
+        response->availableSequenceNumbersSize = sub->retransmissionQueueSize;
     }
-    LIST_FOREACH(nme, &sub->retransmissionQueue, listEntry) {
-        response->availableSequenceNumbers[i] = nme->message.sequenceNumber;
+    TAILQ_FOREACH(nme, &sub->retransmissionQueue, listEntry) {
+        response->availableSequenceNumbers[i] = nme->sequenceNumber;
         i++;
     }
 
     /* Send the response */
     UA_LOG_DEBUG_SESSION(server->config.logger, sub->session,
                          "Sending out a publish response with %u notifications", (UA_UInt32)notifications);
-    UA_SecureChannel_sendBinaryMessage(sub->session->channel, requestId, response,
-                                       &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_SecureChannel_sendBinaryMessage(channel, requestId, response,
+                                           &UA_TYPES[UA_TYPES_PUBLISHRESPONSE]);
+    } else {
+        sendPublishResponse(channel, requestId, response, stored ? &stored->message : &encoded);
+        UA_ByteString_deleteMembers(&encoded);
+    }
+    UA_TRACE5(publish_sent, channel->securityToken.channelId,
+              sub->session->sessionId.identifier.guid.data1, sub->subscriptionID,
+              message->sequenceNumber, notifications);
 
     /* Remove the queued request */
     response->availableSequenceNumbers = NULL; /* stack-allocated */
     response->availableSequenceNumbersSize = 0;
     UA_PublishResponse_deleteMembers(&pre->response);
-    UA_free(pre);
+    UA_objfree(pre);
 
     /* Repeat if there are more notifications to send */
     if(moreNotifications)
@@ -351,9 +1528,11 @@ void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub) {
 UA_StatusCode Subscription_registerPublishJob(UA_Server *server, UA_Subscription *sub) {
     UA_Job job = (UA_Job) {.type = UA_JOBTYPE_METHODCALL,
                            .job.methodCall = {.method = (UA_ServerCallback)UA_Subscription_publishCallback,
-                                              .data = sub} };
-    UA_StatusCode retval = UA_Server_addRepeatedJob(server, job, (UA_UInt32)sub->publishingInterval,
-                                                    &sub->publishJobGuid);
+                                              .data = sub},
+                           .priority = UA_JOBPRIORITY_REALTIME };
+    UA_StatusCode retval =
+        UA_Server_addRepeatedJobUsec(server, job, (UA_UInt64)(sub->publishingInterval * 1000.0),
+                                     &sub->publishJobGuid);
     if(retval == UA_STATUSCODE_GOOD)
         sub->publishJobIsRegistered = true;
     return retval;
@@ -17,12 +17,27 @@ typedef enum {
     UA_MONITOREDITEMTYPE_EVENTNOTIFY = 4
 } UA_MonitoredItemType;
 
+/* The binary encoding of a sample. All items of a sampler queue the same
+ * sample. So the encoding is shared and freed with the last reference. The
+ * notification messages are concatenated from the encodings. */
+typedef struct {
+    UA_UInt32 refCount;
+    size_t length;
+    UA_Byte data[];
+} MonitoredItem_encodedValue;
+
 typedef struct MonitoredItem_queuedValue {
-    TAILQ_ENTRY(MonitoredItem_queuedValue) listEntry;
     UA_UInt32 clientHandle;
     UA_DataValue value;
+    MonitoredItem_encodedValue *encoded; /* NULL if the encoding failed */
 } MonitoredItem_queuedValue;
 
+struct UA_Sampler;
+typedef struct UA_Sampler UA_Sampler;
+
+struct UA_SamplingGroup;
+typedef struct UA_SamplingGroup UA_SamplingGroup;
+
 typedef struct UA_MonitoredItem {
     LIST_ENTRY(UA_MonitoredItem) listEntry;
 
@@ -42,27 +57,98 @@ typedef struct UA_MonitoredItem {
     UA_String indexRange;
     // TODO: dataEncoding is hardcoded to UA binary
 
-    /* Sample Job */
-    UA_Guid sampleJobGuid;
-    UA_Boolean sampleJobIsRegistered;
-
-    /* Sample Queue */
-    UA_ByteString lastSampledValue;
-    TAILQ_HEAD(QueueOfQueueDataValues, MonitoredItem_queuedValue) queue;
+    /* DataChangeFilter. A percent deadband is converted to the absolute
+     * deadband with the EURange when the filter is set. The deadband applies
+     * only to numeric values. Other values are compared exactly. */
+    UA_DataChangeTrigger trigger;
+    UA_Double deadband; /* absolute, 0 for no deadband */
+
+    /* Sampling */
+    UA_Sampler *sampler; /* NULL if the item is not sampled */
+    LIST_ENTRY(UA_MonitoredItem) samplerEntry;
+
+    /* Sample Queue. The last sample is remembered to detect changes. Values
+     * of overlayable types are kept as raw content and compared directly.
+     * Otherwise only the length and hash of the encoding are kept. */
+    UA_Boolean lastSampled; /* a value was sampled before */
+    const UA_DataType *lastSampledType; /* NULL if the value was hashed */
+    UA_Boolean lastSampledScalar;
+    UA_ByteString lastSampledValue; /* raw content (not encoded) */
+    size_t lastSampledSize; /* length of the encoding */
+    UA_UInt64 lastSampledHash;
+    UA_StatusCode lastSampledStatus;
+    UA_DateTime lastSampledSourceTimestamp;
+
+    /* The queued samples are kept in a ring of maxQueueSize entries. The ring
+     * is allocated when the queue size is set and not on every sample. */
+    MonitoredItem_queuedValue *queue;
+    UA_UInt32 queueStart; /* index of the oldest sample */
+    size_t memory; /* of the item and its ring, charged to the subscription */
+    TAILQ_ENTRY(UA_MonitoredItem) readyEntry; /* if currentQueueSize > 0 */
 } UA_MonitoredItem;
 
 UA_MonitoredItem *UA_MonitoredItem_new(void);
 void MonitoredItem_delete(UA_Server *server, UA_MonitoredItem *monitoredItem);
+
+/* Reallocates the ring of queued samples. If the queue shrinks, the oldest
+ * samples are discarded. The queue is left unchanged if no memory is left. The
+ * item and its ring are charged to the memory of the subscription. */
+UA_StatusCode MonitoredItem_setQueueSize(UA_MonitoredItem *mon, UA_UInt32 queueSize);
 UA_StatusCode MonitoredItem_registerSampleJob(UA_Server *server, UA_MonitoredItem *mon);
 UA_StatusCode MonitoredItem_unregisterSampleJob(UA_Server *server, UA_MonitoredItem *mon);
 
+/* The monitored items of all sessions with the same node, attribute, index
+ * range, timestamps and sampling interval share a sampler. The value is read
+ * once per sample. The queues of the items reference the same data (see
+ * UA_Variant_share). Samplers on a value that changes only when written are
+ * notified by the writes instead of being polled (see watchesValue). */
+struct UA_Sampler {
+    LIST_ENTRY(UA_Sampler) indexEntry; /* in the sampler index of the server */
+    LIST_ENTRY(UA_Sampler) groupEntry; /* polled or changed samplers of the group */
+    UA_SamplingGroup *group;
+    UA_NodeId nodeId;
+    UA_UInt32 attributeId;
+    UA_String indexRange;
+    UA_TimestampsToReturn timestamps;
+    size_t itemsSize;
+    LIST_HEAD(UA_ListOfSampledItems, UA_MonitoredItem) items;
+    UA_Boolean samplePending; /* waiting for an asynchronous data source */
+    UA_Boolean notified; /* sampled when the value is written */
+    UA_Boolean changed; /* contained in the changed samplers of the group */
+    UA_DateTime lastSampleTime; /* monotonic */
+};
+
+/* The samplers with the same sampling interval are sampled together from a
+ * single repeated job. The group is removed with its last sampler. Notified
+ * samplers are sampled right away when a write arrives after the sampling
+ * interval has passed. Otherwise, they wait in the changed samplers for the
+ * next run of the job. */
+struct UA_SamplingGroup {
+    LIST_ENTRY(UA_SamplingGroup) listEntry;
+    UA_UInt64 samplingInterval; // [us]
+    UA_Guid sampleJobGuid;
+    size_t samplersSize; /* polled and notified samplers */
+    LIST_HEAD(UA_ListOfPolledSamplers, UA_Sampler) samplers; /* polled */
+    LIST_HEAD(UA_ListOfChangedSamplers, UA_Sampler) changedSamplers;
+};
+
+/* The repeated job of the sampling group. Called directly by the benchmarks. */
+void SamplingGroupCallback(UA_Server *server, UA_SamplingGroup *group);
+
 /****************/
 /* Subscription */
 /****************/
 
+/* Sent notification messages are kept until they are acknowledged or the
+ * retransmission queue of the subscription or the session is full. Then the
+ * oldest message is dropped. The message is kept in its binary encoding, so
+ * that Republish only copies the bytes. */
 typedef struct UA_NotificationMessageEntry {
-    LIST_ENTRY(UA_NotificationMessageEntry) listEntry;
-    UA_NotificationMessage message;
+    TAILQ_ENTRY(UA_NotificationMessageEntry) listEntry; /* in the subscription */
+    TAILQ_ENTRY(UA_NotificationMessageEntry) sessionEntry;
+    UA_Subscription *subscription;
+    UA_UInt32 sequenceNumber;
+    UA_ByteString message;
 } UA_NotificationMessageEntry;
 
 /* We use only a subset of the states defined in the standard */
@@ -89,6 +175,8 @@ struct UA_Subscription {
 
     /* Runtime information */
     UA_SubscriptionState state;
+    UA_DateTime lateSince; /* monotonic */
+    UA_UInt32 latePublishRequestCount; /* transitions to the late state */
     UA_UInt32 sequenceNumber;
     UA_UInt32 currentKeepAliveCount;
     UA_UInt32 currentLifetimeCount;
@@ -99,9 +187,26 @@ struct UA_Subscription {
     UA_Boolean publishJobIsRegistered;
 
     LIST_HEAD(UA_ListOfUAMonitoredItems, UA_MonitoredItem) MonitoredItems;
-    LIST_HEAD(UA_ListOfNotificationMessages, UA_NotificationMessageEntry) retransmissionQueue;
+
+    /* The items with queued samples in the order they became ready. The
+     * publish callback only visits these items. */
+    TAILQ_HEAD(UA_ListOfReadyItems, UA_MonitoredItem) readyItems;
+    size_t queuedNotifications; /* sum of the queue sizes of the ready items */
+
+    TAILQ_HEAD(UA_ListOfNotificationMessages, UA_NotificationMessageEntry) retransmissionQueue;
+    size_t retransmissionQueueSize;
+
+    /* Bytes of the subscription, its items, samples and retransmissions. They
+     * are also charged to the session. */
+    size_t memory;
 };
 
+/* Tests if the subscription or its session would exceed their memory quota
+ * with the additional bytes */
+UA_Boolean
+UA_Subscription_exceedsMemory(const UA_Server *server, const UA_Subscription *sub,
+                              size_t bytes);
+
 UA_Subscription *UA_Subscription_new(UA_Session *session, UA_UInt32 subscriptionID);
 void UA_Subscription_deleteMembers(UA_Subscription *subscription, UA_Server *server);
 UA_StatusCode Subscription_registerPublishJob(UA_Server *server, UA_Subscription *sub);
@@ -116,4 +221,24 @@ UA_Subscription_getMonitoredItem(UA_Subscription *sub, UA_UInt32 monitoredItemID
 
 void UA_Subscription_publishCallback(UA_Server *server, UA_Subscription *sub);
 
+/* Moves the subscription with its samples and retransmissions to another
+ * session. The memory is charged to the new session. */
+void UA_Subscription_moveToSession(UA_Subscription *sub, UA_Session *session);
+
+/* Sends a StatusChangeNotification for the subscription with the next queued
+ * publish request of its session. Nothing is sent if the session has no
+ * publish request queued. */
+void UA_Subscription_sendStatusChange(UA_Server *server, UA_Subscription *sub,
+                                      UA_StatusCode status);
+
+/* The next sample of every item is queued, even if the value is unchanged */
+void UA_Subscription_resendValues(UA_Server *server, UA_Subscription *sub);
+
+/* Returns NULL if the message is no longer in the retransmission queue */
+UA_NotificationMessageEntry *
+UA_Subscription_getRetransmission(UA_Subscription *sub, UA_UInt32 sequenceNumber);
+
+UA_StatusCode
+UA_Subscription_removeRetransmission(UA_Subscription *sub, UA_UInt32 sequenceNumber);
+
 #endif /* UA_SUBSCRIPTION_H_ */
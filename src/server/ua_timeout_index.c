@@ -0,0 +1,115 @@
+#include "ua_timeout_index.h"
+#include "ua_util.h"
+
+#define TIMEOUTINDEX_MINSIZE 64
+
+void UA_TimeoutIndex_init(UA_TimeoutIndex *ti) {
+    ti->buckets = NULL;
+    ti->heap = NULL;
+    ti->capacity = 0;
+    ti->size = 0;
+}
+
+void UA_TimeoutIndex_deleteMembers(UA_TimeoutIndex *ti) {
+    UA_free(ti->buckets);
+    UA_free(ti->heap);
+    UA_TimeoutIndex_init(ti);
+}
+
+/* Both arrays are allocated before either is replaced. So the index stays
+   consistent when an allocation fails. */
+static UA_StatusCode grow(UA_TimeoutIndex *ti) {
+    size_t newSize = ti->capacity * 2;
+    if(newSize < TIMEOUTINDEX_MINSIZE)
+        newSize = TIMEOUTINDEX_MINSIZE;
+    struct UA_TimeoutBucket *buckets = UA_malloc(newSize * sizeof(struct UA_TimeoutBucket));
+    if(!buckets)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_TimeoutEntry **heap = UA_realloc(ti->heap, newSize * sizeof(UA_TimeoutEntry*));
+    if(!heap) {
+        UA_free(buckets);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    ti->heap = heap;
+
+    /* Rehash all entries into the new buckets */
+    for(size_t i = 0; i < newSize; i++)
+        LIST_INIT(&buckets[i]);
+    UA_free(ti->buckets);
+    ti->buckets = buckets;
+    ti->capacity = newSize;
+    for(size_t i = 0; i < ti->size; i++) {
+        UA_TimeoutEntry *entry = ti->heap[i];
+        LIST_INSERT_HEAD(UA_TimeoutIndex_bucket(ti, entry->hash), entry, pointers);
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/********/
+/* Heap */
+/********/
+
+static void heapSet(UA_TimeoutIndex *ti, size_t i, UA_TimeoutEntry *entry) {
+    ti->heap[i] = entry;
+    entry->heapIndex = i;
+}
+
+static void heapSiftUp(UA_TimeoutIndex *ti, size_t i) {
+    UA_TimeoutEntry *entry = ti->heap[i];
+    while(i > 0) {
+        size_t parent = (i - 1) / 2;
+        if(ti->heap[parent]->timeout <= entry->timeout)
+            break;
+        heapSet(ti, i, ti->heap[parent]);
+        i = parent;
+    }
+    heapSet(ti, i, entry);
+}
+
+static void heapSiftDown(UA_TimeoutIndex *ti, size_t i) {
+    UA_TimeoutEntry *entry = ti->heap[i];
+    while(true) {
+        size_t child = (2 * i) + 1;
+        if(child >= ti->size)
+            break;
+        if(child + 1 < ti->size && ti->heap[child + 1]->timeout < ti->heap[child]->timeout)
+            child++;
+        if(entry->timeout <= ti->heap[child]->timeout)
+            break;
+        heapSet(ti, i, ti->heap[child]);
+        i = child;
+    }
+    heapSet(ti, i, entry);
+}
+
+/*********/
+/* Index */
+/*********/
+
+UA_StatusCode UA_TimeoutIndex_insert(UA_TimeoutIndex *ti, UA_TimeoutEntry *entry) {
+    if(ti->size >= ti->capacity) {
+        UA_StatusCode retval = grow(ti);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    LIST_INSERT_HEAD(UA_TimeoutIndex_bucket(ti, entry->hash), entry, pointers);
+    ti->heap[ti->size] = entry;
+    ti->size++;
+    heapSiftUp(ti, ti->size - 1);
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_TimeoutIndex_remove(UA_TimeoutIndex *ti, UA_TimeoutEntry *entry) {
+    LIST_REMOVE(entry, pointers);
+    size_t i = entry->heapIndex;
+    ti->size--;
+    if(i == ti->size)
+        return;
+    heapSet(ti, i, ti->heap[ti->size]);
+    UA_TimeoutIndex_update(ti, ti->heap[i]);
+}
+
+void UA_TimeoutIndex_update(UA_TimeoutIndex *ti, UA_TimeoutEntry *entry) {
+    heapSiftUp(ti, entry->heapIndex);
+    heapSiftDown(ti, entry->heapIndex);
+}
@@ -0,0 +1,63 @@
+#ifndef UA_TIMEOUT_INDEX_H_
+#define UA_TIMEOUT_INDEX_H_
+
+#include "queue.h"
+#include "ua_types.h"
+
+/**
+ * Timeout Index
+ * -------------
+ * The entries are indexed by a hash in a hash table with a power of two
+ * buckets. Additionally, they are kept in a binary min-heap ordered by their
+ * timeout. So the cleanup only touches the entries that have actually timed
+ * out. The number of buckets and the heap capacity grow together. So the load
+ * factor of the hash table stays below one. The SecureChannels and Sessions
+ * of the server are kept in a timeout index.
+ *
+ * The entry is embedded in the indexed structure. The hash and the timeout are
+ * set before the entry is inserted. */
+
+typedef struct UA_TimeoutEntry {
+    LIST_ENTRY(UA_TimeoutEntry) pointers; /* entry in the bucket */
+    UA_UInt32 hash;
+    UA_DateTime timeout;
+    size_t heapIndex; /* current position in the heap */
+} UA_TimeoutEntry;
+
+LIST_HEAD(UA_TimeoutBucket, UA_TimeoutEntry);
+
+typedef struct {
+    struct UA_TimeoutBucket *buckets;
+    UA_TimeoutEntry **heap;
+    size_t capacity; /* number of buckets and the capacity of the heap */
+    size_t size; /* number of entries */
+} UA_TimeoutIndex;
+
+void UA_TimeoutIndex_init(UA_TimeoutIndex *ti);
+
+/* The entries themselves are not freed */
+void UA_TimeoutIndex_deleteMembers(UA_TimeoutIndex *ti);
+
+/* Grows the index if required. The index is unchanged if that fails. */
+UA_StatusCode UA_TimeoutIndex_insert(UA_TimeoutIndex *ti, UA_TimeoutEntry *entry);
+
+void UA_TimeoutIndex_remove(UA_TimeoutIndex *ti, UA_TimeoutEntry *entry);
+
+/* Call after the timeout of the entry was changed */
+void UA_TimeoutIndex_update(UA_TimeoutIndex *ti, UA_TimeoutEntry *entry);
+
+/* Returns the entry with the earliest timeout or NULL if the index is empty */
+static UA_INLINE UA_TimeoutEntry *
+UA_TimeoutIndex_first(const UA_TimeoutIndex *ti) {
+    return ti->size > 0 ? ti->heap[0] : NULL;
+}
+
+/* Returns the bucket of entries with the hash or NULL if the index is empty */
+static UA_INLINE struct UA_TimeoutBucket *
+UA_TimeoutIndex_bucket(const UA_TimeoutIndex *ti, UA_UInt32 hash) {
+    if(ti->capacity == 0)
+        return NULL;
+    return &ti->buckets[hash & (ti->capacity - 1)];
+}
+
+#endif /* UA_TIMEOUT_INDEX_H_ */
@@ -0,0 +1,58 @@
+#include "ua_util.h"
+#include "ua_types.h"
+
+typedef struct {
+    const UA_Allocator *allocator; /* NULL for UA_malloc */
+    UA_UInt32 size; /* including the header */
+    UA_UInt32 category;
+} UA_ObjHeader;
+
+#define UA_OBJALIGN (2 * sizeof(void*))
+#define UA_OBJHEADER ((sizeof(UA_ObjHeader) + UA_OBJALIGN - 1) & ~(UA_OBJALIGN - 1))
+
+/* Set before the server starts its threads */
+static const UA_Allocator *currentAllocator = NULL;
+
+void UA_setAllocator(const UA_Allocator *allocator) {
+    currentAllocator = allocator;
+}
+
+const UA_Allocator * UA_getAllocator(void) {
+    return currentAllocator;
+}
+
+void * UA_objalloc(UA_MemCategory category, size_t size) {
+    if(size > UA_UINT32_MAX - UA_OBJHEADER)
+        return NULL;
+    size += UA_OBJHEADER;
+    const UA_Allocator *allocator = currentAllocator;
+    UA_ObjHeader *h;
+    if(allocator)
+        h = allocator->alloc(allocator->context, category, size);
+    else
+        h = UA_malloc(size);
+    if(!h)
+        return NULL;
+    h->allocator = allocator;
+    h->size = (UA_UInt32)size;
+    h->category = (UA_UInt32)category;
+    return (void*)((uintptr_t)h + UA_OBJHEADER);
+}
+
+void * UA_objcalloc(UA_MemCategory category, size_t size) {
+    void *p = UA_objalloc(category, size);
+    if(p)
+        memset(p, 0, size);
+    return p;
+}
+
+void UA_objfree(void *p) {
+    if(!p)
+        return;
+    UA_ObjHeader *h = (UA_ObjHeader*)((uintptr_t)p - UA_OBJHEADER);
+    const UA_Allocator *allocator = h->allocator;
+    if(allocator)
+        allocator->free(allocator->context, (UA_MemCategory)h->category, h, h->size);
+    else
+        UA_free(h);
+}
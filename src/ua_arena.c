@@ -0,0 +1,62 @@
+#include "ua_util.h"
+#include "ua_arena.h"
+
+#define UA_ARENA_ALIGN (2 * sizeof(void*))
+#define UA_ARENA_MINBLOCKSIZE 4096
+
+struct UA_ArenaBlock {
+    UA_ArenaBlock *next;
+    size_t size;
+};
+
+/* The data of a block starts after the header with alignment */
+#define UA_ARENA_BLOCKHEADER \
+    ((sizeof(UA_ArenaBlock) + UA_ARENA_ALIGN - 1) & ~(UA_ARENA_ALIGN - 1))
+
+static UA_Byte * alignUp(UA_Byte *p) {
+    return (UA_Byte*)(((uintptr_t)p + UA_ARENA_ALIGN - 1) & ~(uintptr_t)(UA_ARENA_ALIGN - 1));
+}
+
+void UA_Arena_init(UA_Arena *arena, void *buf, size_t bufSize) {
+    arena->buf = buf;
+    arena->bufSize = buf ? bufSize : 0;
+    arena->pos = arena->buf;
+    arena->end = arena->buf + arena->bufSize;
+    arena->blocks = NULL;
+    arena->nextBlockSize = UA_ARENA_MINBLOCKSIZE;
+}
+
+void * UA_Arena_calloc(UA_Arena *arena, size_t size) {
+    UA_Byte *p = alignUp(arena->pos);
+    if(!arena->pos || p > arena->end || size > (size_t)(arena->end - p)) {
+        /* Allocate a new block. Large allocations get a block of their own. */
+        size_t blockSize = arena->nextBlockSize;
+        while(blockSize < size + UA_ARENA_BLOCKHEADER)
+            blockSize *= 2;
+        UA_ArenaBlock *block = UA_malloc(blockSize);
+        if(!block)
+            return NULL;
+        block->next = arena->blocks;
+        block->size = blockSize;
+        arena->blocks = block;
+        arena->nextBlockSize = blockSize * 2;
+        p = (UA_Byte*)block + UA_ARENA_BLOCKHEADER;
+        arena->end = (UA_Byte*)block + blockSize;
+    }
+    memset(p, 0, size);
+    arena->pos = p + size;
+    return p;
+}
+
+void UA_Arena_deleteMembers(UA_Arena *arena) {
+    UA_ArenaBlock *block = arena->blocks;
+    while(block) {
+        UA_ArenaBlock *next = block->next;
+        UA_free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->nextBlockSize = UA_ARENA_MINBLOCKSIZE;
+    arena->pos = arena->buf;
+    arena->end = arena->buf + arena->bufSize;
+}
@@ -0,0 +1,40 @@
+#ifndef UA_ARENA_H_
+#define UA_ARENA_H_
+
+#include "ua_types.h"
+
+/**
+ * Arena Allocator
+ * ---------------
+ * The arena hands out memory from large blocks. Individual allocations are
+ * never freed. Instead, the entire arena is cleaned up at once. This is used
+ * for data that lives only as long as a single request, e.g. the decoded
+ * request message.
+ *
+ * The first block can be provided by the user (e.g. on the stack). Further
+ * blocks are allocated on the heap with growing size when the first block is
+ * exhausted. */
+
+typedef struct UA_ArenaBlock UA_ArenaBlock;
+
+typedef struct {
+    UA_Byte *buf; /* the initial buffer */
+    size_t bufSize;
+    UA_Byte *pos; /* the free space in the current block */
+    UA_Byte *end;
+    UA_ArenaBlock *blocks; /* heap blocks, the current one first */
+    size_t nextBlockSize;
+} UA_Arena;
+
+/* Initialize the arena with an initial buffer. The buffer can be NULL. */
+void UA_Arena_init(UA_Arena *arena, void *buf, size_t bufSize);
+
+/* Returns zeroed memory that is aligned for all builtin types. Returns NULL if
+ * no further block could be allocated. */
+void * UA_Arena_calloc(UA_Arena *arena, size_t size);
+
+/* Frees the heap blocks. All memory taken from the arena becomes invalid. The
+ * arena can be used again afterwards, starting with the initial buffer. */
+void UA_Arena_deleteMembers(UA_Arena *arena);
+
+#endif /* UA_ARENA_H_ */
@@ -7,7 +7,9 @@
 // max message size is 64k
 const UA_ConnectionConfig UA_ConnectionConfig_standard =
     {.protocolVersion = 0, .sendBufferSize = 65535, .recvBufferSize = 65535,
-     .maxMessageSize = 1048576, .maxChunkCount = 16};
+     .maxMessageSize = 1048576, .maxChunkCount = 16,
+     .maxSendQueueSize = 4194304, .maxChunkedRequests = 16,
+     .maxChunkMemory = 4194304};
 
 void UA_Connection_init(UA_Connection *connection) {
     connection->state = UA_CONNECTION_CLOSED;
@@ -17,7 +19,9 @@ void UA_Connection_init(UA_Connection *connection) {
     connection->sockfd = 0;
     connection->handle = NULL;
     UA_ByteString_init(&connection->incompleteMessage);
+    connection->recvRing = NULL;
     connection->send = NULL;
+    connection->sendBatch = NULL;
     connection->close = NULL;
     connection->recv = NULL;
     connection->getSendBuffer = NULL;
@@ -25,65 +29,235 @@ void UA_Connection_init(UA_Connection *connection) {
     connection->releaseRecvBuffer = NULL;
 }
 
+/* The buffers of the receive ring. A buffer is replaced when the incomplete
+ * message has to be moved to the beginning while messages at the beginning are
+ * still processed. The replaced buffer is freed when the last view into it is
+ * released. */
+typedef struct RecvRingBuffer {
+    struct RecvRingBuffer *next; /* older buffers with views left */
+    size_t views;                /* messages handed out and not yet released */
+} RecvRingBuffer;
+
+#define RINGDATA(b) ((UA_Byte*)&(b)[1])
+
+struct UA_RecvRing {
+    RecvRingBuffer *buffer; /* the current buffer */
+    size_t size;            /* size of the buffers */
+    size_t start;           /* beginning of the incomplete message */
+    size_t end;             /* end of the received data */
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_Int32 lock;          /* the views are released by the worker threads */
+#endif
+};
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void RecvRing_lock(struct UA_RecvRing *ring) {
+    while(uatomic_cmpxchg(&ring->lock, 0, 1) != 0)
+        caa_cpu_relax();
+}
+
+static void RecvRing_unlock(struct UA_RecvRing *ring) {
+    cmm_smp_mb();
+    uatomic_set(&ring->lock, 0);
+}
+#else
+# define RecvRing_lock(ring)
+# define RecvRing_unlock(ring)
+#endif
+
+static RecvRingBuffer * RecvRingBuffer_new(size_t size) {
+    RecvRingBuffer *b = UA_malloc(sizeof(RecvRingBuffer) + size);
+    if(!b)
+        return NULL;
+    b->next = NULL;
+    b->views = 0;
+    return b;
+}
+
 void UA_Connection_deleteMembers(UA_Connection *connection) {
     UA_ByteString_deleteMembers(&connection->incompleteMessage);
+    struct UA_RecvRing *ring = connection->recvRing;
+    if(!ring)
+        return;
+    RecvRingBuffer *b = ring->buffer;
+    while(b) {
+        RecvRingBuffer *next = b->next;
+        UA_free(b);
+        b = next;
+    }
+    UA_free(ring);
+    connection->recvRing = NULL;
 }
 
 UA_StatusCode
-UA_Connection_completeMessages(UA_Connection *connection, UA_ByteString * UA_RESTRICT message,
-                              UA_Boolean * UA_RESTRICT realloced) {
-    UA_ByteString *current = message;
-    *realloced = false;
-    if(connection->incompleteMessage.length > 0) {
-        /* concat the existing incomplete message with the new message */
-        UA_Byte *data = UA_realloc(connection->incompleteMessage.data,
-                                   connection->incompleteMessage.length + message->length);
-        if(!data) {
-            /* not enough memory */
-            UA_ByteString_deleteMembers(&connection->incompleteMessage);
-            connection->releaseRecvBuffer(connection, message);
+UA_Connection_getRecvSpace(UA_Connection *connection, UA_ByteString *space) {
+    size_t minSpace = connection->localConf.recvBufferSize;
+    struct UA_RecvRing *ring = connection->recvRing;
+    if(!ring) {
+        /* an incomplete message is shorter than recvBufferSize. so there is
+           always room for a full receive after it is moved to the beginning */
+        ring = UA_malloc(sizeof(struct UA_RecvRing));
+        if(!ring)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        ring->size = 2 * minSpace;
+        ring->buffer = RecvRingBuffer_new(ring->size);
+        if(!ring->buffer) {
+            UA_free(ring);
             return UA_STATUSCODE_BADOUTOFMEMORY;
         }
-        memcpy(&data[connection->incompleteMessage.length], message->data, message->length);
-        connection->incompleteMessage.data = data;
-        connection->incompleteMessage.length += message->length;
-        connection->releaseRecvBuffer(connection, message);
-        current = &connection->incompleteMessage;
-        *realloced = true;
+        ring->start = 0;
+        ring->end = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+        ring->lock = 0;
+#endif
+        connection->recvRing = ring;
+    }
+
+    if(ring->size - ring->end < minSpace) {
+        /* move the incomplete message to the beginning. take a new buffer if
+           the messages at the beginning are not yet processed. */
+        size_t rest = ring->end - ring->start;
+        RecvRing_lock(ring);
+        RecvRingBuffer *b = ring->buffer;
+        if(b->views == 0) {
+            memmove(RINGDATA(b), &RINGDATA(b)[ring->start], rest);
+        } else {
+            RecvRingBuffer *nb = RecvRingBuffer_new(ring->size);
+            if(!nb) {
+                RecvRing_unlock(ring);
+                return UA_STATUSCODE_BADOUTOFMEMORY;
+            }
+            memcpy(RINGDATA(nb), &RINGDATA(b)[ring->start], rest);
+            nb->next = b;
+            ring->buffer = nb;
+        }
+        RecvRing_unlock(ring);
+        ring->start = 0;
+        ring->end = rest;
+    }
+
+    space->data = &RINGDATA(ring->buffer)[ring->end];
+    space->length = ring->size - ring->end;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean
+UA_Connection_releaseRecvRing(UA_Connection *connection, UA_ByteString *buf) {
+    struct UA_RecvRing *ring = connection->recvRing;
+    if(!ring || !buf->data)
+        return false;
+    UA_Boolean found = false;
+    RecvRing_lock(ring);
+    for(RecvRingBuffer **b = &ring->buffer; *b; b = &(*b)->next) {
+        const UA_Byte *data = RINGDATA(*b);
+        if(buf->data < data || buf->data >= &data[ring->size])
+            continue;
+        found = true;
+        (*b)->views--;
+        if((*b)->views == 0 && *b != ring->buffer) {
+            RecvRingBuffer *old = *b;
+            *b = old->next;
+            UA_free(old);
+        }
+        break;
     }
+    RecvRing_unlock(ring);
+    if(found)
+        UA_ByteString_init(buf);
+    return found;
+}
 
-    /* the while loop sets offset to the first element after the last complete message. if a message
-       contains garbage, the buffer length is set to contain only the "good" messages before. */
+/* Returns the length of the complete messages at the beginning of the buffer.
+ * The garbage flag is set if the message after them is invalid. */
+static size_t
+completeLength(const UA_Connection *connection, const UA_ByteString *buf, UA_Boolean *garbage) {
     size_t offset = 0;
-    size_t delete_at = current->length-1; // garbled message after this point
-    while(current->length - offset >= 16) {
-        UA_UInt32 msgtype = (UA_UInt32)current->data[offset] +
-            ((UA_UInt32)current->data[offset+1] << 8) +
-            ((UA_UInt32)current->data[offset+2] << 16);
+    *garbage = false;
+    while(buf->length - offset >= 16) {
+        UA_UInt32 msgtype = (UA_UInt32)buf->data[offset] +
+            ((UA_UInt32)buf->data[offset+1] << 8) +
+            ((UA_UInt32)buf->data[offset+2] << 16);
         if(msgtype != ('M' + ('S' << 8) + ('G' << 16)) &&
            msgtype != ('O' + ('P' << 8) + ('N' << 16)) &&
            msgtype != ('H' + ('E' << 8) + ('L' << 16)) &&
            msgtype != ('A' + ('C' << 8) + ('K' << 16)) &&
            msgtype != ('C' + ('L' << 8) + ('O' << 16))) {
             /* the message type is not recognized */
-            delete_at = offset; // throw the remaining message away
+            *garbage = true;
             break;
         }
         UA_UInt32 length = 0;
         size_t length_pos = offset + 4;
-        UA_StatusCode retval = UA_UInt32_decodeBinary(current, &length_pos, &length);
+        UA_StatusCode retval = UA_UInt32_decodeBinary(buf, &length_pos, &length);
         if(retval != UA_STATUSCODE_GOOD || length < 16 || length > connection->localConf.recvBufferSize) {
-            /* the message size is not allowed. throw the remaining bytestring away */
-            delete_at = offset;
+            /* the message size is not allowed */
+            *garbage = true;
             break;
         }
-        if(length + offset > current->length)
+        if(length + offset > buf->length)
             break; /* the message is incomplete. keep the beginning */
         offset += length;
     }
+    return offset;
+}
+
+/* The message was received into the ring. Hand out the complete messages as a
+ * view and leave the incomplete rest in place. */
+static UA_StatusCode
+completeRecvRing(UA_Connection *connection, struct UA_RecvRing *ring,
+                 UA_ByteString * UA_RESTRICT message) {
+    ring->end += message->length;
+    UA_ByteString current = {ring->end - ring->start, &RINGDATA(ring->buffer)[ring->start]};
+    UA_Boolean garbage;
+    size_t offset = completeLength(connection, &current, &garbage);
+    if(garbage)
+        ring->end = ring->start + offset; /* throw the invalid rest away */
+    UA_ByteString_init(message);
+    if(offset == 0)
+        return UA_STATUSCODE_GOOD;
+    message->data = current.data;
+    message->length = offset;
+    ring->start += offset;
+    RecvRing_lock(ring);
+    ring->buffer->views++;
+    RecvRing_unlock(ring);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_Connection_completeMessages(UA_Connection *connection, UA_ByteString * UA_RESTRICT message,
+                              UA_Boolean * UA_RESTRICT realloced) {
+    *realloced = false;
+    struct UA_RecvRing *ring = connection->recvRing;
+    if(ring && message->data == &RINGDATA(ring->buffer)[ring->end])
+        return completeRecvRing(connection, ring, message);
+
+    UA_ByteString *current = message;
+    if(connection->incompleteMessage.length > 0) {
+        /* concat the existing incomplete message with the new message */
+        UA_Byte *data = UA_realloc(connection->incompleteMessage.data,
+                                   connection->incompleteMessage.length + message->length);
+        if(!data) {
+            /* not enough memory */
+            UA_ByteString_deleteMembers(&connection->incompleteMessage);
+            connection->releaseRecvBuffer(connection, message);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+        memcpy(&data[connection->incompleteMessage.length], message->data, message->length);
+        connection->incompleteMessage.data = data;
+        connection->incompleteMessage.length += message->length;
+        connection->releaseRecvBuffer(connection, message);
+        current = &connection->incompleteMessage;
+        *realloced = true;
+    }
+
+    /* offset is set to the first element after the last complete message. if
+       the first message contains garbage, the buffer is thrown away. */
+    UA_Boolean garbage;
+    size_t offset = completeLength(connection, current, &garbage);
 
     /* throw the message away */
-    if(delete_at == 0) {
+    if(garbage && offset == 0) {
         if(!*realloced) {
             connection->releaseRecvBuffer(connection, message);
             *realloced = true;
@@ -13,6 +13,11 @@
  * is received, we copy it into a local buffer. Then, the stack-specific free
  * needs to be used.
  *
+ * If the message was received into the receive ring of the connection (see
+ * UA_Connection_getRecvSpace), the complete messages are returned as a view
+ * into the ring and realloced remains false. The view is released with the
+ * releaseRecvBuffer callback of the connection.
+ *
  * @param connection The connection
  * @param message The received message. The content may be overwritten when a
  *        previsouly received buffer is completed.
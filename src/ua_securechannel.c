@@ -6,6 +6,7 @@
 #include "ua_transport_generated_encoding_binary.h"
 
 #define UA_SECURE_MESSAGE_HEADER_LENGTH 24
+#define UA_SYMMETRIC_SECURITY_HEADER_END 16 /* encryption starts behind it */
 
 void UA_SecureChannel_init(UA_SecureChannel *channel) {
     UA_MessageSecurityMode_init(&channel->securityMode);
@@ -19,7 +20,11 @@ void UA_SecureChannel_init(UA_SecureChannel *channel) {
     channel->sendSequenceNumber = 0;
     channel->connection = NULL;
     LIST_INIT(&channel->sessions);
-    LIST_INIT(&channel->chunks);
+    for(size_t i = 0; i < UA_CHUNKINDEXSIZE; i++)
+        LIST_INIT(&channel->chunks[i]);
+    channel->chunkMemory = 0;
+    channel->chunkRequests = 0;
+    memset(&channel->crypto, 0, sizeof(UA_SymmetricCrypto));
 }
 
 void UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
@@ -30,6 +35,9 @@ void UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
     UA_ByteString_deleteMembers(&channel->clientNonce);
     UA_ChannelSecurityToken_deleteMembers(&channel->securityToken);
     UA_ChannelSecurityToken_deleteMembers(&channel->nextSecurityToken);
+    if(channel->crypto.deleteMembers)
+        channel->crypto.deleteMembers(channel->crypto.context);
+    memset(&channel->crypto, 0, sizeof(UA_SymmetricCrypto));
 
     /* Detach from the channel */
     if(channel->connection)
@@ -46,11 +54,15 @@ void UA_SecureChannel_deleteMembersCleanup(UA_SecureChannel *channel) {
 
     /* Remove the buffered chunks */
     struct ChunkEntry *ch, *temp_ch;
-    LIST_FOREACH_SAFE(ch, &channel->chunks, pointers, temp_ch) {
-        UA_ByteString_deleteMembers(&ch->bytes);
-        LIST_REMOVE(ch, pointers);
-        UA_free(ch);
+    for(size_t i = 0; i < UA_CHUNKINDEXSIZE; i++) {
+        LIST_FOREACH_SAFE(ch, &channel->chunks[i], pointers, temp_ch) {
+            UA_ByteString_deleteMembers(&ch->bytes);
+            LIST_REMOVE(ch, pointers);
+            UA_objfree(ch);
+        }
     }
+    channel->chunkMemory = 0;
+    channel->chunkRequests = 0;
 }
 
 //TODO implement real nonce generator - DUMMY function
@@ -127,12 +139,113 @@ void UA_SecureChannel_revolveTokens(UA_SecureChannel *channel) {
     UA_ChannelSecurityToken_init(&channel->nextSecurityToken);
 }
 
+/************/
+/* Security */
+/************/
+
+static UA_Boolean signsChunks(const UA_SecureChannel *channel) {
+    return channel->crypto.sign &&
+        (channel->securityMode == UA_MESSAGESECURITYMODE_SIGN ||
+         channel->securityMode == UA_MESSAGESECURITYMODE_SIGNANDENCRYPT);
+}
+
+static UA_Boolean encryptsChunks(const UA_SecureChannel *channel) {
+    return channel->crypto.encrypt &&
+        channel->securityMode == UA_MESSAGESECURITYMODE_SIGNANDENCRYPT;
+}
+
+void UA_SecureChannel_setCrypto(UA_SecureChannel *channel, const UA_SymmetricCrypto *crypto) {
+    if(channel->crypto.deleteMembers)
+        channel->crypto.deleteMembers(channel->crypto.context);
+    channel->crypto = *crypto;
+}
+
+size_t UA_SecureChannel_securityTrailerLength(const UA_SecureChannel *channel) {
+    if(!signsChunks(channel))
+        return 0;
+    size_t length = channel->crypto.signatureSize;
+    if(encryptsChunks(channel))
+        length += channel->crypto.blockSize; /* the padding is at most one block */
+    return length;
+}
+
+/* The padding bytes (including the byte with the padding size) behind content
+ * that ends at the offset */
+static size_t paddingLength(const UA_SecureChannel *channel, size_t offset) {
+    if(!encryptsChunks(channel))
+        return 0;
+    size_t blockSize = channel->crypto.blockSize;
+    size_t length = offset - UA_SYMMETRIC_SECURITY_HEADER_END + 1 + channel->crypto.signatureSize;
+    return 1 + ((blockSize - (length % blockSize)) % blockSize);
+}
+
+/* Appends the padding and the signature to the content that ends at the offset
+ * and encrypts the chunk. The headers are already encoded. */
+static UA_StatusCode
+protectChunk(UA_SecureChannel *channel, UA_ByteString *chunk, size_t offset, size_t padding) {
+    UA_SymmetricCrypto *crypto = &channel->crypto;
+    memset(&chunk->data[offset], (UA_Byte)(padding - 1), padding);
+    offset += padding;
+    UA_StatusCode retval = crypto->sign(crypto->context, chunk->data, offset, &chunk->data[offset]);
+    if(retval != UA_STATUSCODE_GOOD || !encryptsChunks(channel))
+        return retval;
+    offset += crypto->signatureSize;
+    return crypto->encrypt(crypto->context, &chunk->data[UA_SYMMETRIC_SECURITY_HEADER_END],
+                           offset - UA_SYMMETRIC_SECURITY_HEADER_END);
+}
+
+UA_StatusCode
+UA_SecureChannel_unprotectChunk(UA_SecureChannel *channel, UA_ByteString *chunk,
+                                size_t *contentLength) {
+    *contentLength = chunk->length;
+    if(!signsChunks(channel))
+        return UA_STATUSCODE_GOOD;
+
+    UA_SymmetricCrypto *crypto = &channel->crypto;
+    UA_Boolean encrypted = encryptsChunks(channel);
+    if(chunk->length < UA_SECURE_MESSAGE_HEADER_LENGTH + crypto->signatureSize + encrypted)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+    if(encrypted) {
+        size_t length = chunk->length - UA_SYMMETRIC_SECURITY_HEADER_END;
+        if(length % crypto->blockSize != 0)
+            return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+        if(crypto->decrypt(crypto->context, &chunk->data[UA_SYMMETRIC_SECURITY_HEADER_END],
+                           length) != UA_STATUSCODE_GOOD)
+            return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+    }
+
+    size_t length = chunk->length - crypto->signatureSize;
+    if(crypto->verify(crypto->context, chunk->data, length, &chunk->data[length]) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+
+    /* The padding is covered by the signature */
+    if(encrypted) {
+        size_t padding = (size_t)chunk->data[length - 1] + 1;
+        if(padding > length - UA_SECURE_MESSAGE_HEADER_LENGTH)
+            return UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+        length -= padding;
+    }
+    *contentLength = length;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Send the collected chunks */
+static void
+UA_SecureChannel_flushChunks(UA_ChunkInfo *ci) {
+    if(ci->batchSize == 0)
+        return;
+    ci->batchConnection->sendBatch(ci->batchConnection, ci->batch, ci->batchSize);
+    ci->batchSize = 0;
+}
+
 static UA_StatusCode
 UA_SecureChannel_sendChunk(UA_ChunkInfo *ci, UA_ByteString *dst, size_t offset) {
     UA_SecureChannel *channel = ci->channel;
     UA_Connection *connection = channel->connection;
-    if(!connection)
-       return UA_STATUSCODE_BADINTERNALERROR;
+    if(!connection) {
+        UA_SecureChannel_flushChunks(ci);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
 
     /* adjust the buffer where the header was hidden */
     dst->data = &dst->data[-UA_SECURE_MESSAGE_HEADER_LENGTH];
@@ -162,8 +275,12 @@ UA_SecureChannel_sendChunk(UA_ChunkInfo *ci, UA_ByteString *dst, size_t offset)
         UA_UInt32_encodeBinary(&ci->errorCode, dst, &offset);
         UA_String_encodeBinary(&errorMsg, dst, &offset);
     }
-    respHeader.messageHeader.messageSize = (UA_UInt32)offset;
-    ci->messageSizeSoFar += offset;
+    size_t padding = paddingLength(channel, offset);
+    size_t chunkLength = offset;
+    if(signsChunks(channel))
+        chunkLength += padding + channel->crypto.signatureSize;
+    respHeader.messageHeader.messageSize = (UA_UInt32)chunkLength;
+    ci->messageSizeSoFar += chunkLength;
 
     /* Encode the header at the beginning of the buffer */
     UA_SymmetricAlgorithmSecurityHeader symSecHeader;
@@ -180,115 +297,283 @@ UA_SecureChannel_sendChunk(UA_ChunkInfo *ci, UA_ByteString *dst, size_t offset)
     UA_SymmetricAlgorithmSecurityHeader_encodeBinary(&symSecHeader, dst, &offset_header);
     UA_SequenceHeader_encodeBinary(&seqHeader, dst, &offset_header);
 
-    /* Send the chunk, the buffer is freed in the network layer */
-    dst->length = offset; /* set the buffer length to the content length */
-    connection->send(channel->connection, dst);
+    /* Sign and encrypt in the send buffer. The room for the padding and the
+     * signature was left free behind the content. */
+    if(signsChunks(channel)) {
+        UA_StatusCode retval = protectChunk(channel, dst, offset, padding);
+        if(retval != UA_STATUSCODE_GOOD) {
+            connection->releaseSendBuffer(connection, dst);
+            UA_ByteString_init(dst);
+            UA_SecureChannel_flushChunks(ci);
+            ci->final = true; /* no abort chunk is sent */
+            ci->errorCode = retval;
+            return retval;
+        }
+    }
+
+    /* Send the chunk, the buffer is freed in the network layer. If the
+     * connection can send several buffers at once, the chunks are collected
+     * and sent together. */
+    dst->length = chunkLength; /* set the buffer length to the content length */
+    if(connection->sendBatch) {
+        if(ci->batchSize > 0 && ci->batchConnection != connection)
+            UA_SecureChannel_flushChunks(ci);
+        ci->batchConnection = connection;
+        ci->batch[ci->batchSize++] = *dst;
+        UA_ByteString_init(dst);
+        if(ci->final || ci->batchSize == UA_CHUNKBATCH)
+            UA_SecureChannel_flushChunks(ci);
+    } else {
+        connection->send(channel->connection, dst);
+    }
 
     /* Replace with the buffer for the next chunk */
     if(!ci->final) {
         UA_StatusCode retval = connection->getSendBuffer(connection, connection->localConf.sendBufferSize, dst);
-        if(retval != UA_STATUSCODE_GOOD)
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_SecureChannel_flushChunks(ci);
             return retval;
-        /* Hide the header of the buffer, so that the ensuing encoding does not overwrite anything */
+        }
+        /* Hide the header and the security trailer of the buffer, so that the
+         * ensuing encoding does not overwrite anything */
         dst->data = &dst->data[UA_SECURE_MESSAGE_HEADER_LENGTH];
-        dst->length = connection->localConf.sendBufferSize - UA_SECURE_MESSAGE_HEADER_LENGTH;
+        dst->length = connection->localConf.sendBufferSize - UA_SECURE_MESSAGE_HEADER_LENGTH -
+            UA_SecureChannel_securityTrailerLength(channel);
     }
     return ci->errorCode;
 }
 
 UA_StatusCode
-UA_SecureChannel_sendBinaryMessage(UA_SecureChannel *channel, UA_UInt32 requestId, const void *content,
-                                   const UA_DataType *contentType) {
+UA_SecureChannel_beginMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
+                              const UA_DataType *contentType, UA_MessageContext *mc) {
     UA_Connection *connection = channel->connection;
     if(!connection)
         return UA_STATUSCODE_BADINTERNALERROR;
 
     /* Allocate the message buffer */
-    UA_ByteString message;
-    UA_StatusCode retval = connection->getSendBuffer(connection, connection->localConf.sendBufferSize, &message);
+    UA_StatusCode retval = connection->getSendBuffer(connection, connection->localConf.sendBufferSize, &mc->buf);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
 
-    /* Hide the message beginning where the header will be encoded */
-    message.data = &message.data[UA_SECURE_MESSAGE_HEADER_LENGTH];
-    message.length -= UA_SECURE_MESSAGE_HEADER_LENGTH;
+    /* Hide the message beginning where the header will be encoded and the end
+     * where the padding and the signature will be added */
+    mc->buf.data = &mc->buf.data[UA_SECURE_MESSAGE_HEADER_LENGTH];
+    mc->buf.length -= UA_SECURE_MESSAGE_HEADER_LENGTH +
+        UA_SecureChannel_securityTrailerLength(channel);
 
     /* Encode the message type */
-    size_t messagePos = 0;
+    mc->offset = 0;
     UA_NodeId typeId = contentType->typeId; /* always numeric */
     typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
-    UA_NodeId_encodeBinary(&typeId, &message, &messagePos);
-
-    /* Encode with the chunking callback */
-    UA_ChunkInfo ci;
-    ci.channel = channel;
-    ci.requestId = requestId;
-    ci.chunksSoFar = 0;
-    ci.messageSizeSoFar = 0;
-    ci.final = false;
-    ci.messageType = UA_MESSAGETYPE_MSG;
-    ci.errorCode = UA_STATUSCODE_GOOD;
+    UA_NodeId_encodeBinary(&typeId, &mc->buf, &mc->offset);
+
+    /* Set up the chunking callback */
+    UA_ChunkInfo *ci = &mc->ci;
+    ci->channel = channel;
+    ci->requestId = requestId;
+    ci->chunksSoFar = 0;
+    ci->messageSizeSoFar = 0;
+    ci->final = false;
+    ci->messageType = UA_MESSAGETYPE_MSG;
+    ci->errorCode = UA_STATUSCODE_GOOD;
+    ci->batchConnection = NULL;
+    ci->batchSize = 0;
     if(typeId.identifier.numeric == 446 || typeId.identifier.numeric == 449)
-        ci.messageType = UA_MESSAGETYPE_OPN;
+        ci->messageType = UA_MESSAGETYPE_OPN;
     else if(typeId.identifier.numeric == 452 || typeId.identifier.numeric == 455)
-        ci.messageType = UA_MESSAGETYPE_CLO;
-    retval = UA_encodeBinary(content, contentType, (UA_exchangeEncodeBuffer)UA_SecureChannel_sendChunk,
-                             &ci, &message, &messagePos);
+        ci->messageType = UA_MESSAGETYPE_CLO;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_SecureChannel_encodeMessage(UA_MessageContext *mc, const void *content, const UA_DataType *type) {
+    return UA_encodeBinary(content, type, (UA_exchangeEncodeBuffer)UA_SecureChannel_sendChunk,
+                           &mc->ci, &mc->buf, &mc->offset);
+}
+
+UA_StatusCode
+UA_SecureChannel_encodeMessageArray(UA_MessageContext *mc, const void *array,
+                                    size_t arraySize, const UA_DataType *type) {
+    if(arraySize > UA_INT32_MAX)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Int32 length = -1;
+    if(arraySize > 0)
+        length = (UA_Int32)arraySize;
+    else if(array == UA_EMPTY_ARRAY_SENTINEL)
+        length = 0;
+    UA_StatusCode retval = UA_SecureChannel_encodeMessage(mc, &length, &UA_TYPES[UA_TYPES_INT32]);
+    uintptr_t ptr = (uintptr_t)array;
+    for(size_t i = 0; i < arraySize && retval == UA_STATUSCODE_GOOD; i++) {
+        retval = UA_SecureChannel_encodeMessage(mc, (const void*)ptr, type);
+        ptr += type->memSize;
+    }
+    return retval;
+}
 
+UA_StatusCode
+UA_SecureChannel_writeMessageBytes(UA_MessageContext *mc, const UA_ByteString *bytes) {
+    size_t written = 0;
+    while(written < bytes->length) {
+        /* Send the full chunk and continue in the next */
+        if(mc->offset >= mc->buf.length) {
+            UA_StatusCode retval = UA_SecureChannel_sendChunk(&mc->ci, &mc->buf, mc->offset);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            mc->offset = 0;
+        }
+        size_t n = mc->buf.length - mc->offset;
+        if(n > bytes->length - written)
+            n = bytes->length - written;
+        memcpy(&mc->buf.data[mc->offset], &bytes->data[written], n);
+        mc->offset += n;
+        written += n;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode
+UA_SecureChannel_finishMessage(UA_MessageContext *mc, UA_StatusCode error) {
     /* Encoding failed, release the message */
-    if(retval != UA_STATUSCODE_GOOD) {
-        if(!ci.final) {
+    if(error != UA_STATUSCODE_GOOD) {
+        if(!mc->ci.final) {
             /* the abort message was not send */
-            ci.errorCode = retval;
-            UA_SecureChannel_sendChunk(&ci, &message, messagePos);
+            mc->ci.errorCode = error;
+            UA_SecureChannel_sendChunk(&mc->ci, &mc->buf, mc->offset);
         }
-        return retval;
+        return error;
     }
 
     /* Encoding finished, send the final chunk */
-    ci.final = UA_TRUE;
-    return UA_SecureChannel_sendChunk(&ci, &message, messagePos);
+    mc->ci.final = UA_TRUE;
+    return UA_SecureChannel_sendChunk(&mc->ci, &mc->buf, mc->offset);
 }
 
-/* assume that chunklength fits */
-static void appendChunk(struct ChunkEntry *ch, const UA_ByteString *msg,
-                        size_t offset, size_t chunklength) {
-    UA_Byte* new_bytes = UA_realloc(ch->bytes.data, ch->bytes.length + chunklength);
-    if(!new_bytes) {
-        UA_ByteString_deleteMembers(&ch->bytes);
-        return;
+UA_StatusCode
+UA_SecureChannel_sendBinaryMessage(UA_SecureChannel *channel, UA_UInt32 requestId, const void *content,
+                                   const UA_DataType *contentType) {
+    UA_MessageContext mc;
+    UA_StatusCode retval = UA_SecureChannel_beginMessage(channel, requestId, contentType, &mc);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = UA_SecureChannel_encodeMessage(&mc, content, contentType);
+    return UA_SecureChannel_finishMessage(&mc, retval);
+}
+
+static struct ChunkEntry *
+findChunkEntry(UA_SecureChannel *channel, UA_UInt32 requestId) {
+    struct ChunkEntry *ch;
+    LIST_FOREACH(ch, &channel->chunks[requestId % UA_CHUNKINDEXSIZE], pointers) {
+        if(ch->requestId == requestId)
+            return ch;
     }
-    ch->bytes.data = new_bytes;
-    memcpy(&ch->bytes.data[ch->bytes.length], &msg->data[offset], chunklength);
-    ch->bytes.length += chunklength;
+    return NULL;
 }
 
-void UA_SecureChannel_appendChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
-                                  const UA_ByteString *msg, size_t offset, size_t chunklength) {
-    /* Check if the chunk fits into the message */
-    if(msg->length - offset < chunklength) {
-        UA_SecureChannel_removeChunk(channel, requestId); /* can't process all chunks for that request */
-        return;
+static void deleteChunkEntry(UA_SecureChannel *channel, struct ChunkEntry *ch) {
+    channel->chunkMemory -= ch->capacity;
+    channel->chunkRequests--;
+    UA_ByteString_deleteMembers(&ch->bytes);
+    LIST_REMOVE(ch, pointers);
+    UA_objfree(ch);
+}
+
+/* Keep the entry without the bytes. The remaining chunks of the request are
+ * dropped until the final or abort chunk arrives. */
+static void abortChunkEntry(UA_SecureChannel *channel, struct ChunkEntry *ch,
+                            UA_StatusCode status) {
+    channel->chunkMemory -= ch->capacity;
+    ch->capacity = 0;
+    UA_ByteString_deleteMembers(&ch->bytes);
+    ch->status = status;
+}
+
+/* The limits are those that were sent to the remote end in the ACK message. 0
+ * is unlimited. */
+static const UA_ConnectionConfig *
+chunkLimits(UA_SecureChannel *channel) {
+    if(channel->connection)
+        return &channel->connection->localConf;
+    return &UA_ConnectionConfig_standard;
+}
+
+static UA_StatusCode
+checkChunkLimits(const UA_ConnectionConfig *conf, struct ChunkEntry *ch, size_t chunklength) {
+    if((conf->maxChunkCount > 0 && ++ch->chunksSoFar > conf->maxChunkCount) ||
+       (conf->maxMessageSize > 0 && ch->bytes.length + chunklength > conf->maxMessageSize))
+        return UA_STATUSCODE_BADTCPMESSAGETOOLARGE;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Assume that chunklength fits. The capacity doubles from the actual length,
+ * up to maxMessageSize. The memory of all requests on the channel stays below
+ * maxChunkMemory. */
+static UA_StatusCode
+appendChunk(UA_SecureChannel *channel, struct ChunkEntry *ch, const UA_ByteString *msg,
+            size_t offset, size_t chunklength) {
+    const UA_ConnectionConfig *conf = chunkLimits(channel);
+    if(checkChunkLimits(conf, ch, chunklength) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADTCPMESSAGETOOLARGE;
+
+    size_t length = ch->bytes.length + chunklength;
+
+    if(length > ch->capacity) {
+        size_t capacity = ch->capacity * 2;
+        if(capacity < length)
+            capacity = length;
+        if(conf->maxMessageSize > 0 && capacity > conf->maxMessageSize)
+            capacity = conf->maxMessageSize;
+        if(conf->maxChunkMemory > 0 &&
+           channel->chunkMemory + capacity - ch->capacity > conf->maxChunkMemory) {
+            capacity = length;
+            if(channel->chunkMemory + capacity - ch->capacity > conf->maxChunkMemory)
+                return UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES;
+        }
+        UA_Byte* new_bytes = UA_realloc(ch->bytes.data, capacity);
+        if(!new_bytes)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        ch->bytes.data = new_bytes;
+        channel->chunkMemory += capacity - ch->capacity;
+        ch->capacity = capacity;
     }
+    memcpy(&ch->bytes.data[ch->bytes.length], &msg->data[offset], chunklength);
+    ch->bytes.length = length;
+    return UA_STATUSCODE_GOOD;
+}
 
+UA_StatusCode
+UA_SecureChannel_appendChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
+                             const UA_ByteString *msg, size_t offset, size_t chunklength) {
     /* Get the chunkentry */
-    struct ChunkEntry *ch;
-    LIST_FOREACH(ch, &channel->chunks, pointers) {
-        if(ch->requestId == requestId)
-            break;
-    }
+    struct ChunkEntry *ch = findChunkEntry(channel, requestId);
 
     /* No chunkentry on the channel, create one */
     if(!ch) {
-        ch = UA_malloc(sizeof(struct ChunkEntry));
+        const UA_ConnectionConfig *conf = chunkLimits(channel);
+        if(conf->maxChunkedRequests > 0 && channel->chunkRequests >= conf->maxChunkedRequests)
+            return UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES;
+        ch = UA_objalloc(UA_MEMCATEGORY_NETWORK, sizeof(struct ChunkEntry));
         if(!ch)
-            return;
+            return UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES;
         ch->requestId = requestId;
+        ch->chunksSoFar = 0;
+        ch->status = UA_STATUSCODE_GOOD;
+        ch->capacity = 0;
         UA_ByteString_init(&ch->bytes);
-        LIST_INSERT_HEAD(&channel->chunks, ch, pointers);
+        LIST_INSERT_HEAD(&channel->chunks[requestId % UA_CHUNKINDEXSIZE], ch, pointers);
+        channel->chunkRequests++;
     }
 
-    appendChunk(ch, msg, offset, chunklength);
+    /* The request was aborted before. Drop the chunk. */
+    if(ch->status != UA_STATUSCODE_GOOD)
+        return ch->status;
+
+    /* Check if the chunk fits into the message */
+    UA_StatusCode retval = UA_STATUSCODE_BADDECODINGERROR;
+    if(msg->length - offset >= chunklength)
+        retval = appendChunk(channel, ch, msg, offset, chunklength);
+    if(retval != UA_STATUSCODE_GOOD)
+        abortChunkEntry(channel, ch, retval); /* the request cannot be completed */
+    return retval;
 }
 
 UA_ByteString UA_SecureChannel_finalizeChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
@@ -299,35 +584,51 @@ UA_ByteString UA_SecureChannel_finalizeChunk(UA_SecureChannel *channel, UA_UInt3
         return UA_BYTESTRING_NULL;
     }
 
-    struct ChunkEntry *ch;
-    LIST_FOREACH(ch, &channel->chunks, pointers) {
-        if(ch->requestId == requestId)
-            break;
-    }
-
+    struct ChunkEntry *ch = findChunkEntry(channel, requestId);
     UA_ByteString bytes;
     if(!ch) {
         *deleteChunk = false;
         bytes.length = chunklength;
         bytes.data = msg->data + offset;
+    } else if(ch->status != UA_STATUSCODE_GOOD ||
+              appendChunk(channel, ch, msg, offset, chunklength) != UA_STATUSCODE_GOOD) {
+        deleteChunkEntry(channel, ch);
+        return UA_BYTESTRING_NULL;
     } else {
         *deleteChunk = true;
-        appendChunk(ch, msg, offset, chunklength);
         bytes = ch->bytes;
-        LIST_REMOVE(ch, pointers);
-        UA_free(ch);
+        UA_ByteString_init(&ch->bytes);
+        deleteChunkEntry(channel, ch);
     }
     return bytes;
 }
 
-void UA_SecureChannel_removeChunk(UA_SecureChannel *channel, UA_UInt32 requestId) {
-    struct ChunkEntry *ch;
-    LIST_FOREACH(ch, &channel->chunks, pointers) {
-        if(ch->requestId == requestId) {
-            UA_ByteString_deleteMembers(&ch->bytes);
-            LIST_REMOVE(ch, pointers);
-            UA_free(ch);
-            return;
-        }
+UA_StatusCode
+UA_SecureChannel_takeChunks(UA_SecureChannel *channel, UA_UInt32 requestId,
+                            const UA_ByteString *msg, size_t offset, size_t chunklength,
+                            UA_ByteString *bytes) {
+    UA_ByteString_init(bytes);
+    if(msg->length - offset < chunklength) {
+        UA_SecureChannel_removeChunk(channel, requestId); /* can't process all chunks for that request */
+        return UA_STATUSCODE_BADDECODINGERROR;
+    }
+
+    struct ChunkEntry *ch = findChunkEntry(channel, requestId);
+    if(!ch)
+        return UA_STATUSCODE_GOOD;
+    UA_StatusCode retval = ch->status;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = checkChunkLimits(chunkLimits(channel), ch, chunklength);
+    if(retval == UA_STATUSCODE_GOOD) {
+        *bytes = ch->bytes;
+        UA_ByteString_init(&ch->bytes);
     }
+    deleteChunkEntry(channel, ch);
+    return retval;
+}
+
+void UA_SecureChannel_removeChunk(UA_SecureChannel *channel, UA_UInt32 requestId) {
+    struct ChunkEntry *ch = findChunkEntry(channel, requestId);
+    if(ch)
+        deleteChunkEntry(channel, ch);
 }
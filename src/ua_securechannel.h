@@ -5,6 +5,7 @@
 #include "ua_types.h"
 #include "ua_transport_generated.h"
 #include "ua_connection_internal.h"
+#include "ua_crypto.h"
 
 struct UA_Session;
 typedef struct UA_Session UA_Session;
@@ -18,10 +19,23 @@ struct SessionEntry {
 struct ChunkEntry {
     LIST_ENTRY(ChunkEntry) pointers;
     UA_UInt32 requestId;
+    UA_UInt32 chunksSoFar;
+    UA_StatusCode status; /* not good if the request was aborted. The entry
+                           * remains without bytes to drop the remaining
+                           * chunks until the final or abort chunk. */
+    size_t capacity; /* allocated length of bytes */
     UA_ByteString bytes;
 };
 
+/* The chunk entries are indexed by the requestId. The requestIds of a channel
+ * are consecutive and spread evenly over the lists. */
+#define UA_CHUNKINDEXSIZE 8
+
 /* For chunked responses */
+/* Chunks that are collected before they are handed to the sendBatch callback
+ * of the connection */
+#define UA_CHUNKBATCH 8
+
 typedef struct {
     UA_SecureChannel *channel;
     UA_UInt32 requestId;
@@ -30,6 +44,9 @@ typedef struct {
     size_t messageSizeSoFar;
     UA_Boolean final;
     UA_StatusCode errorCode;
+    UA_Connection *batchConnection;
+    size_t batchSize;
+    UA_ByteString batch[UA_CHUNKBATCH];
 } UA_ChunkInfo;
 
 struct UA_SecureChannel {
@@ -44,7 +61,10 @@ struct UA_SecureChannel {
     UA_UInt32      sendSequenceNumber;
     UA_Connection *connection;
     LIST_HEAD(session_pointerlist, SessionEntry) sessions;
-    LIST_HEAD(chunk_pointerlist, ChunkEntry) chunks;
+    LIST_HEAD(chunk_pointerlist, ChunkEntry) chunks[UA_CHUNKINDEXSIZE];
+    size_t chunkMemory; /* bytes reserved for the incomplete requests */
+    size_t chunkRequests; /* incomplete and aborted requests */
+    UA_SymmetricCrypto crypto; /* sign is NULL without a security policy */
 };
 
 void UA_SecureChannel_init(UA_SecureChannel *channel);
@@ -59,15 +79,66 @@ UA_Session * UA_SecureChannel_getSession(UA_SecureChannel *channel, UA_NodeId *t
 UA_StatusCode UA_SecureChannel_sendBinaryMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
                                                   const void *content, const UA_DataType *contentType);
 
+/* Encodes a message piece by piece into the chunks of the channel, so that the
+ * content does not need to exist as a whole in memory. beginMessage encodes the
+ * binary encoding id of the content type. Every call to encodeMessage appends
+ * the binary encoding of a value. Full chunks are sent on the way.
+ * finishMessage sends the final chunk, or an abort chunk if the error is not
+ * good. It must be called after every successful beginMessage. */
+typedef struct {
+    UA_ChunkInfo ci;
+    UA_ByteString buf;
+    size_t offset;
+} UA_MessageContext;
+
+UA_StatusCode UA_SecureChannel_beginMessage(UA_SecureChannel *channel, UA_UInt32 requestId,
+                                            const UA_DataType *contentType, UA_MessageContext *mc);
+
+UA_StatusCode UA_SecureChannel_encodeMessage(UA_MessageContext *mc, const void *content,
+                                             const UA_DataType *type);
+
+/* Appends the binary encoding of an array (with the length prefix) */
+UA_StatusCode UA_SecureChannel_encodeMessageArray(UA_MessageContext *mc, const void *array,
+                                                  size_t arraySize, const UA_DataType *type);
+
+/* Appends bytes that are already binary encoded */
+UA_StatusCode UA_SecureChannel_writeMessageBytes(UA_MessageContext *mc, const UA_ByteString *bytes);
+
+UA_StatusCode UA_SecureChannel_finishMessage(UA_MessageContext *mc, UA_StatusCode error);
+
 void UA_SecureChannel_revolveTokens(UA_SecureChannel *channel);
 
+/**
+ * Security
+ * -------- */
+/* The channel takes ownership of the crypto context. From then on, the chunks
+ * are protected according to the security mode of the channel. */
+void UA_SecureChannel_setCrypto(UA_SecureChannel *channel, const UA_SymmetricCrypto *crypto);
+
+/* The bytes that the send buffers keep free behind the content of a chunk for
+ * the padding and the signature */
+size_t UA_SecureChannel_securityTrailerLength(const UA_SecureChannel *channel);
+
+/* Decrypts and verifies a received MSG chunk in place. The chunk begins with
+ * the message header and has the length of the message size. Returns the
+ * length of the chunk without padding and signature in contentLength. */
+UA_StatusCode UA_SecureChannel_unprotectChunk(UA_SecureChannel *channel, UA_ByteString *chunk,
+                                              size_t *contentLength);
+
 /**
  * Chunking
  * -------- */
 /* Offset is initially set to the beginning of the chunk content. chunklength is
-   the length of the decoded chunk content (minus header, padding, etc.) */
-void UA_SecureChannel_appendChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
-                                  const UA_ByteString *msg, size_t offset, size_t chunklength);
+   the length of the decoded chunk content (minus header, padding, etc.)
+
+   If the request exceeds the limits of the connection config, it is aborted and
+   the following chunks of the request are dropped. The final chunk of an
+   aborted request returns the error. BadTcpNotEnoughResources is returned if
+   the channel cannot keep track of the request (too many incomplete requests
+   or out of memory). Then the channel needs to be closed. */
+UA_StatusCode UA_SecureChannel_appendChunk(UA_SecureChannel *channel, UA_UInt32 requestId,
+                                           const UA_ByteString *msg, size_t offset,
+                                           size_t chunklength);
 
 /* deleteChunk indicates if the returned bytestring was copied off the network
    buffer (and needs to be freed) or points into the msg */
@@ -75,6 +146,14 @@ UA_ByteString UA_SecureChannel_finalizeChunk(UA_SecureChannel *channel, UA_UInt3
                                              const UA_ByteString *msg, size_t offset, size_t chunklength,
                                              UA_Boolean *deleteChunk);
 
+/* Returns the previous chunks of the request in bytes (UA_BYTESTRING_NULL if
+   the request is not chunked) and removes them from the channel. The final
+   chunk is not copied behind them. Instead, the request is decoded from bytes
+   and then the final chunk in the msg. */
+UA_StatusCode UA_SecureChannel_takeChunks(UA_SecureChannel *channel, UA_UInt32 requestId,
+                                          const UA_ByteString *msg, size_t offset, size_t chunklength,
+                                          UA_ByteString *bytes);
+
 void UA_SecureChannel_removeChunk(UA_SecureChannel *channel, UA_UInt32 requestId);
 
 /**
@@ -24,25 +24,98 @@ void UA_Session_init(UA_Session *session) {
     UA_NodeId_init(&session->authenticationToken);
     UA_NodeId_init(&session->sessionId);
     UA_String_init(&session->sessionName);
+    UA_String_init(&session->userName);
+    session->userTokenType = NULL;
+    UA_String_init(&session->userPolicyId);
+    UA_ByteString_init(&session->clientCertificate);
     session->maxRequestMessageSize  = 0;
     session->maxResponseMessageSize = 0;
     session->timeout = 0;
     UA_DateTime_init(&session->validTill);
     session->channel = NULL;
+    session->requestsDue = 0;
+    session->inflightRequests = 0;
+    memset(&session->memory, 0, sizeof(UA_SessionMemory));
+    session->maxContinuationPoints = MAXCONTINUATIONPOINTS;
     session->availableContinuationPoints = MAXCONTINUATIONPOINTS;
     LIST_INIT(&session->continuationPoints);
+    session->continuationPointSlots = NULL;
+    session->continuationPointSlotsSize = 0;
 #ifdef UA_ENABLE_SUBSCRIPTIONS
     LIST_INIT(&session->serverSubscriptions);
-    session->lastSubscriptionID = 0;
     SIMPLEQ_INIT(&session->responseQueue);
+    TAILQ_INIT(&session->retransmissionQueue);
+    session->retransmissionQueueSize = 0;
 #endif
 }
 
+UA_StatusCode
+UA_Session_admitRequest(UA_Session *session, const UA_ServerConfig *config,
+                        UA_DateTime now, size_t operations) {
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_UInt32 inflight = session->inflightRequests;
+#else
+    UA_UInt32 inflight = uatomic_read(&session->inflightRequests);
+#endif
+    if(config->maxSessionInflightRequests > 0 &&
+       inflight >= config->maxSessionInflightRequests)
+        return UA_STATUSCODE_BADTCPSERVERTOOBUSY;
+    if(config->maxSessionRequestRate == 0)
+        return UA_STATUSCODE_GOOD;
+
+    /* Heavy requests cost more, but never more than a full burst. Otherwise
+     * they could not be admitted at all. */
+    UA_DateTime interval = UA_SEC_TO_DATETIME / config->maxSessionRequestRate;
+    if(interval == 0)
+        interval = 1;
+    UA_DateTime limit = interval * ((UA_DateTime)config->maxSessionRequestBurst + 1);
+    UA_DateTime cost = interval;
+    if(config->operationsPerRequest > 0)
+        cost *= 1 + (UA_DateTime)(operations / config->operationsPerRequest);
+    if(cost > limit)
+        cost = limit;
+
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_DateTime due = session->requestsDue > now ? session->requestsDue : now;
+    if(due + cost - now > limit)
+        return UA_STATUSCODE_BADTCPSERVERTOOBUSY;
+    session->requestsDue = due + cost;
+#else
+    UA_DateTime old = uatomic_read(&session->requestsDue);
+    while(true) {
+        UA_DateTime due = old > now ? old : now;
+        if(due + cost - now > limit)
+            return UA_STATUSCODE_BADTCPSERVERTOOBUSY;
+        UA_DateTime seen = uatomic_cmpxchg(&session->requestsDue, old, due + cost);
+        if(seen == old)
+            break;
+        old = seen;
+    }
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_Boolean UA_Session_sameUser(const UA_Session *a, const UA_Session *b) {
+    if(!a->userTokenType || a->userTokenType != b->userTokenType ||
+       !UA_String_equal(&a->userPolicyId, &b->userPolicyId) ||
+       !UA_String_equal(&a->userName, &b->userName))
+        return false;
+    if(a->userTokenType != &UA_TYPES[UA_TYPES_ANONYMOUSIDENTITYTOKEN])
+        return true;
+    /* Anonymous users cannot be told apart */
+    return a->clientDescription.applicationUri.length > 0 &&
+        UA_String_equal(&a->clientDescription.applicationUri, &b->clientDescription.applicationUri) &&
+        UA_ByteString_equal(&a->clientCertificate, &b->clientCertificate);
+}
+
 void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
     UA_ApplicationDescription_deleteMembers(&session->clientDescription);
     UA_NodeId_deleteMembers(&session->authenticationToken);
     UA_NodeId_deleteMembers(&session->sessionId);
     UA_String_deleteMembers(&session->sessionName);
+    UA_String_deleteMembers(&session->userName);
+    UA_String_deleteMembers(&session->userPolicyId);
+    UA_ByteString_deleteMembers(&session->clientCertificate);
     struct ContinuationPointEntry *cp, *temp;
     LIST_FOREACH_SAFE(cp, &session->continuationPoints, pointers, temp) {
         LIST_REMOVE(cp, pointers);
@@ -50,6 +123,9 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
         UA_BrowseDescription_deleteMembers(&cp->browseDescription);
         UA_free(cp);
     }
+    UA_free(session->continuationPointSlots);
+    session->continuationPointSlots = NULL;
+    session->continuationPointSlotsSize = 0;
     if(session->channel)
         UA_SecureChannel_detachSession(session->channel, session);
 #ifdef UA_ENABLE_SUBSCRIPTIONS
@@ -57,19 +133,14 @@ void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server* server) {
     LIST_FOREACH_SAFE(currents, &session->serverSubscriptions, listEntry, temps) {
         LIST_REMOVE(currents, listEntry);
         UA_Subscription_deleteMembers(currents, server);
-        UA_free(currents);
-    }
-    UA_PublishResponseEntry *entry;
-    while((entry = SIMPLEQ_FIRST(&session->responseQueue))) {
-        SIMPLEQ_REMOVE_HEAD(&session->responseQueue, listEntry);
-        UA_PublishResponse_deleteMembers(&entry->response);
-        UA_free(entry);
+        UA_objfree(currents);
     }
+    UA_Session_discardPublishRequests(session);
 #endif
 }
 
-void UA_Session_updateLifetime(UA_Session *session) {
-    session->validTill = UA_DateTime_now() + (UA_DateTime)(session->timeout * UA_MSEC_TO_DATETIME);
+void UA_Session_updateLifetime(UA_Session *session, UA_DateTime now) {
+    session->validTill = now + (UA_DateTime)(session->timeout * UA_MSEC_TO_DATETIME);
 }
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS
@@ -85,7 +156,7 @@ UA_Session_deleteSubscription(UA_Server *server, UA_Session *session, UA_UInt32
         return UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID;
     LIST_REMOVE(sub, listEntry);
     UA_Subscription_deleteMembers(sub, server);
-    UA_free(sub);
+    UA_objfree(sub);
     return UA_STATUSCODE_GOOD;
 }
 
@@ -99,8 +170,27 @@ UA_Session_getSubscriptionByID(UA_Session *session, UA_UInt32 subscriptionID) {
     return sub;
 }
 
-UA_UInt32 UA_Session_getUniqueSubscriptionID(UA_Session *session) {
-    return ++(session->lastSubscriptionID);
+UA_Subscription *
+UA_Session_getLateSubscription(UA_Session *session) {
+    UA_Subscription *late = NULL;
+    UA_Subscription *sub;
+    LIST_FOREACH(sub, &session->serverSubscriptions, listEntry) {
+        if(sub->state != UA_SUBSCRIPTIONSTATE_LATE)
+            continue;
+        if(!late || sub->priority > late->priority ||
+           (sub->priority == late->priority && sub->lateSince < late->lateSince))
+            late = sub;
+    }
+    return late;
+}
+
+void UA_Session_discardPublishRequests(UA_Session *session) {
+    UA_PublishResponseEntry *entry;
+    while((entry = SIMPLEQ_FIRST(&session->responseQueue))) {
+        SIMPLEQ_REMOVE_HEAD(&session->responseQueue, listEntry);
+        UA_PublishResponse_deleteMembers(&entry->response);
+        UA_objfree(entry);
+    }
 }
 
 
@@ -8,27 +8,46 @@
 
 #define MAXCONTINUATIONPOINTS 5
 
+/* The identifier of a continuation point begins with its slot in the session.
+ * So BrowseNext finds the continuation point without a search. The browse is
+ * resumed from the stored position if the version of the node's references is
+ * unchanged. Otherwise, the first continuationIndex matching references are
+ * skipped. */
 struct ContinuationPointEntry {
     LIST_ENTRY(ContinuationPointEntry) pointers;
     UA_ByteString        identifier;
     UA_BrowseDescription browseDescription;
     UA_UInt32            continuationIndex;
     UA_UInt32            maxReferences;
+    UA_UInt32            slot;
+    size_t               referencesVersion;
+    size_t               filterNext;
+    size_t               referencesIndex;
+    size_t               referencesEnd;
 };
 
 struct UA_Subscription;
 typedef struct UA_Subscription UA_Subscription;
 
+struct UA_NotificationMessageEntry;
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
 typedef struct UA_PublishResponseEntry {
     SIMPLEQ_ENTRY(UA_PublishResponseEntry) listEntry;
     UA_UInt32 requestId;
+    UA_UInt32 returnDiagnostics; /* of the request */
     UA_PublishResponse response;
 } UA_PublishResponseEntry;
+#endif
 
 struct UA_Session {
     UA_ApplicationDescription clientDescription;
     UA_Boolean        activated;
     UA_String         sessionName;
+    UA_String         userName; /* of the activation, empty if anonymous */
+    const UA_DataType *userTokenType; /* of the activation, NULL before */
+    UA_String         userPolicyId; /* of the activation */
+    UA_ByteString     clientCertificate;
     UA_NodeId         authenticationToken;
     UA_NodeId         sessionId;
     UA_UInt32         maxRequestMessageSize;
@@ -36,12 +55,20 @@ struct UA_Session {
     UA_Double         timeout; // [ms]
     UA_DateTime       validTill;
     UA_SecureChannel *channel;
-    UA_UInt16 availableContinuationPoints;
+    UA_DateTime       requestsDue; /* of the rate limit, monotonic */
+    UA_UInt32         inflightRequests;
+    UA_SessionMemory  memory;
+    UA_UInt16 maxContinuationPoints; /* 0 -> unlimited */
+    UA_UInt16 availableContinuationPoints; /* if limited */
     LIST_HEAD(ContinuationPointList, ContinuationPointEntry) continuationPoints;
+    struct ContinuationPointEntry **continuationPointSlots; /* allocated with the first */
+    UA_UInt32 continuationPointSlotsSize;
 #ifdef UA_ENABLE_SUBSCRIPTIONS
-    UA_UInt32 lastSubscriptionID;
     LIST_HEAD(UA_ListOfUASubscriptions, UA_Subscription) serverSubscriptions;
     SIMPLEQ_HEAD(UA_ListOfQueuedPublishResponses, UA_PublishResponseEntry) responseQueue;
+    /* The retransmission queues of all subscriptions, oldest first */
+    TAILQ_HEAD(UA_ListOfSessionRetransmissions, UA_NotificationMessageEntry) retransmissionQueue;
+    size_t retransmissionQueueSize;
 #endif
 };
 
@@ -52,8 +79,30 @@ extern UA_Session adminSession;
 void UA_Session_init(UA_Session *session);
 void UA_Session_deleteMembersCleanup(UA_Session *session, UA_Server *server);
 
+/* Tests if both sessions were activated by the same user. Anonymous users are
+ * only the same if the sessions were created by the same client application
+ * (ApplicationUri and certificate). */
+UA_Boolean UA_Session_sameUser(const UA_Session *a, const UA_Session *b);
+
 /* If any activity on a session happens, the timeout is extended */
-void UA_Session_updateLifetime(UA_Session *session);
+void UA_Session_updateLifetime(UA_Session *session, UA_DateTime now);
+
+/* The memory that counts against maxSessionMemory */
+static UA_INLINE size_t
+UA_Session_memoryUsage(const UA_Session *session) {
+    return session->memory.subscriptions + session->memory.samples +
+        session->memory.retransmissions + session->memory.continuationPoints;
+}
+
+/* Admits a request with the given number of operations or returns
+ * BadTcpServerTooBusy if the session is beyond the request limits of the
+ * server configuration. The rate is limited with the generic cell rate
+ * algorithm. Every admitted request moves requestsDue forward by its cost. A
+ * request is rejected if requestsDue would run ahead of now by more than the
+ * burst. */
+UA_StatusCode
+UA_Session_admitRequest(UA_Session *session, const UA_ServerConfig *config,
+                        UA_DateTime now, size_t operations);
 
 #ifdef UA_ENABLE_SUBSCRIPTIONS
 void UA_Session_addSubscription(UA_Session *session, UA_Subscription *newSubscription);
@@ -61,12 +110,20 @@ void UA_Session_addSubscription(UA_Session *session, UA_Subscription *newSubscri
 UA_Subscription *
 UA_Session_getSubscriptionByID(UA_Session *session, UA_UInt32 subscriptionID);
 
+/* Returns the late subscription that gets the next publish request. That is
+ * the one with the highest priority. Among equal priorities, the one that is
+ * late for the longest time. NULL if no subscription is late. */
+UA_Subscription *
+UA_Session_getLateSubscription(UA_Session *session);
+
 UA_StatusCode
 UA_Session_deleteSubscription(UA_Server *server, UA_Session *session,
                               UA_UInt32 subscriptionID);
 
-UA_UInt32
-UA_Session_getUniqueSubscriptionID(UA_Session *session);
+/* Drops the queued publish requests. Their request ids belong to the channel
+ * they were received on. So they cannot be answered on another channel. */
+void
+UA_Session_discardPublishRequests(UA_Session *session);
 #endif
 
 /**
@@ -1,6 +1,7 @@
 #include "ua_util.h"
 #include "ua_types.h"
 #include "ua_types_generated.h"
+#include "ua_types_encoding_binary.h"
 
 #include "pcg_basic.h"
 #include "libc_time.h"
@@ -46,6 +47,8 @@ UA_String UA_String_fromChars(char const src[]) {
 UA_Boolean UA_String_equal(const UA_String *string1, const UA_String *string2) {
     if(string1->length != string2->length)
         return false;
+    if(string1->data == string2->data)
+        return true; /* e.g. interned strings */
     UA_Int32 is = memcmp((char const*)string1->data, (char const*)string2->data, string1->length);
     return (is == 0) ? true : false;
 }
@@ -291,16 +294,69 @@ ExtensionObject_copy(UA_ExtensionObject const *src, UA_ExtensionObject *dst, con
 }
 
 /* Variant */
+
+/* Shared variant data is preceded by a header with the reference count. The
+   header size keeps the alignment of the data for all builtin types. */
+typedef struct {
+    size_t refCount;
+} VariantSharedHeader;
+
+#define UA_VARIANT_SHAREDALIGN (2 * sizeof(void*))
+#define UA_VARIANT_SHAREDHEADER \
+    ((sizeof(VariantSharedHeader) + UA_VARIANT_SHAREDALIGN - 1) & ~(UA_VARIANT_SHAREDALIGN - 1))
+
+static VariantSharedHeader * sharedHeader(const UA_Variant *v) {
+    return (VariantSharedHeader*)((uintptr_t)v->data - UA_VARIANT_SHAREDHEADER);
+}
+
+static size_t sharedLength(const UA_Variant *v) {
+    return UA_Variant_isScalar(v) ? 1 : v->arrayLength;
+}
+
+static void Variant_acquireShared(const UA_Variant *v) {
+#ifdef UA_ENABLE_MULTITHREADING
+    uatomic_inc(&sharedHeader(v)->refCount);
+#else
+    sharedHeader(v)->refCount++;
+#endif
+}
+
+static void Variant_releaseShared(const UA_Variant *v) {
+    VariantSharedHeader *h = sharedHeader(v);
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_sub_return(&h->refCount, 1) > 0)
+        return;
+#else
+    if(--h->refCount > 0)
+        return;
+#endif
+    if(!v->type->fixedSize) {
+        uintptr_t ptr = (uintptr_t)v->data;
+        size_t length = sharedLength(v);
+        for(size_t i = 0; i < length; i++) {
+            UA_deleteMembers((void*)ptr, v->type);
+            ptr += v->type->memSize;
+        }
+    }
+    UA_free(h);
+}
+
+static UA_Boolean Variant_hasSharedData(const UA_Variant *v) {
+    return v->storageType == UA_VARIANT_DATA_SHARED && v->type && v->data > UA_EMPTY_ARRAY_SENTINEL;
+}
+
 static void Variant_deletemembers(UA_Variant *p, const UA_DataType *_) {
-    if(p->storageType != UA_VARIANT_DATA)
+    if(p->storageType == UA_VARIANT_DATA_NODELETE)
         return;
     if(p->type && p->data > UA_EMPTY_ARRAY_SENTINEL) {
-        if(p->arrayLength == 0)
-            p->arrayLength = 1;
-        UA_Array_delete(p->data, p->arrayLength, p->type);
+        if(p->storageType == UA_VARIANT_DATA_SHARED)
+            Variant_releaseShared(p);
+        else
+            UA_Array_delete(p->data, sharedLength(p), p->type);
         p->data = NULL;
         p->arrayLength = 0;
     }
+    p->storageType = UA_VARIANT_DATA;
     if(p->arrayDimensions) {
         UA_Array_delete(p->arrayDimensions, p->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
         p->arrayDimensions = NULL;
@@ -310,12 +366,17 @@ static void Variant_deletemembers(UA_Variant *p, const UA_DataType *_) {
 
 static UA_StatusCode
 Variant_copy(UA_Variant const *src, UA_Variant *dst, const UA_DataType *_) {
-    size_t length = src->arrayLength;
-    if(UA_Variant_isScalar(src))
-        length = 1;
-    UA_StatusCode retval = UA_Array_copy(src->data, length, &dst->data, src->type);
-    if(retval != UA_STATUSCODE_GOOD)
-        return retval;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(Variant_hasSharedData(src)) {
+        /* Add a reference instead of copying the data */
+        Variant_acquireShared(src);
+        dst->data = src->data;
+        dst->storageType = UA_VARIANT_DATA_SHARED;
+    } else {
+        retval = UA_Array_copy(src->data, sharedLength(src), &dst->data, src->type);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
     dst->arrayLength = src->arrayLength;
     dst->type = src->type;
     if(src->arrayDimensions) {
@@ -329,16 +390,106 @@ Variant_copy(UA_Variant const *src, UA_Variant *dst, const UA_DataType *_) {
     return retval;
 }
 
+UA_StatusCode UA_Variant_share(UA_Variant *v) {
+    if(v->storageType != UA_VARIANT_DATA || !v->type || v->data <= UA_EMPTY_ARRAY_SENTINEL)
+        return UA_STATUSCODE_GOOD;
+    size_t dataSize = sharedLength(v) * v->type->memSize;
+    VariantSharedHeader *h = UA_malloc(UA_VARIANT_SHAREDHEADER + dataSize);
+    if(!h)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    h->refCount = 1;
+    void *data = (void*)((uintptr_t)h + UA_VARIANT_SHAREDHEADER);
+    memcpy(data, v->data, dataSize);
+    UA_free(v->data); /* the members have moved to the shared buffer */
+    v->data = data;
+    v->storageType = UA_VARIANT_DATA_SHARED;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_Variant_unshare(UA_Variant *v) {
+    if(v->storageType == UA_VARIANT_DATA)
+        return UA_STATUSCODE_GOOD;
+    if(!v->type || v->data <= UA_EMPTY_ARRAY_SENTINEL) {
+        v->storageType = UA_VARIANT_DATA;
+        return UA_STATUSCODE_GOOD;
+    }
+    void *data;
+    UA_StatusCode retval = UA_Array_copy(v->data, sharedLength(v), &data, v->type);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(v->storageType == UA_VARIANT_DATA_SHARED)
+        Variant_releaseShared(v);
+    v->data = data;
+    v->storageType = UA_VARIANT_DATA;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Shared data is written in place only if there are no other references.
+   Otherwise, the data is copied into a new shared buffer first. So the data is
+   copied once and need not be shared again after the write. */
+static UA_StatusCode Variant_makeWritable(UA_Variant *v) {
+    if(!Variant_hasSharedData(v))
+        return UA_STATUSCODE_GOOD;
+#ifdef UA_ENABLE_MULTITHREADING
+    if(uatomic_read(&sharedHeader(v)->refCount) == 1)
+        return UA_STATUSCODE_GOOD;
+#else
+    if(sharedHeader(v)->refCount == 1)
+        return UA_STATUSCODE_GOOD;
+#endif
+    size_t length = sharedLength(v);
+    size_t dataSize = length * v->type->memSize;
+    VariantSharedHeader *h = UA_calloc(1, UA_VARIANT_SHAREDHEADER + dataSize);
+    if(!h)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    h->refCount = 1;
+    void *data = (void*)((uintptr_t)h + UA_VARIANT_SHAREDHEADER);
+    if(v->type->fixedSize) {
+        memcpy(data, v->data, dataSize);
+    } else {
+        uintptr_t ptrs = (uintptr_t)v->data;
+        uintptr_t ptrd = (uintptr_t)data;
+        UA_StatusCode retval = UA_STATUSCODE_GOOD;
+        for(size_t i = 0; i < length; i++) {
+            retval |= UA_copy((void*)ptrs, (void*)ptrd, v->type);
+            ptrs += v->type->memSize;
+            ptrd += v->type->memSize;
+        }
+        if(retval != UA_STATUSCODE_GOOD) {
+            ptrd = (uintptr_t)data;
+            for(size_t i = 0; i < length; i++) {
+                UA_deleteMembers((void*)ptrd, v->type);
+                ptrd += v->type->memSize;
+            }
+            UA_free(h);
+            return retval;
+        }
+    }
+    Variant_releaseShared(v);
+    v->data = data;
+    return UA_STATUSCODE_GOOD;
+}
+
 /**
- * Test if a range is compatible with a variant. If yes, the following values are set:
- * - total: how many elements are in the range
- * - block: how big is each contiguous block of elements in the variant that maps into the range
- * - stride: how many elements are between the blocks (beginning to beginning)
- * - first: where does the first block begin
+ * Ranges map into blocks of contiguous elements of the variant array. A block
+ * spans the inner dimensions that are fully covered by the range and the first
+ * dimension (from the inside) that is covered only partially. The blocks are
+ * enumerated over the indices of the remaining outer dimensions. So large
+ * slices and sub-rectangles are copied with one memcpy per block.
  */
+typedef struct {
+    UA_UInt32 arrayLength; /* the dimension of one-dimensional arrays */
+    const UA_UInt32 *dims;
+    const struct UA_NumericRangeDimension *rdims;
+    size_t contiguousDim; /* the outermost dimension inside a block */
+    size_t contiguousStride; /* elements between two indices of contiguousDim */
+    size_t block; /* elements per block */
+    size_t blockCount;
+} RangeBlocks;
+
+/* Test if a range is compatible with a variant and compute the blocks */
 static UA_StatusCode
-processRangeDefinition(const UA_Variant *v, const UA_NumericRange range, size_t *total,
-                       size_t *block, size_t *stride, size_t *first) {
+processRangeDefinition(const UA_Variant *v, const UA_NumericRange *range, RangeBlocks *rb) {
     /* Test the integrity of the source variant dimensions */
     size_t dims_count = 1;
     UA_UInt32 elements = 1;
@@ -346,16 +497,16 @@ processRangeDefinition(const UA_Variant *v, const UA_NumericRange range, size_t
     if(v->arrayLength > UA_UINT32_MAX)
         return UA_STATUSCODE_BADINTERNALERROR;
 #endif
-    UA_UInt32 arrayLength = (UA_UInt32)v->arrayLength;
-    const UA_UInt32 *dims = &arrayLength;
+    rb->arrayLength = (UA_UInt32)v->arrayLength;
+    rb->dims = &rb->arrayLength;
     if(v->arrayDimensionsSize > 0) {
         dims_count = v->arrayDimensionsSize;
-        dims = (UA_UInt32*)v->arrayDimensions;
+        rb->dims = (UA_UInt32*)v->arrayDimensions;
         for(size_t i = 0; i < dims_count; i++) {
             /* dimensions can have negative size similar to array lengths */
             if(v->arrayDimensions[i] < 0)
                 return UA_STATUSCODE_BADINDEXRANGEINVALID;
-            elements *= dims[i];
+            elements *= rb->dims[i];
         }
         if(elements != v->arrayLength)
             return UA_STATUSCODE_BADINTERNALERROR;
@@ -363,154 +514,208 @@ processRangeDefinition(const UA_Variant *v, const UA_NumericRange range, size_t
 
     /* Test the integrity of the range */
     size_t count = 1;
-    if(range.dimensionsSize != dims_count)
+    if(range->dimensionsSize != dims_count)
         return UA_STATUSCODE_BADINDEXRANGENODATA;
     for(size_t i = 0; i < dims_count; i++) {
-        if(range.dimensions[i].min > range.dimensions[i].max)
+        if(range->dimensions[i].min > range->dimensions[i].max)
             return UA_STATUSCODE_BADINDEXRANGEINVALID;
-        if(range.dimensions[i].max >= dims[i])
+        if(range->dimensions[i].max >= rb->dims[i])
             return UA_STATUSCODE_BADINDEXRANGENODATA;
-        count *= (range.dimensions[i].max - range.dimensions[i].min) + 1;
+        count *= (range->dimensions[i].max - range->dimensions[i].min) + 1;
     }
 
-    /* Compute the stride length and the position of the first element */
-    size_t b = 1, s = elements, f = 0;
+    /* Extend the block outwards while the dimensions are fully covered */
     size_t running_dimssize = 1;
-    UA_Boolean found_contiguous = false;
-    for(size_t k = dims_count - 1; ; k--) {
-        if(!found_contiguous && (range.dimensions[k].min != 0 || range.dimensions[k].max + 1 != dims[k])) {
-            found_contiguous = true;
-            b = (range.dimensions[k].max - range.dimensions[k].min + 1) * running_dimssize;
-            s = dims[k] * running_dimssize;
-        }
-        f += running_dimssize * range.dimensions[k].min;
-        running_dimssize *= dims[k];
-        if(k == 0)
+    size_t k = dims_count - 1;
+    while(true) {
+        size_t width = (range->dimensions[k].max - range->dimensions[k].min) + 1;
+        if(width != rb->dims[k] || k == 0) {
+            rb->block = width * running_dimssize;
             break;
+        }
+        running_dimssize *= rb->dims[k];
+        k--;
     }
-    *total = count;
-    *block = b;
-    *stride = s;
-    *first = f;
+    rb->rdims = range->dimensions;
+    rb->contiguousDim = k;
+    rb->contiguousStride = running_dimssize;
+    rb->blockCount = count / rb->block;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The position of the first element of a block in the variant array */
+static size_t rangeBlockOffset(const RangeBlocks *rb, size_t blockIndex) {
+    size_t c = rb->contiguousDim;
+    size_t offset = rb->rdims[c].min * rb->contiguousStride;
+    size_t stride = rb->contiguousStride * rb->dims[c];
+    for(size_t k = c; k > 0; k--) {
+        size_t width = (rb->rdims[k-1].max - rb->rdims[k-1].min) + 1;
+        offset += (rb->rdims[k-1].min + (blockIndex % width)) * stride;
+        blockIndex /= width;
+        stride *= rb->dims[k-1];
+    }
+    return offset;
+}
+
+static UA_StatusCode
+Variant_setRangeDimensions(const UA_Variant *src, UA_Variant *dst, const UA_NumericRange *range) {
+    if(src->arrayDimensionsSize == 0)
+        return UA_STATUSCODE_GOOD;
+    dst->arrayDimensions = UA_Array_new(src->arrayDimensionsSize, &UA_TYPES[UA_TYPES_UINT32]);
+    if(!dst->arrayDimensions)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    dst->arrayDimensionsSize = src->arrayDimensionsSize;
+    for(size_t k = 0; k < src->arrayDimensionsSize; k++)
+        dst->arrayDimensions[k] = (UA_Int32)(range->dimensions[k].max - range->dimensions[k].min + 1);
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_Variant_copyRange(const UA_Variant *src, UA_Variant *dst, const UA_NumericRange range) {
-    size_t count, block, stride, first;
-    UA_StatusCode retval = processRangeDefinition(src, range, &count, &block, &stride, &first);
+    RangeBlocks rb;
+    UA_StatusCode retval = processRangeDefinition(src, &range, &rb);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     UA_Variant_init(dst);
+    size_t count = rb.block * rb.blockCount;
     size_t elem_size = src->type->memSize;
-    dst->data = UA_malloc(elem_size * count);
+    /* Zeroed, so that a partial copy can be deleted */
+    if(src->type->fixedSize)
+        dst->data = UA_malloc(elem_size * count);
+    else
+        dst->data = UA_calloc(count, elem_size);
     if(!dst->data)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     /* Copy the range */
-    size_t block_count = count / block;
     uintptr_t nextdst = (uintptr_t)dst->data;
-    uintptr_t nextsrc = (uintptr_t)src->data + (elem_size * first);
-    if(src->type->fixedSize) {
-        for(size_t i = 0; i < block_count; i++) {
-            memcpy((void*)nextdst, (void*)nextsrc, elem_size * block);
-            nextdst += block * elem_size;
-            nextsrc += stride * elem_size;
+    for(size_t i = 0; i < rb.blockCount && retval == UA_STATUSCODE_GOOD; i++) {
+        uintptr_t nextsrc = (uintptr_t)src->data + (rangeBlockOffset(&rb, i) * elem_size);
+        if(src->type->fixedSize) {
+            memcpy((void*)nextdst, (void*)nextsrc, elem_size * rb.block);
+            nextdst += rb.block * elem_size;
+            continue;
         }
-    } else {
-        for(size_t i = 0; i < block_count; i++) {
-            for(size_t j = 0; j < block && retval == UA_STATUSCODE_GOOD; j++) {
-                retval = UA_copy((const void*)nextsrc, (void*)nextdst, src->type);
-                nextdst += elem_size;
-                nextsrc += elem_size;
-            }
-            nextsrc += (stride - block) * elem_size;
-        }
-        if(retval != UA_STATUSCODE_GOOD) {
-            size_t copied = ((nextdst - elem_size) - (uintptr_t)dst->data) / elem_size;
-            UA_Array_delete(dst->data, copied, src->type);
-            dst->data = NULL;
-            return retval;
+        for(size_t j = 0; j < rb.block && retval == UA_STATUSCODE_GOOD; j++) {
+            retval = UA_copy((const void*)nextsrc, (void*)nextdst, src->type);
+            nextdst += elem_size;
+            nextsrc += elem_size;
         }
     }
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_Array_delete(dst->data, count, src->type);
+        dst->data = NULL;
+        return retval;
+    }
     dst->arrayLength = count;
     dst->type = src->type;
 
     /* Copy the range dimensions */
-    if(src->arrayDimensionsSize > 0) {
-        dst->arrayDimensions = UA_Array_new(src->arrayDimensionsSize, &UA_TYPES[UA_TYPES_UINT32]);
-        if(!dst->arrayDimensions) {
-            Variant_deletemembers(dst, NULL);
-            return UA_STATUSCODE_BADOUTOFMEMORY;
-        }
-        dst->arrayDimensionsSize = src->arrayDimensionsSize;
-        for(size_t k = 0; k < src->arrayDimensionsSize; k++)
-            dst->arrayDimensions[k] = (UA_Int32)(range.dimensions[k].max - range.dimensions[k].min + 1);
-    }
+    retval = Variant_setRangeDimensions(src, dst, &range);
+    if(retval != UA_STATUSCODE_GOOD)
+        Variant_deletemembers(dst, NULL);
+    return retval;
+}
+
+UA_StatusCode
+UA_Variant_borrowRange(const UA_Variant *src, UA_Variant *dst, const UA_NumericRange range) {
+    RangeBlocks rb;
+    UA_StatusCode retval = processRangeDefinition(src, &range, &rb);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    /* Borrowed variants cannot own array dimensions */
+    if(rb.blockCount > 1 || src->arrayDimensionsSize > 1)
+        return UA_Variant_copyRange(src, dst, range);
+    UA_Variant_init(dst);
+    dst->type = src->type;
+    dst->data = (void*)((uintptr_t)src->data + (rangeBlockOffset(&rb, 0) * src->type->memSize));
+    dst->arrayLength = rb.block;
+    dst->storageType = UA_VARIANT_DATA_NODELETE;
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_Variant_setRange(UA_Variant *v, void * UA_RESTRICT array, size_t arraySize, const UA_NumericRange range) {
-    size_t count, block, stride, first;
-    UA_StatusCode retval = processRangeDefinition(v, range, &count, &block, &stride, &first);
+    RangeBlocks rb;
+    UA_StatusCode retval = processRangeDefinition(v, &range, &rb);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
-    if(count != arraySize)
+    if(rb.block * rb.blockCount != arraySize)
         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+    retval = Variant_makeWritable(v);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
 
-    size_t block_count = count / block;
     size_t elem_size = v->type->memSize;
-    uintptr_t nextdst = (uintptr_t)v->data + (first * elem_size);
     uintptr_t nextsrc = (uintptr_t)array;
-    for(size_t i = 0; i < block_count; i++) {
+    for(size_t i = 0; i < rb.blockCount; i++) {
+        uintptr_t nextdst = (uintptr_t)v->data + (rangeBlockOffset(&rb, i) * elem_size);
         if(!v->type->fixedSize) {
-            for(size_t j = 0; j < block; j++) {
-                UA_deleteMembers((void*)nextdst, v->type);
-                nextdst += elem_size;
-            }
-            nextdst -= block * elem_size;
+            for(size_t j = 0; j < rb.block; j++)
+                UA_deleteMembers((void*)(nextdst + (j * elem_size)), v->type);
         }
-        memcpy((void*)nextdst, (void*)nextsrc, elem_size * block);
-        nextsrc += block * elem_size;
-        nextdst += stride * elem_size;
+        memcpy((void*)nextdst, (void*)nextsrc, elem_size * rb.block);
+        nextsrc += rb.block * elem_size;
     }
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_Variant_setRangeCopy(UA_Variant *v, const void *array, size_t arraySize, const UA_NumericRange range) {
-    size_t count, block, stride, first;
-    UA_StatusCode retval = processRangeDefinition(v, range, &count, &block, &stride, &first);
+    RangeBlocks rb;
+    UA_StatusCode retval = processRangeDefinition(v, &range, &rb);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
-    if(count != arraySize)
+    if(rb.block * rb.blockCount != arraySize)
         return UA_STATUSCODE_BADINDEXRANGEINVALID;
+    retval = Variant_makeWritable(v);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
 
-    size_t block_count = count / block;
     size_t elem_size = v->type->memSize;
-    uintptr_t nextdst = (uintptr_t)v->data + (first * elem_size);
     uintptr_t nextsrc = (uintptr_t)array;
-    if(v->type->fixedSize) {
-        for(size_t i = 0; i < block_count; i++) {
-            memcpy((void*)nextdst, (void*)nextsrc, elem_size * block);
-            nextsrc += block * elem_size;
-            nextdst += stride * elem_size;
+    for(size_t i = 0; i < rb.blockCount; i++) {
+        uintptr_t nextdst = (uintptr_t)v->data + (rangeBlockOffset(&rb, i) * elem_size);
+        if(v->type->fixedSize) {
+            memcpy((void*)nextdst, (void*)nextsrc, elem_size * rb.block);
+            nextsrc += rb.block * elem_size;
+            continue;
         }
-    } else {
-        for(size_t i = 0; i < block_count; i++) {
-            for(size_t j = 0; j < block; j++) {
-                UA_deleteMembers((void*)nextdst, v->type);
-                retval |= UA_copy((void*)nextsrc, (void*)nextdst, v->type);
-                nextdst += elem_size;
-                nextsrc += elem_size;
-            }
-            nextdst += (stride - block) * elem_size;
+        for(size_t j = 0; j < rb.block; j++) {
+            UA_deleteMembers((void*)nextdst, v->type);
+            retval |= UA_copy((void*)nextsrc, (void*)nextdst, v->type);
+            nextdst += elem_size;
+            nextsrc += elem_size;
         }
     }
     return retval;
 }
 
+UA_StatusCode
+UA_Variant_forRangeBlocks(const UA_Variant *v, const UA_NumericRange range,
+                          UA_RangeBlockCallback callback, void *context) {
+    RangeBlocks rb;
+    UA_StatusCode retval = processRangeDefinition(v, &range, &rb);
+    for(size_t i = 0; i < rb.blockCount && retval == UA_STATUSCODE_GOOD; i++)
+        retval = callback(context, rangeBlockOffset(&rb, i), rb.block);
+    return retval;
+}
+
+UA_StatusCode
+UA_Variant_allocShared(UA_Variant *v, const UA_DataType *type, size_t arrayLength) {
+    UA_assert(type->fixedSize);
+    VariantSharedHeader *h = UA_malloc(UA_VARIANT_SHAREDHEADER + (arrayLength * type->memSize));
+    if(!h)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    h->refCount = 1;
+    UA_Variant_init(v);
+    v->data = (void*)((uintptr_t)h + UA_VARIANT_SHAREDHEADER);
+    v->arrayLength = arrayLength;
+    v->type = type;
+    v->storageType = UA_VARIANT_DATA_SHARED;
+    return UA_STATUSCODE_GOOD;
+}
+
 void UA_Variant_setScalar(UA_Variant *v, void * UA_RESTRICT p, const UA_DataType *type) {
     UA_Variant_init(v);
     v->type = type;
@@ -1,55 +1,234 @@
 #include "ua_util.h"
 #include "ua_types_encoding_binary.h"
 #include "ua_types_generated.h"
+#include "ua_arena.h"
+
+#define UA_DECODESTAGE 16
+
+/* The state of an encoding or decoding run. We give pointers to the current
+ * position and the last position in the buffer instead of a string with an
+ * offset. The context is passed to every function explicitly instead of using
+ * thread-local variables, so that the compiler can keep the cursor in a
+ * register. */
+typedef struct {
+    UA_Byte *pos;
+    UA_Byte *end;
+
+    /* The code UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED is returned only when
+     * the end of the buffer is reached. This error is caught. We then try to
+     * send the current chunk and continue with the next. */
+    UA_ByteString *encodeBuf; /* the original buffer */
+    UA_exchangeEncodeBuffer exchangeBufferCallback;
+    void *exchangeBufferCallbackHandle;
+
+    /* Length fields in the current buffer that are written after the content
+     * is encoded. The buffer cannot be sent before. */
+    size_t encodePendingLengths;
+
+    /* Decoding from a sequence of buffers (chunks). When pos reaches the end
+     * of the current buffer, the next one is pulled with the callback.
+     * Fixed-size values that are split between two buffers are copied into a
+     * small staging area. */
+    UA_exchangeDecodeBuffer decodeBufferCallback;
+    void *decodeBufferCallbackHandle;
+    UA_ByteString decodeBuf; /* the current buffer */
+    size_t decodeRemaining; /* bytes in the buffers after decodeBuf */
+    UA_Boolean decodeStaged; /* pos points into the stage */
+    size_t decodeStageSkip; /* continue in decodeBuf after the stage */
+    UA_Byte decodeStage[UA_DECODESTAGE];
+
+    /* Decoded strings and arrays are taken from the arena if one is set. They
+     * are not freed individually when decoding fails. Strings point into the
+     * source buffer where possible. */
+    UA_Arena *arena;
+
+    /* Keep the bodies of ExtensionObjects encoded. They are decoded on access
+     * with UA_ExtensionObject_decodeContent. */
+    UA_Boolean lazyExtensionObjects;
+} Ctx;
 
 /* Jumptables for de-/encoding and computing the buffer length */
-typedef UA_StatusCode (*UA_encodeBinarySignature)(const void *UA_RESTRICT src, const UA_DataType *type);
+typedef UA_StatusCode (*UA_encodeBinarySignature)(const void *UA_RESTRICT src, const UA_DataType *type,
+                                                  Ctx *UA_RESTRICT ctx);
 static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1];
 
-typedef UA_StatusCode (*UA_decodeBinarySignature)(void *UA_RESTRICT dst, const UA_DataType *type);
+typedef UA_StatusCode (*UA_decodeBinarySignature)(void *UA_RESTRICT dst, const UA_DataType *type,
+                                                  Ctx *UA_RESTRICT ctx);
 static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1];
 
 typedef size_t (*UA_calcSizeBinarySignature)(const void *UA_RESTRICT p, const UA_DataType *contenttype);
 static const UA_calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES_COUNT + 1];
 
-/* We give pointers to the current position and the last position in the buffer
-   instead of a string with an offset. */
-UA_THREAD_LOCAL UA_Byte * pos;
-UA_THREAD_LOCAL UA_Byte * end;
+/* Structured types of namespace zero with generated straight-line functions.
+ * The entries for the types without are NULL. The tables are defined in
+ * ua_types_generated_encoding_specialized.inc at the end of this file. */
+static const UA_encodeBinarySignature encodeBinarySpecialized[UA_TYPES_COUNT];
+static const UA_decodeBinarySignature decodeBinarySpecialized[UA_TYPES_COUNT];
+static const UA_calcSizeBinarySignature calcSizeBinarySpecialized[UA_TYPES_COUNT];
+
+#define UA_SPECIALIZED(TABLE, TYPE)                                     \
+    ((TYPE)->typeIndex < UA_TYPES_COUNT && (TYPE) == &UA_TYPES[(TYPE)->typeIndex] ? \
+     TABLE[(TYPE)->typeIndex] : NULL)
+
+/* Look up a type of namespace zero by its typeId. Defined at the end of this
+ * file with the generated hash map. */
+static const UA_DataType * findDataType(const UA_NodeId *typeId);
+
+static UA_StatusCode UA_encodeBinaryInternal(const void *src, const UA_DataType *type, Ctx *ctx);
+static UA_StatusCode UA_decodeBinaryInternal(void *dst, const UA_DataType *type, Ctx *ctx);
+static size_t UA_calcSizeBinaryInternal(const void *p, const UA_DataType *type);
+
+/* Send the current chunk and replace the buffer. The encoders retry an element
+ * that did not fit on the new buffer. An element that does not fit into an
+ * empty buffer would be retried forever. */
+static UA_StatusCode exchangeBuffer(Ctx *ctx) {
+    if(!ctx->exchangeBufferCallback)
+        return UA_STATUSCODE_BADENCODINGERROR;
+    if(ctx->encodePendingLengths > 0 || ctx->pos == ctx->encodeBuf->data)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    size_t offset = ((uintptr_t)ctx->pos - (uintptr_t)ctx->encodeBuf->data) / sizeof(UA_Byte);
+    UA_StatusCode retval = ctx->exchangeBufferCallback(ctx->exchangeBufferCallbackHandle, ctx->encodeBuf, offset);
 
-/* The code UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED is returned only when the
- * end of the buffer is reached. This error is caught. We then try to send the
- * current chunk and continue with the next. */
+    /* set pos and end in order to continue encoding */
+    ctx->pos = ctx->encodeBuf->data;
+    ctx->end = &ctx->encodeBuf->data[ctx->encodeBuf->length];
+    return retval;
+}
 
-/* Thread-local buffers used for exchanging the buffer for chunking */
-UA_THREAD_LOCAL UA_ByteString *encodeBuf; /* the original buffer */
-UA_THREAD_LOCAL UA_exchangeEncodeBuffer exchangeBufferCallback;
-UA_THREAD_LOCAL void *exchangeBufferCallbackHandle;
+/* Continue in the next buffer */
+static UA_StatusCode decodeNextBuffer(Ctx *ctx) {
+    if(ctx->decodeStaged) {
+        ctx->decodeStaged = false;
+        ctx->pos = &ctx->decodeBuf.data[ctx->decodeStageSkip];
+        ctx->end = &ctx->decodeBuf.data[ctx->decodeBuf.length];
+        return UA_STATUSCODE_GOOD;
+    }
+    if(!ctx->decodeBufferCallback)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_StatusCode retval = ctx->decodeBufferCallback(ctx->decodeBufferCallbackHandle, &ctx->decodeBuf);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    ctx->decodeRemaining -= (ctx->decodeBuf.length < ctx->decodeRemaining) ? ctx->decodeBuf.length : ctx->decodeRemaining;
+    ctx->pos = ctx->decodeBuf.data;
+    ctx->end = &ctx->decodeBuf.data[ctx->decodeBuf.length];
+    return UA_STATUSCODE_GOOD;
+}
 
-/* Send the current chunk and replace the buffer */
-static UA_StatusCode exchangeBuffer(void) {
-    if(!exchangeBufferCallback)
-        return UA_STATUSCODE_BADENCODINGERROR;
+/* Make the next length bytes available at pos. Called when the current buffer
+ * ends before. */
+static UA_StatusCode decodeEnsure(size_t length, Ctx *ctx) {
+    if(!ctx->decodeBufferCallback || length > UA_DECODESTAGE)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    UA_Byte stage[UA_DECODESTAGE];
+    size_t have = (size_t)(ctx->end - ctx->pos);
+    memcpy(stage, ctx->pos, have);
+    UA_StatusCode retval = decodeNextBuffer(ctx);
+    while(retval == UA_STATUSCODE_GOOD && have == 0 && ctx->pos + length > ctx->end) {
+        /* the value starts in the next buffer */
+        if(ctx->pos < ctx->end) {
+            have = (size_t)(ctx->end - ctx->pos);
+            memcpy(stage, ctx->pos, have);
+        }
+        retval = decodeNextBuffer(ctx);
+    }
+    if(retval != UA_STATUSCODE_GOOD || (have == 0 && ctx->pos + length <= ctx->end))
+        return retval;
 
-    /* store context variables since chunk-sending might call UA_encode itself */
-    UA_ByteString *store_encodeBuf = encodeBuf;
-    UA_exchangeEncodeBuffer store_exchangeBufferCallback = exchangeBufferCallback;
-    void *store_exchangeBufferCallbackHandle = exchangeBufferCallbackHandle;
+    /* copy the beginning of the next buffer(s) behind the rest */
+    while(have < length) {
+        if(ctx->pos == ctx->end) {
+            retval = decodeNextBuffer(ctx);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            continue;
+        }
+        size_t take = length - have;
+        if(take > (size_t)(ctx->end - ctx->pos))
+            take = (size_t)(ctx->end - ctx->pos);
+        memcpy(&stage[have], ctx->pos, take);
+        have += take;
+        ctx->pos += take;
+    }
+    memcpy(ctx->decodeStage, stage, length);
+    ctx->decodeStageSkip = (size_t)(ctx->pos - ctx->decodeBuf.data);
+    ctx->decodeStaged = true;
+    ctx->pos = ctx->decodeStage;
+    ctx->end = &ctx->decodeStage[length];
+    return UA_STATUSCODE_GOOD;
+}
 
-    size_t offset = ((uintptr_t)pos - (uintptr_t)encodeBuf->data) / sizeof(UA_Byte);
-    UA_StatusCode retval = exchangeBufferCallback(exchangeBufferCallbackHandle, encodeBuf, offset);
+/* Copy length bytes from the source, possibly from several buffers */
+static UA_StatusCode decodeBytes(UA_Byte *dst, size_t length, Ctx *ctx) {
+    while(ctx->pos + length > ctx->end) {
+        size_t have = (size_t)(ctx->end - ctx->pos);
+        memcpy(dst, ctx->pos, have);
+        dst += have;
+        length -= have;
+        ctx->pos = ctx->end;
+        UA_StatusCode retval = decodeNextBuffer(ctx);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
+    memcpy(dst, ctx->pos, length);
+    ctx->pos += length;
+    return UA_STATUSCODE_GOOD;
+}
 
-    /* restore context variables */
-    encodeBuf = store_encodeBuf;
-    exchangeBufferCallback = store_exchangeBufferCallback;
-    exchangeBufferCallbackHandle = store_exchangeBufferCallbackHandle;
+/* The number of bytes left in the source */
+static size_t decodeAvailable(Ctx *ctx) {
+    size_t available = (size_t)(ctx->end - ctx->pos) + ctx->decodeRemaining;
+    if(ctx->decodeStaged)
+        available += ctx->decodeBuf.length - ctx->decodeStageSkip;
+    return available;
+}
 
-    /* set pos and end in order to continue encoding */
-    pos = encodeBuf->data;
-    end = &encodeBuf->data[encodeBuf->length];
-    return retval;
+#define UA_DECODE_ENSURE(LENGTH)                                        \
+    if(ctx->pos + (LENGTH) > ctx->end && decodeEnsure(LENGTH, ctx) != UA_STATUSCODE_GOOD) \
+        return UA_STATUSCODE_BADDECODINGERROR;
+
+static void * decodeCalloc(size_t size, Ctx *ctx) {
+    if(ctx->arena)
+        return UA_Arena_calloc(ctx->arena, size);
+    return UA_calloc(1, size);
+}
+
+static void decodeFree(void *p, Ctx *ctx) {
+    if(!ctx->arena)
+        UA_free(p);
 }
 
+static void decodeDeleteMembers(void *p, const UA_DataType *type, Ctx *ctx) {
+    if(!ctx->arena)
+        UA_deleteMembers(p, type);
+    else
+        UA_init(p, type);
+}
+
+/* Copy length bytes into the buffer. Members of structures that lie next to
+ * each other in memory and on the wire are encoded at once. */
+static UA_StatusCode encodeBytes(const UA_Byte *src, size_t length, Ctx *ctx) {
+    if(ctx->pos + length > ctx->end)
+        return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+    memcpy(ctx->pos, src, length);
+    ctx->pos += length;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Encode a member of a structure. If the buffer is full, it is exchanged and
+ * the member is encoded once more. Used by the generated functions. */
+#define UA_ENCODE_MEMBER(CALL) do {                                   \
+        UA_Byte *oldpos = ctx->pos;                                   \
+        retval = CALL;                                                \
+        if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {       \
+            ctx->pos = oldpos;                                        \
+            retval = exchangeBuffer(ctx);                             \
+            if(retval == UA_STATUSCODE_GOOD)                          \
+                retval = CALL;                                        \
+        }                                                             \
+        if(retval != UA_STATUSCODE_GOOD)                              \
+            return retval;                                            \
+    } while(0)
+
 /*****************/
 /* Integer Types */
 /*****************/
@@ -85,154 +264,149 @@ static void UA_decode64(const UA_Byte buf[8], UA_UInt64 *v) {
 
 /* Boolean */
 static UA_StatusCode
-Boolean_encodeBinary(const UA_Boolean *src, const UA_DataType *_) {
-    if(pos + sizeof(UA_Boolean) > end)
+Boolean_encodeBinary(const UA_Boolean *src, const UA_DataType *_, Ctx *ctx) {
+    if(ctx->pos + sizeof(UA_Boolean) > ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
-    *pos = *(const UA_Byte*)src;
-    pos++;
+    *ctx->pos = *(const UA_Byte*)src;
+    ctx->pos++;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-Boolean_decodeBinary(UA_Boolean *dst, const UA_DataType *_) {
-    if(pos + sizeof(UA_Boolean) > end)
-        return UA_STATUSCODE_BADDECODINGERROR;
-    *dst = (*pos > 0) ? true : false;
-    pos++;
+Boolean_decodeBinary(UA_Boolean *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_DECODE_ENSURE(sizeof(UA_Boolean));
+    *dst = (*ctx->pos > 0) ? true : false;
+    ctx->pos++;
     return UA_STATUSCODE_GOOD;
 }
 
 /* Byte */
 static UA_StatusCode
-Byte_encodeBinary(const UA_Byte *src, const UA_DataType *_) {
-    if(pos + sizeof(UA_Byte) > end)
+Byte_encodeBinary(const UA_Byte *src, const UA_DataType *_, Ctx *ctx) {
+    if(ctx->pos + sizeof(UA_Byte) > ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
-    *pos = *(const UA_Byte*)src;
-    pos++;
+    *ctx->pos = *(const UA_Byte*)src;
+    ctx->pos++;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_StatusCode
-Byte_decodeBinary(UA_Byte *dst, const UA_DataType *_) {
-    if(pos + sizeof(UA_Byte) > end)
-        return UA_STATUSCODE_BADDECODINGERROR;
-    *dst = *pos;
-    pos++;
+Byte_decodeBinary(UA_Byte *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_DECODE_ENSURE(sizeof(UA_Byte));
+    *dst = *ctx->pos;
+    ctx->pos++;
     return UA_STATUSCODE_GOOD;
 }
 
 /* UInt16 */
 static UA_StatusCode
-UInt16_encodeBinary(UA_UInt16 const *src, const UA_DataType *_) {
-    if(pos + sizeof(UA_UInt16) > end)
+UInt16_encodeBinary(UA_UInt16 const *src, const UA_DataType *_, Ctx *ctx) {
+    if(ctx->pos + sizeof(UA_UInt16) > ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
 #if UA_BINARY_OVERLAYABLE_INTEGER
-    memcpy(pos, src, sizeof(UA_UInt16));
+    memcpy(ctx->pos, src, sizeof(UA_UInt16));
 #else
-    UA_encode16(*src, pos);
+    UA_encode16(*src, ctx->pos);
 #endif
-    pos += 2;
+    ctx->pos += 2;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-Int16_encodeBinary(UA_Int16 const *src, const UA_DataType *_) {
-    return UInt16_encodeBinary((const UA_UInt16*)src, NULL);
+Int16_encodeBinary(UA_Int16 const *src, const UA_DataType *_, Ctx *ctx) {
+    return UInt16_encodeBinary((const UA_UInt16*)src, NULL, ctx);
 }
 
 static UA_StatusCode
-UInt16_decodeBinary(UA_UInt16 *dst, const UA_DataType *_) {
-    if(pos + sizeof(UA_UInt16) > end)
-        return UA_STATUSCODE_BADDECODINGERROR;
+UInt16_decodeBinary(UA_UInt16 *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_DECODE_ENSURE(sizeof(UA_UInt16));
 #if UA_BINARY_OVERLAYABLE_INTEGER
-    memcpy(dst, pos, sizeof(UA_UInt16));
+    memcpy(dst, ctx->pos, sizeof(UA_UInt16));
 #else
-    UA_decode16(pos, dst);
+    UA_decode16(ctx->pos, dst);
 #endif
-    pos += 2;
+    ctx->pos += 2;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-Int16_decodeBinary(UA_Int16 *dst) { return UInt16_decodeBinary((UA_UInt16*)dst, NULL); }
+Int16_decodeBinary(UA_Int16 *dst, Ctx *ctx) { return UInt16_decodeBinary((UA_UInt16*)dst, NULL, ctx); }
 
 /* UInt32 */
 static UA_StatusCode
-UInt32_encodeBinary(UA_UInt32 const *src, const UA_DataType *_) {
-    if(pos + sizeof(UA_UInt32) > end)
+UInt32_encodeBinary(UA_UInt32 const *src, const UA_DataType *_, Ctx *ctx) {
+    if(ctx->pos + sizeof(UA_UInt32) > ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
 #if UA_BINARY_OVERLAYABLE_INTEGER
-    memcpy(pos, src, sizeof(UA_UInt32));
+    memcpy(ctx->pos, src, sizeof(UA_UInt32));
 #else
-    UA_encode32(*src, pos);
+    UA_encode32(*src, ctx->pos);
 #endif
-    pos += 4;
+    ctx->pos += 4;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-Int32_encodeBinary(UA_Int32 const *src) { return UInt32_encodeBinary((const UA_UInt32*)src, NULL); }
+Int32_encodeBinary(UA_Int32 const *src, Ctx *ctx) { return UInt32_encodeBinary((const UA_UInt32*)src, NULL, ctx); }
 
 static UA_INLINE UA_StatusCode
-StatusCode_encodeBinary(UA_StatusCode const *src) { return UInt32_encodeBinary((const UA_UInt32*)src, NULL); }
+StatusCode_encodeBinary(UA_StatusCode const *src, Ctx *ctx) { return UInt32_encodeBinary((const UA_UInt32*)src, NULL, ctx); }
 
 static UA_StatusCode
-UInt32_decodeBinary(UA_UInt32 *dst, const UA_DataType *_) {
-    if(pos + sizeof(UA_UInt32) > end)
-        return UA_STATUSCODE_BADDECODINGERROR;
+UInt32_decodeBinary(UA_UInt32 *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_DECODE_ENSURE(sizeof(UA_UInt32));
 #if UA_BINARY_OVERLAYABLE_INTEGER
-    memcpy(dst, pos, sizeof(UA_UInt32));
+    memcpy(dst, ctx->pos, sizeof(UA_UInt32));
 #else
-    UA_decode32(pos, dst);
+    UA_decode32(ctx->pos, dst);
 #endif
-    pos += 4;
+    ctx->pos += 4;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-Int32_decodeBinary(UA_Int32 *dst) { return UInt32_decodeBinary((UA_UInt32*)dst, NULL); }
+Int32_decodeBinary(UA_Int32 *dst, Ctx *ctx) { return UInt32_decodeBinary((UA_UInt32*)dst, NULL, ctx); }
 
 static UA_INLINE UA_StatusCode
-StatusCode_decodeBinary(UA_StatusCode *dst) { return UInt32_decodeBinary((UA_UInt32*)dst, NULL); }
+StatusCode_decodeBinary(UA_StatusCode *dst, Ctx *ctx) { return UInt32_decodeBinary((UA_UInt32*)dst, NULL, ctx); }
 
 /* UInt64 */
 static UA_StatusCode
-UInt64_encodeBinary(UA_UInt64 const *src, const UA_DataType *_) {
-    if(pos + sizeof(UA_UInt64) > end)
+UInt64_encodeBinary(UA_UInt64 const *src, const UA_DataType *_, Ctx *ctx) {
+    if(ctx->pos + sizeof(UA_UInt64) > ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
 #if UA_BINARY_OVERLAYABLE_INTEGER
-    memcpy(pos, src, sizeof(UA_UInt64));
+    memcpy(ctx->pos, src, sizeof(UA_UInt64));
 #else
-    UA_encode64(*src, pos);
+    UA_encode64(*src, ctx->pos);
 #endif
-    pos += 8;
+    ctx->pos += 8;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-Int64_encodeBinary(UA_Int64 const *src) { return UInt64_encodeBinary((const UA_UInt64*)src, NULL); }
+Int64_encodeBinary(UA_Int64 const *src, Ctx *ctx) { return UInt64_encodeBinary((const UA_UInt64*)src, NULL, ctx); }
 
 static UA_INLINE UA_StatusCode
-DateTime_encodeBinary(UA_DateTime const *src) { return UInt64_encodeBinary((const UA_UInt64*)src, NULL); }
+DateTime_encodeBinary(UA_DateTime const *src, Ctx *ctx) { return UInt64_encodeBinary((const UA_UInt64*)src, NULL, ctx); }
 
 static UA_StatusCode
-UInt64_decodeBinary(UA_UInt64 *dst, const UA_DataType *_) {
-    if(pos + sizeof(UA_UInt64) > end)
-        return UA_STATUSCODE_BADDECODINGERROR;
+UInt64_decodeBinary(UA_UInt64 *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_DECODE_ENSURE(sizeof(UA_UInt64));
 #if UA_BINARY_OVERLAYABLE_INTEGER
-    memcpy(dst, pos, sizeof(UA_UInt64));
+    memcpy(dst, ctx->pos, sizeof(UA_UInt64));
 #else
-    UA_decode64(pos, dst);
+    UA_decode64(ctx->pos, dst);
 #endif
-    pos += 8;
+    ctx->pos += 8;
     return UA_STATUSCODE_GOOD;
 }
 
 static UA_INLINE UA_StatusCode
-Int64_decodeBinary(UA_Int64 *dst) { return UInt64_decodeBinary((UA_UInt64*)dst, NULL); }
+Int64_decodeBinary(UA_Int64 *dst, Ctx *ctx) { return UInt64_decodeBinary((UA_UInt64*)dst, NULL, ctx); }
 
 static UA_INLINE UA_StatusCode
-DateTime_decodeBinary(UA_DateTime *dst) { return UInt64_decodeBinary((UA_UInt64*)dst, NULL); }
+DateTime_decodeBinary(UA_DateTime *dst, Ctx *ctx) { return UInt64_decodeBinary((UA_UInt64*)dst, NULL, ctx); }
 
 /************************/
 /* Floating Point Types */
@@ -285,7 +459,7 @@ static long double unpack754(uint64_t i, unsigned bits, unsigned expbits) {
 #define FLOAT_NEG_ZERO 0x80000000
 
 static UA_StatusCode
-Float_encodeBinary(UA_Float const *src, const UA_DataType *_) {
+Float_encodeBinary(UA_Float const *src, const UA_DataType *_, Ctx *ctx) {
     UA_Float f = *src;
     UA_UInt32 encoded;
     //cppcheck-suppress duplicateExpression
@@ -294,13 +468,13 @@ Float_encodeBinary(UA_Float const *src, const UA_DataType *_) {
     //cppcheck-suppress duplicateExpression
     else if(f/f != f/f) encoded = f > 0 ? FLOAT_INF : FLOAT_NEG_INF;
     else encoded = (UA_UInt32)pack754(f, 32, 8);
-    return UInt32_encodeBinary(&encoded, NULL);
+    return UInt32_encodeBinary(&encoded, NULL, ctx);
 }
 
 static UA_StatusCode
-Float_decodeBinary(UA_Float *dst, const UA_DataType *_) {
+Float_decodeBinary(UA_Float *dst, const UA_DataType *_, Ctx *ctx) {
     UA_UInt32 decoded;
-    UA_StatusCode retval = UInt32_decodeBinary(&decoded, NULL);
+    UA_StatusCode retval = UInt32_decodeBinary(&decoded, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(decoded == 0) *dst = 0.0f;
@@ -320,7 +494,7 @@ Float_decodeBinary(UA_Float *dst, const UA_DataType *_) {
 #define DOUBLE_NEG_ZERO 0x8000000000000000L
 
 static UA_StatusCode
-Double_encodeBinary(UA_Double const *src, const UA_DataType *_) {
+Double_encodeBinary(UA_Double const *src, const UA_DataType *_, Ctx *ctx) {
     UA_Double d = *src;
     UA_UInt64 encoded;
     //cppcheck-suppress duplicateExpression
@@ -329,13 +503,13 @@ Double_encodeBinary(UA_Double const *src, const UA_DataType *_) {
     //cppcheck-suppress duplicateExpression
     else if(d/d != d/d) encoded = d > 0 ? DOUBLE_INF : DOUBLE_NEG_INF;
     else encoded = pack754(d, 64, 11);
-    return UInt64_encodeBinary(&encoded, NULL);
+    return UInt64_encodeBinary(&encoded, NULL, ctx);
 }
 
 static UA_StatusCode
-Double_decodeBinary(UA_Double *dst, const UA_DataType *_) {
+Double_decodeBinary(UA_Double *dst, const UA_DataType *_, Ctx *ctx) {
     UA_UInt64 decoded;
-    UA_StatusCode retval = UInt64_decodeBinary(&decoded, NULL);
+    UA_StatusCode retval = UInt64_decodeBinary(&decoded, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(decoded == 0) *dst = 0.0;
@@ -355,8 +529,90 @@ Double_decodeBinary(UA_Double *dst, const UA_DataType *_) {
 /* Array Handling */
 /******************/
 
+/* On big-endian hosts, arrays of numeric types are converted in bulk instead of
+ * calling the encoding function for every element. The loops have no
+ * dependencies between elements, so that the compiler vectorizes them with the
+ * byte-shuffle instructions of the target (AltiVec, NEON, SSSE3). Floats are
+ * converted this way only if they are big-endian as well. Hosts where
+ * big-endian is not positively detected (also mixed-endian hosts) encode
+ * element by element. */
+#if !UA_BINARY_OVERLAYABLE_INTEGER && defined(__BYTE_ORDER__) && \
+    defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+# define UA_ARRAY_SWAP
+# if !UA_BINARY_OVERLAYABLE_FLOAT && defined(__FLOAT_WORD_ORDER__) && \
+    (__FLOAT_WORD_ORDER__ == __ORDER_BIG_ENDIAN__)
+#  define UA_ARRAY_SWAP_FLOAT
+# endif
+
+# if defined(__GNUC__) || defined(__clang__)
+#  define UA_BSWAP16(v) __builtin_bswap16(v)
+#  define UA_BSWAP32(v) __builtin_bswap32(v)
+#  define UA_BSWAP64(v) __builtin_bswap64(v)
+# else
+#  define UA_BSWAP16(v) ((UA_UInt16)(((v) >> 8) | ((v) << 8)))
+#  define UA_BSWAP32(v) ((((v) & 0xff000000u) >> 24) | (((v) & 0x00ff0000u) >> 8) | \
+                         (((v) & 0x0000ff00u) << 8) | (((v) & 0x000000ffu) << 24))
+#  define UA_BSWAP64(v) (((UA_UInt64)UA_BSWAP32((UA_UInt32)(v)) << 32) | \
+                         (UA_UInt64)UA_BSWAP32((UA_UInt32)((v) >> 32)))
+# endif
+
+/* The size of the elements that are swapped. Zero if the type is encoded
+ * element by element. */
+static size_t arraySwapSize(const UA_DataType *type) {
+    if(!type->builtin)
+        return 0;
+    switch(type->typeIndex) {
+    case UA_TYPES_INT16:
+    case UA_TYPES_UINT16:
+        return 2;
+    case UA_TYPES_INT32:
+    case UA_TYPES_UINT32:
+    case UA_TYPES_STATUSCODE:
+        return 4;
+    case UA_TYPES_INT64:
+    case UA_TYPES_UINT64:
+    case UA_TYPES_DATETIME:
+        return 8;
+# ifdef UA_ARRAY_SWAP_FLOAT
+    case UA_TYPES_FLOAT:
+        return 4;
+    case UA_TYPES_DOUBLE:
+        return 8;
+# endif
+    default:
+        return 0;
+    }
+}
+
+/* Swap the byte order of length elements. src and dst may be the same. */
+static void arraySwap(UA_Byte *dst, const UA_Byte *src, size_t length, size_t size) {
+    if(size == 2) {
+        for(size_t i = 0; i < length; i++) {
+            UA_UInt16 v;
+            memcpy(&v, &src[i * 2], 2);
+            v = UA_BSWAP16(v);
+            memcpy(&dst[i * 2], &v, 2);
+        }
+    } else if(size == 4) {
+        for(size_t i = 0; i < length; i++) {
+            UA_UInt32 v;
+            memcpy(&v, &src[i * 4], 4);
+            v = UA_BSWAP32(v);
+            memcpy(&dst[i * 4], &v, 4);
+        }
+    } else {
+        for(size_t i = 0; i < length; i++) {
+            UA_UInt64 v;
+            memcpy(&v, &src[i * 8], 8);
+            v = UA_BSWAP64(v);
+            memcpy(&dst[i * 8], &v, 8);
+        }
+    }
+}
+#endif
+
 static UA_StatusCode
-Array_encodeBinary(const void *src, size_t length, const UA_DataType *type) {
+Array_encodeBinary(const void *src, size_t length, const UA_DataType *type, Ctx *ctx) {
     UA_Int32 signed_length = -1;
     if(length > UA_INT32_MAX)
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -364,38 +620,58 @@ Array_encodeBinary(const void *src, size_t length, const UA_DataType *type) {
         signed_length = (UA_Int32)length;
     else if(src == UA_EMPTY_ARRAY_SENTINEL)
         signed_length = 0;
-    UA_StatusCode retval = Int32_encodeBinary(&signed_length);
+    UA_StatusCode retval = Int32_encodeBinary(&signed_length, ctx);
     if(retval != UA_STATUSCODE_GOOD || length == 0)
         return retval;
 
     if(type->overlayable) {
         size_t i = 0; /* the number of already encoded elements */
-        while(end < pos + (type->memSize * (length-i))) {
+        while(ctx->end < ctx->pos + (type->memSize * (length-i))) {
             /* not enough space, need to exchange the buffer */
-            size_t elements = ((uintptr_t)end - (uintptr_t)pos) / (sizeof(UA_Byte) * type->memSize);
-            memcpy(pos, src, type->memSize * elements);
-            pos += type->memSize * elements;
+            size_t elements = ((uintptr_t)ctx->end - (uintptr_t)ctx->pos) / (sizeof(UA_Byte) * type->memSize);
+            memcpy(ctx->pos, (const UA_Byte*)src + (type->memSize * i), type->memSize * elements);
+            ctx->pos += type->memSize * elements;
             i += elements;
-            retval = exchangeBuffer();
+            retval = exchangeBuffer(ctx);
             if(retval != UA_STATUSCODE_GOOD)
                 return retval;
         }
         /* encode the remaining elements */
-        memcpy(pos, src, type->memSize * (length-i));
-        pos += type->memSize * (length-i);
+        memcpy(ctx->pos, (const UA_Byte*)src + (type->memSize * i), type->memSize * (length-i));
+        ctx->pos += type->memSize * (length-i);
         return UA_STATUSCODE_GOOD;
     }
 
+#ifdef UA_ARRAY_SWAP
+    size_t swapSize = arraySwapSize(type);
+    if(swapSize > 0) {
+        size_t i = 0; /* the number of already encoded elements */
+        while(true) {
+            size_t elements = (size_t)(ctx->end - ctx->pos) / swapSize;
+            if(elements > length - i)
+                elements = length - i;
+            arraySwap(ctx->pos, (const UA_Byte*)src + (swapSize * i), elements, swapSize);
+            ctx->pos += swapSize * elements;
+            i += elements;
+            if(i == length)
+                return UA_STATUSCODE_GOOD;
+            retval = exchangeBuffer(ctx);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+        }
+    }
+#endif
+
     uintptr_t ptr = (uintptr_t)src;
     size_t encode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
     for(size_t i = 0; i < length && retval == UA_STATUSCODE_GOOD; i++) {
-        UA_Byte *oldpos = pos;
-        retval = encodeBinaryJumpTable[encode_index]((const void*)ptr, type);
+        UA_Byte *oldpos = ctx->pos;
+        retval = encodeBinaryJumpTable[encode_index]((const void*)ptr, type, ctx);
         ptr += type->memSize;
         if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
             /* exchange the buffer and try to encode the same element once more */
-            pos = oldpos;
-            retval = exchangeBuffer();
+            ctx->pos = oldpos;
+            retval = exchangeBuffer(ctx);
             /* Repeat encoding of the same element */
             ptr -= type->memSize;
             i--;
@@ -406,7 +682,7 @@ Array_encodeBinary(const void *src, size_t length, const UA_DataType *type) {
 
 static UA_StatusCode
 Array_decodeBinary(UA_Int32 signed_length, void *UA_RESTRICT *UA_RESTRICT dst,
-                   size_t *out_length, const UA_DataType *type) {
+                   size_t *out_length, const UA_DataType *type, Ctx *ctx) {
     *out_length = 0;
     if(signed_length <= 0) {
         *dst = NULL;
@@ -418,28 +694,44 @@ Array_decodeBinary(UA_Int32 signed_length, void *UA_RESTRICT *UA_RESTRICT dst,
 
     /* filter out arrays that can obviously not be parsed, because the message
        is too small */
-    if(pos + ((type->memSize * length) / 32) > end)
+    if((type->memSize * length) / 32 > decodeAvailable(ctx))
         return UA_STATUSCODE_BADDECODINGERROR;
 
-    *dst = UA_calloc(1, type->memSize * length);
+    *dst = decodeCalloc(type->memSize * length, ctx);
     if(!*dst)
         return UA_STATUSCODE_BADOUTOFMEMORY;
 
     if(type->overlayable) {
-        if(end < pos + (type->memSize * length))
+        if(decodeBytes(*dst, type->memSize * length, ctx) != UA_STATUSCODE_GOOD) {
+            decodeFree(*dst, ctx);
+            *dst = NULL;
+            return UA_STATUSCODE_BADDECODINGERROR;
+        }
+        *out_length = length;
+        return UA_STATUSCODE_GOOD;
+    }
+
+#ifdef UA_ARRAY_SWAP
+    size_t swapSize = arraySwapSize(type);
+    if(swapSize > 0) {
+        if(decodeBytes(*dst, swapSize * length, ctx) != UA_STATUSCODE_GOOD) {
+            decodeFree(*dst, ctx);
+            *dst = NULL;
             return UA_STATUSCODE_BADDECODINGERROR;
-        memcpy(*dst, pos, type->memSize * length);
-        pos += type->memSize * length;
+        }
+        arraySwap((UA_Byte*)*dst, (const UA_Byte*)*dst, length, swapSize);
         *out_length = length;
         return UA_STATUSCODE_GOOD;
     }
+#endif
 
     uintptr_t ptr = (uintptr_t)*dst;
     size_t decode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
     for(size_t i = 0; i < length; i++) {
-        UA_StatusCode retval = decodeBinaryJumpTable[decode_index]((void*)ptr, type);
+        UA_StatusCode retval = decodeBinaryJumpTable[decode_index]((void*)ptr, type, ctx);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_Array_delete(*dst, i, type);
+            if(!ctx->arena)
+                UA_Array_delete(*dst, i, type);
             *dst = NULL;
             return retval;
         }
@@ -454,47 +746,57 @@ Array_decodeBinary(UA_Int32 signed_length, void *UA_RESTRICT *UA_RESTRICT dst,
 /*****************/
 
 static UA_StatusCode
-String_encodeBinary(UA_String const *src, const UA_DataType *_) {
-    return Array_encodeBinary(src->data, src->length, &UA_TYPES[UA_TYPES_BYTE]);
+String_encodeBinary(UA_String const *src, const UA_DataType *_, Ctx *ctx) {
+    return Array_encodeBinary(src->data, src->length, &UA_TYPES[UA_TYPES_BYTE], ctx);
 }
 
 static UA_StatusCode
-String_decodeBinary(UA_String *dst, const UA_DataType *_) {
+String_decodeBinary(UA_String *dst, const UA_DataType *_, Ctx *ctx) {
     UA_Int32 signed_length;
-    UA_StatusCode retval = Int32_decodeBinary(&signed_length);
+    UA_StatusCode retval = Int32_decodeBinary(&signed_length, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
-    return Array_decodeBinary(signed_length, (void**)&dst->data, &dst->length, &UA_TYPES[UA_TYPES_BYTE]);
+
+    /* Values decoded into an arena are never freed member by member. The
+     * content is borrowed from the source if it lies within the current
+     * buffer. Strings split between buffers are copied. */
+    if(ctx->arena && signed_length > 0 && !ctx->decodeStaged &&
+       (size_t)signed_length <= (size_t)(ctx->end - ctx->pos)) {
+        dst->data = ctx->pos;
+        dst->length = (size_t)signed_length;
+        ctx->pos += signed_length;
+        return UA_STATUSCODE_GOOD;
+    }
+    return Array_decodeBinary(signed_length, (void**)&dst->data, &dst->length, &UA_TYPES[UA_TYPES_BYTE], ctx);
 }
 
 static UA_INLINE UA_StatusCode
-ByteString_encodeBinary(UA_ByteString const *src) { return String_encodeBinary((const UA_String*)src, NULL); }
+ByteString_encodeBinary(UA_ByteString const *src, Ctx *ctx) { return String_encodeBinary((const UA_String*)src, NULL, ctx); }
 
 static UA_INLINE UA_StatusCode
-ByteString_decodeBinary(UA_ByteString *dst) { return String_decodeBinary((UA_ByteString*)dst, NULL); }
+ByteString_decodeBinary(UA_ByteString *dst, Ctx *ctx) { return String_decodeBinary((UA_ByteString*)dst, NULL, ctx); }
 
 /* Guid */
 static UA_StatusCode
-Guid_encodeBinary(UA_Guid const *src, const UA_DataType *_) {
-    UA_StatusCode retval = UInt32_encodeBinary(&src->data1, NULL);
-    retval |= UInt16_encodeBinary(&src->data2, NULL);
-    retval |= UInt16_encodeBinary(&src->data3, NULL);
-    if(pos + (8*sizeof(UA_Byte)) > end)
+Guid_encodeBinary(UA_Guid const *src, const UA_DataType *_, Ctx *ctx) {
+    UA_StatusCode retval = UInt32_encodeBinary(&src->data1, NULL, ctx);
+    retval |= UInt16_encodeBinary(&src->data2, NULL, ctx);
+    retval |= UInt16_encodeBinary(&src->data3, NULL, ctx);
+    if(ctx->pos + (8*sizeof(UA_Byte)) > ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
-    memcpy(pos, src->data4, 8*sizeof(UA_Byte));
-    pos += 8;
+    memcpy(ctx->pos, src->data4, 8*sizeof(UA_Byte));
+    ctx->pos += 8;
     return retval;
 }
 
 static UA_StatusCode
-Guid_decodeBinary(UA_Guid *dst, const UA_DataType *_) {
-    UA_StatusCode retval = UInt32_decodeBinary(&dst->data1, NULL);
-    retval |= UInt16_decodeBinary(&dst->data2, NULL);
-    retval |= UInt16_decodeBinary(&dst->data3, NULL);
-    if(pos + (8*sizeof(UA_Byte)) > end)
-        return UA_STATUSCODE_BADDECODINGERROR;
-    memcpy(dst->data4, pos, 8*sizeof(UA_Byte));
-    pos += 8;
+Guid_decodeBinary(UA_Guid *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_StatusCode retval = UInt32_decodeBinary(&dst->data1, NULL, ctx);
+    retval |= UInt16_decodeBinary(&dst->data2, NULL, ctx);
+    retval |= UInt16_decodeBinary(&dst->data3, NULL, ctx);
+    UA_DECODE_ENSURE(8*sizeof(UA_Byte));
+    memcpy(dst->data4, ctx->pos, 8*sizeof(UA_Byte));
+    ctx->pos += 8;
     return retval;
 }
 
@@ -504,7 +806,7 @@ Guid_decodeBinary(UA_Guid *dst, const UA_DataType *_) {
 #define UA_NODEIDTYPE_NUMERIC_COMPLETE 2
 
 static UA_StatusCode
-NodeId_encodeBinary(UA_NodeId const *src, const UA_DataType *_) {
+NodeId_encodeBinary(UA_NodeId const *src, const UA_DataType *_, Ctx *ctx) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     // temporary variables for endian-save code
     UA_Byte srcByte;
@@ -514,41 +816,41 @@ NodeId_encodeBinary(UA_NodeId const *src, const UA_DataType *_) {
     case UA_NODEIDTYPE_NUMERIC:
         if(src->identifier.numeric > UA_UINT16_MAX || src->namespaceIndex > UA_BYTE_MAX) {
             srcByte = UA_NODEIDTYPE_NUMERIC_COMPLETE;
-            retval |= Byte_encodeBinary(&srcByte, NULL);
-            retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL);
+            retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
+            retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL, ctx);
             srcUInt32 = src->identifier.numeric;
-            retval |= UInt32_encodeBinary(&srcUInt32, NULL);
+            retval |= UInt32_encodeBinary(&srcUInt32, NULL, ctx);
         } else if(src->identifier.numeric > UA_BYTE_MAX || src->namespaceIndex > 0) {
             srcByte = UA_NODEIDTYPE_NUMERIC_FOURBYTE;
-            retval |= Byte_encodeBinary(&srcByte, NULL);
+            retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
             srcByte = (UA_Byte)src->namespaceIndex;
             srcUInt16 = (UA_UInt16)src->identifier.numeric;
-            retval |= Byte_encodeBinary(&srcByte, NULL);
-            retval |= UInt16_encodeBinary(&srcUInt16, NULL);
+            retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
+            retval |= UInt16_encodeBinary(&srcUInt16, NULL, ctx);
         } else {
             srcByte = UA_NODEIDTYPE_NUMERIC_TWOBYTE;
-            retval |= Byte_encodeBinary(&srcByte, NULL);
+            retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
             srcByte = (UA_Byte)src->identifier.numeric;
-            retval |= Byte_encodeBinary(&srcByte, NULL);
+            retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
         }
         break;
     case UA_NODEIDTYPE_STRING:
         srcByte = UA_NODEIDTYPE_STRING;
-        retval |= Byte_encodeBinary(&srcByte, NULL);
-        retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL);
-        retval |= String_encodeBinary(&src->identifier.string, NULL);
+        retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
+        retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL, ctx);
+        retval |= String_encodeBinary(&src->identifier.string, NULL, ctx);
         break;
     case UA_NODEIDTYPE_GUID:
         srcByte = UA_NODEIDTYPE_GUID;
-        retval |= Byte_encodeBinary(&srcByte, NULL);
-        retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL);
-        retval |= Guid_encodeBinary(&src->identifier.guid, NULL);
+        retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
+        retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL, ctx);
+        retval |= Guid_encodeBinary(&src->identifier.guid, NULL, ctx);
         break;
     case UA_NODEIDTYPE_BYTESTRING:
         srcByte = UA_NODEIDTYPE_BYTESTRING;
-        retval |= Byte_encodeBinary(&srcByte, NULL);
-        retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL);
-        retval |= ByteString_encodeBinary(&src->identifier.byteString);
+        retval |= Byte_encodeBinary(&srcByte, NULL, ctx);
+        retval |= UInt16_encodeBinary(&src->namespaceIndex, NULL, ctx);
+        retval |= ByteString_encodeBinary(&src->identifier.byteString, ctx);
         break;
     default:
         return UA_STATUSCODE_BADINTERNALERROR;
@@ -557,52 +859,52 @@ NodeId_encodeBinary(UA_NodeId const *src, const UA_DataType *_) {
 }
 
 static UA_StatusCode
-NodeId_decodeBinary(UA_NodeId *dst, const UA_DataType *_) {
+NodeId_decodeBinary(UA_NodeId *dst, const UA_DataType *_, Ctx *ctx) {
     UA_Byte dstByte = 0, encodingByte = 0;
     UA_UInt16 dstUInt16 = 0;
-    UA_StatusCode retval = Byte_decodeBinary(&encodingByte, NULL);
+    UA_StatusCode retval = Byte_decodeBinary(&encodingByte, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     switch (encodingByte) {
     case UA_NODEIDTYPE_NUMERIC_TWOBYTE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
-        retval = Byte_decodeBinary(&dstByte, NULL);
+        retval = Byte_decodeBinary(&dstByte, NULL, ctx);
         dst->identifier.numeric = dstByte;
         dst->namespaceIndex = 0;
         break;
     case UA_NODEIDTYPE_NUMERIC_FOURBYTE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
-        retval |= Byte_decodeBinary(&dstByte, NULL);
+        retval |= Byte_decodeBinary(&dstByte, NULL, ctx);
         dst->namespaceIndex = dstByte;
-        retval |= UInt16_decodeBinary(&dstUInt16, NULL);
+        retval |= UInt16_decodeBinary(&dstUInt16, NULL, ctx);
         dst->identifier.numeric = dstUInt16;
         break;
     case UA_NODEIDTYPE_NUMERIC_COMPLETE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
-        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL);
-        retval |= UInt32_decodeBinary(&dst->identifier.numeric, NULL);
+        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL, ctx);
+        retval |= UInt32_decodeBinary(&dst->identifier.numeric, NULL, ctx);
         break;
     case UA_NODEIDTYPE_STRING:
         dst->identifierType = UA_NODEIDTYPE_STRING;
-        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL);
-        retval |= String_decodeBinary(&dst->identifier.string, NULL);
+        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL, ctx);
+        retval |= String_decodeBinary(&dst->identifier.string, NULL, ctx);
         break;
     case UA_NODEIDTYPE_GUID:
         dst->identifierType = UA_NODEIDTYPE_GUID;
-        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL);
-        retval |= Guid_decodeBinary(&dst->identifier.guid, NULL);
+        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL, ctx);
+        retval |= Guid_decodeBinary(&dst->identifier.guid, NULL, ctx);
         break;
     case UA_NODEIDTYPE_BYTESTRING:
         dst->identifierType = UA_NODEIDTYPE_BYTESTRING;
-        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL);
-        retval |= ByteString_decodeBinary(&dst->identifier.byteString);
+        retval |= UInt16_decodeBinary(&dst->namespaceIndex, NULL, ctx);
+        retval |= ByteString_decodeBinary(&dst->identifier.byteString, ctx);
         break;
     default:
         retval |= UA_STATUSCODE_BADINTERNALERROR; // the client sends an encodingByte we do not recognize
         break;
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_NodeId_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_NODEID], ctx);
     return retval;
 }
 
@@ -611,37 +913,36 @@ NodeId_decodeBinary(UA_NodeId *dst, const UA_DataType *_) {
 #define UA_EXPANDEDNODEID_SERVERINDEX_FLAG 0x40
 
 static UA_StatusCode
-ExpandedNodeId_encodeBinary(UA_ExpandedNodeId const *src, const UA_DataType *_) {
-    if(pos >= end)
+ExpandedNodeId_encodeBinary(UA_ExpandedNodeId const *src, const UA_DataType *_, Ctx *ctx) {
+    if(ctx->pos >= ctx->end)
         return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
-    UA_Byte *start = pos;
-    UA_StatusCode retval = NodeId_encodeBinary(&src->nodeId, NULL);
+    UA_Byte *start = ctx->pos;
+    UA_StatusCode retval = NodeId_encodeBinary(&src->nodeId, NULL, ctx);
     if(src->namespaceUri.length > 0) {
-        retval |= String_encodeBinary(&src->namespaceUri, NULL);
+        retval |= String_encodeBinary(&src->namespaceUri, NULL, ctx);
         *start |= UA_EXPANDEDNODEID_NAMESPACEURI_FLAG;
     }
     if(src->serverIndex > 0) {
-        retval |= UInt32_encodeBinary(&src->serverIndex, NULL);
+        retval |= UInt32_encodeBinary(&src->serverIndex, NULL, ctx);
         *start |= UA_EXPANDEDNODEID_SERVERINDEX_FLAG;
     }
     return retval;
 }
 
 static UA_StatusCode
-ExpandedNodeId_decodeBinary(UA_ExpandedNodeId *dst, const UA_DataType *_) {
-    if(pos >= end)
-        return UA_STATUSCODE_BADDECODINGERROR;
-    UA_Byte encodingByte = *pos;
-    *pos = encodingByte & (UA_Byte)~(UA_EXPANDEDNODEID_NAMESPACEURI_FLAG | UA_EXPANDEDNODEID_SERVERINDEX_FLAG);
-    UA_StatusCode retval = NodeId_decodeBinary(&dst->nodeId, NULL);
+ExpandedNodeId_decodeBinary(UA_ExpandedNodeId *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_DECODE_ENSURE(1);
+    UA_Byte encodingByte = *ctx->pos;
+    *ctx->pos = encodingByte & (UA_Byte)~(UA_EXPANDEDNODEID_NAMESPACEURI_FLAG | UA_EXPANDEDNODEID_SERVERINDEX_FLAG);
+    UA_StatusCode retval = NodeId_decodeBinary(&dst->nodeId, NULL, ctx);
     if(encodingByte & UA_EXPANDEDNODEID_NAMESPACEURI_FLAG) {
         dst->nodeId.namespaceIndex = 0;
-        retval |= String_decodeBinary(&dst->namespaceUri, NULL);
+        retval |= String_decodeBinary(&dst->namespaceUri, NULL, ctx);
     }
     if(encodingByte & UA_EXPANDEDNODEID_SERVERINDEX_FLAG)
-        retval |= UInt32_decodeBinary(&dst->serverIndex, NULL);
+        retval |= UInt32_decodeBinary(&dst->serverIndex, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
-        UA_ExpandedNodeId_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_EXPANDEDNODEID], ctx);
     return retval;
 }
 
@@ -650,36 +951,36 @@ ExpandedNodeId_decodeBinary(UA_ExpandedNodeId *dst, const UA_DataType *_) {
 #define UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT 0x02
 
 static UA_StatusCode
-LocalizedText_encodeBinary(UA_LocalizedText const *src, const UA_DataType *_) {
+LocalizedText_encodeBinary(UA_LocalizedText const *src, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingMask = 0;
     if(src->locale.data)
         encodingMask |= UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_LOCALE;
     if(src->text.data)
         encodingMask |= UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT;
-    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, NULL);
+    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, NULL, ctx);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_LOCALE)
-        retval |= String_encodeBinary(&src->locale, NULL);
+        retval |= String_encodeBinary(&src->locale, NULL, ctx);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT)
-        retval |= String_encodeBinary(&src->text, NULL);
+        retval |= String_encodeBinary(&src->text, NULL, ctx);
     return retval;
 }
 
 static UA_StatusCode
-LocalizedText_decodeBinary(UA_LocalizedText *dst, const UA_DataType *_) {
+LocalizedText_decodeBinary(UA_LocalizedText *dst, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingMask = 0;
-    UA_StatusCode retval = Byte_decodeBinary(&encodingMask, NULL);
+    UA_StatusCode retval = Byte_decodeBinary(&encodingMask, NULL, ctx);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_LOCALE)
-        retval |= String_decodeBinary(&dst->locale, NULL);
+        retval |= String_decodeBinary(&dst->locale, NULL, ctx);
     if(encodingMask & UA_LOCALIZEDTEXT_ENCODINGMASKTYPE_TEXT)
-        retval |= String_decodeBinary(&dst->text, NULL);
+        retval |= String_decodeBinary(&dst->text, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
-        UA_LocalizedText_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT], ctx);
     return retval;
 }
 
 /* ExtensionObject */
 static UA_StatusCode
-ExtensionObject_encodeBinary(UA_ExtensionObject const *src, const UA_DataType *_) {
+ExtensionObject_encodeBinary(UA_ExtensionObject const *src, const UA_DataType *_, Ctx *ctx) {
     UA_StatusCode retval;
     UA_Byte encoding = src->encoding;
     if(encoding > UA_EXTENSIONOBJECT_ENCODED_XML) {
@@ -690,28 +991,57 @@ ExtensionObject_encodeBinary(UA_ExtensionObject const *src, const UA_DataType *_
             return UA_STATUSCODE_BADENCODINGERROR;
         typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
         encoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
-        retval = NodeId_encodeBinary(&typeId, NULL);
-        retval |= Byte_encodeBinary(&encoding, NULL);
-        UA_Byte *old_pos = pos; /* save the position to encode the length afterwards */
-        pos += 4; /* jump over the length field */
+        retval = NodeId_encodeBinary(&typeId, NULL, ctx);
+        retval |= Byte_encodeBinary(&encoding, NULL, ctx);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        if(ctx->pos + 4 > ctx->end)
+            return UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED;
+
+        /* Jump over the length field, encode the body and write the length
+         * afterwards. So the body is traversed only once. */
+        UA_Byte *lengthPos = ctx->pos;
+        ctx->pos += 4;
         const UA_DataType *type = src->content.decoded.type;
         size_t encode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-        retval |= encodeBinaryJumpTable[encode_index](src->content.decoded.data, type);
+        ctx->encodePendingLengths++;
+        retval = encodeBinaryJumpTable[encode_index](src->content.decoded.data, type, ctx);
+        ctx->encodePendingLengths--;
+
+        /* The body does not fit into the current buffer. The buffer cannot be
+         * sent while the length is open. If this is the outermost open length,
+         * compute the length up front and encode the body over several
+         * buffers. */
+        if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED &&
+           ctx->exchangeBufferCallback && ctx->encodePendingLengths == 0) {
+            size_t bodySize = UA_calcSizeBinaryInternal(src->content.decoded.data, type);
+            if(bodySize > UA_INT32_MAX)
+                return UA_STATUSCODE_BADENCODINGERROR;
+            UA_Int32 length = (UA_Int32)bodySize;
+            ctx->pos = lengthPos;
+            retval = Int32_encodeBinary(&length, ctx);
+            if(retval != UA_STATUSCODE_GOOD)
+                return retval;
+            return encodeBinaryJumpTable[encode_index](src->content.decoded.data, type, ctx);
+        }
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+
         /* jump back, encode the length, jump back forward */
-        UA_Int32 length = (UA_Int32)(((uintptr_t)pos - (uintptr_t)old_pos) / sizeof(UA_Byte)) - 4;
-        UA_Byte *new_pos = pos;
-        pos = old_pos;
-        retval |= Int32_encodeBinary(&length);
-        pos = new_pos;
+        UA_Int32 length = (UA_Int32)(ctx->pos - lengthPos) - 4;
+        UA_Byte *new_pos = ctx->pos;
+        ctx->pos = lengthPos;
+        retval = Int32_encodeBinary(&length, ctx);
+        ctx->pos = new_pos;
     } else {
-        retval = NodeId_encodeBinary(&src->content.encoded.typeId, NULL);
-        retval |= Byte_encodeBinary(&encoding, NULL);
+        retval = NodeId_encodeBinary(&src->content.encoded.typeId, NULL, ctx);
+        retval |= Byte_encodeBinary(&encoding, NULL, ctx);
         switch (src->encoding) {
         case UA_EXTENSIONOBJECT_ENCODED_NOBODY:
             break;
         case UA_EXTENSIONOBJECT_ENCODED_BYTESTRING:
         case UA_EXTENSIONOBJECT_ENCODED_XML:
-            retval |= ByteString_encodeBinary(&src->content.encoded.body);
+            retval |= ByteString_encodeBinary(&src->content.encoded.body, ctx);
             break;
         default:
             return UA_STATUSCODE_BADINTERNALERROR;
@@ -720,67 +1050,73 @@ ExtensionObject_encodeBinary(UA_ExtensionObject const *src, const UA_DataType *_
     return retval;
 }
 
-static UA_StatusCode findDataType(const UA_NodeId *typeId, const UA_DataType **findtype) {
-    for(size_t i = 0; i < UA_TYPES_COUNT; i++) {
-        if(UA_NodeId_equal(typeId, &UA_TYPES[i].typeId)) {
-            *findtype = &UA_TYPES[i];
-            return UA_STATUSCODE_GOOD;
-        }
-    }
-    return UA_STATUSCODE_BADNODEIDUNKNOWN;
-}
-
+/* Decode the content after the typeId and the encoding byte. The typeId is
+ * moved into the ExtensionObject or deleted. */
 static UA_StatusCode
-ExtensionObject_decodeBinary(UA_ExtensionObject *dst, const UA_DataType *_) {
-    UA_Byte encoding = 0;
-    UA_NodeId typeId;
-    UA_NodeId_init(&typeId);
-    UA_StatusCode retval = NodeId_decodeBinary(&typeId, NULL);
-    retval |= Byte_decodeBinary(&encoding, NULL);
-    if(typeId.namespaceIndex != 0 || typeId.identifierType != UA_NODEIDTYPE_NUMERIC)
-        retval = UA_STATUSCODE_BADDECODINGERROR;
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeId_deleteMembers(&typeId);
-        return retval;
+ExtensionObject_decodeBinaryContent(UA_ExtensionObject *dst, UA_NodeId *typeId, UA_Byte encoding, Ctx *ctx) {
+    if(typeId->namespaceIndex != 0 || typeId->identifierType != UA_NODEIDTYPE_NUMERIC) {
+        decodeDeleteMembers(typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
+        return UA_STATUSCODE_BADDECODINGERROR;
     }
 
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
     if(encoding == UA_EXTENSIONOBJECT_ENCODED_NOBODY) {
         dst->encoding = encoding;
-        dst->content.encoded.typeId = typeId;
+        dst->content.encoded.typeId = *typeId;
         dst->content.encoded.body = UA_BYTESTRING_NULL;
     } else if(encoding == UA_EXTENSIONOBJECT_ENCODED_XML) {
         dst->encoding = encoding;
-        dst->content.encoded.typeId = typeId;
-        retval = ByteString_decodeBinary(&dst->content.encoded.body);
+        dst->content.encoded.typeId = *typeId;
+        retval = ByteString_decodeBinary(&dst->content.encoded.body, ctx);
     } else {
         /* try to decode the content */
         const UA_DataType *type = NULL;
         /* helping clang analyzer, typeId is numeric */
-        UA_assert(typeId.identifier.byteString.data == NULL);
-        UA_assert(typeId.identifier.string.data == NULL);
-        typeId.identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
-        findDataType(&typeId, &type);
+        UA_assert(typeId->identifier.byteString.data == NULL);
+        UA_assert(typeId->identifier.string.data == NULL);
+        if(!ctx->lazyExtensionObjects) {
+            typeId->identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
+            type = findDataType(typeId);
+            typeId->identifier.numeric += UA_ENCODINGOFFSET_BINARY;
+        }
         if(type) {
-            pos += 4; /* jump over the length (todo: check if length matches) */
-            dst->content.decoded.data = UA_new(type);
+            UA_Int32 length = 0;
+            retval = Int32_decodeBinary(&length, ctx); /* jump over the length (todo: check if length matches) */
+            dst->content.decoded.data = decodeCalloc(type->memSize, ctx);
             size_t decode_index = type->builtin ? type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-            if(dst->content.decoded.data) {
+            if(!dst->content.decoded.data)
+                retval = UA_STATUSCODE_BADOUTOFMEMORY;
+            else {
                 dst->content.decoded.type = type;
                 dst->encoding = UA_EXTENSIONOBJECT_DECODED;
-                retval = decodeBinaryJumpTable[decode_index](dst->content.decoded.data, type);
-            } else
-                retval = UA_STATUSCODE_BADOUTOFMEMORY;
+                if(retval == UA_STATUSCODE_GOOD)
+                    retval = decodeBinaryJumpTable[decode_index](dst->content.decoded.data, type, ctx);
+            }
         } else {
-            retval = ByteString_decodeBinary(&dst->content.encoded.body);
+            retval = ByteString_decodeBinary(&dst->content.encoded.body, ctx);
             dst->encoding = UA_EXTENSIONOBJECT_ENCODED_BYTESTRING;
-            dst->content.encoded.typeId = typeId;
+            dst->content.encoded.typeId = *typeId;
         }
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_ExtensionObject_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], ctx);
     return retval;
 }
 
+static UA_StatusCode
+ExtensionObject_decodeBinary(UA_ExtensionObject *dst, const UA_DataType *_, Ctx *ctx) {
+    UA_Byte encoding = 0;
+    UA_NodeId typeId;
+    UA_NodeId_init(&typeId);
+    UA_StatusCode retval = NodeId_decodeBinary(&typeId, NULL, ctx);
+    retval |= Byte_decodeBinary(&encoding, NULL, ctx);
+    if(retval != UA_STATUSCODE_GOOD) {
+        decodeDeleteMembers(&typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
+        return retval;
+    }
+    return ExtensionObject_decodeBinaryContent(dst, &typeId, encoding, ctx);
+}
+
 /* Variant */
 enum UA_VARIANT_ENCODINGMASKTYPE {
     UA_VARIANT_ENCODINGMASKTYPE_TYPEID_MASK = 0x3F,        // bits 0:5
@@ -789,10 +1125,10 @@ enum UA_VARIANT_ENCODINGMASKTYPE {
 };
 
 static UA_StatusCode
-Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_) {
+Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingByte = 0;
     if(!src->type)
-        return Byte_encodeBinary(&encodingByte, NULL); /* empty variant */
+        return Byte_encodeBinary(&encodingByte, NULL, ctx); /* empty variant */
 
     const UA_Boolean isArray = src->arrayLength > 0 || src->data <= UA_EMPTY_ARRAY_SENTINEL;
     const UA_Boolean hasDimensions = isArray && src->arrayDimensionsSize > 0;
@@ -809,15 +1145,15 @@ Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_) {
         encodingByte |= t;
     } else
         encodingByte |= UA_VARIANT_ENCODINGMASKTYPE_TYPEID_MASK & (UA_Byte) 22; /* ExtensionObject */
-    UA_StatusCode retval = Byte_encodeBinary(&encodingByte, NULL);
+    UA_StatusCode retval = Byte_encodeBinary(&encodingByte, NULL, ctx);
 
     /* Encode the content */
     if(isBuiltin) {
         if(!isArray) {
             size_t encode_index = src->type->typeIndex;
-            retval |= encodeBinaryJumpTable[encode_index](src->data, src->type);
+            retval |= encodeBinaryJumpTable[encode_index](src->data, src->type, ctx);
         } else
-            retval |= Array_encodeBinary(src->data, src->arrayLength, src->type);
+            retval |= Array_encodeBinary(src->data, src->arrayLength, src->type, ctx);
     } else {
         /* Wrap not-builtin elements into an extensionobject */
         if(src->arrayDimensionsSize > UA_INT32_MAX)
@@ -826,7 +1162,7 @@ Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_) {
         if(isArray) {
             length = src->arrayLength;
             UA_Int32 encodedLength = (UA_Int32)src->arrayLength;
-            retval |= Int32_encodeBinary(&encodedLength);
+            retval |= Int32_encodeBinary(&encodedLength, ctx);
         }
         UA_ExtensionObject eo;
         UA_ExtensionObject_init(&eo);
@@ -835,14 +1171,14 @@ Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_) {
         const UA_UInt16 memSize = src->type->memSize;
         uintptr_t ptr = (uintptr_t)src->data;
         for(size_t i = 0; i < length && retval == UA_STATUSCODE_GOOD; i++) {
-            UA_Byte *oldpos = pos;
+            UA_Byte *oldpos = ctx->pos;
             eo.content.decoded.data = (void*)ptr;
-            retval |= ExtensionObject_encodeBinary(&eo, NULL);
+            retval |= ExtensionObject_encodeBinary(&eo, NULL, ctx);
             ptr += memSize;
             if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
                 /* exchange/send with the current buffer with chunking */
-                pos = oldpos;
-                retval = exchangeBuffer();
+                ctx->pos = oldpos;
+                retval = exchangeBuffer(ctx);
                 /* encode the same element in the next iteration */
                 i--;
                 ptr -= memSize;
@@ -852,7 +1188,7 @@ Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_) {
 
     /* Encode the dimensions */
     if(hasDimensions)
-        retval |= Array_encodeBinary(src->arrayDimensions, src->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
+        retval |= Array_encodeBinary(src->arrayDimensions, src->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32], ctx);
 
     return retval;
 }
@@ -860,9 +1196,9 @@ Variant_encodeBinary(UA_Variant const *src, const UA_DataType *_) {
 /* The resulting variant always has the storagetype UA_VARIANT_DATA. Currently,
  we only support ns0 types (todo: attach typedescriptions to datatypenodes) */
 static UA_StatusCode
-Variant_decodeBinary(UA_Variant *dst, const UA_DataType *_) {
+Variant_decodeBinary(UA_Variant *dst, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingByte;
-    UA_StatusCode retval = Byte_decodeBinary(&encodingByte, NULL);
+    UA_StatusCode retval = Byte_decodeBinary(&encodingByte, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(encodingByte == 0)
@@ -876,203 +1212,211 @@ Variant_decodeBinary(UA_Variant *dst, const UA_DataType *_) {
         /* an array */
         dst->type = &UA_TYPES[typeIndex];
         UA_Int32 signedLength = 0;
-        retval |= Int32_decodeBinary(&signedLength);
+        retval |= Int32_decodeBinary(&signedLength, ctx);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
-        retval = Array_decodeBinary(signedLength, &dst->data, &dst->arrayLength, dst->type);
+        retval = Array_decodeBinary(signedLength, &dst->data, &dst->arrayLength, dst->type, ctx);
     } else if (typeIndex != UA_TYPES_EXTENSIONOBJECT) {
         /* a builtin type */
         dst->type = &UA_TYPES[typeIndex];
-        retval = Array_decodeBinary(1, &dst->data, &dst->arrayLength, dst->type);
+        retval = Array_decodeBinary(1, &dst->data, &dst->arrayLength, dst->type, ctx);
         dst->arrayLength = 0;
     } else {
         /* a single extensionobject */
-        UA_Byte *old_pos = pos;
         UA_NodeId typeId;
         UA_NodeId_init(&typeId);
-        retval = NodeId_decodeBinary(&typeId, NULL);
+        retval = NodeId_decodeBinary(&typeId, NULL, ctx);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
 
         UA_Byte eo_encoding;
-        retval = Byte_decodeBinary(&eo_encoding, NULL);
+        retval = Byte_decodeBinary(&eo_encoding, NULL, ctx);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_NodeId_deleteMembers(&typeId);
+            decodeDeleteMembers(&typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
             return retval;
         }
 
         /* search for the datatype. use extensionobject if nothing is found */
+        UA_Boolean unwrapped = false;
         dst->type = &UA_TYPES[UA_TYPES_EXTENSIONOBJECT];
         if(typeId.namespaceIndex == 0 && typeId.identifierType == UA_NODEIDTYPE_NUMERIC &&
            eo_encoding == UA_EXTENSIONOBJECT_ENCODED_BYTESTRING) {
             UA_assert(typeId.identifier.byteString.data == NULL); /* for clang analyzer <= 3.7 */
             typeId.identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
-            if(findDataType(&typeId, &dst->type) == UA_STATUSCODE_GOOD)
-                pos += 4; /* jump over the length (todo: check if length matches) */
-            else
-                pos = old_pos; /* jump back and decode as extensionobject */
-        } else {
-            pos = old_pos; /* jump back and decode as extensionobject */
-            UA_NodeId_deleteMembers(&typeId);
+            const UA_DataType *type = findDataType(&typeId);
+            if(type) {
+                dst->type = type;
+                UA_Int32 length = 0;
+                unwrapped = true;
+                retval = Int32_decodeBinary(&length, ctx); /* jump over the length (todo: check if length matches) */
+                if(retval != UA_STATUSCODE_GOOD)
+                    return retval;
+            } else
+                typeId.identifier.numeric += UA_ENCODINGOFFSET_BINARY;
         }
 
-        /* decode the type */
-        dst->data = UA_calloc(1, dst->type->memSize);
+        /* decode the type. the header was already decoded for an extensionobject */
+        dst->data = decodeCalloc(dst->type->memSize, ctx);
         if(dst->data) {
-            size_t decode_index = dst->type->builtin ? dst->type->typeIndex : UA_BUILTIN_TYPES_COUNT;
-            retval = decodeBinaryJumpTable[decode_index](dst->data, dst->type);
+            if(unwrapped) {
+                size_t decode_index = dst->type->builtin ? dst->type->typeIndex : UA_BUILTIN_TYPES_COUNT;
+                retval = decodeBinaryJumpTable[decode_index](dst->data, dst->type, ctx);
+            } else
+                retval = ExtensionObject_decodeBinaryContent(dst->data, &typeId, eo_encoding, ctx);
             if(retval != UA_STATUSCODE_GOOD) {
-                UA_free(dst->data);
+                decodeFree(dst->data, ctx);
                 dst->data = NULL;
             }
-        } else
+        } else {
+            decodeDeleteMembers(&typeId, &UA_TYPES[UA_TYPES_NODEID], ctx);
             retval = UA_STATUSCODE_BADOUTOFMEMORY;
+        }
     }
 
     /* array dimensions */
     if(isArray && (encodingByte & UA_VARIANT_ENCODINGMASKTYPE_DIMENSIONS)) {
         UA_Int32 signed_length = 0;
-        retval |= Int32_decodeBinary(&signed_length);
+        retval |= Int32_decodeBinary(&signed_length, ctx);
         if(retval == UA_STATUSCODE_GOOD)
             retval = Array_decodeBinary(signed_length, (void**)&dst->arrayDimensions,
-                                        &dst->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
+                                        &dst->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32], ctx);
     }
 
     if(retval != UA_STATUSCODE_GOOD)
-        UA_Variant_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_VARIANT], ctx);
     return retval;
 }
 
 /* DataValue */
 static UA_StatusCode
-DataValue_encodeBinary(UA_DataValue const *src, const UA_DataType *_) {
+DataValue_encodeBinary(UA_DataValue const *src, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingMask = (UA_Byte)
         (src->hasValue | (src->hasStatus << 1) | (src->hasSourceTimestamp << 2) |
          (src->hasServerTimestamp << 3) | (src->hasSourcePicoseconds << 4) |
          (src->hasServerPicoseconds << 5));
-    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, NULL);
+    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, NULL, ctx);
     if(src->hasValue)
-        retval |= Variant_encodeBinary(&src->value, NULL);
+        retval |= Variant_encodeBinary(&src->value, NULL, ctx);
     if(src->hasStatus)
-        retval |= StatusCode_encodeBinary(&src->status);
+        retval |= StatusCode_encodeBinary(&src->status, ctx);
     if(src->hasSourceTimestamp)
-        retval |= DateTime_encodeBinary(&src->sourceTimestamp);
+        retval |= DateTime_encodeBinary(&src->sourceTimestamp, ctx);
     if(src->hasSourcePicoseconds)
-        retval |= UInt16_encodeBinary(&src->sourcePicoseconds, NULL);
+        retval |= UInt16_encodeBinary(&src->sourcePicoseconds, NULL, ctx);
     if(src->hasServerTimestamp)
-        retval |= DateTime_encodeBinary(&src->serverTimestamp);
+        retval |= DateTime_encodeBinary(&src->serverTimestamp, ctx);
     if(src->hasServerPicoseconds)
-        retval |= UInt16_encodeBinary(&src->serverPicoseconds, NULL);
+        retval |= UInt16_encodeBinary(&src->serverPicoseconds, NULL, ctx);
     return retval;
 }
 
 #define MAX_PICO_SECONDS 999
 static UA_StatusCode
-DataValue_decodeBinary(UA_DataValue *dst, const UA_DataType *_) {
+DataValue_decodeBinary(UA_DataValue *dst, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingMask;
-    UA_StatusCode retval = Byte_decodeBinary(&encodingMask, NULL);
+    UA_StatusCode retval = Byte_decodeBinary(&encodingMask, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(encodingMask & 0x01) {
         dst->hasValue = true;
-        retval |= Variant_decodeBinary(&dst->value, NULL);
+        retval |= Variant_decodeBinary(&dst->value, NULL, ctx);
     }
     if(encodingMask & 0x02) {
         dst->hasStatus = true;
-        retval |= StatusCode_decodeBinary(&dst->status);
+        retval |= StatusCode_decodeBinary(&dst->status, ctx);
     }
     if(encodingMask & 0x04) {
         dst->hasSourceTimestamp = true;
-        retval |= DateTime_decodeBinary(&dst->sourceTimestamp);
+        retval |= DateTime_decodeBinary(&dst->sourceTimestamp, ctx);
     }
     if(encodingMask & 0x08) {
         dst->hasServerTimestamp = true;
-        retval |= DateTime_decodeBinary(&dst->serverTimestamp);
+        retval |= DateTime_decodeBinary(&dst->serverTimestamp, ctx);
     }
     if(encodingMask & 0x10) {
         dst->hasSourcePicoseconds = true;
-        retval |= UInt16_decodeBinary(&dst->sourcePicoseconds, NULL);
+        retval |= UInt16_decodeBinary(&dst->sourcePicoseconds, NULL, ctx);
         if(dst->sourcePicoseconds > MAX_PICO_SECONDS)
             dst->sourcePicoseconds = MAX_PICO_SECONDS;
     }
     if(encodingMask & 0x20) {
         dst->hasServerPicoseconds = true;
-        retval |= UInt16_decodeBinary(&dst->serverPicoseconds, NULL);
+        retval |= UInt16_decodeBinary(&dst->serverPicoseconds, NULL, ctx);
         if(dst->serverPicoseconds > MAX_PICO_SECONDS)
             dst->serverPicoseconds = MAX_PICO_SECONDS;
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_DataValue_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_DATAVALUE], ctx);
     return retval;
 }
 
 /* DiagnosticInfo */
 static UA_StatusCode
-DiagnosticInfo_encodeBinary(const UA_DiagnosticInfo *src, const UA_DataType *_) {
+DiagnosticInfo_encodeBinary(const UA_DiagnosticInfo *src, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingMask = (UA_Byte)
         (src->hasSymbolicId | (src->hasNamespaceUri << 1) | (src->hasLocalizedText << 2) |
          (src->hasLocale << 3) | (src->hasAdditionalInfo << 4) | (src->hasInnerDiagnosticInfo << 5));
-    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, NULL);
+    UA_StatusCode retval = Byte_encodeBinary(&encodingMask, NULL, ctx);
     if(src->hasSymbolicId)
-        retval |= Int32_encodeBinary(&src->symbolicId);
+        retval |= Int32_encodeBinary(&src->symbolicId, ctx);
     if(src->hasNamespaceUri)
-        retval |= Int32_encodeBinary(&src->namespaceUri);
+        retval |= Int32_encodeBinary(&src->namespaceUri, ctx);
     if(src->hasLocalizedText)
-        retval |= Int32_encodeBinary(&src->localizedText);
+        retval |= Int32_encodeBinary(&src->localizedText, ctx);
     if(src->hasLocale)
-        retval |= Int32_encodeBinary(&src->locale);
+        retval |= Int32_encodeBinary(&src->locale, ctx);
     if(src->hasAdditionalInfo)
-        retval |= String_encodeBinary(&src->additionalInfo, NULL);
+        retval |= String_encodeBinary(&src->additionalInfo, NULL, ctx);
     if(src->hasInnerStatusCode)
-        retval |= StatusCode_encodeBinary(&src->innerStatusCode);
+        retval |= StatusCode_encodeBinary(&src->innerStatusCode, ctx);
     if(src->hasInnerDiagnosticInfo)
-        retval |= DiagnosticInfo_encodeBinary(src->innerDiagnosticInfo, NULL);
+        retval |= DiagnosticInfo_encodeBinary(src->innerDiagnosticInfo, NULL, ctx);
     return retval;
 }
 
 static UA_StatusCode
-DiagnosticInfo_decodeBinary(UA_DiagnosticInfo *dst, const UA_DataType *_) {
+DiagnosticInfo_decodeBinary(UA_DiagnosticInfo *dst, const UA_DataType *_, Ctx *ctx) {
     UA_Byte encodingMask;
-    UA_StatusCode retval = Byte_decodeBinary(&encodingMask, NULL);
+    UA_StatusCode retval = Byte_decodeBinary(&encodingMask, NULL, ctx);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
     if(encodingMask & 0x01) {
         dst->hasSymbolicId = true;
-        retval |= Int32_decodeBinary(&dst->symbolicId);
+        retval |= Int32_decodeBinary(&dst->symbolicId, ctx);
     }
     if(encodingMask & 0x02) {
         dst->hasNamespaceUri = true;
-        retval |= Int32_decodeBinary(&dst->namespaceUri);
+        retval |= Int32_decodeBinary(&dst->namespaceUri, ctx);
     }
     if(encodingMask & 0x04) {
         dst->hasLocalizedText = true;
-        retval |= Int32_decodeBinary(&dst->localizedText);
+        retval |= Int32_decodeBinary(&dst->localizedText, ctx);
     }
     if(encodingMask & 0x08) {
         dst->hasLocale = true;
-        retval |= Int32_decodeBinary(&dst->locale);
+        retval |= Int32_decodeBinary(&dst->locale, ctx);
     }
     if(encodingMask & 0x10) {
         dst->hasAdditionalInfo = true;
-        retval |= String_decodeBinary(&dst->additionalInfo, NULL);
+        retval |= String_decodeBinary(&dst->additionalInfo, NULL, ctx);
     }
     if(encodingMask & 0x20) {
         dst->hasInnerStatusCode = true;
-        retval |= StatusCode_decodeBinary(&dst->innerStatusCode);
+        retval |= StatusCode_decodeBinary(&dst->innerStatusCode, ctx);
     }
     if(encodingMask & 0x40) {
         dst->hasInnerDiagnosticInfo = true;
         /* innerDiagnosticInfo is a pointer to struct, therefore allocate */
-        dst->innerDiagnosticInfo = UA_calloc(1, sizeof(UA_DiagnosticInfo));
+        dst->innerDiagnosticInfo = decodeCalloc(sizeof(UA_DiagnosticInfo), ctx);
         if(dst->innerDiagnosticInfo)
-            retval |= DiagnosticInfo_decodeBinary(dst->innerDiagnosticInfo, NULL);
+            retval |= DiagnosticInfo_decodeBinary(dst->innerDiagnosticInfo, NULL, ctx);
         else {
             dst->hasInnerDiagnosticInfo = false;
             retval |= UA_STATUSCODE_BADOUTOFMEMORY;
         }
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_DiagnosticInfo_deleteMembers(dst);
+        decodeDeleteMembers(dst, &UA_TYPES[UA_TYPES_DIAGNOSTICINFO], ctx);
     return retval;
 }
 
@@ -1081,7 +1425,10 @@ DiagnosticInfo_decodeBinary(UA_DiagnosticInfo *dst, const UA_DataType *_) {
 /********************/
 
 static UA_StatusCode
-UA_encodeBinaryInternal(const void *src, const UA_DataType *type) {
+UA_encodeBinaryInternal(const void *src, const UA_DataType *type, Ctx *ctx) {
+    UA_encodeBinarySignature specialized = UA_SPECIALIZED(encodeBinarySpecialized, type);
+    if(specialized)
+        return specialized(src, type, ctx);
     uintptr_t ptr = (uintptr_t)src;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_Byte membersSize = type->membersSize;
@@ -1093,13 +1440,13 @@ UA_encodeBinaryInternal(const void *src, const UA_DataType *type) {
             ptr += member->padding;
             size_t encode_index = membertype->builtin ? membertype->typeIndex : UA_BUILTIN_TYPES_COUNT;
             size_t memSize = membertype->memSize;
-            UA_Byte *oldpos = pos;
-            retval |= encodeBinaryJumpTable[encode_index]((const void*)ptr, membertype);
+            UA_Byte *oldpos = ctx->pos;
+            retval |= encodeBinaryJumpTable[encode_index]((const void*)ptr, membertype, ctx);
             ptr += memSize;
             if(retval == UA_STATUSCODE_BADENCODINGLIMITSEXCEEDED) {
                 /* exchange/send the buffer and try to encode the same type once more */
-                pos = oldpos;
-                retval = exchangeBuffer();
+                ctx->pos = oldpos;
+                retval = exchangeBuffer(ctx);
                 /* re-encode the same member on the new buffer */
                 ptr -= member->padding + memSize;
                 i--;
@@ -1108,7 +1455,7 @@ UA_encodeBinaryInternal(const void *src, const UA_DataType *type) {
             ptr += member->padding;
             const size_t length = *((const size_t*)ptr);
             ptr += sizeof(size_t);
-            retval |= Array_encodeBinary(*(void *UA_RESTRICT const *)ptr, length, membertype);
+            retval |= Array_encodeBinary(*(void *UA_RESTRICT const *)ptr, length, membertype, ctx);
             ptr += sizeof(void*);
         }
     }
@@ -1147,18 +1494,23 @@ static const UA_encodeBinarySignature encodeBinaryJumpTable[UA_BUILTIN_TYPES_COU
 UA_StatusCode
 UA_encodeBinary(const void *src, const UA_DataType *type, UA_exchangeEncodeBuffer callback,
                 void *handle, UA_ByteString *dst, size_t *offset) {
-    pos = &dst->data[*offset];
-    end = &dst->data[dst->length];
-    encodeBuf = dst;
-    exchangeBufferCallback = callback;
-    exchangeBufferCallbackHandle = handle;
-    UA_StatusCode retval = UA_encodeBinaryInternal(src, type);
-    *offset = (size_t)(pos - dst->data) / sizeof(UA_Byte);
+    Ctx ctx;
+    ctx.pos = &dst->data[*offset];
+    ctx.end = &dst->data[dst->length];
+    ctx.encodeBuf = dst;
+    ctx.exchangeBufferCallback = callback;
+    ctx.exchangeBufferCallbackHandle = handle;
+    ctx.encodePendingLengths = 0;
+    UA_StatusCode retval = UA_encodeBinaryInternal(src, type, &ctx);
+    *offset = (size_t)(ctx.pos - dst->data) / sizeof(UA_Byte);
     return retval;
 }
 
 static UA_StatusCode
-UA_decodeBinaryInternal(void *dst, const UA_DataType *type) {
+UA_decodeBinaryInternal(void *dst, const UA_DataType *type, Ctx *ctx) {
+    UA_decodeBinarySignature specialized = UA_SPECIALIZED(decodeBinarySpecialized, type);
+    if(specialized)
+        return specialized(dst, type, ctx);
     uintptr_t ptr = (uintptr_t)dst;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     UA_Byte membersSize = type->membersSize;
@@ -1170,20 +1522,20 @@ UA_decodeBinaryInternal(void *dst, const UA_DataType *type) {
             ptr += member->padding;
             size_t fi = membertype->builtin ? membertype->typeIndex : UA_BUILTIN_TYPES_COUNT;
             size_t memSize = membertype->memSize;
-            retval |= decodeBinaryJumpTable[fi]((void *UA_RESTRICT)ptr, membertype);
+            retval |= decodeBinaryJumpTable[fi]((void *UA_RESTRICT)ptr, membertype, ctx);
             ptr += memSize;
         } else {
             ptr += member->padding;
             size_t *length = (size_t*)ptr;
             ptr += sizeof(size_t);
             UA_Int32 slength = -1;
-            retval |= Int32_decodeBinary(&slength);
-            retval |= Array_decodeBinary(slength, (void *UA_RESTRICT *UA_RESTRICT)ptr, length, membertype);
+            retval |= Int32_decodeBinary(&slength, ctx);
+            retval |= Array_decodeBinary(slength, (void *UA_RESTRICT *UA_RESTRICT)ptr, length, membertype, ctx);
             ptr += sizeof(void*);
         }
     }
     if(retval != UA_STATUSCODE_GOOD)
-        UA_deleteMembers(dst, type);
+        decodeDeleteMembers(dst, type, ctx);
     return retval;
 }
 
@@ -1216,13 +1568,57 @@ static const UA_decodeBinarySignature decodeBinaryJumpTable[UA_BUILTIN_TYPES_COU
     (UA_decodeBinarySignature)UA_decodeBinaryInternal
 };
 
+static UA_StatusCode
+decodeBinary(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *type,
+             UA_Boolean lazyExtensionObjects) {
+    memset(dst, 0, type->memSize); // init
+    Ctx ctx;
+    ctx.pos = &src->data[*offset];
+    ctx.end = &src->data[src->length];
+    ctx.decodeBufferCallback = NULL;
+    ctx.decodeRemaining = 0;
+    ctx.decodeStaged = false;
+    ctx.arena = NULL;
+    ctx.lazyExtensionObjects = lazyExtensionObjects;
+    UA_StatusCode retval = UA_decodeBinaryInternal(dst, type, &ctx);
+    *offset = (size_t)(ctx.pos - src->data) / sizeof(UA_Byte);
+    return retval;
+}
+
 UA_StatusCode
 UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *type) {
+    return decodeBinary(src, offset, dst, type, false);
+}
+
+UA_StatusCode
+UA_decodeBinaryLazy(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *type) {
+    return decodeBinary(src, offset, dst, type, true);
+}
+
+UA_StatusCode
+UA_decodeBinaryChunked(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *type,
+                       UA_exchangeDecodeBuffer callback, void *handle, size_t remaining,
+                       UA_Arena *arena) {
     memset(dst, 0, type->memSize); // init
-    pos = &src->data[*offset];
-    end = &src->data[src->length];
-    UA_StatusCode retval = UA_decodeBinaryInternal(dst, type);
-    *offset = (size_t)(pos - src->data) / sizeof(UA_Byte);
+    Ctx ctx;
+    ctx.decodeBuf = *src;
+    ctx.pos = &ctx.decodeBuf.data[*offset];
+    ctx.end = &ctx.decodeBuf.data[ctx.decodeBuf.length];
+    ctx.decodeBufferCallback = callback;
+    ctx.decodeBufferCallbackHandle = handle;
+    ctx.decodeRemaining = remaining;
+    ctx.decodeStaged = false;
+    ctx.arena = arena;
+    ctx.lazyExtensionObjects = false;
+    UA_StatusCode retval = UA_decodeBinaryInternal(dst, type, &ctx);
+
+    /* the offset in the last buffer. bytes left in the stage were copied from
+       the end of the previous buffer(s) */
+    if(ctx.decodeStaged) {
+        size_t left = (size_t)(ctx.end - ctx.pos);
+        *offset = (left < ctx.decodeStageSkip) ? ctx.decodeStageSkip - left : 0;
+    } else
+        *offset = (size_t)(ctx.pos - ctx.decodeBuf.data) / sizeof(UA_Byte);
     return retval;
 }
 
@@ -1436,16 +1832,19 @@ static const UA_calcSizeBinarySignature calcSizeBinaryJumpTable[UA_BUILTIN_TYPES
     (UA_calcSizeBinarySignature)NodeId_calcSizeBinary,
     (UA_calcSizeBinarySignature)ExpandedNodeId_calcSizeBinary,
     (UA_calcSizeBinarySignature)calcSizeBinaryMemSize, // StatusCode
-    (UA_calcSizeBinarySignature)UA_calcSizeBinary, // QualifiedName
+    (UA_calcSizeBinarySignature)UA_calcSizeBinaryInternal, // QualifiedName
     (UA_calcSizeBinarySignature)LocalizedText_calcSizeBinary,
     (UA_calcSizeBinarySignature)ExtensionObject_calcSizeBinary,
     (UA_calcSizeBinarySignature)DataValue_calcSizeBinary,
     (UA_calcSizeBinarySignature)Variant_calcSizeBinary,
     (UA_calcSizeBinarySignature)DiagnosticInfo_calcSizeBinary,
-    (UA_calcSizeBinarySignature)UA_calcSizeBinary
+    (UA_calcSizeBinarySignature)UA_calcSizeBinaryInternal
 };
 
-size_t UA_calcSizeBinary(void *p, const UA_DataType *type) {
+static size_t UA_calcSizeBinaryInternal(const void *p, const UA_DataType *type) {
+    UA_calcSizeBinarySignature specialized = UA_SPECIALIZED(calcSizeBinarySpecialized, type);
+    if(specialized)
+        return specialized(p, type);
     size_t s = 0;
     uintptr_t ptr = (uintptr_t)p;
     UA_Byte membersSize = type->membersSize;
@@ -1468,3 +1867,56 @@ size_t UA_calcSizeBinary(void *p, const UA_DataType *type) {
     }
     return s;
 }
+
+size_t UA_calcSizeBinary(void *p, const UA_DataType *type) {
+    return UA_calcSizeBinaryInternal(p, type);
+}
+
+/******************************/
+/* Generated Structured Types */
+/******************************/
+
+#include "ua_types_generated_encoding_specialized.inc"
+
+static const UA_DataType *
+findDataType(const UA_NodeId *typeId) {
+    if(typeId->namespaceIndex != 0 || typeId->identifierType != UA_NODEIDTYPE_NUMERIC)
+        return NULL;
+    const UA_UInt32 mask = (1u << UA_TYPES_TYPEIDHASHBITS) - 1;
+    UA_UInt32 id = typeId->identifier.numeric;
+    UA_UInt32 slot = (UA_UInt32)(id * 2654435761u) >> (32 - UA_TYPES_TYPEIDHASHBITS);
+    for(; typeIdHashMap[slot] != 0; slot = (slot + 1) & mask) {
+        const UA_DataType *type = &UA_TYPES[typeIdHashMap[slot] - 1];
+        if(type->typeId.identifier.numeric == id)
+            return type;
+    }
+    return NULL;
+}
+
+UA_StatusCode
+UA_ExtensionObject_decodeContent(UA_ExtensionObject *eo) {
+    if(eo->encoding != UA_EXTENSIONOBJECT_ENCODED_BYTESTRING)
+        return UA_STATUSCODE_GOOD;
+    UA_NodeId typeId = eo->content.encoded.typeId;
+    if(typeId.namespaceIndex != 0 || typeId.identifierType != UA_NODEIDTYPE_NUMERIC)
+        return UA_STATUSCODE_BADDATATYPEIDUNKNOWN;
+    typeId.identifier.numeric -= UA_ENCODINGOFFSET_BINARY;
+    const UA_DataType *type = findDataType(&typeId);
+    if(!type)
+        return UA_STATUSCODE_BADDATATYPEIDUNKNOWN;
+
+    void *data = UA_malloc(type->memSize);
+    if(!data)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    size_t offset = 0;
+    UA_StatusCode retval = UA_decodeBinary(&eo->content.encoded.body, &offset, data, type);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_free(data);
+        return retval;
+    }
+    UA_ByteString_deleteMembers(&eo->content.encoded.body);
+    eo->encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo->content.decoded.type = type;
+    eo->content.decoded.data = data;
+    return UA_STATUSCODE_GOOD;
+}
@@ -2,6 +2,7 @@
 #define UA_TYPES_ENCODING_BINARY_H_
 
 #include "ua_types.h"
+#include "ua_arena.h"
 
 typedef UA_StatusCode (*UA_exchangeEncodeBuffer)(void *handle, UA_ByteString *buf, size_t offset);
 
@@ -14,6 +15,51 @@ UA_StatusCode
 UA_decodeBinary(const UA_ByteString *src, size_t *offset, void *dst,
                 const UA_DataType *type) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
 
+/* Decodes like UA_decodeBinary, but keeps the bodies of ExtensionObjects in
+ * their encoded form. So values that are only forwarded are not decoded. The
+ * bodies are decoded on access with UA_ExtensionObject_decodeContent. The
+ * typeId of the kept ExtensionObjects is the NodeId of the binary encoding, so
+ * that they are encoded back unchanged. */
+UA_StatusCode
+UA_decodeBinaryLazy(const UA_ByteString *src, size_t *offset, void *dst,
+                    const UA_DataType *type) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
+/* Replaces buf with the next buffer of the source. Returns an error code if
+ * there is no further buffer. */
+typedef UA_StatusCode (*UA_exchangeDecodeBuffer)(void *handle, UA_ByteString *buf);
+
+/* Decodes from a source that is split into several buffers (e.g. the chunks of
+ * a message) without gluing them together. When the end of src is reached, the
+ * next buffer is pulled with the callback. Afterwards, offset points into the
+ * last buffer that was pulled. remaining is the number of bytes in the buffers
+ * after src. It is used to reject array lengths that cannot be decoded.
+ *
+ * If an arena is given, all memory of the decoded value is taken from it. The
+ * value must then not be deleted. It becomes invalid when the arena is cleaned
+ * up. Strings and ByteStrings that lie within one buffer are not copied but
+ * point into the buffer (zero-copy). So the buffers must also outlive the
+ * decoded value. Values that are kept must be copied with UA_copy. */
+UA_StatusCode
+UA_decodeBinaryChunked(const UA_ByteString *src, size_t *offset, void *dst, const UA_DataType *type,
+                       UA_exchangeDecodeBuffer exchangeBufferCallback, void *exchangeBufferCallbackHandle,
+                       size_t remaining, UA_Arena *arena) UA_FUNC_ATTR_WARN_UNUSED_RESULT;
+
 size_t UA_calcSizeBinary(void *p, const UA_DataType *type);
 
+/* The server stores large arrays in chunks (see UA_ValueChunks). The range
+ * blocks are the runs of contiguous elements that a range selects in the
+ * array. The callback gets the position of the first element and the number
+ * of elements of every block. Only the type and the dimensions of the variant
+ * are used. */
+typedef UA_StatusCode (*UA_RangeBlockCallback)(void *context, size_t offset, size_t length);
+
+UA_StatusCode
+UA_Variant_forRangeBlocks(const UA_Variant *v, const UA_NumericRange range,
+                          UA_RangeBlockCallback callback, void *context);
+
+/* Sets up the variant with shared data for an array of a fixed-size type. The
+ * elements are not initialized. */
+UA_StatusCode
+UA_Variant_allocShared(UA_Variant *v, const UA_DataType *type, size_t arrayLength);
+
 #endif /* UA_TYPES_ENCODING_BINARY_H_ */
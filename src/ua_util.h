@@ -29,6 +29,17 @@
 # define UA_realloc(ptr, size) realloc(ptr, size)
 #endif
 
+/* The small objects listed in ua_allocator.h are taken from the process-wide
+ * allocator. A header before the object remembers the allocator, the size and
+ * the category. So UA_objfree needs no further arguments. */
+#include "ua_allocator.h"
+
+void UA_setAllocator(const UA_Allocator *allocator);
+const UA_Allocator * UA_getAllocator(void);
+void * UA_objalloc(UA_MemCategory category, size_t size);
+void * UA_objcalloc(UA_MemCategory category, size_t size);
+void UA_objfree(void *p);
+
 #ifndef NO_ALLOCA
 # ifdef __GNUC__
 #  define UA_alloca(size) __builtin_alloca (size)
@@ -76,7 +87,6 @@
 # include <urcu.h>
 # include <urcu/wfcqueue.h>
 # include <urcu/uatomic.h>
-# include <urcu/rculfhash.h>
 # include <urcu/lfstack.h>
 # ifdef NDEBUG
 #  define UA_RCU_LOCK() rcu_read_lock()
@@ -1362,6 +1362,122 @@ START_TEST(UA_Variant_copyShallWorkOn1DArrayExample) {
 }
 END_TEST
 
+START_TEST(UA_Variant_copySharedShallReferenceTheData) {
+    // given
+    UA_String *srcArray = UA_Array_new(2, &UA_TYPES[UA_TYPES_STRING]);
+    srcArray[0] = UA_STRING_ALLOC("open");
+    srcArray[1] = UA_STRING_ALLOC("62541");
+    UA_Variant value, copiedValue;
+    UA_Variant_init(&copiedValue);
+    UA_Variant_setArray(&value, srcArray, 2, &UA_TYPES[UA_TYPES_STRING]);
+
+    //when
+    UA_StatusCode retval = UA_Variant_share(&value);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Variant_copy(&value, &copiedValue);
+
+    //then
+    ck_assert_int_eq(value.storageType, UA_VARIANT_DATA_SHARED);
+    ck_assert_int_eq(copiedValue.storageType, UA_VARIANT_DATA_SHARED);
+    ck_assert_ptr_eq(value.data, copiedValue.data);
+    ck_assert_int_eq(copiedValue.arrayLength, 2);
+
+    // a range write into a shared array makes a private copy first
+    UA_String newString = UA_STRING("opc ua");
+    UA_NumericRange range;
+    struct UA_NumericRangeDimension dim = {1, 1};
+    range.dimensionsSize = 1;
+    range.dimensions = &dim;
+    retval = UA_Variant_setRangeCopy(&copiedValue, &newString, 1, range);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_ne(value.data, copiedValue.data);
+    UA_String oldString = UA_STRING("62541");
+    ck_assert(UA_String_equal(&((UA_String*)value.data)[1], &oldString));
+    ck_assert(UA_String_equal(&((UA_String*)copiedValue.data)[1], &newString));
+
+    // the original becomes the only reference and is written in place
+    UA_Variant_deleteMembers(&copiedValue);
+    void *data = value.data;
+    retval = UA_Variant_setRangeCopy(&value, &newString, 1, range);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.data, data);
+    ck_assert(UA_String_equal(&((UA_String*)value.data)[1], &newString));
+
+    //finally
+    UA_Variant_deleteMembers(&value);
+}
+END_TEST
+
+START_TEST(UA_Variant_copyRangeShallWorkOn3DExample) {
+    // given
+    UA_Int32 *srcArray = UA_Array_new(64, &UA_TYPES[UA_TYPES_INT32]);
+    for(UA_Int32 i = 0; i < 64; i++)
+        srcArray[i] = i;
+    UA_Int32 *dimensions = UA_Array_new(3, &UA_TYPES[UA_TYPES_INT32]);
+    dimensions[0] = 4;
+    dimensions[1] = 4;
+    dimensions[2] = 4;
+    UA_Variant value, rangeValue;
+    UA_Variant_setArray(&value, srcArray, 64, &UA_TYPES[UA_TYPES_INT32]);
+    value.arrayDimensionsSize = 3;
+    value.arrayDimensions = dimensions;
+
+    struct UA_NumericRangeDimension dims[3] = {{1, 2}, {0, 1}, {2, 3}};
+    UA_NumericRange range = {3, dims};
+
+    //when
+    UA_StatusCode retval = UA_Variant_copyRange(&value, &rangeValue, range);
+
+    //then
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(rangeValue.arrayLength, 8);
+    ck_assert_int_eq(rangeValue.arrayDimensionsSize, 3);
+    ck_assert_int_eq(rangeValue.arrayDimensions[0], 2);
+    const UA_Int32 expected[8] = {18, 19, 22, 23, 34, 35, 38, 39};
+    for(size_t i = 0; i < 8; i++)
+        ck_assert_int_eq(((UA_Int32*)rangeValue.data)[i], expected[i]);
+    UA_Variant_deleteMembers(&rangeValue);
+
+    // write the range back shifted by 100
+    UA_Int32 newValues[8];
+    for(size_t i = 0; i < 8; i++)
+        newValues[i] = expected[i] + 100;
+    retval = UA_Variant_setRangeCopy(&value, newValues, 8, range);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    for(UA_Int32 i = 0; i < 64; i++) {
+        UA_Boolean inRange = false;
+        for(size_t j = 0; j < 8; j++)
+            inRange |= (expected[j] == i);
+        ck_assert_int_eq(srcArray[i], inRange ? i + 100 : i);
+    }
+
+    //finally
+    UA_Variant_deleteMembers(&value);
+}
+END_TEST
+
+START_TEST(UA_Variant_borrowRangeShallReferenceContiguousData) {
+    // given
+    UA_Int32 srcArray[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    UA_Variant value, rangeValue;
+    UA_Variant_setArray(&value, srcArray, 10, &UA_TYPES[UA_TYPES_INT32]);
+    struct UA_NumericRangeDimension dim = {3, 7};
+    UA_NumericRange range = {1, &dim};
+
+    //when
+    UA_StatusCode retval = UA_Variant_borrowRange(&value, &rangeValue, range);
+
+    //then
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(rangeValue.storageType, UA_VARIANT_DATA_NODELETE);
+    ck_assert_int_eq(rangeValue.arrayLength, 5);
+    ck_assert_ptr_eq(rangeValue.data, &srcArray[3]);
+
+    //finally
+    UA_Variant_deleteMembers(&rangeValue);
+}
+END_TEST
+
 START_TEST(UA_Variant_copyShallWorkOn2DArrayExample) {
     // given
     UA_Int32 *srcArray = UA_Array_new(6, &UA_TYPES[UA_TYPES_INT32]);
@@ -1473,6 +1589,131 @@ START_TEST(UA_ExtensionObject_encodeDecodeShallWorkOnExtensionObject) {
 }
 END_TEST
 
+/* Encode with the generated functions and with the generic functions. A copy
+   of the type description is not in UA_TYPES and uses the generic functions.
+   Returns the encoding. */
+static UA_ByteString encodeSpecializedAndGeneric(const void *src, const UA_DataType *type) {
+    UA_DataType generic = *type;
+    UA_ByteString specializedBuf, genericBuf;
+    UA_ByteString_allocBuffer(&specializedBuf, 256);
+    UA_ByteString_allocBuffer(&genericBuf, 256);
+    size_t specializedPos = 0, genericPos = 0;
+    UA_StatusCode retval = UA_encodeBinary(src, type, NULL, NULL, &specializedBuf, &specializedPos);
+    retval |= UA_encodeBinary(src, &generic, NULL, NULL, &genericBuf, &genericPos);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(specializedPos, genericPos);
+    ck_assert_int_eq(memcmp(specializedBuf.data, genericBuf.data, genericPos), 0);
+    ck_assert_uint_eq(UA_calcSizeBinary((void*)(uintptr_t)src, type), genericPos);
+    ck_assert_uint_eq(UA_calcSizeBinary((void*)(uintptr_t)src, &generic), genericPos);
+    UA_ByteString_deleteMembers(&specializedBuf);
+    genericBuf.length = genericPos;
+    return genericBuf;
+}
+
+START_TEST(UA_ReadRequest_specializedEncodingShallEqualGeneric) {
+    // given
+    UA_ReadRequest src;
+    UA_ReadRequest_init(&src);
+    src.requestHeader.authenticationToken = UA_NODEID_NUMERIC(1, 4711);
+    src.requestHeader.timestamp = 1234567890;
+    src.requestHeader.requestHandle = 17;
+    src.requestHeader.auditEntryId = UA_STRING("audit");
+    src.maxAge = 2.5;
+    src.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    UA_ReadValueId rvi[2];
+    UA_ReadValueId_init(&rvi[0]);
+    UA_ReadValueId_init(&rvi[1]);
+    rvi[0].nodeId = UA_NODEID_STRING(1, "the.answer");
+    rvi[0].attributeId = UA_ATTRIBUTEID_VALUE;
+    rvi[1].nodeId = UA_NODEID_NUMERIC(0, 2258);
+    rvi[1].attributeId = UA_ATTRIBUTEID_BROWSENAME;
+    rvi[1].dataEncoding = UA_QUALIFIEDNAME(0, "Default Binary");
+    src.nodesToRead = rvi;
+    src.nodesToReadSize = 2;
+
+    // then
+    UA_ByteString encoded = encodeSpecializedAndGeneric(&rvi[1], &UA_TYPES[UA_TYPES_READVALUEID]);
+    UA_ByteString_deleteMembers(&encoded);
+    encoded = encodeSpecializedAndGeneric(&src.requestHeader, &UA_TYPES[UA_TYPES_REQUESTHEADER]);
+    UA_ByteString_deleteMembers(&encoded);
+    encoded = encodeSpecializedAndGeneric(&src, &UA_TYPES[UA_TYPES_READREQUEST]);
+
+    // when
+    UA_ReadRequest decoded;
+    size_t decodePos = 0;
+    UA_StatusCode retval = UA_decodeBinary(&encoded, &decodePos, &decoded,
+                                           &UA_TYPES[UA_TYPES_READREQUEST]);
+
+    // then
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(decodePos, encoded.length);
+    ck_assert_uint_eq(decoded.requestHeader.requestHandle, 17);
+    ck_assert(decoded.maxAge == 2.5);
+    ck_assert_int_eq(decoded.timestampsToReturn, UA_TIMESTAMPSTORETURN_BOTH);
+    ck_assert_uint_eq(decoded.nodesToReadSize, 2);
+    ck_assert(UA_NodeId_equal(&decoded.nodesToRead[0].nodeId, &rvi[0].nodeId));
+    ck_assert(UA_String_equal(&decoded.nodesToRead[1].dataEncoding.name, &rvi[1].dataEncoding.name));
+
+    // finally
+    UA_ReadRequest_deleteMembers(&decoded);
+    UA_ByteString_deleteMembers(&encoded);
+}
+END_TEST
+
+START_TEST(UA_ExtensionObject_lazyDecodeShallKeepBody) {
+    // given
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_NUMERIC(0, 2258);
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ExtensionObject src;
+    UA_ExtensionObject_init(&src);
+    src.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    src.content.decoded.type = &UA_TYPES[UA_TYPES_READVALUEID];
+    src.content.decoded.data = &rvi;
+    UA_ByteString encoded;
+    UA_ByteString_allocBuffer(&encoded, 64);
+    size_t pos = 0;
+    UA_StatusCode retval = UA_encodeBinary(&src, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], NULL, NULL, &encoded, &pos);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    encoded.length = pos;
+
+    // when
+    UA_ExtensionObject lazy;
+    pos = 0;
+    retval = UA_decodeBinaryLazy(&encoded, &pos, &lazy, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT]);
+
+    // then
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(lazy.encoding, UA_EXTENSIONOBJECT_ENCODED_BYTESTRING);
+    ck_assert_uint_eq(lazy.content.encoded.typeId.identifier.numeric,
+                      UA_TYPES[UA_TYPES_READVALUEID].typeId.identifier.numeric + UA_ENCODINGOFFSET_BINARY);
+
+    // the kept body is encoded back unchanged
+    UA_ByteString reencoded;
+    UA_ByteString_allocBuffer(&reencoded, 64);
+    pos = 0;
+    retval = UA_encodeBinary(&lazy, &UA_TYPES[UA_TYPES_EXTENSIONOBJECT], NULL, NULL, &reencoded, &pos);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(pos, encoded.length);
+    ck_assert_int_eq(memcmp(reencoded.data, encoded.data, pos), 0);
+
+    // decoded on access
+    retval = UA_ExtensionObject_decodeContent(&lazy);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(lazy.encoding, UA_EXTENSIONOBJECT_DECODED);
+    ck_assert_ptr_eq(lazy.content.decoded.type, &UA_TYPES[UA_TYPES_READVALUEID]);
+    UA_ReadValueId *decoded = lazy.content.decoded.data;
+    ck_assert(UA_NodeId_equal(&decoded->nodeId, &rvi.nodeId));
+    ck_assert_uint_eq(decoded->attributeId, UA_ATTRIBUTEID_VALUE);
+
+    // finally
+    UA_ExtensionObject_deleteMembers(&lazy);
+    UA_ByteString_deleteMembers(&reencoded);
+    UA_ByteString_deleteMembers(&encoded);
+}
+END_TEST
+
 static Suite *testSuite_builtin(void) {
     Suite *s = suite_create("Built-in Data Types 62541-6 Table 1");
 
@@ -1523,6 +1764,8 @@ static Suite *testSuite_builtin(void) {
     tcase_add_test(tc_encode, UA_DataValue_encodeShallWorkOnExampleWithoutVariant);
     tcase_add_test(tc_encode, UA_DataValue_encodeShallWorkOnExampleWithVariant);
     tcase_add_test(tc_encode, UA_ExtensionObject_encodeDecodeShallWorkOnExtensionObject);
+    tcase_add_test(tc_encode, UA_ReadRequest_specializedEncodingShallEqualGeneric);
+    tcase_add_test(tc_encode, UA_ExtensionObject_lazyDecodeShallKeepBody);
     suite_add_tcase(s, tc_encode);
 
     TCase *tc_convert = tcase_create("convert");
@@ -1538,6 +1781,9 @@ static Suite *testSuite_builtin(void) {
     tcase_add_test(tc_copy, UA_Variant_copyShallWorkOnSingleValueExample);
     tcase_add_test(tc_copy, UA_Variant_copyShallWorkOn1DArrayExample);
     tcase_add_test(tc_copy, UA_Variant_copyShallWorkOn2DArrayExample);
+    tcase_add_test(tc_copy, UA_Variant_copySharedShallReferenceTheData);
+    tcase_add_test(tc_copy, UA_Variant_copyRangeShallWorkOn3DExample);
+    tcase_add_test(tc_copy, UA_Variant_borrowRangeShallReferenceContiguousData);
 
     tcase_add_test(tc_copy, UA_DiagnosticInfo_copyShallWorkOnExample);
     tcase_add_test(tc_copy, UA_ApplicationDescription_copyShallWorkOnExample);
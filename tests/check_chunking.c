@@ -4,14 +4,19 @@
 #include "ua_types_generated_encoding_binary.h"
 #include "ua_securechannel.h"
 #include "ua_util.h"
+#ifdef UA_ENABLE_CRYPTO_BASIC256SHA256
+# include "ua_crypto_basic256sha256.h"
+#endif
 #include "check.h"
 
 UA_ByteString *buffers;
 size_t bufIndex;
 size_t counter;
 size_t dataCount;
+size_t chunkLengths[8];
 
 static UA_StatusCode sendChunkMockUp(UA_ChunkInfo *ci, UA_ByteString *dst, size_t offset) {
+    chunkLengths[bufIndex] = offset;
     bufIndex++;
     dst->data = buffers[bufIndex].data;
     dst->length = buffers[bufIndex].length;
@@ -103,13 +108,639 @@ START_TEST(encodeStringIntoFiveChunksShallWork) {
 }
 END_TEST
 
+START_TEST(encodeArrayIntoChunksShallKeepContent) {
+    size_t arraySize = 30;
+    size_t offset = 0;
+    size_t chunkCount = 6;
+    size_t chunkSize = 30;
+    UA_ChunkInfo ci;
+    bufIndex = 0;
+    counter = 0;
+    dataCount = 0;
+    buffers = UA_Array_new(chunkCount, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    for(size_t i=0;i<chunkCount;i++){
+        UA_ByteString_allocBuffer(&buffers[i],chunkSize);
+    }
+    UA_ByteString workingBuffer=buffers[0];
+
+    UA_Int32 ar[30];
+    for(size_t i=0;i<arraySize;i++){
+        ar[i]=(UA_Int32)i;
+    }
+    UA_Variant v;
+    UA_Variant_setArray(&v,ar,arraySize,&UA_TYPES[UA_TYPES_INT32]);
+    UA_StatusCode retval = UA_encodeBinary(&v,&UA_TYPES[UA_TYPES_VARIANT],(UA_exchangeEncodeBuffer)sendChunkMockUp,&ci,&workingBuffer,&offset);
+    ck_assert_uint_eq(retval,UA_STATUSCODE_GOOD);
+
+    /* glue the chunks together and decode */
+    UA_ByteString whole;
+    UA_ByteString_allocBuffer(&whole, dataCount + offset);
+    size_t wholePos = 0;
+    for(size_t i=0;i<bufIndex;i++) {
+        memcpy(&whole.data[wholePos], buffers[i].data, chunkLengths[i]);
+        wholePos += chunkLengths[i];
+    }
+    memcpy(&whole.data[wholePos], buffers[bufIndex].data, offset);
+    UA_Variant out;
+    size_t pos = 0;
+    retval = UA_Variant_decodeBinary(&whole, &pos, &out);
+    ck_assert_uint_eq(retval,UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(out.arrayLength, arraySize);
+    for(size_t i=0;i<arraySize;i++)
+        ck_assert_int_eq(((UA_Int32*)out.data)[i], (UA_Int32)i);
+
+    UA_Variant_deleteMembers(&out);
+    UA_ByteString_deleteMembers(&whole);
+    UA_Array_delete(buffers, chunkCount, &UA_TYPES[UA_TYPES_BYTESTRING]);
+}
+END_TEST
+
+START_TEST(encodeExtensionObjectIntoChunksShallWork) {
+    size_t offset = 0;
+    size_t chunkCount = 6;
+    size_t chunkSize = 40;
+    UA_ChunkInfo ci;
+    bufIndex = 0;
+    counter = 0;
+    dataCount = 0;
+    buffers = UA_Array_new(chunkCount, &UA_TYPES[UA_TYPES_BYTESTRING]);
+    for(size_t i=0;i<chunkCount;i++){
+        UA_ByteString_allocBuffer(&buffers[i],chunkSize);
+    }
+    UA_ByteString workingBuffer=buffers[0];
+
+    /* the body is larger than a chunk. the length cannot be written
+       after the body. */
+    UA_ReadValueId rvids[4];
+    for(size_t i=0;i<4;i++) {
+        UA_ReadValueId_init(&rvids[i]);
+        rvids[i].nodeId = UA_NODEID_NUMERIC(0, (UA_UInt32)(2255 + i));
+        rvids[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    UA_ReadRequest rq;
+    UA_ReadRequest_init(&rq);
+    rq.nodesToRead = rvids;
+    rq.nodesToReadSize = 4;
+    UA_ExtensionObject eo;
+    UA_ExtensionObject_init(&eo);
+    eo.encoding = UA_EXTENSIONOBJECT_DECODED;
+    eo.content.decoded.type = &UA_TYPES[UA_TYPES_READREQUEST];
+    eo.content.decoded.data = &rq;
+    UA_StatusCode retval = UA_encodeBinary(&eo,&UA_TYPES[UA_TYPES_EXTENSIONOBJECT],(UA_exchangeEncodeBuffer)sendChunkMockUp,&ci,&workingBuffer,&offset);
+    ck_assert_uint_eq(retval,UA_STATUSCODE_GOOD);
+    ck_assert_uint_gt(counter,1);
+    ck_assert_int_eq(UA_calcSizeBinary(&eo,&UA_TYPES[UA_TYPES_EXTENSIONOBJECT]), dataCount + offset);
+
+    /* glue the chunks together and decode */
+    UA_ByteString whole;
+    UA_ByteString_allocBuffer(&whole, dataCount + offset);
+    size_t wholePos = 0;
+    for(size_t i=0;i<bufIndex;i++) {
+        memcpy(&whole.data[wholePos], buffers[i].data, chunkLengths[i]);
+        wholePos += chunkLengths[i];
+    }
+    memcpy(&whole.data[wholePos], buffers[bufIndex].data, offset);
+    UA_ExtensionObject out;
+    size_t pos = 0;
+    retval = UA_ExtensionObject_decodeBinary(&whole, &pos, &out);
+    ck_assert_uint_eq(retval,UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(pos, whole.length);
+    ck_assert_int_eq(out.encoding, UA_EXTENSIONOBJECT_DECODED);
+    ck_assert_ptr_eq(out.content.decoded.type, &UA_TYPES[UA_TYPES_READREQUEST]);
+    UA_ReadRequest *outRq = out.content.decoded.data;
+    ck_assert_int_eq(outRq->nodesToReadSize, 4);
+    for(size_t i=0;i<4;i++)
+        ck_assert_int_eq(outRq->nodesToRead[i].nodeId.identifier.numeric, 2255 + i);
+
+    UA_ExtensionObject_deleteMembers(&out);
+    UA_ByteString_deleteMembers(&whole);
+    UA_Array_delete(buffers, chunkCount, &UA_TYPES[UA_TYPES_BYTESTRING]);
+}
+END_TEST
+
+START_TEST(reassembleInterleavedChunksShallWork) {
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    UA_Byte data[40];
+    for(size_t i=0;i<40;i++)
+        data[i] = (UA_Byte)i;
+    UA_ByteString msg = {40, data};
+
+    /* two requests with chunks of 10 bytes each. request 9 ends up in the same
+       index list as request 1. */
+    UA_Boolean deleteChunk;
+    UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    UA_SecureChannel_appendChunk(&channel, 9, &msg, 20, 10);
+    UA_SecureChannel_appendChunk(&channel, 1, &msg, 10, 10);
+    UA_ByteString bytes1 = UA_SecureChannel_finalizeChunk(&channel, 1, &msg, 20, 10, &deleteChunk);
+    ck_assert(deleteChunk);
+    ck_assert_int_eq(bytes1.length, 30);
+    ck_assert(memcmp(bytes1.data, data, 30) == 0);
+    UA_ByteString bytes9 = UA_SecureChannel_finalizeChunk(&channel, 9, &msg, 30, 10, &deleteChunk);
+    ck_assert(deleteChunk);
+    ck_assert_int_eq(bytes9.length, 20);
+    ck_assert(memcmp(bytes9.data, &data[20], 20) == 0);
+
+    /* a single final chunk points into the message */
+    UA_ByteString single = UA_SecureChannel_finalizeChunk(&channel, 2, &msg, 5, 10, &deleteChunk);
+    ck_assert(!deleteChunk);
+    ck_assert_ptr_eq(single.data, &data[5]);
+
+    UA_ByteString_deleteMembers(&bytes1);
+    UA_ByteString_deleteMembers(&bytes9);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+}
+END_TEST
+
+START_TEST(reassembleTooManyChunksShallFail) {
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    UA_Byte data[10] = {0};
+    UA_ByteString msg = {10, data};
+    for(size_t i=0;i<UA_ConnectionConfig_standard.maxChunkCount;i++)
+        UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    UA_Boolean deleteChunk;
+    UA_ByteString bytes = UA_SecureChannel_finalizeChunk(&channel, 1, &msg, 0, 10, &deleteChunk);
+    ck_assert_int_eq(bytes.length, 0);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+}
+END_TEST
+
+
+START_TEST(reassembleAfterAbortShallDropChunks) {
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    UA_Byte data[10] = {0};
+    UA_ByteString msg = {10, data};
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i=0;i<UA_ConnectionConfig_standard.maxChunkCount;i++)
+        retval |= UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* the limit is exceeded. the request is aborted. */
+    retval = UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTCPMESSAGETOOLARGE);
+    ck_assert_uint_eq(channel.chunkMemory, 0);
+
+    /* the following chunks do not start over */
+    retval = UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTCPMESSAGETOOLARGE);
+    ck_assert_uint_eq(channel.chunkMemory, 0);
+    UA_ByteString previous;
+    retval = UA_SecureChannel_takeChunks(&channel, 1, &msg, 0, 10, &previous);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADTCPMESSAGETOOLARGE);
+    ck_assert_ptr_eq(previous.data, NULL);
+    ck_assert_uint_eq(channel.chunkRequests, 0);
+
+    /* the abort chunk removes the aborted request */
+    UA_SecureChannel_appendChunk(&channel, 2, &msg, 5, 10);
+    UA_SecureChannel_removeChunk(&channel, 2);
+    ck_assert_uint_eq(channel.chunkRequests, 0);
+
+    /* the request id can be used again */
+    retval = UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_SecureChannel_takeChunks(&channel, 1, &msg, 0, 10, &previous);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(previous.length, 10);
+    UA_ByteString_deleteMembers(&previous);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+}
+END_TEST
+
+START_TEST(reassembleShallLimitTheRequestsAndMemory) {
+    UA_Connection connection;
+    UA_Connection_init(&connection);
+    connection.localConf.maxChunkedRequests = 2;
+    connection.localConf.maxChunkMemory = 25;
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.connection = &connection;
+    UA_Byte data[10] = {0};
+    UA_ByteString msg = {10, data};
+
+    /* the memory grows from the actual length */
+    ck_assert_uint_eq(UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(channel.chunkMemory, 10);
+    ck_assert_uint_eq(UA_SecureChannel_appendChunk(&channel, 2, &msg, 0, 10), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(channel.chunkMemory, 20);
+
+    /* a third request cannot be tracked */
+    ck_assert_uint_eq(UA_SecureChannel_appendChunk(&channel, 3, &msg, 0, 10),
+                      UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES);
+
+    /* request 1 exceeds the memory limit and is aborted */
+    ck_assert_uint_eq(UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10),
+                      UA_STATUSCODE_BADTCPNOTENOUGHRESOURCES);
+    ck_assert_uint_eq(channel.chunkMemory, 10);
+    ck_assert_uint_eq(channel.chunkRequests, 2);
+    UA_Boolean deleteChunk;
+    UA_ByteString bytes = UA_SecureChannel_finalizeChunk(&channel, 1, &msg, 0, 10, &deleteChunk);
+    ck_assert_ptr_eq(bytes.data, NULL);
+    ck_assert_uint_eq(channel.chunkRequests, 1);
+
+    /* now request 2 fits */
+    ck_assert_uint_eq(UA_SecureChannel_appendChunk(&channel, 2, &msg, 0, 10), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(channel.chunkMemory, 20);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+    UA_Connection_deleteMembers(&connection);
+}
+END_TEST
+
+
+START_TEST(reassembleWithoutFinalChunkShallWork) {
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    UA_Byte data[30];
+    for(size_t i=0;i<30;i++)
+        data[i] = (UA_Byte)i;
+    UA_ByteString msg = {30, data};
+    UA_SecureChannel_appendChunk(&channel, 1, &msg, 0, 10);
+    UA_SecureChannel_appendChunk(&channel, 1, &msg, 10, 10);
+    UA_ByteString previous;
+    UA_StatusCode retval = UA_SecureChannel_takeChunks(&channel, 1, &msg, 20, 10, &previous);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(previous.length, 20);
+    ck_assert(memcmp(previous.data, data, 20) == 0);
+    UA_ByteString_deleteMembers(&previous);
+
+    /* the chunks were removed */
+    retval = UA_SecureChannel_takeChunks(&channel, 1, &msg, 20, 10, &previous);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(previous.data, NULL);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+}
+END_TEST
+
+UA_ByteString *pieces;
+size_t piecesSize;
+size_t pieceIndex;
+
+static UA_StatusCode nextPieceMockUp(void *handle, UA_ByteString *buf) {
+    if(pieceIndex + 1 >= piecesSize)
+        return UA_STATUSCODE_BADDECODINGERROR;
+    pieceIndex++;
+    *buf = pieces[pieceIndex];
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(decodeFromSplitBuffersShallWork) {
+    /* a request with values of all sizes that end up split between pieces */
+    UA_WriteRequest req;
+    UA_WriteRequest_init(&req);
+    req.requestHeader.timestamp = 0x0102030405060708;
+    req.nodesToWriteSize = 2;
+    req.nodesToWrite = UA_Array_new(2, &UA_TYPES[UA_TYPES_WRITEVALUE]);
+    UA_Guid guid = {1, 2, 3, {4, 5, 6, 7, 8, 9, 10, 11}};
+    req.nodesToWrite[0].nodeId = UA_NODEID_GUID(1, guid);
+    req.nodesToWrite[0].attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_String strings[3] = {UA_STRING("a"), UA_STRING("split string"),
+                            UA_STRING("")};
+    UA_Variant_setArrayCopy(&req.nodesToWrite[0].value.value, strings, 3, &UA_TYPES[UA_TYPES_STRING]);
+    req.nodesToWrite[0].value.hasValue = true;
+    req.nodesToWrite[1].nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+    req.nodesToWrite[1].attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_Double d = 42.0;
+    UA_Variant_setScalarCopy(&req.nodesToWrite[1].value.value, &d, &UA_TYPES[UA_TYPES_DOUBLE]);
+    req.nodesToWrite[1].value.hasValue = true;
+    req.nodesToWrite[1].value.sourceTimestamp = 0x1112131415161718;
+    req.nodesToWrite[1].value.hasSourceTimestamp = true;
+
+    size_t encodedSize = UA_calcSizeBinary(&req, &UA_TYPES[UA_TYPES_WRITEREQUEST]);
+    UA_ByteString encoded;
+    UA_ByteString_allocBuffer(&encoded, encodedSize);
+    size_t offset = 0;
+    UA_StatusCode retval = UA_encodeBinary(&req, &UA_TYPES[UA_TYPES_WRITEREQUEST], NULL, NULL, &encoded, &offset);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_ByteString reencoded;
+    UA_ByteString_allocBuffer(&reencoded, encodedSize);
+    pieces = UA_malloc(sizeof(UA_ByteString) * encodedSize);
+    for(size_t pieceSize = 1; pieceSize <= 20; pieceSize++) {
+        piecesSize = 0;
+        for(size_t i = 0; i < encodedSize; i += pieceSize) {
+            pieces[piecesSize].data = &encoded.data[i];
+            pieces[piecesSize].length = (encodedSize - i < pieceSize) ? encodedSize - i : pieceSize;
+            piecesSize++;
+        }
+        pieceIndex = 0;
+        UA_WriteRequest decoded;
+        offset = 0;
+        retval = UA_decodeBinaryChunked(&pieces[0], &offset, &decoded, &UA_TYPES[UA_TYPES_WRITEREQUEST],
+                                        nextPieceMockUp, NULL, encodedSize - pieces[0].length, NULL);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(pieceIndex, piecesSize - 1);
+        ck_assert_int_eq(offset, pieces[pieceIndex].length);
+
+        size_t reoffset = 0;
+        retval = UA_encodeBinary(&decoded, &UA_TYPES[UA_TYPES_WRITEREQUEST], NULL, NULL, &reencoded, &reoffset);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_int_eq(reoffset, encodedSize);
+        ck_assert(memcmp(reencoded.data, encoded.data, encodedSize) == 0);
+        UA_WriteRequest_deleteMembers(&decoded);
+
+        /* decode into an arena. the small initial buffer spills to the heap */
+        UA_Byte arenaBuf[64];
+        UA_Arena arena;
+        UA_Arena_init(&arena, arenaBuf, sizeof(arenaBuf));
+        pieceIndex = 0;
+        offset = 0;
+        retval = UA_decodeBinaryChunked(&pieces[0], &offset, &decoded, &UA_TYPES[UA_TYPES_WRITEREQUEST],
+                                        nextPieceMockUp, NULL, encodedSize - pieces[0].length, &arena);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        reoffset = 0;
+        retval = UA_encodeBinary(&decoded, &UA_TYPES[UA_TYPES_WRITEREQUEST], NULL, NULL, &reencoded, &reoffset);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(memcmp(reencoded.data, encoded.data, encodedSize) == 0);
+        UA_Arena_deleteMembers(&arena);
+
+        /* a truncated source fails */
+        pieceIndex = 0;
+        piecesSize--;
+        offset = 0;
+        retval = UA_decodeBinaryChunked(&pieces[0], &offset, &decoded, &UA_TYPES[UA_TYPES_WRITEREQUEST],
+                                        nextPieceMockUp, NULL, encodedSize - pieces[0].length, NULL);
+        ck_assert_uint_ne(retval, UA_STATUSCODE_GOOD);
+        UA_WriteRequest_deleteMembers(&decoded);
+    }
+
+    UA_free(pieces);
+    UA_ByteString_deleteMembers(&reencoded);
+    UA_ByteString_deleteMembers(&encoded);
+    UA_WriteRequest_deleteMembers(&req);
+}
+END_TEST
+
+START_TEST(decodeIntoArenaShallBorrowStrings) {
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "a.rather.long.string.identifier");
+    rvi.dataEncoding = UA_QUALIFIEDNAME(0, "DefaultBinary");
+    UA_ByteString encoded;
+    UA_ByteString_allocBuffer(&encoded, 256);
+    size_t offset = 0;
+    UA_StatusCode retval = UA_encodeBinary(&rvi, &UA_TYPES[UA_TYPES_READVALUEID], NULL, NULL, &encoded, &offset);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    size_t encodedSize = offset;
+
+    /* strings within the buffer point into it */
+    UA_Arena arena;
+    UA_Arena_init(&arena, NULL, 0);
+    UA_ReadValueId decoded;
+    UA_ByteString src = {encodedSize, encoded.data};
+    offset = 0;
+    retval = UA_decodeBinaryChunked(&src, &offset, &decoded, &UA_TYPES[UA_TYPES_READVALUEID],
+                                    NULL, NULL, 0, &arena);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_NodeId_equal(&decoded.nodeId, &rvi.nodeId));
+    ck_assert(decoded.nodeId.identifier.string.data > encoded.data);
+    ck_assert(decoded.nodeId.identifier.string.data < &encoded.data[encodedSize]);
+    ck_assert(decoded.dataEncoding.name.data > encoded.data);
+    ck_assert(decoded.dataEncoding.name.data < &encoded.data[encodedSize]);
+    UA_Arena_deleteMembers(&arena);
+
+    /* a string split between two buffers is copied */
+    UA_ByteString split[2] = {{10, encoded.data}, {encodedSize - 10, &encoded.data[10]}};
+    pieces = split;
+    piecesSize = 2;
+    pieceIndex = 0;
+    offset = 0;
+    retval = UA_decodeBinaryChunked(&split[0], &offset, &decoded, &UA_TYPES[UA_TYPES_READVALUEID],
+                                    nextPieceMockUp, NULL, split[1].length, &arena);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(UA_NodeId_equal(&decoded.nodeId, &rvi.nodeId));
+    ck_assert(decoded.nodeId.identifier.string.data < encoded.data ||
+              decoded.nodeId.identifier.string.data >= &encoded.data[encodedSize]);
+    UA_Arena_deleteMembers(&arena);
+
+    UA_ByteString_deleteMembers(&encoded);
+}
+END_TEST
+
+/* A toy cipher and checksum for the protection of chunks */
+static UA_StatusCode
+toySign(void *context, const UA_Byte *data, size_t length, UA_Byte *signature) {
+    UA_UInt32 sum = 0x1234;
+    for(size_t i = 0; i < length; i++)
+        sum = sum * 31 + data[i];
+    memcpy(signature, &sum, 4);
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_StatusCode
+toyVerify(void *context, const UA_Byte *data, size_t length, const UA_Byte *signature) {
+    UA_Byte expected[4];
+    toySign(context, data, length, expected);
+    return memcmp(expected, signature, 4) == 0 ? UA_STATUSCODE_GOOD :
+        UA_STATUSCODE_BADSECURITYCHECKSFAILED;
+}
+
+static UA_StatusCode toyCrypt(void *context, UA_Byte *data, size_t length) {
+    if(length % 16 != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    for(size_t i = 0; i < length; i++)
+        data[i] ^= 0xa5;
+    return UA_STATUSCODE_GOOD;
+}
+
+static const UA_SymmetricCrypto toyCrypto = {NULL, 16, 4, toySign, toyVerify,
+                                             toyCrypt, toyCrypt, NULL};
+
+UA_ByteString sentChunks[16];
+size_t sentChunksSize;
+
+static UA_StatusCode
+captureGetSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static void captureReleaseSendBuffer(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+}
+
+static UA_StatusCode captureSend(UA_Connection *connection, UA_ByteString *buf) {
+    if(sentChunksSize >= 16) {
+        UA_ByteString_deleteMembers(buf);
+        return UA_STATUSCODE_BADINTERNALERROR;
+    }
+    sentChunks[sentChunksSize++] = *buf;
+    UA_ByteString_init(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void sendProtectedRequest(UA_SecureChannel *channel, UA_Connection *connection,
+                                 UA_ReadRequest *rq) {
+    UA_Connection_init(connection);
+    connection->localConf.sendBufferSize = 256;
+    connection->getSendBuffer = captureGetSendBuffer;
+    connection->releaseSendBuffer = captureReleaseSendBuffer;
+    connection->send = captureSend;
+    UA_SecureChannel_init(channel);
+    channel->connection = connection;
+    channel->securityMode = UA_MESSAGESECURITYMODE_SIGNANDENCRYPT;
+    UA_SecureChannel_setCrypto(channel, &toyCrypto);
+
+    UA_ReadRequest_init(rq);
+    rq->nodesToReadSize = 20;
+    rq->nodesToRead = UA_Array_new(20, &UA_TYPES[UA_TYPES_READVALUEID]);
+    for(size_t i = 0; i < 20; i++) {
+        rq->nodesToRead[i].nodeId = UA_NODEID_NUMERIC(1, 1000 + (UA_UInt32)i);
+        rq->nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    sentChunksSize = 0;
+    UA_StatusCode retval = UA_SecureChannel_sendBinaryMessage(channel, 1, rq,
+                                                              &UA_TYPES[UA_TYPES_READREQUEST]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(sentChunksSize > 1);
+}
+
+START_TEST(protectedChunksShallRoundTrip) {
+    UA_SecureChannel channel;
+    UA_Connection connection;
+    UA_ReadRequest rq;
+    sendProtectedRequest(&channel, &connection, &rq);
+
+    UA_ByteString whole;
+    UA_ByteString_allocBuffer(&whole, 256 * sentChunksSize);
+    size_t wholeLength = 0;
+    for(size_t i = 0; i < sentChunksSize; i++) {
+        UA_ByteString *chunk = &sentChunks[i];
+        ck_assert(chunk->length <= 256);
+        UA_UInt32 messageSize;
+        memcpy(&messageSize, &chunk->data[4], 4);
+        ck_assert_uint_eq(messageSize, chunk->length);
+        /* everything behind the security header is encrypted in whole blocks */
+        ck_assert_uint_eq((chunk->length - 16) % 16, 0);
+        size_t contentLength;
+        UA_StatusCode retval = UA_SecureChannel_unprotectChunk(&channel, chunk, &contentLength);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert(contentLength > 24);
+        ck_assert_int_eq(chunk->data[3], i + 1 == sentChunksSize ? 'F' : 'C');
+        memcpy(&whole.data[wholeLength], &chunk->data[24], contentLength - 24);
+        wholeLength += contentLength - 24;
+        UA_ByteString_deleteMembers(chunk);
+    }
+
+    whole.length = wholeLength;
+    size_t offset = 0;
+    UA_NodeId typeId;
+    UA_ReadRequest decoded;
+    UA_StatusCode retval = UA_NodeId_decodeBinary(&whole, &offset, &typeId);
+    retval |= UA_ReadRequest_decodeBinary(&whole, &offset, &decoded);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(offset, wholeLength);
+    ck_assert_uint_eq(typeId.identifier.numeric,
+                      UA_TYPES[UA_TYPES_READREQUEST].typeId.identifier.numeric + UA_ENCODINGOFFSET_BINARY);
+    ck_assert_int_eq(decoded.nodesToReadSize, 20);
+    for(size_t i = 0; i < 20; i++)
+        ck_assert(UA_NodeId_equal(&decoded.nodesToRead[i].nodeId, &rq.nodesToRead[i].nodeId));
+
+    UA_ReadRequest_deleteMembers(&decoded);
+    UA_ReadRequest_deleteMembers(&rq);
+    UA_ByteString_deleteMembers(&whole);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+}
+END_TEST
+
+START_TEST(tamperedChunkShallFail) {
+    UA_SecureChannel channel;
+    UA_Connection connection;
+    UA_ReadRequest rq;
+    sendProtectedRequest(&channel, &connection, &rq);
+
+    size_t contentLength;
+    sentChunks[0].data[40] ^= 0x01;
+    UA_StatusCode retval = UA_SecureChannel_unprotectChunk(&channel, &sentChunks[0], &contentLength);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADSECURITYCHECKSFAILED);
+
+    /* a chunk that does not end on a block boundary */
+    sentChunks[1].length--;
+    retval = UA_SecureChannel_unprotectChunk(&channel, &sentChunks[1], &contentLength);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADSECURITYCHECKSFAILED);
+    sentChunks[1].length++;
+
+    for(size_t i = 0; i < sentChunksSize; i++)
+        UA_ByteString_deleteMembers(&sentChunks[i]);
+    UA_ReadRequest_deleteMembers(&rq);
+    UA_SecureChannel_deleteMembersCleanup(&channel);
+}
+END_TEST
+
+#ifdef UA_ENABLE_CRYPTO_BASIC256SHA256
+START_TEST(basic256Sha256ShallMatchTestVectors) {
+    UA_Byte clientNonceData[32], serverNonceData[32];
+    for(size_t i = 0; i < 32; i++) {
+        clientNonceData[i] = (UA_Byte)(0x01 + i);
+        serverNonceData[i] = (UA_Byte)(0x21 + i);
+    }
+    UA_ByteString clientNonce = {32, clientNonceData};
+    UA_ByteString serverNonce = {32, serverNonceData};
+    UA_SymmetricCrypto server, client;
+    UA_StatusCode retval = UA_SymmetricCrypto_Basic256Sha256(&serverNonce, &clientNonce, &server);
+    retval |= UA_SymmetricCrypto_Basic256Sha256(&clientNonce, &serverNonce, &client);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* HMAC-SHA256 and AES-256-CBC with the keys of the server. Computed with
+     * python hmac and openssl enc. */
+    const UA_Byte expectedSignature[32] = {
+        0x75, 0x29, 0x0a, 0x25, 0xce, 0xe6, 0xc0, 0x18, 0x99, 0x41, 0xac, 0x69, 0x91, 0x9f, 0x73, 0xe2,
+        0x58, 0xd9, 0x4b, 0xf9, 0x1a, 0xfa, 0xc1, 0x8b, 0x3e, 0xdf, 0x5b, 0x13, 0xb6, 0x78, 0x12, 0x87};
+    const UA_Byte expectedCipher[32] = {
+        0xb6, 0xa2, 0xe2, 0x05, 0xcc, 0xaa, 0xc0, 0x29, 0x9f, 0x91, 0x76, 0x56, 0x34, 0xb9, 0x1b, 0xa6,
+        0xf7, 0x9f, 0x76, 0x87, 0x27, 0x17, 0x43, 0xd2, 0x2a, 0xf0, 0x33, 0xda, 0x7b, 0x76, 0xf6, 0xe0};
+    UA_Byte signature[32];
+    server.sign(server.context, (const UA_Byte*)"abc", 3, signature);
+    ck_assert(memcmp(signature, expectedSignature, 32) == 0);
+    ck_assert_uint_eq(client.verify(client.context, (const UA_Byte*)"abc", 3, signature),
+                      UA_STATUSCODE_GOOD);
+    signature[31] ^= 0x80;
+    ck_assert_uint_eq(client.verify(client.context, (const UA_Byte*)"abc", 3, signature),
+                      UA_STATUSCODE_BADSECURITYCHECKSFAILED);
+
+    UA_Byte data[32] = {0};
+    server.encrypt(server.context, data, 32);
+    ck_assert(memcmp(data, expectedCipher, 32) == 0);
+
+    /* the decryption interleaves four blocks and handles the rest singly */
+    UA_Byte plain[112], cipher[112];
+    for(size_t i = 0; i < 112; i++)
+        plain[i] = (UA_Byte)(i * 7);
+    memcpy(cipher, plain, 112);
+    client.encrypt(client.context, cipher, 112);
+    ck_assert(memcmp(cipher, plain, 112) != 0);
+    server.decrypt(server.context, cipher, 112);
+    ck_assert(memcmp(cipher, plain, 112) == 0);
+
+    server.deleteMembers(server.context);
+    client.deleteMembers(client.context);
+}
+END_TEST
+#endif
 
 static Suite *testSuite_builtin(void) {
     Suite *s = suite_create("Chunked encoding");
     TCase *tc_message = tcase_create("encode chunking");
     tcase_add_test(tc_message,encodeArrayIntoFiveChunksShallWork);
     tcase_add_test(tc_message,encodeStringIntoFiveChunksShallWork);
+    tcase_add_test(tc_message,encodeArrayIntoChunksShallKeepContent);
+    tcase_add_test(tc_message,encodeExtensionObjectIntoChunksShallWork);
     suite_add_tcase(s, tc_message);
+    TCase *tc_reassembly = tcase_create("chunk reassembly");
+    tcase_add_test(tc_reassembly,reassembleInterleavedChunksShallWork);
+    tcase_add_test(tc_reassembly,reassembleTooManyChunksShallFail);
+    tcase_add_test(tc_reassembly,reassembleAfterAbortShallDropChunks);
+    tcase_add_test(tc_reassembly,reassembleShallLimitTheRequestsAndMemory);
+    tcase_add_test(tc_reassembly,reassembleWithoutFinalChunkShallWork);
+    tcase_add_test(tc_reassembly,decodeFromSplitBuffersShallWork);
+    tcase_add_test(tc_reassembly,decodeIntoArenaShallBorrowStrings);
+    suite_add_tcase(s, tc_reassembly);
+    TCase *tc_security = tcase_create("chunk security");
+    tcase_add_test(tc_security,protectedChunksShallRoundTrip);
+    tcase_add_test(tc_security,tamperedChunkShallFail);
+#ifdef UA_ENABLE_CRYPTO_BASIC256SHA256
+    tcase_add_test(tc_security,basic256Sha256ShallMatchTestVectors);
+#endif
+    suite_add_tcase(s, tc_security);
     return s;
 }
 
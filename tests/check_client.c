@@ -0,0 +1,506 @@
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel.h"
+#include "ua_config_standard.h"
+#include "ua_network_tcp.h"
+#include "check.h"
+
+#define ENDPOINT "opc.tcp://localhost:16682"
+
+static UA_Server *server;
+static UA_ServerNetworkLayer nl;
+static UA_Boolean running;
+static pthread_t server_thread;
+static UA_Client *client;
+
+static void *serverloop(void *_) {
+    UA_Server_run(server, &running);
+    return NULL;
+}
+
+static void setup(void) {
+    running = true;
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    nl = UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, 16682);
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    server = UA_Server_new(config);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 value = 42;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    attr.accessLevel = attr.userAccessLevel = 3;
+    UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "the.answer"),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                              UA_QUALIFIEDNAME(1, "the answer"), UA_NODEID_NULL,
+                              attr, NULL, NULL);
+    pthread_create(&server_thread, NULL, serverloop, NULL);
+    usleep(100000); /* until the server listens */
+
+    client = UA_Client_new(UA_ClientConfig_standard);
+    ck_assert_uint_eq(UA_Client_connect(client, ENDPOINT), UA_STATUSCODE_GOOD);
+}
+
+static void teardown(void) {
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    running = false;
+    pthread_join(server_thread, NULL);
+    UA_Server_delete(server);
+    nl.deleteMembers(&nl);
+}
+
+static UA_ReadRequest readRequest(UA_ReadValueId *rvi, UA_UInt32 attributeId) {
+    UA_ReadValueId_init(rvi);
+    rvi->nodeId = UA_NODEID_STRING(1, "the.answer");
+    rvi->attributeId = attributeId;
+    UA_ReadRequest request;
+    UA_ReadRequest_init(&request);
+    request.nodesToRead = rvi;
+    request.nodesToReadSize = 1;
+    return request;
+}
+
+/*************************/
+/* Asynchronous Services */
+/*************************/
+
+typedef struct {
+    UA_UInt32 requestId;
+    UA_UInt32 receivedId;
+    UA_StatusCode serviceResult;
+    UA_DataValue result;
+    size_t calls;
+} AsyncRead;
+
+static void asyncReadDone(UA_Client *c, void *userdata, UA_UInt32 requestId,
+                          const void *response) {
+    AsyncRead *ar = (AsyncRead*)userdata;
+    const UA_ReadResponse *rr = (const UA_ReadResponse*)response;
+    ar->receivedId = requestId;
+    ar->serviceResult = rr->responseHeader.serviceResult;
+    if(rr->resultsSize == 1)
+        UA_DataValue_copy(&rr->results[0], &ar->result);
+    ar->calls++;
+}
+
+START_TEST(Client_async_dispatchesResponsesByRequestId) {
+    UA_UInt32 attributes[3] = {UA_ATTRIBUTEID_VALUE, UA_ATTRIBUTEID_BROWSENAME,
+                               UA_ATTRIBUTEID_NODECLASS};
+    AsyncRead reads[3];
+    memset(reads, 0, sizeof(reads));
+    UA_ReadValueId rvi;
+    for(size_t i = 0; i < 3; i++) {
+        UA_ReadRequest request = readRequest(&rvi, attributes[i]);
+        ck_assert_uint_eq(UA_Client_AsyncService_read(client, request, asyncReadDone, &reads[i],
+                                                      &reads[i].requestId), UA_STATUSCODE_GOOD);
+    }
+
+    /* The responses that arrive while a synchronous service waits are
+     * dispatched as well */
+    UA_Variant value;
+    ck_assert_uint_eq(UA_Client_readValueAttribute(client, UA_NODEID_STRING(1, "the.answer"),
+                                                   &value), UA_STATUSCODE_GOOD);
+    UA_Variant_deleteMembers(&value);
+    for(size_t i = 0; i < 100 && reads[2].calls == 0; i++)
+        UA_Client_run_iterate(client, 10);
+
+    for(size_t i = 0; i < 3; i++) {
+        ck_assert_uint_eq(reads[i].calls, 1);
+        ck_assert_uint_eq(reads[i].receivedId, reads[i].requestId);
+        ck_assert_uint_eq(reads[i].serviceResult, UA_STATUSCODE_GOOD);
+        ck_assert(reads[i].result.hasValue);
+    }
+    ck_assert_ptr_eq(reads[0].result.value.type, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_int_eq(*(UA_Int32*)reads[0].result.value.data, 42);
+    ck_assert_ptr_eq(reads[1].result.value.type, &UA_TYPES[UA_TYPES_QUALIFIEDNAME]);
+    ck_assert_ptr_eq(reads[2].result.value.type, &UA_TYPES[UA_TYPES_INT32]); /* enum */
+    ck_assert_int_eq(*(UA_Int32*)reads[2].result.value.data, UA_NODECLASS_VARIABLE);
+    for(size_t i = 0; i < 3; i++)
+        UA_DataValue_deleteMembers(&reads[i].result);
+} END_TEST
+
+START_TEST(Client_async_completesPendingCallsOnDisconnect) {
+    AsyncRead read;
+    memset(&read, 0, sizeof(read));
+    UA_ReadValueId rvi;
+    UA_ReadRequest request = readRequest(&rvi, UA_ATTRIBUTEID_VALUE);
+    ck_assert_uint_eq(UA_Client_AsyncService_read(client, request, asyncReadDone, &read,
+                                                  &read.requestId), UA_STATUSCODE_GOOD);
+    UA_Client_disconnect(client);
+    ck_assert_uint_eq(read.calls, 1);
+    ck_assert_uint_eq(read.receivedId, read.requestId);
+    UA_DataValue_deleteMembers(&read.result);
+} END_TEST
+
+/****************************/
+/* Batched Reads and Writes */
+/****************************/
+
+START_TEST(Client_batch_keepsTheOrderOfOperations) {
+    UA_NodeId answer = UA_NODEID_STRING(1, "the.answer");
+    UA_Variant before, after, missing, written;
+    UA_QualifiedName browseName;
+    UA_Int32 value = 43;
+    UA_Variant_setScalar(&written, &value, &UA_TYPES[UA_TYPES_INT32]);
+
+    ck_assert_uint_eq(UA_Client_beginBatch(client), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Client_readValueAttribute(client, answer, &before),
+                      UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY);
+    ck_assert_uint_eq(UA_Client_readValueAttribute(client, UA_NODEID_STRING(1, "no.such.node"),
+                                                   &missing),
+                      UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY);
+    ck_assert_uint_eq(UA_Client_writeValueAttribute(client, answer, &written),
+                      UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY);
+    ck_assert_uint_eq(UA_Client_readValueAttribute(client, answer, &after),
+                      UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY);
+    ck_assert_uint_eq(UA_Client_readBrowseNameAttribute(client, answer, &browseName),
+                      UA_STATUSCODE_GOODCOMPLETESASYNCHRONOUSLY);
+
+    UA_StatusCode *results;
+    size_t resultsSize;
+    ck_assert_uint_eq(UA_Client_flushBatch(client, &results, &resultsSize), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(resultsSize, 5);
+    ck_assert_uint_eq(results[0], UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[1], UA_STATUSCODE_BADNODEIDUNKNOWN);
+    ck_assert_uint_eq(results[2], UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[3], UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[4], UA_STATUSCODE_GOOD);
+    UA_Array_delete(results, resultsSize, &UA_TYPES[UA_TYPES_STATUSCODE]);
+
+    /* The reads before the write see the old value */
+    ck_assert_int_eq(*(UA_Int32*)before.data, 42);
+    ck_assert_int_eq(*(UA_Int32*)after.data, 43);
+    UA_String name = UA_STRING("the answer");
+    ck_assert(UA_String_equal(&browseName.name, &name));
+    UA_Variant_deleteMembers(&before);
+    UA_Variant_deleteMembers(&after);
+    UA_QualifiedName_deleteMembers(&browseName);
+
+    /* Without a batch, the operations are sent right away */
+    ck_assert_uint_eq(UA_Client_readValueAttribute(client, answer, &after), UA_STATUSCODE_GOOD);
+    UA_Variant_deleteMembers(&after);
+} END_TEST
+
+/*********************/
+/* Prepared Requests */
+/*********************/
+
+static void writeAnswer(UA_Int32 value) {
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &value, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_uint_eq(UA_Client_writeValueAttribute(client, UA_NODEID_STRING(1, "the.answer"), &v),
+                      UA_STATUSCODE_GOOD);
+}
+
+START_TEST(Client_prepared_sendsTheCurrentHeader) {
+    UA_ReadValueId rvi;
+    UA_ReadRequest request = readRequest(&rvi, UA_ATTRIBUTEID_VALUE);
+    UA_PreparedRequest prepared;
+    ck_assert_uint_eq(UA_Client_prepareRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST],
+                                               &UA_TYPES[UA_TYPES_READRESPONSE], &prepared),
+                      UA_STATUSCODE_GOOD);
+
+    /* The same response structure is reused for every send */
+    UA_ReadResponse response;
+    UA_ReadResponse_init(&response);
+    UA_UInt32 lastHandle = 0;
+    for(UA_Int32 i = 0; i < 3; i++) {
+        writeAnswer(100 + i);
+        ck_assert_uint_eq(UA_Client_sendPreparedRequest(client, &prepared, &response),
+                          UA_STATUSCODE_GOOD);
+        ck_assert_uint_gt(response.responseHeader.requestHandle, lastHandle);
+        lastHandle = response.responseHeader.requestHandle;
+        ck_assert_uint_eq(response.resultsSize, 1);
+        ck_assert(response.results[0].hasValue);
+        ck_assert_int_eq(*(UA_Int32*)response.results[0].value.data, 100 + i);
+    }
+    UA_ReadResponse_deleteMembers(&response);
+    UA_PreparedRequest_deleteMembers(&prepared);
+} END_TEST
+
+static UA_Boolean inBuffer(const void *p, const UA_Byte *buf, size_t bufSize) {
+    return (const UA_Byte*)p >= buf && (const UA_Byte*)p < buf + bufSize;
+}
+
+START_TEST(Client_prepared_decodesIntoTheArena) {
+    UA_ReadValueId rvi[2];
+    UA_ReadRequest request = readRequest(&rvi[0], UA_ATTRIBUTEID_VALUE);
+    readRequest(&rvi[1], UA_ATTRIBUTEID_BROWSENAME);
+    request.nodesToReadSize = 2;
+    UA_PreparedRequest prepared;
+    ck_assert_uint_eq(UA_Client_prepareRequest(&request, &UA_TYPES[UA_TYPES_READREQUEST],
+                                               &UA_TYPES[UA_TYPES_READRESPONSE], &prepared),
+                      UA_STATUSCODE_GOOD);
+
+    /* The response is taken from the buffer and is not deleted */
+    UA_Byte arena[1024];
+    UA_ReadResponse response;
+    UA_String name = UA_STRING("the answer");
+    for(UA_Int32 i = 0; i < 3; i++) {
+        writeAnswer(200 + i);
+        ck_assert_uint_eq(UA_Client_sendPreparedRequestArena(client, &prepared, &response,
+                                                             arena, sizeof(arena)),
+                          UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(response.resultsSize, 2);
+        ck_assert(inBuffer(response.results, arena, sizeof(arena)));
+        ck_assert_int_eq(*(UA_Int32*)response.results[0].value.data, 200 + i);
+        UA_QualifiedName *browseName = (UA_QualifiedName*)response.results[1].value.data;
+        ck_assert(UA_String_equal(&browseName->name, &name));
+    }
+
+    /* The heap is used when the buffer is exhausted */
+    UA_Byte small[16];
+    ck_assert_uint_eq(UA_Client_sendPreparedRequestArena(client, &prepared, &response,
+                                                         small, sizeof(small)),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, 2);
+    ck_assert_int_eq(*(UA_Int32*)response.results[0].value.data, 202);
+    UA_PreparedRequest_deleteMembers(&prepared);
+} END_TEST
+
+/****************/
+/* Client Cache */
+/****************/
+
+static UA_Client *connectOther(void) {
+    UA_Client *other = UA_Client_new(UA_ClientConfig_standard);
+    ck_assert_uint_eq(UA_Client_connect(other, ENDPOINT), UA_STATUSCODE_GOOD);
+    return other;
+}
+
+static void assertDisplayName(const char *expected) {
+    UA_LocalizedText displayName;
+    ck_assert_uint_eq(UA_Client_readDisplayNameAttribute(client, UA_NODEID_STRING(1, "the.answer"),
+                                                         &displayName), UA_STATUSCODE_GOOD);
+    UA_String text = UA_STRING((char*)(uintptr_t)expected);
+    ck_assert(UA_String_equal(&displayName.text, &text));
+    UA_LocalizedText_deleteMembers(&displayName);
+}
+
+START_TEST(Client_cache_servesAttributesUntilInvalidated) {
+    UA_NodeId answer = UA_NODEID_STRING(1, "the.answer");
+    ck_assert_uint_eq(UA_Client_Cache_enable(client, 60000), UA_STATUSCODE_GOOD);
+    assertDisplayName("");
+
+    /* Changes by other clients are not seen before the invalidation */
+    UA_Client *other = connectOther();
+    UA_LocalizedText displayName = UA_LOCALIZEDTEXT("en", "changed");
+    ck_assert_uint_eq(UA_Client_writeDisplayNameAttribute(other, answer, &displayName),
+                      UA_STATUSCODE_GOOD);
+    assertDisplayName("");
+    UA_Client_Cache_invalidate(client, answer);
+    assertDisplayName("changed");
+
+    /* Own writes invalidate the node */
+    displayName = UA_LOCALIZEDTEXT("en", "own");
+    ck_assert_uint_eq(UA_Client_writeDisplayNameAttribute(client, answer, &displayName),
+                      UA_STATUSCODE_GOOD);
+    assertDisplayName("own");
+
+    UA_Client_disconnect(other);
+    UA_Client_delete(other);
+} END_TEST
+
+static size_t countChildren(void) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult result;
+    ck_assert_uint_eq(UA_Client_browse(client, &bd, &result), UA_STATUSCODE_GOOD);
+    size_t children = result.referencesSize;
+    UA_BrowseResult_deleteMembers(&result);
+    return children;
+}
+
+START_TEST(Client_cache_servesPrefetchedBrowseResults) {
+    ck_assert_uint_eq(UA_Client_Cache_enable(client, 60000), UA_STATUSCODE_GOOD);
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    ck_assert_uint_eq(UA_Client_Cache_prefetch(client, &bd, 1), UA_STATUSCODE_GOOD);
+
+    /* A node added by another client is not seen in the prefetched result */
+    UA_Client *other = connectOther();
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 value = 0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_uint_eq(UA_Client_addVariableNode(other, UA_NODEID_STRING(1, "the.other"),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                UA_QUALIFIEDNAME(1, "the other"),
+                                                UA_NODEID_NULL, attr, NULL),
+                      UA_STATUSCODE_GOOD);
+    size_t children = countChildren();
+    ck_assert_uint_gt(children, 0);
+    UA_Client_Cache_invalidate(client, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER));
+    ck_assert_uint_eq(countChildren(), children + 1);
+
+    /* Without the cache, the server is browsed every time */
+    ck_assert_uint_eq(UA_Client_Cache_enable(client, 0), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Client_deleteNode(other, UA_NODEID_STRING(1, "the.other"), true),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(countChildren(), children);
+
+    UA_Client_disconnect(other);
+    UA_Client_delete(other);
+} END_TEST
+
+/***************/
+/* Client Pool */
+/***************/
+
+#define POOLSIZE 3
+#define POOLNODES 6
+
+START_TEST(Client_pool_browsesInPartsAndContinues) {
+    UA_ClientPool *pool = UA_ClientPool_new(UA_ClientConfig_standard, POOLSIZE);
+    ck_assert_ptr_ne(pool, NULL);
+    ck_assert_uint_eq(UA_ClientPool_connect(pool, ENDPOINT), UA_STATUSCODE_GOOD);
+
+    const UA_UInt32 nodes[POOLNODES] = {UA_NS0ID_ROOTFOLDER, UA_NS0ID_OBJECTSFOLDER,
+                                        UA_NS0ID_TYPESFOLDER, UA_NS0ID_VIEWSFOLDER,
+                                        UA_NS0ID_SERVER, UA_NS0ID_REFERENCETYPESFOLDER};
+    UA_BrowseDescription bd[POOLNODES];
+    for(size_t i = 0; i < POOLNODES; i++) {
+        UA_BrowseDescription_init(&bd[i]);
+        bd[i].nodeId = UA_NODEID_NUMERIC(0, nodes[i]);
+        bd[i].browseDirection = UA_BROWSEDIRECTION_BOTH;
+        bd[i].resultMask = UA_BROWSERESULTMASK_NONE;
+    }
+    UA_BrowseRequest request;
+    UA_BrowseRequest_init(&request);
+    request.nodesToBrowse = bd;
+    request.nodesToBrowseSize = POOLNODES;
+
+    /* The references of the nodes in one request to a single client */
+    UA_BrowseResponse expected = UA_Client_Service_browse(client, request);
+    ck_assert_uint_eq(expected.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(expected.resultsSize, POOLNODES);
+
+    /* One reference at a time over the pool */
+    request.requestedMaxReferencesPerNode = 1;
+    UA_BrowseResponse response = UA_ClientPool_browse(pool, &request);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.resultsSize, POOLNODES);
+    size_t references[POOLNODES];
+    UA_ByteString cps[POOLNODES];
+    for(size_t i = 0; i < POOLNODES; i++) {
+        ck_assert_uint_eq(response.results[i].statusCode, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(response.results[i].referencesSize, 1);
+        references[i] = 1;
+        cps[i] = response.results[i].continuationPoint;
+        UA_ByteString_init(&response.results[i].continuationPoint);
+        ck_assert_uint_gt(cps[i].length, 0);
+    }
+    UA_BrowseResponse_deleteMembers(&response);
+
+    /* The first and the last node were browsed on different clients. The
+     * continuation points are prefixed with the index of the client. */
+    UA_UInt32 firstClient, lastClient;
+    memcpy(&firstClient, cps[0].data, sizeof(UA_UInt32));
+    memcpy(&lastClient, cps[POOLNODES-1].data, sizeof(UA_UInt32));
+    ck_assert_uint_eq(firstClient, 0);
+    ck_assert_uint_eq(lastClient, POOLSIZE-1);
+
+    /* The continuation points are sent to the clients they belong to. They
+     * are continued in reverse order. */
+    UA_BrowseNextRequest nextRequest;
+    UA_BrowseNextRequest_init(&nextRequest);
+    nextRequest.continuationPoints = cps;
+    UA_Boolean more = true;
+    while(more) {
+        UA_ByteString reversed[POOLNODES];
+        size_t positions[POOLNODES];
+        size_t pending = 0;
+        for(size_t i = POOLNODES; i > 0; i--) {
+            if(cps[i-1].length == 0)
+                continue;
+            reversed[pending] = cps[i-1];
+            positions[pending] = i-1;
+            pending++;
+        }
+        nextRequest.continuationPoints = reversed;
+        nextRequest.continuationPointsSize = pending;
+        UA_BrowseNextResponse next = UA_ClientPool_browseNext(pool, &nextRequest);
+        ck_assert_uint_eq(next.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(next.resultsSize, pending);
+        more = false;
+        for(size_t j = 0; j < pending; j++) {
+            size_t i = positions[j];
+            ck_assert_uint_eq(next.results[j].statusCode, UA_STATUSCODE_GOOD);
+            references[i] += next.results[j].referencesSize;
+            UA_ByteString_deleteMembers(&cps[i]);
+            cps[i] = next.results[j].continuationPoint;
+            UA_ByteString_init(&next.results[j].continuationPoint);
+            more |= (cps[i].length > 0);
+        }
+        UA_BrowseNextResponse_deleteMembers(&next);
+    }
+    for(size_t i = 0; i < POOLNODES; i++)
+        ck_assert_uint_eq(references[i], expected.results[i].referencesSize);
+    UA_BrowseResponse_deleteMembers(&expected);
+
+    /* A continuation point that did not come from the pool */
+    UA_ByteString invalid = UA_BYTESTRING("x");
+    nextRequest.continuationPoints = &invalid;
+    nextRequest.continuationPointsSize = 1;
+    UA_BrowseNextResponse next = UA_ClientPool_browseNext(pool, &nextRequest);
+    ck_assert_uint_eq(next.resultsSize, 1);
+    ck_assert_uint_eq(next.results[0].statusCode, UA_STATUSCODE_BADCONTINUATIONPOINTINVALID);
+    UA_BrowseNextResponse_deleteMembers(&next);
+
+    UA_ClientPool_disconnect(pool);
+    UA_ClientPool_delete(pool);
+} END_TEST
+
+static Suite* testSuite_Client(void) {
+    Suite *s = suite_create("Client");
+    TCase *tc_async = tcase_create("Asynchronous Services");
+    tcase_add_checked_fixture(tc_async, setup, teardown);
+    tcase_add_test(tc_async, Client_async_dispatchesResponsesByRequestId);
+    tcase_add_test(tc_async, Client_async_completesPendingCallsOnDisconnect);
+    suite_add_tcase(s, tc_async);
+    TCase *tc_batch = tcase_create("Batched Reads and Writes");
+    tcase_add_checked_fixture(tc_batch, setup, teardown);
+    tcase_add_test(tc_batch, Client_batch_keepsTheOrderOfOperations);
+    suite_add_tcase(s, tc_batch);
+    TCase *tc_prepared = tcase_create("Prepared Requests");
+    tcase_add_checked_fixture(tc_prepared, setup, teardown);
+    tcase_add_test(tc_prepared, Client_prepared_sendsTheCurrentHeader);
+    tcase_add_test(tc_prepared, Client_prepared_decodesIntoTheArena);
+    suite_add_tcase(s, tc_prepared);
+    TCase *tc_cache = tcase_create("Client Cache");
+    tcase_add_checked_fixture(tc_cache, setup, teardown);
+    tcase_add_test(tc_cache, Client_cache_servesAttributesUntilInvalidated);
+    tcase_add_test(tc_cache, Client_cache_servesPrefetchedBrowseResults);
+    suite_add_tcase(s, tc_cache);
+    TCase *tc_pool = tcase_create("Client Pool");
+    tcase_add_checked_fixture(tc_pool, setup, teardown);
+    tcase_add_test(tc_pool, Client_pool_browsesInPartsAndContinues);
+    suite_add_tcase(s, tc_pool);
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_Client();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
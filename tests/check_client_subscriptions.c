@@ -0,0 +1,263 @@
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_client.h"
+#include "ua_client_highlevel.h"
+#include "ua_config_standard.h"
+#include "ua_network_tcp.h"
+#include "client/ua_client_internal.h"
+#include "check.h"
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+
+#define ENDPOINT "opc.tcp://localhost:16681"
+
+static UA_Server *server;
+static UA_ServerNetworkLayer nl;
+static UA_Boolean running;
+static pthread_t server_thread;
+
+static void *serverloop(void *_) {
+    UA_Server_run(server, &running);
+    return NULL;
+}
+
+static void setup(void) {
+    running = true;
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    nl = UA_ServerNetworkLayerTCP(UA_ConnectionConfig_standard, 16681);
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    server = UA_Server_new(config);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 value = 0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    attr.accessLevel = attr.userAccessLevel = 3;
+    UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "the.answer"),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                              UA_QUALIFIEDNAME(1, "the answer"), UA_NODEID_NULL,
+                              attr, NULL, NULL);
+    UA_LocalizedText text = UA_LOCALIZEDTEXT("", "");
+    UA_Variant_setScalar(&attr.value, &text, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "the.text"),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                              UA_QUALIFIEDNAME(1, "the text"), UA_NODEID_NULL,
+                              attr, NULL, NULL);
+    pthread_create(&server_thread, NULL, serverloop, NULL);
+    usleep(100000); /* until the server listens */
+}
+
+static void teardown(void) {
+    running = false;
+    pthread_join(server_thread, NULL);
+    UA_Server_delete(server);
+    nl.deleteMembers(&nl);
+}
+
+static UA_Int32 lastValue;
+static size_t notifications;
+
+static void valueChanged(UA_UInt32 monId, UA_DataValue *value, void *context) {
+    if(value->hasValue && value->value.type == &UA_TYPES[UA_TYPES_INT32])
+        lastValue = *(UA_Int32*)value->value.data;
+    notifications++;
+}
+
+static UA_Client *
+connectClient(const char *applicationUri, UA_UInt32 *subId) {
+    UA_ClientConfig config = UA_ClientConfig_standard;
+    config.applicationUri = UA_STRING((char*)(uintptr_t)applicationUri);
+    UA_Client *client = UA_Client_new(config);
+    ck_assert_uint_eq(UA_Client_connect(client, ENDPOINT), UA_STATUSCODE_GOOD);
+    UA_SubscriptionSettings settings = UA_SubscriptionSettings_standard;
+    settings.requestedPublishingInterval = 10.0;
+    ck_assert_uint_eq(UA_Client_Subscriptions_new(client, settings, subId), UA_STATUSCODE_GOOD);
+    UA_UInt32 monId;
+    ck_assert_uint_eq(UA_Client_Subscriptions_addMonitoredItem(client, *subId,
+                                                               UA_NODEID_STRING(1, "the.answer"),
+                                                               UA_ATTRIBUTEID_VALUE, valueChanged,
+                                                               NULL, &monId), UA_STATUSCODE_GOOD);
+    return client;
+}
+
+static void writeValue(UA_Client *client, UA_Int32 value) {
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &value, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_uint_eq(UA_Client_writeValueAttribute(client, UA_NODEID_STRING(1, "the.answer"), &v),
+                      UA_STATUSCODE_GOOD);
+}
+
+/* Publish until the notification arrives, at most for a second */
+static void publishUntil(UA_Client *client, size_t expected) {
+    for(size_t i = 0; i < 100 && notifications < expected; i++) {
+        usleep(10000);
+        UA_Client_Subscriptions_manuallySendPublishRequest(client);
+    }
+}
+
+START_TEST(Client_reconnect_republishesMissedMessages) {
+    UA_UInt32 subId;
+    notifications = 0;
+    UA_Client *client = connectClient("urn:test:client", &subId);
+    publishUntil(client, 1);
+    ck_assert_uint_eq(notifications, 1);
+    ck_assert_int_eq(lastValue, 0);
+
+    /* The server sends a notification message that the client never reads */
+    writeValue(client, 42);
+    usleep(500000);
+    ck_assert_uint_eq(UA_Client_Subscriptions_startPublishing(client, 1), UA_STATUSCODE_GOOD);
+    usleep(500000);
+    UA_Client_Subscriptions_stopPublishing(client);
+    client->connection.close(&client->connection);
+
+    /* The session is reactivated and the missed message republished */
+    ck_assert_uint_eq(UA_Client_reconnect(client), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(notifications, 2);
+    ck_assert_int_eq(lastValue, 42);
+
+    /* The subscription continues */
+    writeValue(client, 43);
+    publishUntil(client, 3);
+    ck_assert_uint_eq(notifications, 3);
+    ck_assert_int_eq(lastValue, 43);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+} END_TEST
+
+START_TEST(Client_renew_keepsOutstandingPublishRequests) {
+    UA_UInt32 subId;
+    notifications = 0;
+    UA_Client *client = connectClient("urn:test:client", &subId);
+    publishUntil(client, 1);
+    ck_assert_uint_eq(notifications, 1);
+
+    /* The publish responses that arrive during the renewal are dispatched */
+    ck_assert_uint_eq(UA_Client_Subscriptions_startPublishing(client, 2), UA_STATUSCODE_GOOD);
+    writeValue(client, 7);
+    usleep(200000);
+    ck_assert_uint_eq(UA_Client_manuallyRenewSecureChannel(client), UA_STATUSCODE_GOOD);
+    writeValue(client, 8);
+    for(size_t i = 0; i < 100 && lastValue != 8; i++) {
+        usleep(10000);
+        UA_Client_run_iterate(client, 0);
+    }
+    ck_assert_int_eq(lastValue, 8);
+    UA_Client_Subscriptions_stopPublishing(client);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+} END_TEST
+
+static size_t lastTextLength;
+
+static void textChanged(UA_UInt32 monId, UA_DataValue *value, void *context) {
+    if(value->hasValue && value->value.type == &UA_TYPES[UA_TYPES_LOCALIZEDTEXT])
+        lastTextLength = ((UA_LocalizedText*)value->value.data)->text.length;
+    notifications++;
+}
+
+START_TEST(Client_sample_detectsChangeOfUnsplittableValue) {
+    UA_Client *client = UA_Client_new(UA_ClientConfig_standard);
+    ck_assert_uint_eq(UA_Client_connect(client, ENDPOINT), UA_STATUSCODE_GOOD);
+    UA_SubscriptionSettings settings = UA_SubscriptionSettings_standard;
+    settings.requestedPublishingInterval = 10.0;
+    UA_UInt32 subId, monId;
+    ck_assert_uint_eq(UA_Client_Subscriptions_new(client, settings, &subId), UA_STATUSCODE_GOOD);
+    notifications = 0;
+    ck_assert_uint_eq(UA_Client_Subscriptions_addMonitoredItem(client, subId,
+                                                               UA_NODEID_STRING(1, "the.text"),
+                                                               UA_ATTRIBUTEID_VALUE, textChanged,
+                                                               NULL, &monId), UA_STATUSCODE_GOOD);
+    publishUntil(client, 1);
+    ck_assert_uint_eq(notifications, 1);
+
+    /* The length of the text is encoded across the end of the sampling
+     * buffer. Integers are not split between buffers. */
+    char locale[505];
+    memset(locale, 'a', 504);
+    locale[504] = 0;
+    UA_LocalizedText text = UA_LOCALIZEDTEXT(locale, "changed");
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &text, &UA_TYPES[UA_TYPES_LOCALIZEDTEXT]);
+    ck_assert_uint_eq(UA_Client_writeValueAttribute(client, UA_NODEID_STRING(1, "the.text"), &v),
+                      UA_STATUSCODE_GOOD);
+    publishUntil(client, 2);
+    ck_assert_uint_eq(notifications, 2);
+    ck_assert_uint_eq(lastTextLength, 7);
+
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+} END_TEST
+
+static UA_StatusCode transfer(UA_Client *client, UA_UInt32 subId) {
+    UA_TransferSubscriptionsRequest request;
+    UA_TransferSubscriptionsRequest_init(&request);
+    request.subscriptionIds = &subId;
+    request.subscriptionIdsSize = 1;
+    UA_TransferSubscriptionsResponse response =
+        UA_Client_Service_transferSubscriptions(client, request);
+    UA_StatusCode retval = response.responseHeader.serviceResult;
+    if(retval == UA_STATUSCODE_GOOD)
+        retval = response.resultsSize == 1 ? response.results[0].statusCode :
+            UA_STATUSCODE_BADUNEXPECTEDERROR;
+    UA_TransferSubscriptionsResponse_deleteMembers(&response);
+    return retval;
+}
+
+START_TEST(Client_transfer_onlyBetweenSameAnonymousApplication) {
+    UA_UInt32 subId, otherSubId;
+    UA_Client *client = connectClient("urn:test:client", &subId);
+    UA_Client *other = connectClient("urn:test:other", &otherSubId);
+    UA_Client *unnamed = connectClient("", &otherSubId);
+    UA_Client *same = connectClient("urn:test:client", &otherSubId);
+
+    /* The anonymous users of other applications cannot take the subscription */
+    ck_assert_uint_eq(transfer(other, subId), UA_STATUSCODE_BADUSERACCESSDENIED);
+    ck_assert_uint_eq(transfer(unnamed, subId), UA_STATUSCODE_BADUSERACCESSDENIED);
+    ck_assert_uint_eq(transfer(same, subId), UA_STATUSCODE_GOOD);
+
+    UA_Client_disconnect(same);
+    UA_Client_delete(same);
+    UA_Client_disconnect(unnamed);
+    UA_Client_delete(unnamed);
+    UA_Client_disconnect(other);
+    UA_Client_delete(other);
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+} END_TEST
+
+#endif
+
+static Suite* testSuite_ClientSubscriptions(void) {
+    Suite *s = suite_create("Client Subscriptions");
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+    TCase *tc_reconnect = tcase_create("Reconnect");
+    tcase_add_checked_fixture(tc_reconnect, setup, teardown);
+    tcase_add_test(tc_reconnect, Client_reconnect_republishesMissedMessages);
+    tcase_add_test(tc_reconnect, Client_renew_keepsOutstandingPublishRequests);
+    tcase_add_test(tc_reconnect, Client_transfer_onlyBetweenSameAnonymousApplication);
+    tcase_add_test(tc_reconnect, Client_sample_detectsChangeOfUnsplittableValue);
+    suite_add_tcase(s, tc_reconnect);
+#endif
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_ClientSubscriptions();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,106 @@
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ua_types.h"
+#include "ua_network_tcp.h"
+#include "ua_log_stdout.h"
+#include "check.h"
+
+#define SOCKETPATH "/tmp/open62541_check_network_unix"
+
+/* Binds a socket to the path. The socket is closed without removing the file
+ * unless listening is requested. */
+static int bindSocket(UA_Boolean listening) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKETPATH);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(bind(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    if(listening) {
+        ck_assert_int_eq(listen(fd, 1), 0);
+        return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+static UA_StatusCode startLayer(UA_ServerNetworkLayer *nl) {
+    *nl = UA_ServerNetworkLayerUnix(UA_ConnectionConfig_standard, SOCKETPATH);
+    return nl->start(nl, UA_Log_Stdout);
+}
+
+static void stopLayer(UA_ServerNetworkLayer *nl) {
+    UA_Job *jobs;
+    nl->stop(nl, &jobs);
+    nl->deleteMembers(nl);
+}
+
+static void deleteLayer(UA_ServerNetworkLayer *nl) {
+    nl->deleteMembers(nl);
+}
+
+static UA_Boolean isSocket(void) {
+    struct stat st;
+    return lstat(SOCKETPATH, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+START_TEST(Unix_start_replacesStaleSocket) {
+    unlink(SOCKETPATH);
+    bindSocket(false);
+    ck_assert(isSocket());
+    UA_ServerNetworkLayer nl;
+    ck_assert_uint_eq(startLayer(&nl), UA_STATUSCODE_GOOD);
+    stopLayer(&nl);
+    ck_assert_int_ne(access(SOCKETPATH, F_OK), 0);
+} END_TEST
+
+START_TEST(Unix_start_keepsOtherFiles) {
+    unlink(SOCKETPATH);
+    FILE *f = fopen(SOCKETPATH, "w");
+    ck_assert_ptr_ne(f, NULL);
+    fclose(f);
+    UA_ServerNetworkLayer nl;
+    ck_assert_uint_ne(startLayer(&nl), UA_STATUSCODE_GOOD);
+    deleteLayer(&nl);
+    ck_assert_int_eq(access(SOCKETPATH, F_OK), 0);
+    ck_assert(!isSocket());
+    unlink(SOCKETPATH);
+} END_TEST
+
+START_TEST(Unix_start_keepsRunningServer) {
+    unlink(SOCKETPATH);
+    int fd = bindSocket(true);
+    UA_ServerNetworkLayer nl;
+    ck_assert_uint_ne(startLayer(&nl), UA_STATUSCODE_GOOD);
+    deleteLayer(&nl);
+    ck_assert(isSocket());
+    close(fd);
+    unlink(SOCKETPATH);
+} END_TEST
+
+static Suite* testSuite_NetworkTCP(void) {
+    Suite *s = suite_create("Network TCP");
+    TCase *tc_unix = tcase_create("Unix");
+    tcase_add_test(tc_unix, Unix_start_replacesStaleSocket);
+    tcase_add_test(tc_unix, Unix_start_keepsOtherFiles);
+    tcase_add_test(tc_unix, Unix_start_keepsRunningServer);
+    suite_add_tcase(s, tc_unix);
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_NetworkTCP();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -4,6 +4,7 @@
 
 #include "ua_types.h"
 #include "server/ua_nodestore.h"
+#include "ua_nodeids.h"
 #include "ua_util.h"
 #include "check.h"
 
@@ -14,12 +15,12 @@
 
 int zeroCnt = 0;
 int visitCnt = 0;
-static void checkZeroVisitor(const UA_Node* node) {
+static void checkZeroVisitor(void *handle, const UA_Node* node) {
 	visitCnt++;
 	if (node == NULL) zeroCnt++;
 }
 
-static void printVisitor(const UA_Node* node) {
+static void printVisitor(void *handle, const UA_Node* node) {
 	printf("%d\n", node->nodeId.identifier.numeric);
 }
 
@@ -163,7 +164,7 @@ START_TEST(iterateOverUA_NodeStoreShallNotVisitEmptyNodes) {
 	// when
 	zeroCnt = 0;
 	visitCnt = 0;
-	UA_NodeStore_iterate(ns,checkZeroVisitor);
+	UA_NodeStore_iterate(ns,checkZeroVisitor,NULL);
 	// then
 	ck_assert_int_eq(zeroCnt, 0);
 	ck_assert_int_eq(visitCnt, 6);
@@ -201,6 +202,89 @@ START_TEST(findNodeInExpandedNamespace) {
 }
 END_TEST
 
+START_TEST(findNodesWhileGrowingAndShrinking) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+#endif
+	// given
+	/* ns0 uses the dense index, ns10 the hash-map */
+	UA_UInt16 nsIndex = (UA_UInt16)(_i == 0 ? 0 : 10);
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_Int32 i=1;
+	for (; i<=5000; i++) {
+		UA_NodeStore_insert(ns, createNode((UA_Int16)nsIndex,i));
+		/* remove every third node again */
+		if(i % 3 == 0) {
+			UA_NodeId id = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)i);
+			ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+		}
+	}
+	// when
+	zeroCnt = 0;
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns,checkZeroVisitor,NULL);
+	// then
+	ck_assert_int_eq(visitCnt, 5000 - 1666);
+	for (i=1; i<=5000; i++) {
+		UA_NodeId id = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)i);
+		const UA_Node *nr = UA_NodeStore_get(ns, &id);
+		if(i % 3 == 0)
+			ck_assert_ptr_eq(nr, NULL);
+		else
+			ck_assert_int_eq(nr->nodeId.identifier.numeric, i);
+	}
+	// when most nodes are removed again
+	for (i=1; i<4900; i++) {
+		UA_NodeId id = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)i);
+		UA_NodeStore_remove(ns, &id);
+	}
+	// then
+	for (; i<=5000; i++) {
+		UA_NodeId id = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)i);
+		ck_assert_int_eq(UA_NodeStore_get(ns, &id) != NULL, i % 3 != 0);
+	}
+	// finally
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+START_TEST(findStringNodeIdsNextToNumericNodeIds) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+#endif
+	// given
+	UA_NodeStore *ns = UA_NodeStore_new();
+	char name[16];
+	for (UA_Int32 i = 1; i <= 500; i++) {
+		UA_NodeStore_insert(ns, createNode(1, i));
+		UA_Node *n = (UA_Node *)UA_NodeStore_newVariableNode();
+		snprintf(name, 16, "node%d", i);
+		n->nodeId = UA_NODEID_STRING_ALLOC(1, name);
+		UA_NodeStore_insert(ns, n);
+	}
+	// then
+	for (UA_Int32 i = 1; i <= 500; i++) {
+		snprintf(name, 16, "node%d", i);
+		UA_NodeId sid = UA_NODEID_STRING(1, name);
+		const UA_Node *nr = UA_NodeStore_get(ns, &sid);
+		ck_assert(UA_NodeId_equal(&nr->nodeId, &sid));
+		UA_NodeId nid = UA_NODEID_NUMERIC(1, (UA_UInt32)i);
+		nr = UA_NodeStore_get(ns, &nid);
+		ck_assert(UA_NodeId_equal(&nr->nodeId, &nid));
+	}
+	UA_NodeId other = UA_NODEID_NUMERIC(2, 1);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &other), NULL);
+	// finally
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
 START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
@@ -216,7 +300,7 @@ START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
 	// when
 	zeroCnt = 0;
 	visitCnt = 0;
-	UA_NodeStore_iterate(ns,checkZeroVisitor);
+	UA_NodeStore_iterate(ns,checkZeroVisitor,NULL);
 	// then
 	ck_assert_int_eq(zeroCnt, 0);
 	ck_assert_int_eq(visitCnt, 200);
@@ -228,6 +312,38 @@ START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
 }
 END_TEST
 
+static void sumVisitor(void *handle, const UA_Node* node) {
+	*(UA_UInt64*)handle += node->nodeId.identifier.numeric;
+}
+
+START_TEST(partitionsShallVisitEveryNodeOnce) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+#endif
+	// given: dense and hashed nodes
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_UInt64 expected = 0;
+	for(UA_Int32 i = 1; i <= 300; i++) {
+		UA_NodeStore_insert(ns, createNode(0, i));
+		UA_NodeStore_insert(ns, createNode(5, i * 1000));
+		expected += (UA_UInt64)i + (UA_UInt64)i * 1000;
+	}
+	// when / then
+	size_t partitions[] = {1, 3, 16, 40};
+	for(size_t p = 0; p < sizeof(partitions) / sizeof(size_t); p++) {
+		UA_UInt64 sum = 0;
+		for(size_t i = 0; i < partitions[p]; i++)
+			UA_NodeStore_iteratePartition(ns, i, partitions[p], sumVisitor, &sum);
+		ck_assert_uint_eq(sum, expected);
+	}
+	// finally
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
 START_TEST(failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
@@ -259,6 +375,166 @@ START_TEST(failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries) {
 }
 END_TEST
 
+START_TEST(insertedNodesShallShareInternedStrings) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+#endif
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_Node* n1 = createNode(0,2253);
+	n1->browseName = UA_QUALIFIEDNAME_ALLOC(0, "Temperature");
+	UA_NodeStore_insert(ns, n1);
+	UA_Node* n2 = createNode(0,2255);
+	n2->browseName = UA_QUALIFIEDNAME_ALLOC(0, "Temperature");
+	UA_NodeStore_insert(ns, n2);
+
+	UA_NodeId in1 = UA_NODEID_NUMERIC(0, 2253);
+	UA_NodeId in2 = UA_NODEID_NUMERIC(0, 2255);
+	const UA_Node *r1 = UA_NodeStore_get(ns, &in1);
+	const UA_Node *r2 = UA_NodeStore_get(ns, &in2);
+	ck_assert_ptr_eq(r1->browseName.name.data, r2->browseName.name.data);
+
+	/* copies have their own strings and are interned when they replace the node */
+	UA_Node* n3 = UA_NodeStore_getCopy(ns, &in1);
+	ck_assert_ptr_ne(n3->browseName.name.data, r2->browseName.name.data);
+	UA_StatusCode retval = UA_NodeStore_replace(ns, n3);
+	ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+	r1 = UA_NodeStore_get(ns, &in1);
+	ck_assert_ptr_eq(r1->browseName.name.data, r2->browseName.name.data);
+
+	UA_NodeStore_remove(ns, &in2);
+	UA_String expected = UA_STRING("Temperature");
+	ck_assert(UA_String_equal(&r1->browseName.name, &expected));
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+START_TEST(referencesShallBeGroupedByTypeAndDirection) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+#endif
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_Node* n1 = createNode(0,2253);
+	UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+	UA_NodeId hasComponent = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+	UA_NodeId hasProperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+	UA_ExpandedNodeId target = UA_EXPANDEDNODEID_NUMERIC(1, 0);
+	for(UA_UInt32 i = 10; i > 0; i--) {
+		target.nodeId.identifier.numeric = i;
+		UA_Node_addReference(n1, (i % 2) ? &hasComponent : &organizes, (i % 3) == 0, &target);
+	}
+	UA_NodeStore_insert(ns, n1);
+
+	UA_NodeId in1 = UA_NODEID_NUMERIC(0, 2253);
+	const UA_Node *r1 = UA_NodeStore_get(ns, &in1);
+	ck_assert_int_eq(r1->referencesSize, 10);
+	for(size_t i = 1; i < r1->referencesSize; i++)
+		ck_assert_int_le(UA_ReferenceNode_order(&r1->references[i-1], &r1->references[i]), 0);
+
+	/* hasComponent: 1, 5, 7 forward and 3, 9 inverse */
+	size_t begin, end;
+	UA_Node_findReferences(r1, &hasComponent, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+	ck_assert_int_eq(end - begin, 3);
+	ck_assert_int_eq(r1->references[begin].targetId.nodeId.identifier.numeric, 1);
+	UA_Node_findReferences(r1, &hasComponent, UA_BROWSEDIRECTION_INVERSE, &begin, &end);
+	ck_assert_int_eq(end - begin, 2);
+	UA_Node_findReferences(r1, &hasComponent, UA_BROWSEDIRECTION_BOTH, &begin, &end);
+	ck_assert_int_eq(end - begin, 5);
+	UA_Node_findReferences(r1, &hasProperty, UA_BROWSEDIRECTION_BOTH, &begin, &end);
+	ck_assert_int_eq(end - begin, 0);
+
+	target.nodeId.identifier.numeric = 6;
+	ck_assert_int_lt(UA_Node_findReference(r1, &organizes, true, &target.nodeId), r1->referencesSize);
+	ck_assert_int_eq(UA_Node_findReference(r1, &organizes, false, &target.nodeId), r1->referencesSize);
+
+	/* edits keep the order */
+	UA_Node* n2 = UA_NodeStore_getCopy(ns, &in1);
+	UA_Node_removeReference(n2, UA_Node_findReference(n2, &organizes, true, &target.nodeId));
+	target.nodeId.identifier.numeric = 11;
+	UA_Node_addReference(n2, &hasComponent, false, &target);
+	ck_assert_int_eq(n2->referencesSize, 10);
+	for(size_t i = 1; i < n2->referencesSize; i++)
+		ck_assert_int_le(UA_ReferenceNode_order(&n2->references[i-1], &n2->references[i]), 0);
+	UA_Node_findReferences(n2, &hasComponent, UA_BROWSEDIRECTION_FORWARD, &begin, &end);
+	ck_assert_int_eq(n2->references[end-1].targetId.nodeId.identifier.numeric, 11);
+	UA_NodeStore_deleteNode(n2);
+
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+/****************/
+/* Static Nodes */
+/****************/
+
+static const UA_ObjectNode staticNode1 =
+    {.nodeId = {1, UA_NODEIDTYPE_NUMERIC, {100}}, .nodeClass = UA_NODECLASS_OBJECT,
+     .browseName = {1, {6, (UA_Byte*)"Static"}}};
+static const UA_ObjectNode staticNode2 =
+    {.nodeId = {1, UA_NODEIDTYPE_NUMERIC, {101}}, .nodeClass = UA_NODECLASS_OBJECT};
+static const UA_ObjectNode staticNode3 =
+    {.nodeId = {1, UA_NODEIDTYPE_NUMERIC, {102}}, .nodeClass = UA_NODECLASS_OBJECT};
+
+static const UA_Node * const staticNodes[] =
+    {(const UA_Node*)&staticNode1, (const UA_Node*)&staticNode2, (const UA_Node*)&staticNode3};
+static const UA_Node * const unsortedNodes[] =
+    {(const UA_Node*)&staticNode2, (const UA_Node*)&staticNode1};
+
+START_TEST(staticNodesShallBeFoundReplacedAndRemoved) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+#endif
+	UA_Byte hidden[1];
+	UA_StaticNodeTable unsorted = {unsortedNodes, 2, hidden};
+	UA_StaticNodeTable table = {staticNodes, 3, hidden};
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_Node* n1 = createNode(1,200);
+	UA_NodeStore_insert(ns, n1);
+	ck_assert_int_eq(UA_NodeStore_addStaticNodes(ns, &unsorted), UA_STATUSCODE_BADINVALIDARGUMENT);
+	ck_assert_int_eq(UA_NodeStore_addStaticNodes(ns, &table), UA_STATUSCODE_GOOD);
+
+	UA_NodeId in1 = UA_NODEID_NUMERIC(1, 100);
+	UA_NodeId in2 = UA_NODEID_NUMERIC(1, 101);
+	const UA_Node *r1 = UA_NodeStore_get(ns, &in1);
+	ck_assert_ptr_eq(r1, (const UA_Node*)&staticNode1);
+	ck_assert(UA_NodeStore_isStatic(ns, r1));
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(1,101)), UA_STATUSCODE_BADNODEIDEXISTS);
+
+	zeroCnt = 0;
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns,checkZeroVisitor,NULL);
+	ck_assert_int_eq(visitCnt, 4);
+
+	/* the replacement lives on the heap */
+	UA_Node* n2 = UA_NodeStore_getCopy(ns, &in1);
+	UA_StatusCode retval = UA_NodeStore_replace(ns, n2);
+	ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+	r1 = UA_NodeStore_get(ns, &in1);
+	ck_assert_ptr_ne(r1, (const UA_Node*)&staticNode1);
+	ck_assert(!UA_NodeStore_isStatic(ns, r1));
+	UA_String expected = UA_STRING("Static");
+	ck_assert(UA_String_equal(&r1->browseName.name, &expected));
+
+	retval = UA_NodeStore_remove(ns, &in2);
+	ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &in2), NULL);
+
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns,checkZeroVisitor,NULL);
+	ck_assert_int_eq(visitCnt, 3);
+	ck_assert_int_eq(zeroCnt, 0);
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -344,6 +620,8 @@ static Suite * namespace_suite (void) {
 	tcase_add_test (tc_find, findNodeInUA_NodeStoreWithSingleEntry);
 	tcase_add_test (tc_find, findNodeInUA_NodeStoreWithSeveralEntries);
 	tcase_add_test (tc_find, findNodeInExpandedNamespace);
+	tcase_add_loop_test (tc_find, findNodesWhileGrowingAndShrinking, 0, 2);
+	tcase_add_test (tc_find, findStringNodeIdsNextToNumericNodeIds);
 	tcase_add_test (tc_find, failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries);
 	tcase_add_test (tc_find, failToFindNodeInOtherUA_NodeStore);
 	suite_add_tcase (s, tc_find);
@@ -351,11 +629,18 @@ static Suite * namespace_suite (void) {
 	TCase *tc_replace = tcase_create("Replace");
 	tcase_add_test (tc_replace, replaceExistingNode);
 	tcase_add_test (tc_replace, replaceOldNode);
+	tcase_add_test (tc_replace, insertedNodesShallShareInternedStrings);
+	tcase_add_test (tc_replace, staticNodesShallBeFoundReplacedAndRemoved);
 	suite_add_tcase (s, tc_replace);
 
+	TCase *tc_references = tcase_create("References");
+	tcase_add_test (tc_references, referencesShallBeGroupedByTypeAndDirection);
+	suite_add_tcase (s, tc_references);
+
 	TCase* tc_iterate = tcase_create ("Iterate");
 	tcase_add_test (tc_iterate, iterateOverUA_NodeStoreShallNotVisitEmptyNodes);
 	tcase_add_test (tc_iterate, iterateOverExpandedNamespaceShallNotVisitEmptyNodes);
+	tcase_add_test (tc_iterate, partitionsShallVisitEveryNodeOnce);
 	suite_add_tcase (s, tc_iterate);
 	
 	/* TCase* tc_profile = tcase_create ("Profile"); */
@@ -4,6 +4,8 @@
 
 #include "ua_server.h"
 #include "ua_server_internal.h"
+#include "ua_services.h"
+#include "ua_types_encoding_binary.h"
 #include "ua_config_standard.h"
 #include "ua_log_stdout.h"
 #include "testing_networklayers.h"
@@ -42,15 +44,97 @@ START_TEST(processMessage) {
             UA_Server_processBinaryMessage(server, &c, &msg);
         UA_ByteString_deleteMembers(&msg);
     }
+#ifdef UA_ENABLE_SERVICE_STATISTICS
+    /* Every message sequence creates one session */
+    UA_ServiceStatistics stats;
+    UA_StatusCode retval = UA_Server_getServiceStatistics(server, &UA_TYPES[UA_TYPES_CREATESESSIONREQUEST],
+                                                          &stats);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(stats.requests, 1);
+    ck_assert_uint_eq(stats.errors, 0);
+    ck_assert_uint_gt(stats.bytesIn, 0);
+    ck_assert_uint_gt(stats.bytesOut, 0);
+#endif
     UA_Server_delete(server);
     UA_Connection_deleteMembers(&c);
 }
 END_TEST
 
+START_TEST(findServices) {
+    for(size_t i = 0; i < UA_ServicesSize; i++) {
+        if(i > 0)
+            ck_assert_uint_lt(UA_Services[i-1].requestTypeId, UA_Services[i].requestTypeId);
+        ck_assert_uint_eq(UA_Services[i].requestType->typeId.identifier.numeric,
+                         UA_Services[i].requestTypeId);
+        ck_assert_uint_eq(UA_Services_find(UA_Services[i].requestTypeId), i);
+    }
+    ck_assert_uint_eq(UA_Services_find(UA_NS0ID_OPENSECURECHANNELREQUEST), UA_ServicesSize);
+}
+END_TEST
+
+static UA_ByteString encode(const void *p, const UA_DataType *type) {
+    UA_ByteString encoded;
+    UA_ByteString_allocBuffer(&encoded, UA_calcSizeBinary((void*)(uintptr_t)p, type));
+    size_t offset = 0;
+    UA_StatusCode retval = UA_encodeBinary(p, type, NULL, NULL, &encoded, &offset);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    return encoded;
+}
+
+START_TEST(cachedDiscoveryResponses) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(UA_ServerNetworkLayer));
+    nl.discoveryUrl = UA_STRING("opc.tcp://cached:4840");
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    UA_Server *server = UA_Server_new(config);
+    UA_Server_buildDiscoveryCache(server);
+    ck_assert_uint_gt(server->encodedServers.length, 0);
+    ck_assert_ptr_ne(server->encodedEndpoints, NULL);
+
+    /* The cached servers array is the encoding of the regular response */
+    UA_FindServersRequest fsRequest;
+    UA_FindServersRequest_init(&fsRequest);
+    UA_FindServersResponse fsResponse;
+    UA_FindServersResponse_init(&fsResponse);
+    Service_FindServers(server, &adminSession, &fsRequest, &fsResponse);
+    ck_assert_uint_eq(fsResponse.serversSize, 1);
+    UA_ByteString servers = encode(fsResponse.servers, &UA_TYPES[UA_TYPES_APPLICATIONDESCRIPTION]);
+    ck_assert_uint_eq(server->encodedServers.length, servers.length + 4);
+    ck_assert(memcmp(&server->encodedServers.data[4], servers.data, servers.length) == 0);
+
+    /* The endpoint with the requested url is the url followed by the cached
+     * encoding */
+    UA_GetEndpointsRequest geRequest;
+    UA_GetEndpointsRequest_init(&geRequest);
+    geRequest.endpointUrl = UA_STRING("opc.tcp://requested:4840");
+    UA_GetEndpointsResponse geResponse;
+    UA_GetEndpointsResponse_init(&geResponse);
+    Service_GetEndpoints(server, &adminSession, &geRequest, &geResponse);
+    ck_assert_uint_eq(geResponse.endpointsSize, 1);
+    UA_ByteString endpoint = encode(&geResponse.endpoints[0], &UA_TYPES[UA_TYPES_ENDPOINTDESCRIPTION]);
+    UA_ByteString url = encode(&geRequest.endpointUrl, &UA_TYPES[UA_TYPES_STRING]);
+    ck_assert_uint_eq(endpoint.length, url.length + server->encodedEndpoints[0].length);
+    ck_assert(memcmp(endpoint.data, url.data, url.length) == 0);
+    ck_assert(memcmp(&endpoint.data[url.length], server->encodedEndpoints[0].data,
+                     server->encodedEndpoints[0].length) == 0);
+
+    UA_ByteString_deleteMembers(&servers);
+    UA_ByteString_deleteMembers(&endpoint);
+    UA_ByteString_deleteMembers(&url);
+    UA_FindServersResponse_deleteMembers(&fsResponse);
+    UA_GetEndpointsResponse_deleteMembers(&geResponse);
+    UA_Server_delete(server);
+}
+END_TEST
+
 static Suite *testSuite_binaryMessages(void) {
     Suite *s = suite_create("Test server with messages stored in text files");
     TCase *tc_messages = tcase_create("binary messages");
     tcase_add_test(tc_messages, processMessage);
+    tcase_add_test(tc_messages, findServices);
+    tcase_add_test(tc_messages, cachedDiscoveryResponses);
     suite_add_tcase(s, tc_messages);
     return s;
 }
@@ -0,0 +1,357 @@
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "ua_types.h"
+#include "ua_server.h"
+#include "ua_config_standard.h"
+#include "server/ua_nodestore.h"
+#include "server/ua_server_internal.h"
+#include "server/ua_services.h"
+#include "ua_types_encoding_binary.h"
+
+#ifdef UA_ENABLE_MULTITHREADING
+#include <urcu.h>
+#endif
+
+/* The server runs with several workers. The tests run the parallel paths on
+ * the server and compare them with the same work done on the test thread
+ * before the server starts. Without multithreading, both are sequential. */
+
+#define NODES 1000
+#define WORKERS 4
+
+static UA_Server *server;
+static UA_Boolean running;
+static pthread_t server_thread;
+
+static void *serverloop(void *_) {
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_register_thread();
+#endif
+    UA_Server_run(server, &running);
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_unregister_thread();
+#endif
+    return NULL;
+}
+
+static void setup(void) {
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_register_thread();
+#endif
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.nThreads = WORKERS;
+    config.networkLayersSize = 0;
+    server = UA_Server_new(config);
+    for(UA_Int32 i = 0; i < NODES; i++) {
+        UA_VariableAttributes attr;
+        UA_VariableAttributes_init(&attr);
+        UA_Variant_setScalar(&attr.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        attr.accessLevel = attr.userAccessLevel = 3;
+        UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, (UA_UInt32)(1000 + i)),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "node"), UA_NODEID_NULL,
+                                  attr, NULL, NULL);
+    }
+    running = false;
+}
+
+static void teardown(void) {
+    if(running) {
+        running = false;
+        pthread_join(server_thread, NULL);
+    }
+    UA_Server_delete(server);
+#ifdef UA_ENABLE_MULTITHREADING
+    rcu_unregister_thread();
+#endif
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static UA_Boolean done;
+# define SET_DONE() uatomic_set(&done, true)
+#else
+# define SET_DONE()
+#endif
+
+/* Starts the server and runs the callback in a server thread. Returns when
+ * the callback is done. Without multithreading, the callback runs right
+ * away. */
+static void runInServer(UA_ServerCallback callback, void *data) {
+#ifdef UA_ENABLE_MULTITHREADING
+    running = true;
+    pthread_create(&server_thread, NULL, serverloop, NULL);
+    usleep(100000); /* until the workers run */
+    done = false;
+#endif
+    ck_assert_uint_eq(UA_Server_dispatchCallback(server, callback, data), UA_STATUSCODE_GOOD);
+#ifdef UA_ENABLE_MULTITHREADING
+    for(size_t i = 0; i < 500 && !uatomic_read(&done); i++)
+        usleep(10000);
+    ck_assert(uatomic_read(&done));
+#endif
+}
+
+/* Runs on the test thread with the RCU lock held */
+static void runHere(UA_ServerCallback callback, void *data) {
+    UA_RCU_LOCK();
+    callback(server, data);
+    UA_RCU_UNLOCK();
+}
+
+/******************/
+/* Node Iteration */
+/******************/
+
+#define PARTITIONS 16
+
+typedef struct {
+    size_t count;
+    UA_UInt64 sum;
+} NodeSum;
+
+static void sumVisitor(void *handle, const UA_Node *node) {
+    NodeSum *ns = (NodeSum*)handle;
+    ns->count++;
+    if(node->nodeId.identifierType == UA_NODEIDTYPE_NUMERIC)
+        ns->sum += node->nodeId.identifier.numeric;
+}
+
+static void sumReducer(void *result, void *handle) {
+    NodeSum *r = (NodeSum*)result;
+    NodeSum *ns = (NodeSum*)handle;
+    r->count += ns->count;
+    r->sum += ns->sum;
+}
+
+static void sumNodesSequential(UA_Server *s, void *data) {
+    NodeSum *result = (NodeSum*)data;
+    UA_NodeStore_iteratePartition(s->nodestore, 0, 1, sumVisitor, result);
+}
+
+static void sumNodesParallel(UA_Server *s, void *data) {
+    NodeSum *result = (NodeSum*)data;
+    NodeSum partial[PARTITIONS];
+    void *handles[PARTITIONS];
+    for(size_t i = 0; i < PARTITIONS; i++) {
+        partial[i] = (NodeSum){0, 0};
+        handles[i] = &partial[i];
+    }
+    UA_StatusCode retval =
+        UA_Server_iterateNodesParallel(s, sumVisitor, handles, PARTITIONS, sumReducer, result);
+    if(retval != UA_STATUSCODE_GOOD)
+        result->count = 0;
+    SET_DONE();
+}
+
+START_TEST(Server_iterateNodesParallel_visitsEveryNodeOnce) {
+    NodeSum expected = {0, 0};
+    runHere(sumNodesSequential, &expected);
+    ck_assert_uint_ge(expected.count, NODES);
+
+    NodeSum result = {0, 0};
+    runInServer(sumNodesParallel, &result);
+    ck_assert_uint_eq(result.count, expected.count);
+    ck_assert_uint_eq(result.sum, expected.sum);
+} END_TEST
+
+/************/
+/* Services */
+/************/
+
+/* The requests have several parts of UA_SERVER_PARALLEL_PARTSIZE operations.
+ * Every third operation targets an unknown node. */
+
+static UA_NodeId requestNode(size_t i) {
+    if(i % 3 == 0)
+        return UA_NODEID_NUMERIC(1, 1);
+    return UA_NODEID_NUMERIC(1, (UA_UInt32)(1000 + i));
+}
+
+static void assertEncodedEqual(const void *p1, const void *p2, const UA_DataType *type) {
+    UA_ByteString b1, b2;
+    ck_assert_uint_eq(UA_ByteString_allocBuffer(&b1, UA_calcSizeBinary((void*)(uintptr_t)p1, type)),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_ByteString_allocBuffer(&b2, UA_calcSizeBinary((void*)(uintptr_t)p2, type)),
+                      UA_STATUSCODE_GOOD);
+    size_t o1 = 0, o2 = 0;
+    ck_assert_uint_eq(UA_encodeBinary(p1, type, NULL, NULL, &b1, &o1), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_encodeBinary(p2, type, NULL, NULL, &b2, &o2), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(o1, o2);
+    ck_assert_int_eq(memcmp(b1.data, b2.data, o1), 0);
+    UA_ByteString_deleteMembers(&b1);
+    UA_ByteString_deleteMembers(&b2);
+}
+
+typedef struct {
+    UA_ReadRequest request;
+    UA_ReadResponse response;
+} ReadCall;
+
+static void readNodes(UA_Server *s, void *data) {
+    ReadCall *call = (ReadCall*)data;
+    Service_Read(s, &adminSession, &call->request, &call->response);
+    SET_DONE();
+}
+
+static void initReadRequest(UA_ReadRequest *request) {
+    UA_ReadRequest_init(request);
+    request->nodesToReadSize = NODES;
+    request->nodesToRead = UA_Array_new(NODES, &UA_TYPES[UA_TYPES_READVALUEID]);
+    for(size_t i = 0; i < NODES; i++) {
+        request->nodesToRead[i].nodeId = requestNode(i);
+        request->nodesToRead[i].attributeId =
+            i % 2 == 0 ? UA_ATTRIBUTEID_VALUE : UA_ATTRIBUTEID_BROWSENAME;
+    }
+    request->timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+}
+
+START_TEST(Server_read_parallelEqualsSequential) {
+    ReadCall expected, result;
+    initReadRequest(&expected.request);
+    UA_ReadResponse_init(&expected.response);
+    runHere(readNodes, &expected);
+    initReadRequest(&result.request);
+    UA_ReadResponse_init(&result.response);
+    runInServer(readNodes, &result);
+
+    ck_assert_uint_eq(result.response.resultsSize, NODES);
+    assertEncodedEqual(&result.response, &expected.response, &UA_TYPES[UA_TYPES_READRESPONSE]);
+    UA_ReadRequest_deleteMembers(&expected.request);
+    UA_ReadResponse_deleteMembers(&expected.response);
+    UA_ReadRequest_deleteMembers(&result.request);
+    UA_ReadResponse_deleteMembers(&result.response);
+} END_TEST
+
+typedef struct {
+    UA_WriteRequest request;
+    UA_WriteResponse response;
+    ReadCall check; /* reads the written values back */
+} WriteCall;
+
+static void writeNodes(UA_Server *s, void *data) {
+    WriteCall *call = (WriteCall*)data;
+    Service_Write(s, &adminSession, &call->request, &call->response);
+    Service_Read(s, &adminSession, &call->check.request, &call->check.response);
+    SET_DONE();
+}
+
+static void initWriteCall(WriteCall *call, UA_Int32 factor) {
+    UA_WriteRequest_init(&call->request);
+    UA_WriteResponse_init(&call->response);
+    call->request.nodesToWriteSize = NODES;
+    call->request.nodesToWrite = UA_Array_new(NODES, &UA_TYPES[UA_TYPES_WRITEVALUE]);
+    for(size_t i = 0; i < NODES; i++) {
+        UA_WriteValue *wv = &call->request.nodesToWrite[i];
+        wv->nodeId = requestNode(i);
+        wv->attributeId = UA_ATTRIBUTEID_VALUE;
+        wv->value.hasValue = true;
+        UA_Int32 value = (UA_Int32)i * factor;
+        UA_Variant_setScalarCopy(&wv->value.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    }
+    initReadRequest(&call->check.request);
+    for(size_t i = 0; i < NODES; i++)
+        call->check.request.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_ReadResponse_init(&call->check.response);
+}
+
+static void deleteWriteCall(WriteCall *call) {
+    UA_WriteRequest_deleteMembers(&call->request);
+    UA_WriteResponse_deleteMembers(&call->response);
+    UA_ReadRequest_deleteMembers(&call->check.request);
+    UA_ReadResponse_deleteMembers(&call->check.response);
+}
+
+START_TEST(Server_write_parallelEqualsSequential) {
+    WriteCall expected, result;
+    initWriteCall(&expected, 2);
+    runHere(writeNodes, &expected);
+    initWriteCall(&result, 3);
+    runInServer(writeNodes, &result);
+
+    ck_assert_uint_eq(result.response.resultsSize, NODES);
+    assertEncodedEqual(&result.response, &expected.response, &UA_TYPES[UA_TYPES_WRITERESPONSE]);
+    ck_assert_uint_eq(result.check.response.resultsSize, NODES);
+    for(size_t i = 0; i < NODES; i++) {
+        UA_DataValue *dv = &result.check.response.results[i];
+        if(i % 3 == 0) {
+            ck_assert_uint_eq(dv->status, UA_STATUSCODE_BADNODEIDUNKNOWN);
+            continue;
+        }
+        ck_assert(dv->hasValue);
+        ck_assert_int_eq(*(UA_Int32*)dv->value.data, (UA_Int32)i * 3);
+    }
+    deleteWriteCall(&expected);
+    deleteWriteCall(&result);
+} END_TEST
+
+typedef struct {
+    UA_BrowseRequest request;
+    UA_BrowseResponse response;
+} BrowseCall;
+
+static void browseNodes(UA_Server *s, void *data) {
+    BrowseCall *call = (BrowseCall*)data;
+    Service_Browse(s, &adminSession, &call->request, &call->response);
+    SET_DONE();
+}
+
+static void initBrowseCall(BrowseCall *call) {
+    UA_BrowseRequest_init(&call->request);
+    UA_BrowseResponse_init(&call->response);
+    call->request.nodesToBrowseSize = NODES;
+    call->request.nodesToBrowse = UA_Array_new(NODES, &UA_TYPES[UA_TYPES_BROWSEDESCRIPTION]);
+    for(size_t i = 0; i < NODES; i++) {
+        UA_BrowseDescription *bd = &call->request.nodesToBrowse[i];
+        bd->nodeId = i == 0 ? UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER) : requestNode(i);
+        bd->browseDirection = UA_BROWSEDIRECTION_BOTH;
+        bd->includeSubtypes = true;
+        bd->resultMask = UA_BROWSERESULTMASK_ALL;
+    }
+}
+
+START_TEST(Server_browse_parallelEqualsSequential) {
+    BrowseCall expected, result;
+    initBrowseCall(&expected);
+    runHere(browseNodes, &expected);
+    initBrowseCall(&result);
+    runInServer(browseNodes, &result);
+
+    ck_assert_uint_eq(result.response.resultsSize, NODES);
+    ck_assert_uint_ge(result.response.results[0].referencesSize, NODES);
+    assertEncodedEqual(&result.response, &expected.response, &UA_TYPES[UA_TYPES_BROWSERESPONSE]);
+    UA_BrowseRequest_deleteMembers(&expected.request);
+    UA_BrowseResponse_deleteMembers(&expected.response);
+    UA_BrowseRequest_deleteMembers(&result.request);
+    UA_BrowseResponse_deleteMembers(&result.response);
+} END_TEST
+
+static Suite* testSuite_ServerParallel(void) {
+    Suite *s = suite_create("Server Parallel");
+    TCase *tc_nodes = tcase_create("Node Iteration");
+    tcase_add_checked_fixture(tc_nodes, setup, teardown);
+    tcase_add_test(tc_nodes, Server_iterateNodesParallel_visitsEveryNodeOnce);
+    suite_add_tcase(s, tc_nodes);
+    TCase *tc_services = tcase_create("Services");
+    tcase_add_checked_fixture(tc_services, setup, teardown);
+    tcase_add_test(tc_services, Server_read_parallelEqualsSequential);
+    tcase_add_test(tc_services, Server_write_parallelEqualsSequential);
+    tcase_add_test(tc_services, Server_browse_parallelEqualsSequential);
+    suite_add_tcase(s, tc_services);
+    return s;
+}
+
+int main(void) {
+    Suite *s = testSuite_ServerParallel();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "ua_types.h"
 #include "ua_config_standard.h"
+#include "ua_allocator_slab.h"
+#ifdef UA_ENABLE_STATIC_ALLOCATOR
+#include "ua_allocator_static.h"
+#endif
 #include "check.h"
 
 START_TEST(Server_addNamespace_ShallWork)
@@ -20,10 +25,569 @@ START_TEST(Server_addNamespace_ShallWork)
 }
 END_TEST
 
+static void countCalls(UA_Server *server, void *data) {
+    (*(size_t*)data)++;
+}
+
+START_TEST(Server_readValue_returnsPrivateCopy)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 array[3] = {1, 2, 3};
+    UA_Variant_setArray(&attr.value, array, 3, &UA_TYPES[UA_TYPES_INT32]);
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "array");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "array"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The node value is shared. Writing into the read value leaves it unchanged. */
+    UA_Variant value;
+    retval = UA_Server_readValue(server, nodeId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(value.storageType, UA_VARIANT_DATA);
+    ((UA_Int32*)value.data)[0] = 42;
+    UA_Variant_deleteMembers(&value);
+    retval = UA_Server_readValue(server, nodeId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(((UA_Int32*)value.data)[0], 1);
+    UA_Variant_deleteMembers(&value);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Server_repeatedJobs_addRemove)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    size_t calls = 0;
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = countCalls, .data = &calls} };
+    UA_Guid ids[500];
+    for(size_t i = 0; i < 500; i++)
+        ck_assert_uint_eq(UA_Server_addRepeatedJob(server, job, 10000, &ids[i]), UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < 500; i += 2)
+        ck_assert_uint_eq(UA_Server_removeRepeatedJob(server, ids[i]), UA_STATUSCODE_GOOD);
+
+    /* All remaining jobs are due in the first iteration and then rescheduled */
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(calls, 250);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(calls, 250);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+struct SelfRemoving {
+    UA_Guid id;
+    size_t calls;
+};
+
+static void removeSelf(UA_Server *server, void *data) {
+    struct SelfRemoving *sr = (struct SelfRemoving*)data;
+    sr->calls++;
+    UA_Server_removeRepeatedJob(server, sr->id);
+}
+
+START_TEST(Server_repeatedJobs_removeDuringExecution)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    struct SelfRemoving sr = {.calls = 0};
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = removeSelf, .data = &sr} };
+    UA_Server_addRepeatedJob(server, job, 5, &sr.id);
+    /* Iterate long enough for the job to become due several times */
+    UA_DateTime end = UA_DateTime_nowMonotonic() + (20 * UA_MSEC_TO_DATETIME);
+    while(UA_DateTime_nowMonotonic() < end)
+        UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(sr.calls, 1);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+#ifndef UA_ENABLE_MULTITHREADING
+START_TEST(Server_repeatedJobs_microseconds)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    size_t calls = 0;
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = countCalls, .data = &calls} };
+    ck_assert_uint_eq(UA_Server_addRepeatedJobUsec(server, job, 49, NULL),
+                      UA_STATUSCODE_BADINTERNALERROR);
+    ck_assert_uint_eq(UA_Server_addRepeatedJobUsec(server, job, 200, NULL), UA_STATUSCODE_GOOD);
+    /* Due 100 times in 20ms. Leave room for a loaded machine. */
+    UA_DateTime end = UA_DateTime_nowMonotonic() + (20 * UA_MSEC_TO_DATETIME);
+    while(UA_DateTime_nowMonotonic() < end)
+        UA_Server_run_iterate(server, false);
+    ck_assert_uint_ge(calls, 20);
+    ck_assert_uint_le(calls, 101);
+
+    UA_Server_delete(server);
+}
+END_TEST
+#endif
+
+#if defined(UA_ENABLE_SCHEDULER_STATISTICS) && !defined(UA_ENABLE_MULTITHREADING)
+START_TEST(Server_schedulerStatistics_countJobs)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    size_t calls = 0;
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = countCalls, .data = &calls} };
+    for(size_t i = 0; i < 10; i++)
+        UA_Server_addRepeatedJob(server, job, 10000, NULL);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(calls, 10);
+
+    UA_SchedulerStatistics stats;
+    ck_assert_uint_eq(UA_Server_getSchedulerStatistics(server, &stats), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(stats.iterations, 1);
+    /* the repeated cleanup job of the server runs as well */
+    ck_assert_uint_ge(stats.mainLoop.jobsCount[UA_JOBTYPE_METHODCALL], 10);
+    UA_UInt64 histogramCount = 0;
+    for(size_t i = 0; i < UA_JOBSTATISTICS_BUCKETS; i++)
+        histogramCount += stats.mainLoop.runTimeHistogram[i];
+    ck_assert_uint_eq(histogramCount, stats.mainLoop.jobsCount[UA_JOBTYPE_METHODCALL]);
+    ck_assert_uint_eq(stats.queueDepth, 0);
+
+    UA_JobStatistics workerStats;
+    ck_assert_uint_eq(UA_Server_getWorkerStatistics(server, 0, &workerStats),
+                      UA_STATUSCODE_BADINVALIDARGUMENT);
+
+    UA_Server_delete(server);
+}
+END_TEST
+#endif
+
+START_TEST(Server_slabAllocator_accountsNodes)
+{
+    UA_Allocator *slab = UA_Allocator_Slab_new();
+    ck_assert_ptr_ne(slab, NULL);
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.allocator = slab;
+    UA_Server *server = UA_Server_new(config);
+    size_t nodeBytes = UA_Allocator_Slab_bytesInUse(slab, UA_MEMCATEGORY_NODESTORE);
+    ck_assert_uint_gt(nodeBytes, 0);
+
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 value = 42;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, 5000),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "slab"), UA_NODEID_NULL,
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_gt(UA_Allocator_Slab_bytesInUse(slab, UA_MEMCATEGORY_NODESTORE), nodeBytes);
+
+    /* A repeated job is cut from the slab as well */
+    size_t jobBytes = UA_Allocator_Slab_bytesInUse(slab, UA_MEMCATEGORY_JOBS);
+    size_t calls = 0;
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = countCalls, .data = &calls} };
+    UA_Guid id;
+    UA_Server_addRepeatedJob(server, job, 10, &id);
+    ck_assert_uint_gt(UA_Allocator_Slab_bytesInUse(slab, UA_MEMCATEGORY_JOBS), jobBytes);
+
+    UA_Server_delete(server);
+    for(size_t i = 0; i < UA_MEMCATEGORY_COUNT; i++)
+        ck_assert_uint_eq(UA_Allocator_Slab_bytesInUse(slab, (UA_MemCategory)i), 0);
+    UA_Allocator_Slab_delete(slab);
+}
+END_TEST
+
+#ifdef UA_ENABLE_STATIC_ALLOCATOR
+START_TEST(Server_staticAllocator_enforcesCapacity)
+{
+    UA_Allocator_Static_reset();
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.allocator = UA_Allocator_Static_get();
+    UA_Server *server = UA_Server_new(config);
+    ck_assert_uint_gt(UA_Allocator_Static_bytesInUse(UA_MEMCATEGORY_NODESTORE), 0);
+    ck_assert_uint_eq(UA_Allocator_Static_failures(UA_MEMCATEGORY_NODESTORE), 0);
+
+    /* The job pool runs out after a fixed number of jobs */
+    size_t calls = 0;
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.method = countCalls, .data = &calls} };
+    size_t added = 0;
+    while(UA_Server_addRepeatedJob(server, job, 10000, NULL) == UA_STATUSCODE_GOOD)
+        added++;
+    ck_assert_uint_gt(added, 0);
+    ck_assert_uint_eq(UA_Allocator_Static_failures(UA_MEMCATEGORY_JOBS), 1);
+    ck_assert_uint_eq(UA_Server_addRepeatedJob(server, job, 10000, NULL),
+                      UA_STATUSCODE_BADOUTOFMEMORY);
+
+    UA_Server_delete(server);
+    for(size_t i = 0; i < UA_MEMCATEGORY_COUNT; i++)
+        ck_assert_uint_eq(UA_Allocator_Static_bytesInUse((UA_MemCategory)i), 0);
+
+    /* The freed objects are reused */
+    server = UA_Server_new(config);
+    size_t readded = 0;
+    while(UA_Server_addRepeatedJob(server, job, 10000, NULL) == UA_STATUSCODE_GOOD)
+        readded++;
+    ck_assert_uint_eq(readded, added);
+    UA_Server_delete(server);
+    UA_Allocator_Static_reset();
+}
+END_TEST
+#endif
+
+START_TEST(Server_snapshot_restoresNodes)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+    UA_UInt16 ns = UA_Server_addNamespace(server, "http://snapshot");
+
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 answer = 42;
+    UA_Variant_setScalar(&attr.value, &answer, &UA_TYPES[UA_TYPES_INT32]);
+    attr.displayName = UA_LOCALIZEDTEXT("en_US", "the answer");
+    const UA_NodeId nodeId = UA_NODEID_STRING(ns, "the.answer");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(ns, "the answer"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_ByteString snapshot;
+    retval = UA_Server_saveSnapshot(server, &snapshot);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+
+    server = UA_Server_new(config);
+    retval = UA_Server_loadSnapshot(server, &snapshot);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_ByteString_deleteMembers(&snapshot);
+
+    UA_Variant value;
+    retval = UA_Server_readValue(server, nodeId, &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(*(UA_Int32*)value.data, 42);
+    UA_Variant_deleteMembers(&value);
+    UA_QualifiedName name;
+    retval = UA_Server_readBrowseName(server, nodeId, &name);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(name.namespaceIndex, ns);
+    UA_QualifiedName_deleteMembers(&name);
+
+    /* The data sources of namespace zero remain */
+    retval = UA_Server_readValue(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_SERVERSTATUS_CURRENTTIME),
+                                 &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(value.type, &UA_TYPES[UA_TYPES_DATETIME]);
+    UA_Variant_deleteMembers(&value);
+
+    /* The NamespaceArray contains the restored namespace */
+    retval = UA_Server_readValue(server, UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_NAMESPACEARRAY), &value);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(value.arrayLength, (size_t)ns + 1);
+    UA_String uri = UA_STRING("http://snapshot");
+    ck_assert(UA_String_equal(&((UA_String*)value.data)[ns], &uri));
+    UA_Variant_deleteMembers(&value);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Server_snapshot_rejectsOtherNamespaces)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+    UA_Server_addNamespace(server, "http://snapshot");
+    UA_ByteString snapshot;
+    ck_assert_uint_eq(UA_Server_saveSnapshot(server, &snapshot), UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+
+    server = UA_Server_new(config);
+    UA_Server_addNamespace(server, "http://other");
+    ck_assert_uint_eq(UA_Server_loadSnapshot(server, &snapshot), UA_STATUSCODE_BADINVALIDARGUMENT);
+    snapshot.data[0] ^= 0xff;
+    ck_assert_uint_eq(UA_Server_loadSnapshot(server, &snapshot), UA_STATUSCODE_BADDECODINGERROR);
+    UA_ByteString_deleteMembers(&snapshot);
+    UA_Server_delete(server);
+}
+END_TEST
+
+#ifdef UA_ENABLE_METHODCALLS
+static UA_StatusCode
+countMethodCalls(void *methodHandle, const UA_NodeId objectId, size_t inputSize,
+                 const UA_Variant *input, size_t outputSize, UA_Variant *output) {
+    (*(size_t*)methodHandle)++;
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(Server_call_updatesCachedArguments)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    UA_Argument inputArgument;
+    UA_Argument_init(&inputArgument);
+    inputArgument.dataType = UA_TYPES[UA_TYPES_INT32].typeId;
+    inputArgument.valueRank = -1;
+    UA_MethodAttributes attr;
+    UA_MethodAttributes_init(&attr);
+    attr.executable = true;
+    size_t calls = 0;
+    const UA_NodeId methodId = UA_NODEID_NUMERIC(1, 62541);
+    UA_StatusCode retval =
+        UA_Server_addMethodNode(server, methodId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                UA_QUALIFIEDNAME(1, "count"), attr, countMethodCalls, &calls,
+                                1, &inputArgument, 0, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Int32 number = 42;
+    UA_Variant input;
+    UA_Variant_setScalar(&input, &number, &UA_TYPES[UA_TYPES_INT32]);
+    UA_CallMethodRequest request;
+    UA_CallMethodRequest_init(&request);
+    request.objectId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    request.methodId = methodId;
+    request.inputArgumentsSize = 1;
+    request.inputArguments = &input;
+
+    /* The second call uses the cached definitions */
+    for(size_t i = 0; i < 2; i++) {
+        UA_CallMethodResult result = UA_Server_call(server, &request);
+        ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+        UA_CallMethodResult_deleteMembers(&result);
+    }
+    ck_assert_uint_eq(calls, 2);
+
+    /* Change the definition to a string argument */
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = methodId;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_BROWSENAME;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    UA_NodeId inputArgumentsId = UA_NODEID_NULL;
+    UA_String inputArgumentsName = UA_STRING("InputArguments");
+    for(size_t i = 0; i < br.referencesSize; i++) {
+        if(UA_String_equal(&br.references[i].browseName.name, &inputArgumentsName))
+            inputArgumentsId = br.references[i].nodeId.nodeId;
+    }
+    ck_assert(!UA_NodeId_isNull(&inputArgumentsId));
+    inputArgument.dataType = UA_TYPES[UA_TYPES_STRING].typeId;
+    UA_Variant definition;
+    UA_Variant_setArray(&definition, &inputArgument, 1, &UA_TYPES[UA_TYPES_ARGUMENT]);
+    retval = UA_Server_writeValue(server, inputArgumentsId, definition);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_BrowseResult_deleteMembers(&br);
+
+    UA_CallMethodResult result = UA_Server_call(server, &request);
+    ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_BADINVALIDARGUMENT);
+    UA_CallMethodResult_deleteMembers(&result);
+    UA_String text = UA_STRING("42");
+    UA_Variant_setScalar(&input, &text, &UA_TYPES[UA_TYPES_STRING]);
+    result = UA_Server_call(server, &request);
+    ck_assert_uint_eq(result.statusCode, UA_STATUSCODE_GOOD);
+    UA_CallMethodResult_deleteMembers(&result);
+    ck_assert_uint_eq(calls, 3);
+
+    UA_Server_delete(server);
+}
+END_TEST
+#endif
+
+#ifndef UA_ENABLE_MULTITHREADING
+typedef struct {
+    size_t messages;
+    UA_ByteString last;
+    UA_Boolean deleted;
+} CapturingTransport;
+
+static UA_StatusCode captureMessage(void *handle, const UA_ByteString *message) {
+    CapturingTransport *t = handle;
+    t->messages++;
+    UA_ByteString_deleteMembers(&t->last);
+    return UA_ByteString_copy(message, &t->last);
+}
+
+static void deleteCapturingTransport(void *handle) {
+    CapturingTransport *t = handle;
+    t->deleted = true;
+}
+
+START_TEST(Server_valuePublisher_sendsValues)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 answer = 42;
+    UA_Variant_setScalar(&attr.value, &answer, &UA_TYPES[UA_TYPES_INT32]);
+    attr.displayName = UA_LOCALIZEDTEXT("en_US", "the answer");
+    const UA_NodeId nodes[2] = {UA_NODEID_STRING(1, "the.answer"), UA_NODEID_NUMERIC(1, 4711)};
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodes[0], UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "the answer"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    CapturingTransport t = {0, {0, NULL}, false};
+    UA_ValuePublisherTransport transport = {&t, captureMessage, deleteCapturingTransport, 1024};
+    UA_Guid guid;
+    retval = UA_Server_addValuePublisher(server, 7, nodes, 2, 1000,
+                                         UA_TIMESTAMPSTORETURN_NEITHER, transport, &guid);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(t.messages, 1);
+
+    UA_ValuePublisherMessage msg;
+    retval = UA_ValuePublisherMessage_decode(&t.last, &msg);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(msg.publisherId, 7);
+    ck_assert_uint_eq(msg.sequenceNumber, 0);
+    ck_assert_uint_eq(msg.valuesSize, 2);
+    ck_assert(msg.values[0].hasValue);
+    ck_assert_int_eq(*(UA_Int32*)msg.values[0].value.data, 42);
+    /* the unknown node is reported in place */
+    ck_assert_uint_eq(msg.values[1].status, UA_STATUSCODE_BADNODEIDUNKNOWN);
+    UA_ValuePublisherMessage_deleteMembers(&msg);
+
+    ck_assert_uint_eq(UA_Server_removeValuePublisher(server, guid), UA_STATUSCODE_GOOD);
+    ck_assert(t.deleted);
+    ck_assert_uint_eq(UA_Server_removeValuePublisher(server, guid), UA_STATUSCODE_BADNOTFOUND);
+    UA_ByteString_deleteMembers(&t.last);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Server_valuePublisher_skipsOversizedMessages)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+
+    CapturingTransport t = {0, {0, NULL}, false};
+    UA_ValuePublisherTransport transport = {&t, captureMessage, deleteCapturingTransport, 32};
+    const UA_NodeId node = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER_NAMESPACEARRAY);
+    UA_StatusCode retval = UA_Server_addValuePublisher(server, 1, &node, 1, 1000,
+                                                       UA_TIMESTAMPSTORETURN_NEITHER, transport, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Server_run_iterate(server, false);
+    ck_assert_uint_eq(t.messages, 0);
+
+    UA_Server_delete(server);
+    ck_assert(t.deleted);
+}
+END_TEST
+#endif
+
+struct AccessingThread {
+    UA_Server *server;
+    volatile UA_Boolean done;
+    UA_StatusCode retval;
+};
+
+static void checkBorrowed(void *context, const UA_NodeId *nodeId, const UA_Variant *value) {
+    *(UA_Int32*)context = *(UA_Int32*)value->data;
+}
+
+/* Every write replaces the node. The replaced nodes are retired from a thread
+ * that is not known to the server. */
+static void *writeWithAccess(void *data) {
+    struct AccessingThread *t = data;
+    const UA_NodeId node = UA_NODEID_STRING(1, "accessed");
+    for(UA_Int32 i = 0; i < 200; i++) {
+        UA_Variant value;
+        UA_Variant_setScalar(&value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        UA_Server_beginAccess(t->server);
+        t->retval |= UA_Server_writeValue(t->server, node, value);
+        UA_Variant out;
+        t->retval |= UA_Server_readValue(t->server, node, &out);
+        if(t->retval == UA_STATUSCODE_GOOD && *(UA_Int32*)out.data != i)
+            t->retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+        UA_Variant_deleteMembers(&out);
+        UA_Server_endAccess(t->server);
+        /* Borrowed reads enter the access section themselves */
+        UA_Int32 borrowed = -1;
+        t->retval |= UA_Server_readValueBorrowed(t->server, node, checkBorrowed, &borrowed);
+        if(t->retval == UA_STATUSCODE_GOOD && borrowed != i)
+            t->retval = UA_STATUSCODE_BADUNEXPECTEDERROR;
+    }
+    t->done = true;
+    return NULL;
+}
+
+START_TEST(Server_applicationThread_accessesNodes)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    UA_Server *server = UA_Server_new(config);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 initial = -1;
+    UA_Variant_setScalar(&attr.value, &initial, &UA_TYPES[UA_TYPES_INT32]);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "accessed"),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "accessed"), UA_NODEID_NULL,
+                                  attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The main loop reclaims the replaced nodes while the thread writes */
+    UA_Server_run_startup(server);
+    struct AccessingThread t = {server, false, UA_STATUSCODE_GOOD};
+    pthread_t thr;
+    pthread_create(&thr, NULL, writeWithAccess, &t);
+    while(!t.done)
+        UA_Server_run_iterate(server, false);
+    pthread_join(thr, NULL);
+    UA_Server_run_shutdown(server);
+    ck_assert_uint_eq(t.retval, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+}
+END_TEST
+
 static Suite* testSuite_ServerUserspace(void) {
 	Suite *s = suite_create("ServerUserspace");
 	TCase *tc_core = tcase_create("Core");
 	tcase_add_test(tc_core, Server_addNamespace_ShallWork);
+	tcase_add_test(tc_core, Server_readValue_returnsPrivateCopy);
+	tcase_add_test(tc_core, Server_repeatedJobs_addRemove);
+	tcase_add_test(tc_core, Server_applicationThread_accessesNodes);
+	tcase_add_test(tc_core, Server_repeatedJobs_removeDuringExecution);
+#ifndef UA_ENABLE_MULTITHREADING
+	tcase_add_test(tc_core, Server_repeatedJobs_microseconds);
+#endif
+	tcase_add_test(tc_core, Server_slabAllocator_accountsNodes);
+#ifdef UA_ENABLE_STATIC_ALLOCATOR
+	tcase_add_test(tc_core, Server_staticAllocator_enforcesCapacity);
+#endif
+	tcase_add_test(tc_core, Server_snapshot_restoresNodes);
+	tcase_add_test(tc_core, Server_snapshot_rejectsOtherNamespaces);
+#ifndef UA_ENABLE_MULTITHREADING
+	tcase_add_test(tc_core, Server_valuePublisher_sendsValues);
+	tcase_add_test(tc_core, Server_valuePublisher_skipsOversizedMessages);
+#endif
+#ifdef UA_ENABLE_METHODCALLS
+	tcase_add_test(tc_core, Server_call_updatesCachedArguments);
+#endif
+#if defined(UA_ENABLE_SCHEDULER_STATISTICS) && !defined(UA_ENABLE_MULTITHREADING)
+	tcase_add_test(tc_core, Server_schedulerStatistics_countJobs);
+#endif
 
 	suite_add_tcase(s,tc_core);
 	return s;
@@ -10,6 +10,7 @@
 #include "ua_types.h"
 #include "ua_config_standard.h"
 #include "server/ua_server_internal.h"
+#include "ua_types_encoding_binary.h"
 
 #ifdef UA_ENABLE_MULTITHREADING
 #include <pthread.h>
@@ -159,6 +160,25 @@ START_TEST(ReadSingleAttributeValueWithoutTimestamp) {
     UA_DataValue_deleteMembers(&resp);
 } END_TEST
 
+START_TEST(ReadSingleAttributeValueWithTimestamps) {
+    UA_Server *server = makeTestSequence();
+    server->now = 1234567;
+    UA_DataValue resp;
+    UA_DataValue_init(&resp);
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "the.answer");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_BOTH, &rvi, &resp);
+    ck_assert(resp.hasServerTimestamp);
+    ck_assert(resp.hasSourceTimestamp);
+    /* the time of the main loop iteration is used */
+    ck_assert_int_eq(resp.serverTimestamp, 1234567);
+    ck_assert_int_eq(resp.sourceTimestamp, 1234567);
+    UA_DataValue_deleteMembers(&resp);
+    UA_Server_delete(server);
+} END_TEST
+
 START_TEST(ReadSingleAttributeValueRangeWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
     UA_DataValue resp;
@@ -853,6 +873,570 @@ START_TEST(WriteSingleAttributeEventNotifier) {
     UA_Server_delete(server);
 } END_TEST
 
+/* Large requests are split into parts. Every result lands in its own slot. */
+START_TEST(ReadLargeRequest) {
+    UA_Server *server = makeTestSequence();
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.nodesToReadSize = 1000;
+    rReq.nodesToRead = UA_Array_new(rReq.nodesToReadSize, &UA_TYPES[UA_TYPES_READVALUEID]);
+    for(size_t i = 0; i < rReq.nodesToReadSize; i++) {
+        if(i % 3 == 0)
+            rReq.nodesToRead[i].nodeId = UA_NODEID_STRING_ALLOC(1, "no.such.node");
+        else
+            rReq.nodesToRead[i].nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+        rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    rReq.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    UA_ReadResponse rResp;
+    UA_ReadResponse_init(&rResp);
+    Service_Read(server, &adminSession, &rReq, &rResp);
+    ck_assert_uint_eq(rResp.resultsSize, rReq.nodesToReadSize);
+    for(size_t i = 0; i < rResp.resultsSize; i++) {
+        if(i % 3 == 0) {
+            ck_assert_uint_eq(rResp.results[i].status, UA_STATUSCODE_BADNODEIDUNKNOWN);
+        } else {
+            ck_assert(rResp.results[i].hasValue);
+            ck_assert_int_eq(42, *(UA_Int32*)rResp.results[i].value.data);
+        }
+    }
+    UA_ReadRequest_deleteMembers(&rReq);
+    UA_ReadResponse_deleteMembers(&rResp);
+    UA_Server_delete(server);
+} END_TEST
+
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+/* Every external nodestore records the indices of its last call */
+typedef struct {
+    size_t calls;
+    UA_UInt32 indices[8];
+    UA_UInt32 indicesSize;
+} ExternalStore;
+
+static UA_Int32
+readExternal(void *ensHandle, const UA_RequestHeader *requestHeader, UA_ReadValueId *readValueIds,
+             UA_UInt32 *indices, UA_UInt32 indicesSize, UA_DataValue *readNodesResults,
+             UA_Boolean timeStampToReturn, UA_DiagnosticInfo *diagnosticInfos) {
+    ExternalStore *store = ensHandle;
+    store->calls++;
+    store->indicesSize = indicesSize;
+    for(UA_UInt32 i = 0; i < indicesSize; i++) {
+        store->indices[i] = indices[i];
+        readNodesResults[indices[i]].hasStatus = true;
+        readNodesResults[indices[i]].status = UA_STATUSCODE_GOODNODATA;
+    }
+    return 0;
+}
+
+static UA_Int32 deleteExternal(void *ensHandle) {
+    return 0;
+}
+
+/* The items of an external namespace are read with a single call */
+START_TEST(ReadExternalNamespaces) {
+    UA_Server *server = makeTestSequence();
+    ExternalStore stores[2];
+    memset(stores, 0, sizeof(stores));
+    UA_UInt16 nsIndex[2];
+    for(size_t i = 0; i < 2; i++) {
+        UA_ExternalNodeStore ens;
+        memset(&ens, 0, sizeof(ens));
+        ens.ensHandle = &stores[i];
+        ens.readNodes = readExternal;
+        ens.destroy = deleteExternal;
+        UA_String url = i == 0 ? UA_STRING("urn:external:a") : UA_STRING("urn:external:b");
+        UA_StatusCode retval = UA_Server_addExternalNamespace(server, &url, &ens, &nsIndex[i]);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+
+    UA_ReadValueId items[5];
+    for(size_t i = 0; i < 5; i++) {
+        UA_ReadValueId_init(&items[i]);
+        items[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    items[0].nodeId = UA_NODEID_NUMERIC(nsIndex[1], 1);
+    items[1].nodeId = UA_NODEID_STRING(1, "the.answer");
+    items[2].nodeId = UA_NODEID_NUMERIC(nsIndex[0], 2);
+    items[3].nodeId = UA_NODEID_NUMERIC(nsIndex[1], 3);
+    items[4].nodeId = UA_NODEID_NUMERIC(nsIndex[1], 4);
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.nodesToRead = items;
+    rReq.nodesToReadSize = 5;
+    rReq.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    UA_ReadResponse rResp;
+    UA_ReadResponse_init(&rResp);
+    Service_Read(server, &adminSession, &rReq, &rResp);
+
+    ck_assert_uint_eq(stores[0].calls, 1);
+    ck_assert_uint_eq(stores[0].indicesSize, 1);
+    ck_assert_uint_eq(stores[0].indices[0], 2);
+    ck_assert_uint_eq(stores[1].calls, 1);
+    ck_assert_uint_eq(stores[1].indicesSize, 3);
+    ck_assert_uint_eq(stores[1].indices[0], 0);
+    ck_assert_uint_eq(stores[1].indices[1], 3);
+    ck_assert_uint_eq(stores[1].indices[2], 4);
+    ck_assert_uint_eq(rResp.results[0].status, UA_STATUSCODE_GOODNODATA);
+    ck_assert(rResp.results[1].hasValue);
+    ck_assert_int_eq(42, *(UA_Int32*)rResp.results[1].value.data);
+    UA_ReadResponse_deleteMembers(&rResp);
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
+/* The asynchronous data source keeps the handle of the last started read */
+static UA_AsyncRead *pendingRead;
+
+static UA_StatusCode
+readAsyncValue(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+               const UA_NumericRange *range, UA_AsyncRead *pending) {
+    pendingRead = pending;
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t finishedBatches;
+
+static void finishBatch(UA_Server *server, UA_AsyncReadBatch *batch) {
+    finishedBatches++;
+}
+
+START_TEST(ReadAsyncDataSource) {
+    UA_Server *server = makeTestSequence();
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US","fieldbus");
+    UA_DataSource asyncDataSource = (UA_DataSource) {
+        .handle = NULL, .read = NULL, .write = NULL, .readAsync = readAsyncValue};
+    UA_Server_addDataSourceVariableNode(server, UA_NODEID_STRING(1, "fieldbus"),
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                        UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                        UA_QUALIFIEDNAME(1, "fieldbus"),
+                                        UA_NODEID_NULL, vattr, asyncDataSource, NULL);
+
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "fieldbus");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+
+    /* Without a batch, the blocking read is required */
+    UA_DataValue resp;
+    UA_DataValue_init(&resp);
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &resp);
+    ck_assert(resp.hasStatus);
+    ck_assert_uint_eq(resp.status, UA_STATUSCODE_BADINTERNALERROR);
+    UA_DataValue_deleteMembers(&resp);
+
+    /* The batch is finished when the read has completed */
+    UA_AsyncReadBatch batch;
+    UA_AsyncReadBatch_init(&batch, finishBatch);
+    finishedBatches = 0;
+    pendingRead = NULL;
+    UA_DataValue_init(&resp);
+    Service_Read_singleAsync(server, &adminSession, UA_TIMESTAMPSTORETURN_SERVER, &rvi, &batch, &resp);
+    ck_assert_ptr_ne(pendingRead, NULL);
+    UA_AsyncReadBatch_release(server, &batch);
+    ck_assert_uint_eq(finishedBatches, 0);
+
+    UA_Int32 fieldValue = 23;
+    UA_DataValue value;
+    UA_DataValue_init(&value);
+    value.hasValue = true;
+    UA_Variant_setScalar(&value.value, &fieldValue, &UA_TYPES[UA_TYPES_INT32]);
+    UA_Server_completeAsyncRead(server, pendingRead, &value);
+    ck_assert_uint_eq(finishedBatches, 1);
+    ck_assert(resp.hasValue);
+    ck_assert(resp.hasServerTimestamp);
+    ck_assert_int_eq(23, *(UA_Int32*)resp.value.data);
+
+    UA_DataValue_deleteMembers(&resp);
+    UA_Server_delete(server);
+} END_TEST
+
+/* The batched data source returns the index of the node in the batch */
+static size_t batchCalls;
+
+static UA_StatusCode
+readBatchValues(void *handle, const UA_NodeId *nodeids, size_t nodeidsSize,
+                UA_Boolean sourceTimeStamp, UA_DataValue *values) {
+    batchCalls++;
+    for(size_t i = 0; i < nodeidsSize; i++) {
+        UA_Int32 index = (UA_Int32)i;
+        UA_Variant_setScalarCopy(&values[i].value, &index, &UA_TYPES[UA_TYPES_INT32]);
+        values[i].hasValue = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(ReadBatchedDataSource) {
+    UA_Server *server = makeTestSequence();
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US","device");
+    UA_DataSource batchDataSource = (UA_DataSource) {
+        .handle = NULL, .read = NULL, .write = NULL, .readBatch = readBatchValues};
+    for(UA_UInt32 i = 0; i < 3; i++)
+        UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 5000 + i),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "device"),
+                                            UA_NODEID_NULL, vattr, batchDataSource, NULL);
+
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.nodesToReadSize = 4;
+    rReq.nodesToRead = UA_Array_new(rReq.nodesToReadSize, &UA_TYPES[UA_TYPES_READVALUEID]);
+    rReq.nodesToRead[0].nodeId = UA_NODEID_NUMERIC(1, 5002);
+    rReq.nodesToRead[1].nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+    rReq.nodesToRead[2].nodeId = UA_NODEID_NUMERIC(1, 5000);
+    rReq.nodesToRead[3].nodeId = UA_NODEID_NUMERIC(1, 5001);
+    for(size_t i = 0; i < rReq.nodesToReadSize; i++)
+        rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    rReq.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+
+    /* All nodes of the data source are read in one call */
+    batchCalls = 0;
+    UA_ReadResponse rResp;
+    UA_ReadResponse_init(&rResp);
+    Service_Read(server, &adminSession, &rReq, &rResp);
+    ck_assert_uint_eq(batchCalls, 1);
+    ck_assert_uint_eq(rResp.resultsSize, 4);
+    ck_assert_int_eq(42, *(UA_Int32*)rResp.results[1].value.data);
+    UA_Int32 indexSum = 0;
+    for(size_t i = 0; i < rResp.resultsSize; i++) {
+        ck_assert(rResp.results[i].hasValue);
+        if(i != 1)
+            indexSum += *(UA_Int32*)rResp.results[i].value.data;
+    }
+    ck_assert_int_eq(indexSum, 0 + 1 + 2);
+
+    UA_ReadRequest_deleteMembers(&rReq);
+    UA_ReadResponse_deleteMembers(&rResp);
+    UA_Server_delete(server);
+} END_TEST
+
+static size_t otherBatchCalls;
+
+static UA_StatusCode
+readOtherBatchValues(void *handle, const UA_NodeId *nodeids, size_t nodeidsSize,
+                     UA_Boolean sourceTimeStamp, UA_DataValue *values) {
+    otherBatchCalls++;
+    for(size_t i = 0; i < nodeidsSize; i++) {
+        UA_Int32 index = (UA_Int32)i;
+        UA_Variant_setScalarCopy(&values[i].value, &index, &UA_TYPES[UA_TYPES_INT32]);
+        values[i].hasValue = true;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(ReadBatchedDataSource_GroupsByCallback) {
+    UA_Server *server = makeTestSequence();
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US","device");
+    /* the data sources share the handle */
+    UA_DataSource batchDataSource = (UA_DataSource) {
+        .handle = NULL, .read = NULL, .write = NULL, .readBatch = readBatchValues};
+    UA_DataSource otherDataSource = (UA_DataSource) {
+        .handle = NULL, .read = NULL, .write = NULL, .readBatch = readOtherBatchValues};
+    for(UA_UInt32 i = 0; i < 4; i++)
+        UA_Server_addDataSourceVariableNode(server, UA_NODEID_NUMERIC(1, 5000 + i),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "device"), UA_NODEID_NULL, vattr,
+                                            (i % 2 == 0) ? batchDataSource : otherDataSource, NULL);
+
+    /* the nodes of the data sources alternate in the request */
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.nodesToReadSize = 4;
+    rReq.nodesToRead = UA_Array_new(rReq.nodesToReadSize, &UA_TYPES[UA_TYPES_READVALUEID]);
+    for(size_t i = 0; i < rReq.nodesToReadSize; i++) {
+        rReq.nodesToRead[i].nodeId = UA_NODEID_NUMERIC(1, 5000 + (UA_UInt32)i);
+        rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+    }
+    rReq.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+
+    /* every data source is read in one call */
+    batchCalls = 0;
+    otherBatchCalls = 0;
+    UA_ReadResponse rResp;
+    UA_ReadResponse_init(&rResp);
+    Service_Read(server, &adminSession, &rReq, &rResp);
+    ck_assert_uint_eq(batchCalls, 1);
+    ck_assert_uint_eq(otherBatchCalls, 1);
+    ck_assert_uint_eq(rResp.resultsSize, 4);
+    UA_Int32 indexSum = 0;
+    for(size_t i = 0; i < rResp.resultsSize; i++) {
+        ck_assert(rResp.results[i].hasValue);
+        indexSum += *(UA_Int32*)rResp.results[i].value.data;
+    }
+    ck_assert_int_eq(indexSum, (0 + 1) + (0 + 1));
+
+    UA_ReadRequest_deleteMembers(&rReq);
+    UA_ReadResponse_deleteMembers(&rResp);
+    UA_Server_delete(server);
+} END_TEST
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+static const UA_NodeStatistics *
+findNodeStatistics(const UA_NodeStatistics *stats, size_t statsSize, UA_NodeId nodeId) {
+    for(size_t i = 0; i < statsSize; i++) {
+        if(UA_NodeId_equal(&stats[i].nodeId, &nodeId))
+            return &stats[i];
+    }
+    return NULL;
+}
+
+#endif
+
+/* The direct read sends the response over the channel of the session. The
+ * connection keeps the last sent chunk. */
+static UA_ByteString sentChunk;
+
+static UA_StatusCode
+keepGetSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static UA_StatusCode
+keepSend(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(&sentChunk);
+    sentChunk = *buf;
+    UA_ByteString_init(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+START_TEST(ReadDirect) {
+    UA_Server *server = makeTestSequence();
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.localConf = UA_ConnectionConfig_standard;
+    connection.remoteConf = UA_ConnectionConfig_standard;
+    connection.getSendBuffer = keepGetSendBuffer;
+    connection.send = keepSend;
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.connection = &connection;
+    UA_Session session = adminSession;
+    session.channel = &channel;
+
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.requestHeader.requestHandle = 7;
+    rReq.nodesToReadSize = 2;
+    rReq.nodesToRead = UA_Array_new(rReq.nodesToReadSize, &UA_TYPES[UA_TYPES_READVALUEID]);
+    rReq.nodesToRead[0].nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+    rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_VALUE;
+    rReq.nodesToRead[1].nodeId = UA_NODEID_STRING_ALLOC(1, "cpu.temperature");
+    rReq.nodesToRead[1].attributeId = UA_ATTRIBUTEID_VALUE;
+    rReq.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+
+    /* DataSources are not read directly */
+    ck_assert(!Service_Read_direct(server, &session, &rReq, 1));
+    ck_assert_ptr_eq(sentChunk.data, NULL);
+
+    rReq.nodesToReadSize = 1;
+    ck_assert(Service_Read_direct(server, &session, &rReq, 1));
+    ck_assert_ptr_ne(sentChunk.data, NULL);
+
+    /* Skip the message and security headers */
+    size_t offset = 24;
+    UA_NodeId responseType;
+    UA_StatusCode retval = UA_decodeBinary(&sentChunk, &offset, &responseType, &UA_TYPES[UA_TYPES_NODEID]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(responseType.identifier.numeric,
+                      UA_NS0ID_READRESPONSE + UA_ENCODINGOFFSET_BINARY);
+    UA_ReadResponse rResp;
+    retval = UA_decodeBinary(&sentChunk, &offset, &rResp, &UA_TYPES[UA_TYPES_READRESPONSE]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(offset, sentChunk.length);
+    ck_assert_uint_eq(rResp.responseHeader.requestHandle, 7);
+    ck_assert_uint_eq(rResp.resultsSize, 1);
+    ck_assert(rResp.results[0].hasValue);
+    ck_assert(rResp.results[0].hasSourceTimestamp);
+    ck_assert(!rResp.results[0].hasServerTimestamp);
+    ck_assert_ptr_eq(rResp.results[0].value.type, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_int_eq(42, *(UA_Int32*)rResp.results[0].value.data);
+    ck_assert_uint_eq(rResp.diagnosticInfosSize, 0);
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+    /* Only the direct read is counted */
+    UA_NodeStatistics *stats;
+    size_t statsSize;
+    ck_assert_uint_eq(UA_Server_getHottestNodes(server, 100000, &stats, &statsSize),
+                      UA_STATUSCODE_GOOD);
+    const UA_NodeStatistics *answerStats =
+        findNodeStatistics(stats, statsSize, UA_NODEID_STRING(1, "the.answer"));
+    ck_assert_ptr_ne(answerStats, NULL);
+    ck_assert_uint_eq(answerStats->reads, 1);
+    ck_assert_ptr_eq(findNodeStatistics(stats, statsSize, UA_NODEID_STRING(1, "cpu.temperature")), NULL);
+    UA_NodeStatistics_deleteArray(stats, statsSize);
+#endif
+
+    rReq.nodesToReadSize = 2;
+    UA_ReadRequest_deleteMembers(&rReq);
+    UA_ReadResponse_deleteMembers(&rResp);
+    UA_ByteString_deleteMembers(&sentChunk);
+    UA_Server_delete(server);
+} END_TEST
+
+/* A process image as written by a PLC runtime into shared memory */
+static struct {
+    volatile UA_UInt32 sequence;
+    UA_Double temperatures[4];
+    volatile UA_DateTime timestamp;
+} processImage;
+
+START_TEST(ReadValueMemory) {
+    UA_Server *server = makeTestSequence();
+    UA_ValueMemory memory = {&processImage.sequence, &UA_TYPES[UA_TYPES_DOUBLE],
+                             processImage.temperatures, 4, &processImage.timestamp};
+    UA_StatusCode retval =
+        UA_Server_setVariableNode_valueMemory(server, UA_NODEID_STRING(1, "the.answer"), memory);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Updated without calling into the server */
+    UA_ValueMemory_beginWrite(&processImage.sequence);
+    for(size_t i = 0; i < 4; i++)
+        processImage.temperatures[i] = 20.5 + (UA_Double)i;
+    processImage.timestamp = 1234;
+    UA_ValueMemory_endWrite(&processImage.sequence);
+
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.nodeId = UA_NODEID_STRING(1, "the.answer");
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_DataValue resp;
+    UA_DataValue_init(&resp);
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_SOURCE, &rvi, &resp);
+    ck_assert(resp.hasValue);
+    ck_assert_ptr_eq(resp.value.type, &UA_TYPES[UA_TYPES_DOUBLE]);
+    ck_assert_uint_eq(resp.value.arrayLength, 4);
+    ck_assert(((UA_Double*)resp.value.data)[3] == 23.5);
+    ck_assert(resp.hasSourceTimestamp);
+    ck_assert_int_eq(resp.sourceTimestamp, 1234);
+    UA_DataValue_deleteMembers(&resp);
+
+    /* The snapshot is taken only when the writer has finished */
+    UA_ValueMemory_beginWrite(&processImage.sequence);
+    UA_DataValue_init(&resp);
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &resp);
+    ck_assert(resp.hasStatus);
+    ck_assert_uint_eq(resp.status, UA_STATUSCODE_BADRESOURCEUNAVAILABLE);
+    UA_DataValue_deleteMembers(&resp);
+    UA_ValueMemory_endWrite(&processImage.sequence);
+
+    /* Index range and data type */
+    rvi.indexRange = UA_STRING("1:2");
+    UA_DataValue_init(&resp);
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &resp);
+    ck_assert_uint_eq(resp.value.arrayLength, 2);
+    ck_assert(((UA_Double*)resp.value.data)[0] == 21.5);
+    UA_DataValue_deleteMembers(&resp);
+    rvi.indexRange = UA_STRING_NULL;
+    rvi.attributeId = UA_ATTRIBUTEID_DATATYPE;
+    UA_DataValue_init(&resp);
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &resp);
+    ck_assert(UA_NodeId_equal((UA_NodeId*)resp.value.data, &UA_TYPES[UA_TYPES_DOUBLE].typeId));
+    UA_DataValue_deleteMembers(&resp);
+
+    /* The memory is not written over the server */
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Double value = 1.0;
+    UA_Variant_setScalar(&wValue.value.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = UA_NODEID_STRING(1, "the.answer");
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue),
+                      UA_STATUSCODE_BADWRITENOTSUPPORTED);
+
+    /* Bound memory is read directly */
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.localConf = UA_ConnectionConfig_standard;
+    connection.remoteConf = UA_ConnectionConfig_standard;
+    connection.getSendBuffer = keepGetSendBuffer;
+    connection.send = keepSend;
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.connection = &connection;
+    UA_Session session = adminSession;
+    session.channel = &channel;
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.nodesToReadSize = 1;
+    rReq.nodesToRead = &rvi;
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    ck_assert(Service_Read_direct(server, &session, &rReq, 1));
+    size_t offset = 24;
+    UA_NodeId responseType;
+    retval = UA_decodeBinary(&sentChunk, &offset, &responseType, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_ReadResponse rResp;
+    retval |= UA_decodeBinary(&sentChunk, &offset, &rResp, &UA_TYPES[UA_TYPES_READRESPONSE]);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(rResp.resultsSize, 1);
+    ck_assert_uint_eq(rResp.results[0].value.arrayLength, 4);
+    ck_assert(((UA_Double*)rResp.results[0].value.data)[0] == 20.5);
+    UA_ReadResponse_deleteMembers(&rResp);
+    UA_ByteString_deleteMembers(&sentChunk);
+    UA_Server_delete(server);
+} END_TEST
+
+typedef struct {
+    size_t calls;
+    const void *data;
+    UA_Double first;
+} BorrowedRead;
+
+static void recordBorrowedValue(void *context, const UA_NodeId *nodeId, const UA_Variant *value) {
+    BorrowedRead *r = context;
+    r->calls++;
+    r->data = value->data;
+    if(value->type == &UA_TYPES[UA_TYPES_DOUBLE] && value->arrayLength > 0)
+        r->first = *(UA_Double*)value->data;
+}
+
+START_TEST(ReadValueBorrowed) {
+    UA_Server *server = makeTestSequence();
+
+    /* The value is handed out in place */
+    BorrowedRead r = {0, NULL, 0.0};
+    UA_NodeId id = UA_NODEID_STRING(1, "the.answer");
+    UA_StatusCode retval = UA_Server_readValueBorrowed(server, id, recordBorrowedValue, &r);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(r.calls, 1);
+    const UA_VariableNode *vn = (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &id);
+    UA_Variant value;
+    UA_VariableNode_getValue(vn, &value);
+    ck_assert_ptr_eq(r.data, value.data);
+
+    /* Bound memory is read into a snapshot */
+    static UA_UInt32 sequence = 0;
+    static UA_Double image[2] = {18.5, 19.5};
+    UA_ValueMemory memory = {&sequence, &UA_TYPES[UA_TYPES_DOUBLE], image, 2, NULL};
+    retval = UA_Server_setVariableNode_valueMemory(server, id, memory);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_readValueBorrowed(server, id, recordBorrowedValue, &r);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(r.calls, 2);
+    ck_assert(r.first == 18.5);
+    ck_assert_ptr_ne(r.data, image);
+
+    /* Errors do not call back */
+    retval = UA_Server_readValueBorrowed(server, UA_NODEID_STRING(1, "cpu.temperature"),
+                                         recordBorrowedValue, &r);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADINTERNALERROR);
+    retval = UA_Server_readValueBorrowed(server, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                         recordBorrowedValue, &r);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADATTRIBUTEIDINVALID);
+    retval = UA_Server_readValueBorrowed(server, UA_NODEID_NUMERIC(1, 4711),
+                                         recordBorrowedValue, &r);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_BADNODEIDUNKNOWN);
+    ck_assert_uint_eq(r.calls, 2);
+    UA_Server_delete(server);
+} END_TEST
+
 START_TEST(WriteSingleAttributeValue) {
     UA_Server *server = makeTestSequence();
     UA_WriteValue wValue;
@@ -878,6 +1462,197 @@ START_TEST(WriteSingleAttributeValue) {
     UA_Server_delete(server);
 } END_TEST
 
+START_TEST(WriteSingleAttributeValueInPlace) {
+    UA_Server *server = makeTestSequence();
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "the.answer");
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &nodeId);
+    UA_Node *copy = UA_NodeStore_getCopy(server->nodestore, &nodeId);
+    ck_assert_ptr_ne(copy, NULL);
+
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 myInteger = 20;
+    UA_Variant_setScalar(&wValue.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = nodeId;
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The node was not replaced. But the copy cannot overwrite the new value. */
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &nodeId), node);
+    ck_assert_int_eq(UA_NodeStore_replace(server->nodestore, copy), UA_STATUSCODE_BADINTERNALERROR);
+
+    UA_Variant value;
+    UA_VariableNode_getValue((const UA_VariableNode*)node, &value);
+    ck_assert_int_eq(20, *(UA_Int32*)value.data);
+
+    /* Writing the wrong type leaves the value unchanged */
+    UA_Double myDouble = 1.0;
+    UA_Variant_setScalar(&wValue.value.value, &myDouble, &UA_TYPES[UA_TYPES_DOUBLE]);
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADTYPEMISMATCH);
+    UA_VariableNode_getValue((const UA_VariableNode*)node, &value);
+    ck_assert_int_eq(20, *(UA_Int32*)value.data);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(WriteSingleAttributeValueRange) {
+    UA_Server *server = makeTestSequence();
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "myarray");
+    const UA_VariableNode *node =
+        (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &nodeId);
+    UA_Node *copy = UA_NodeStore_getCopy(server->nodestore, &nodeId);
+    ck_assert_ptr_ne(copy, NULL);
+
+    /* A reader holds the current value */
+    UA_Variant held;
+    UA_Variant_copy(&node->value.variant.value, &held);
+
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 row[2] = {10, 11};
+    UA_Variant_setArray(&wValue.value.value, row, 2, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = nodeId;
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    wValue.indexRange = UA_STRING("1,0:1");
+    UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The node was not replaced and the held value is unchanged */
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &nodeId), (const UA_Node*)node);
+    ck_assert_int_eq(UA_NodeStore_replace(server->nodestore, copy), UA_STATUSCODE_BADINTERNALERROR);
+    UA_Int32 *data = (UA_Int32*)node->value.variant.value.data;
+    ck_assert_int_eq(data[3], 10);
+    ck_assert_int_eq(data[4], 11);
+    ck_assert_int_eq(data[5], 6);
+    ck_assert_int_eq(((UA_Int32*)held.data)[3], 4);
+    ck_assert_int_eq(node->value.variant.value.arrayDimensionsSize, 2);
+    UA_Variant_deleteMembers(&held);
+
+#ifndef UA_ENABLE_MULTITHREADING
+    /* Without other references, the range is written into the current data */
+    UA_Int32 element = 12;
+    UA_Variant_setArray(&wValue.value.value, &element, 1, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.indexRange = UA_STRING("2,2");
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(node->value.variant.value.data, data);
+    ck_assert_int_eq(data[8], 12);
+#endif
+
+    /* An invalid range leaves the value unchanged */
+    wValue.indexRange = UA_STRING("3,0");
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADINDEXRANGENODATA);
+    data = (UA_Int32*)node->value.variant.value.data;
+    ck_assert_int_eq(data[3], 10);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(WriteSingleAttributeValueRangeChunks) {
+    UA_Server *server = makeTestSequence();
+    /* A 100x100 matrix of doubles in chunks of 512 elements */
+    UA_Double *matrix = UA_Array_new(10000, &UA_TYPES[UA_TYPES_DOUBLE]);
+    for(size_t i = 0; i < 10000; i++)
+        matrix[i] = (UA_Double)i;
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Variant_setArray(&vattr.value, matrix, 10000, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_Int32 dims[2] = {100, 100};
+    vattr.value.arrayDimensions = dims;
+    vattr.value.arrayDimensionsSize = 2;
+    vattr.displayName = UA_LOCALIZEDTEXT("locale","matrix");
+    UA_NodeId nodeId = UA_NODEID_STRING(1, "matrix");
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "matrix"), UA_NODEID_NULL, vattr, NULL, NULL);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_Array_delete(matrix, 10000, &UA_TYPES[UA_TYPES_DOUBLE]);
+    const UA_VariableNode *node =
+        (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &nodeId);
+
+    /* A reader holds the current value */
+    UA_Variant value;
+    UA_VariableNode_getValue(node, &value);
+    UA_Variant held;
+    UA_Variant_copy(&value, &held);
+    const UA_Double *orig = (const UA_Double*)held.data;
+
+    /* Write row 10. The elements 1000 to 1099 are in the chunks 1 and 2. */
+    UA_Double row[100];
+    for(size_t i = 0; i < 100; i++)
+        row[i] = -1.0;
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Variant_setArray(&wValue.value.value, row, 100, &UA_TYPES[UA_TYPES_DOUBLE]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = nodeId;
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    wValue.indexRange = UA_STRING("10,0:99");
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* Only the touched chunks were copied. The others point into the data
+       that the reader holds. */
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &nodeId), (const UA_Node*)node);
+    const UA_ValueChunks *chunks = node->valueChunks;
+    ck_assert_ptr_ne(chunks, NULL);
+    ck_assert_ptr_eq(node->value.variant.value.data, NULL);
+    ck_assert_int_eq(node->value.variant.value.arrayDimensionsSize, 2);
+    for(size_t i = 0; i < 20; i++) {
+        if(i == 1 || i == 2)
+            ck_assert_ptr_ne(UA_ValueChunks_getChunk(chunks, i), &orig[i * 512]);
+        else
+            ck_assert_ptr_eq(UA_ValueChunks_getChunk(chunks, i), &orig[i * 512]);
+    }
+    ck_assert_ptr_eq(UA_ValueChunks_getChunk(chunks, 20), NULL);
+    const void *chunk1 = UA_ValueChunks_getChunk(chunks, 1);
+
+    /* The next write shares the unchanged chunks with the previous value */
+    UA_Double element = -2.0;
+    UA_Variant_setArray(&wValue.value.value, &element, 1, &UA_TYPES[UA_TYPES_DOUBLE]);
+    wValue.indexRange = UA_STRING("50,0");
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    chunks = node->valueChunks;
+    ck_assert_ptr_eq(UA_ValueChunks_getChunk(chunks, 1), chunk1);
+    ck_assert_ptr_ne(UA_ValueChunks_getChunk(chunks, 9), &orig[9 * 512]);
+    ck_assert_ptr_eq(UA_ValueChunks_getChunk(chunks, 10), &orig[10 * 512]);
+
+    /* Readers get the array in one piece. The held value is unchanged. */
+    UA_VariableNode_getValue(node, &value);
+    ck_assert_int_eq(value.arrayLength, 10000);
+    const UA_Double *data = (const UA_Double*)value.data;
+    ck_assert(data[999] == 999.0);
+    ck_assert(data[1000] == -1.0);
+    ck_assert(data[1099] == -1.0);
+    ck_assert(data[1100] == 1100.0);
+    ck_assert(data[5000] == -2.0);
+    ck_assert(orig[1000] == 1000.0);
+    ck_assert(orig[5000] == 5000.0);
+    UA_Variant_deleteMembers(&held);
+
+    /* An invalid range leaves the value unchanged */
+    wValue.indexRange = UA_STRING("100,0");
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADINDEXRANGENODATA);
+    ck_assert_ptr_eq(node->valueChunks, chunks);
+
+    /* Writing the entire value replaces the chunks */
+    UA_Double small[2] = {1.0, 2.0};
+    UA_Variant_setArray(&wValue.value.value, small, 2, &UA_TYPES[UA_TYPES_DOUBLE]);
+    wValue.indexRange = UA_STRING_NULL;
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(node->valueChunks, NULL);
+    UA_VariableNode_getValue(node, &value);
+    ck_assert_int_eq(value.arrayLength, 2);
+    UA_Server_delete(server);
+} END_TEST
+
 START_TEST(WriteSingleAttributeDataType) {
     UA_Server *server = makeTestSequence();
     UA_WriteValue wValue;
@@ -1036,11 +1811,333 @@ START_TEST(numericRange) {
     UA_free(range.dimensions);
 } END_TEST
 
+#ifdef UA_ENABLE_HISTORIZING
+#define HISTORY_START ((UA_DateTime)1000 * UA_MSEC_TO_DATETIME)
+
+/* Writes n values with source timestamps at a jittered 100ms interval */
+static void writeHistory(UA_Server *server, const UA_NodeId nodeId, size_t n) {
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    wValue.nodeId = nodeId;
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    wValue.value.hasValue = true;
+    wValue.value.hasSourceTimestamp = true;
+    for(size_t i = 0; i < n; i++) {
+        UA_Double value = 20.0 + (UA_Double)(i % 50) * 0.25;
+        UA_Variant_setScalar(&wValue.value.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+        wValue.value.sourceTimestamp = HISTORY_START + (UA_DateTime)i * 100 * UA_MSEC_TO_DATETIME + (i % 7);
+        ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue), UA_STATUSCODE_GOOD);
+    }
+}
+
+static UA_Server *makeHistorySequence(size_t maxBytes) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.maxHistoryBytesPerNode = maxBytes;
+    UA_Server *server = UA_Server_new(config);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Double value = 0.0;
+    UA_Variant_setScalar(&vattr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US","temperature");
+    vattr.historizing = true;
+    UA_Server_addVariableNode(server, UA_NODEID_STRING(1, "history"),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                              UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                              UA_QUALIFIEDNAME(1, "temperature"),
+                              UA_NODEID_NULL, vattr, NULL, NULL);
+    return server;
+}
+
+static void
+readHistory(UA_Server *server, UA_DateTime start, UA_DateTime end, UA_UInt32 numValues,
+            const UA_ByteString *continuationPoint, UA_HistoryReadResponse *response) {
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.startTime = start;
+    details.endTime = end;
+    details.numValuesPerNode = numValues;
+    UA_HistoryReadValueId id;
+    UA_HistoryReadValueId_init(&id);
+    id.nodeId = UA_NODEID_STRING(1, "history");
+    if(continuationPoint)
+        id.continuationPoint = *continuationPoint;
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    request.historyReadDetails.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    request.historyReadDetails.content.decoded.type = &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS];
+    request.historyReadDetails.content.decoded.data = &details;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_SOURCE;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &id;
+    UA_HistoryReadResponse_init(response);
+    Service_HistoryRead(server, &adminSession, &request, response);
+    ck_assert_uint_eq(response->responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response->resultsSize, 1);
+}
+
+static const UA_HistoryData *historyData(const UA_HistoryReadResponse *response) {
+    ck_assert_ptr_eq(response->results[0].historyData.content.decoded.type,
+                     &UA_TYPES[UA_TYPES_HISTORYDATA]);
+    return response->results[0].historyData.content.decoded.data;
+}
+
+START_TEST(HistoryReadRawValues) {
+    UA_Server *server = makeHistorySequence(0);
+    writeHistory(server, UA_NODEID_STRING(1, "history"), 5000);
+
+    /* The values are decoded from several chunks as they were written */
+    UA_HistoryReadResponse response;
+    readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 0, NULL, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.results[0].continuationPoint.length, 0);
+    const UA_HistoryData *data = historyData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 5000);
+    for(size_t i = 0; i < data->dataValuesSize; i++) {
+        const UA_DataValue *dv = &data->dataValues[i];
+        ck_assert(dv->hasValue && dv->hasSourceTimestamp && !dv->hasServerTimestamp);
+        ck_assert_ptr_eq(dv->value.type, &UA_TYPES[UA_TYPES_DOUBLE]);
+        ck_assert(*(UA_Double*)dv->value.data == 20.0 + (UA_Double)(i % 50) * 0.25);
+        ck_assert_int_eq(dv->sourceTimestamp,
+                         HISTORY_START + (UA_DateTime)i * 100 * UA_MSEC_TO_DATETIME + (UA_DateTime)(i % 7));
+    }
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* A start time after the end time reads backwards */
+    UA_DateTime t10 = HISTORY_START + 1000 * UA_MSEC_TO_DATETIME;
+    UA_DateTime t20 = HISTORY_START + 2000 * UA_MSEC_TO_DATETIME;
+    readHistory(server, t20 + 10, t10, 0, NULL, &response);
+    data = historyData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 11);
+    ck_assert_int_eq(data->dataValues[0].sourceTimestamp, t20 + 20 % 7);
+    ck_assert_int_eq(data->dataValues[10].sourceTimestamp, t10 + 10 % 7);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Without a start time, the newest values are read backwards */
+    readHistory(server, 0, t20 + 10, 3, NULL, &response);
+    data = historyData(&response);
+    ck_assert_uint_eq(data->dataValuesSize, 3);
+    ck_assert_int_eq(data->dataValues[2].sourceTimestamp,
+                     HISTORY_START + 1800 * UA_MSEC_TO_DATETIME + 18 % 7);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Nothing in the range */
+    readHistory(server, 1, 2, 0, NULL, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOODNODATA);
+    UA_HistoryReadResponse_deleteMembers(&response);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(HistoryReadContinuationPoints) {
+    UA_Server *server = makeHistorySequence(0);
+    writeHistory(server, UA_NODEID_STRING(1, "history"), 1000);
+
+    /* Two values with the timestamp of the page boundary */
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    wValue.nodeId = UA_NODEID_STRING(1, "history");
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    wValue.value.hasValue = true;
+    wValue.value.hasSourceTimestamp = true;
+    wValue.value.sourceTimestamp = HISTORY_START + 1000 * 100 * UA_MSEC_TO_DATETIME;
+    for(UA_Double v = 1.0; v <= 3.0; v += 1.0) {
+        UA_Variant_setScalar(&wValue.value.value, &v, &UA_TYPES[UA_TYPES_DOUBLE]);
+        ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue), UA_STATUSCODE_GOOD);
+    }
+
+    /* Older values are not recorded */
+    wValue.value.sourceTimestamp = HISTORY_START;
+    ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue), UA_STATUSCODE_GOOD);
+
+    /* Page through all values. Pages end between the values with the same
+     * timestamp. */
+    UA_ByteString cp = UA_BYTESTRING_NULL;
+    size_t total = 0;
+    UA_DateTime last = 0;
+    do {
+        UA_HistoryReadResponse response;
+        readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 167,
+                    cp.length > 0 ? &cp : NULL, &response);
+        UA_ByteString_deleteMembers(&cp);
+        ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+        const UA_HistoryData *data = historyData(&response);
+        ck_assert(data->dataValuesSize <= 167);
+        for(size_t i = 0; i < data->dataValuesSize; i++) {
+            ck_assert_int_ge(data->dataValues[i].sourceTimestamp, last);
+            last = data->dataValues[i].sourceTimestamp;
+            if(total >= 1000)
+                ck_assert(*(UA_Double*)data->dataValues[i].value.data == (UA_Double)(total - 999));
+            total++;
+        }
+        cp = response.results[0].continuationPoint;
+        UA_ByteString_init(&response.results[0].continuationPoint);
+        UA_HistoryReadResponse_deleteMembers(&response);
+    } while(cp.length > 0);
+    ck_assert_uint_eq(total, 1003);
+
+    /* Invalid continuation point */
+    UA_ByteString invalid = UA_BYTESTRING("xyz");
+    UA_HistoryReadResponse response;
+    readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 10, &invalid, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADCONTINUATIONPOINTINVALID);
+    UA_HistoryReadResponse_deleteMembers(&response);
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(HistoryLimitAndNodes) {
+    /* The oldest values are dropped beyond 8kB */
+    UA_Server *server = makeHistorySequence(8 * 1024);
+    writeHistory(server, UA_NODEID_STRING(1, "history"), 20000);
+    UA_HistoryReadResponse response;
+    readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 0, NULL, &response);
+    const UA_HistoryData *data = historyData(&response);
+    ck_assert_uint_gt(data->dataValuesSize, 1000);
+    ck_assert_uint_lt(data->dataValuesSize, 20000);
+    ck_assert_int_eq(data->dataValues[data->dataValuesSize - 1].sourceTimestamp,
+                     HISTORY_START + (UA_DateTime)19999 * 100 * UA_MSEC_TO_DATETIME + 19999 % 7);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Removing the Historizing attribute drops the history */
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Boolean historizing = false;
+    UA_Variant_setScalar(&wValue.value.value, &historizing, &UA_TYPES[UA_TYPES_BOOLEAN]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = UA_NODEID_STRING(1, "history");
+    wValue.attributeId = UA_ATTRIBUTEID_HISTORIZING;
+    ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue), UA_STATUSCODE_GOOD);
+    readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 0, NULL, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Recorded again from the next write on */
+    historizing = true;
+    ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue), UA_STATUSCODE_GOOD);
+    writeHistory(server, UA_NODEID_STRING(1, "history"), 10);
+    readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 0, NULL, &response);
+    ck_assert_uint_eq(historyData(&response)->dataValuesSize, 10);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Deleted nodes are unknown */
+    UA_Server_deleteNode(server, UA_NODEID_STRING(1, "history"), true);
+    readHistory(server, HISTORY_START, HISTORY_START + 3600 * UA_SEC_TO_DATETIME, 0, NULL, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADNODEIDUNKNOWN);
+    UA_HistoryReadResponse_deleteMembers(&response);
+
+    /* Only raw values with timestamps */
+    UA_ReadRawModifiedDetails details;
+    UA_ReadRawModifiedDetails_init(&details);
+    details.isReadModified = true;
+    UA_HistoryReadValueId id;
+    UA_HistoryReadValueId_init(&id);
+    UA_HistoryReadRequest request;
+    UA_HistoryReadRequest_init(&request);
+    request.historyReadDetails.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    request.historyReadDetails.content.decoded.type = &UA_TYPES[UA_TYPES_READRAWMODIFIEDDETAILS];
+    request.historyReadDetails.content.decoded.data = &details;
+    request.nodesToReadSize = 1;
+    request.nodesToRead = &id;
+    UA_HistoryReadResponse_init(&response);
+    Service_HistoryRead(server, &adminSession, &request, &response);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_BADHISTORYOPERATIONUNSUPPORTED);
+    UA_HistoryReadResponse_deleteMembers(&response);
+    details.isReadModified = false;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_NEITHER;
+    UA_HistoryReadResponse_init(&response);
+    Service_HistoryRead(server, &adminSession, &request, &response);
+    ck_assert_uint_eq(response.responseHeader.serviceResult, UA_STATUSCODE_BADTIMESTAMPSTORETURNINVALID);
+    UA_HistoryReadResponse_deleteMembers(&response);
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+START_TEST(NodeStatistics) {
+    UA_Server *server = makeTestSequence();
+    UA_NodeId answer = UA_NODEID_STRING(1, "the.answer");
+    UA_NodeId unknown = UA_NODEID_STRING(1, "unknown");
+
+    /* Reads of unknown nodes are not counted */
+    UA_ReadValueId rvi;
+    UA_ReadValueId_init(&rvi);
+    rvi.attributeId = UA_ATTRIBUTEID_VALUE;
+    rvi.nodeId = unknown;
+    UA_DataValue resp;
+    UA_DataValue_init(&resp);
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &resp);
+    UA_DataValue_deleteMembers(&resp);
+    rvi.nodeId = answer;
+    for(size_t i = 0; i < 5; i++) {
+        Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rvi, &resp);
+        UA_DataValue_deleteMembers(&resp);
+    }
+
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 myInteger = 20;
+    UA_Variant_setScalar(&wValue.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = answer;
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue), UA_STATUSCODE_GOOD);
+    wValue.nodeId = unknown;
+    ck_assert_uint_eq(Service_Write_single(server, &adminSession, &wValue),
+                      UA_STATUSCODE_BADNODEIDUNKNOWN);
+
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = answer;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    Service_Browse_single(server, &adminSession, NULL, &bd, 0, &br);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    UA_BrowseResult_deleteMembers(&br);
+
+    UA_NodeStatistics *stats;
+    size_t statsSize;
+    ck_assert_uint_eq(UA_Server_getHottestNodes(server, 100000, &stats, &statsSize),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_gt(statsSize, 1);
+    const UA_NodeStatistics *s = findNodeStatistics(stats, statsSize, answer);
+    ck_assert_ptr_ne(s, NULL);
+    ck_assert_uint_eq(s->reads, 5);
+    ck_assert_uint_eq(s->writes, 1);
+    ck_assert_uint_eq(s->monitoredItems, 0);
+    ck_assert_uint_eq(s->browses, 1);
+    ck_assert_ptr_eq(findNodeStatistics(stats, statsSize, unknown), NULL);
+
+    /* The hottest node first */
+    for(size_t i = 1; i < statsSize; i++)
+        ck_assert_uint_ge(stats[i-1].reads + stats[i-1].writes + stats[i-1].monitoredItems +
+                          stats[i-1].browses, stats[i].reads + stats[i].writes +
+                          stats[i].monitoredItems + stats[i].browses);
+    UA_NodeStatistics *top;
+    size_t topSize;
+    ck_assert_uint_eq(UA_Server_getHottestNodes(server, 1, &top, &topSize), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(topSize, 1);
+    ck_assert(UA_NodeId_equal(&top[0].nodeId, &stats[0].nodeId));
+    UA_NodeStatistics_deleteArray(top, topSize);
+
+    /* Deleted nodes are forgotten */
+    size_t oldSize = statsSize;
+    UA_NodeStatistics_deleteArray(stats, statsSize);
+    ck_assert_uint_eq(UA_Server_deleteNode(server, answer, true), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Server_getHottestNodes(server, 100000, &stats, &statsSize),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(findNodeStatistics(stats, statsSize, answer), NULL);
+    ck_assert_uint_le(statsSize, oldSize);
+    UA_NodeStatistics_deleteArray(stats, statsSize);
+    UA_Server_delete(server);
+} END_TEST
+#endif
+
 static Suite * testSuite_services_attributes(void) {
 	Suite *s = suite_create("services_attributes_read");
 
 	TCase *tc_readSingleAttributes = tcase_create("readSingleAttributes");
 	tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeValueWithoutTimestamp);
+	tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeValueWithTimestamps);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeValueRangeWithoutTimestamp);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeNodeIdWithoutTimestamp);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleAttributeNodeClassWithoutTimestamp);
@@ -1067,6 +2164,16 @@ static Suite * testSuite_services_attributes(void) {
         tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeValueWithoutTimestamp);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeDataTypeWithoutTimestamp);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp);
+	tcase_add_test(tc_readSingleAttributes, ReadLargeRequest);
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+	tcase_add_test(tc_readSingleAttributes, ReadExternalNamespaces);
+#endif
+	tcase_add_test(tc_readSingleAttributes, ReadDirect);
+	tcase_add_test(tc_readSingleAttributes, ReadValueMemory);
+	tcase_add_test(tc_readSingleAttributes, ReadValueBorrowed);
+	tcase_add_test(tc_readSingleAttributes, ReadAsyncDataSource);
+	tcase_add_test(tc_readSingleAttributes, ReadBatchedDataSource);
+	tcase_add_test(tc_readSingleAttributes, ReadBatchedDataSource_GroupsByCallback);
 
 	suite_add_tcase(s, tc_readSingleAttributes);
 
@@ -1084,6 +2191,9 @@ static Suite * testSuite_services_attributes(void) {
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeContainsNoLoops);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeEventNotifier);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValue);
+	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueInPlace);
+	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRange);
+	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRangeChunks);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeDataType);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRank);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeArrayDimensions);
@@ -1101,6 +2211,20 @@ static Suite * testSuite_services_attributes(void) {
 	tcase_add_test(tc_parseNumericRange, numericRange);
 	suite_add_tcase(s, tc_parseNumericRange);
 
+#ifdef UA_ENABLE_HISTORIZING
+	TCase *tc_history = tcase_create("history");
+	tcase_add_test(tc_history, HistoryReadRawValues);
+	tcase_add_test(tc_history, HistoryReadContinuationPoints);
+	tcase_add_test(tc_history, HistoryLimitAndNodes);
+	suite_add_tcase(s, tc_history);
+#endif
+
+#ifdef UA_ENABLE_NODE_STATISTICS
+	TCase *tc_nodeStatistics = tcase_create("nodeStatistics");
+	tcase_add_test(tc_nodeStatistics, NodeStatistics);
+	suite_add_tcase(s, tc_nodeStatistics);
+#endif
+
 	return s;
 }
 
@@ -87,6 +87,76 @@ START_TEST(AddNodeTwiceGivesError) {
     UA_Server_delete(server);
 } END_TEST
 
+START_TEST(AddNodesBatch) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    /* a folder and 100 variables below it in one batch */
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Int32 myInteger = 42;
+    UA_Variant_setScalar(&vattr.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+
+    size_t itemsSize = 102;
+    UA_AddNodesItem *items = UA_Array_new(itemsSize, &UA_TYPES[UA_TYPES_ADDNODESITEM]);
+    UA_NodeId folderId = UA_NODEID_NUMERIC(1, 50000);
+    items[0].requestedNewNodeId.nodeId = folderId;
+    items[0].parentNodeId.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    items[0].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+    items[0].browseName = UA_QUALIFIEDNAME(1, "folder");
+    items[0].nodeClass = UA_NODECLASS_OBJECT;
+    items[0].typeDefinition.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE);
+    items[0].nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    items[0].nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
+    items[0].nodeAttributes.content.decoded.data = &oattr;
+    for(size_t i = 1; i < itemsSize; i++) {
+        items[i].requestedNewNodeId.nodeId = UA_NODEID_NUMERIC(1, 50000 + (UA_UInt32)i);
+        items[i].parentNodeId.nodeId = folderId;
+        items[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+        items[i].browseName = UA_QUALIFIEDNAME(1, "var");
+        items[i].nodeClass = UA_NODECLASS_VARIABLE;
+        items[i].typeDefinition.nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE);
+        items[i].nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+        items[i].nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
+        items[i].nodeAttributes.content.decoded.data = &vattr;
+    }
+    /* the last item exists already */
+    items[itemsSize-1].requestedNewNodeId.nodeId = items[1].requestedNewNodeId.nodeId;
+
+    UA_AddNodesResult *results = NULL;
+    UA_StatusCode res = UA_Server_addNodes(server, items, itemsSize, &results);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < itemsSize - 1; i++)
+        ck_assert_int_eq(results[i].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(results[itemsSize-1].statusCode, UA_STATUSCODE_BADNODEIDEXISTS);
+
+    /* the folder references all children */
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = folderId;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    Service_Browse_single(server, &adminSession, NULL, &bd, 0, &br);
+    ck_assert_int_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, itemsSize - 2);
+    UA_BrowseResult_deleteMembers(&br);
+
+    /* and the children reference the folder */
+    bd.nodeId = results[1].addedNodeId;
+    bd.browseDirection = UA_BROWSEDIRECTION_INVERSE;
+    Service_Browse_single(server, &adminSession, NULL, &bd, 0, &br);
+    ck_assert_uint_eq(br.referencesSize, 1);
+    ck_assert(UA_NodeId_equal(&br.references[0].nodeId.nodeId, &folderId));
+    UA_BrowseResult_deleteMembers(&br);
+
+    UA_Array_delete(results, itemsSize, &UA_TYPES[UA_TYPES_ADDNODESRESULT]);
+    UA_free(items); /* the members point to static data */
+    UA_Server_delete(server);
+} END_TEST
+
 static Suite * testSuite_services_nodemanagement(void) {
 	Suite *s = suite_create("services_nodemanagement");
 
@@ -94,6 +164,7 @@ static Suite * testSuite_services_nodemanagement(void) {
 	tcase_add_test(tc_addnodes, AddVariableNode);
         tcase_add_test(tc_addnodes, AddComplexTypeWithInheritance);
 	tcase_add_test(tc_addnodes, AddNodeTwiceGivesError);
+	tcase_add_test(tc_addnodes, AddNodesBatch);
 
 	suite_add_tcase(s, tc_addnodes);
 	return s;
@@ -2,9 +2,70 @@
 #include <stdlib.h>
 
 #include "ua_types.h"
+#include "ua_server.h"
+#include "ua_config_standard.h"
 #include "server/ua_services.h"
+#include "ua_session.h"
 #include "check.h"
 
+static UA_Boolean
+browseFinds(UA_Server *server, const UA_NodeId *nodeId, UA_UInt32 referenceType, const UA_NodeId *target) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = *nodeId;
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    bd.includeSubtypes = true;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult br = UA_Server_browse(server, 0, &bd);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    UA_Boolean found = false;
+    for(size_t i = 0; i < br.referencesSize; i++) {
+        if(UA_NodeId_equal(&br.references[i].nodeId.nodeId, target))
+            found = true;
+    }
+    UA_BrowseResult_deleteMembers(&br);
+    return found;
+}
+
+START_TEST(BrowseWithSubtypes) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_NodeId objects = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    UA_NodeId serverNode = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+    ck_assert(browseFinds(server, &objects, UA_NS0ID_HIERARCHICALREFERENCES, &serverNode));
+    ck_assert(!browseFinds(server, &objects, UA_NS0ID_HASCOMPONENT, &serverNode));
+
+    /* A new subtype of Organizes is part of the closure */
+    UA_ReferenceTypeAttributes rattr;
+    UA_ReferenceTypeAttributes_init(&rattr);
+    rattr.displayName = UA_LOCALIZEDTEXT("en_US", "MyOrganizes");
+    UA_NodeId myOrganizes = UA_NODEID_NUMERIC(1, 5000);
+    UA_StatusCode retval =
+        UA_Server_addReferenceTypeNode(server, myOrganizes, UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                       UA_QUALIFIEDNAME(1, "MyOrganizes"), rattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", "MyObject");
+    UA_NodeId myObject = UA_NODEID_NUMERIC(1, 5001);
+    retval = UA_Server_addObjectNode(server, myObject, objects, myOrganizes,
+                                     UA_QUALIFIEDNAME(1, "MyObject"),
+                                     UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(browseFinds(server, &objects, UA_NS0ID_HIERARCHICALREFERENCES, &myObject));
+    ck_assert(browseFinds(server, &objects, UA_NS0ID_ORGANIZES, &myObject));
+    ck_assert(!browseFinds(server, &objects, UA_NS0ID_NONHIERARCHICALREFERENCES, &myObject));
+
+    /* Without the reference type, the closure no longer contains it */
+    retval = UA_Server_deleteNode(server, myOrganizes, true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!browseFinds(server, &objects, UA_NS0ID_HIERARCHICALREFERENCES, &myObject));
+    UA_Server_delete(server);
+}
+END_TEST
+
 /* START_TEST(Service_TranslateBrowsePathsToNodeIds_SmokeTest)
 {
 	UA_TranslateBrowsePathsToNodeIdsRequest request;
@@ -27,11 +88,237 @@
 }
 END_TEST */
 
+static UA_StatusCode
+translate(UA_Server *server, UA_UInt32 startId, char *name, UA_NodeId *target) {
+    UA_RelativePathElement elem;
+    UA_RelativePathElement_init(&elem);
+    elem.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    elem.includeSubtypes = true;
+    elem.targetName = UA_QUALIFIEDNAME(1, name);
+    UA_BrowsePath bp;
+    UA_BrowsePath_init(&bp);
+    bp.startingNode = UA_NODEID_NUMERIC(1, startId);
+    bp.relativePath.elements = &elem;
+    bp.relativePath.elementsSize = 1;
+    UA_BrowsePathResult result;
+    UA_BrowsePathResult_init(&result);
+    Service_TranslateBrowsePathsToNodeIds_single(server, &adminSession, &bp, &result);
+    UA_StatusCode retval = result.statusCode;
+    if(retval == UA_STATUSCODE_GOOD) {
+        ck_assert_uint_eq(result.targetsSize, 1);
+        UA_NodeId_copy(&result.targets[0].targetId.nodeId, target);
+    }
+    UA_BrowsePathResult_deleteMembers(&result);
+    return retval;
+}
+
+static void addChild(UA_Server *server, UA_UInt32 parentId, UA_UInt32 id, char *name) {
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", name);
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, id), UA_NODEID_NUMERIC(1, parentId),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), UA_QUALIFIEDNAME(1, name),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+}
+
+START_TEST(TranslateInWideFolder) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", "Folder");
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 6000),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    char name[16];
+    for(UA_UInt32 i = 0; i < 20; i++) {
+        sprintf(name, "Child%u", (unsigned)i);
+        addChild(server, 6000, 6001 + i, name);
+    }
+
+    /* Twice to use the index built by the first lookup */
+    UA_NodeId target;
+    for(size_t i = 0; i < 2; i++) {
+        ck_assert_uint_eq(translate(server, 6000, "Child7", &target), UA_STATUSCODE_GOOD);
+        ck_assert_uint_eq(target.identifier.numeric, 6008);
+    }
+    ck_assert_uint_eq(translate(server, 6000, "Child20", &target), UA_STATUSCODE_BADNOMATCH);
+
+    /* Renamed targets */
+    retval = UA_Server_writeBrowseName(server, UA_NODEID_NUMERIC(1, 6008), UA_QUALIFIEDNAME(1, "Renamed"));
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(translate(server, 6000, "Child7", &target), UA_STATUSCODE_BADNOMATCH);
+    ck_assert_uint_eq(translate(server, 6000, "Renamed", &target), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(target.identifier.numeric, 6008);
+
+    /* New references */
+    addChild(server, 6000, 6021, "Child20");
+    ck_assert_uint_eq(translate(server, 6000, "Child20", &target), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(target.identifier.numeric, 6021);
+    UA_Server_delete(server);
+}
+END_TEST
+
+/* Browses the folder with up to maxrefs references per call. Returns the number
+ * of references. The continuation point is left open after the first call if
+ * stopEarly is set. */
+static size_t
+browseWithContinuation(UA_Server *server, UA_Session *session, UA_UInt32 folder,
+                       UA_UInt32 maxrefs, UA_Boolean stopEarly) {
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(1, folder);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    bd.includeSubtypes = true;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    bd.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    Service_Browse_single(server, session, NULL, &bd, maxrefs, &br);
+    size_t count = 0;
+    while(br.statusCode == UA_STATUSCODE_GOOD) {
+        for(size_t i = 0; i < br.referencesSize; i++)
+            ck_assert_uint_eq(br.references[i].nodeId.nodeId.identifier.numeric, 6101 + count + i);
+        count += br.referencesSize;
+        if(br.continuationPoint.length == 0 || stopEarly)
+            break;
+        UA_ByteString cp = br.continuationPoint;
+        UA_ByteString_init(&br.continuationPoint);
+        UA_BrowseResult_deleteMembers(&br);
+        UA_BrowseResult_init(&br);
+        UA_Server_browseNext_single(server, session, false, &cp, &br);
+        UA_ByteString_deleteMembers(&cp);
+    }
+    if(br.statusCode != UA_STATUSCODE_GOOD)
+        count = 0;
+    UA_BrowseResult_deleteMembers(&br);
+    return count;
+}
+
+START_TEST(BrowseNextResumes) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", "Folder");
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 6100),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    char name[16];
+    for(UA_UInt32 i = 0; i < 10; i++) {
+        sprintf(name, "Child%u", (unsigned)i);
+        addChild(server, 6100, 6101 + i, name);
+    }
+
+    UA_Session session;
+    UA_Session_init(&session);
+    session.maxContinuationPoints = 2;
+    session.availableContinuationPoints = 2;
+    for(UA_UInt32 maxrefs = 1; maxrefs <= 11; maxrefs++)
+        ck_assert_uint_eq(browseWithContinuation(server, &session, 6100, maxrefs, false), 10);
+    ck_assert_uint_eq(session.availableContinuationPoints, 2);
+
+    /* The number of open continuation points is limited */
+    ck_assert_uint_eq(browseWithContinuation(server, &session, 6100, 3, true), 3);
+    ck_assert_uint_eq(browseWithContinuation(server, &session, 6100, 3, true), 3);
+    ck_assert_uint_eq(browseWithContinuation(server, &session, 6100, 3, true), 0);
+
+    /* Unknown continuation points */
+    UA_Guid unknown = UA_Guid_random();
+    UA_ByteString cp = {sizeof(UA_Guid), (UA_Byte*)&unknown};
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    UA_Server_browseNext_single(server, &session, false, &cp, &br);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_BADCONTINUATIONPOINTINVALID);
+    unknown.data1 = 0;
+    UA_Server_browseNext_single(server, &session, false, &cp, &br);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_BADCONTINUATIONPOINTINVALID);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(BrowseNextAfterReferencesChanged) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", "Folder");
+    UA_StatusCode retval =
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 6100),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_QUALIFIEDNAME(1, "Folder"),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), oattr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    char name[16];
+    for(UA_UInt32 i = 0; i < 10; i++) {
+        sprintf(name, "Child%u", (unsigned)i);
+        addChild(server, 6100, 6101 + i, name);
+    }
+
+    /* Without a limit, more than the default number of continuation points
+     * can be open */
+    UA_Session session;
+    UA_Session_init(&session);
+    session.maxContinuationPoints = 0;
+    for(size_t i = 0; i < 2 * MAXCONTINUATIONPOINTS; i++)
+        ck_assert_uint_eq(browseWithContinuation(server, &session, 6100, 3, true), 3);
+
+    UA_BrowseDescription bd;
+    UA_BrowseDescription_init(&bd);
+    bd.nodeId = UA_NODEID_NUMERIC(1, 6100);
+    bd.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+    bd.includeSubtypes = true;
+    bd.browseDirection = UA_BROWSEDIRECTION_FORWARD;
+    UA_BrowseResult br;
+    UA_BrowseResult_init(&br);
+    Service_Browse_single(server, &session, NULL, &bd, 3, &br);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, 3);
+    UA_ByteString cp = br.continuationPoint;
+    UA_ByteString_init(&br.continuationPoint);
+    UA_BrowseResult_deleteMembers(&br);
+
+    /* Move the children within the references. Their number stays the same. */
+    retval = UA_Server_deleteReference(server, UA_NODEID_NUMERIC(1, 6100),
+                                       UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), false,
+                                       UA_EXPANDEDNODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), false);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    retval = UA_Server_addReference(server, UA_NODEID_NUMERIC(1, 6100),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ALWAYSGENERATESEVENT),
+                                    UA_EXPANDEDNODEID_NUMERIC(1, 6101), true);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* The browse continues after the references already returned */
+    UA_BrowseResult_init(&br);
+    UA_Server_browseNext_single(server, &session, false, &cp, &br);
+    ck_assert_uint_eq(br.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(br.referencesSize, 3);
+    ck_assert_uint_eq(br.references[0].nodeId.nodeId.identifier.numeric, 6104);
+    UA_BrowseResult_deleteMembers(&br);
+    UA_ByteString_deleteMembers(&cp);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
 static Suite* testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
 	Suite *s = suite_create("Service_TranslateBrowsePathsToNodeIds");
 	TCase *tc_core = tcase_create("Core");
 	//tcase_add_test(tc_core, Service_TranslateBrowsePathsToNodeIds_SmokeTest);
 	suite_add_tcase(s,tc_core);
+	TCase *tc_browse = tcase_create("Browse");
+	tcase_add_test(tc_browse, BrowseWithSubtypes);
+	tcase_add_test(tc_browse, TranslateInWideFolder);
+	tcase_add_test(tc_browse, BrowseNextResumes);
+	tcase_add_test(tc_browse, BrowseNextAfterReferencesChanged);
+	suite_add_tcase(s,tc_browse);
 	return s;
 }
 
@@ -1,10 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ua_types.h"
+#include "ua_config_standard.h"
 #include "server/ua_services.h"
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+#include "server/ua_subscription.h"
+#endif
+#include "server/ua_server_internal.h"
 #include "check.h"
 
+#ifdef UA_ENABLE_MULTITHREADING
+#include <pthread.h>
+#endif
+
 START_TEST(Session_init_ShallWork)
 {
 	UA_Session session;
@@ -37,18 +47,843 @@ START_TEST(Session_updateLifetime_ShallWork)
 	UA_Session_init(&session);
     UA_DateTime tmpDateTime;
     tmpDateTime = session.validTill;
-	UA_Session_updateLifetime(&session);
+	UA_Session_updateLifetime(&session, UA_DateTime_now());
 
 	UA_Int32 result = (session.validTill > tmpDateTime);
 	ck_assert_int_gt(result,0);
 }
 END_TEST
 
+START_TEST(Session_admitRequest_LimitsRate)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.maxSessionRequestRate = 10;
+    config.maxSessionRequestBurst = 2;
+    config.operationsPerRequest = 100;
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+
+    /* The burst and one more are admitted at once */
+    for(size_t i = 0; i < 3; i++)
+        ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1),
+                      UA_STATUSCODE_BADTCPSERVERTOOBUSY);
+
+    /* One request per 100ms */
+    now += 100 * UA_MSEC_TO_DATETIME;
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1),
+                      UA_STATUSCODE_BADTCPSERVERTOOBUSY);
+
+    /* A heavy request needs the full burst */
+    now += 200 * UA_MSEC_TO_DATETIME;
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 10000),
+                      UA_STATUSCODE_BADTCPSERVERTOOBUSY);
+    now += 100 * UA_MSEC_TO_DATETIME;
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 10000), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1),
+                      UA_STATUSCODE_BADTCPSERVERTOOBUSY);
+
+    /* Requests waiting for asynchronous reads */
+    config.maxSessionRequestRate = 0;
+    config.maxSessionInflightRequests = 2;
+    session.inflightRequests = 2;
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1),
+                      UA_STATUSCODE_BADTCPSERVERTOOBUSY);
+    session.inflightRequests = 1;
+    ck_assert_uint_eq(UA_Session_admitRequest(&session, &config, now, 1), UA_STATUSCODE_GOOD);
+}
+END_TEST
+
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+static UA_MonitoredItem *
+newSampledItem(UA_Subscription *sub, UA_Double samplingInterval) {
+    UA_MonitoredItem *mon = UA_MonitoredItem_new();
+    mon->subscription = sub;
+    mon->samplingInterval = samplingInterval;
+    mon->attributeID = UA_ATTRIBUTEID_VALUE;
+    LIST_INSERT_HEAD(&sub->MonitoredItems, mon, listEntry);
+    return mon;
+}
+
+static void
+onReadNothing(void *handle, const UA_NodeId nodeid, const UA_Variant *data,
+              const UA_NumericRange *range) {}
+
+START_TEST(Session_samplingGroups_ShallShareInterval)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_Subscription *sub = UA_Subscription_new(&session, 1);
+
+    UA_MonitoredItem *a = newSampledItem(sub, 100.0);
+    UA_MonitoredItem *b = newSampledItem(sub, 100.0);
+    UA_MonitoredItem *c = newSampledItem(sub, 250.0);
+    UA_MonitoredItem *d = newSampledItem(sub, 100.0);
+    d->monitoredNodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_SERVER);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, a), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, b), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, c), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, d), UA_STATUSCODE_GOOD);
+
+    /* items with the same target share the sampler */
+    ck_assert_ptr_eq(a->sampler, b->sampler);
+    ck_assert_uint_eq(a->sampler->itemsSize, 2);
+    ck_assert_ptr_ne(a->sampler, d->sampler);
+    ck_assert_ptr_eq(a->sampler->group, d->sampler->group);
+    ck_assert_ptr_ne(a->sampler->group, c->sampler->group);
+    ck_assert_uint_eq(a->sampler->group->samplersSize, 2);
+
+    /* registering twice does not add the item again */
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, a), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(a->sampler->itemsSize, 2);
+
+    MonitoredItem_unregisterSampleJob(server, a);
+    ck_assert_ptr_eq(a->sampler, NULL);
+    ck_assert_uint_eq(b->sampler->itemsSize, 1);
+
+    /* the samplers and groups are removed with the last item */
+    UA_Subscription_deleteMembers(sub, server);
+    UA_objfree(sub);
+    ck_assert_ptr_eq(LIST_FIRST(&server->samplingGroups), NULL);
+    ck_assert_uint_eq(server->samplersCount, 0);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Session_samplingGroups_NotifyWrittenValues)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Int32 value = 42;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_INT32]);
+    const UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 5000);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "watched"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* two sessions monitor the same value */
+    UA_Session sessions[2];
+    UA_Subscription *subs[2];
+    UA_MonitoredItem *mons[2];
+    for(size_t i = 0; i < 2; i++) {
+        UA_Session_init(&sessions[i]);
+        subs[i] = UA_Subscription_new(&sessions[i], 1);
+        mons[i] = newSampledItem(subs[i], 100.0);
+        MonitoredItem_setQueueSize(mons[i], 10);
+        UA_NodeId_copy(&nodeId, &mons[i]->monitoredNodeId);
+        ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, mons[i]), UA_STATUSCODE_GOOD);
+    }
+
+    /* the shared sampler is notified and waits for the initial sample */
+    UA_Sampler *sampler = mons[0]->sampler;
+    ck_assert_ptr_eq(mons[1]->sampler, sampler);
+    ck_assert(sampler->notified);
+    ck_assert(sampler->changed);
+    ck_assert_ptr_eq(LIST_FIRST(&sampler->group->samplers), NULL);
+    ck_assert_ptr_eq(LIST_FIRST(&sampler->group->changedSamplers), sampler);
+
+#ifndef UA_ENABLE_MULTITHREADING
+    /* a write after the sampling interval is sampled right away. Both queues
+     * reference the same data. The next write waits for the group job. */
+    LIST_REMOVE(sampler, groupEntry);
+    sampler->changed = false;
+    UA_Variant v;
+    value = 43;
+    UA_Variant_setScalar(&v, &value, &UA_TYPES[UA_TYPES_INT32]);
+    ck_assert_uint_eq(UA_Server_writeValue(server, nodeId, v), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(mons[0]->currentQueueSize, 1);
+    ck_assert_uint_eq(mons[1]->currentQueueSize, 1);
+    ck_assert_ptr_eq(TAILQ_FIRST(&subs[0]->readyItems), mons[0]);
+    ck_assert_uint_eq(subs[0]->queuedNotifications, 1);
+    ck_assert_ptr_eq(mons[0]->queue[0].value.value.data, mons[1]->queue[0].value.value.data);
+    ck_assert_int_eq(*(UA_Int32*)mons[0]->queue[0].value.value.data, 43);
+    ck_assert_ptr_ne(mons[0]->queue[0].encoded, NULL);
+    ck_assert_ptr_eq(mons[0]->queue[0].encoded, mons[1]->queue[0].encoded);
+    ck_assert_uint_eq(mons[0]->queue[0].encoded->refCount, 2);
+    ck_assert(!sampler->changed);
+    value = 44;
+    ck_assert_uint_eq(UA_Server_writeValue(server, nodeId, v), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(mons[0]->currentQueueSize, 1);
+    ck_assert(sampler->changed);
+
+    /* a batched write notifies the written nodes only */
+    LIST_REMOVE(sampler, groupEntry);
+    sampler->changed = false;
+    sampler->lastSampleTime = 0;
+    value = 45;
+    const UA_NodeId nodeIds[2] = {nodeId, UA_NODEID_NUMERIC(1, 5999)};
+    const UA_Variant values[2] = {v, v};
+    UA_StatusCode results[2];
+    ck_assert_uint_eq(UA_Server_writeValues(server, 2, nodeIds, values, results),
+                      UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[0], UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(results[1], UA_STATUSCODE_BADNODEIDUNKNOWN);
+    ck_assert_uint_eq(mons[0]->currentQueueSize, 2);
+    ck_assert_uint_eq(mons[1]->currentQueueSize, 2);
+    ck_assert_int_eq(*(UA_Int32*)mons[0]->queue[1].value.value.data, 45);
+    ck_assert_uint_eq(UA_Server_writeValues(server, 0, NULL, NULL, NULL),
+                      UA_STATUSCODE_BADNOTHINGTODO);
+#endif
+
+    /* values with an onRead callback are polled */
+    UA_ValueCallback callback = {NULL, onReadNothing, NULL};
+    retval = UA_Server_setVariableNode_valueCallback(server, nodeId, callback);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    ck_assert(!sampler->notified);
+    ck_assert(!sampler->changed);
+    ck_assert_ptr_eq(LIST_FIRST(&sampler->group->samplers), sampler);
+    ck_assert_uint_eq(server->notifiedSamplers, 0);
+
+    for(size_t i = 0; i < 2; i++) {
+        UA_Subscription_deleteMembers(subs[i], server);
+        UA_objfree(subs[i]);
+        UA_Session_deleteMembersCleanup(&sessions[i], server);
+    }
+    UA_Server_delete(server);
+}
+END_TEST
+
+typedef struct {
+    UA_Server *server;
+    UA_MonitoredItem *mon;
+    UA_Boolean lockFree;
+} UnregisteringSource;
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void *tryLockSamplers(void *data) {
+    UnregisteringSource *src = (UnregisteringSource*)data;
+    if(pthread_mutex_trylock(&src->server->samplersLock) == 0) {
+        src->lockFree = true;
+        pthread_mutex_unlock(&src->server->samplersLock);
+    }
+    return NULL;
+}
+#endif
+
+/* Removes the last item of the sampler while its value is read */
+static UA_StatusCode
+readUnregistering(void *handle, const UA_NodeId nodeid, UA_Boolean sourceTimeStamp,
+                  const UA_NumericRange *range, UA_DataValue *value) {
+    UnregisteringSource *src = (UnregisteringSource*)handle;
+#ifdef UA_ENABLE_MULTITHREADING
+    pthread_t thread;
+    pthread_create(&thread, NULL, tryLockSamplers, src);
+    pthread_join(thread, NULL);
+#else
+    src->lockFree = true;
+#endif
+    MonitoredItem_unregisterSampleJob(src->server, src->mon);
+    UA_Int32 v = 42;
+    value->hasValue = true;
+    return UA_Variant_setScalarCopy(&value->value, &v, &UA_TYPES[UA_TYPES_INT32]);
+}
+
+START_TEST(Session_samplingGroups_ReadSourcesWithoutLock)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UnregisteringSource src = {server, NULL, false};
+    UA_DataSource dataSource = {.handle = &src, .read = readUnregistering, .write = NULL};
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    const UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 5001);
+    UA_StatusCode retval =
+        UA_Server_addDataSourceVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                            UA_QUALIFIEDNAME(1, "source"), UA_NODEID_NULL, attr,
+                                            dataSource, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_Subscription *sub = UA_Subscription_new(&session, 1);
+    src.mon = newSampledItem(sub, 100.0);
+    UA_NodeId_copy(&nodeId, &src.mon->monitoredNodeId);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, src.mon), UA_STATUSCODE_GOOD);
+    UA_SamplingGroup *group = src.mon->sampler->group;
+
+    /* The sampler is kept until the read has finished. Then it is deleted
+     * without a sample. The group is removed with the sampler. */
+    UA_RCU_LOCK();
+    SamplingGroupCallback(server, group);
+    UA_RCU_UNLOCK();
+    ck_assert(src.lockFree);
+    ck_assert_ptr_eq(src.mon->sampler, NULL);
+    ck_assert_uint_eq(src.mon->currentQueueSize, 0);
+    ck_assert_uint_eq(server->samplersCount, 0);
+    ck_assert_ptr_eq(LIST_FIRST(&server->samplingGroups), NULL);
+
+    UA_Subscription_deleteMembers(sub, server);
+    UA_objfree(sub);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+#ifndef UA_ENABLE_MULTITHREADING
+/* Writes the value and samples it right away instead of waiting for the job */
+static void
+writeAndSample(UA_Server *server, UA_Sampler *sampler, const UA_NodeId nodeId, UA_Double value) {
+    if(sampler->changed) {
+        LIST_REMOVE(sampler, groupEntry);
+        sampler->changed = false;
+    }
+    sampler->lastSampleTime = 0;
+    UA_Variant v;
+    UA_Variant_setScalar(&v, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    ck_assert_uint_eq(UA_Server_writeValue(server, nodeId, v), UA_STATUSCODE_GOOD);
+}
+
+START_TEST(Session_monitoredItem_DeadbandFilter)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Double value = 10.0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    const UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 5001);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "analog"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_Subscription *sub = UA_Subscription_new(&session, 1);
+    UA_MonitoredItem *mon = newSampledItem(sub, 100.0);
+    mon->deadband = 2.0;
+    MonitoredItem_setQueueSize(mon, 10);
+    UA_NodeId_copy(&nodeId, &mon->monitoredNodeId);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, mon), UA_STATUSCODE_GOOD);
+    UA_Sampler *sampler = mon->sampler;
+
+    writeAndSample(server, sampler, nodeId, 10.0); /* initial value */
+    ck_assert_uint_eq(mon->currentQueueSize, 1);
+    writeAndSample(server, sampler, nodeId, 11.5); /* within the deadband */
+    ck_assert_uint_eq(mon->currentQueueSize, 1);
+    writeAndSample(server, sampler, nodeId, 12.5); /* compared to the reported 10.0 */
+    ck_assert_uint_eq(mon->currentQueueSize, 2);
+    writeAndSample(server, sampler, nodeId, 10.6);
+    ck_assert_uint_eq(mon->currentQueueSize, 2);
+
+    /* only status changes are reported */
+    mon->deadband = 0.0;
+    mon->trigger = UA_DATACHANGETRIGGER_STATUS;
+    writeAndSample(server, sampler, nodeId, 100.0);
+    ck_assert_uint_eq(mon->currentQueueSize, 2);
+
+    UA_Subscription_deleteMembers(sub, server);
+    UA_objfree(sub);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Session_memory_EnforcesQuota)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Double value = 1.0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    const UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 5002);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "quota"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_Subscription *sub = UA_Subscription_new(&session, 1);
+    UA_MonitoredItem *mon = newSampledItem(sub, 100.0);
+    MonitoredItem_setQueueSize(mon, 10);
+    ck_assert_uint_eq(session.memory.subscriptions, sub->memory);
+    ck_assert_uint_eq(sub->memory, sizeof(UA_Subscription) + mon->memory);
+    UA_NodeId_copy(&nodeId, &mon->monitoredNodeId);
+
+    /* no room for the initial sample */
+    server->config.maxSubscriptionMemory = sub->memory;
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, mon), UA_STATUSCODE_GOOD);
+    UA_Sampler *sampler = mon->sampler;
+    writeAndSample(server, sampler, nodeId, 2.0);
+    ck_assert_uint_eq(mon->currentQueueSize, 0);
+    ck_assert_uint_eq(session.memory.samples, 0);
+    ck_assert_uint_eq(session.memory.discarded, 1);
+
+    server->config.maxSubscriptionMemory = 0;
+    writeAndSample(server, sampler, nodeId, 3.0);
+    ck_assert_uint_eq(mon->currentQueueSize, 1);
+    ck_assert(session.memory.samples > 0);
+
+    /* the oldest sample makes room for the new one */
+    server->config.maxSubscriptionMemory = sub->memory;
+    mon->discardOldest = true;
+    writeAndSample(server, sampler, nodeId, 4.0);
+    ck_assert_uint_eq(mon->currentQueueSize, 1);
+    ck_assert_uint_eq(session.memory.discarded, 2);
+    ck_assert_uint_eq(sub->memory, server->config.maxSubscriptionMemory);
+
+    UA_Subscription_deleteMembers(sub, server);
+    ck_assert_uint_eq(session.memory.subscriptions, 0);
+    ck_assert_uint_eq(session.memory.samples, 0);
+    UA_objfree(sub);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+#endif
+
+START_TEST(Session_monitoredItem_ResizeQueueRing)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_Session session;
+    UA_Session_init(&session);
+    UA_Subscription *sub = UA_Subscription_new(&session, 1);
+    UA_MonitoredItem *mon = newSampledItem(sub, 100.0);
+    ck_assert_uint_eq(MonitoredItem_setQueueSize(mon, 3), UA_STATUSCODE_GOOD);
+
+    /* a full ring that wraps around */
+    mon->queueStart = 2;
+    for(UA_Int32 i = 0; i < 3; i++) {
+        MonitoredItem_queuedValue *qv = &mon->queue[(2 + i) % 3];
+        UA_DataValue_init(&qv->value);
+        UA_Variant_setScalarCopy(&qv->value.value, &i, &UA_TYPES[UA_TYPES_INT32]);
+        qv->value.hasValue = true;
+        qv->encoded = NULL;
+    }
+    mon->currentQueueSize = 3;
+    TAILQ_INSERT_TAIL(&sub->readyItems, mon, readyEntry);
+    sub->queuedNotifications = 3;
+
+    /* shrinking discards the oldest sample */
+    ck_assert_uint_eq(MonitoredItem_setQueueSize(mon, 2), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(mon->maxQueueSize, 2);
+    ck_assert_uint_eq(mon->currentQueueSize, 2);
+    ck_assert_uint_eq(mon->queueStart, 0);
+    ck_assert_uint_eq(sub->queuedNotifications, 2);
+    ck_assert_int_eq(*(UA_Int32*)mon->queue[0].value.value.data, 1);
+    ck_assert_int_eq(*(UA_Int32*)mon->queue[1].value.value.data, 2);
+
+    /* growing keeps the samples */
+    ck_assert_uint_eq(MonitoredItem_setQueueSize(mon, 4), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(mon->currentQueueSize, 2);
+    ck_assert_int_eq(*(UA_Int32*)mon->queue[1].value.value.data, 2);
+
+    UA_Subscription_deleteMembers(sub, server);
+    UA_objfree(sub);
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+static UA_StatusCode
+allocSendBuffer(UA_Connection *connection, size_t length, UA_ByteString *buf) {
+    return UA_ByteString_allocBuffer(buf, length);
+}
+
+static UA_StatusCode
+dropSend(UA_Connection *connection, UA_ByteString *buf) {
+    UA_ByteString_deleteMembers(buf);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* A subscription without notifications that sends a keep-alive on every
+ * publish callback */
+static UA_Subscription *
+newKeepAliveSubscription(UA_Session *session, UA_UInt32 id, UA_Byte priority) {
+    UA_Subscription *sub = UA_Subscription_new(session, id);
+    sub->maxKeepAliveCount = 1;
+    sub->lifeTimeCount = 100;
+    sub->notificationsPerPublish = 10;
+    sub->priority = priority;
+    UA_Session_addSubscription(session, sub);
+    return sub;
+}
+
+static void
+queuePublishRequest(UA_Session *session) {
+    UA_PublishResponseEntry *pre =
+        UA_objalloc(UA_MEMCATEGORY_SUBSCRIPTION, sizeof(UA_PublishResponseEntry));
+    pre->requestId = 1;
+    pre->returnDiagnostics = 0;
+    UA_PublishResponse_init(&pre->response);
+    SIMPLEQ_INSERT_TAIL(&session->responseQueue, pre, listEntry);
+}
+
+START_TEST(Session_publish_PrioritizesLateSubscriptions)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.localConf = UA_ConnectionConfig_standard;
+    connection.remoteConf = UA_ConnectionConfig_standard;
+    connection.getSendBuffer = allocSendBuffer;
+    connection.send = dropSend;
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.connection = &connection;
+    UA_Session session;
+    UA_Session_init(&session);
+    session.channel = &channel;
+
+    UA_Subscription *low = newKeepAliveSubscription(&session, 1, 1);
+    UA_Subscription *high = newKeepAliveSubscription(&session, 2, 5);
+    UA_Subscription *other = newKeepAliveSubscription(&session, 3, 0);
+
+    /* without publish requests, both become late */
+    UA_Subscription_publishCallback(server, low);
+    UA_Subscription_publishCallback(server, high);
+    ck_assert_int_eq(low->state, UA_SUBSCRIPTIONSTATE_LATE);
+    ck_assert_int_eq(high->state, UA_SUBSCRIPTIONSTATE_LATE);
+    ck_assert_uint_eq(high->latePublishRequestCount, 1);
+    ck_assert_ptr_eq(UA_Session_getLateSubscription(&session), high);
+
+    /* a new publish request is answered on the late subscription with the
+     * highest priority */
+    UA_PublishRequest request;
+    UA_PublishRequest_init(&request);
+    Service_Publish(server, &session, &request, 1);
+    ck_assert_int_eq(high->state, UA_SUBSCRIPTIONSTATE_NORMAL);
+    ck_assert_int_eq(low->state, UA_SUBSCRIPTIONSTATE_LATE);
+    ck_assert(SIMPLEQ_EMPTY(&session.responseQueue));
+
+    /* a late subscription takes the request before a subscription with a
+     * lower priority */
+    queuePublishRequest(&session);
+    UA_Subscription_publishCallback(server, other);
+    ck_assert_int_eq(low->state, UA_SUBSCRIPTIONSTATE_NORMAL);
+    ck_assert_int_eq(other->state, UA_SUBSCRIPTIONSTATE_LATE);
+
+    /* but not before a subscription with a higher priority */
+    queuePublishRequest(&session);
+    UA_Subscription_publishCallback(server, high);
+    ck_assert_int_eq(high->state, UA_SUBSCRIPTIONSTATE_NORMAL);
+    ck_assert_int_eq(other->state, UA_SUBSCRIPTIONSTATE_LATE);
+    ck_assert(SIMPLEQ_EMPTY(&session.responseQueue));
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+#ifndef UA_ENABLE_MULTITHREADING
+START_TEST(Session_transferSubscriptions_MovesMemory)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Double value = 1.0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    const UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 5003);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "transfer"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.localConf = UA_ConnectionConfig_standard;
+    connection.remoteConf = UA_ConnectionConfig_standard;
+    connection.getSendBuffer = allocSendBuffer;
+    connection.send = dropSend;
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.connection = &connection;
+
+    UA_SessionManager *sm = &server->sessionManager;
+    UA_CreateSessionRequest csr;
+    UA_CreateSessionRequest_init(&csr);
+    UA_Session *old, *session;
+    ck_assert_uint_eq(UA_SessionManager_createSession(sm, NULL, &csr, &old), UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(UA_SessionManager_createSession(sm, NULL, &csr, &session), UA_STATUSCODE_GOOD);
+    old->channel = &channel;
+
+    /* a subscription with a sent message and a queued sample */
+    UA_UInt32 id = UA_SessionManager_getUniqueSubscriptionID(sm);
+    UA_Subscription *sub = newKeepAliveSubscription(old, id, 0);
+    sub->publishingEnabled = true;
+    UA_MonitoredItem *mon = newSampledItem(sub, 100.0);
+    MonitoredItem_setQueueSize(mon, 2);
+    UA_NodeId_copy(&nodeId, &mon->monitoredNodeId);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, mon), UA_STATUSCODE_GOOD);
+    writeAndSample(server, mon->sampler, nodeId, 2.0);
+    queuePublishRequest(old);
+    UA_Subscription_publishCallback(server, sub);
+    ck_assert_uint_eq(sub->retransmissionQueueSize, 1);
+    writeAndSample(server, mon->sampler, nodeId, 3.0);
+    ck_assert_uint_eq(mon->currentQueueSize, 1);
+    UA_SessionMemory memory = old->memory;
+    ck_assert(memory.samples > 0);
+    ck_assert(memory.retransmissions > 0);
+
+    /* the ids are unique across the sessions */
+    ck_assert_uint_ne(UA_SessionManager_getUniqueSubscriptionID(sm), id);
+
+    UA_UInt32 ids[2] = {id, 4711};
+    UA_TransferSubscriptionsRequest request;
+    UA_TransferSubscriptionsRequest_init(&request);
+    request.subscriptionIds = ids;
+    request.subscriptionIdsSize = 2;
+    request.sendInitialValues = true;
+    UA_TransferSubscriptionsResponse response;
+
+    /* only between the sessions of the same user */
+    old->userTokenType = &UA_TYPES[UA_TYPES_ANONYMOUSIDENTITYTOKEN];
+    old->userPolicyId = UA_STRING_ALLOC("open62541-anonymous-policy");
+    session->userTokenType = &UA_TYPES[UA_TYPES_USERNAMEIDENTITYTOKEN];
+    session->userPolicyId = UA_STRING_ALLOC("open62541-username-policy");
+    session->userName = UA_STRING_ALLOC("user");
+    UA_TransferSubscriptionsResponse_init(&response);
+    Service_TransferSubscriptions(server, session, &request, &response);
+    ck_assert_uint_eq(response.resultsSize, 2);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADUSERACCESSDENIED);
+    ck_assert_uint_eq(response.results[1].statusCode, UA_STATUSCODE_BADSUBSCRIPTIONIDINVALID);
+    ck_assert_ptr_eq(sub->session, old);
+    UA_TransferSubscriptionsResponse_deleteMembers(&response);
+    UA_String_deleteMembers(&session->userName);
+    UA_String_deleteMembers(&session->userPolicyId);
+
+    /* anonymous users of different client applications are not the same */
+    session->userTokenType = &UA_TYPES[UA_TYPES_ANONYMOUSIDENTITYTOKEN];
+    session->userPolicyId = UA_STRING_ALLOC("open62541-anonymous-policy");
+    UA_TransferSubscriptionsResponse_init(&response);
+    Service_TransferSubscriptions(server, session, &request, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADUSERACCESSDENIED);
+    UA_TransferSubscriptionsResponse_deleteMembers(&response);
+    old->clientDescription.applicationUri = UA_STRING_ALLOC("urn:client:a");
+    session->clientDescription.applicationUri = UA_STRING_ALLOC("urn:client:b");
+    UA_TransferSubscriptionsResponse_init(&response);
+    Service_TransferSubscriptions(server, session, &request, &response);
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_BADUSERACCESSDENIED);
+    ck_assert_ptr_eq(sub->session, old);
+    UA_TransferSubscriptionsResponse_deleteMembers(&response);
+    UA_String_deleteMembers(&session->clientDescription.applicationUri);
+    session->clientDescription.applicationUri = UA_STRING_ALLOC("urn:client:a");
+
+    /* the old session is told with its next publish response */
+    queuePublishRequest(old);
+    UA_TransferSubscriptionsResponse_init(&response);
+    Service_TransferSubscriptions(server, session, &request, &response);
+    ck_assert(SIMPLEQ_EMPTY(&old->responseQueue));
+    ck_assert_uint_eq(response.results[0].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_uint_eq(response.results[0].availableSequenceNumbersSize, 1);
+    ck_assert_uint_eq(response.results[0].availableSequenceNumbers[0], 1);
+    UA_TransferSubscriptionsResponse_deleteMembers(&response);
+    ck_assert_ptr_eq(sub->session, session);
+    ck_assert_ptr_eq(UA_Session_getSubscriptionByID(session, id), sub);
+    ck_assert_ptr_eq(UA_Session_getSubscriptionByID(old, id), NULL);
+    ck_assert(!mon->lastSampled);
+
+    /* the memory and the retransmissions moved along */
+    ck_assert_uint_eq(old->memory.subscriptions, 0);
+    ck_assert_uint_eq(old->memory.samples, 0);
+    ck_assert_uint_eq(old->memory.retransmissions, 0);
+    ck_assert_uint_eq(old->retransmissionQueueSize, 0);
+    ck_assert(TAILQ_EMPTY(&old->retransmissionQueue));
+    ck_assert_uint_eq(session->memory.subscriptions, memory.subscriptions);
+    ck_assert_uint_eq(session->memory.samples, memory.samples);
+    ck_assert_uint_eq(session->memory.retransmissions, memory.retransmissions);
+    ck_assert_uint_eq(session->retransmissionQueueSize, 1);
+    UA_Session_deleteSubscription(server, session, id);
+    ck_assert_uint_eq(UA_Session_memoryUsage(session), 0);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(Session_retransmission_KeepsQueueForOversizedMessage)
+{
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_VariableAttributes attr;
+    UA_VariableAttributes_init(&attr);
+    UA_Double value = 1.0;
+    UA_Variant_setScalar(&attr.value, &value, &UA_TYPES[UA_TYPES_DOUBLE]);
+    const UA_NodeId nodeId = UA_NODEID_NUMERIC(1, 5004);
+    UA_StatusCode retval =
+        UA_Server_addVariableNode(server, nodeId, UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                  UA_QUALIFIEDNAME(1, "oversized"), UA_NODEID_NULL, attr, NULL, NULL);
+    ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+
+    UA_Connection connection;
+    memset(&connection, 0, sizeof(UA_Connection));
+    connection.localConf = UA_ConnectionConfig_standard;
+    connection.remoteConf = UA_ConnectionConfig_standard;
+    connection.getSendBuffer = allocSendBuffer;
+    connection.send = dropSend;
+    UA_SecureChannel channel;
+    UA_SecureChannel_init(&channel);
+    channel.connection = &connection;
+
+    UA_CreateSessionRequest csr;
+    UA_CreateSessionRequest_init(&csr);
+    UA_Session *session;
+    ck_assert_uint_eq(UA_SessionManager_createSession(&server->sessionManager, NULL, &csr, &session),
+                      UA_STATUSCODE_GOOD);
+    session->channel = &channel;
+
+    UA_Subscription *sub = newKeepAliveSubscription(session, 1, 0);
+    sub->publishingEnabled = true;
+    UA_MonitoredItem *mon = newSampledItem(sub, 100.0);
+    MonitoredItem_setQueueSize(mon, 2);
+    UA_NodeId_copy(&nodeId, &mon->monitoredNodeId);
+    ck_assert_uint_eq(MonitoredItem_registerSampleJob(server, mon), UA_STATUSCODE_GOOD);
+    writeAndSample(server, mon->sampler, nodeId, 2.0);
+    queuePublishRequest(session);
+    UA_Subscription_publishCallback(server, sub);
+    ck_assert_uint_eq(sub->retransmissionQueueSize, 1);
+    size_t retransmissions = session->memory.retransmissions;
+
+    /* the next message alone exceeds the quota. It is not kept and the queued
+     * message stays available. */
+    writeAndSample(server, mon->sampler, nodeId, 3.0);
+    server->config.maxSubscriptionMemory = 1;
+    queuePublishRequest(session);
+    UA_Subscription_publishCallback(server, sub);
+    ck_assert_uint_eq(sub->retransmissionQueueSize, 1);
+    ck_assert_uint_eq(TAILQ_FIRST(&sub->retransmissionQueue)->sequenceNumber, 1);
+    ck_assert_uint_eq(session->memory.retransmissions, retransmissions);
+    ck_assert_uint_eq(session->memory.discarded, 1);
+
+    server->config.maxSubscriptionMemory = 0;
+    UA_Server_delete(server);
+}
+END_TEST
+#endif
+#endif
+
+#define CHANNELS 300
+
+START_TEST(SecureChannelManager_manyChannels_ShallWork)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.maxSecureChannels = CHANNELS;
+    UA_Server *server = UA_Server_new(config);
+    UA_SecureChannelManager cm;
+    UA_SecureChannelManager_init(&cm, server);
+
+    /* every tenth channel gets a shorter lifetime */
+    UA_Connection *connections = UA_malloc(sizeof(UA_Connection) * CHANNELS);
+    UA_UInt32 channelIds[CHANNELS];
+    for(size_t i = 0; i < CHANNELS; i++) {
+        UA_Connection_init(&connections[i]);
+        UA_OpenSecureChannelRequest request;
+        UA_OpenSecureChannelRequest_init(&request);
+        request.securityMode = UA_MESSAGESECURITYMODE_NONE;
+        request.requestedLifetime = (i % 10 == 0) ? 1000 : 100000;
+        UA_OpenSecureChannelResponse response;
+        UA_OpenSecureChannelResponse_init(&response);
+        UA_StatusCode retval = UA_SecureChannelManager_open(&cm, &connections[i], &request, &response);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+        channelIds[i] = response.securityToken.channelId;
+        UA_OpenSecureChannelResponse_deleteMembers(&response);
+    }
+    ck_assert_uint_eq(cm.channels.size, CHANNELS);
+    for(size_t i = 0; i < CHANNELS; i++)
+        ck_assert_ptr_eq(UA_SecureChannelManager_get(&cm, channelIds[i]), connections[i].channel);
+
+    /* close and detach some channels */
+    ck_assert_uint_eq(UA_SecureChannelManager_close(&cm, channelIds[1]), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(UA_SecureChannelManager_get(&cm, channelIds[1]), NULL);
+    ck_assert_uint_ne(UA_SecureChannelManager_close(&cm, channelIds[1]), UA_STATUSCODE_GOOD);
+    UA_SecureChannel *detached = connections[2].channel;
+    UA_Connection_detachSecureChannel(&connections[2]);
+    UA_SecureChannelManager_detached(&cm, detached);
+
+    /* the detached channel is removed right away, then those with the short lifetime */
+    UA_DateTime now = UA_DateTime_now();
+    UA_SecureChannelManager_cleanupTimedOut(&cm, now);
+    ck_assert_uint_eq(cm.channels.size, CHANNELS - 2);
+    ck_assert_ptr_eq(UA_SecureChannelManager_get(&cm, channelIds[2]), NULL);
+    UA_SecureChannelManager_cleanupTimedOut(&cm, now + 10 * UA_SEC_TO_DATETIME);
+    ck_assert_uint_eq(cm.channels.size, CHANNELS - 2 - (CHANNELS / 10));
+    ck_assert_ptr_eq(UA_SecureChannelManager_get(&cm, channelIds[0]), NULL);
+    ck_assert_ptr_eq(UA_SecureChannelManager_get(&cm, channelIds[3]), connections[3].channel);
+    UA_SecureChannelManager_cleanupTimedOut(&cm, now + 1000 * UA_SEC_TO_DATETIME);
+    ck_assert_uint_eq(cm.channels.size, 0);
+
+    UA_SecureChannelManager_deleteMembers(&cm);
+    UA_free(connections);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(SessionManager_manySessions_ShallWork)
+{
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.maxSessions = CHANNELS;
+    UA_Server *server = UA_Server_new(config);
+    UA_SessionManager sm;
+    UA_SessionManager_init(&sm, server);
+
+    /* every tenth session gets a shorter timeout */
+    UA_Session *sessions[CHANNELS];
+    for(size_t i = 0; i < CHANNELS; i++) {
+        UA_CreateSessionRequest request;
+        UA_CreateSessionRequest_init(&request);
+        request.requestedSessionTimeout = (i % 10 == 0) ? 1000 : 100000;
+        UA_StatusCode retval = UA_SessionManager_createSession(&sm, NULL, &request, &sessions[i]);
+        ck_assert_uint_eq(retval, UA_STATUSCODE_GOOD);
+    }
+    UA_Session *session;
+    UA_CreateSessionRequest request;
+    UA_CreateSessionRequest_init(&request);
+    ck_assert_uint_eq(UA_SessionManager_createSession(&sm, NULL, &request, &session),
+                      UA_STATUSCODE_BADTOOMANYSESSIONS);
+    for(size_t i = 0; i < CHANNELS; i++)
+        ck_assert_ptr_eq(UA_SessionManager_getSession(&sm, &sessions[i]->authenticationToken), sessions[i]);
+
+    UA_NodeId token;
+    UA_NodeId_copy(&sessions[1]->authenticationToken, &token);
+    ck_assert_uint_eq(UA_SessionManager_removeSession(&sm, &token), UA_STATUSCODE_GOOD);
+    ck_assert_ptr_eq(UA_SessionManager_getSession(&sm, &token), NULL);
+    ck_assert_uint_ne(UA_SessionManager_removeSession(&sm, &token), UA_STATUSCODE_GOOD);
+    UA_NodeId_deleteMembers(&token);
+
+    /* a short session that was used lives on */
+    UA_DateTime now = server->now;
+    UA_Session_updateLifetime(sessions[10], now + 50 * UA_SEC_TO_DATETIME);
+    UA_SessionManager_cleanupTimedOut(&sm, now + 10 * UA_SEC_TO_DATETIME);
+    ck_assert_uint_eq(sm.sessions.size, CHANNELS - 1 - (CHANNELS / 10) + 1);
+    ck_assert_ptr_eq(UA_SessionManager_getSession(&sm, &sessions[10]->authenticationToken), sessions[10]);
+    UA_SessionManager_cleanupTimedOut(&sm, now + 1000 * UA_SEC_TO_DATETIME);
+    ck_assert_uint_eq(sm.sessions.size, 0);
+
+    UA_SessionManager_deleteMembers(&sm);
+    UA_Server_delete(server);
+}
+END_TEST
+
 static Suite* testSuite_Session(void) {
 	Suite *s = suite_create("Session");
 	TCase *tc_core = tcase_create("Core");
 	tcase_add_test(tc_core, Session_init_ShallWork);
 	tcase_add_test(tc_core, Session_updateLifetime_ShallWork);
+	tcase_add_test(tc_core, Session_admitRequest_LimitsRate);
+	tcase_add_test(tc_core, SecureChannelManager_manyChannels_ShallWork);
+	tcase_add_test(tc_core, SessionManager_manySessions_ShallWork);
+#ifdef UA_ENABLE_SUBSCRIPTIONS
+	tcase_add_test(tc_core, Session_samplingGroups_ShallShareInterval);
+	tcase_add_test(tc_core, Session_samplingGroups_NotifyWrittenValues);
+	tcase_add_test(tc_core, Session_samplingGroups_ReadSourcesWithoutLock);
+	tcase_add_test(tc_core, Session_monitoredItem_ResizeQueueRing);
+	tcase_add_test(tc_core, Session_publish_PrioritizesLateSubscriptions);
+#ifndef UA_ENABLE_MULTITHREADING
+	tcase_add_test(tc_core, Session_monitoredItem_DeadbandFilter);
+	tcase_add_test(tc_core, Session_memory_EnforcesQuota);
+	tcase_add_test(tc_core, Session_transferSubscriptions_MovesMemory);
+	tcase_add_test(tc_core, Session_retransmission_KeepsQueueForOversizedMessage);
+#endif
+#endif
 
 	suite_add_tcase(s,tc_core);
 	return s;
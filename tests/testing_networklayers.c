@@ -38,9 +38,11 @@ UA_Connection createDummyConnection(void) {
     c.sockfd = 0;
     c.handle = NULL;
     c.incompleteMessage = UA_BYTESTRING_NULL;
+    c.recvRing = NULL;
     c.getSendBuffer = dummyGetSendBuffer;
     c.releaseSendBuffer = dummyReleaseSendBuffer;
     c.send = dummySend;
+    c.sendBatch = NULL;
     c.recv = NULL;
     c.releaseRecvBuffer = dummyReleaseRecvBuffer;
     c.close = dummyClose;
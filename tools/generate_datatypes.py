@@ -315,6 +315,145 @@ def parseTypeDescriptions(filename, namespaceid):
             definitions[row[0]] = TypeDescription(row[0], row[1], namespaceid)
     return definitions
 
+############################
+# Specialized En/Decoding #
+############################
+
+# Member types that are en/decoded with a builtin function of
+# ua_types_encoding_binary.c. Gives the function prefix and the C type of the
+# argument. Float and Double are macros for the integer functions on some
+# architectures and take a void pointer.
+builtin_encoding = {"Boolean": ("Boolean", "UA_Boolean"), "SByte": ("Byte", "UA_Byte"),
+                    "Byte": ("Byte", "UA_Byte"), "Int16": ("UInt16", "UA_UInt16"),
+                    "UInt16": ("UInt16", "UA_UInt16"), "Int32": ("UInt32", "UA_UInt32"),
+                    "UInt32": ("UInt32", "UA_UInt32"), "Int64": ("UInt64", "UA_UInt64"),
+                    "UInt64": ("UInt64", "UA_UInt64"), "Float": ("Float", "void"),
+                    "Double": ("Double", "void"), "String": ("String", "UA_String"),
+                    "DateTime": ("UInt64", "UA_UInt64"), "Guid": ("Guid", "UA_Guid"),
+                    "ByteString": ("String", "UA_String"), "XmlElement": ("String", "UA_String"),
+                    "NodeId": ("NodeId", "UA_NodeId"), "ExpandedNodeId": ("ExpandedNodeId", "UA_ExpandedNodeId"),
+                    "StatusCode": ("UInt32", "UA_UInt32"), "LocalizedText": ("LocalizedText", "UA_LocalizedText"),
+                    "ExtensionObject": ("ExtensionObject", "UA_ExtensionObject"),
+                    "DataValue": ("DataValue", "UA_DataValue"), "Variant": ("Variant", "UA_Variant"),
+                    "DiagnosticInfo": ("DiagnosticInfo", "UA_DiagnosticInfo")}
+
+def member_builtin(t):
+    if t.name in builtin_encoding:
+        return builtin_encoding[t.name]
+    if type(t) == EnumerationType:
+        return ("UInt32", "UA_UInt32")
+    if type(t) == OpaqueType:
+        return ("String", "UA_String")
+    return None
+
+def member_arg(t, name, const):
+    "The pointer to the member, casted to the argument type of the builtin function"
+    (prefix, ctype) = member_builtin(t)
+    q = "const " if const else ""
+    p = ("&src->" if const else "&dst->") + name
+    if ctype == "UA_" + t.name:
+        return p
+    return "(%s%s*)%s" % (q, ctype, p)
+
+def member_runs(t):
+    """Group the members into runs of overlayable members that follow each other
+    without padding. A run is en/decoded with a single memcpy. Returns a list of
+    (members, condition) tuples. The condition is None for single members."""
+    runs = []
+    run = []
+    for m in t.members + [None]:
+        if m and not m.isArray and m.memberType.overlayable != "false":
+            run.append(m)
+            continue
+        if len(run) > 1:
+            conds = []
+            for r in run:
+                if not "(%s)" % r.memberType.overlayable in conds:
+                    conds.append("(%s)" % r.memberType.overlayable)
+            cond = " && ".join(conds)
+            for a, b in zip(run, run[1:]):
+                cond += " &&\n       offsetof(UA_%s, %s) == offsetof(UA_%s, %s) + sizeof(UA_%s)" % \
+                        (t.name, b.name, t.name, a.name, a.memberType.name)
+            runs.append((run, cond))
+        elif len(run) == 1:
+            runs.append((run, None))
+        run = []
+        if m:
+            runs.append(([m], None))
+    return runs
+
+def run_size(run):
+    return " + ".join(["sizeof(UA_%s)" % m.memberType.name for m in run])
+
+def encode_member_c(t, m):
+    if m.isArray:
+        return "    retval = Array_encodeBinary(src->%s, src->%sSize, %s, ctx);\n" % \
+            (m.name, m.name, m.memberType.datatype_ptr()) + \
+            "    if(retval != UA_STATUSCODE_GOOD)\n        return retval;"
+    if member_builtin(m.memberType):
+        return "    UA_ENCODE_MEMBER(%s_encodeBinary(%s, NULL, ctx));" % \
+            (member_builtin(m.memberType)[0], member_arg(m.memberType, m.name, True))
+    if m.memberType.name in specialized_types:
+        return "    UA_ENCODE_MEMBER(%s_encodeBinary(&src->%s, NULL, ctx));" % (m.memberType.name, m.name)
+    return "    UA_ENCODE_MEMBER(UA_encodeBinaryInternal(&src->%s, %s, ctx));" % (m.name, m.memberType.datatype_ptr())
+
+def decode_member_c(t, m):
+    if m.isArray:
+        return "    length = -1;\n    retval |= Int32_decodeBinary(&length, ctx);\n" + \
+            "    retval |= Array_decodeBinary(length, (void**)&dst->%s, &dst->%sSize, %s, ctx);" % \
+            (m.name, m.name, m.memberType.datatype_ptr())
+    if member_builtin(m.memberType):
+        return "    retval |= %s_decodeBinary(%s, NULL, ctx);" % \
+            (member_builtin(m.memberType)[0], member_arg(m.memberType, m.name, False))
+    if m.memberType.name in specialized_types:
+        return "    retval |= %s_decodeBinary(&dst->%s, NULL, ctx);" % (m.memberType.name, m.name)
+    return "    retval |= UA_decodeBinaryInternal(&dst->%s, %s, ctx);" % (m.name, m.memberType.datatype_ptr())
+
+def calcsize_member_c(t, m):
+    if m.isArray:
+        return "Array_calcSizeBinary(src->%s, src->%sSize, %s)" % (m.name, m.name, m.memberType.datatype_ptr())
+    if m.memberType.fixed_size == "true":
+        return "sizeof(UA_%s)" % m.memberType.name
+    if member_builtin(m.memberType):
+        return "%s_calcSizeBinary(%s, NULL)" % \
+            (member_builtin(m.memberType)[0], member_arg(m.memberType, m.name, True))
+    if m.memberType.name in specialized_types:
+        return "%s_calcSizeBinary(&src->%s, NULL)" % (m.memberType.name, m.name)
+    return "UA_calcSizeBinaryInternal(&src->%s, %s)" % (m.name, m.memberType.datatype_ptr())
+
+def specialized_c(t):
+    "Straight-line en/decoding and size computation for a structured type"
+    runs = member_runs(t)
+    enc = "static UA_StatusCode\n%s_encodeBinary(const UA_%s *src, const UA_DataType *_, Ctx *ctx) {\n" % (t.name, t.name)
+    enc += "    UA_StatusCode retval;\n"
+    dec = "static UA_StatusCode\n%s_decodeBinary(UA_%s *dst, const UA_DataType *_, Ctx *ctx) {\n" % (t.name, t.name)
+    dec += "    UA_StatusCode retval = UA_STATUSCODE_GOOD;\n"
+    if any(m.isArray for m in t.members):
+        dec += "    UA_Int32 length;\n"
+    calc = "static size_t\n%s_calcSizeBinary(const UA_%s *src, const UA_DataType *_) {\n" % (t.name, t.name)
+    calc += "    size_t s = 0;\n"
+    for (run, cond) in runs:
+        if not cond:
+            enc += encode_member_c(t, run[0]) + "\n"
+            dec += decode_member_c(t, run[0]) + "\n"
+            calc += "    s += %s;\n" % calcsize_member_c(t, run[0])
+            continue
+        first = run[0].name
+        enc += "    if(%s) {\n" % cond
+        enc += "        UA_ENCODE_MEMBER(encodeBytes((const UA_Byte*)&src->%s, %s, ctx));\n" % (first, run_size(run))
+        enc += "    } else {\n"
+        enc += "\n".join(["    " + encode_member_c(t, m) for m in run]) + "\n    }\n"
+        dec += "    if(%s) {\n" % cond
+        dec += "        retval |= decodeBytes((UA_Byte*)&dst->%s, %s, ctx);\n" % (first, run_size(run))
+        dec += "    } else {\n"
+        dec += "\n".join(["    " + decode_member_c(t, m) for m in run]) + "\n    }\n"
+        calc += "    s += %s;\n" % run_size(run)
+    enc += "    return UA_STATUSCODE_GOOD;\n}\n"
+    dec += "    if(retval != UA_STATUSCODE_GOOD)\n        decodeDeleteMembers(dst, %s, ctx);\n" % t.datatype_ptr()
+    dec += "    return retval;\n}\n"
+    calc += "    return s;\n}"
+    return enc + "\n" + dec + "\n" + calc
+
 ###############################
 # Parse the Command Line Input#
 ###############################
@@ -322,7 +461,10 @@ def parseTypeDescriptions(filename, namespaceid):
 parser = argparse.ArgumentParser()
 parser.add_argument('--typedescriptions', help='csv file with type descriptions')
 parser.add_argument('--namespace', type=int, default=0, help='namespace id of the generated type nodeids (defaults to 0)')
-parser.add_argument('--selected_types', help='file with list of types (among those parsed) to be generated')
+parser.add_argument('--selected_types', action='append',
+                    help='file with list of types (among those parsed) to be generated. can be repeated. '
+                         'the member types of the selected types are generated as well.')
+parser.add_argument('--specialized_types', help='file with list of structured types that get generated en/decoding functions')
 parser.add_argument('typexml_ns0', help='path/to/Opc.Ua.Types.bsd ...')
 parser.add_argument('typexml_additional', nargs='*', help='path/to/Opc.Ua.Types.bsd ...')
 parser.add_argument('outfile', help='output file w/o extension')
@@ -350,8 +492,26 @@ if args.typedescriptions:
 
 selected_types = types.keys()
 if args.selected_types:
-    with open(args.selected_types) as f:
-        selected_types = filter(len, [line.strip() for line in f])
+    selected = set()
+    for filename in args.selected_types:
+        with open(filename) as f:
+            selected.update(filter(len, [line.strip() for line in f]))
+    # Add the member types that are generated in the same file
+    pending = list(selected)
+    while len(pending) > 0:
+        t = types[pending.pop()]
+        for m in t.members:
+            if m.memberType.outname == outname and not m.memberType.name in selected:
+                selected.add(m.memberType.name)
+                pending.append(m.memberType.name)
+    selected_types = [n for n in types if n in selected]
+
+specialized_types = []
+if args.specialized_types:
+    with open(args.specialized_types) as f:
+        specialized_types = filter(len, [line.strip() for line in f])
+    specialized_types = [n for n in specialized_types if n in selected_types and len(types[n].members) > 0 and \
+                         (type(types[n]) == StructType or n == "QualifiedName")]
 
 #############################
 # Write out the Definitions #
@@ -462,3 +622,68 @@ printc("};\n")
 fh.close()
 fc.close()
 fe.close()
+
+if not args.specialized_types:
+    sys.exit(0)
+
+# The specialized functions use the internal functions of
+# ua_types_encoding_binary.c and are included at the end of that file.
+fs = open(args.outfile + "_generated_encoding_specialized.inc",'w')
+def prints(string):
+    print(string, end='\n', file=fs)
+
+prints('''/* Generated from ''' + inname + ''' with script ''' + sys.argv[0] + '''
+ * on host ''' + platform.uname()[1] + ''' by user ''' + getpass.getuser() + \
+       ''' at ''' + time.strftime("%Y-%m-%d %I:%M:%S") + ''' */''')
+
+if sys.version_info[0] < 3:
+    values = types.itervalues()
+else:
+    values = types.values()
+
+# Types are parsed after their members. So the callees are defined first.
+specialized = [t for t in values if t.name in specialized_types]
+for t in specialized:
+    prints("")
+    prints("/* " + t.name + " */")
+    prints(specialized_c(t))
+
+for (table, kind) in [("encode", "encodeBinarySignature"), ("decode", "decodeBinarySignature"),
+                      ("calcSize", "calcSizeBinarySignature")]:
+    prints("static const UA_%s %sBinarySpecialized[%s_COUNT] = {" % (kind, table, outname.upper()))
+    for t in specialized:
+        prints("    [%s] = (UA_%s)%s_%sBinary," % (t.typeIndex, kind, t.name, table))
+    prints("};\n")
+
+# Hash map from the numeric typeId to the index in the type array. Open
+# addressing with linear probing. The entries are index+1, zero is empty.
+if sys.version_info[0] < 3:
+    values = types.itervalues()
+else:
+    values = types.values()
+typeids = []
+for t in values:
+    if not t.name in selected_types:
+        continue
+    nodeid = 0
+    if t.name in typedescriptions:
+        nodeid = int(typedescriptions[t.name].nodeid)
+    typeids.append(nodeid)
+hashbits = 1
+while (1 << hashbits) < 2 * len(typeids):
+    hashbits += 1
+hashmap = [0] * (1 << hashbits)
+for index, nodeid in enumerate(typeids):
+    if nodeid == 0 or nodeid in typeids[:index]:
+        continue
+    slot = ((nodeid * 2654435761) & 0xffffffff) >> (32 - hashbits)
+    while hashmap[slot] != 0:
+        slot = (slot + 1) & ((1 << hashbits) - 1)
+    hashmap[slot] = index + 1
+prints("#define %s_TYPEIDHASHBITS %s" % (outname.upper(), hashbits))
+prints("static const UA_UInt16 typeIdHashMap[1 << %s_TYPEIDHASHBITS] = {" % outname.upper())
+for i in range(0, len(hashmap), 16):
+    prints("    " + ", ".join([str(x) for x in hashmap[i:i+16]]) + ",")
+prints("};")
+
+fs.close()
@@ -25,7 +25,7 @@ from open62541_XMLPreprocessor import open62541_XMLPreprocessor
 
 def usage():
   print("Script usage:")
-  print("generate_open62541CCode [-i <ignorefile> | -b <blacklistfile>] <namespace XML> [namespace.xml[ namespace.xml[...]]] <output file>\n")
+  print("generate_open62541CCode [-i <ignorefile> | -b <blacklistfile>] [--static] <namespace XML> [namespace.xml[ namespace.xml[...]]] <output file>\n")
   print("generate_open62541CCode will first read all XML files passed on the command line, then ")
   print("link and check the namespace. All nodes that fullfill the basic requirements will then be")
   print("printed as C-Code intended to be included in the open62541 OPC-UA Server that will")
@@ -45,6 +45,8 @@ def usage():
   print("""   -s <attribute>  Suppresses the generation of some node attributes. Currently supported
                        options are 'description', 'browseName', 'displayName', 'writeMask', 'userWriteMask'
                        and 'nodeid'.""")
+  print("""   --static        Prints the nodes as a table of constant nodes that the server uses
+                       without copying them to the heap (see UA_Server_addStaticNodes).""")
   print("""   namespaceXML Any number of namespace descriptions in XML format. Note that the
                        last description of a node encountered will be used and all prior definitions
                        are discarded.""")
@@ -56,6 +58,7 @@ if __name__ == '__main__':
   ignoreFiles = []
   blacklistFiles = []
   supressGenerationOfAttribute=[]
+  printStatic = False
 
   GLOBAL_LOG_LEVEL = LOG_LEVEL_DEBUG
   
@@ -94,6 +97,8 @@ if __name__ == '__main__':
         arg_isBlacklist = True
       elif filename.lower() == "-s" or filename.lower() == "--suppress" :
         arg_isSupress = True
+      elif filename.lower() == "--static" :
+        printStatic = True
       else:
         log(None, "File " + str(filename) + " does not exist.", LOG_LEVEL_ERROR)
         usage()
@@ -191,7 +196,10 @@ if __name__ == '__main__':
   # Create the C Code
   log(None, "Generating Header", LOG_LEVEL_INFO)
   # Returns a tuple of (["Header","lines"],["Code","lines","generated"])
-  generatedCode=ns.printOpen62541Header(ignoreNodes, supressGenerationOfAttribute, outfilename=path.basename(argv[-1]))
+  if printStatic:
+    generatedCode=ns.printOpen62541Static(ignoreNodes, supressGenerationOfAttribute, outfilename=path.basename(argv[-1]))
+  else:
+    generatedCode=ns.printOpen62541Header(ignoreNodes, supressGenerationOfAttribute, outfilename=path.basename(argv[-1]))
   for line in generatedCode[0]:
     outfileh.write(line+"\n")
   for line in generatedCode[1]:
@@ -0,0 +1,302 @@
+#!/usr/bin/env/python
+# -*- coding: utf-8 -*-
+
+###
+### This program was created for educational purposes and has been
+### contributed to the open62541 project by the author. All licensing
+### terms for this source is inherited by the terms and conditions
+### specified for by the open62541 project (see the projects readme
+### file for more information on the LGPL terms and restrictions).
+###
+### This program is not meant to be used in a production environment. The
+### author is not liable for any complications arising due to the use of
+### this program.
+###
+
+from logger import *
+from ua_constants import *
+from ua_builtin_types import opcua_value_t
+
+# The C types of the builtin values that can be printed as constant initializers
+staticValueTypes = {
+  BUILTINTYPE_TYPEID_BOOLEAN: "Boolean",
+  BUILTINTYPE_TYPEID_SBYTE:   "SByte",
+  BUILTINTYPE_TYPEID_BYTE:    "Byte",
+  BUILTINTYPE_TYPEID_INT16:   "Int16",
+  BUILTINTYPE_TYPEID_UINT16:  "UInt16",
+  BUILTINTYPE_TYPEID_INT32:   "Int32",
+  BUILTINTYPE_TYPEID_UINT32:  "UInt32",
+  BUILTINTYPE_TYPEID_INT64:   "Int64",
+  BUILTINTYPE_TYPEID_UINT64:  "UInt64",
+  BUILTINTYPE_TYPEID_FLOAT:   "Float",
+  BUILTINTYPE_TYPEID_DOUBLE:  "Double",
+  BUILTINTYPE_TYPEID_STRING:  "String"
+}
+
+# Same order as the UA_NodeIdType enum
+NODEIDTYPE_NUMERIC = 0
+NODEIDTYPE_STRING  = 3
+NODEIDTYPE_GUID    = 4
+
+def toBytes(s):
+  """ Returns the UTF-8 encoding of a (unicode) string """
+  try:
+    if isinstance(s, unicode):
+      return s.encode('utf-8')
+  except NameError:
+    if isinstance(s, str):
+      return s.encode('utf-8')
+  return s
+
+class open62541_StaticHelper():
+  """ Prints a nodeset as a table of constant nodes for UA_Server_addStaticNodes.
+
+      The nodes are sorted in the order of UA_NodeId_order and the references
+      of every node in the order of UA_ReferenceNode_order. The references
+      between the printed nodes are emitted in both directions.
+      Nodes outside the table are linked back when the table is added to the
+      server.
+  """
+  def __init__(self, supressGenerationOfAttribute=[]):
+    self.supressGenerationOfAttribute = supressGenerationOfAttribute
+
+  def getCString(self, s):
+    """ Returns the C literal for UA_String {length, data} of a string """
+    data = toBytes(s)
+    if len(data) == 0:
+      return "{0, NULL}"
+    literal = ""
+    for c in bytearray(data):
+      if c < 32 or c > 126 or chr(c) in "\"\\?":
+        literal = literal + "\\%03o" % c
+      else:
+        literal = literal + chr(c)
+    return "{" + str(len(data)) + ", (UA_Byte*)\"" + literal + "\"}"
+
+  def getGuidParts(self, nodeid):
+    """ Returns data1, data2, data3 and the eight bytes of data4 """
+    g = nodeid.g
+    data4 = [(g[3] >> 8) & 0xff, g[3] & 0xff]
+    for i in range(5, -1, -1):
+      data4.append((g[4] >> (8 * i)) & 0xff)
+    return (g[0], g[1], g[2], data4)
+
+  def getNodeIdOrder(self, nodeid):
+    """ Sort key that matches UA_NodeId_order """
+    if nodeid.i != None:
+      return (nodeid.ns, NODEIDTYPE_NUMERIC, nodeid.i)
+    if nodeid.g != None:
+      (d1, d2, d3, d4) = self.getGuidParts(nodeid)
+      return (nodeid.ns, NODEIDTYPE_GUID, d1, d2, d3, d4)
+    data = toBytes(nodeid.s)
+    return (nodeid.ns, NODEIDTYPE_STRING, len(data), data)
+
+  def isPrintable(self, nodeid):
+    return nodeid != None and (nodeid.i != None or nodeid.g != None or nodeid.s != None)
+
+  def getNodeId(self, nodeid):
+    if nodeid.i != None:
+      return "{" + str(nodeid.ns) + ", UA_NODEIDTYPE_NUMERIC, {.numeric = " + str(nodeid.i) + "}}"
+    if nodeid.g != None:
+      (d1, d2, d3, d4) = self.getGuidParts(nodeid)
+      return "{" + str(nodeid.ns) + ", UA_NODEIDTYPE_GUID, {.guid = {" + hex(d1) + ", " + hex(d2) + ", " + \
+             hex(d3) + ", {" + ", ".join([hex(b) for b in d4]) + "}}}}"
+    return "{" + str(nodeid.ns) + ", UA_NODEIDTYPE_STRING, {.string = " + self.getCString(nodeid.s) + "}}"
+
+  def getLocalizedText(self, text):
+    if len(text) == 0:
+      return "{{0, NULL}, {0, NULL}}"
+    return "{" + self.getCString("en_US") + ", " + self.getCString(text) + "}"
+
+  def getBoolean(self, b):
+    if b:
+      return "true"
+    return "false"
+
+  def getReferences(self, nodes):
+    """ Returns a dict from each node to its sorted list of (referenceType, target, isInverse).
+        References are added in both directions if source and target are printed. """
+    refs = {}
+    seen = {}
+    for n in nodes:
+      refs[n] = []
+      seen[n] = set()
+    def addRef(src, reftype, tgt, isInverse):
+      key = (str(reftype.id()), str(tgt.id()), isInverse)
+      if key in seen[src]:
+        return
+      seen[src].add(key)
+      refs[src].append((reftype, tgt, isInverse))
+    for n in nodes:
+      for r in n.getReferences():
+        if r.target() == None or r.referenceType() == None:
+          continue
+        if not self.isPrintable(r.target().id()) or not self.isPrintable(r.referenceType().id()):
+          continue
+        addRef(n, r.referenceType(), r.target(), not r.isForward())
+        if r.target() in refs:
+          addRef(r.target(), r.referenceType(), n, r.isForward())
+    for n in nodes:
+      refs[n].sort(key=lambda r: (self.getNodeIdOrder(r[0].id()), r[2], self.getNodeIdOrder(r[1].id())))
+    return refs
+
+  def getValue(self, node, name):
+    """ Returns the declaration of the value data and the designated initializer of
+        the variant. Values that cannot be printed as constants are left empty. """
+    if node.dataType() == None or node.dataType().target() == None:
+      return ([], None)
+    if not node.dataType().target().isEncodable() or node.value() == None:
+      return ([], None)
+    values = node.value().value
+    if not isinstance(values, list) or len(values) == 0 or not isinstance(values[0], opcua_value_t):
+      return ([], None)
+    typeId = values[0].__binTypeId__
+    if not typeId in staticValueTypes:
+      log(self, "Cannot print a constant value of type " + values[0].stringRepresentation +
+          " in node " + str(node.id()) + ". The value is left empty.", LOG_LEVEL_WARN)
+      return ([], None)
+    ctype = staticValueTypes[typeId]
+    elements = []
+    for v in values:
+      if typeId == BUILTINTYPE_TYPEID_STRING:
+        elements.append(self.getCString(v.value))
+        continue
+      literal = str(v.value)
+      if literal.lower() in ["inf", "-inf", "nan"]:
+        log(self, "Cannot print the value " + literal + " in node " + str(node.id()), LOG_LEVEL_WARN)
+        return ([], None)
+      if typeId == BUILTINTYPE_TYPEID_INT64:
+        literal = literal + "LL"
+      elif typeId == BUILTINTYPE_TYPEID_UINT64:
+        literal = literal + "ULL"
+      elements.append("(UA_" + ctype + ") " + literal)
+    variant = ".type = &UA_TYPES[UA_TYPES_" + ctype.upper() + "], .storageType = UA_VARIANT_DATA_NODELETE"
+    if node.valueRank() >= 0 or len(values) > 1:
+      decl = ["static const UA_" + ctype + " " + name + "[" + str(len(elements)) + "] = {" + ", ".join(elements) + "};"]
+      variant = variant + ", .arrayLength = " + str(len(elements)) + ", .data = (void*)(uintptr_t)" + name
+    else:
+      decl = ["static const UA_" + ctype + " " + name + " = " + elements[0] + ";"]
+      variant = variant + ", .data = (void*)(uintptr_t)&" + name
+    return (decl, "{" + variant + "}")
+
+  def getNodeClassMembers(self, node, code):
+    """ Returns the initializers of the nodeclass specific members. The
+        declarations needed for them are appended to code. """
+    nc = node.nodeClass()
+    members = []
+    if nc == NODE_CLASS_OBJECT:
+      members.append(".eventNotifier = " + str(node.eventNotifier()))
+    elif nc == NODE_CLASS_VARIABLE:
+      (decl, variant) = self.getValue(node, node.getCodePrintableID() + "_value")
+      code.extend(decl)
+      members.append(".valueRank = " + str(node.valueRank()))
+      members.append(".valueSource = UA_VALUESOURCE_VARIANT")
+      if variant != None:
+        members.append(".value.variant.value = " + variant)
+      members.append(".accessLevel = " + str(node.accessLevel()))
+      members.append(".userAccessLevel = " + str(node.userAccessLevel()))
+      members.append(".minimumSamplingInterval = " + repr(float(node.minimumSamplingInterval())))
+      members.append(".historizing = " + self.getBoolean(node.historizing()))
+    elif nc == NODE_CLASS_METHOD:
+      members.append(".executable = " + self.getBoolean(node.executable()))
+      members.append(".userExecutable = " + self.getBoolean(node.userExecutable()))
+    elif nc == NODE_CLASS_OBJECTTYPE or nc == NODE_CLASS_DATATYPE:
+      members.append(".isAbstract = " + self.getBoolean(node.isAbstract()))
+    elif nc == NODE_CLASS_VARIABLETYPE:
+      members.append(".valueRank = " + str(node.valueRank()))
+      members.append(".valueSource = UA_VALUESOURCE_VARIANT")
+      members.append(".isAbstract = " + self.getBoolean(node.isAbstract()))
+    elif nc == NODE_CLASS_REFERENCETYPE:
+      members.append(".isAbstract = " + self.getBoolean(node.isAbstract()))
+      members.append(".symmetric = " + self.getBoolean(node.symmetric()))
+      members.append(".inverseName = " + self.getLocalizedText(node.inverseName()))
+    elif nc == NODE_CLASS_VIEW:
+      members.append(".eventNotifier = " + str(node.eventNotifier()))
+      members.append(".containsNoLoops = " + self.getBoolean(node.containsNoLoops()))
+    return members
+
+  def getNodeType(self, node):
+    return {NODE_CLASS_OBJECT: "Object", NODE_CLASS_VARIABLE: "Variable",
+            NODE_CLASS_METHOD: "Method", NODE_CLASS_OBJECTTYPE: "ObjectType",
+            NODE_CLASS_VARIABLETYPE: "VariableType", NODE_CLASS_REFERENCETYPE: "ReferenceType",
+            NODE_CLASS_DATATYPE: "DataType", NODE_CLASS_VIEW: "View"}.get(node.nodeClass())
+
+  def printNode(self, node, refs):
+    code = []
+    nodeName = node.getCodePrintableID()
+    code.append("")
+    code.append("/* " + str(node.id()) + ", " + str(node.browseName()) + " */")
+    if len(refs) > 0:
+      code.append("static const UA_ReferenceNode " + nodeName + "_refs[" + str(len(refs)) + "] = {")
+      for (reftype, target, isInverse) in refs:
+        code.append("    {.referenceTypeId = " + self.getNodeId(reftype.id()) + ", .isInverse = " +
+                    self.getBoolean(isInverse) + ", .targetId = {.nodeId = " + self.getNodeId(target.id()) + "}},")
+      code.append("};")
+    members = self.getNodeClassMembers(node, code)
+
+    nodetype = self.getNodeType(node)
+    code.append("static const UA_" + nodetype + "Node " + nodeName + " = {")
+    code.append("    .nodeId = " + self.getNodeId(node.id()) + ",")
+    code.append("    .nodeClass = UA_NODECLASS_" + nodetype.upper() + ",")
+    if not "browsename" in self.supressGenerationOfAttribute:
+      extrNs = node.browseName().split(":")
+      if len(extrNs) > 1:
+        code.append("    .browseName = {" + str(extrNs[0]) + ", " + self.getCString(extrNs[1]) + "},")
+      else:
+        code.append("    .browseName = {0, " + self.getCString(node.browseName()) + "},")
+    if not "displayname" in self.supressGenerationOfAttribute:
+      code.append("    .displayName = " + self.getLocalizedText(node.displayName()) + ",")
+    if not "description" in self.supressGenerationOfAttribute:
+      code.append("    .description = " + self.getLocalizedText(node.description()) + ",")
+    if not "writemask" in self.supressGenerationOfAttribute:
+      code.append("    .writeMask = " + str(node.writeMask()) + ",")
+    if not "userwritemask" in self.supressGenerationOfAttribute:
+      code.append("    .userWriteMask = " + str(node.userWriteMask()) + ",")
+    if len(refs) > 0:
+      code.append("    .referencesSize = " + str(len(refs)) + ",")
+      code.append("    .references = (UA_ReferenceNode*)(uintptr_t)" + nodeName + "_refs,")
+    for m in members:
+      code.append("    " + m + ",")
+    code.append("};")
+    return code
+
+  def printStaticTable(self, nodes, namespaceIdentifiers, outfilename):
+    header = []
+    code = []
+    printable = []
+    for n in nodes:
+      if not self.isPrintable(n.id()) or self.getNodeType(n) == None:
+        log(self, "Node " + str(n) + " cannot be printed into a static table.", LOG_LEVEL_WARN)
+        continue
+      printable.append(n)
+    printable.sort(key=lambda n: self.getNodeIdOrder(n.id()))
+    refs = self.getReferences(printable)
+
+    header.append("extern const UA_StaticNodeTable " + outfilename + "_table;")
+    header.append("extern UA_StatusCode " + outfilename + "(UA_Server *server);\n")
+
+    for n in printable:
+      code = code + self.printNode(n, refs[n])
+
+    code.append("")
+    code.append("static const UA_Node * const " + outfilename + "_nodes[" + str(max(len(printable), 1)) + "] = {")
+    for n in printable:
+      code.append("    (const UA_Node*)&" + n.getCodePrintableID() + ",")
+    code.append("};")
+    code.append("")
+    code.append("static UA_Byte " + outfilename + "_hidden[" + str(max((len(printable) + 7) // 8, 1)) + "];")
+    code.append("")
+    code.append("const UA_StaticNodeTable " + outfilename + "_table = {")
+    code.append("    " + outfilename + "_nodes, " + str(len(printable)) + ", " + outfilename + "_hidden")
+    code.append("};")
+    code.append("")
+    code.append("UA_StatusCode " + outfilename + "(UA_Server *server) {")
+    for nsid in namespaceIdentifiers:
+      if nsid == 0 or nsid == 1:
+        continue
+      name = namespaceIdentifiers[nsid].replace("\"", "\\\"")
+      code.append("    UA_Server_addNamespace(server, \"" + toBytes(name) + "\");")
+    code.append("    return UA_Server_addStaticNodes(server, &" + outfilename + "_table);")
+    code.append("}")
+    log(self, str(len(printable)) + " nodes printed into the static table.", LOG_LEVEL_DEBUG)
+    return (header, code)
@@ -26,6 +26,7 @@ from ua_builtin_types import *;
 from ua_node_types import *;
 from ua_constants import *;
 from open62541_MacroHelper import open62541_MacroHelper
+from open62541_StaticHelper import open62541_StaticHelper
 
 def getNextElementNode(xmlvalue):
   if xmlvalue == None:
@@ -607,6 +608,48 @@ class opcua_namespace():
     log(self, "Nodes reordered.")
     return
   
+  def printOpen62541Preamble(self, outfilename):
+    """ Returns the beginning of the generated header and c-file """
+    header = []
+    code = []
+    header.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
+    code.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
+
+    header.append('#ifndef '+outfilename.upper()+'_H_')
+    header.append('#define '+outfilename.upper()+'_H_')
+    header.append('#ifdef UA_NO_AMALGAMATION')
+    header.append('#include "server/ua_server_internal.h"')
+    header.append('#include "server/ua_nodes.h"')
+    header.append('#include "ua_util.h"')
+    header.append('#include "ua_types.h"')
+    header.append('#include "ua_types_encoding_binary.h"')
+    header.append('#include "ua_types_generated_encoding_binary.h"')
+    header.append('#include "ua_transport_generated_encoding_binary.h"')
+    header.append('#else')
+    header.append('#include "open62541.h"')
+    header.append('#define NULL ((void *)0)')
+    header.append('#endif')
+
+    code.append('#include "'+outfilename+'.h"')
+    return (header, code)
+
+  def printOpen62541Static(self, printedExternally=[], supressGenerationOfAttribute=[], outfilename=""):
+    """ Prints the nodes as a table of constant nodes instead of code that
+        creates the nodes at runtime. The generated function adds the table
+        to the server with UA_Server_addStaticNodes. """
+    (header, code) = self.printOpen62541Preamble(outfilename)
+    nodes = []
+    for n in self.nodes:
+      if not n in printedExternally:
+        nodes.append(n)
+      else:
+        log(self, "Node " + str(n.id()) + " is being ignored.", LOG_LEVEL_DEBUG)
+    staticgen = open62541_StaticHelper(supressGenerationOfAttribute=supressGenerationOfAttribute)
+    (h, c) = staticgen.printStaticTable(nodes, self.namespaceIdentifiers, outfilename)
+    header = header + h
+    header.append("#endif /* "+outfilename.upper()+"_H_ */")
+    return (header, code + c)
+
   def printOpen62541Header(self, printedExternally=[], supressGenerationOfAttribute=[], outfilename=""):
     unPrintedNodes = []
     unPrintedRefs  = []
@@ -635,25 +678,7 @@ class opcua_namespace():
           unPrintedRefs.append(r)
 
     log(self, str(len(unPrintedNodes)) + " Nodes, " + str(len(unPrintedRefs)) +  "References need to get printed.", LOG_LEVEL_DEBUG)
-    header.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
-    code.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
-
-    header.append('#ifndef '+outfilename.upper()+'_H_')
-    header.append('#define '+outfilename.upper()+'_H_')
-    header.append('#ifdef UA_NO_AMALGAMATION')
-    header.append('#include "server/ua_server_internal.h"')
-    header.append('#include "server/ua_nodes.h"')
-    header.append('#include "ua_util.h"')
-    header.append('#include "ua_types.h"')
-    header.append('#include "ua_types_encoding_binary.h"')
-    header.append('#include "ua_types_generated_encoding_binary.h"')
-    header.append('#include "ua_transport_generated_encoding_binary.h"')
-    header.append('#else')
-    header.append('#include "open62541.h"')
-    header.append('#define NULL ((void *)0)')
-    header.append('#endif')
-      
-    code.append('#include "'+outfilename+'.h"')
+    (header, code) = self.printOpen62541Preamble(outfilename)
     code.append("UA_INLINE void "+outfilename+"(UA_Server *server) {")
     
     # Before printing nodes, we need to request additional namespace arrays from the server